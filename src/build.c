@@ -12,6 +12,14 @@
  * are supposed to be match states, and then hand this info to
  * matassign2hmm().
  * 
+ * For a big alignment, the column labeling, the checking of the faux
+ * traces, and the counting can be divided amongst <bld->ncpus>
+ * threads: columns and sequences are sharded trivially, and counts
+ * are sharded by bands of model nodes, so each count is still summed
+ * in sequence order and the model doesn't depend on the number of
+ * threads. Faux traces are in node order, so each band finds its
+ * own stretch of each trace by bisection instead of walking it all.
+ * 
  * 
  * Contents:
  *    1. Exported API: model construction routines.
@@ -28,12 +36,42 @@
 #include "esl_alphabet.h"
 #include "esl_msa.h"
 #include "esl_msafile.h"
+#include "esl_random.h"
+#include "esl_vectorops.h"
+#ifdef HMMER_THREADS
+#include "esl_threads.h"
+#endif /*HMMER_THREADS*/
 
 #include "hmmer.h"
 
+/* One share of a model construction step, done either serially by
+ * the caller or by one worker thread: the range lo..hi-1 is a range
+ * of alignment columns, sequences, or model nodes, depending on the
+ * step <func>.
+ */
+typedef struct build_share_s {
+  int      (*func)(struct build_share_s *sh);
+  ESL_MSA   *msa;
+  float      symfrac;
+  int       *matassign;
+  P7_TRACE **tr;
+  int       *inorder;   /* [0..nseq-1] TRUE if tr[idx]'s node indices never decrease */
+  P7_HMM    *hmm;
+  int        lo, hi;
+  int        status;
+} BUILD_SHARE;
+
 static int do_modelmask( ESL_MSA *msa);
-static int matassign2hmm(ESL_MSA *msa, int *matassign, P7_HMM **ret_hmm, P7_TRACE ***opt_tr);
+static int matassign2hmm(ESL_MSA *msa, int *matassign, int ncpus, P7_HMM **ret_hmm, P7_TRACE ***opt_tr);
 static int annotate_model(P7_HMM *hmm, int *matassign, ESL_MSA *msa);
+static int run_shares    (BUILD_SHARE *proto, int (*func)(BUILD_SHARE *), int ncpus, int lo, int hi);
+static int assign_columns(BUILD_SHARE *sh);
+static int check_traces  (BUILD_SHARE *sh);
+static int count_traces  (BUILD_SHARE *sh);
+static void band_zrange  (const P7_TRACE *tr, int ka, int kb, int *ret_za, int *ret_zb);
+#ifdef HMMER_THREADS
+static void share_thread (void *arg);
+#endif
 
 /*****************************************************************
  * 1. Exported API: model construction routines.
@@ -61,7 +99,8 @@ static int annotate_model(P7_HMM *hmm, int *matassign, ESL_MSA *msa);
  *           no consensus columns, a <eslENORESULT> error is returned.
  *           
  * Args:     msa     - multiple sequence alignment
- *           bld       - holds information on regions requiring masking, optionally NULL -> no masking
+ *           bld       - holds information on regions requiring masking, optionally NULL -> no masking;
+ *                       and <bld->ncpus>, the number of threads to use
  *           ret_hmm - RETURN: counts-form HMM
  *           opt_tr  - optRETURN: array of tracebacks for aseq's
  *           
@@ -94,7 +133,7 @@ p7_Handmodelmaker(ESL_MSA *msa, P7_BUILDER *bld, P7_HMM **ret_hmm, P7_TRACE ***o
     matassign[apos] = (esl_abc_CIsGap(msa->abc, msa->rf[apos-1])? FALSE : TRUE);
 
   /* matassign2hmm leaves ret_hmm, opt_tr in their proper state: */
-  if ((status = matassign2hmm(msa, matassign, ret_hmm, opt_tr)) != eslOK) goto ERROR;
+  if ((status = matassign2hmm(msa, matassign, (bld ? bld->ncpus : 0), ret_hmm, opt_tr)) != eslOK) goto ERROR;
 
   free(matassign);
   return eslOK;
@@ -137,7 +176,8 @@ p7_Handmodelmaker(ESL_MSA *msa, P7_BUILDER *bld, P7_HMM **ret_hmm, P7_TRACE ***o
  *           
  * Args:     msa       - multiple sequence alignment
  *           symfrac   - threshold for residue occupancy; >= assigns MATCH
- *           bld       - holds information on regions requiring masking, optionally NULL -> no masking
+ *           bld       - holds information on regions requiring masking, optionally NULL -> no masking;
+ *                       and <bld->ncpus>, the number of threads to use
  *           ret_hmm   - RETURN: counts-form HMM
  *           opt_tr    - optRETURN: array of tracebacks for aseq's
  *           
@@ -154,12 +194,10 @@ p7_Handmodelmaker(ESL_MSA *msa, P7_BUILDER *bld, P7_HMM **ret_hmm, P7_TRACE ***o
 int
 p7_Fastmodelmaker(ESL_MSA *msa, float symfrac, P7_BUILDER *bld, P7_HMM **ret_hmm, P7_TRACE ***opt_tr)
 {
-  int      status;	     /* return status flag                  */
-  int     *matassign = NULL; /* MAT state assignments if 1; 1..alen */
-  int      idx;              /* counter over sequences              */
-  int      apos;             /* counter for aligned columns         */
-  float    r;		         /* weighted residue count              */
-  float    totwgt;	     /* weighted residue+gap count          */
+  int          status;	         /* return status flag                  */
+  int         *matassign = NULL; /* MAT state assignments if 1; 1..alen */
+  int          ncpus     = (bld != NULL ? bld->ncpus : 0);
+  BUILD_SHARE  proto;
 
   if (! (msa->flags & eslMSA_DIGITAL)) ESL_XEXCEPTION(eslEINVAL, "need digital MSA");
 
@@ -169,25 +207,19 @@ p7_Fastmodelmaker(ESL_MSA *msa, float symfrac, P7_BUILDER *bld, P7_HMM **ret_hmm
 
   /* Determine weighted sym freq in each column, set matassign[] accordingly.
    */
-  for (apos = 1; apos <= msa->alen; apos++) 
-    {  
-      r = totwgt = 0.;
-      for (idx = 0; idx < msa->nseq; idx++) 
-      {
-        if       (esl_abc_XIsResidue(msa->abc, msa->ax[idx][apos])) { r += msa->wgt[idx]; totwgt += msa->wgt[idx]; }
-        else if  (esl_abc_XIsGap(msa->abc,     msa->ax[idx][apos])) {                     totwgt += msa->wgt[idx]; }
-        else if  (esl_abc_XIsMissing(msa->abc, msa->ax[idx][apos])) continue;
-      }
-      if (r > 0. && r / totwgt >= symfrac) matassign[apos] = TRUE;
-      else                                 matassign[apos] = FALSE;
-    }
-
+  proto.msa       = msa;
+  proto.symfrac   = symfrac;
+  proto.matassign = matassign;
+  proto.tr        = NULL;
+  proto.inorder   = NULL;
+  proto.hmm       = NULL;
+  if ((status = run_shares(&proto, assign_columns, ncpus, 1, msa->alen+1)) != eslOK) goto ERROR;
 
   /* Once we have matassign calculated, modelmakers behave
    * the same; matassign2hmm() does this stuff (traceback construction,
    * trace counting) and sets up ret_hmm and opt_tr.
    */
-  if ((status = matassign2hmm(msa, matassign, ret_hmm, opt_tr)) != eslOK) {
+  if ((status = matassign2hmm(msa, matassign, ncpus, ret_hmm, opt_tr)) != eslOK) {
     fprintf (stderr, "hmm construction error during trace counting\n");
     goto ERROR;
   }
@@ -246,6 +278,7 @@ do_modelmask( ESL_MSA *msa)
  *           
  * Args:     msa       - multiple sequence alignment
  *           matassign - 1..alen bit flags for column assignments
+ *           ncpus     - number of threads to use; 0 = serial
  *           ret_hmm   - RETURN: counts-form HMM
  *           opt_tr    - optRETURN: array of tracebacks for aseq's
  *                         
@@ -255,15 +288,15 @@ do_modelmask( ESL_MSA *msa)
  *           ret_hmm and opt_tr alloc'ed here.
  */
 static int
-matassign2hmm(ESL_MSA *msa, int *matassign, P7_HMM **ret_hmm, P7_TRACE ***opt_tr)
+matassign2hmm(ESL_MSA *msa, int *matassign, int ncpus, P7_HMM **ret_hmm, P7_TRACE ***opt_tr)
 {
-  int        status;		/* return status                       */
-  P7_HMM    *hmm = NULL;        /* RETURN: new hmm                     */
-  P7_TRACE **tr  = NULL;        /* RETURN: 0..nseq-1 fake traces       */
-  int      M;                   /* length of new model in match states */
-  int      idx;                 /* counter over sequences              */
-  int      apos;                /* counter for aligned columns         */
-  char errbuf[eslERRBUFSIZE];
+  int          status;		/* return status                       */
+  P7_HMM      *hmm = NULL;      /* RETURN: new hmm                     */
+  P7_TRACE   **tr  = NULL;      /* RETURN: 0..nseq-1 fake traces       */
+  int         *inorder = NULL;  /* per trace: TRUE if in node order     */
+  int          M;               /* length of new model in match states */
+  int          apos;            /* counter for aligned columns         */
+  BUILD_SHARE  proto;
 
   /* apply the model mask in the 'GC MM' row */
   do_modelmask(msa);
@@ -274,22 +307,22 @@ matassign2hmm(ESL_MSA *msa, int *matassign, P7_HMM **ret_hmm, P7_TRACE ***opt_tr
   if (M == 0) { status = eslENORESULT; goto ERROR; }
 
   /* Make fake tracebacks for each seq */
-  ESL_ALLOC(tr, sizeof(P7_TRACE *) * msa->nseq);
+  ESL_ALLOC(tr,      sizeof(P7_TRACE *) * msa->nseq);
+  ESL_ALLOC(inorder, sizeof(int)        * msa->nseq);
   if ((status = p7_trace_FauxFromMSA(msa, matassign, p7_MSA_COORDS, tr))        != eslOK) goto ERROR;
-  for (idx = 0; idx < msa->nseq; idx++)
-    {
-      if ((status = p7_trace_Doctor(tr[idx], NULL, NULL))                       != eslOK) goto ERROR;
-      if ((status = p7_trace_Validate(tr[idx], msa->abc, msa->ax[idx], errbuf)) != eslOK) 
-	ESL_XEXCEPTION(eslFAIL, "validation failed: %s", errbuf);
-    }
-
-  /* Build count model from tracebacks */
+  proto.msa       = msa;
+  proto.symfrac   = 0.;
+  proto.matassign = matassign;
+  proto.tr        = tr;
+  proto.inorder   = inorder;
+  proto.hmm       = NULL;
+  if ((status = run_shares(&proto, check_traces, ncpus, 0, msa->nseq))           != eslOK) goto ERROR;
+
+  /* Build count model from tracebacks, sharded by bands of nodes 0..M */
   if ((hmm    = p7_hmm_Create(M, msa->abc)) == NULL)  { status = eslEMEM; goto ERROR; }
   if ((status = p7_hmm_Zero(hmm))           != eslOK) goto ERROR;
-  for (idx = 0; idx < msa->nseq; idx++) {
-    if (tr[idx] == NULL) continue; /* skip rare examples of empty sequences */
-    if ((status = p7_trace_Count(hmm, msa->ax[idx], msa->wgt[idx], tr[idx])) != eslOK) goto ERROR;
-  }
+  proto.hmm = hmm;
+  if ((status = run_shares(&proto, count_traces, ncpus, 0, M+1))                 != eslOK) goto ERROR;
 
   hmm->nseq     = msa->nseq;
   hmm->eff_nseq = msa->nseq;
@@ -309,10 +342,12 @@ matassign2hmm(ESL_MSA *msa, int *matassign, P7_HMM **ret_hmm, P7_TRACE ***opt_tr
 
   if (opt_tr  != NULL) *opt_tr  = tr; 
   else                  p7_trace_DestroyArray(tr, msa->nseq);
+  free(inorder);
   *ret_hmm = hmm;
   return eslOK;
 
  ERROR:
+  if (inorder != NULL) free(inorder);
   if (tr     != NULL) p7_trace_DestroyArray(tr, msa->nseq);
   if (hmm    != NULL) p7_hmm_Destroy(hmm);
   if (opt_tr != NULL) *opt_tr = NULL;
@@ -395,6 +430,202 @@ annotate_model(P7_HMM *hmm, int *matassign, ESL_MSA *msa)
   return status;
 }
 
+/* run_shares()
+ * 
+ * Divide the range <lo..hi-1> into shares, one per thread (or one, if
+ * <ncpus> is 0 or we're not threaded), and do <func> on each: the
+ * shares are copies of <proto>, with their own ranges. Returns
+ * <eslOK> if all shares succeeded; else the first failing share's
+ * error code.
+ */
+static int
+run_shares(BUILD_SHARE *proto, int (*func)(BUILD_SHARE *), int ncpus, int lo, int hi)
+{
+  BUILD_SHARE *sh      = NULL;
+  int          nshares = 1;
+#ifdef HMMER_THREADS
+  ESL_THREADS *threadObj = NULL;
+#endif
+  int          t;
+  int          status;
+
+#ifdef HMMER_THREADS
+  nshares = ESL_MAX(1, ESL_MIN(ncpus, hi-lo));
+#endif
+  ESL_ALLOC(sh, sizeof(BUILD_SHARE) * nshares);
+  for (t = 0; t < nshares; t++)
+    {
+      sh[t]        = *proto;
+      sh[t].func   = func;
+      sh[t].lo     = lo + (int) ((int64_t) (hi-lo) * t     / nshares);
+      sh[t].hi     = lo + (int) ((int64_t) (hi-lo) * (t+1) / nshares);
+      sh[t].status = eslOK;
+    }
+
+  if (nshares == 1) (*func)(&sh[0]);
+#ifdef HMMER_THREADS
+  else
+    {
+      if ((threadObj = esl_threads_Create(&share_thread)) == NULL) { status = eslEMEM; goto ERROR; }
+      for (t = 0; t < nshares; t++) esl_threads_AddThread(threadObj, &sh[t]);
+      esl_threads_WaitForStart (threadObj);
+      esl_threads_WaitForFinish(threadObj);
+      esl_threads_Destroy(threadObj);
+    }
+#endif
+
+  status = eslOK;
+  for (t = 0; t < nshares; t++)
+    if (sh[t].status != eslOK) { status = sh[t].status; break; }
+
+ ERROR:
+  if (sh != NULL) free(sh);
+  return status;
+}
+
+/* assign_columns()
+ * 
+ * The Krogh/Haussler rule, for columns <sh->lo..hi-1>: determine weighted
+ * sym freq in each column, set <sh->matassign[]> accordingly.
+ */
+static int
+assign_columns(BUILD_SHARE *sh)
+{
+  ESL_MSA *msa = sh->msa;
+  int      idx;              /* counter over sequences              */
+  int      apos;             /* counter for aligned columns         */
+  float    r;		     /* weighted residue count              */
+  float    totwgt;	     /* weighted residue+gap count          */
+
+  for (apos = sh->lo; apos < sh->hi; apos++) 
+    {  
+      r = totwgt = 0.;
+      for (idx = 0; idx < msa->nseq; idx++) 
+      {
+        if       (esl_abc_XIsResidue(msa->abc, msa->ax[idx][apos])) { r += msa->wgt[idx]; totwgt += msa->wgt[idx]; }
+        else if  (esl_abc_XIsGap(msa->abc,     msa->ax[idx][apos])) {                     totwgt += msa->wgt[idx]; }
+        else if  (esl_abc_XIsMissing(msa->abc, msa->ax[idx][apos])) continue;
+      }
+      if (r > 0. && r / totwgt >= sh->symfrac) sh->matassign[apos] = TRUE;
+      else                                     sh->matassign[apos] = FALSE;
+    }
+  return (sh->status = eslOK);
+}
+
+/* check_traces()
+ * 
+ * Doctor and validate the faux traces of sequences <sh->lo..hi-1>,
+ * and note in <sh->inorder[]> which ones have nondecreasing node
+ * indices between their B and E, so count_traces() can bisect them.
+ */
+static int
+check_traces(BUILD_SHARE *sh)
+{
+  ESL_MSA *msa = sh->msa;
+  int      idx;
+  char     errbuf[eslERRBUFSIZE];
+  int      status;
+
+  P7_TRACE *tr;
+  int       z;
+
+  for (idx = sh->lo; idx < sh->hi; idx++)
+    {
+      tr = sh->tr[idx];
+      if ((status = p7_trace_Doctor(tr, NULL, NULL))                       != eslOK) goto ERROR;
+      if ((status = p7_trace_Validate(tr, msa->abc, msa->ax[idx], errbuf)) != eslOK) 
+	ESL_XEXCEPTION(eslFAIL, "validation failed: %s", errbuf);
+
+      sh->inorder[idx] = (tr->st[0] == p7T_B);
+      for (z = 2; z < tr->N-1 && sh->inorder[idx]; z++)
+	if (tr->k[z] < tr->k[z-1]) sh->inorder[idx] = FALSE;
+    }
+  return (sh->status = eslOK);
+
+ ERROR:
+  return (sh->status = status);
+}
+
+/* count_traces()
+ * 
+ * Count all the traces into nodes <sh->lo..hi-1> of the count model
+ * <sh->hmm>. Each count is summed in the same sequence order as a
+ * serial p7_trace_Count() would, so the sharding is invisible in
+ * the result. Only the stretch of each trace that lands in the
+ * band is visited, when check_traces() found the trace in node order.
+ */
+static int
+count_traces(BUILD_SHARE *sh)
+{
+  ESL_MSA *msa = sh->msa;
+  int      idx;
+  int      za, zb;
+  int      status;
+
+  for (idx = 0; idx < msa->nseq; idx++) {
+    if (sh->tr[idx] == NULL) continue; /* skip rare examples of empty sequences */
+    za = 0;
+    zb = sh->tr[idx]->N-1;
+    if (sh->inorder[idx]) band_zrange(sh->tr[idx], sh->lo, sh->hi-1, &za, &zb);
+    if ((status = p7_trace_CountBand(sh->hmm, msa->ax[idx], msa->wgt[idx], sh->tr[idx], sh->lo, sh->hi-1, za, zb)) != eslOK) return (sh->status = status);
+  }
+  return (sh->status = eslOK);
+}
+
+/* band_zrange()
+ * 
+ * For a core trace <tr> whose node indices never decrease between
+ * its B (z=0) and E (z=N-1), find the trace positions <za..zb>
+ * that can count into nodes <ka..kb>: the states in nodes ka..kb,
+ * plus the B state when nothing lies before node <ka>, since a
+ * wing-retracted B->Mk entry counts into nodes 0..k-1.
+ */
+static void
+band_zrange(const P7_TRACE *tr, int ka, int kb, int *ret_za, int *ret_zb)
+{
+  int lo, hi, mid;
+
+  lo = 1; hi = tr->N-1;      /* first z in 1..N-2 with k >= ka; N-1 if none */
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (tr->k[mid] >= ka) hi = mid;
+    else                  lo = mid+1;
+  }
+  *ret_za = (lo == 1 ? 0 : lo);
+
+  lo = 0; hi = tr->N-2;      /* last z in 1..N-2 with k <= kb; 0 if none */
+  while (lo < hi) {
+    mid = (lo + hi + 1) / 2;
+    if (tr->k[mid] <= kb) lo = mid;
+    else                  hi = mid-1;
+  }
+  *ret_zb = lo;
+}
+
+#ifdef HMMER_THREADS
+/* share_thread()
+ * A worker thread: does one share of a model construction step.
+ */
+static void 
+share_thread(void *arg)
+{
+  int          workeridx;
+  BUILD_SHARE *sh;
+  ESL_THREADS *obj;
+
+  obj = (ESL_THREADS *) arg;
+  esl_threads_Started(obj, &workeridx);
+
+  sh = (BUILD_SHARE *) esl_threads_GetData(obj, workeridx);
+  (*sh->func)(sh);
+
+  esl_threads_Finished(obj, workeridx);
+  return;
+}
+#endif /*HMMER_THREADS*/
+/*---------------- end, private model construction -------------*/
+
+
 /*****************************************************************
  * 3. Unit tests.
  *****************************************************************/
@@ -521,6 +752,58 @@ utest_fragments(void)
   return;
 }
 
+/* utest_threaded()
+ * Building the same weighted alignment with and without threads must
+ * give exactly the same counts; the node-banded counting sums each
+ * count in the same order as serial counting does.
+ */
+static void
+utest_threaded(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, int M, int N, int ncpus)
+{
+  char          *failmsg = "failure in build.c::utest_threaded() unit test";
+  P7_HMM        *hmm     = NULL;
+  P7_HMM        *h1      = NULL;
+  P7_HMM        *h2      = NULL;
+  P7_BUILDER    *bld     = p7_builder_Create(NULL, abc);
+  ESL_SQ       **sq      = malloc(sizeof(ESL_SQ *)   * N);
+  P7_TRACE     **tr      = malloc(sizeof(P7_TRACE *) * N);
+  ESL_MSA       *msa     = NULL;
+  int            idx, k;
+
+  if (p7_hmm_Sample(r, M, abc, &hmm) != eslOK) esl_fatal(failmsg);
+  for (idx = 0; idx < N; idx++)
+    {
+      sq[idx] = esl_sq_CreateDigital(abc);
+      tr[idx] = p7_trace_Create();
+      if (p7_CoreEmit(r, hmm, sq[idx], tr[idx]) != eslOK) esl_fatal(failmsg);
+    }
+  if (p7_tracealign_Seqs(sq, tr, N, M, p7_DIGITIZE, NULL, &msa) != eslOK) esl_fatal(failmsg);
+  for (idx = 0; idx < N; idx++) msa->wgt[idx] = esl_random(r); /* so summation order would matter */
+  msa->flags |= eslMSA_HASWGTS;
+
+  bld->ncpus = 0;
+  if (p7_Fastmodelmaker(msa, 0.5, bld, &h1, NULL) != eslOK) esl_fatal(failmsg);
+  bld->ncpus = ncpus;
+  if (p7_Fastmodelmaker(msa, 0.5, bld, &h2, NULL) != eslOK) esl_fatal(failmsg);
+
+  if (h1->M != h2->M) esl_fatal(failmsg);
+  for (k = 0; k <= h1->M; k++)
+    {
+      if (esl_vec_FCompare(h1->mat[k], h2->mat[k], abc->K, 0.0) != eslOK) esl_fatal(failmsg);
+      if (esl_vec_FCompare(h1->ins[k], h2->ins[k], abc->K, 0.0) != eslOK) esl_fatal(failmsg);
+      if (esl_vec_FCompare(h1->t[k],   h2->t[k],   p7H_NTRANSITIONS, 0.0) != eslOK) esl_fatal(failmsg);
+    }
+
+  for (idx = 0; idx < N; idx++) { esl_sq_Destroy(sq[idx]); p7_trace_Destroy(tr[idx]); }
+  free(sq);
+  free(tr);
+  esl_msa_Destroy(msa);
+  p7_builder_Destroy(bld);
+  p7_hmm_Destroy(h1);
+  p7_hmm_Destroy(h2);
+  p7_hmm_Destroy(hmm);
+}
+
 #endif /*p7BUILD_TESTDRIVE*/
 /*---------------------- end of unit tests -----------------------*/
 
@@ -542,8 +825,15 @@ utest_fragments(void)
 int
 main(int argc, char **argv)
 {  
+  ESL_RANDOMNESS *r   = esl_randomness_CreateFast(42);
+  ESL_ALPHABET   *abc = esl_alphabet_Create(eslAMINO);
+
   utest_basic();
   utest_fragments();
+  utest_threaded(r, abc, 50, 200, 4);
+
+  esl_alphabet_Destroy(abc);
+  esl_randomness_Destroy(r);
 
   return eslOK;
 }
@@ -0,0 +1,552 @@
+/* Single-linkage clustering of aligned sequences at a percent
+ * identity threshold: used for effective sequence number (--eclust)
+ * and for BLOSUM relative weights (--wblosum).
+ *
+ * Gives the same clusters as Easel's esl_msacluster_SingleLinkage(),
+ * with pairwise identity defined the same way as esl_dst_XPairId()
+ * (identities in canonical residues, divided by the length of the
+ * shorter sequence), but faster on big alignments:
+ *   - sequences are recoded once into rows of residue codes, with
+ *     all noncanonical symbols (gaps, degeneracies, missing data)
+ *     folded to one code that never counts as an identity;
+ *   - each pair is first screened with a bound from the residue
+ *     counts in 64-column blocks, which rejects most pairs of
+ *     fragments that don't overlap enough without looking at
+ *     their residues;
+ *   - the comparison of a pair stops as soon as the shorter
+ *     sequence has enough non-identities that the pair can't
+ *     reach the threshold; with SSE, 16 columns at a time.
+ *
+ * Optionally, the clustering can be approximated by comparing
+ * sequences on a random sample of <ncols> columns instead of all of
+ * them. See p7_SingleLinkage() for the error bound.
+ *
+ * Contents:
+ *    1. p7_SingleLinkage()
+ *    2. Internal functions
+ *    3. Unit tests
+ *    4. Test driver
+ */
+#include "p7_config.h"
+
+#include <string.h>
+
+#if defined eslENABLE_SSE
+#include <xmmintrin.h>		/* SSE  */
+#include <emmintrin.h>		/* SSE2 */
+#endif
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_msa.h"
+#include "esl_random.h"
+#include "esl_sq.h"
+#include "esl_vectorops.h"
+
+#include "hmmer.h"
+
+#define p7ECLUST_BLOCK   64	/* columns per block in the residue count screen; also multiple of 16 for SSE */
+#define p7ECLUST_NONRES  255	/* row code for anything that isn't a canonical residue                     */
+
+/* The recoded alignment. Row i is X + i*W: W residue codes, 0..K-1
+ * or p7ECLUST_NONRES, padded with NONRES to a multiple of the block
+ * size. bcnt + i*nb is the number of residues in each block of row i.
+ */
+typedef struct {
+  int      N;			/* number of sequences                                */
+  int      W;			/* row width, in columns                              */
+  int      nb;			/* number of blocks per row: W / p7ECLUST_BLOCK       */
+  uint8_t *X;			/* N*W residue codes                                  */
+  uint8_t *bcnt;		/* N*nb per-block residue counts (0..64)              */
+  int     *len;			/* number of residues in each row                     */
+  int     *maxmiss;		/* [0..W]: max non-identities in the shorter seq of length n, to still link; -1 = can't link */
+} ECLUST_ROWS;
+
+static int  rows_Create (const ESL_MSA *msa, int *cols, int ncols, double maxid, ECLUST_ROWS **ret_rows);
+static void rows_Destroy(ECLUST_ROWS *rows);
+static int  is_linked   (const ECLUST_ROWS *rows, int i, int j);
+
+
+/*****************************************************************
+ * 1. p7_SingleLinkage()
+ *****************************************************************/
+
+/* Function:  p7_SingleLinkage()
+ * Synopsis:  Single linkage clustering of an MSA by percent identity.
+ *
+ * Purpose:   Cluster the sequences in digital alignment <msa> by
+ *            single linkage at fractional pairwise identity <maxid>:
+ *            two sequences are linked if their identity is $\geq$
+ *            <maxid>, and the clusters are the connected components.
+ *            Identity is calculated as in <esl_dst_XPairId()>: the
+ *            number of identical aligned canonical residues, divided
+ *            by the number of canonical residues in the shorter
+ *            sequence (or 0, if either sequence has none). The
+ *            clusters are the same as <esl_msacluster_SingleLinkage()>
+ *            finds. They're numbered <0..nc-1> in order of the first
+ *            sequence in each.
+ *
+ *            If <ncols> is $>0$ and less than the alignment length,
+ *            identities are instead estimated on a random sample of
+ *            <ncols> columns, drawn without replacement using <r>;
+ *            this is an approximation, with a cost proportional to
+ *            <ncols> instead of the alignment length. For one pair,
+ *            if $n$ of the sampled columns have residues in the
+ *            shorter sequence, the estimated identity is within
+ *            $\epsilon$ of its true value with probability at least
+ *            $1 - 2 e^{-2n\epsilon^2}$ (Hoeffding's bound, which
+ *            holds for sampling without replacement). For example,
+ *            with $n = 300$, a pair whose true identity is more than
+ *            0.1 away from <maxid> is put on the wrong side of the
+ *            threshold with probability less than 0.005. If <ncols>
+ *            is 0, or $\geq$ the alignment length, the clustering is
+ *            exact, and <r> may be <NULL>.
+ *
+ * Args:      msa     - digital alignment to cluster
+ *            maxid   - fractional identity threshold for linking, 0..1
+ *            ncols   - 0 for exact; else # of columns to sample
+ *            r       - RNG for column sampling, or NULL if <ncols> is 0
+ *            opt_c   - optRETURN: cluster assignments <0..nseq-1>, values <0..nc-1>
+ *            opt_nin - optRETURN: number of sequences in each cluster <0..nc-1>
+ *            ret_nc  - RETURN: number of clusters
+ *
+ * Returns:   <eslOK> on success; <*opt_c> and <*opt_nin> are
+ *            allocated here, and the caller frees them.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ *            <eslEINVAL> if the <msa> isn't digital, or <ncols> > 0
+ *            without an <r>.
+ */
+int
+p7_SingleLinkage(const ESL_MSA *msa, double maxid, int ncols, ESL_RANDOMNESS *r, int **opt_c, int **opt_nin, int *ret_nc)
+{
+  ECLUST_ROWS *rows  = NULL;
+  int         *cols  = NULL;	/* 1..alen column numbers to use, if sampling; else NULL */
+  int         *c     = NULL;	/* cluster assignment of each seq, or -1 if unassigned   */
+  int         *nin   = NULL;
+  int         *a     = NULL;	/* a[0..na-1]: unassigned sequences                      */
+  int         *pos   = NULL;	/* pos[i]: where unassigned seq i is in a[]              */
+  int         *stack = NULL;	/* sequences in the current cluster yet to be searched from */
+  int          na, ns;
+  int          nc    = 0;
+  int          i, j, v, n, tmp;
+  int          status;
+
+  if (! (msa->flags & eslMSA_DIGITAL)) ESL_XEXCEPTION(eslEINVAL, "need a digital msa");
+
+  if (ncols > 0 && ncols < msa->alen)
+    {
+      if (r == NULL) ESL_XEXCEPTION(eslEINVAL, "column sampling needs an RNG");
+      ESL_ALLOC(cols, sizeof(int) * msa->alen);
+      for (n = 0; n < msa->alen; n++) cols[n] = n+1;
+      for (n = 0; n < ncols; n++)	/* partial Fisher-Yates shuffle: cols[0..ncols-1] is the sample */
+	{
+	  j       = n + esl_rnd_Roll(r, msa->alen - n);
+	  tmp     = cols[n]; cols[n] = cols[j]; cols[j] = tmp;
+	}
+    }
+  else ncols = msa->alen;
+
+  if ((status = rows_Create(msa, cols, ncols, maxid, &rows)) != eslOK) goto ERROR;
+
+  ESL_ALLOC(c,     sizeof(int) * ESL_MAX(1, msa->nseq));
+  ESL_ALLOC(a,     sizeof(int) * ESL_MAX(1, msa->nseq));
+  ESL_ALLOC(pos,   sizeof(int) * ESL_MAX(1, msa->nseq));
+  ESL_ALLOC(stack, sizeof(int) * ESL_MAX(1, msa->nseq));
+  for (i = 0; i < msa->nseq; i++) { c[i] = -1; a[i] = i; pos[i] = i; }
+  na = msa->nseq;
+
+  /* Each unassigned sequence, in order, seeds a new cluster; then
+   * search outward from it, comparing each sequence in the cluster
+   * only to the sequences that remain unassigned. A highly redundant
+   * alignment empties the unassigned list quickly.
+   */
+  for (i = 0; i < msa->nseq; i++)
+    {
+      if (c[i] != -1) continue;
+      c[i] = nc;
+      a[pos[i]] = a[na-1]; pos[a[na-1]] = pos[i]; na--;
+      stack[0] = i; ns = 1;
+
+      while (ns > 0)
+	{
+	  v = stack[--ns];
+	  for (n = na-1; n >= 0; n--)	/* downwards, so the swap-remove below only moves already-tested seqs */
+	    {
+	      j = a[n];
+	      if (! is_linked(rows, v, j)) continue;
+	      c[j]      = nc;
+	      a[n]      = a[na-1]; pos[a[n]] = n; na--;
+	      stack[ns++] = j;
+	    }
+	}
+      nc++;
+    }
+
+  if (opt_nin != NULL)
+    {
+      ESL_ALLOC(nin, sizeof(int) * ESL_MAX(1, nc));
+      esl_vec_ISet(nin, nc, 0);
+      for (i = 0; i < msa->nseq; i++) nin[c[i]]++;
+    }
+
+  rows_Destroy(rows);
+  free(cols);
+  free(a);
+  free(pos);
+  free(stack);
+  if (opt_c   != NULL) *opt_c   = c;   else free(c);
+  if (opt_nin != NULL) *opt_nin = nin;
+  *ret_nc = nc;
+  return eslOK;
+
+ ERROR:
+  rows_Destroy(rows);
+  if (cols  != NULL) free(cols);
+  if (c     != NULL) free(c);
+  if (nin   != NULL) free(nin);
+  if (a     != NULL) free(a);
+  if (pos   != NULL) free(pos);
+  if (stack != NULL) free(stack);
+  if (opt_c   != NULL) *opt_c   = NULL;
+  if (opt_nin != NULL) *opt_nin = NULL;
+  *ret_nc = 0;
+  return status;
+}
+/*----------------- end, p7_SingleLinkage() ---------------------*/
+
+
+
+/*****************************************************************
+ * 2. Internal functions
+ *****************************************************************/
+
+/* rows_Create()
+ * Recode the <msa> into rows of residue codes: all of its columns
+ * 1..alen if <cols> is NULL, else the <ncols> columns <cols[0..ncols-1]>.
+ * Also precalculate each row's residue count and per-block residue
+ * counts, and the link criterion for <maxid> in terms of
+ * non-identities, for each possible length of the shorter sequence.
+ */
+static int
+rows_Create(const ESL_MSA *msa, int *cols, int ncols, double maxid, ECLUST_ROWS **ret_rows)
+{
+  ECLUST_ROWS *rows = NULL;
+  uint8_t     *row;
+  ESL_DSQ      x;
+  int          i, n, need;
+  int          status;
+
+  ESL_ALLOC(rows, sizeof(ECLUST_ROWS));
+  rows->X       = NULL;
+  rows->bcnt    = NULL;
+  rows->len     = NULL;
+  rows->maxmiss = NULL;
+
+  rows->N  = msa->nseq;
+  rows->nb = ESL_MAX(1, (ncols + p7ECLUST_BLOCK - 1) / p7ECLUST_BLOCK);
+  rows->W  = rows->nb * p7ECLUST_BLOCK;
+  ESL_ALLOC(rows->X,       sizeof(uint8_t) * ESL_MAX(1, rows->N) * rows->W);
+  ESL_ALLOC(rows->bcnt,    sizeof(uint8_t) * ESL_MAX(1, rows->N) * rows->nb);
+  ESL_ALLOC(rows->len,     sizeof(int)     * ESL_MAX(1, rows->N));
+  ESL_ALLOC(rows->maxmiss, sizeof(int)     * (rows->W+1));
+
+  for (i = 0; i < rows->N; i++)
+    {
+      row = rows->X + (int64_t) i * rows->W;
+      memset(row, p7ECLUST_NONRES, rows->W);
+      memset(rows->bcnt + (int64_t) i * rows->nb, 0, rows->nb);
+      rows->len[i] = 0;
+      for (n = 0; n < ncols; n++)
+	{
+	  x = msa->ax[i][(cols == NULL ? n+1 : cols[n])];
+	  if (! esl_abc_XIsCanonical(msa->abc, x)) continue;
+	  row[n] = x;
+	  rows->bcnt[(int64_t) i * rows->nb + n / p7ECLUST_BLOCK]++;
+	  rows->len[i]++;
+	}
+    }
+
+  /* A pair whose shorter seq has n residues links if (idents / n) >= maxid,
+   * exactly as esl_dst_XPairId() and the Easel linkage function decide it;
+   * or, if n = 0, if 0 >= maxid. Find the fewest idents that link
+   * (starting from a guess, then checking the same expression), and
+   * convert that to the most non-identities allowed.
+   */
+  rows->maxmiss[0] = (0. >= maxid ? 0 : -1);
+  for (n = 1; n <= rows->W; n++)
+    {
+      need = (int) (maxid * (double) n);
+      while (need > 0 && (double) (need-1) / (double) n >= maxid) need--;
+      while (need <= n && (double)  need    / (double) n <  maxid) need++;
+      rows->maxmiss[n] = (need <= n ? n - need : -1);
+    }
+
+  *ret_rows = rows;
+  return eslOK;
+
+ ERROR:
+  rows_Destroy(rows);
+  *ret_rows = NULL;
+  return status;
+}
+
+static void
+rows_Destroy(ECLUST_ROWS *rows)
+{
+  if (rows == NULL) return;
+  if (rows->X       != NULL) free(rows->X);
+  if (rows->bcnt    != NULL) free(rows->bcnt);
+  if (rows->len     != NULL) free(rows->len);
+  if (rows->maxmiss != NULL) free(rows->maxmiss);
+  free(rows);
+}
+
+
+/* is_linked()
+ * Return TRUE if sequences <i> and <j> are at least <maxid> identical.
+ *
+ * Identities can only happen at residues of the shorter sequence
+ * <s>, so count its "misses" (residues not matched by an identical
+ * residue in the other one, <o>), and give up once there are more than
+ * the pair can afford. Before looking at any residues, the block
+ * counts give a lower bound on misses: in each block, <s> misses at
+ * least as many residues as it has more than <o>.
+ */
+static int
+is_linked(const ECLUST_ROWS *rows, int i, int j)
+{
+  int            s       = (rows->len[i] <= rows->len[j] ? i : j);
+  int            o       = (s == i ? j : i);
+  int            maxmiss = rows->maxmiss[rows->len[s]];
+  const uint8_t *sb      = rows->bcnt + (int64_t) s * rows->nb;
+  const uint8_t *ob      = rows->bcnt + (int64_t) o * rows->nb;
+  const uint8_t *sx      = rows->X    + (int64_t) s * rows->W;
+  const uint8_t *ox      = rows->X    + (int64_t) o * rows->W;
+  int            miss    = 0;
+  int            b;
+#if defined eslENABLE_SSE
+  __m128i        nonres  = _mm_set1_epi8((char) p7ECLUST_NONRES);
+  __m128i        acc, sv, mv;
+  int            q;
+#else
+  int            x;
+#endif
+
+  if (maxmiss < 0) return FALSE;
+
+  for (b = 0; b < rows->nb; b++)
+    if (sb[b] > ob[b]) miss += sb[b] - ob[b];
+  if (miss > maxmiss) return FALSE;
+
+  /* Now count the actual misses, block by block. */
+  miss = 0;
+  for (b = 0; b < rows->nb; b++)
+    {
+      if (sb[b] == 0) continue;	/* no residues in s here: no misses */
+#if defined eslENABLE_SSE
+      acc = _mm_setzero_si128();
+      for (q = 0; q < p7ECLUST_BLOCK / 16; q++)
+	{
+	  sv  = _mm_loadu_si128((const __m128i *) (sx + b*p7ECLUST_BLOCK + q*16));
+	  mv  = _mm_loadu_si128((const __m128i *) (ox + b*p7ECLUST_BLOCK + q*16));
+	  /* a miss: s has a residue (sv != NONRES), and it isn't identical (sv != mv) */
+	  mv  = _mm_or_si128(_mm_cmpeq_epi8(sv, mv), _mm_cmpeq_epi8(sv, nonres));
+	  acc = _mm_sub_epi8(acc, _mm_andnot_si128(mv, _mm_set1_epi8(-1)));   /* -(-1) per miss */
+	}
+      acc   = _mm_sad_epu8(acc, _mm_setzero_si128());
+      miss += _mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8));
+#else
+      for (x = b*p7ECLUST_BLOCK; x < (b+1)*p7ECLUST_BLOCK; x++)
+	if (sx[x] != p7ECLUST_NONRES && sx[x] != ox[x]) miss++;
+#endif
+      if (miss > maxmiss) return FALSE;
+    }
+  return TRUE;
+}
+/*------------------ end, internal functions --------------------*/
+
+
+
+/*****************************************************************
+ * 3. Unit tests
+ *****************************************************************/
+#ifdef p7ECLUST_TESTDRIVE
+#include "esl_msacluster.h"
+
+/* sample_msa()
+ * Sample an <N>-sequence digital alignment from <hmm>.
+ */
+static ESL_MSA *
+sample_msa(ESL_RANDOMNESS *r, P7_HMM *hmm, int N)
+{
+  char      *msg = "eclust.c:: alignment sampling failed";
+  ESL_SQ   **sq  = malloc(sizeof(ESL_SQ *)   * N);
+  P7_TRACE **tr  = malloc(sizeof(P7_TRACE *) * N);
+  ESL_MSA   *msa = NULL;
+  int        idx;
+
+  if (sq == NULL || tr == NULL) esl_fatal(msg);
+  for (idx = 0; idx < N; idx++)
+    {
+      sq[idx] = esl_sq_CreateDigital(hmm->abc);
+      tr[idx] = p7_trace_Create();
+      if (p7_CoreEmit(r, hmm, sq[idx], tr[idx]) != eslOK) esl_fatal(msg);
+    }
+  if (p7_tracealign_Seqs(sq, tr, N, hmm->M, p7_DIGITIZE, NULL, &msa) != eslOK) esl_fatal(msg);
+
+  for (idx = 0; idx < N; idx++) { esl_sq_Destroy(sq[idx]); p7_trace_Destroy(tr[idx]); }
+  free(sq);
+  free(tr);
+  return msa;
+}
+
+/* utest_easel()
+ * Compare exact clustering to Easel's, on alignments sampled from a
+ * random profile, with some of the sequences made into fragments,
+ * at a range of identity thresholds. Clusters are numbered
+ * differently, so compare the partitions: the same number of
+ * clusters, and each of ours maps into exactly one of Easel's.
+ */
+static void
+utest_easel(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, int M, int N)
+{
+  char       *msg    = "eclust.c:: Easel comparison unit test failed";
+  double      maxid[] = { 0.0, 0.3, 0.5, 0.62, 0.8, 0.95, 1.0 };
+  P7_HMM     *hmm    = NULL;
+  ESL_MSA    *msa    = NULL;
+  int        *c1     = NULL;
+  int        *c2     = NULL;
+  int        *nin    = NULL;
+  int        *map    = NULL;
+  int         nc1, nc2;
+  int         t, i, x;
+
+  if (p7_hmm_Sample(r, M, abc, &hmm) != eslOK) esl_fatal(msg);
+  msa = sample_msa(r, hmm, N);
+
+  /* make some fragments, with missing data at the ends */
+  for (i = 0; i < N; i += 3)
+    for (x = 1; x <= msa->alen / 3; x++) msa->ax[i][x] = esl_abc_XGetMissing(abc);
+
+  for (t = 0; t < sizeof(maxid) / sizeof(double); t++)
+    {
+      if (p7_SingleLinkage(msa, maxid[t], 0, NULL, &c1, &nin, &nc1)    != eslOK) esl_fatal(msg);
+      if (esl_msacluster_SingleLinkage(msa, maxid[t], &c2, NULL, &nc2) != eslOK) esl_fatal(msg);
+      if (nc1 != nc2) esl_fatal(msg);
+
+      if ((map = malloc(sizeof(int) * nc1)) == NULL) esl_fatal(msg);
+      esl_vec_ISet(map, nc1, -1);
+      for (i = 0; i < N; i++)
+	{
+	  if (c1[i] < 0 || c1[i] >= nc1)                  esl_fatal(msg);
+	  if (i > 0 && c1[i] > esl_vec_IMax(c1, i) + 1)   esl_fatal(msg); /* numbered in order of first member */
+	  if      (map[c1[i]] == -1)    map[c1[i]] = c2[i];
+	  else if (map[c1[i]] != c2[i]) esl_fatal(msg);
+	}
+      for (i = 0, x = 0; i < nc1; i++) x += nin[i];
+      if (x != N) esl_fatal(msg);
+
+      free(map);
+      free(c1);
+      free(c2);
+      free(nin);
+    }
+
+  esl_msa_Destroy(msa);
+  p7_hmm_Destroy(hmm);
+}
+
+/* utest_sampled()
+ * Sampling all the columns is the same as exact clustering; and
+ * sampling fewer, only links pairs that are linked by a comparison
+ * on the sample, so identical sequences always stay together.
+ */
+static void
+utest_sampled(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, int M, int N)
+{
+  char       *msg    = "eclust.c:: column sampling unit test failed";
+  P7_HMM     *hmm    = NULL;
+  ESL_MSA    *msa    = NULL;
+  int        *c1     = NULL;
+  int        *c2     = NULL;
+  int         nc1, nc2;
+  int         i;
+
+  if (p7_hmm_Sample(r, M, abc, &hmm) != eslOK) esl_fatal(msg);
+  msa = sample_msa(r, hmm, N);
+
+  /* every other sequence is a copy of the one before it */
+  for (i = 1; i < N; i += 2) memcpy(msa->ax[i], msa->ax[i-1], sizeof(ESL_DSQ) * (msa->alen+2));
+
+  if (p7_SingleLinkage(msa, 0.62, 0,         NULL, &c1, NULL, &nc1) != eslOK) esl_fatal(msg);
+  if (p7_SingleLinkage(msa, 0.62, msa->alen, r,    &c2, NULL, &nc2) != eslOK) esl_fatal(msg);
+  if (nc1 != nc2) esl_fatal(msg);
+  for (i = 0; i < N; i++) if (c1[i] != c2[i]) esl_fatal(msg);
+  free(c2);
+
+  if (p7_SingleLinkage(msa, 0.62, msa->alen / 2, r, &c2, NULL, &nc2) != eslOK) esl_fatal(msg);
+  if (nc2 < 1 || nc2 > N / 2 + 1) esl_fatal(msg);
+  for (i = 1; i < N; i += 2) if (c2[i] != c2[i-1]) esl_fatal(msg);
+
+  free(c1);
+  free(c2);
+  esl_msa_Destroy(msa);
+  p7_hmm_Destroy(hmm);
+}
+#endif /*p7ECLUST_TESTDRIVE*/
+/*---------------------- end, unit tests ------------------------*/
+
+
+
+/*****************************************************************
+ * 4. Test driver
+ *****************************************************************/
+#ifdef p7ECLUST_TESTDRIVE
+/*
+ * gcc -g -Wall -msse2 -std=gnu99 -o eclust_utest -I. -L. -I../easel -L../easel -Dp7ECLUST_TESTDRIVE eclust.c -lhmmer -leasel -lm
+ */
+#include "p7_config.h"
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_getopts.h"
+#include "esl_random.h"
+
+#include "hmmer.h"
+
+static ESL_OPTIONS options[] = {
+  /* name           type      default  env  range toggles reqs incomp  help                                       docgroup*/
+  { "-h",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "show brief help on version and usage",           0 },
+  { "-s",        eslARG_INT,     "42", NULL, NULL,  NULL,  NULL, NULL, "set random number seed to <n>",                  0 },
+  { "-M",        eslARG_INT,     "60", NULL, NULL,  NULL,  NULL, NULL, "length of sampled profiles",                     0 },
+  { "-N",        eslARG_INT,    "150", NULL, NULL,  NULL,  NULL, NULL, "number of sampled sequences per alignment",      0 },
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+static char usage[]  = "[-options]";
+static char banner[] = "unit test driver for single linkage clustering";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go  = p7_CreateDefaultApp(options, 0, argc, argv, banner, usage);
+  ESL_RANDOMNESS *r   = esl_randomness_CreateFast(esl_opt_GetInteger(go, "-s"));
+  ESL_ALPHABET   *abc = NULL;
+  int             M   = esl_opt_GetInteger(go, "-M");
+  int             N   = esl_opt_GetInteger(go, "-N");
+
+  abc = esl_alphabet_Create(eslAMINO);
+  utest_easel  (r, abc, M, N);
+  utest_sampled(r, abc, M, N);
+  esl_alphabet_Destroy(abc);
+
+  abc = esl_alphabet_Create(eslDNA);
+  utest_easel  (r, abc, M, N);
+  esl_alphabet_Destroy(abc);
+
+  esl_randomness_Destroy(r);
+  esl_getopts_Destroy(go);
+  return 0;
+}
+#endif /*p7ECLUST_TESTDRIVE*/
+/*-------------------- end, test driver -------------------------*/
@@ -15,9 +15,40 @@
 #include "esl_random.h"
 #include "esl_randomseq.h"
 #include "esl_vectorops.h"
+#ifdef HMMER_THREADS
+#include "esl_threads.h"
+#endif /*HMMER_THREADS*/
 
 #include "hmmer.h"
 
+/* One share of a calibration simulation: scores of the random
+ * sequences <lo..hi-1> with one of the three fast algorithms. The
+ * <om> and <bg> are shared read-only; DP matrix is our own. A serial
+ * simulation passes <r> and samples each sequence just before
+ * scoring it, in the one slot of <dsq>.
+ */
+typedef struct {
+  P7_OPROFILE    *om;
+  P7_BG          *bg;
+  ESL_RANDOMNESS *r;		/* serial only: sample each seq into <dsq> as it's scored */
+  ESL_DSQ        *dsq;		/* N random seqs of length L, each in its own L+2 slot;
+				 * or the one L+2 slot that <r> samples into           */
+  int             L;
+  int             algo;		/* p7_MMU, p7_VMU, or p7_FTAU: which score to collect  */
+  double         *xv;		/* RETURN: xv[lo..hi-1] bit scores                     */
+  int             lo, hi;
+  int             status;
+} CALIB_SHARE;
+
+static int  msv_mu   (ESL_RANDOMNESS *r, P7_OPROFILE *om, P7_BG *bg, int L, int N, double lambda, int ncpus, double *ret_mmu);
+static int  vit_mu   (ESL_RANDOMNESS *r, P7_OPROFILE *om, P7_BG *bg, int L, int N, double lambda, int ncpus, double *ret_vmu);
+static int  fwd_tau  (ESL_RANDOMNESS *r, P7_OPROFILE *om, P7_BG *bg, int L, int N, double lambda, double tailp, int ncpus, double *ret_tau);
+static int  simulate (ESL_RANDOMNESS *r, P7_OPROFILE *om, P7_BG *bg, int L, int N, int algo, int ncpus, double *xv);
+static int  score_share(CALIB_SHARE *sh);
+#ifdef HMMER_THREADS
+static void score_thread(void *arg);
+#endif
+
 /*****************************************************************
  * 1. p7_Calibrate():  model calibration wrapper 
  *****************************************************************/ 
@@ -30,6 +61,12 @@
  *            one calculation ($\lambda$) and two brief simulations
  *            (Viterbi $\mu$, Forward $\tau$).
  *            
+ *            If <cfg_b->ncpus> is $>0$, the scoring of each
+ *            simulation's random sequences is divided amongst that
+ *            many threads. The sequences are still sampled serially
+ *            from <r>, so the results are identical to a serial
+ *            calibration.
+ *            
  * Args:      hmm     - HMM to be calibrated
  *            cfg_b   - OPTCFG: ptr to optional build configuration;
  *                      if <NULL>, use default parameters.
@@ -69,6 +106,7 @@ p7_Calibrate(P7_HMM *hmm, P7_BUILDER *cfg_b, ESL_RANDOMNESS **byp_rng, P7_BG **b
   int             EfL    = ((cfg_b != NULL) ? cfg_b->EfL    : 100);
   int             EfN    = ((cfg_b != NULL) ? cfg_b->EfN    : 200);
   double          Eft    = ((cfg_b != NULL) ? cfg_b->Eft    : 0.04);
+  int             ncpus  = ((cfg_b != NULL) ? cfg_b->ncpus  : 0);
   double          lambda, mmu, vmu, tau;
   int             status;
   
@@ -102,9 +140,9 @@ p7_Calibrate(P7_HMM *hmm, P7_BUILDER *cfg_b, ESL_RANDOMNESS **byp_rng, P7_BG **b
 
   /* The calibration steps themselves */
   if ((status = p7_Lambda(hmm, bg, &lambda))                          != eslOK) ESL_XFAIL(status,  errbuf, "failed to determine lambda");
-  if ((status = p7_MSVMu    (r, om, bg, EmL, EmN, lambda, &mmu))      != eslOK) ESL_XFAIL(status,  errbuf, "failed to determine msv mu");
-  if ((status = p7_ViterbiMu(r, om, bg, EvL, EvN, lambda, &vmu))      != eslOK) ESL_XFAIL(status,  errbuf, "failed to determine vit mu");
-  if ((status = p7_Tau      (r, om, bg, EfL, EfN, lambda, Eft, &tau)) != eslOK) ESL_XFAIL(status,  errbuf, "failed to determine fwd tau");
+  if ((status = msv_mu (r, om, bg, EmL, EmN, lambda,      ncpus, &mmu)) != eslOK) ESL_XFAIL(status,  errbuf, "failed to determine msv mu");
+  if ((status = vit_mu (r, om, bg, EvL, EvN, lambda,      ncpus, &vmu)) != eslOK) ESL_XFAIL(status,  errbuf, "failed to determine vit mu");
+  if ((status = fwd_tau(r, om, bg, EfL, EfN, lambda, Eft, ncpus, &tau)) != eslOK) ESL_XFAIL(status,  errbuf, "failed to determine fwd tau");
 
   /* Store results */
   hmm->evparam[p7_MLAMBDA] = om->evparam[p7_MLAMBDA] = lambda;
@@ -237,46 +275,7 @@ p7_Lambda(P7_HMM *hmm, P7_BG *bg, double *ret_lambda)
 int
 p7_MSVMu(ESL_RANDOMNESS *r, P7_OPROFILE *om, P7_BG *bg, int L, int N, double lambda, double *ret_mmu)
 {
-  P7_OMX  *ox      = p7_omx_Create(om->M, 0, 0); /* DP matrix: 1 row version */
-  ESL_DSQ *dsq     = NULL;
-  double  *xv      = NULL;
-  int      i;
-  float    sc, nullsc;
-  float    maxsc   = (255 - om->base_b) / om->scale_b; /* if score overflows, use this */
-  int      status;
-
-  if (ox == NULL) { status = eslEMEM; goto ERROR; }
-  ESL_ALLOC(xv,  sizeof(double)  * N);
-  ESL_ALLOC(dsq, sizeof(ESL_DSQ) * (L+2));
-
-  p7_oprofile_ReconfigLength(om, L);
-  p7_bg_SetLength(bg, L);
-
-  for (i = 0; i < N; i++)
-    {
-      if ((status = esl_rsq_xfIID(r, bg->f, om->abc->K, L, dsq)) != eslOK) goto ERROR;
-      if ((status = p7_bg_NullOne(bg, dsq, L, &nullsc))          != eslOK) goto ERROR;   
-
-      status = p7_MSVFilter(dsq, L, om, ox, &sc); 
-      if (status == eslERANGE) { sc = maxsc; status = eslOK; }
-      if (status != eslOK)     goto ERROR;
-
-      xv[i] = (sc - nullsc) / eslCONST_LOG2;
-    }
-
-  if ((status = esl_gumbel_FitCompleteLoc(xv, N, lambda, ret_mmu))  != eslOK) goto ERROR;
-  p7_omx_Destroy(ox);
-  free(xv);
-  free(dsq);
-  return eslOK;
-
- ERROR:
-  *ret_mmu = 0.0;
-  if (ox  != NULL) p7_omx_Destroy(ox);
-  if (xv  != NULL) free(xv);
-  if (dsq != NULL) free(dsq);
-  return status;
-
+  return msv_mu(r, om, bg, L, N, lambda, 0, ret_mmu);
 }
 
 /* Function:  p7_ViterbiMu()
@@ -306,46 +305,7 @@ p7_MSVMu(ESL_RANDOMNESS *r, P7_OPROFILE *om, P7_BG *bg, int L, int N, double lam
 int
 p7_ViterbiMu(ESL_RANDOMNESS *r, P7_OPROFILE *om, P7_BG *bg, int L, int N, double lambda, double *ret_vmu)
 {
-  P7_OMX  *ox      = p7_omx_Create(om->M, 0, 0); /* DP matrix: 1 row version */
-  ESL_DSQ *dsq     = NULL;
-  double  *xv      = NULL;
-  int      i;
-  float    sc, nullsc;
-  float    maxsc   = (32767.0 - om->base_w) / om->scale_w; /* if score overflows, use this [J4/139] */
-  int      status;
-
-  if (ox == NULL) { status = eslEMEM; goto ERROR; }
-  ESL_ALLOC(xv,  sizeof(double)  * N);
-  ESL_ALLOC(dsq, sizeof(ESL_DSQ) * (L+2));
-
-  p7_oprofile_ReconfigLength(om, L);
-  p7_bg_SetLength(bg, L);
-
-  for (i = 0; i < N; i++)
-    {
-      if ((status = esl_rsq_xfIID(r, bg->f, om->abc->K, L, dsq)) != eslOK) goto ERROR;
-      if ((status = p7_bg_NullOne(bg, dsq, L, &nullsc))          != eslOK) goto ERROR;   
-
-      status = p7_ViterbiFilter(dsq, L, om, ox, &sc); 
-      if (status == eslERANGE) { sc = maxsc; status = eslOK; }
-      if (status != eslOK)     goto ERROR;
-
-      xv[i] = (sc - nullsc) / eslCONST_LOG2;
-    }
-
-  if ((status = esl_gumbel_FitCompleteLoc(xv, N, lambda, ret_vmu))  != eslOK) goto ERROR;
-  p7_omx_Destroy(ox);
-  free(xv);
-  free(dsq);
-  return eslOK;
-
- ERROR:
-  *ret_vmu = 0.0;
-  if (ox  != NULL) p7_omx_Destroy(ox);
-  if (xv  != NULL) free(xv);
-  if (dsq != NULL) free(dsq);
-  return status;
-
+  return vit_mu(r, om, bg, L, N, lambda, 0, ret_vmu);
 }
 
 
@@ -411,29 +371,62 @@ p7_ViterbiMu(ESL_RANDOMNESS *r, P7_OPROFILE *om, P7_BG *bg, int L, int N, double
 int
 p7_Tau(ESL_RANDOMNESS *r, P7_OPROFILE *om, P7_BG *bg, int L, int N, double lambda, double tailp, double *ret_tau)
 {
-  P7_OMX  *ox      = p7_omx_Create(om->M, 0, L);     /* DP matrix: for ForwardParser,  L rows */
-  ESL_DSQ *dsq     = NULL;
-  double  *xv      = NULL;
-  float    fsc, nullsc;		                  
-  double   gmu, glam;
+  return fwd_tau(r, om, bg, L, N, lambda, tailp, 0, ret_tau);
+}
+
+
+/* msv_mu(), vit_mu(), fwd_tau()
+ * 
+ * The guts of p7_MSVMu(), p7_ViterbiMu(), p7_Tau(), with the
+ * scoring of the <N> random sequences divided amongst <ncpus>
+ * threads (0 = serial).
+ */
+static int
+msv_mu(ESL_RANDOMNESS *r, P7_OPROFILE *om, P7_BG *bg, int L, int N, double lambda, int ncpus, double *ret_mmu)
+{
+  double  *xv = NULL;
   int      status;
-  int      i;
 
-  ESL_ALLOC(xv,  sizeof(double)  * N);
-  ESL_ALLOC(dsq, sizeof(ESL_DSQ) * (L+2));
-  if (ox == NULL) { status = eslEMEM; goto ERROR; }
+  ESL_ALLOC(xv, sizeof(double) * N);
+  if ((status = simulate(r, om, bg, L, N, p7_MMU, ncpus, xv))      != eslOK) goto ERROR;
+  if ((status = esl_gumbel_FitCompleteLoc(xv, N, lambda, ret_mmu)) != eslOK) goto ERROR;
+  free(xv);
+  return eslOK;
 
-  p7_oprofile_ReconfigLength(om, L);
-  p7_bg_SetLength(bg, L);
+ ERROR:
+  *ret_mmu = 0.0;
+  if (xv != NULL) free(xv);
+  return status;
+}
 
-  for (i = 0; i < N; i++)
-    {
-      if ((status = esl_rsq_xfIID(r, bg->f, om->abc->K, L, dsq)) != eslOK) goto ERROR;
-      if ((status = p7_ForwardParser(dsq, L, om, ox, &fsc))      != eslOK) goto ERROR;
-      if ((status = p7_bg_NullOne(bg, dsq, L, &nullsc))          != eslOK) goto ERROR;   
-      xv[i] = (fsc - nullsc) / eslCONST_LOG2;
-    }
-  if ((status = esl_gumbel_FitComplete(xv, N, &gmu, &glam)) != eslOK) goto ERROR;
+static int
+vit_mu(ESL_RANDOMNESS *r, P7_OPROFILE *om, P7_BG *bg, int L, int N, double lambda, int ncpus, double *ret_vmu)
+{
+  double  *xv = NULL;
+  int      status;
+
+  ESL_ALLOC(xv, sizeof(double) * N);
+  if ((status = simulate(r, om, bg, L, N, p7_VMU, ncpus, xv))      != eslOK) goto ERROR;
+  if ((status = esl_gumbel_FitCompleteLoc(xv, N, lambda, ret_vmu)) != eslOK) goto ERROR;
+  free(xv);
+  return eslOK;
+
+ ERROR:
+  *ret_vmu = 0.0;
+  if (xv != NULL) free(xv);
+  return status;
+}
+
+static int
+fwd_tau(ESL_RANDOMNESS *r, P7_OPROFILE *om, P7_BG *bg, int L, int N, double lambda, double tailp, int ncpus, double *ret_tau)
+{
+  double  *xv = NULL;
+  double   gmu, glam;
+  int      status;
+
+  ESL_ALLOC(xv, sizeof(double) * N);
+  if ((status = simulate(r, om, bg, L, N, p7_FTAU, ncpus, xv)) != eslOK) goto ERROR;
+  if ((status = esl_gumbel_FitComplete(xv, N, &gmu, &glam))    != eslOK) goto ERROR;
 
   /* Explanation of the eqn below: first find the x at which the Gumbel tail
    * mass is predicted to be equal to tailp. Then back up from that x
@@ -441,19 +434,165 @@ p7_Tau(ESL_RANDOMNESS *r, P7_OPROFILE *om, P7_BG *bg, int L, int N, double lambd
    * instead of tailp.
    */
   *ret_tau =  esl_gumbel_invcdf(1.0-tailp, gmu, glam) + (log(tailp) / lambda);
-  
   free(xv);
-  free(dsq);
-  p7_omx_Destroy(ox);
   return eslOK;
 
  ERROR:
   *ret_tau = 0.;
-  if (xv  != NULL) free(xv);
+  if (xv != NULL) free(xv);
+  return status;
+}
+
+
+/* simulate()
+ * 
+ * Sample <N> iid random sequences of length <L> from the background
+ * composition of <bg>, using <r>; score each with <om> by the fast
+ * algorithm for evalue parameter <algo> (<p7_MMU>: MSV filter;
+ * <p7_VMU>: Viterbi filter; <p7_FTAU>: Forward parser); and return
+ * their null-corrected bit scores in <xv[0..N-1]>.
+ * 
+ * Serially (<ncpus> 0, or not threaded), each sequence is sampled
+ * and scored in turn, in one L+2 buffer. Threaded, all the sequences
+ * are sampled first, in order, so <r> is used exactly as the serial
+ * loop would use it; then the scoring is divided into <ncpus> shares.
+ * 
+ * Changes the length configuration of <om> and <bg> to <L>.
+ */
+static int
+simulate(ESL_RANDOMNESS *r, P7_OPROFILE *om, P7_BG *bg, int L, int N, int algo, int ncpus, double *xv)
+{
+  CALIB_SHARE *sh      = NULL;
+  ESL_DSQ     *dsq     = NULL;
+  int          nshares = 1;
+#ifdef HMMER_THREADS
+  ESL_THREADS *threadObj = NULL;
+#endif
+  int          i, t;
+  int          status;
+
+#ifdef HMMER_THREADS
+  nshares = ESL_MAX(1, ESL_MIN(ncpus, N));
+#endif
+  ESL_ALLOC(dsq, sizeof(ESL_DSQ) * (L+2) * (nshares == 1 ? 1 : N));
+  ESL_ALLOC(sh,  sizeof(CALIB_SHARE) * nshares);
+
+  p7_oprofile_ReconfigLength(om, L);
+  p7_bg_SetLength(bg, L);
+
+  if (nshares > 1)
+    for (i = 0; i < N; i++)
+      if ((status = esl_rsq_xfIID(r, bg->f, om->abc->K, L, dsq + (int64_t) i * (L+2))) != eslOK) goto ERROR;
+
+  for (t = 0; t < nshares; t++)
+    {
+      sh[t].om     = om;
+      sh[t].bg     = bg;
+      sh[t].r      = (nshares == 1 ? r : NULL);
+      sh[t].dsq    = dsq;
+      sh[t].L      = L;
+      sh[t].algo   = algo;
+      sh[t].xv     = xv;
+      sh[t].lo     = (int) ((int64_t) N * t     / nshares);
+      sh[t].hi     = (int) ((int64_t) N * (t+1) / nshares);
+      sh[t].status = eslOK;
+    }
+
+  if (nshares == 1) score_share(&sh[0]);
+#ifdef HMMER_THREADS
+  else
+    {
+      if ((threadObj = esl_threads_Create(&score_thread)) == NULL) { status = eslEMEM; goto ERROR; }
+      for (t = 0; t < nshares; t++) esl_threads_AddThread(threadObj, &sh[t]);
+      esl_threads_WaitForStart (threadObj);
+      esl_threads_WaitForFinish(threadObj);
+      esl_threads_Destroy(threadObj);
+    }
+#endif
+
+  status = eslOK;
+  for (t = 0; t < nshares; t++)
+    if (sh[t].status != eslOK) { status = sh[t].status; break; }
+
+ ERROR:
+  if (sh  != NULL) free(sh);
   if (dsq != NULL) free(dsq);
-  if (ox  != NULL) p7_omx_Destroy(ox);
   return status;
 }
+
+
+/* score_share()
+ * 
+ * Score the random sequences <sh->lo..hi-1>, storing bit scores in
+ * <sh->xv[]>. A filter score that overflows is set to the filter's
+ * maximum score [J4/139].
+ */
+static int
+score_share(CALIB_SHARE *sh)
+{
+  P7_OPROFILE *om    = sh->om;
+  int          L     = sh->L;
+  P7_OMX      *ox    = p7_omx_Create(om->M, 0, (sh->algo == p7_FTAU ? L : 0)); /* ForwardParser needs L rows; filters, 1 */
+  ESL_DSQ     *dsq;
+  float        maxsc = (sh->algo == p7_MMU ? (255 - om->base_b) / om->scale_b : (32767.0 - om->base_w) / om->scale_w);
+  float        sc, nullsc;
+  int          i;
+  int          status;
+
+  if (ox == NULL) { status = eslEMEM; goto ERROR; }
+
+  for (i = sh->lo; i < sh->hi; i++)
+    {
+      if (sh->r) {
+	dsq = sh->dsq;
+	if ((status = esl_rsq_xfIID(sh->r, sh->bg->f, om->abc->K, L, dsq)) != eslOK) goto ERROR;
+      }
+      else dsq = sh->dsq + (int64_t) i * (L+2);
+
+      if ((status = p7_bg_NullOne(sh->bg, dsq, L, &nullsc)) != eslOK) goto ERROR;   
+
+      switch (sh->algo) {
+      case p7_MMU:  status = p7_MSVFilter    (dsq, L, om, ox, &sc); break;
+      case p7_VMU:  status = p7_ViterbiFilter(dsq, L, om, ox, &sc); break;
+      default:      status = p7_ForwardParser(dsq, L, om, ox, &sc); break;
+      }
+      if (status == eslERANGE && sh->algo != p7_FTAU) { sc = maxsc; status = eslOK; }
+      if (status != eslOK)     goto ERROR;
+
+      sh->xv[i] = (sc - nullsc) / eslCONST_LOG2;
+    }
+  status = eslOK;
+
+ ERROR:
+  if (ox != NULL) p7_omx_Destroy(ox);
+  sh->status = status;
+  return status;
+}
+
+
+#ifdef HMMER_THREADS
+/* score_thread()
+ * A worker thread: scores one share of a calibration simulation.
+ */
+static void 
+score_thread(void *arg)
+{
+  int          workeridx;
+  CALIB_SHARE *sh;
+  ESL_THREADS *obj;
+
+  impl_Init();
+
+  obj = (ESL_THREADS *) arg;
+  esl_threads_Started(obj, &workeridx);
+
+  sh = (CALIB_SHARE *) esl_threads_GetData(obj, workeridx);
+  score_share(sh);
+
+  esl_threads_Finished(obj, workeridx);
+  return;
+}
+#endif /*HMMER_THREADS*/
 /*-------------- end, determining individual parameters ---------*/
 
 
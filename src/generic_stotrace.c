@@ -2,10 +2,11 @@
  * 
  * Contents:
  *   1. Stochastic traceback implementation.
- *   2. Benchmark driver.
- *   3. Unit tests.
- *   4. Test driver.
- *   5. Example.
+ *   2. P7_STOCACHE: tables shared by repeated tracebacks.
+ *   3. Benchmark driver.
+ *   4. Unit tests.
+ *   5. Test driver.
+ *   6. Example.
  *
  * SRE, Fri Aug 15 10:50:55 2008 [Janelia]
  */
@@ -190,11 +191,122 @@ p7_GStochasticTrace(ESL_RANDOMNESS *r, const ESL_DSQ *dsq, int L, const P7_PROFI
 /*------------------- end, stochastic trace ---------------------*/
 
 
+/*****************************************************************
+ * 2. P7_STOCACHE: tables shared by repeated tracebacks.
+ *****************************************************************/
+
+/* Function:  p7_stocache_Create()
+ * Synopsis:  Create a <P7_STOCACHE> for a matrix of up to <L> rows.
+ *
+ * Purpose:   Create a cache of selection tables for sampling
+ *            tracebacks from a DP matrix for a sequence of length
+ *            up to <L>; it is grown as needed by the traceback
+ *            routines. Tables themselves are built on demand, by the
+ *            vector implementation's <p7_StochasticTraceCached()>.
+ *
+ * Returns:   a pointer to the new object.
+ *
+ * Throws:    <NULL> on allocation failure.
+ */
+P7_STOCACHE *
+p7_stocache_Create(int L)
+{
+  P7_STOCACHE *stc = NULL;
+  int          status;
+
+  ESL_ALLOC(stc, sizeof(P7_STOCACHE));
+  stc->ecum   = NULL;
+  stc->nsel   = NULL;
+  stc->ncells = 0;
+  stc->L      = 0;
+  stc->Lalloc = 0;
+
+  if (p7_stocache_GrowTo(stc, L) != eslOK) goto ERROR;
+  return stc;
+
+ ERROR:
+  p7_stocache_Destroy(stc);
+  return NULL;
+}
+
+/* Function:  p7_stocache_GrowTo()
+ * Synopsis:  Make room for a matrix of <L> rows in a <P7_STOCACHE>.
+ *
+ * Purpose:   Reallocate <stc> if necessary to hold tables for rows
+ *            <0..L>, and set <stc->L> to <L>. Any tables already
+ *            built are kept.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ */
+int
+p7_stocache_GrowTo(P7_STOCACHE *stc, int L)
+{
+  int   i;
+  void *p;
+  int   status;
+
+  if (L+1 > stc->Lalloc)
+    {
+      ESL_RALLOC(stc->ecum, p, sizeof(double *) * (L+1));
+      ESL_RALLOC(stc->nsel, p, sizeof(int)      * (L+1));
+      for (i = stc->Lalloc; i <= L; i++) { stc->ecum[i] = NULL; stc->nsel[i] = 0; }
+      stc->Lalloc = L+1;
+    }
+  stc->L = ESL_MAX(stc->L, L);
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+
+/* Function:  p7_stocache_Reuse()
+ * Synopsis:  Invalidate all tables in a <P7_STOCACHE>.
+ *
+ * Purpose:   Free the tables in <stc>, so it can be used with a new
+ *            DP matrix.
+ *
+ * Returns:   <eslOK> on success.
+ */
+int
+p7_stocache_Reuse(P7_STOCACHE *stc)
+{
+  int i;
+
+  for (i = 0; i <= stc->L && i < stc->Lalloc; i++)
+    {
+      if (stc->ecum[i] != NULL) { free(stc->ecum[i]); stc->ecum[i] = NULL; }
+      stc->nsel[i] = 0;
+    }
+  stc->ncells = 0;
+  stc->L      = 0;
+  return eslOK;
+}
+
+/* Function:  p7_stocache_Destroy()
+ * Synopsis:  Frees a <P7_STOCACHE>.
+ */
+void
+p7_stocache_Destroy(P7_STOCACHE *stc)
+{
+  if (stc == NULL) return;
+  if (stc->ecum != NULL)
+    {
+      p7_stocache_Reuse(stc);
+      free(stc->ecum);
+    }
+  if (stc->nsel != NULL) free(stc->nsel);
+  free(stc);
+}
+/*------------------- end, P7_STOCACHE --------------------------*/
+
+
 
 
 
 /*****************************************************************
- * 2. Benchmark driver
+ * 3. Benchmark driver
  *****************************************************************/
 #ifdef p7GENERIC_STOTRACE_BENCHMARK
 /*
@@ -294,7 +406,7 @@ main(int argc, char **argv)
 
 
 /*****************************************************************
- * 3. Unit tests
+ * 4. Unit tests
  *****************************************************************/
 #ifdef p7GENERIC_STOTRACE_TESTDRIVE
 #include "esl_getopts.h"
@@ -338,7 +450,7 @@ utest_stotrace(ESL_GETOPTS *go, ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_PROFILE
 
 
 /*****************************************************************
- * 4. Test driver
+ * 5. Test driver
  *****************************************************************/
 #ifdef p7GENERIC_STOTRACE_TESTDRIVE
 /* gcc -g -Wall -Dp7GENERIC_STOTRACE_TESTDRIVE -I. -I../easel -L. -L../easel -o generic_stotrace_utest generic_stotrace.c -lhmmer -leasel -lm
@@ -410,7 +522,7 @@ main(int argc, char **argv)
 
 
 /*****************************************************************
- * 5. Example
+ * 6. Example
  *****************************************************************/
 #ifdef p7GENERIC_STOTRACE_EXAMPLE
 /* 
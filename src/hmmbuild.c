@@ -140,6 +140,7 @@ static ESL_OPTIONS options[] = {
   { "--w_beta",   eslARG_REAL,       NULL, NULL, NULL,    NULL,     NULL,    NULL, "tail mass at which window length is determined",        8 },
   { "--w_length", eslARG_INT,        NULL, NULL, NULL,    NULL,     NULL,    NULL, "window length ",                                        8 },
   { "--maxinsertlen",  eslARG_INT,   NULL, NULL, "n>=5",  NULL,     NULL,    NULL, "pretend all inserts are length <= <n>",   8 },
+  { "--clustcols",     eslARG_INT,   NULL, NULL, "n>0",   NULL,     NULL,    NULL, "for --eclust, --wblosum: cluster on <n> sampled columns", 8 },
 
   /*Expert-only option, hidden from view. Likely to be removed in the future.
     This is an experimental alternative method for weighting sequence counts.
@@ -184,6 +185,8 @@ struct cfg_s {
   FILE         *postmsafp;	/* open <postmsafile>, or NULL */
 
   int           nali;		/* which # alignment this is in file (only valid in serial mode)   */
+  ESL_MSA      *ahead[2];	/* alignments read ahead of time by the master, not yet built      */
+  int           nahead;		/* how many of them                                                 */
   int           nnamed;		/* number of alignments that had their own names */
 
   int           do_mpi;		/* TRUE if we're doing MPI parallelization */
@@ -198,6 +201,7 @@ static char banner[] = "profile HMM construction from multiple sequence alignmen
 
 static int  usual_master(const ESL_GETOPTS *go, struct cfg_s *cfg);
 static void serial_loop  (WORKER_INFO *info, struct cfg_s *cfg, const ESL_GETOPTS *go);
+static int  read_msa     (struct cfg_s *cfg, ESL_MSA **ret_msa);
 #ifdef HMMER_THREADS
 static void thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, struct cfg_s *cfg, const ESL_GETOPTS *go);
 static void pipeline_thread(void *arg);
@@ -347,6 +351,7 @@ output_header(const ESL_GETOPTS *go, const struct cfg_s *cfg)
   if (esl_opt_IsUsed(go, "--mx")         && fprintf(cfg->ofp, "# subst score matrix (built-in):    %s\n",         esl_opt_GetString (go, "--mx"))      < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--mxfile")     && fprintf(cfg->ofp, "# subst score matrix (file):        %s\n",         esl_opt_GetString (go, "--mxfile"))  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--maxinsertlen")  && fprintf(cfg->ofp, "# max insert length:                %d\n",         esl_opt_GetInteger (go, "--maxinsertlen"))  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--clustcols")     && fprintf(cfg->ofp, "# columns sampled for clustering:   %d\n",         esl_opt_GetInteger (go, "--clustcols"))     < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 
 
 #ifdef HMMER_THREADS
@@ -428,6 +433,9 @@ main(int argc, char **argv)
 
   cfg.nali       = 0;		           /* this counter is incremented in masters */
   cfg.nnamed     = 0;		           /* 0 or 1 if a single MSA; == nali if multiple MSAs */
+  cfg.ahead[0]   = NULL;
+  cfg.ahead[1]   = NULL;
+  cfg.nahead     = 0;
   cfg.do_mpi     = FALSE;	           /* this gets reset below, if we init MPI */
   cfg.nproc      = 0;		           /* this gets reset below, if we init MPI */
   cfg.my_rank    = 0;		           /* this gets reset below, if we init MPI */
@@ -504,6 +512,7 @@ static int
 usual_master(const ESL_GETOPTS *go, struct cfg_s *cfg)
 {
   int              ncpus    = 0;
+  int              bldcpus  = 0;	/* threads inside each p7_Builder(): used for a single alignment */
   int              infocnt  = 0;
   WORKER_INFO     *info     = NULL;
 #ifdef HMMER_THREADS
@@ -558,6 +567,20 @@ usual_master(const ESL_GETOPTS *go, struct cfg_s *cfg)
 #ifdef HMMER_THREADS
   /* initialize thread data */
   ncpus = ESL_MIN(esl_opt_GetInteger(go, "--cpu"), esl_threads_GetCPUCount());
+
+  /* Threads build different alignments in parallel; with only one
+   * alignment, that leaves all but one idle. Read ahead to see if
+   * there's more than one. If not, build serially, and give the
+   * threads to the builder to use inside model construction instead.
+   */
+  if (ncpus > 0)
+    {
+      status = eslOK;
+      while (cfg->nahead < 2 && (status = esl_msafile_Read(cfg->afp, &(cfg->ahead[cfg->nahead]))) == eslOK) cfg->nahead++;
+      if (status != eslOK && status != eslEOF) esl_msafile_ReadFailure(cfg->afp, status);
+      if (cfg->nahead < 2) { bldcpus = ncpus; ncpus = 0; }
+    }
+
   if (ncpus > 0)
     {
       threadObj = esl_threads_Create(&pipeline_thread);
@@ -576,6 +599,7 @@ usual_master(const ESL_GETOPTS *go, struct cfg_s *cfg)
       info[i].bld = p7_builder_Create(go, cfg->abc);
 
       if (info[i].bld == NULL)  p7_Fail("p7_builder_Create failed");
+      info[i].bld->ncpus = bldcpus;
 
 
 
@@ -583,6 +607,8 @@ usual_master(const ESL_GETOPTS *go, struct cfg_s *cfg)
 
       if ( esl_opt_IsOn(go, "--maxinsertlen") )
         info[i].bld->max_insert_len    = esl_opt_GetInteger(go, "--maxinsertlen");
+      if ( esl_opt_IsOn(go, "--clustcols") )
+        info[i].bld->clustcols         = esl_opt_GetInteger(go, "--clustcols");
 
       if( !esl_opt_GetBoolean(go, "--pnone") && !esl_opt_GetBoolean(go, "--plaplace") )
       {
@@ -1056,7 +1082,7 @@ serial_loop(WORKER_INFO *info, struct cfg_s *cfg, const ESL_GETOPTS *go)
   double      entropy;
 
   cfg->nali = 0;
-  while ((status = esl_msafile_Read(cfg->afp, &msa)) != eslEOF)
+  while ((status = read_msa(cfg, &msa)) != eslEOF)
     {
       if (status != eslOK) esl_msafile_ReadFailure(cfg->afp, status);
       cfg->nali++;  
@@ -1090,6 +1116,24 @@ serial_loop(WORKER_INFO *info, struct cfg_s *cfg, const ESL_GETOPTS *go)
     }
 }
 
+/* read_msa()
+ * Get the next alignment: one the master already read ahead, if
+ * any; else the next one in the file. Same returns as esl_msafile_Read().
+ */
+static int
+read_msa(struct cfg_s *cfg, ESL_MSA **ret_msa)
+{
+  if (cfg->nahead > 0)
+    {
+      *ret_msa      = cfg->ahead[0];
+      cfg->ahead[0] = cfg->ahead[1];
+      cfg->ahead[1] = NULL;
+      cfg->nahead--;
+      return eslOK;
+    }
+  return esl_msafile_Read(cfg->afp, ret_msa);
+}
+
 #ifdef HMMER_THREADS
 static void
 thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, struct cfg_s *cfg, const ESL_GETOPTS *go)
@@ -1116,7 +1160,7 @@ thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, struct cfg_s *cfg, const ES
   /* Main loop: */
   item = (WORK_ITEM *) newItem;
   while (sstatus == eslOK) {
-    sstatus = esl_msafile_Read(cfg->afp, &item->msa);
+    sstatus = read_msa(cfg, &item->msa);
     if (sstatus == eslOK) {
       item->nali = ++cfg->nali;
       if (set_msa_name(cfg, errmsg, item->msa) != eslOK) p7_Fail("%s\n", errmsg);
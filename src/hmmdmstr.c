@@ -992,6 +992,8 @@ forward_results(QUEUE_DATA *query, SEARCH_RESULTS *results)
     qsort(hits, results->stats.nhits, sizeof(P7_HIT), hit_sorter);
 
     th.unsrt     = NULL;
+    th.arena     = NULL;
+    th.maxhits   = 0;
     th.N         = results->stats.nhits;
     th.nreported = 0;
     th.nincluded = 0;
@@ -88,6 +88,8 @@ static ESL_OPTIONS searchOpts[] = {
   /* Other options */
   { "--seed",       eslARG_INT,        "42", NULL, "n>=0",    NULL,  NULL, NULL,        "set RNG seed to <n> (if 0: one-time arbitrary seed)",         12 },
   { "--nonull2",    eslARG_NONE,       NULL, NULL, NULL,      NULL,  NULL, NULL,        "turn off biased composition score corrections",               12 },
+  { "--nosample",   eslARG_NONE,       NULL, NULL, NULL,      NULL,  NULL, NULL,        "split domains by posterior decoding, not sampling",           12 },
+  { "--stagestats", eslARG_NONE,       NULL, NULL, NULL,      NULL,  NULL, NULL,        "time each pipeline stage, and count its DP cells",            12 },
   { "-Z",           eslARG_REAL,      FALSE, NULL, "x>0",     NULL,  NULL, NULL,        "set # of comparisons done, for E-value calculation",          12 },
   { "--domZ",       eslARG_REAL,      FALSE, NULL, "x>0",     NULL,  NULL, NULL,        "set # of significant seqs, for domain E-value calculation",   12 },
   { "--hmmdb",      eslARG_INT,         NULL,  NULL, "n>0",   NULL,  NULL,  "--seqdb",       "hmm database to search",                                      12 },
@@ -42,6 +42,7 @@
 #include "esl_alphabet.h"	/* ESL_DSQ, ESL_ALPHABET */
 #include "esl_dirichlet.h"	/* ESL_MIXDCHLET         */
 #include "esl_dmatrix.h"	/* ESL_DMATRIX           */
+#include "esl_gencode.h"	/* ESL_GENCODE           */
 #include "esl_getopts.h"	/* ESL_GETOPTS           */
 #include "esl_histogram.h"      /* ESL_HISTOGRAM         */
 #include "esl_hmm.h"	        /* ESL_HMM               */
@@ -560,6 +561,24 @@ typedef struct p7_spensemble_s {
   int                  nsigc_alloc; /* current allocated max for nsigc                      */
 } P7_SPENSEMBLE;
 
+/* Structure: P7_STOCACHE
+ *
+ * Tables shared by many stochastic tracebacks of the same Forward
+ * matrix. Sampling a predecessor of E(i) means a scan over all M,D
+ * cells of row i; when the same row is sampled again, the scan is
+ * replaced by a binary search of the cumulative probabilities,
+ * which are stored in the vector implementation's own cell order so
+ * the choice is bit-identical to the scan. Tables are only valid for
+ * one matrix: Reuse() the cache whenever the matrix changes.
+ */
+typedef struct p7_stocache_s {
+  double **ecum;		    /* ecum[i] = cumulative E(i) predecessor probs; NULL if not built, [0..L] */
+  int     *nsel;		    /* nsel[i] = # of times E(i) has been sampled since Reuse()            */
+  int      ncells;		    /* # of cells in each ecum[i] row; set by the vector implementation     */
+  int      L;			    /* rows 0..L are in use                                                 */
+  int      Lalloc;		    /* allocated # of rows; Lalloc >= L+1                                   */
+} P7_STOCACHE;
+
 
 
 /*****************************************************************
@@ -622,8 +641,59 @@ typedef struct p7_dom_s {
   int            is_included;	/* TRUE if domain meets inclusion thresholds                                  */
   float         *scores_per_pos; /* score in BITS that each position in the alignment contributes to an overall viterbi score */
   P7_ALIDISPLAY *ad; 
+  ESL_DSQ       *envdsq;        /* if alignment is deferred (<ad> NULL): envelope's residues as envdsq[1..jenv-ienv+1]; else NULL */
+  int64_t        L;		/* length of the target sequence                                                               */
 } P7_DOMAIN;
 
+/* Structure: P7_STAGESTATS
+ *
+ * Optional per-stage instrumentation of the acceleration pipeline and
+ * of domain definition (--stagestats): elapsed nanoseconds and DP
+ * cells (M x L for each DP pass) spent in each stage. A P7_PIPELINE
+ * owns one and points its P7_DOMAINDEF at it; see p7_pipeline.c.
+ */
+enum p7_stages_e { p7_STAGE_MSV        = 0,	/* MSV filter; and SSV, in long target pipeline      */
+		   p7_STAGE_BIAS       = 1,	/* bias filter; cells = residues                     */
+		   p7_STAGE_VIT        = 2,	/* Viterbi filter                                    */
+		   p7_STAGE_FWD        = 3,	/* Forward parser; and region, envelope Forward      */
+		   p7_STAGE_BCK        = 4,	/* Backward parser; and region, envelope Backward    */
+		   p7_STAGE_DECODING   = 5,	/* domain and posterior decoding                     */
+		   p7_STAGE_STOCLUST   = 6,	/* stochastic traceback clustering; cells = samples x L */
+		   p7_STAGE_NULL2      = 7,	/* null2 by expectation; long target domcorrection   */
+		   p7_STAGE_ALIGN      = 8 };	/* optimal accuracy alignment, trace, and display    */
+#define p7_NSTAGES 9
+
+typedef struct p7_stagestats_s {
+  uint64_t ns[p7_NSTAGES];	/* elapsed time in each stage, summed over threads (nanoseconds) */
+  uint64_t cells[p7_NSTAGES];	/* DP cells computed in each stage                              */
+} P7_STAGESTATS;
+
+/* Time one stage <s> on <st>, if <st> is non-NULL; <t0> is caller's uint64_t.  */
+#define p7_STAGE_START(st, t0)            do { if (st) (t0) = p7_stagestats_Clock(); } while (0)
+#define p7_STAGE_STOP(st, s, t0, ncells)  do { if (st) { (st)->ns[s] += p7_stagestats_Clock() - (t0); (st)->cells[s] += (ncells); } } while (0)
+
+
+/* Structure: P7_ENVELOPE
+ *
+ * An envelope i..j that domain definition has called on the target,
+ * queued for rescoring (Forward, null2, and OA alignment), and the
+ * domain that rescoring yields. Envelopes are defined for a whole
+ * target before any is rescored, so they can be rescored
+ * independently; see <P7_DOMAINPOOL>.
+ */
+typedef struct p7_envelope_s {
+  int        i, j;		/* envelope coords on the target, 1..L                           */
+  int        null2_is_done;	/* TRUE if n2sc[i..j] was already set by stochastic clustering    */
+  int        do_align;		/* TRUE to build the OA alignment now; FALSE to defer it          */
+  int        status;		/* after rescoring: eslOK if <dom> is a domain, else eslFAIL      */
+  P7_DOMAIN  dom;
+} P7_ENVELOPE;
+
+/* P7_DOMAINPOOL is a set of helper threads that rescore envelopes for
+ * any number of P7_DOMAINDEFs. Its contents are private to p7_domaindef.c.
+ */
+typedef struct p7_domainpool_s P7_DOMAINPOOL;
+
 /* Structure: P7_DOMAINDEF
  * 
  * This is a container for all the necessary information for domain
@@ -654,6 +724,7 @@ typedef struct p7_domaindef_s {
   P7_SPENSEMBLE  *sp;		/* an ensemble of sampled segment pairs (domain endpoints) */
   P7_TRACE       *tr;		/* reusable space for a trace of a domain                  */
   P7_TRACE       *gtr;		/* reusable space for a traceback of the entire target seq */
+  P7_STOCACHE    *stc;		/* selection tables shared by the traces of one region     */
 
   /* Heuristic thresholds that control the region definition process */
   /* "rt" = "region threshold", for lack of better term  */
@@ -668,6 +739,8 @@ typedef struct p7_domaindef_s {
   int    max_diagdiff;	/* 4 means either start or endpoints of two segments must be within <=4 diagonals of each other */
   float  min_posterior;	/* 0.25 means a cluster must have >= 25% posterior prob in the sample to be reported            */
   float  min_endpointp;	/* 0.02 means choose widest endpoint with post prob of at least 2%                              */
+  int    do_sampling;	/* TRUE to split multidomain regions by clustering sampled traces; FALSE: by posterior decoding */
+  int    do_alignment;	/* TRUE to align every domain; FALSE to let the caller align reported ones later (see p7_tophits_AlignDomains()) */
 
   /* storage of the results; domain locations, scores, alignments          */
   P7_DOMAIN *dcl;
@@ -681,6 +754,14 @@ typedef struct p7_domaindef_s {
   int    noverlaps;	/* number of envelopes defined in ensemble clustering that overlap w/ prev envelope */
   int    nenvelopes;	/* number of envelopes handed over for domain definition, null2, alignment, and scoring. */
 
+  /* envelopes awaiting rescoring, in order of definition; and (optionally) threads to rescore them */
+  P7_ENVELOPE   *env;
+  int            nenv;
+  int            envalloc;
+  P7_DOMAINPOOL *pool;		/* shared helper threads, or NULL to rescore serially; not owned by <ddef> */
+
+  P7_STAGESTATS *stats;		/* per-stage timing (--stagestats), or NULL; not owned by <ddef> */
+  struct p7_arena_s *arena;	/* alignment displays are made in this arena, if non-NULL, and belong to it; not owned by <ddef> */
 } P7_DOMAINDEF;
 
 
@@ -740,6 +821,27 @@ typedef struct p7_hit_s {
 } P7_HIT;
 
 
+/* Structure: P7_ARENA
+ * Bump allocator for memory that is all freed at once; a P7_TOPHITS
+ * list allocates its hits' names, domains, and alignment displays
+ * from one.
+ */
+typedef struct p7_arena_s {
+  char   **blk;		/* memory blocks; blk[nblk-1] is the one being carved from */
+  size_t  *blksize;	/* size of each block, in bytes                            */
+  int      nblk;	/* number of blocks                                        */
+  int      nblkalloc;	/* allocated size of blk[], blksize[]                      */
+  size_t   used;	/* bytes used in current block blk[nblk-1]                 */
+  size_t   minblock;	/* size of first block                                     */
+} P7_ARENA;
+
+/* A position in a P7_ARENA, recorded by p7_arena_Mark() */
+typedef struct p7_arenamark_s {
+  int     nblk;
+  size_t  used;
+} P7_ARENAMARK;
+
+
 /* Structure: P7_TOPHITS
  * merging when we prepare to output results. "hit" list is NULL and
  * unavailable until after we do a sort.  
@@ -753,6 +855,13 @@ typedef struct p7_tophits_s {
   uint64_t nincluded;	/* number of hits that are includable       */
   int      is_sorted_by_sortkey; /* TRUE when hits sorted by sortkey and th->hit valid for all N hits */
   int      is_sorted_by_seqidx; /* TRUE when hits sorted by seq_idx, position, and th->hit valid for all N hits */
+  P7_ARENA *arena;      /* hit names, domains, alignment displays; or NULL if all malloc'ed */
+
+  uint64_t  maxhits;    /* if >0, "top-K" mode: keep only the <maxhits> best hits    */
+  uint64_t *heap;       /* top-K: unsrt[] indices in a heap, worst kept hit on top   */
+  uint64_t  nheap;      /* top-K: # of hits in heap[]; N-nheap is 0, or 1 new hit   */
+  uint64_t  ndropped;   /* top-K: # of hits dropped from the list                   */
+  uint64_t  nevicted;   /* top-K: # dropped since arena was last compacted          */
 } P7_TOPHITS;
 
 
@@ -797,7 +906,7 @@ typedef struct p7_scoredata_s {
 
 typedef struct p7_hmm_window_s {
   float      score;
-  float      null_sc;
+  float      null_sc;     //filter score of the window, for p7_ViterbiFilter_longtarget_windows()
   int32_t    id;          //sequence id of the database sequence hit
   int64_t    n;           //position in database sequence at which the diagonal/window starts
   int64_t    fm_n;        //position in the concatenated fm-index sequence at which the diagonal starts
@@ -1235,12 +1344,15 @@ typedef struct p7_pipeline_s {
   uint64_t      pos_past_vit;	/* # positions that pass ViterbiFilter()  (used for nhmmer) */
   uint64_t      pos_past_fwd;	/* # positions that pass ForwardFilter()  (used for nhmmer) */
   uint64_t      pos_output;	    /* # positions that make it to the final output (used for nhmmer) */
+  int           do_stagestats;  /* TRUE to time each stage (--stagestats)   */
+  P7_STAGESTATS stats;          /* per-stage times and DP cells, if so      */
 
   enum p7_pipemodes_e mode;    	/* p7_SCAN_MODELS | p7_SEARCH_SEQS          */
   int           long_targets;   /* TRUE if the target sequences are expected to be very long (e.g. dna chromosome search in nhmmer) */
   int           strands;         /*  p7_STRAND_TOPONLY  | p7_STRAND_BOTTOMONLY |  p7_STRAND_BOTH */
   int 		    	W;              /* window length for nhmmer scan - essentially maximum length of model that we expect to find*/
   int           block_length;   /* length of overlapping blocks read in the multi-threaded variant (default MAX_RESIDUE_COUNT) */
+  int           curL;           /* target length <om>,<bg> are configured for by p7_pli_SetTargetLength(); -1 if unknown */
 
   int           show_accessions;/* TRUE to output accessions not names      */
   int           show_alignments;/* TRUE to output alignments (default)      */
@@ -1250,6 +1362,73 @@ typedef struct p7_pipeline_s {
 } P7_PIPELINE;
 
 
+/* Structure: P7_PROGRESS
+ * Periodic machine-readable progress records (--progress) for one
+ * pass over a target database, written as JSON lines by the thread
+ * that reads the targets; see p7_pipeline.c.
+ */
+typedef struct p7_progress_s {
+  FILE         *ofp;		/* JSON lines output stream (not owned)                 */
+  const char   *progname;	/* program name, for each record (not owned)            */
+  const char   *qname;		/* current query name, or NULL (not owned)              */
+  uint64_t      interval;	/* nanoseconds between records                          */
+  int64_t       dbsize;		/* size of target file in bytes; 0 if unknown           */
+  uint64_t      nseqs;		/* targets read so far in this pass                     */
+  uint64_t      nres;		/* residues read so far in this pass                    */
+  uint64_t      t0;		/* p7_stagestats_Clock() at start of pass               */
+  uint64_t      tnext;		/* clock time when the next record is due               */
+} P7_PROGRESS;
+
+
+/* Structure: P7_HITFILE
+ * An open binary hit file (--hitout), read one query's hit list at a
+ * time by p7_hitfile_Read(). See p7_hitfile.c for the file format.
+ */
+typedef struct p7_hitfile_s {
+  FILE     *f;			/* stream we're reading from                           */
+  char     *fname;		/* name of the file; [STDIN] if -                      */
+  int       do_stdin;		/* TRUE if f is stdin (won't close f)                  */
+
+  /* The query whose hit list was read last:                                           */
+  char     *qname;		/* query name                                          */
+  char     *qacc;		/* query accession; or NULL                            */
+  enum p7_pipemodes_e mode;	/* p7_SEARCH_SEQS | p7_SCAN_MODELS                     */
+  int       long_targets;	/* TRUE for nhmmer's long target hit lists             */
+  double    Z;			/* eff # targs searched (per-target E-val)             */
+  double    domZ;		/* eff # signific targs (per-domain E-val)             */
+  uint64_t  nqueries;		/* # of query hit lists read so far                    */
+
+  /* The file's tail, once read: program, version, mode, query file,                   */
+  /* target file, option settings, current dir, date.                                  */
+  int       has_tail;
+  char     *tail[8];
+
+  char      errbuf[eslERRBUFSIZE];
+} P7_HITFILE;
+
+
+/* Structure: P7_ORFSCAN
+ * Steps through the open reading frames of a DNA target sequence,
+ * translating them one at a time for a translated search
+ * (hmmsearcht). See p7_orfscan.c.
+ */
+typedef struct p7_orfscan_s {
+  const ESL_GENCODE *gcode;	/* genetic code to translate with                      */
+  int       minlen;		/* skip ORFs shorter than this many aa                 */
+  int       require_init;	/* TRUE if ORFs must start with an initiation codon    */
+  int       do_watson;		/* TRUE to translate the given strand                  */
+  int       do_crick;		/* TRUE to translate the reverse complement            */
+  ESL_DSQ   met;		/* digital Met, for translating initiation codons      */
+
+  /* The DNA sequence being scanned, and where we are in it:                           */
+  const ESL_SQ *ntsq;		/* DNA sequence; or NULL                               */
+  int       strand;		/* 0 = given strand, 1 = reverse complement            */
+  int       frame;		/* 0..2                                                */
+  int64_t   c;			/* next codon to look at in this strand, frame: 0..    */
+  int64_t   norf;		/* # of ORFs returned for <ntsq> so far                */
+} P7_ORFSCAN;
+
+
 
 /*****************************************************************
  * 17. P7_BUILDER: pipeline for new HMM construction
@@ -1295,12 +1474,18 @@ typedef struct p7_builder_s {
   P7_PRIOR            *prior;	         /* choice of prior when parameterizing from counts        */
   int                  max_insert_len;
 
+  /* Single linkage clustering for --eclust, --wblosum                                             */
+  int                  clustcols;        /* 0 = exact; else # of columns sampled for clustering    */
+
   /* Optional: information used for parameterizing single sequence queries                         */
   ESL_SCOREMATRIX     *S;		 /* residue score matrix                                   */
   ESL_DMATRIX         *Q;	         /* Q->mx[a][b] = P(b|a) residue probabilities             */
   double               popen;         	 /* gap open probability                                   */
   double               pextend;          /* gap extend probability                                 */
 
+  /* Parallelization of the stages inside one model construction                                  */
+  int                  ncpus;            /* # of worker threads for one build; 0 = serial          */
+
   double               w_beta;    /*beta value used to compute W (window length)   */
   int                  w_len;     /*W (window length)  explicitly set */
 
@@ -1339,6 +1524,9 @@ extern int p7_Tau       (ESL_RANDOMNESS *r, P7_OPROFILE *om, P7_BG *bg, int L, i
 extern int p7_EntropyWeight(const P7_HMM *hmm, const P7_BG *bg, const P7_PRIOR *pri, double infotarget, double *ret_Neff);
 
 extern int p7_EntropyWeight_exp(const P7_HMM *hmm, const P7_BG *bg, const P7_PRIOR *pri, double etarget, double *ret_exp);
+
+/* eclust.c */
+extern int p7_SingleLinkage(const ESL_MSA *msa, double maxid, int ncols, ESL_RANDOMNESS *r, int **opt_c, int **opt_nin, int *ret_nc);
 /* generic_decoding.c */
 extern int p7_GDecoding      (const P7_PROFILE *gm, const P7_GMX *fwd,       P7_GMX *bck, P7_GMX *pp);
 extern int p7_GDomainDecoding(const P7_PROFILE *gm, const P7_GMX *fwd, const P7_GMX *bck, P7_DOMAINDEF *ddef);
@@ -1362,6 +1550,10 @@ extern int p7_GOATrace        (const P7_PROFILE *gm, const P7_GMX *pp, const P7_
 
 /* generic_stotrace.c */
 extern int p7_GStochasticTrace(ESL_RANDOMNESS *r, const ESL_DSQ *dsq, int L, const P7_PROFILE *gm, const P7_GMX *gx, P7_TRACE *tr);
+extern P7_STOCACHE *p7_stocache_Create(int L);
+extern int          p7_stocache_GrowTo(P7_STOCACHE *stc, int L);
+extern int          p7_stocache_Reuse(P7_STOCACHE *stc);
+extern void         p7_stocache_Destroy(P7_STOCACHE *stc);
 
 /* generic_viterbi.c */
 extern int p7_GViterbi     (const ESL_DSQ *dsq, int L, const P7_PROFILE *gm,       P7_GMX *gx, float *ret_sc);
@@ -1465,7 +1657,9 @@ extern int p7_tracealign_getMSAandStats(P7_HMM *hmm, ESL_SQ  **sq, int N, ESL_MS
 
 /* p7_alidisplay.c */
 extern P7_ALIDISPLAY *p7_alidisplay_Create(const P7_TRACE *tr, int which, const P7_OPROFILE *om, const ESL_SQ *sq, const ESL_SQ *ntsq);
+extern P7_ALIDISPLAY *p7_alidisplay_CreateInArena(const P7_TRACE *tr, int which, const P7_OPROFILE *om, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_ARENA *ar);
 extern P7_ALIDISPLAY *p7_alidisplay_Clone(const P7_ALIDISPLAY *ad);
+extern P7_ALIDISPLAY *p7_alidisplay_CloneInArena(const P7_ALIDISPLAY *ad, P7_ARENA *ar);
 extern size_t         p7_alidisplay_Sizeof(const P7_ALIDISPLAY *ad);
 extern int            p7_alidisplay_Serialize(P7_ALIDISPLAY *ad);
 extern int            p7_alidisplay_Deserialize(P7_ALIDISPLAY *ad);
@@ -1483,6 +1677,18 @@ extern int            p7_alidisplay_Sample(ESL_RANDOMNESS *rng, int N, P7_ALIDIS
 extern int            p7_alidisplay_Dump(FILE *fp, const P7_ALIDISPLAY *ad);
 extern int            p7_alidisplay_Compare(const P7_ALIDISPLAY *ad1, const P7_ALIDISPLAY *ad2);
 
+/* p7_arena.c */
+extern P7_ARENA *p7_arena_Create(size_t minblock);
+extern void     *p7_arena_Alloc(P7_ARENA *ar, size_t n);
+extern int       p7_arena_Strdup(P7_ARENA *ar, const char *s, int64_t n, char **ret_dup);
+extern int       p7_arena_Owns(const P7_ARENA *ar, const void *p);
+extern int       p7_arena_Merge(P7_ARENA *dst, P7_ARENA *src);
+extern size_t    p7_arena_Sizeof(const P7_ARENA *ar);
+extern int       p7_arena_Reuse(P7_ARENA *ar);
+extern void      p7_arena_Mark(const P7_ARENA *ar, P7_ARENAMARK *mark);
+extern int       p7_arena_Release(P7_ARENA *ar, const P7_ARENAMARK *mark);
+extern void      p7_arena_Destroy(P7_ARENA *ar);
+
 /* p7_bg.c */
 extern P7_BG *p7_bg_Create(const ESL_ALPHABET *abc);
 extern P7_BG *p7_bg_CreateUniform(const ESL_ALPHABET *abc);
@@ -1515,11 +1721,17 @@ extern int           p7_domaindef_GrowTo (P7_DOMAINDEF *ddef, int L);
 extern int           p7_domaindef_Reuse  (P7_DOMAINDEF *ddef);
 extern int           p7_domaindef_DumpPosteriors(FILE *ofp, P7_DOMAINDEF *ddef);
 extern void          p7_domaindef_Destroy(P7_DOMAINDEF *ddef);
+#ifdef HMMER_THREADS
+extern P7_DOMAINPOOL *p7_domainpool_Create (int nworkers);
+extern void           p7_domainpool_Destroy(P7_DOMAINPOOL *pool);
+#endif
 
 extern int p7_domaindef_ByViterbi            (P7_PROFILE *gm, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_GMX *gx1, P7_GMX *gx2, P7_DOMAINDEF *ddef);
 extern int p7_domaindef_ByPosteriorHeuristics(const ESL_SQ *sq, const ESL_SQ *ntsq, P7_OPROFILE *om, P7_OMX *oxf, P7_OMX *oxb, P7_OMX *fwd, P7_OMX *bck,
 				                                  P7_DOMAINDEF *ddef, P7_BG *bg, int long_target,
 				                                  P7_BG *bg_tmp, float *scores_arr, float *fwd_emissions_arr);
+extern int p7_domaindef_AlignEnvelope        (P7_OPROFILE *om, P7_ARENA *ar, const char *name, const char *acc, const char *desc,
+						  P7_OMX *ox1, P7_OMX *ox2, P7_TRACE *tr, P7_DOMAIN *dom);
 
 
 /* p7_gmx.c */
@@ -1533,6 +1745,18 @@ extern int     p7_gmx_Dump(FILE *fp, P7_GMX *gx, int flags);
 extern int     p7_gmx_DumpWindow(FILE *fp, P7_GMX *gx, int istart, int iend, int kstart, int kend, int show_specials);
 
 
+/* p7_hitfile.c */
+extern int  p7_hitfile_WriteMagic(FILE *ofp);
+extern int  p7_hitfile_Write(FILE *ofp, char *qname, char *qacc, P7_TOPHITS *th, P7_PIPELINE *pli);
+extern int  p7_hitfile_WriteTail(FILE *ofp, const char *progname, enum p7_pipemodes_e pipemode,
+				 const char *qfile, const char *tfile, const ESL_GETOPTS *go);
+extern int  p7_hitfile_Open(const char *filename, P7_HITFILE **ret_hfp, char *errbuf);
+extern int  p7_hitfile_Read(P7_HITFILE *hfp, P7_TOPHITS **ret_th);
+extern void p7_hitfile_Close(P7_HITFILE *hfp);
+extern int  p7_hitfile_TabularTargets(FILE *ofp, const P7_HITFILE *hfp, P7_TOPHITS *th, int show_header);
+extern int  p7_hitfile_TabularDomains(FILE *ofp, const P7_HITFILE *hfp, P7_TOPHITS *th, int show_header);
+extern int  p7_hitfile_TabularTail(FILE *ofp, const P7_HITFILE *hfp);
+
 /* p7_hmm.c */
 /*      1. The P7_HMM object: allocation, initialization, destruction. */
 extern P7_HMM *p7_hmm_Create(int M, const ESL_ALPHABET *abc);
@@ -1608,6 +1832,13 @@ extern P7_HMM_WINDOW *p7_hmm_newWindow (P7_HMM_WINDOWLIST *list, uint32_t id, ui
 extern void p7_null3_score(const ESL_ALPHABET *abc, const ESL_DSQ *dsq, P7_TRACE *tr, int start, int stop, P7_BG *bg, float *ret_sc);
 extern void p7_null3_windowed_score(const ESL_ALPHABET *abc, const ESL_DSQ *dsq, int start, int stop, P7_BG *bg, float *ret_sc);
 
+/* p7_orfscan.c */
+extern P7_ORFSCAN *p7_orfscan_Create(const ESL_GENCODE *gcode, int minlen, int require_init, int do_watson, int do_crick);
+extern int         p7_orfscan_SetSequence(P7_ORFSCAN *os, const ESL_SQ *ntsq);
+extern int         p7_orfscan_Next(P7_ORFSCAN *os, ESL_SQ *orfsq);
+extern int64_t     p7_orfscan_CodonStart(const ESL_SQ *orfsq, int64_t i);
+extern void        p7_orfscan_Destroy(P7_ORFSCAN *os);
+
 /* p7_pipeline.c */
 extern P7_PIPELINE *p7_pipeline_Create(ESL_GETOPTS *go, int M_hint, int L_hint, int long_targets, enum p7_pipemodes_e mode);
 extern int          p7_pipeline_Reuse  (P7_PIPELINE *pli);
@@ -1623,6 +1854,8 @@ extern int p7_pli_DomainIncludable  (P7_PIPELINE *pli, float dom_score, double l
 extern int p7_pli_NewModel          (P7_PIPELINE *pli, const P7_OPROFILE *om, P7_BG *bg);
 extern int p7_pli_NewModelThresholds(P7_PIPELINE *pli, const P7_OPROFILE *om);
 extern int p7_pli_NewSeq            (P7_PIPELINE *pli, const ESL_SQ *sq);
+extern int p7_pli_SetTargetLength   (P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, int L);
+extern int p7_pli_OrderByLength     (const ESL_SQ *sq, int n, int *order);
 extern int p7_Pipeline              (P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_TOPHITS *th);
 extern int p7_Pipeline_LongTarget   (P7_PIPELINE *pli, P7_OPROFILE *om, P7_SCOREDATA *data,
                                      P7_BG *bg, P7_TOPHITS *hitlist, int64_t seqidx,
@@ -1633,6 +1866,18 @@ extern int p7_Pipeline_LongTarget   (P7_PIPELINE *pli, P7_OPROFILE *om, P7_SCORE
 
 
 extern int p7_pli_Statistics(FILE *ofp, P7_PIPELINE *pli, ESL_STOPWATCH *w);
+extern int p7_pli_TabularStageStats(FILE *ofp, const P7_STAGESTATS *st);
+extern int p7_pli_JSONStatistics(FILE *ofp, const char *progname, const char *qname, P7_PIPELINE *pli, const P7_TOPHITS *th, ESL_STOPWATCH *w, int nthreads);
+
+extern uint64_t    p7_stagestats_Clock(void);
+extern void        p7_stagestats_Zero (P7_STAGESTATS *st);
+extern void        p7_stagestats_Merge(P7_STAGESTATS *st1, const P7_STAGESTATS *st2);
+extern const char *p7_stagestats_Name (int s);
+
+extern P7_PROGRESS *p7_progress_Create (FILE *ofp, const char *progname, double interval, const char *dbfile);
+extern void         p7_progress_Start  (P7_PROGRESS *prg, const char *qname);
+extern int          p7_progress_Update (P7_PROGRESS *prg, uint64_t nseqs, uint64_t nres, int64_t offset);
+extern void         p7_progress_Destroy(P7_PROGRESS *prg);
 
 
 /* p7_prior.c */
@@ -1674,6 +1919,10 @@ extern void    p7_spensemble_Destroy(P7_SPENSEMBLE *sp);
 extern P7_TOPHITS *p7_tophits_Create(void);
 extern int         p7_tophits_Grow(P7_TOPHITS *h);
 extern int         p7_tophits_CreateNextHit(P7_TOPHITS *h, P7_HIT **ret_hit);
+extern int         p7_tophits_CopyDomains(P7_TOPHITS *h, const P7_DOMAIN *dcl, int ndom, P7_DOMAIN **ret_dcl);
+extern int         p7_tophits_SetMaxHits(P7_TOPHITS *h, uint64_t maxhits);
+extern int         p7_tophits_Admits(P7_TOPHITS *h, double sortkey);
+extern int         p7_tophits_Settle(P7_TOPHITS *h);
 extern int         p7_tophits_Add(P7_TOPHITS *h,
 				  char *name, char *acc, char *desc, 
 				  double sortkey, 
@@ -1697,6 +1946,7 @@ extern void        p7_tophits_Destroy(P7_TOPHITS *h);
 extern int p7_tophits_ComputeNhmmerEvalues(P7_TOPHITS *th, double N, int W);
 extern int p7_tophits_RemoveDuplicates(P7_TOPHITS *th, int using_bit_cutoffs);
 extern int p7_tophits_Threshold(P7_TOPHITS *th, P7_PIPELINE *pli);
+extern int p7_tophits_AlignDomains(P7_TOPHITS *th, P7_OPROFILE *om, P7_STAGESTATS *st);
 extern int p7_tophits_CompareRanking(P7_TOPHITS *th, ESL_KEYHASH *kh, int *opt_nnew);
 extern int p7_tophits_Targets(FILE *ofp, P7_TOPHITS *th, P7_PIPELINE *pli, int textw);
 extern int p7_tophits_Domains(FILE *ofp, P7_TOPHITS *th, P7_PIPELINE *pli, int textw);
@@ -1744,6 +1994,7 @@ extern int  p7_trace_FauxFromMSA(ESL_MSA *msa, int *matassign, int optflags, P7_
 extern int  p7_trace_Doctor(P7_TRACE *tr, int *opt_ndi, int *opt_nid);
 
 extern int  p7_trace_Count(P7_HMM *hmm, ESL_DSQ *dsq, float wt, P7_TRACE *tr);
+extern int  p7_trace_CountBand(P7_HMM *hmm, ESL_DSQ *dsq, float wt, P7_TRACE *tr, int ka, int kb, int za, int zb);
 
 
 /* seqmodel.c */
@@ -0,0 +1,64 @@
+/* hmmhitconvert: convert a binary hit file (--hitout) to tabular output.
+ */
+#include "p7_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "easel.h"
+#include "esl_getopts.h"
+
+#include "hmmer.h"
+
+static ESL_OPTIONS options[] = {
+  /* name           type         default  env  range toggles reqs incomp  help                                                     docgroup*/
+  { "-h",          eslARG_NONE,    FALSE, NULL, NULL, NULL,  NULL, NULL, "show brief help on version and usage",                          0 },
+  { "--tblout",    eslARG_OUTFILE,  NULL, NULL, NULL, NULL,  NULL, NULL, "save parseable table of per-sequence hits to file <f>",         0 },
+  { "--domtblout", eslARG_OUTFILE,  NULL, NULL, NULL, NULL,  NULL, NULL, "save parseable table of per-domain hits to file <f>",           0 },
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+static char usage[]  = "[-options] <hitfile>";
+static char banner[] = "convert a binary hit file to tabular output";
+
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS   *go       = p7_CreateDefaultApp(options, 1, argc, argv, banner, usage);
+  char          *hitfile  = esl_opt_GetArg(go, 1);
+  P7_HITFILE    *hfp      = NULL;
+  P7_TOPHITS    *th       = NULL;
+  FILE          *tblfp    = NULL;
+  FILE          *domtblfp = NULL;
+  int            status;
+  char           errbuf[eslERRBUFSIZE];
+
+  /* With no output files named, the per-sequence table goes to stdout. */
+  if      (esl_opt_IsOn(go, "--tblout"))    { if ((tblfp    = fopen(esl_opt_GetString(go, "--tblout"),    "w")) == NULL) p7_Fail("Failed to open tabular per-seq output file %s for writing\n", esl_opt_GetString(go, "--tblout")); }
+  else if (! esl_opt_IsOn(go, "--domtblout")) tblfp = stdout;
+  if      (esl_opt_IsOn(go, "--domtblout")) { if ((domtblfp = fopen(esl_opt_GetString(go, "--domtblout"), "w")) == NULL) p7_Fail("Failed to open tabular per-dom output file %s for writing\n", esl_opt_GetString(go, "--domtblout")); }
+
+  status = p7_hitfile_Open(hitfile, &hfp, errbuf);
+  if      (status == eslENOTFOUND) p7_Fail("File existence/permissions problem in trying to open hit file %s.\n%s\n", hitfile, errbuf);
+  else if (status == eslEFORMAT)   p7_Fail("File format problem in trying to open hit file %s.\n%s\n",                hitfile, errbuf);
+  else if (status != eslOK)        p7_Fail("Unexpected error %d in opening hit file %s.\n%s\n",                       status, hitfile, errbuf);
+
+  while ((status = p7_hitfile_Read(hfp, &th)) == eslOK)
+    {
+      if (tblfp)    p7_hitfile_TabularTargets(tblfp,    hfp, th, (hfp->nqueries == 1));
+      if (domtblfp) p7_hitfile_TabularDomains(domtblfp, hfp, th, (hfp->nqueries == 1));
+      p7_tophits_Destroy(th);
+    }
+  if      (status == eslEFORMAT) p7_Fail("bad file format in hit file %s:\n%s\n", hitfile, hfp->errbuf);
+  else if (status != eslEOF)     p7_Fail("Unexpected error in reading hits from %s", hitfile);
+
+  if (tblfp)    p7_hitfile_TabularTail(tblfp,    hfp);
+  if (domtblfp) p7_hitfile_TabularTail(domtblfp, hfp);
+
+  if (tblfp && tblfp != stdout) fclose(tblfp);
+  if (domtblfp)                 fclose(domtblfp);
+  p7_hitfile_Close(hfp);
+  esl_getopts_Destroy(go);
+  return 0;
+}
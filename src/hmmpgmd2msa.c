@@ -97,6 +97,8 @@ hmmpgmd2msa(void *data, P7_HMM *hmm, ESL_SQ *qsq, int *incl, int incl_size, int
   th.N = 0;
   th.unsrt = NULL;
   th.hit   = NULL;
+  th.arena = NULL;
+  th.maxhits = 0;
 
   /* optionally build a faux trace for the query sequence: relative to core model (B->M_1..M_L->E) */
   if (qsq != NULL) {
@@ -331,6 +333,8 @@ int hmmpgmd2stats(void *data, P7_HMM *hmm, float** statsOut)
   th.N = 0;
   th.unsrt = NULL;
   th.hit   = NULL;
+  th.arena = NULL;
+  th.maxhits = 0;
 
   //storage for output
   ESL_ALLOC( *statsOut,   sizeof(float) * hmm->M * 3);
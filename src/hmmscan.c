@@ -62,7 +62,9 @@ static ESL_OPTIONS options[] = {
   { "-o",           eslARG_OUTFILE, NULL, NULL, NULL,    NULL,  NULL,  NULL,            "direct output to file <f>, not stdout",                         2 },
   { "--tblout",     eslARG_OUTFILE, NULL, NULL, NULL,    NULL,  NULL,  NULL,            "save parseable table of per-sequence hits to file <f>",         2 },
   { "--domtblout",  eslARG_OUTFILE, NULL, NULL, NULL,    NULL,  NULL,  NULL,            "save parseable table of per-domain hits to file <f>",           2 },
+  { "--hitout",     eslARG_OUTFILE, NULL, NULL, NULL,    NULL,  NULL,  NULL,            "save hits in compact binary format to file <f>",                2 },
   { "--pfamtblout", eslARG_OUTFILE, NULL, NULL, NULL,    NULL,  NULL,  NULL,            "save table of hits and domains to file, in Pfam format <f>",    2 },
+  { "--statsout",   eslARG_OUTFILE, NULL, NULL, NULL,    NULL,  NULL,  NULL,            "save per-query search statistics as JSON lines to file <f>",    2 },
   { "--acc",        eslARG_NONE,   FALSE, NULL, NULL,    NULL,  NULL,  NULL,            "prefer accessions over names in output",                        2 },
   { "--noali",      eslARG_NONE,   FALSE, NULL, NULL,    NULL,  NULL,  NULL,            "don't output alignments, so output is smaller",                 2 },
   { "--notextw",    eslARG_NONE,    NULL, NULL, NULL,    NULL,  NULL, "--textw",        "unlimit ASCII text output line width",                          2 },
@@ -72,6 +74,7 @@ static ESL_OPTIONS options[] = {
   { "-T",           eslARG_REAL,   FALSE, NULL, NULL,    NULL,  NULL,  REPOPTS,         "report models >= this score threshold in output",               4 },
   { "--domE",       eslARG_REAL,  "10.0", NULL, "x>0",   NULL,  NULL,  DOMREPOPTS,      "report domains <= this E-value threshold in output",            4 },
   { "--domT",       eslARG_REAL,   FALSE, NULL, NULL,    NULL,  NULL,  DOMREPOPTS,      "report domains >= this score cutoff in output",                 4 },
+  { "--max-hits",   eslARG_INT,     NULL, NULL, "n>0",   NULL,  NULL,  NULL,            "keep only the <n> best-scoring hits (saves memory)",            4 },
   /* Control of inclusion (significance) thresholds: */
   { "--incE",       eslARG_REAL,  "0.01", NULL, "x>0",   NULL,  NULL,  INCOPTS,         "consider models <= this E-value threshold as significant",      5 },
   { "--incT",       eslARG_REAL,   FALSE, NULL, NULL,    NULL,  NULL,  INCOPTS,         "consider models >= this score threshold as significant",        5 },
@@ -89,6 +92,8 @@ static ESL_OPTIONS options[] = {
   { "--nobias",     eslARG_NONE,    NULL, NULL, NULL,    NULL,  NULL, "--max",          "turn off composition bias filter",                              7 },
   /* Other options */
   { "--nonull2",    eslARG_NONE,    NULL, NULL, NULL,    NULL,  NULL,  NULL,            "turn off biased composition score corrections",                12 },
+  { "--nosample",   eslARG_NONE,    NULL, NULL, NULL,    NULL,  NULL,  NULL,            "split domains by posterior decoding, not sampling",            12 },
+  { "--stagestats", eslARG_NONE,    NULL, NULL, NULL,    NULL,  NULL,  NULL,            "time each pipeline stage, and count its DP cells",             12 },
   { "-Z",           eslARG_REAL,   FALSE, NULL, "x>0",   NULL,  NULL,  NULL,            "set # of comparisons done, for E-value calculation",           12 },
   { "--domZ",       eslARG_REAL,   FALSE, NULL, "x>0",   NULL,  NULL,  NULL,            "set # of significant seqs, for domain E-value calculation",    12 },
   { "--seed",       eslARG_INT,    "42",  NULL, "n>=0",  NULL,  NULL,  NULL,            "set RNG seed to <n> (if 0: one-time arbitrary seed)",          12 },
@@ -215,7 +220,9 @@ output_header(FILE *ofp, ESL_GETOPTS *go, char *hmmfile, char *seqfile)
   if (esl_opt_IsUsed(go, "-o")          && fprintf(ofp, "# output directed to file:         %s\n",            esl_opt_GetString(go, "-o"))          < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--tblout")    && fprintf(ofp, "# per-seq hits tabular output:     %s\n",            esl_opt_GetString(go, "--tblout"))    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--domtblout") && fprintf(ofp, "# per-dom hits tabular output:     %s\n",            esl_opt_GetString(go, "--domtblout")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--hitout")    && fprintf(ofp, "# binary hit output:               %s\n",            esl_opt_GetString(go, "--hitout")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--pfamtblout")&& fprintf(ofp, "# pfam-style tabular hit output:   %s\n",            esl_opt_GetString(go, "--pfamtblout")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--statsout")  && fprintf(ofp, "# JSON search statistics output:   %s\n",            esl_opt_GetString(go, "--statsout"))  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--acc")       && fprintf(ofp, "# prefer accessions over names:    yes\n")                                                 < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--noali")     && fprintf(ofp, "# show alignments in output:       no\n")                                                  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--notextw")   && fprintf(ofp, "# max ASCII text line length:      unlimited\n")                                           < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
@@ -224,6 +231,7 @@ output_header(FILE *ofp, ESL_GETOPTS *go, char *hmmfile, char *seqfile)
   if (esl_opt_IsUsed(go, "-T")          && fprintf(ofp, "# profile reporting threshold:     score >= %g\n",   esl_opt_GetReal(go, "-T"))            < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--domE")      && fprintf(ofp, "# domain reporting threshold:      E-value <= %g\n", esl_opt_GetReal(go, "--domE"))        < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--domT")      && fprintf(ofp, "# domain reporting threshold:      score >= %g\n",   esl_opt_GetReal(go, "--domT"))        < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--max-hits")  && fprintf(ofp, "# max hits kept:                   %d\n",            esl_opt_GetInteger(go, "--max-hits")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--incE")      && fprintf(ofp, "# profile inclusion threshold:     E-value <= %g\n", esl_opt_GetReal(go, "--incE"))        < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--incT")      && fprintf(ofp, "# profile inclusion threshold:     score >= %g\n",   esl_opt_GetReal(go, "--incT"))        < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--incdomE")   && fprintf(ofp, "# domain inclusion threshold:      E-value <= %g\n", esl_opt_GetReal(go, "--incdomE"))     < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
@@ -237,6 +245,7 @@ output_header(FILE *ofp, ESL_GETOPTS *go, char *hmmfile, char *seqfile)
   if (esl_opt_IsUsed(go, "--F3")        && fprintf(ofp, "# Fwd filter P threshold:       <= %g\n",            esl_opt_GetReal(go, "--F3"))          < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--nobias")    && fprintf(ofp, "# biased composition HMM filter:   off\n")                                                 < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--nonull2")   && fprintf(ofp, "# null2 bias corrections:          off\n")                                                 < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--nosample")  && fprintf(ofp, "# multidomain envelopes:           posterior decoding\n")                                  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "-Z")          && fprintf(ofp, "# sequence search space set to:    %.0f\n",          esl_opt_GetReal(go, "-Z"))            < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--domZ")      && fprintf(ofp, "# domain search space set to:      %.0f\n",          esl_opt_GetReal(go, "--domZ"))        < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--seed"))  {
@@ -320,13 +329,16 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   FILE            *ofp      = stdout;	         /* output file for results (default stdout)        */
   FILE            *tblfp    = NULL;		 /* output stream for tabular per-seq (--tblout)    */
   FILE            *domtblfp = NULL;	  	 /* output stream for tabular per-seq (--domtblout) */
+  FILE            *hitfp    = NULL;	  	 /* output stream for binary hit output (--hitout)   */
   FILE            *pfamtblfp= NULL;              /* output stream for pfam tabular output (--pfamtblout)    */
+  FILE            *statsfp  = NULL;              /* JSON lines of search statistics (--statsout)    */
   int              seqfmt   = eslSQFILE_UNKNOWN; /* format of seqfile                               */
   ESL_SQFILE      *sqfp     = NULL;              /* open seqfile                                    */
   P7_HMMFILE      *hfp      = NULL;		 /* open HMM database file                          */
   ESL_ALPHABET    *abc      = NULL;              /* sequence alphabet                               */
   P7_OPROFILE     *om       = NULL;		 /* target profile                                  */
   ESL_STOPWATCH   *w        = NULL;              /* timing                                          */
+  P7_STAGESTATS    stagestats;                   /* per-stage totals over all queries (--stagestats) */
   ESL_SQ          *qsq      = NULL;		 /* query sequence                                  */
   int              nquery   = 0;
   int              textw;
@@ -343,10 +355,12 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   P7_OM_BLOCK     *block    = NULL;
   ESL_THREADS     *threadObj= NULL;
   ESL_WORK_QUEUE  *queue    = NULL;
+  P7_DOMAINPOOL   *ddpool   = NULL;
 #endif
   char             errbuf[eslERRBUFSIZE];
 
   w = esl_stopwatch_Create();
+  p7_stagestats_Zero(&stagestats);
 
   if (esl_opt_GetBoolean(go, "--notextw")) textw = 0;
   else                                     textw = esl_opt_GetInteger(go, "--textw");
@@ -384,7 +398,9 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (esl_opt_IsOn(go, "-o"))          { if ((ofp      = fopen(esl_opt_GetString(go, "-o"),          "w")) == NULL)  esl_fatal("Failed to open output file %s for writing\n",                 esl_opt_GetString(go, "-o")); }
   if (esl_opt_IsOn(go, "--tblout"))    { if ((tblfp    = fopen(esl_opt_GetString(go, "--tblout"),    "w")) == NULL)  esl_fatal("Failed to open tabular per-seq output file %s for writing\n", esl_opt_GetString(go, "--tblout")); }
   if (esl_opt_IsOn(go, "--domtblout")) { if ((domtblfp = fopen(esl_opt_GetString(go, "--domtblout"), "w")) == NULL)  esl_fatal("Failed to open tabular per-dom output file %s for writing\n", esl_opt_GetString(go, "--domtblout")); }
+  if (esl_opt_IsOn(go, "--hitout"))    { if ((hitfp    = fopen(esl_opt_GetString(go, "--hitout"),    "wb")) == NULL)  esl_fatal("Failed to open binary hit output file %s for writing\n", esl_opt_GetString(go, "--hitout")); p7_hitfile_WriteMagic(hitfp); }
   if (esl_opt_IsOn(go, "--pfamtblout")){ if ((pfamtblfp = fopen(esl_opt_GetString(go, "--pfamtblout"), "w")) == NULL)  esl_fatal("Failed to open pfam-style tabular output file %s for writing\n", esl_opt_GetString(go, "--pfamtblout")); }
+  if (esl_opt_IsOn(go, "--statsout"))  { if ((statsfp  = fopen(esl_opt_GetString(go, "--statsout"),  "w")) == NULL)  esl_fatal("Failed to open JSON statistics output file %s for writing\n", esl_opt_GetString(go, "--statsout")); }
 
   output_header(ofp, go, cfg->hmmfile, cfg->seqfile);
 
@@ -395,6 +411,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
     {
       threadObj = esl_threads_Create(&pipeline_thread);
       queue = esl_workqueue_Create(ncpus * 2);
+      if ((ddpool = p7_domainpool_Create(ncpus)) == NULL) p7_Fail("Failed to create domain definition threads");
     }
 #endif
 
@@ -447,7 +464,11 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 	{
 	  /* Create processing pipeline and hit list */
 	  info[i].th  = p7_tophits_Create(); 
+	  if (esl_opt_IsOn(go, "--max-hits")) p7_tophits_SetMaxHits(info[i].th, esl_opt_GetInteger(go, "--max-hits"));
 	  info[i].pli = p7_pipeline_Create(go, 100, 100, FALSE, p7_SCAN_MODELS); /* M_hint = 100, L_hint = 100 are just dummies for now */
+#ifdef HMMER_THREADS
+	  info[i].pli->ddef->pool = ddpool;
+#endif
 	  info[i].pli->hfp = hfp;  /* for two-stage input, pipeline needs <hfp> */
 
 	  p7_pli_NewSeq(info[i].pli, qsq);
@@ -491,10 +512,13 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
       if (tblfp)     p7_tophits_TabularTargets(tblfp,    qsq->name, qsq->acc, info->th, info->pli, (nquery == 1));
       if (domtblfp)  p7_tophits_TabularDomains(domtblfp, qsq->name, qsq->acc, info->th, info->pli, (nquery == 1));
+      if (hitfp)     p7_hitfile_Write(hitfp, qsq->name, qsq->acc, info->th, info->pli);
       if (pfamtblfp) p7_tophits_TabularXfam(pfamtblfp, qsq->name, qsq->acc, info->th, info->pli);
 
       esl_stopwatch_Stop(w);
       p7_pli_Statistics(ofp, info->pli, w);
+      if (statsfp) p7_pli_JSONStatistics(statsfp, "hmmscan", qsq->name, info->pli, info->th, w, ncpus);
+      p7_stagestats_Merge(&stagestats, &(info->pli->stats));
       if (fprintf(ofp, "//\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
       fflush(ofp);
 
@@ -510,8 +534,14 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
   /* Terminate outputs - any last words?
    */
+  if (esl_opt_GetBoolean(go, "--stagestats")) {
+    if (tblfp)     p7_pli_TabularStageStats(tblfp,     &stagestats);
+    if (domtblfp)  p7_pli_TabularStageStats(domtblfp,  &stagestats);
+    if (pfamtblfp) p7_pli_TabularStageStats(pfamtblfp, &stagestats);
+  }
   if (tblfp)    p7_tophits_TabularTail(tblfp,    "hmmscan", p7_SCAN_MODELS, cfg->seqfile, cfg->hmmfile, go);
   if (domtblfp) p7_tophits_TabularTail(domtblfp, "hmmscan", p7_SCAN_MODELS, cfg->seqfile, cfg->hmmfile, go);
+  if (hitfp)    p7_hitfile_WriteTail(hitfp, "hmmscan", p7_SCAN_MODELS, cfg->seqfile, cfg->hmmfile, go);
   if (pfamtblfp)p7_tophits_TabularTail(pfamtblfp,"hmmscan", p7_SEARCH_SEQS, cfg->seqfile, cfg->hmmfile, go);
   if (ofp)      { if (fprintf(ofp, "[ok]\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
 
@@ -528,6 +558,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 	p7_oprofile_DestroyBlock(block);
       esl_workqueue_Destroy(queue);
       esl_threads_Destroy(threadObj);
+      p7_domainpool_Destroy(ddpool);
     }
 #endif
 
@@ -541,7 +572,9 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (ofp != stdout) fclose(ofp);
   if (tblfp)         fclose(tblfp);
   if (domtblfp)      fclose(domtblfp);
+  if (hitfp)         fclose(hitfp);
   if (pfamtblfp)     fclose(pfamtblfp);
+  if (statsfp)       fclose(statsfp);
   return eslOK;
 
  ERROR:
@@ -719,7 +752,9 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   FILE            *ofp      = stdout;	         /* output file for results (default stdout)        */
   FILE            *tblfp    = NULL;		 /* output stream for tabular per-seq (--tblout)    */
   FILE            *domtblfp = NULL;	  	 /* output stream for tabular per-seq (--domtblout) */
+  FILE            *hitfp    = NULL;	  	 /* output stream for binary hit output (--hitout)   */
   FILE            *pfamtblfp= NULL;              /* output stream for pfam-style tabular output  (--pfamtblout) */
+  FILE            *statsfp  = NULL;              /* JSON lines of search statistics (--statsout)    */
   int              seqfmt   = eslSQFILE_UNKNOWN; /* format of seqfile                               */
   P7_BG           *bg       = NULL;	         /* null model                                      */
   ESL_SQFILE      *sqfp     = NULL;              /* open seqfile                                    */
@@ -727,6 +762,7 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   ESL_ALPHABET    *abc      = NULL;              /* sequence alphabet                               */
   P7_OPROFILE     *om       = NULL;		 /* target profile                                  */
   ESL_STOPWATCH   *w        = NULL;              /* timing                                          */
+  P7_STAGESTATS    stagestats;                   /* per-stage totals over all queries (--stagestats) */
   ESL_SQ          *qsq      = NULL;		 /* query sequence                                  */
   int              nquery   = 0;
   int              textw;
@@ -746,6 +782,7 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   char             errbuf[eslERRBUFSIZE];
 
   w = esl_stopwatch_Create();
+  p7_stagestats_Zero(&stagestats);
 
   if (esl_opt_GetBoolean(go, "--notextw")) textw = 0;
   else                                     textw = esl_opt_GetInteger(go, "--textw");
@@ -785,8 +822,13 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
     mpi_failure("Failed to open tabular per-seq output file %s for writing\n", esl_opt_GetString(go, "--tblfp"));
   if (esl_opt_IsOn(go, "--domtblout") && (domtblfp = fopen(esl_opt_GetString(go, "--domtblout"), "w")) == NULL)  
     mpi_failure("Failed to open tabular per-dom output file %s for writing\n", esl_opt_GetString(go, "--domtblfp"));
+  if (esl_opt_IsOn(go, "--hitout") && (hitfp = fopen(esl_opt_GetString(go, "--hitout"), "wb")) == NULL)
+    mpi_failure("Failed to open binary hit output file %s for writing\n", esl_opt_GetString(go, "--hitout"));
+  if (hitfp) p7_hitfile_WriteMagic(hitfp);
   if (esl_opt_IsOn(go, "--pfamtblout") && (pfamtblfp = fopen(esl_opt_GetString(go, "--pfamtblout"), "w")) == NULL)
     mpi_failure("Failed to open pfam-style tabular output file %s for writing\n", esl_opt_GetString(go, "--pfamtblout"));
+  if (esl_opt_IsOn(go, "--statsout") && (statsfp = fopen(esl_opt_GetString(go, "--statsout"), "w")) == NULL)
+    mpi_failure("Failed to open JSON statistics output file %s for writing\n", esl_opt_GetString(go, "--statsout"));
  
   ESL_ALLOC(list, sizeof(MSV_BLOCK));
   list->complete = 0;
@@ -822,6 +864,7 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
       /* Create processing pipeline and hit list */
       th  = p7_tophits_Create(); 
+      if (esl_opt_IsOn(go, "--max-hits")) p7_tophits_SetMaxHits(th, esl_opt_GetInteger(go, "--max-hits"));
       pli = p7_pipeline_Create(go, 100, 100, FALSE, p7_SCAN_MODELS); /* M_hint = 100, L_hint = 100 are just dummies for now */
       pli->hfp = hfp;  /* for two-stage input, pipeline needs <hfp> */
 
@@ -922,10 +965,13 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
       if (tblfp)     p7_tophits_TabularTargets(tblfp,    qsq->name, qsq->acc, th, pli, (nquery == 1));
       if (domtblfp)  p7_tophits_TabularDomains(domtblfp, qsq->name, qsq->acc, th, pli, (nquery == 1));
+      if (hitfp)     p7_hitfile_Write(hitfp, qsq->name, qsq->acc, th, pli);
       if (pfamtblfp) p7_tophits_TabularXfam(pfamtblfp,   qsq->name, qsq->acc, th, pli);
 
       esl_stopwatch_Stop(w);
       p7_pli_Statistics(ofp, pli, w);
+      if (statsfp) p7_pli_JSONStatistics(statsfp, "hmmscan", qsq->name, pli, th, w, 0);
+      p7_stagestats_Merge(&stagestats, &(pli->stats));
       if (fprintf(ofp, "//\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 
       p7_hmmfile_Close(hfp);
@@ -962,8 +1008,14 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
  /* Terminate outputs - any last words?
    */
+  if (esl_opt_GetBoolean(go, "--stagestats")) {
+    if (tblfp)     p7_pli_TabularStageStats(tblfp,     &stagestats);
+    if (domtblfp)  p7_pli_TabularStageStats(domtblfp,  &stagestats);
+    if (pfamtblfp) p7_pli_TabularStageStats(pfamtblfp, &stagestats);
+  }
   if (tblfp)    p7_tophits_TabularTail(tblfp,    "hmmscan", p7_SCAN_MODELS, cfg->seqfile, cfg->hmmfile, go);
   if (domtblfp) p7_tophits_TabularTail(domtblfp, "hmmscan", p7_SCAN_MODELS, cfg->seqfile, cfg->hmmfile, go);
+  if (hitfp)    p7_hitfile_WriteTail(hitfp, "hmmscan", p7_SCAN_MODELS, cfg->seqfile, cfg->hmmfile, go);
   if (pfamtblfp)p7_tophits_TabularTail(pfamtblfp, "hmmscan", p7_SEARCH_SEQS, cfg->seqfile, cfg->hmmfile, go);
   if (ofp)      { if (fprintf(ofp, "[ok]\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
 
@@ -981,7 +1033,9 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (ofp != stdout) fclose(ofp);
   if (tblfp)         fclose(tblfp);
   if (domtblfp)      fclose(domtblfp);
+  if (hitfp)         fclose(hitfp);
   if (pfamtblfp)     fclose(pfamtblfp);
+  if (statsfp)       fclose(statsfp);
 
   return eslOK;
 
@@ -1057,6 +1111,7 @@ mpi_worker(ESL_GETOPTS *go, struct cfg_s *cfg)
   
       /* Create processing pipeline and hit list */
       th  = p7_tophits_Create(); 
+      if (esl_opt_IsOn(go, "--max-hits")) p7_tophits_SetMaxHits(th, esl_opt_GetInteger(go, "--max-hits"));
       pli = p7_pipeline_Create(go, 100, 100, FALSE, p7_SCAN_MODELS); /* M_hint = 100, L_hint = 100 are just dummies for now */
       pli->hfp = hfp;  /* for two-stage input, pipeline needs <hfp> */
 
@@ -41,6 +41,7 @@ typedef struct {
   P7_PIPELINE      *pli;         /* work pipeline                           */
   P7_TOPHITS       *th;          /* top hit results                         */
   P7_OPROFILE      *om;          /* optimized query profile                 */
+  int               nbatch;      /* # of queries in this worker's batch (set in 1st WORKER_INFO of batch) */
 } WORKER_INFO;
 
 #define REPOPTS     "-E,-T,--cut_ga,--cut_nc,--cut_tc"
@@ -57,6 +58,12 @@ typedef struct {
 #define MPIOPTS     NULL
 #endif
 
+#ifdef HMMER_MPI
+#define QBATCHOPTS  "--mpi"
+#else
+#define QBATCHOPTS  NULL
+#endif
+
 static ESL_OPTIONS options[] = {
   /* name           type      default  env  range     toggles   reqs   incomp              help                                                      docgroup*/
   { "-h",           eslARG_NONE,   FALSE, NULL, NULL,    NULL,  NULL,  NULL,            "show brief help on version and usage",                         1 },
@@ -65,7 +72,10 @@ static ESL_OPTIONS options[] = {
   { "-A",           eslARG_OUTFILE, NULL, NULL, NULL,    NULL,  NULL,  NULL,            "save multiple alignment of all hits to file <f>",              2 },
   { "--tblout",     eslARG_OUTFILE, NULL, NULL, NULL,    NULL,  NULL,  NULL,            "save parseable table of per-sequence hits to file <f>",        2 },
   { "--domtblout",  eslARG_OUTFILE, NULL, NULL, NULL,    NULL,  NULL,  NULL,            "save parseable table of per-domain hits to file <f>",          2 },
+  { "--hitout",     eslARG_OUTFILE, NULL, NULL, NULL,    NULL,  NULL,  NULL,            "save hits in compact binary format to file <f>",               2 },
   { "--pfamtblout", eslARG_OUTFILE, NULL, NULL, NULL,    NULL,  NULL,  NULL,            "save table of hits and domains to file, in Pfam format <f>",   2 },
+  { "--statsout",   eslARG_OUTFILE, NULL, NULL, NULL,    NULL,  NULL,  NULL,            "save per-query search statistics as JSON lines to file <f>",   2 },
+  { "--progress",   eslARG_REAL,    NULL, NULL, "x>0",   NULL,"--statsout", NULL,       "add a progress record to --statsout file every <x> seconds",   2 },
   { "--acc",        eslARG_NONE,   FALSE, NULL, NULL,    NULL,  NULL,  NULL,            "prefer accessions over names in output",                       2 },
   { "--noali",      eslARG_NONE,   FALSE, NULL, NULL,    NULL,  NULL,  NULL,            "don't output alignments, so output is smaller",                2 },
   { "--notextw",    eslARG_NONE,    NULL, NULL, NULL,    NULL,  NULL, "--textw",        "unlimit ASCII text output line width",                         2 },
@@ -75,6 +85,7 @@ static ESL_OPTIONS options[] = {
   { "-T",           eslARG_REAL,   FALSE, NULL, NULL,    NULL,  NULL,  REPOPTS,         "report sequences >= this score threshold in output",           4 },
   { "--domE",       eslARG_REAL,  "10.0", NULL, "x>0",   NULL,  NULL,  DOMREPOPTS,      "report domains <= this E-value threshold in output",           4 },
   { "--domT",       eslARG_REAL,   FALSE, NULL, NULL,    NULL,  NULL,  DOMREPOPTS,      "report domains >= this score cutoff in output",                4 },
+  { "--max-hits",   eslARG_INT,     NULL, NULL, "n>0",   NULL,  NULL,  NULL,            "keep only the <n> best-scoring hits (saves memory)",           4 },
   /* Control of inclusion (significance) thresholds */
   { "--incE",       eslARG_REAL,  "0.01", NULL, "x>0",   NULL,  NULL,  INCOPTS,         "consider sequences <= this E-value threshold as significant",  5 },
   { "--incT",       eslARG_REAL,   FALSE, NULL, NULL,    NULL,  NULL,  INCOPTS,         "consider sequences >= this score threshold as significant",    5 },
@@ -93,10 +104,13 @@ static ESL_OPTIONS options[] = {
 
 /* Other options */
   { "--nonull2",    eslARG_NONE,   NULL,  NULL, NULL,    NULL,  NULL,  NULL,            "turn off biased composition score corrections",               12 },
+  { "--nosample",   eslARG_NONE,   NULL,  NULL, NULL,    NULL,  NULL,  NULL,            "split domains by posterior decoding, not sampling",           12 },
+  { "--stagestats", eslARG_NONE,   NULL,  NULL, NULL,    NULL,  NULL,  NULL,            "time each pipeline stage, and count its DP cells",            12 },
   { "-Z",           eslARG_REAL,   FALSE, NULL, "x>0",   NULL,  NULL,  NULL,            "set # of comparisons done, for E-value calculation",          12 },
   { "--domZ",       eslARG_REAL,   FALSE, NULL, "x>0",   NULL,  NULL,  NULL,            "set # of significant seqs, for domain E-value calculation",   12 },
   { "--seed",       eslARG_INT,    "42",  NULL, "n>=0",  NULL,  NULL,  NULL,            "set RNG seed to <n> (if 0: one-time arbitrary seed)",         12 },
   { "--tformat",    eslARG_STRING,  NULL, NULL, NULL,    NULL,  NULL,  NULL,            "assert target <seqfile> is in format <s>: no autodetection",  12 },
+  { "--qbatch",     eslARG_INT,     "1",  NULL, "n>0",   NULL,  NULL,  QBATCHOPTS,      "search <n> query models per pass over <seqdb> (not with MPI)", 12 },
 
 #ifdef HMMER_THREADS 
   { "--cpu",        eslARG_INT, p7_NCPU,"HMMER_NCPU","n>=0",NULL,  NULL,  CPUOPTS,      "number of parallel CPU workers to use for multithreads",      12 },
@@ -139,12 +153,12 @@ struct cfg_s {
 };
 
 static int  serial_master(ESL_GETOPTS *go, struct cfg_s *cfg);
-static int  serial_loop  (WORKER_INFO *info, ESL_SQFILE *dbfp, int n_targetseqs);
+static int  serial_loop  (WORKER_INFO *info, ESL_SQFILE *dbfp, int n_targetseqs, P7_PROGRESS *prg);
 
 #ifdef HMMER_THREADS
 #define BLOCK_SIZE 1000
 
-static int  thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, int n_targetseqs);
+static int  thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, int n_targetseqs, P7_PROGRESS *prg);
 static void pipeline_thread(void *arg);
 #endif 
 
@@ -227,7 +241,10 @@ output_header(FILE *ofp, const ESL_GETOPTS *go, char *hmmfile, char *seqfile)
   if (esl_opt_IsUsed(go, "-A")           && fprintf(ofp, "# MSA of all hits saved to file:   %s\n",             esl_opt_GetString(go, "-A"))           < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--tblout")     && fprintf(ofp, "# per-seq hits tabular output:     %s\n",             esl_opt_GetString(go, "--tblout"))     < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--domtblout")  && fprintf(ofp, "# per-dom hits tabular output:     %s\n",             esl_opt_GetString(go, "--domtblout"))  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--hitout")     && fprintf(ofp, "# binary hit output:               %s\n",             esl_opt_GetString(go, "--hitout"))  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--pfamtblout") && fprintf(ofp, "# pfam-style tabular hit output:   %s\n",             esl_opt_GetString(go, "--pfamtblout")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--statsout")   && fprintf(ofp, "# JSON search statistics output:   %s\n",             esl_opt_GetString(go, "--statsout"))   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--progress")   && fprintf(ofp, "# progress records every:          %g sec\n",         esl_opt_GetReal(go, "--progress"))     < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--acc")        && fprintf(ofp, "# prefer accessions over names:    yes\n")                                                   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--noali")      && fprintf(ofp, "# show alignments in output:       no\n")                                                    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--notextw")    && fprintf(ofp, "# max ASCII text line length:      unlimited\n")                                             < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
@@ -236,6 +253,7 @@ output_header(FILE *ofp, const ESL_GETOPTS *go, char *hmmfile, char *seqfile)
   if (esl_opt_IsUsed(go, "-T")           && fprintf(ofp, "# sequence reporting threshold:    score >= %g\n",    esl_opt_GetReal(go, "-T"))             < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--domE")       && fprintf(ofp, "# domain reporting threshold:      E-value <= %g\n",  esl_opt_GetReal(go, "--domE"))         < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--domT")       && fprintf(ofp, "# domain reporting threshold:      score >= %g\n",    esl_opt_GetReal(go, "--domT"))         < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--max-hits")   && fprintf(ofp, "# max hits kept:                   %d\n",             esl_opt_GetInteger(go, "--max-hits"))  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--incE")       && fprintf(ofp, "# sequence inclusion threshold:    E-value <= %g\n",  esl_opt_GetReal(go, "--incE"))         < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--incT")       && fprintf(ofp, "# sequence inclusion threshold:    score >= %g\n",    esl_opt_GetReal(go, "--incT"))         < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--incdomE")    && fprintf(ofp, "# domain inclusion threshold:      E-value <= %g\n",  esl_opt_GetReal(go, "--incdomE"))      < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
@@ -253,6 +271,7 @@ output_header(FILE *ofp, const ESL_GETOPTS *go, char *hmmfile, char *seqfile)
   if (esl_opt_IsUsed(go, "--ssifile")          && fprintf(ofp, "# Override ssi file to:            %s\n",            esl_opt_GetString(go, "--ssifile"))       < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 
   if (esl_opt_IsUsed(go, "--nonull2")    && fprintf(ofp, "# null2 bias corrections:          off\n")                                                   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--nosample")   && fprintf(ofp, "# multidomain envelopes:           posterior decoding\n")                                    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "-Z")           && fprintf(ofp, "# sequence search space set to:    %.0f\n",           esl_opt_GetReal(go, "-Z"))             < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--domZ")       && fprintf(ofp, "# domain search space set to:      %.0f\n",           esl_opt_GetReal(go, "--domZ"))         < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--seed"))  {
@@ -260,6 +279,7 @@ output_header(FILE *ofp, const ESL_GETOPTS *go, char *hmmfile, char *seqfile)
     else if (                               fprintf(ofp, "# random number seed set to:       %d\n",             esl_opt_GetInteger(go, "--seed"))      < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   }
   if (esl_opt_IsUsed(go, "--tformat")    && fprintf(ofp, "# targ <seqfile> format asserted:  %s\n",             esl_opt_GetString(go, "--tformat"))    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--qbatch")     && fprintf(ofp, "# query models per database pass:  %d\n",             esl_opt_GetInteger(go, "--qbatch"))    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 #ifdef HMMER_THREADS
   if (esl_opt_IsUsed(go, "--cpu")        && fprintf(ofp, "# number of worker threads:        %d\n",             esl_opt_GetInteger(go, "--cpu"))       < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");  
 #endif
@@ -353,19 +373,26 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   FILE            *afp      = NULL;              /* alignment output file (-A)                      */
   FILE            *tblfp    = NULL;              /* output stream for tabular per-seq (--tblout)    */
   FILE            *domtblfp = NULL;              /* output stream for tabular per-dom (--domtblout) */
+  FILE            *hitfp    = NULL;              /* output stream for binary hit output (--hitout)   */
   FILE            *pfamtblfp= NULL;              /* output stream for pfam tabular output (--pfamtblout)    */
+  FILE            *statsfp  = NULL;              /* JSON lines of search statistics (--statsout)    */
+  P7_PROGRESS     *prg      = NULL;              /* periodic progress records (--progress)          */
   P7_HMMFILE      *hfp      = NULL;              /* open input HMM file                             */
   ESL_SQFILE      *dbfp     = NULL;              /* open input sequence file                        */
-  P7_HMM          *hmm      = NULL;              /* one HMM query                                   */
+  P7_HMM         **hmm      = NULL;              /* batch of query HMMs, [0..qbatch-1]              */
+  P7_OPROFILE    **om       = NULL;              /* optimized query profiles for the batch          */
   ESL_ALPHABET    *abc      = NULL;              /* digital alphabet                                */
   int              dbfmt    = eslSQFILE_UNKNOWN; /* format code for sequence database file          */
   ESL_STOPWATCH   *w;
+  P7_STAGESTATS    stagestats;
   int              textw    = 0;
   int              nquery   = 0;
+  int              qbatch   = esl_opt_GetInteger(go, "--qbatch"); /* max # of queries per pass over <seqdb> */
+  int              nbatch   = 0;                 /* # of queries in the current batch               */
   int              status   = eslOK;
   int              hstatus  = eslOK;
   int              sstatus  = eslOK;
-  int              i;
+  int              i, q;
 
   int              ncpus    = 0;
 
@@ -375,10 +402,12 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   ESL_SQ_BLOCK    *block    = NULL;
   ESL_THREADS     *threadObj= NULL;
   ESL_WORK_QUEUE  *queue    = NULL;
+  P7_DOMAINPOOL   *ddpool   = NULL;
 #endif
   char             errbuf[eslERRBUFSIZE];
 
   w = esl_stopwatch_Create();
+  p7_stagestats_Zero(&stagestats);
 
   if (esl_opt_GetBoolean(go, "--notextw")) textw = 0;
   else                                     textw = esl_opt_GetInteger(go, "--textw");
@@ -416,7 +445,10 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (esl_opt_IsOn(go, "-A"))          { if ((afp      = fopen(esl_opt_GetString(go, "-A"), "w")) == NULL) p7_Fail("Failed to open alignment file %s for writing\n", esl_opt_GetString(go, "-A")); }
   if (esl_opt_IsOn(go, "--tblout"))    { if ((tblfp    = fopen(esl_opt_GetString(go, "--tblout"),    "w")) == NULL)  esl_fatal("Failed to open tabular per-seq output file %s for writing\n", esl_opt_GetString(go, "--tblout")); }
   if (esl_opt_IsOn(go, "--domtblout")) { if ((domtblfp = fopen(esl_opt_GetString(go, "--domtblout"), "w")) == NULL)  esl_fatal("Failed to open tabular per-dom output file %s for writing\n", esl_opt_GetString(go, "--domtblout")); }
+  if (esl_opt_IsOn(go, "--hitout"))    { if ((hitfp    = fopen(esl_opt_GetString(go, "--hitout"),    "wb")) == NULL)  esl_fatal("Failed to open binary hit output file %s for writing\n", esl_opt_GetString(go, "--hitout")); p7_hitfile_WriteMagic(hitfp); }
   if (esl_opt_IsOn(go, "--pfamtblout")){ if ((pfamtblfp = fopen(esl_opt_GetString(go, "--pfamtblout"), "w")) == NULL)  esl_fatal("Failed to open pfam-style tabular output file %s for writing\n", esl_opt_GetString(go, "--pfamtblout")); }
+  if (esl_opt_IsOn(go, "--statsout"))  { if ((statsfp  = fopen(esl_opt_GetString(go, "--statsout"),  "w")) == NULL)  esl_fatal("Failed to open JSON statistics output file %s for writing\n", esl_opt_GetString(go, "--statsout")); }
+  if (esl_opt_IsOn(go, "--progress"))  { if ((prg = p7_progress_Create(statsfp, "hmmsearch", esl_opt_GetReal(go, "--progress"), cfg->dbfile)) == NULL) p7_Fail("Failed to create progress reporter"); }
 
 #ifdef HMMER_THREADS
   /* initialize thread data */
@@ -425,25 +457,32 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
     {
       threadObj = esl_threads_Create(&pipeline_thread);
       queue = esl_workqueue_Create(ncpus * 2);
+      if ((ddpool = p7_domainpool_Create(ncpus)) == NULL) p7_Fail("Failed to create domain definition threads");
     }
 #endif
 
+  /* Each worker gets <qbatch> consecutive WORKER_INFO's, one per query
+   * in the batch: info[t*qbatch + q] is worker <t>'s state for query <q>.
+   */
   infocnt = (ncpus == 0) ? 1 : ncpus;
-  ESL_ALLOC(info, sizeof(*info) * infocnt);
+  ESL_ALLOC(info, sizeof(*info)         * infocnt * qbatch);
+  ESL_ALLOC(hmm,  sizeof(P7_HMM *)      * qbatch);
+  ESL_ALLOC(om,   sizeof(P7_OPROFILE *) * qbatch);
 
   /* <abc> is not known 'til first HMM is read. */
-  hstatus = p7_hmmfile_Read(hfp, &abc, &hmm);
+  hstatus = p7_hmmfile_Read(hfp, &abc, &(hmm[0]));
   if (hstatus == eslOK)
     {
       /* One-time initializations after alphabet <abc> becomes known */
       output_header(ofp, go, cfg->hmmfile, cfg->dbfile);
       esl_sqfile_SetDigital(dbfp, abc); //ReadBlock requires knowledge of the alphabet to decide how best to read blocks
 
-      for (i = 0; i < infocnt; ++i)
+      for (i = 0; i < infocnt * qbatch; ++i)
 	{
-	  info[i].bg    = p7_bg_Create(abc);
+	  info[i].bg     = p7_bg_Create(abc);   /* each query needs its own; p7_pli_NewModel() sets the bg's filter HMM */
+	  info[i].nbatch = 0;
 #ifdef HMMER_THREADS
-	  info[i].queue = queue;
+	  info[i].queue  = queue;
 #endif
 	}
 
@@ -459,17 +498,21 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 #endif
     }
 
-  /* Outer loop: over each query HMM in <hmmfile>. */
+  /* Outer loop: over each batch of query HMMs in <hmmfile>. 
+   * hmm[0] of the batch has already been read.
+   */
   while (hstatus == eslOK) 
     {
       P7_PROFILE      *gm      = NULL;
-      P7_OPROFILE     *om      = NULL;       /* optimized query profile                  */
 
-      nquery++;
+      for (nbatch = 1; nbatch < qbatch; nbatch++)
+	if ((hstatus = p7_hmmfile_Read(hfp, &abc, &(hmm[nbatch]))) != eslOK) break;
+      if (hstatus != eslOK && hstatus != eslEOF) break; /* bad HMM file: fail below, before searching */
+
       esl_stopwatch_Start(w);
 
       /* seqfile may need to be rewound (multiquery mode) */
-      if (nquery > 1)
+      if (nquery > 0)
       {
         if (! esl_sqfile_IsRewindable(dbfp))
           esl_fatal("Target sequence file %s isn't rewindable; can't search it with multiple queries", cfg->dbfile);
@@ -484,35 +527,48 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
           p7_Fail("Failure setting restrictdb_stkey to %d\n", cfg->firstseq_key);
       }
 
-      if (fprintf(ofp, "Query:       %s  [M=%d]\n", hmm->name, hmm->M)  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-      if (hmm->acc)  { if (fprintf(ofp, "Accession:   %s\n", hmm->acc)  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
-      if (hmm->desc) { if (fprintf(ofp, "Description: %s\n", hmm->desc) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
-
-      /* Convert to an optimized model */
-      gm = p7_profile_Create (hmm->M, abc);
-      om = p7_oprofile_Create(hmm->M, abc);
-      p7_ProfileConfig(hmm, info->bg, gm, 100, p7_LOCAL); /* 100 is a dummy length for now; and MSVFilter requires local mode */
-      p7_oprofile_Convert(gm, om);                  /* <om> is now p7_LOCAL, multihit */
+      /* Convert each query to an optimized model */
+      for (q = 0; q < nbatch; q++)
+      {
+        gm    = p7_profile_Create (hmm[q]->M, abc);
+        om[q] = p7_oprofile_Create(hmm[q]->M, abc);
+        p7_ProfileConfig(hmm[q], info->bg, gm, 100, p7_LOCAL); /* 100 is a dummy length for now; and MSVFilter requires local mode */
+        p7_oprofile_Convert(gm, om[q]);                  /* <om> is now p7_LOCAL, multihit */
+        p7_profile_Destroy(gm);
+      }
 
       for (i = 0; i < infocnt; ++i)
       {
-        /* Create processing pipeline and hit list */
-        info[i].th  = p7_tophits_Create();
-        info[i].om  = p7_oprofile_Clone(om);
-        info[i].pli = p7_pipeline_Create(go, om->M, 100, FALSE, p7_SEARCH_SEQS); /* L_hint = 100 is just a dummy for now */
-        status = p7_pli_NewModel(info[i].pli, info[i].om, info[i].bg);
-        if (status == eslEINVAL) p7_Fail(info->pli->errbuf);
+        WORKER_INFO *winfo = info + i * qbatch;
+
+        for (q = 0; q < nbatch; q++)
+        {
+          /* Create processing pipeline and hit list */
+          winfo[q].th  = p7_tophits_Create();
+          if (esl_opt_IsOn(go, "--max-hits")) p7_tophits_SetMaxHits(winfo[q].th, esl_opt_GetInteger(go, "--max-hits"));
+          winfo[q].om  = p7_oprofile_Clone(om[q]);
+          winfo[q].pli = p7_pipeline_Create(go, om[q]->M, 100, FALSE, p7_SEARCH_SEQS); /* L_hint = 100 is just a dummy for now */
+#ifdef HMMER_THREADS
+          winfo[q].pli->ddef->pool = ddpool;
+#endif
+          winfo[q].pli->ddef->do_alignment = FALSE; /* reported domains are aligned after thresholding */
+          status = p7_pli_NewModel(winfo[q].pli, winfo[q].om, winfo[q].bg);
+          if (status == eslEINVAL) p7_Fail(winfo[q].pli->errbuf);
+        }
+        winfo->nbatch = nbatch;
 
 #ifdef HMMER_THREADS
-        if (ncpus > 0) esl_threads_AddThread(threadObj, &info[i]);
+        if (ncpus > 0) esl_threads_AddThread(threadObj, winfo);
 #endif
       }
 
+      if (prg) p7_progress_Start(prg, (nbatch == 1) ? hmm[0]->name : NULL);
+
 #ifdef HMMER_THREADS
-      if (ncpus > 0)  sstatus = thread_loop(threadObj, queue, dbfp, cfg->n_targetseq);
-      else            sstatus = serial_loop(info, dbfp, cfg->n_targetseq);
+      if (ncpus > 0)  sstatus = thread_loop(threadObj, queue, dbfp, cfg->n_targetseq, prg);
+      else            sstatus = serial_loop(info, dbfp, cfg->n_targetseq, prg);
 #else
-      sstatus = serial_loop(info, dbfp, cfg->n_targetseq);
+      sstatus = serial_loop(info, dbfp, cfg->n_targetseq, prg);
 #endif
       switch(sstatus)
       {
@@ -527,60 +583,76 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
         esl_fatal("Unexpected error %d reading sequence file %s", sstatus, dbfp->filename);
       }
 
-      /* merge the results of the search results */
-      for (i = 1; i < infocnt; ++i)
+      esl_stopwatch_Stop(w);
+
+      /* Output each query's results, in the order the queries were read */
+      for (q = 0; q < nbatch; q++)
       {
-        p7_tophits_Merge(info[0].th, info[i].th);
-        p7_pipeline_Merge(info[0].pli, info[i].pli);
+        WORKER_INFO *qinfo = info + q;
 
-        p7_pipeline_Destroy(info[i].pli);
-        p7_tophits_Destroy(info[i].th);
-        p7_oprofile_Destroy(info[i].om);
-      }
+        nquery++;
 
-      /* Print the results.  */
-      p7_tophits_SortBySortkey(info->th);
-      p7_tophits_Threshold(info->th, info->pli);
-      p7_tophits_Targets(ofp, info->th, info->pli, textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-      p7_tophits_Domains(ofp, info->th, info->pli, textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-
-      if (tblfp)     p7_tophits_TabularTargets(tblfp,    hmm->name, hmm->acc, info->th, info->pli, (nquery == 1));
-      if (domtblfp)  p7_tophits_TabularDomains(domtblfp, hmm->name, hmm->acc, info->th, info->pli, (nquery == 1));
-      if (pfamtblfp) p7_tophits_TabularXfam(pfamtblfp, hmm->name, hmm->acc, info->th, info->pli);
-  
-      esl_stopwatch_Stop(w);
-      p7_pli_Statistics(ofp, info->pli, w);
-      if (fprintf(ofp, "//\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+        /* merge the results of the search results */
+        for (i = 1; i < infocnt; ++i)
+        {
+          p7_tophits_Merge(qinfo->th, info[i * qbatch + q].th);
+          p7_pipeline_Merge(qinfo->pli, info[i * qbatch + q].pli);
 
-      /* Output the results in an MSA (-A option) */
-      if (afp) {
-	ESL_MSA *msa = NULL;
+          p7_pipeline_Destroy(info[i * qbatch + q].pli);
+          p7_tophits_Destroy(info[i * qbatch + q].th);
+          p7_oprofile_Destroy(info[i * qbatch + q].om);
+        }
 
-	if (p7_tophits_Alignment(info->th, abc, NULL, NULL, 0, p7_ALL_CONSENSUS_COLS, &msa) == eslOK)
-	  {
-	    esl_msa_SetName     (msa, hmm->name, -1);
-	    esl_msa_SetAccession(msa, hmm->acc,  -1);
-	    esl_msa_SetDesc     (msa, hmm->desc, -1);
-	    esl_msa_FormatAuthor(msa, "hmmsearch (HMMER %s)", HMMER_VERSION);
+        if (fprintf(ofp, "Query:       %s  [M=%d]\n", hmm[q]->name, hmm[q]->M)  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+        if (hmm[q]->acc)  { if (fprintf(ofp, "Accession:   %s\n", hmm[q]->acc)  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
+        if (hmm[q]->desc) { if (fprintf(ofp, "Description: %s\n", hmm[q]->desc) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
+
+        /* Print the results.  */
+        p7_tophits_SortBySortkey(qinfo->th);
+        p7_tophits_Threshold(qinfo->th, qinfo->pli);
+        if (p7_tophits_AlignDomains(qinfo->th, qinfo->om, qinfo->pli->do_stagestats ? &(qinfo->pli->stats) : NULL) != eslOK) p7_Fail("Failed to align reported domains");
+        p7_tophits_Targets(ofp, qinfo->th, qinfo->pli, textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+        p7_tophits_Domains(ofp, qinfo->th, qinfo->pli, textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+
+        if (tblfp)     p7_tophits_TabularTargets(tblfp,    hmm[q]->name, hmm[q]->acc, qinfo->th, qinfo->pli, (nquery == 1));
+        if (domtblfp)  p7_tophits_TabularDomains(domtblfp, hmm[q]->name, hmm[q]->acc, qinfo->th, qinfo->pli, (nquery == 1));
+        if (hitfp)     p7_hitfile_Write(hitfp, hmm[q]->name, hmm[q]->acc, qinfo->th, qinfo->pli);
+        if (pfamtblfp) p7_tophits_TabularXfam(pfamtblfp, hmm[q]->name, hmm[q]->acc, qinfo->th, qinfo->pli);
+
+        p7_pli_Statistics(ofp, qinfo->pli, w);  /* with --qbatch > 1, elapsed time is for the whole batch */
+        if (statsfp) p7_pli_JSONStatistics(statsfp, "hmmsearch", hmm[q]->name, qinfo->pli, qinfo->th, w, ncpus);
+        p7_stagestats_Merge(&stagestats, &(qinfo->pli->stats));
+        if (fprintf(ofp, "//\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+
+        /* Output the results in an MSA (-A option) */
+        if (afp) {
+          ESL_MSA *msa = NULL;
+
+          if (p7_tophits_Alignment(qinfo->th, abc, NULL, NULL, 0, p7_ALL_CONSENSUS_COLS, &msa) == eslOK)
+            {
+              esl_msa_SetName     (msa, hmm[q]->name, -1);
+              esl_msa_SetAccession(msa, hmm[q]->acc,  -1);
+              esl_msa_SetDesc     (msa, hmm[q]->desc, -1);
+              esl_msa_FormatAuthor(msa, "hmmsearch (HMMER %s)", HMMER_VERSION);
+
+              if (textw > 0) esl_msafile_Write(afp, msa, eslMSAFILE_STOCKHOLM);
+              else           esl_msafile_Write(afp, msa, eslMSAFILE_PFAM);
+
+              if (fprintf(ofp, "# Alignment of %d hits satisfying inclusion thresholds saved to: %s\n", msa->nseq, esl_opt_GetString(go, "-A")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+            } 
+          else { if (fprintf(ofp, "# No hits satisfy inclusion thresholds; no alignment saved\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
+
+          esl_msa_Destroy(msa);
+        }
 
-	    if (textw > 0) esl_msafile_Write(afp, msa, eslMSAFILE_STOCKHOLM);
-	    else           esl_msafile_Write(afp, msa, eslMSAFILE_PFAM);
-	  
-	    if (fprintf(ofp, "# Alignment of %d hits satisfying inclusion thresholds saved to: %s\n", msa->nseq, esl_opt_GetString(go, "-A")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-	  } 
-	else { if (fprintf(ofp, "# No hits satisfy inclusion thresholds; no alignment saved\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
-	  
-	esl_msa_Destroy(msa);
+        p7_pipeline_Destroy(qinfo->pli);
+        p7_tophits_Destroy(qinfo->th);
+        p7_oprofile_Destroy(qinfo->om);
+        p7_oprofile_Destroy(om[q]);
+        p7_hmm_Destroy(hmm[q]);
       }
 
-      p7_pipeline_Destroy(info->pli);
-      p7_tophits_Destroy(info->th);
-      p7_oprofile_Destroy(info->om);
-      p7_oprofile_Destroy(om);
-      p7_profile_Destroy(gm);
-      p7_hmm_Destroy(hmm);
-
-      hstatus = p7_hmmfile_Read(hfp, &abc, &hmm);
+      if (hstatus == eslOK) hstatus = p7_hmmfile_Read(hfp, &abc, &(hmm[0]));
     } /* end outer loop over query HMMs */
 
   switch(hstatus) {
@@ -594,14 +666,20 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
   /* Terminate outputs... any last words?
    */
+  if (esl_opt_GetBoolean(go, "--stagestats")) {
+    if (tblfp)     p7_pli_TabularStageStats(tblfp,     &stagestats);
+    if (domtblfp)  p7_pli_TabularStageStats(domtblfp,  &stagestats);
+    if (pfamtblfp) p7_pli_TabularStageStats(pfamtblfp, &stagestats);
+  }
   if (tblfp)    p7_tophits_TabularTail(tblfp,    "hmmsearch", p7_SEARCH_SEQS, cfg->hmmfile, cfg->dbfile, go);
   if (domtblfp) p7_tophits_TabularTail(domtblfp, "hmmsearch", p7_SEARCH_SEQS, cfg->hmmfile, cfg->dbfile, go);
+  if (hitfp)    p7_hitfile_WriteTail(hitfp, "hmmsearch", p7_SEARCH_SEQS, cfg->hmmfile, cfg->dbfile, go);
   if (pfamtblfp) p7_tophits_TabularTail(pfamtblfp,"hmmsearch", p7_SEARCH_SEQS, cfg->hmmfile, cfg->dbfile, go);
   if (ofp)      { if (fprintf(ofp, "[ok]\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
 
   /* Cleanup - prepare for exit
    */
-  for (i = 0; i < infocnt; ++i)
+  for (i = 0; i < infocnt * qbatch; ++i)
     p7_bg_Destroy(info[i].bg);
 
 #ifdef HMMER_THREADS
@@ -612,10 +690,14 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 	esl_sq_DestroyBlock(block);
       esl_workqueue_Destroy(queue);
       esl_threads_Destroy(threadObj);
+      p7_domainpool_Destroy(ddpool);
     }
 #endif
 
   free(info);
+  free(hmm);
+  free(om);
+  p7_progress_Destroy(prg);
   p7_hmmfile_Close(hfp);
   esl_sqfile_Close(dbfp);
   esl_alphabet_Destroy(abc);
@@ -625,7 +707,9 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (afp)           fclose(afp);
   if (tblfp)         fclose(tblfp);
   if (domtblfp)      fclose(domtblfp);
+  if (hitfp)         fclose(hitfp);
   if (pfamtblfp)     fclose(pfamtblfp);
+  if (statsfp)       fclose(statsfp);
 
   return eslOK;
 
@@ -688,7 +772,17 @@ mpi_failure(char *format, ...)
     }
 }
 
-#define MAX_BLOCK_SIZE (512*1024)
+/* The database is indexed in small chunks of whole sequences (about
+ * CHUNK_SIZE bytes each) as the master reads it. Chunks are what the
+ * BLOCK_LIST remembers for later queries; what is sent to a worker
+ * is a block of consecutive chunks, sized to the worker's measured
+ * throughput so that each block takes about BLOCK_SECONDS. A worker
+ * we don't have a measurement for yet gets INIT_BLOCK_SIZE bytes.
+ */
+#define CHUNK_SIZE      (64*1024)
+#define INIT_BLOCK_SIZE (512*1024)
+#define MAX_BLOCK_SIZE  (64*1024*1024)
+#define BLOCK_SECONDS   2.0
 
 typedef struct {
   uint64_t  offset;
@@ -701,64 +795,53 @@ typedef struct {
   int        size;
   int        current;
   int        last;
+  uint64_t   nbytes;		/* total length of chunks 0..last-1 */
   SEQ_BLOCK *blocks;
 } BLOCK_LIST;
 
-/* this routine parses the database keeping track of the blocks
+/* this routine parses the database keeping track of the chunks
  * offset within the file, number of sequences and the length
- * of the block.  These blocks are passed as work units to the
- * MPI workers.  If multiple hmm's are in the query file, the
- * blocks are reused without parsing the database a second time.
+ * of the chunk.  If multiple hmm's are in the query file, the
+ * chunks are reused without parsing the database a second time.
  */
-int next_block(ESL_SQFILE *sqfp, ESL_SQ *sq, BLOCK_LIST *list, SEQ_BLOCK *block, int n_targetseqs)
+static int
+next_chunk(ESL_SQFILE *sqfp, ESL_SQ *sq, BLOCK_LIST *list, SEQ_BLOCK *chunk, int n_targetseqs)
 {
   int      status   = eslOK;
 
-  /* if the list has been calculated, use it instead of parsing the database */
-  if (list->complete)
+  /* use chunks we've already seen before parsing any more of the database */
+  if (list->current < list->last)
     {
-      if (list->current == list->last)
-      {
-        block->offset = 0;
-        block->length = 0;
-        block->count  = 0;
-
-        status = eslEOF;
-      }
-      else
-      {
-        int inx = list->current++;
+      int inx = list->current++;
 
-        block->offset = list->blocks[inx].offset;
-        block->length = list->blocks[inx].length;
-        block->count  = list->blocks[inx].count;
-
-        status = eslOK;
-      }
+      chunk->offset = list->blocks[inx].offset;
+      chunk->length = list->blocks[inx].length;
+      chunk->count  = list->blocks[inx].count;
 
-      return status;
+      return eslOK;
     }
+  if (list->complete) return eslEOF;
 
-  block->offset = 0;
-  block->length = 0;
-  block->count = 0;
+  chunk->offset = 0;
+  chunk->length = 0;
+  chunk->count = 0;
 
   esl_sq_Reuse(sq);
   if (n_targetseqs == 0) status = eslEOF; //this is to handle the end-case of a restrictdb scenario, where no more targets are required, and we want to mark the list as complete
-  while (block->length < MAX_BLOCK_SIZE && (n_targetseqs <0 || block->count < n_targetseqs) && (status = esl_sqio_ReadInfo(sqfp, sq)) == eslOK)
+  while (chunk->length < CHUNK_SIZE && (n_targetseqs <0 || chunk->count < n_targetseqs) && (status = esl_sqio_ReadInfo(sqfp, sq)) == eslOK)
     {
-      if (block->count == 0) block->offset = sq->roff;
-      block->length = sq->eoff - block->offset + 1;
-      block->count++;
+      if (chunk->count == 0) chunk->offset = sq->roff;
+      chunk->length = sq->eoff - chunk->offset + 1;
+      chunk->count++;
       esl_sq_Reuse(sq);
     }
 
-  if (block->count > 0)
-    if (status == eslEOF || block->count == n_targetseqs)
+  if (chunk->count > 0)
+    if (status == eslEOF || chunk->count == n_targetseqs)
       status = eslOK;
   if (status == eslEOF) list->complete = 1;
 
-  /* add the block to the list of known blocks */
+  /* add the chunk to the list of known chunks */
   if (status == eslOK)
     {
       int inx;
@@ -771,9 +854,11 @@ int next_block(ESL_SQFILE *sqfp, ESL_SQ *sq, BLOCK_LIST *list, SEQ_BLOCK *block,
 	}
 
       inx = list->last++;
-      list->blocks[inx].offset = block->offset;
-      list->blocks[inx].length = block->length;
-      list->blocks[inx].count  = block->count;
+      list->blocks[inx].offset = chunk->offset;
+      list->blocks[inx].length = chunk->length;
+      list->blocks[inx].count  = chunk->count;
+      list->nbytes            += chunk->length;
+      list->current            = list->last;
     }
 
   return status;
@@ -782,6 +867,98 @@ int next_block(ESL_SQFILE *sqfp, ESL_SQ *sq, BLOCK_LIST *list, SEQ_BLOCK *block,
   return eslEMEM;
 }
 
+/* next_block()
+ * Build the next work unit for a worker from consecutive chunks,
+ * until it is at least <target> bytes long; a block spans the file
+ * from its first chunk's first sequence to its last chunk's last.
+ * Returns <eslEOF> when there are no more sequences (within the
+ * <n_targetseqs> limit, if that is >= 0).
+ */
+static int
+next_block(ESL_SQFILE *sqfp, ESL_SQ *sq, BLOCK_LIST *list, SEQ_BLOCK *block, int n_targetseqs, uint64_t target)
+{
+  SEQ_BLOCK chunk;
+  int       status;
+
+  block->offset = 0;
+  block->length = 0;
+  block->count  = 0;
+
+  while (block->length < target)
+    {
+      status = next_chunk(sqfp, sq, list, &chunk, (n_targetseqs < 0) ? -1 : n_targetseqs - (int) block->count);
+      if      (status == eslEOF) break;
+      else if (status != eslOK)  return status;
+
+      if (block->count == 0) block->offset = chunk.offset;
+      block->length = chunk.offset + chunk.length - block->offset;
+      block->count += chunk.count;
+    }
+
+  return (block->count > 0) ? eslOK : eslEOF;
+}
+
+/* block_target()
+ * Size the next block for a worker whose throughput is <rate>
+ * bytes/sec (0 if unknown). Once the whole database has been indexed
+ * and we know how much is left (<remaining> bytes), blocks are also
+ * capped at a fraction of each worker's fair share, so the last few
+ * blocks are small and ranks finish together.
+ */
+static uint64_t
+block_target(double rate, BLOCK_LIST *list, uint64_t remaining, int nworkers)
+{
+  uint64_t target = (rate > 0.) ? (uint64_t) (rate * BLOCK_SECONDS) : INIT_BLOCK_SIZE;
+
+  if (list->complete) target = ESL_MIN(target, remaining / (2 * nworkers));
+  return ESL_MAX(CHUNK_SIZE, ESL_MIN(target, MAX_BLOCK_SIZE));
+}
+
+/* mpi_recv_ready()
+ * Wait for the next message from any worker, which must be tagged
+ * <expect>; return the worker's rank. A READY message carries the
+ * worker's {bytes, seconds} for the last block it finished ({0,0} if
+ * none); if <opt_stats> is non-NULL, it is set to those.
+ */
+static int
+mpi_recv_ready(int expect, char **mpi_buf, int *mpi_size, double *opt_stats)
+{
+  MPI_Status  mpistatus;
+  int         size;
+  int         dest;
+  int         pos;
+  int         status;
+
+  if (MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &mpistatus) != 0)
+    mpi_failure("MPI error %d receiving message from %d\n", mpistatus.MPI_SOURCE);
+
+  MPI_Get_count(&mpistatus, MPI_PACKED, &size);
+  if (*mpi_buf == NULL || size > *mpi_size) {
+    void *tmp;
+    ESL_RALLOC(*mpi_buf, tmp, sizeof(char) * size);
+    *mpi_size = size;
+  }
+
+  dest = mpistatus.MPI_SOURCE;
+  MPI_Recv(*mpi_buf, size, MPI_PACKED, dest, mpistatus.MPI_TAG, MPI_COMM_WORLD, &mpistatus);
+
+  if (mpistatus.MPI_TAG == HMMER_ERROR_TAG)
+    mpi_failure("MPI client %d raised error:\n%s\n", dest, *mpi_buf);
+  if (mpistatus.MPI_TAG != expect)
+    mpi_failure("Unexpected tag %d from %d\n", mpistatus.MPI_TAG, dest);
+
+  if (opt_stats != NULL) {
+    pos = 0;
+    if (MPI_Unpack(*mpi_buf, size, &pos, opt_stats, 2, MPI_DOUBLE, MPI_COMM_WORLD) != 0)
+      mpi_failure("Failed to unpack ready message from %d\n", dest);
+  }
+  return dest;
+
+ ERROR:
+  mpi_failure("Failed to allocate MPI receive buffer\n");
+  return status;
+}
+
 /* mpi_master()
  * The MPI version of hmmbuild.
  * Follows standard pattern for a master/worker load-balanced MPI program (J1/78-79).
@@ -807,7 +984,9 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   FILE            *afp      = NULL;              /* alignment output file (-A)                      */
   FILE            *tblfp    = NULL;              /* output stream for tabular per-seq (--tblout)    */
   FILE            *domtblfp = NULL;              /* output stream for tabular per-dom (--domtblout) */
+  FILE            *hitfp    = NULL;              /* output stream for binary hit output (--hitout)   */
   FILE            *pfamtblfp= NULL;              /* output stream for pfam-style tabular output  (--pfamtblout) */
+  FILE            *statsfp  = NULL;              /* JSON lines of search statistics (--statsout)    */
   P7_BG           *bg       = NULL;	         /* null model                                      */
   P7_HMMFILE      *hfp      = NULL;              /* open input HMM file                             */
   ESL_SQFILE      *dbfp     = NULL;              /* open input sequence file                        */
@@ -816,6 +995,7 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   ESL_ALPHABET    *abc      = NULL;              /* digital alphabet                                */
   int              dbfmt    = eslSQFILE_UNKNOWN; /* format code for sequence database file          */
   ESL_STOPWATCH   *w;
+  P7_STAGESTATS    stagestats;
   int              textw    = 0;
   int              nquery   = 0;
   int              status   = eslOK;
@@ -827,15 +1007,17 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   int              mpi_size = 0;                 /* size of the allocated buffer */
   BLOCK_LIST      *list     = NULL;
   SEQ_BLOCK        block;
+  double          *rate     = NULL;              /* each worker's throughput, bytes/sec; 0 if unknown */
+  double           stats[2];                     /* {bytes, seconds} a worker reports for its last block */
 
   int              i;
-  int              size;
-  MPI_Status       mpistatus;
+  int              nidle;
   char             errbuf[eslERRBUFSIZE];
 
   int              n_targets;
 
   w = esl_stopwatch_Create();
+  p7_stagestats_Zero(&stagestats);
 
   if (esl_opt_GetBoolean(go, "--notextw")) textw = 0;
   else                                     textw = esl_opt_GetInteger(go, "--textw");
@@ -878,17 +1060,25 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
   if (esl_opt_IsOn(go, "--domtblout") && (domtblfp = fopen(esl_opt_GetString(go, "--domtblout"), "w")) == NULL)
     mpi_failure("Failed to open tabular per-dom output file %s for writing\n", esl_opt_GetString(go, "--domtblout"));
+  if (esl_opt_IsOn(go, "--hitout") && (hitfp = fopen(esl_opt_GetString(go, "--hitout"), "wb")) == NULL)
+    mpi_failure("Failed to open binary hit output file %s for writing\n", esl_opt_GetString(go, "--hitout"));
+  if (hitfp) p7_hitfile_WriteMagic(hitfp);
 
   if (esl_opt_IsOn(go, "--pfamtblout") && (pfamtblfp = fopen(esl_opt_GetString(go, "--pfamtblout"), "w")) == NULL)
     mpi_failure("Failed to open pfam-style tabular output file %s for writing\n", esl_opt_GetString(go, "--pfamtblout"));
+  if (esl_opt_IsOn(go, "--statsout") && (statsfp = fopen(esl_opt_GetString(go, "--statsout"), "w")) == NULL)
+    mpi_failure("Failed to open JSON statistics output file %s for writing\n", esl_opt_GetString(go, "--statsout"));
 
   ESL_ALLOC(list, sizeof(BLOCK_LIST));
   list->complete = 0;
   list->size     = 0;
   list->current  = 0;
   list->last     = 0;
+  list->nbytes   = 0;
   list->blocks   = NULL;
 
+  ESL_ALLOC(rate, sizeof(double) * cfg->nproc);
+
   /* <abc> is not known 'til first HMM is read. */
   hstatus = p7_hmmfile_Read(hfp, &abc, &hmm);
   if (hstatus == eslOK)
@@ -914,6 +1104,7 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
       P7_PIPELINE     *pli     = NULL;
       P7_TOPHITS      *th      = NULL;
       int              seq_cnt = 0;
+      uint64_t         dispatched = 0;
       nquery++;
       esl_stopwatch_Start(w);
 
@@ -921,6 +1112,7 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
       /* seqfile may need to be rewound (multiquery mode) */
       if (nquery > 1)   list->current = 0;
+      for (i = 0; i < cfg->nproc; ++i) rate[i] = 0.;
 
       if (fprintf(ofp, "Query:       %s  [M=%d]\n", hmm->name, hmm->M)  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
       if (hmm->acc)  { if (fprintf(ofp, "Accession:   %s\n", hmm->acc)  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
@@ -934,32 +1126,26 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
       /* Create processing pipeline and hit list */
       th  = p7_tophits_Create(); 
+      if (esl_opt_IsOn(go, "--max-hits")) p7_tophits_SetMaxHits(th, esl_opt_GetInteger(go, "--max-hits"));
       pli = p7_pipeline_Create(go, hmm->M, 100, FALSE, p7_SEARCH_SEQS);
       p7_pli_NewModel(pli, om, bg);
 
-      /* Main loop: */
-      while ((n_targets==-1 || seq_cnt<=n_targets) && (sstatus = next_block(dbfp, dbsq, list, &block, n_targets-seq_cnt)) == eslOK )
+      /* Main loop: hand the next block to whichever worker asks for one,
+       * sized by that worker's throughput on the blocks it has done.
+       */
+      nidle = 0;
+      while (n_targets==-1 || seq_cnt<=n_targets)
       {
-        seq_cnt += block.count;
-
-        if (MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &mpistatus) != 0)
-          mpi_failure("MPI error %d receiving message from %d\n", mpistatus.MPI_SOURCE);
-
-        MPI_Get_count(&mpistatus, MPI_PACKED, &size);
-        if (mpi_buf == NULL || size > mpi_size) {
-          void *tmp;
-          ESL_RALLOC(mpi_buf, tmp, sizeof(char) * size);
-          mpi_size = size;
-        }
-
-        dest = mpistatus.MPI_SOURCE;
-        MPI_Recv(mpi_buf, size, MPI_PACKED, dest, mpistatus.MPI_TAG, MPI_COMM_WORLD, &mpistatus);
+        dest = mpi_recv_ready(HMMER_READY_TAG, &mpi_buf, &mpi_size, stats);
+        if (stats[1] > 0.)
+          rate[dest] = (rate[dest] > 0.) ? 0.5 * (rate[dest] + stats[0] / stats[1]) : stats[0] / stats[1];
 
-        if (mpistatus.MPI_TAG == HMMER_ERROR_TAG)
-          mpi_failure("MPI client %d raised error:\n%s\n", dest, mpi_buf);
-        if (mpistatus.MPI_TAG != HMMER_READY_TAG)
-          mpi_failure("Unexpected tag %d from %d\n", mpistatus.MPI_TAG, dest);
+        sstatus = next_block(dbfp, dbsq, list, &block, (n_targets == -1) ? -1 : n_targets-seq_cnt,
+                             block_target(rate[dest], list, (dispatched < list->nbytes) ? list->nbytes - dispatched : 0, cfg->nproc-1));
+        if (sstatus != eslOK) { nidle = 1; break; } /* <dest>'s READY is already consumed */
 
+        seq_cnt    += block.count;
+        dispatched += block.length;
         MPI_Send(&block, 3, MPI_LONG_LONG_INT, dest, HMMER_BLOCK_TAG, MPI_COMM_WORLD);
       }
 
@@ -982,26 +1168,8 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
       block.count  = 0;
 
       /* wait for all workers to finish up their work blocks */
-      for (i = 1; i < cfg->nproc; ++i)
-	{
-	  if (MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &mpistatus) != 0) 
-	    mpi_failure("MPI error %d receiving message from %d\n", mpistatus.MPI_SOURCE);
-
-	  MPI_Get_count(&mpistatus, MPI_PACKED, &size);
-	  if (mpi_buf == NULL || size > mpi_size) {
-	    void *tmp;
-	    ESL_RALLOC(mpi_buf, tmp, sizeof(char) * size);
-	    mpi_size = size; 
-	  }
-
-	  dest = mpistatus.MPI_SOURCE;
-	  MPI_Recv(mpi_buf, size, MPI_PACKED, dest, mpistatus.MPI_TAG, MPI_COMM_WORLD, &mpistatus);
-
-	  if (mpistatus.MPI_TAG == HMMER_ERROR_TAG)
-	    mpi_failure("MPI client %d raised error:\n%s\n", dest, mpi_buf);
-	  if (mpistatus.MPI_TAG != HMMER_READY_TAG)
-	    mpi_failure("Unexpected tag %d from %d\n", mpistatus.MPI_TAG, dest);
-	}
+      for (i = 1 + nidle; i < cfg->nproc; ++i)
+        mpi_recv_ready(HMMER_READY_TAG, &mpi_buf, &mpi_size, NULL);
 
       /* merge the results of the search results */
       for (dest = 1; dest < cfg->nproc; ++dest)
@@ -1034,10 +1202,13 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
       if (tblfp)    p7_tophits_TabularTargets(tblfp,    hmm->name, hmm->acc, th, pli, (nquery == 1));
       if (domtblfp) p7_tophits_TabularDomains(domtblfp, hmm->name, hmm->acc, th, pli, (nquery == 1));
+      if (hitfp)     p7_hitfile_Write(hitfp, hmm->name, hmm->acc, th, pli);
       if (pfamtblfp) p7_tophits_TabularXfam(pfamtblfp, hmm->name, hmm->acc, th, pli);
 
       esl_stopwatch_Stop(w);
       p7_pli_Statistics(ofp, pli, w);
+      if (statsfp) p7_pli_JSONStatistics(statsfp, "hmmsearch", hmm->name, pli, th, w, 0);
+      p7_stagestats_Merge(&stagestats, &(pli->stats));
       if (fprintf(ofp, "//\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 
       /* Output the results in an MSA (-A option) */
@@ -1078,36 +1249,26 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
   /* monitor all the workers to make sure they have ended */
   for (i = 1; i < cfg->nproc; ++i)
-    {
-      if (MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &mpistatus) != 0) 
-	mpi_failure("MPI error %d receiving message from %d\n", mpistatus.MPI_SOURCE);
-
-      MPI_Get_count(&mpistatus, MPI_PACKED, &size);
-      if (mpi_buf == NULL || size > mpi_size) {
-	void *tmp;
-	ESL_RALLOC(mpi_buf, tmp, sizeof(char) * size);
-	mpi_size = size; 
-      }
-
-      dest = mpistatus.MPI_SOURCE;
-      MPI_Recv(mpi_buf, size, MPI_PACKED, dest, mpistatus.MPI_TAG, MPI_COMM_WORLD, &mpistatus);
-
-      if (mpistatus.MPI_TAG == HMMER_ERROR_TAG)
-	mpi_failure("MPI client %d raised error:\n%s\n", dest, mpi_buf);
-      if (mpistatus.MPI_TAG != HMMER_TERMINATING_TAG)
-	mpi_failure("Unexpected tag %d from %d\n", mpistatus.MPI_TAG, dest);
-    }
+    mpi_recv_ready(HMMER_TERMINATING_TAG, &mpi_buf, &mpi_size, NULL);
 
   /* Terminate outputs... any last words?
    */
+  if (esl_opt_GetBoolean(go, "--stagestats")) {
+    if (tblfp)     p7_pli_TabularStageStats(tblfp,     &stagestats);
+    if (domtblfp)  p7_pli_TabularStageStats(domtblfp,  &stagestats);
+    if (pfamtblfp) p7_pli_TabularStageStats(pfamtblfp, &stagestats);
+  }
   if (tblfp)    p7_tophits_TabularTail(tblfp,     "hmmsearch", p7_SEARCH_SEQS, cfg->hmmfile, cfg->dbfile, go);
   if (domtblfp) p7_tophits_TabularTail(domtblfp,  "hmmsearch", p7_SEARCH_SEQS, cfg->hmmfile, cfg->dbfile, go);
+  if (hitfp)    p7_hitfile_WriteTail(hitfp, "hmmsearch", p7_SEARCH_SEQS, cfg->hmmfile, cfg->dbfile, go);
   if (pfamtblfp)p7_tophits_TabularTail(pfamtblfp, "hmmsearch", p7_SEARCH_SEQS, cfg->hmmfile, cfg->dbfile, go);
   if (ofp)     { if (fprintf(ofp, "[ok]\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
 
   /* Cleanup - prepare for exit
    */
+  if (list->blocks != NULL) free(list->blocks);
   free(list);
+  free(rate);
   if (mpi_buf != NULL) free(mpi_buf);
 
   p7_hmmfile_Close(hfp);
@@ -1121,7 +1282,9 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (afp)           fclose(afp);
   if (tblfp)         fclose(tblfp);
   if (domtblfp)      fclose(domtblfp);
+  if (hitfp)         fclose(hitfp);
   if (pfamtblfp)     fclose(pfamtblfp);
+  if (statsfp)       fclose(statsfp);
 
   return eslOK;
 
@@ -1130,6 +1293,21 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 }
 
 
+/* mpi_send_ready()
+ * Ask the master for another block, reporting how long the last one
+ * took: <stats> is {bytes, seconds}, or {0,0} if there isn't one.
+ */
+static void
+mpi_send_ready(double *stats)
+{
+  char buf[64];
+  int  pos = 0;
+
+  if (MPI_Pack(stats, 2, MPI_DOUBLE, buf, sizeof(buf), &pos, MPI_COMM_WORLD) != 0)
+    mpi_failure("Failed to pack ready message\n");
+  MPI_Send(buf, pos, MPI_PACKED, 0, HMMER_READY_TAG, MPI_COMM_WORLD);
+}
+
 static int
 mpi_worker(ESL_GETOPTS *go, struct cfg_s *cfg)
 {
@@ -1141,6 +1319,7 @@ mpi_worker(ESL_GETOPTS *go, struct cfg_s *cfg)
   ESL_SQFILE      *dbfp     = NULL;              /* open input sequence file                        */
   int              dbfmt    = eslSQFILE_UNKNOWN; /* format code for sequence database file          */
   ESL_STOPWATCH   *w;
+  ESL_STOPWATCH   *bw;                           /* times each block, for the master's load balancing */
   int              status   = eslOK;
   int              hstatus  = eslOK;
   int              sstatus  = eslOK;
@@ -1149,9 +1328,11 @@ mpi_worker(ESL_GETOPTS *go, struct cfg_s *cfg)
   int              mpi_size = 0;                 /* size of the allocated buffer                    */
 
   MPI_Status       mpistatus;
+  MPI_Request      mpireq;
   char             errbuf[eslERRBUFSIZE];
 
-  w = esl_stopwatch_Create();
+  w  = esl_stopwatch_Create();
+  bw = esl_stopwatch_Create();
 
   /* Open the target sequence database */
   status = esl_sqfile_Open(cfg->dbfile, dbfmt, p7_SEQDBENV, &dbfp);
@@ -1185,11 +1366,12 @@ mpi_worker(ESL_GETOPTS *go, struct cfg_s *cfg)
       P7_TOPHITS      *th      = NULL;
 
       SEQ_BLOCK        block;
+      SEQ_BLOCK        next;
+      double           stats[2] = { 0., 0. };
 
       esl_stopwatch_Start(w);
 
-      status = 0;
-      MPI_Send(&status, 1, MPI_INT, 0, HMMER_READY_TAG, MPI_COMM_WORLD);
+      mpi_send_ready(stats);
 
       /* Convert to an optimized model */
       gm = p7_profile_Create (hmm->M, abc);
@@ -1198,6 +1380,7 @@ mpi_worker(ESL_GETOPTS *go, struct cfg_s *cfg)
       p7_oprofile_Convert(gm, om);
 
       th  = p7_tophits_Create(); 
+      if (esl_opt_IsOn(go, "--max-hits")) p7_tophits_SetMaxHits(th, esl_opt_GetInteger(go, "--max-hits"));
       pli = p7_pipeline_Create(go, om->M, 100, FALSE, p7_SEARCH_SEQS); /* L_hint = 100 is just a dummy for now */
       p7_pli_NewModel(pli, om, bg);
 
@@ -1208,6 +1391,11 @@ mpi_worker(ESL_GETOPTS *go, struct cfg_s *cfg)
 	  uint64_t length = 0;
 	  uint64_t count  = block.count;
 
+	  /* ask for the next block now, so it's here by the time this one is done */
+	  mpi_send_ready(stats);
+	  MPI_Irecv(&next, 3, MPI_LONG_LONG_INT, 0, HMMER_BLOCK_TAG, MPI_COMM_WORLD, &mpireq);
+
+	  esl_stopwatch_Start(bw);
 	  status = esl_sqfile_Position(dbfp, block.offset);
 	  if (status != eslOK) mpi_failure("Cannot position sequence database to %ld\n", block.offset);
 
@@ -1216,8 +1404,7 @@ mpi_worker(ESL_GETOPTS *go, struct cfg_s *cfg)
 	      length = dbsq->eoff - block.offset + 1;
 
 	      p7_pli_NewSeq(pli, dbsq);
-	      p7_bg_SetLength(bg, dbsq->n);
-	      p7_oprofile_ReconfigLength(om, dbsq->n);
+	      p7_pli_SetTargetLength(pli, om, bg, dbsq->n);
       
 	      p7_Pipeline(pli, om, bg, dbsq, NULL, th);
 
@@ -1231,12 +1418,13 @@ mpi_worker(ESL_GETOPTS *go, struct cfg_s *cfg)
 	  if (count > 0)              mpi_failure("Block count mismatch - expected %ld found %ld at offset %ld\n",  block.count,  block.count - count, block.offset);
 	  if (block.length != length) mpi_failure("Block length mismatch - expected %ld found %ld at offset %ld\n", block.length, length,              block.offset);
 
-	  /* inform the master we need another block of sequences */
-	  status = 0;
-	  MPI_Send(&status, 1, MPI_INT, 0, HMMER_READY_TAG, MPI_COMM_WORLD);
+	  esl_stopwatch_Stop(bw);
+	  stats[0] = (double) block.length;
+	  stats[1] = bw->elapsed;
 
-	  /* wait for the next block of sequences */
-	  MPI_Recv(&block, 3, MPI_LONG_LONG_INT, 0, HMMER_BLOCK_TAG, MPI_COMM_WORLD, &mpistatus);
+	  /* the next block of sequences; an empty one means we're done */
+	  MPI_Wait(&mpireq, &mpistatus);
+	  block = next;
 	}
 
       esl_stopwatch_Stop(w);
@@ -1280,32 +1468,43 @@ mpi_worker(ESL_GETOPTS *go, struct cfg_s *cfg)
   p7_bg_Destroy(bg);
   esl_sq_Destroy(dbsq);
   esl_stopwatch_Destroy(w);
+  esl_stopwatch_Destroy(bw);
 
   return eslOK;
 }
 #endif /*HMMER_MPI*/
 
+/* serial_loop()
+ * Read the target database once, passing each sequence through
+ * the pipeline of each of the <info->nbatch> queries in <info[]>.
+ * If <prg> is non-NULL, count each sequence read on it.
+ */
 static int
-serial_loop(WORKER_INFO *info, ESL_SQFILE *dbfp, int n_targetseqs)
+serial_loop(WORKER_INFO *info, ESL_SQFILE *dbfp, int n_targetseqs, P7_PROGRESS *prg)
 {
   int      sstatus;
   ESL_SQ   *dbsq     = NULL;   /* one target sequence (digital)  */
   int seq_cnt = 0;
+  int q;
 
   dbsq = esl_sq_CreateDigital(info->om->abc);
 
   /* Main loop: */
   while ( (n_targetseqs==-1 || seq_cnt<n_targetseqs) &&  (sstatus = esl_sqio_Read(dbfp, dbsq)) == eslOK)
   {
-      p7_pli_NewSeq(info->pli, dbsq);
-      p7_bg_SetLength(info->bg, dbsq->n);
-      p7_oprofile_ReconfigLength(info->om, dbsq->n);
-      
-      p7_Pipeline(info->pli, info->om, info->bg, dbsq, NULL, info->th);
+      for (q = 0; q < info->nbatch; q++)
+      {
+        p7_pli_NewSeq(info[q].pli, dbsq);
+        p7_pli_SetTargetLength(info[q].pli, info[q].om, info[q].bg, dbsq->n);
+
+        p7_Pipeline(info[q].pli, info[q].om, info[q].bg, dbsq, NULL, info[q].th);
 
+        p7_pipeline_Reuse(info[q].pli);
+      }
+
+      if (prg) p7_progress_Update(prg, 1, dbsq->n, dbsq->eoff);
       seq_cnt++;
       esl_sq_Reuse(dbsq);
-      p7_pipeline_Reuse(info->pli);
   }
 
   if (n_targetseqs!=-1 && seq_cnt==n_targetseqs)
@@ -1317,12 +1516,19 @@ serial_loop(WORKER_INFO *info, ESL_SQFILE *dbfp, int n_targetseqs)
 }
 
 #ifdef HMMER_THREADS
+/* thread_loop()
+ * The reader: read blocks of the target database into the work
+ * queue for the pipeline threads. If <prg> is non-NULL, count each
+ * block read on it; progress records come from this thread.
+ */
 static int
-thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, int n_targetseqs)
+thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, int n_targetseqs, P7_PROGRESS *prg)
 {
   int  status  = eslOK;
   int  sstatus = eslOK;
   int  eofCount = 0;
+  int  i;
+  int64_t       nres;
   ESL_SQ_BLOCK *block;
   void         *newBlock;
 
@@ -1346,6 +1552,12 @@ thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, int n_tar
         n_targetseqs -= block->count;
       }
 
+      if (prg && sstatus == eslOK && block->count > 0)
+      {
+        for (nres = 0, i = 0; i < block->count; i++) nres += block->list[i].n;
+        p7_progress_Update(prg, block->count, nres, block->list[block->count-1].eoff);
+      }
+
       if (sstatus == eslEOF)
       {
         if (eofCount < esl_threads_GetWorkerCount(obj)) sstatus = eslOK;
@@ -1375,7 +1587,7 @@ thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, int n_tar
 static void 
 pipeline_thread(void *arg)
 {
-  int i;
+  int i, q;
   int status;
   int workeridx;
   WORKER_INFO   *info;
@@ -1383,6 +1595,8 @@ pipeline_thread(void *arg)
 
   ESL_SQ_BLOCK  *block = NULL;
   void          *newBlock;
+  int           *order  = NULL;	/* indices of the block's seqs, by length */
+  int            norder = 0;
   
   impl_Init();
 
@@ -1398,19 +1612,30 @@ pipeline_thread(void *arg)
   block = (ESL_SQ_BLOCK *) newBlock;
   while (block->count > 0)
     {
+      /* visit the block in order of length, so the model is reconfigured once per distinct length */
+      if (block->count > norder) {
+	ESL_REALLOC(order, sizeof(int) * block->count);
+	norder = block->count;
+      }
+      p7_pli_OrderByLength(block->list, block->count, order);
+
       /* Main loop: */
       for (i = 0; i < block->count; ++i)
 	{
-	  ESL_SQ *dbsq = block->list + i;
+	  ESL_SQ *dbsq = block->list + order[i];
 
-	  p7_pli_NewSeq(info->pli, dbsq);
-	  p7_bg_SetLength(info->bg, dbsq->n);
-	  p7_oprofile_ReconfigLength(info->om, dbsq->n);
-	  
-	  p7_Pipeline(info->pli, info->om, info->bg, dbsq, NULL, info->th);
+	  /* each sequence goes through all queries of the batch while it's hot in cache */
+	  for (q = 0; q < info->nbatch; q++)
+	    {
+	      p7_pli_NewSeq(info[q].pli, dbsq);
+	      p7_pli_SetTargetLength(info[q].pli, info[q].om, info[q].bg, dbsq->n);
+
+	      p7_Pipeline(info[q].pli, info[q].om, info[q].bg, dbsq, NULL, info[q].th);
+
+	      p7_pipeline_Reuse(info[q].pli);
+	    }
 	  
 	  esl_sq_Reuse(dbsq);
-	  p7_pipeline_Reuse(info->pli);
 	}
 
       status = esl_workqueue_WorkerUpdate(info->queue, block, &newBlock);
@@ -1422,8 +1647,12 @@ pipeline_thread(void *arg)
   status = esl_workqueue_WorkerUpdate(info->queue, block, NULL);
   if (status != eslOK) esl_fatal("Work queue worker failed");
 
+  free(order);
   esl_threads_Finished(obj, workeridx);
   return;
+
+ ERROR:
+  p7_Fail("allocation failure in pipeline thread");
 }
 #endif   /* HMMER_THREADS */
  
@@ -0,0 +1,743 @@
+/* hmmsearcht: search protein profile HMM(s) against a DNA sequence database,
+ * translating the DNA on the fly.
+ *
+ * Each DNA target sequence is translated in all six frames, and its
+ * open reading frames (ORFs) are passed one at a time through the
+ * standard protein search pipeline. Translation happens in the worker
+ * that processes the sequence (see p7_orfscan.c), so a genome is never
+ * written out in translated form. Hits are reported against the DNA
+ * sequence, in nucleotide coordinates.
+ */
+#include "p7_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_gencode.h"
+#include "esl_getopts.h"
+#include "esl_msa.h"
+#include "esl_msafile.h"
+#include "esl_sq.h"
+#include "esl_sqio.h"
+#include "esl_stopwatch.h"
+
+#ifdef HMMER_THREADS
+#include <unistd.h>
+#include "esl_threads.h"
+#include "esl_workqueue.h"
+#endif
+
+#include "hmmer.h"
+
+typedef struct {
+#ifdef HMMER_THREADS
+  ESL_WORK_QUEUE   *queue;
+#endif
+  P7_BG            *bg;	         /* null model                              */
+  P7_PIPELINE      *pli;         /* work pipeline                           */
+  P7_TOPHITS       *th;          /* top hit results                         */
+  P7_OPROFILE      *om;          /* optimized query profile                 */
+  P7_ORFSCAN       *os;          /* translates each target into its ORFs    */
+  ESL_SQ           *orfsq;       /* the ORF being searched                  */
+} WORKER_INFO;
+
+#define REPOPTS     "-E,-T,--cut_ga,--cut_nc,--cut_tc"
+#define DOMREPOPTS  "--domE,--domT,--cut_ga,--cut_nc,--cut_tc"
+#define INCOPTS     "--incE,--incT,--cut_ga,--cut_nc,--cut_tc"
+#define INCDOMOPTS  "--incdomE,--incdomT,--cut_ga,--cut_nc,--cut_tc"
+#define THRESHOPTS  "-E,-T,--domE,--domT,--incE,--incT,--incdomE,--incdomT,--cut_ga,--cut_nc,--cut_tc"
+
+static ESL_OPTIONS options[] = {
+  /* name           type      default  env  range     toggles   reqs   incomp              help                                                      docgroup*/
+  { "-h",           eslARG_NONE,   FALSE, NULL, NULL,    NULL,  NULL,  NULL,            "show brief help on version and usage",                         1 },
+  /* Control of output */
+  { "-o",           eslARG_OUTFILE, NULL, NULL, NULL,    NULL,  NULL,  NULL,            "direct output to file <f>, not stdout",                        2 },
+  { "-A",           eslARG_OUTFILE, NULL, NULL, NULL,    NULL,  NULL,  NULL,            "save multiple alignment of all hits to file <f>",              2 },
+  { "--tblout",     eslARG_OUTFILE, NULL, NULL, NULL,    NULL,  NULL,  NULL,            "save parseable table of per-sequence hits to file <f>",        2 },
+  { "--domtblout",  eslARG_OUTFILE, NULL, NULL, NULL,    NULL,  NULL,  NULL,            "save parseable table of per-domain hits to file <f>",          2 },
+  { "--hitout",     eslARG_OUTFILE, NULL, NULL, NULL,    NULL,  NULL,  NULL,            "save hits in compact binary format to file <f>",               2 },
+  { "--pfamtblout", eslARG_OUTFILE, NULL, NULL, NULL,    NULL,  NULL,  NULL,            "save table of hits and domains to file, in Pfam format <f>",   2 },
+  { "--acc",        eslARG_NONE,   FALSE, NULL, NULL,    NULL,  NULL,  NULL,            "prefer accessions over names in output",                       2 },
+  { "--noali",      eslARG_NONE,   FALSE, NULL, NULL,    NULL,  NULL,  NULL,            "don't output alignments, so output is smaller",                2 },
+  { "--notextw",    eslARG_NONE,    NULL, NULL, NULL,    NULL,  NULL, "--textw",        "unlimit ASCII text output line width",                         2 },
+  { "--textw",      eslARG_INT,    "120", NULL, "n>=120",NULL,  NULL, "--notextw",      "set max width of ASCII text output lines",                     2 },
+  /* Control of translation */
+  { "-c",           eslARG_INT,      "1", NULL, NULL,    NULL,  NULL,  NULL,            "use alt genetic code of NCBI transl table <n>",                3 },
+  { "-l",           eslARG_INT,     "20", NULL, "n>0",   NULL,  NULL,  NULL,            "minimum ORF length, in amino acids",                           3 },
+  { "-m",           eslARG_NONE,   FALSE, NULL, NULL,    NULL,  NULL,  NULL,            "ORFs must start with an initiator codon",                      3 },
+  { "--watson",     eslARG_NONE,   FALSE, NULL, NULL,    NULL,  NULL, "--crick",        "only translate the top strand",                                3 },
+  { "--crick",      eslARG_NONE,   FALSE, NULL, NULL,    NULL,  NULL, "--watson",       "only translate the bottom strand",                             3 },
+  /* Control of reporting thresholds */
+  { "-E",           eslARG_REAL,  "10.0", NULL, "x>0",   NULL,  NULL,  REPOPTS,         "report sequences <= this E-value threshold in output",         4 },
+  { "-T",           eslARG_REAL,   FALSE, NULL, NULL,    NULL,  NULL,  REPOPTS,         "report sequences >= this score threshold in output",           4 },
+  { "--domE",       eslARG_REAL,  "10.0", NULL, "x>0",   NULL,  NULL,  DOMREPOPTS,      "report domains <= this E-value threshold in output",           4 },
+  { "--domT",       eslARG_REAL,   FALSE, NULL, NULL,    NULL,  NULL,  DOMREPOPTS,      "report domains >= this score cutoff in output",                4 },
+  { "--max-hits",   eslARG_INT,     NULL, NULL, "n>0",   NULL,  NULL,  NULL,            "keep only the <n> best-scoring hits (saves memory)",           4 },
+  /* Control of inclusion (significance) thresholds */
+  { "--incE",       eslARG_REAL,  "0.01", NULL, "x>0",   NULL,  NULL,  INCOPTS,         "consider sequences <= this E-value threshold as significant",  5 },
+  { "--incT",       eslARG_REAL,   FALSE, NULL, NULL,    NULL,  NULL,  INCOPTS,         "consider sequences >= this score threshold as significant",    5 },
+  { "--incdomE",    eslARG_REAL,  "0.01", NULL, "x>0",   NULL,  NULL,  INCDOMOPTS,      "consider domains <= this E-value threshold as significant",    5 },
+  { "--incdomT",    eslARG_REAL,   FALSE, NULL, NULL,    NULL,  NULL,  INCDOMOPTS,      "consider domains >= this score threshold as significant",      5 },
+  /* Model-specific thresholding for both reporting and inclusion */
+  { "--cut_ga",     eslARG_NONE,   FALSE, NULL, NULL,    NULL,  NULL,  THRESHOPTS,      "use profile's GA gathering cutoffs to set all thresholding",   6 },
+  { "--cut_nc",     eslARG_NONE,   FALSE, NULL, NULL,    NULL,  NULL,  THRESHOPTS,      "use profile's NC noise cutoffs to set all thresholding",       6 },
+  { "--cut_tc",     eslARG_NONE,   FALSE, NULL, NULL,    NULL,  NULL,  THRESHOPTS,      "use profile's TC trusted cutoffs to set all thresholding",     6 },
+  /* Control of acceleration pipeline */
+  { "--max",        eslARG_NONE,   FALSE, NULL, NULL,    NULL,  NULL, "--F1,--F2,--F3", "Turn all heuristic filters off (less speed, more power)",      7 },
+  { "--F1",         eslARG_REAL,  "0.02", NULL, NULL,    NULL,  NULL, "--max",          "Stage 1 (MSV) threshold: promote hits w/ P <= F1",             7 },
+  { "--F2",         eslARG_REAL,  "1e-3", NULL, NULL,    NULL,  NULL, "--max",          "Stage 2 (Vit) threshold: promote hits w/ P <= F2",             7 },
+  { "--F3",         eslARG_REAL,  "1e-5", NULL, NULL,    NULL,  NULL, "--max",          "Stage 3 (Fwd) threshold: promote hits w/ P <= F3",             7 },
+  { "--nobias",     eslARG_NONE,   NULL,  NULL, NULL,    NULL,  NULL, "--max",          "turn off composition bias filter",                             7 },
+
+/* Other options */
+  { "--nonull2",    eslARG_NONE,   NULL,  NULL, NULL,    NULL,  NULL,  NULL,            "turn off biased composition score corrections",               12 },
+  { "--nosample",   eslARG_NONE,   NULL,  NULL, NULL,    NULL,  NULL,  NULL,            "split domains by posterior decoding, not sampling",           12 },
+  { "--stagestats", eslARG_NONE,   NULL,  NULL, NULL,    NULL,  NULL,  NULL,            "time each pipeline stage, and count its DP cells",            12 },
+  { "-Z",           eslARG_REAL,   FALSE, NULL, "x>0",   NULL,  NULL,  NULL,            "set # of comparisons done, for E-value calculation",          12 },
+  { "--domZ",       eslARG_REAL,   FALSE, NULL, "x>0",   NULL,  NULL,  NULL,            "set # of significant seqs, for domain E-value calculation",   12 },
+  { "--seed",       eslARG_INT,    "42",  NULL, "n>=0",  NULL,  NULL,  NULL,            "set RNG seed to <n> (if 0: one-time arbitrary seed)",         12 },
+  { "--tformat",    eslARG_STRING,  NULL, NULL, NULL,    NULL,  NULL,  NULL,            "assert target <seqfile> is in format <s>: no autodetection",  12 },
+#ifdef HMMER_THREADS
+  { "--cpu",        eslARG_INT, p7_NCPU,"HMMER_NCPU","n>=0",NULL,  NULL,  NULL,         "number of parallel CPU workers to use for multithreads",      12 },
+#endif
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+
+static char usage[]  = "[options] <hmmfile> <seqdb>";
+static char banner[] = "search protein profile(s) against a translated DNA sequence database";
+
+/* struct cfg_s : "Global" application configuration shared by all threads/processes
+ *
+ * This structure is passed to routines within main.c, as a means of semi-encapsulation
+ * of shared data amongst different parallel processes (threads).
+ */
+struct cfg_s {
+  char            *dbfile;            /* target DNA sequence database file               */
+  char            *hmmfile;           /* query HMM file                                  */
+};
+
+static int  serial_master(ESL_GETOPTS *go, struct cfg_s *cfg);
+static int  serial_loop  (WORKER_INFO *info, ESL_SQFILE *dbfp);
+static void search_orfs  (WORKER_INFO *info, const ESL_SQ *dbsq);
+
+#ifdef HMMER_THREADS
+#define BLOCK_SIZE 1000
+
+static int  thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp);
+static void pipeline_thread(void *arg);
+#endif
+
+
+static int
+process_commandline(int argc, char **argv, ESL_GETOPTS **ret_go, char **ret_hmmfile, char **ret_seqfile)
+{
+  ESL_GETOPTS *go = esl_getopts_Create(options);
+  int          status;
+
+  if (esl_opt_ProcessEnvironment(go)         != eslOK)  { if (printf("Failed to process environment: %s\n", go->errbuf) < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "write failed"); goto FAILURE; }
+  if (esl_opt_ProcessCmdline(go, argc, argv) != eslOK)  { if (printf("Failed to parse command line: %s\n",  go->errbuf) < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "write failed"); goto FAILURE; }
+  if (esl_opt_VerifyConfig(go)               != eslOK)  { if (printf("Failed to parse command line: %s\n",  go->errbuf) < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "write failed"); goto FAILURE; }
+
+  /* help format: */
+  if (esl_opt_GetBoolean(go, "-h") == TRUE)
+    {
+      p7_banner(stdout, argv[0], banner);
+      esl_usage(stdout, argv[0], usage);
+      if (puts("\nBasic options:")                                           < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "write failed");
+      esl_opt_DisplayHelp(stdout, go, 1, 2, 80); /* 1= group; 2 = indentation; 80=textwidth*/
+
+      if (puts("\nOptions directing output:")                                < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "write failed");
+      esl_opt_DisplayHelp(stdout, go, 2, 2, 80);
+
+      if (puts("\nOptions controlling translation of the target DNA:")       < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "write failed");
+      esl_opt_DisplayHelp(stdout, go, 3, 2, 80);
+
+      if (puts("\nOptions controlling reporting thresholds:")                < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "write failed");
+      esl_opt_DisplayHelp(stdout, go, 4, 2, 80);
+
+      if (puts("\nOptions controlling inclusion (significance) thresholds:") < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "write failed");
+      esl_opt_DisplayHelp(stdout, go, 5, 2, 80);
+
+      if (puts("\nOptions controlling model-specific thresholding:")         < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "write failed");
+      esl_opt_DisplayHelp(stdout, go, 6, 2, 80);
+
+      if (puts("\nOptions controlling acceleration heuristics:")             < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "write failed");
+      esl_opt_DisplayHelp(stdout, go, 7, 2, 80);
+
+      if (puts("\nOther expert options:")                                    < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "write failed");
+      esl_opt_DisplayHelp(stdout, go, 12, 2, 80);
+      exit(0);
+    }
+
+  if (esl_opt_ArgNumber(go)                  != 2)     { if (puts("Incorrect number of command line arguments.")      < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "write failed"); goto FAILURE; }
+  if ((*ret_hmmfile = esl_opt_GetArg(go, 1)) == NULL)  { if (puts("Failed to get <hmmfile> argument on command line") < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "write failed"); goto FAILURE; }
+  if ((*ret_seqfile = esl_opt_GetArg(go, 2)) == NULL)  { if (puts("Failed to get <seqdb> argument on command line")   < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "write failed"); goto FAILURE; }
+
+  /* Validate any attempted use of stdin streams */
+  if (strcmp(*ret_hmmfile, "-") == 0 && strcmp(*ret_seqfile, "-") == 0)
+    { if (puts("Either <hmmfile> or <seqdb> may be '-' (to read from stdin), but not both.") < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "write failed"); goto FAILURE; }
+
+  *ret_go = go;
+  return eslOK;
+
+ FAILURE:  /* all errors handled here are user errors, so be polite.  */
+  esl_usage(stdout, argv[0], usage);
+  if (puts("\nwhere most common options are:")                                 < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "write failed");
+  esl_opt_DisplayHelp(stdout, go, 1, 2, 80); /* 1= group; 2 = indentation; 80=textwidth*/
+  if (printf("\nTo see more help on available options, do %s -h\n\n", argv[0]) < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "write failed");
+  esl_getopts_Destroy(go);
+  exit(1);
+
+ ERROR:
+  if (go) esl_getopts_Destroy(go);
+  exit(status);
+}
+
+static int
+output_header(FILE *ofp, const ESL_GETOPTS *go, char *hmmfile, char *seqfile)
+{
+  p7_banner(ofp, go->argv[0], banner);
+
+  if (fprintf(ofp, "# query HMM file:                  %s\n", hmmfile)                                                                                 < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (fprintf(ofp, "# target DNA sequence database:    %s\n", seqfile)                                                                                 < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "-o")           && fprintf(ofp, "# output directed to file:         %s\n",             esl_opt_GetString(go, "-o"))           < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "-A")           && fprintf(ofp, "# MSA of all hits saved to file:   %s\n",             esl_opt_GetString(go, "-A"))           < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--tblout")     && fprintf(ofp, "# per-seq hits tabular output:     %s\n",             esl_opt_GetString(go, "--tblout"))     < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--domtblout")  && fprintf(ofp, "# per-dom hits tabular output:     %s\n",             esl_opt_GetString(go, "--domtblout"))  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--hitout")     && fprintf(ofp, "# binary hit output:               %s\n",             esl_opt_GetString(go, "--hitout"))     < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--pfamtblout") && fprintf(ofp, "# pfam-style tabular hit output:   %s\n",             esl_opt_GetString(go, "--pfamtblout")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--acc")        && fprintf(ofp, "# prefer accessions over names:    yes\n")                                                   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--noali")      && fprintf(ofp, "# show alignments in output:       no\n")                                                    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--notextw")    && fprintf(ofp, "# max ASCII text line length:      unlimited\n")                                             < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--textw")      && fprintf(ofp, "# max ASCII text line length:      %d\n",             esl_opt_GetInteger(go, "--textw"))     < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "-c")           && fprintf(ofp, "# genetic code:                    NCBI transl table %d\n", esl_opt_GetInteger(go, "-c"))    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "-l")           && fprintf(ofp, "# minimum ORF length:              %d aa\n",          esl_opt_GetInteger(go, "-l"))          < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "-m")           && fprintf(ofp, "# ORFs start at initiator codons:  yes\n")                                                   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--watson")     && fprintf(ofp, "# strands translated:              top only\n")                                              < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--crick")      && fprintf(ofp, "# strands translated:              bottom only\n")                                           < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "-E")           && fprintf(ofp, "# sequence reporting threshold:    E-value <= %g\n",  esl_opt_GetReal(go, "-E"))             < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "-T")           && fprintf(ofp, "# sequence reporting threshold:    score >= %g\n",    esl_opt_GetReal(go, "-T"))             < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--domE")       && fprintf(ofp, "# domain reporting threshold:      E-value <= %g\n",  esl_opt_GetReal(go, "--domE"))         < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--domT")       && fprintf(ofp, "# domain reporting threshold:      score >= %g\n",    esl_opt_GetReal(go, "--domT"))         < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--max-hits")   && fprintf(ofp, "# max hits kept:                   %d\n",             esl_opt_GetInteger(go, "--max-hits"))  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--incE")       && fprintf(ofp, "# sequence inclusion threshold:    E-value <= %g\n",  esl_opt_GetReal(go, "--incE"))         < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--incT")       && fprintf(ofp, "# sequence inclusion threshold:    score >= %g\n",    esl_opt_GetReal(go, "--incT"))         < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--incdomE")    && fprintf(ofp, "# domain inclusion threshold:      E-value <= %g\n",  esl_opt_GetReal(go, "--incdomE"))      < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--incdomT")    && fprintf(ofp, "# domain inclusion threshold:      score >= %g\n",    esl_opt_GetReal(go, "--incdomT"))      < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--cut_ga")     && fprintf(ofp, "# model-specific thresholding:     GA cutoffs\n")                                            < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--cut_nc")     && fprintf(ofp, "# model-specific thresholding:     NC cutoffs\n")                                            < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--cut_tc")     && fprintf(ofp, "# model-specific thresholding:     TC cutoffs\n")                                            < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--max")        && fprintf(ofp, "# Max sensitivity mode:            on [all heuristic filters off]\n")                        < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--F1")         && fprintf(ofp, "# MSV filter P threshold:       <= %g\n",             esl_opt_GetReal(go, "--F1"))           < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--F2")         && fprintf(ofp, "# Vit filter P threshold:       <= %g\n",             esl_opt_GetReal(go, "--F2"))           < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--F3")         && fprintf(ofp, "# Fwd filter P threshold:       <= %g\n",             esl_opt_GetReal(go, "--F3"))           < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--nobias")     && fprintf(ofp, "# biased composition HMM filter:   off\n")                                                   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--nonull2")    && fprintf(ofp, "# null2 bias corrections:          off\n")                                                   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--nosample")   && fprintf(ofp, "# multidomain envelopes:           posterior decoding\n")                                    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "-Z")           && fprintf(ofp, "# sequence search space set to:    %.0f\n",           esl_opt_GetReal(go, "-Z"))             < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--domZ")       && fprintf(ofp, "# domain search space set to:      %.0f\n",           esl_opt_GetReal(go, "--domZ"))         < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--seed"))  {
+    if (esl_opt_GetInteger(go, "--seed") == 0 && fprintf(ofp, "# random number seed:              one-time arbitrary\n")                               < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+    else if (                               fprintf(ofp, "# random number seed set to:       %d\n",             esl_opt_GetInteger(go, "--seed"))      < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  }
+  if (esl_opt_IsUsed(go, "--tformat")    && fprintf(ofp, "# targ <seqfile> format asserted:  %s\n",             esl_opt_GetString(go, "--tformat"))    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+#ifdef HMMER_THREADS
+  if (esl_opt_IsUsed(go, "--cpu")        && fprintf(ofp, "# number of worker threads:        %d\n",             esl_opt_GetInteger(go, "--cpu"))       < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+#endif
+  if (fprintf(ofp, "# - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -\n\n")                                                    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  return eslOK;
+}
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS     *go       = NULL;
+  struct cfg_s     cfg;
+  int              status   = eslOK;
+
+  impl_Init();                  /* processor specific initialization */
+  p7_FLogsumInit();		/* we're going to use table-driven Logsum() approximations at times */
+
+  cfg.hmmfile    = NULL;
+  cfg.dbfile     = NULL;
+
+  process_commandline(argc, argv, &go, &cfg.hmmfile, &cfg.dbfile);
+
+  status = serial_master(go, &cfg);
+
+  esl_getopts_Destroy(go);
+
+  return status;
+}
+
+
+/* serial_master()
+ * The serial version of hmmsearcht.
+ * For each query HMM in <hmmfile> search the translated database for hits.
+ *
+ * A master can only return if it's successful. All errors are handled
+ * immediately and fatally with p7_Fail().  We also use the
+ * ESL_EXCEPTION and ERROR: mechanisms, but only because we know we're
+ * using a fatal exception handler.
+ */
+static int
+serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
+{
+  FILE            *ofp      = stdout;            /* results output file (-o)                        */
+  FILE            *afp      = NULL;              /* alignment output file (-A)                      */
+  FILE            *tblfp    = NULL;              /* output stream for tabular per-seq (--tblout)    */
+  FILE            *domtblfp = NULL;              /* output stream for tabular per-dom (--domtblout) */
+  FILE            *hitfp    = NULL;              /* output stream for binary hit output (--hitout)  */
+  FILE            *pfamtblfp= NULL;              /* output stream for pfam tabular output (--pfamtblout) */
+  P7_HMMFILE      *hfp      = NULL;              /* open input HMM file                             */
+  ESL_SQFILE      *dbfp     = NULL;              /* open input DNA sequence file                    */
+  P7_HMM          *hmm      = NULL;              /* one HMM query                                   */
+  ESL_ALPHABET    *abc      = NULL;              /* digital alphabet of the queries: amino          */
+  ESL_ALPHABET    *nt_abc   = NULL;              /* digital alphabet of the targets: DNA            */
+  ESL_GENCODE     *gcode    = NULL;              /* genetic code for translating the targets        */
+  int              dbfmt    = eslSQFILE_UNKNOWN; /* format code for sequence database file          */
+  ESL_STOPWATCH   *w;
+  P7_STAGESTATS    stagestats;
+  int              textw    = 0;
+  int              nquery   = 0;
+  int              status   = eslOK;
+  int              hstatus  = eslOK;
+  int              sstatus  = eslOK;
+  int              i;
+
+  int              ncpus    = 0;
+
+  int              infocnt  = 0;
+  WORKER_INFO     *info     = NULL;
+#ifdef HMMER_THREADS
+  ESL_SQ_BLOCK    *block    = NULL;
+  ESL_THREADS     *threadObj= NULL;
+  ESL_WORK_QUEUE  *queue    = NULL;
+  P7_DOMAINPOOL   *ddpool   = NULL;
+#endif
+  char             errbuf[eslERRBUFSIZE];
+
+  w = esl_stopwatch_Create();
+  p7_stagestats_Zero(&stagestats);
+
+  if (esl_opt_GetBoolean(go, "--notextw")) textw = 0;
+  else                                     textw = esl_opt_GetInteger(go, "--textw");
+
+  if (esl_opt_IsOn(go, "--tformat")) {
+    dbfmt = esl_sqio_EncodeFormat(esl_opt_GetString(go, "--tformat"));
+    if (dbfmt == eslSQFILE_UNKNOWN) p7_Fail("%s is not a recognized sequence database file format\n", esl_opt_GetString(go, "--tformat"));
+  }
+
+  /* Open the target sequence database, as DNA */
+  nt_abc = esl_alphabet_Create(eslDNA);
+  status = esl_sqfile_OpenDigital(nt_abc, cfg->dbfile, dbfmt, p7_SEQDBENV, &dbfp);
+  if      (status == eslENOTFOUND) p7_Fail("Failed to open sequence file %s for reading\n",          cfg->dbfile);
+  else if (status == eslEFORMAT)   p7_Fail("Sequence file %s is empty or misformatted\n",            cfg->dbfile);
+  else if (status == eslEINVAL)    p7_Fail("Can't autodetect format of a stdin or .gz seqfile");
+  else if (status != eslOK)        p7_Fail("Unexpected error %d opening sequence file %s\n", status, cfg->dbfile);
+
+  /* Open the query profile HMM file */
+  status = p7_hmmfile_OpenE(cfg->hmmfile, NULL, &hfp, errbuf);
+  if      (status == eslENOTFOUND) p7_Fail("File existence/permissions problem in trying to open HMM file %s.\n%s\n", cfg->hmmfile, errbuf);
+  else if (status == eslEFORMAT)   p7_Fail("File format problem in trying to open HMM file %s.\n%s\n",                cfg->hmmfile, errbuf);
+  else if (status != eslOK)        p7_Fail("Unexpected error %d in opening HMM file %s.\n%s\n",               status, cfg->hmmfile, errbuf);
+
+  /* Open the results output files */
+  if (esl_opt_IsOn(go, "-o"))          { if ((ofp      = fopen(esl_opt_GetString(go, "-o"), "w")) == NULL) p7_Fail("Failed to open output file %s for writing\n",    esl_opt_GetString(go, "-o")); }
+  if (esl_opt_IsOn(go, "-A"))          { if ((afp      = fopen(esl_opt_GetString(go, "-A"), "w")) == NULL) p7_Fail("Failed to open alignment file %s for writing\n", esl_opt_GetString(go, "-A")); }
+  if (esl_opt_IsOn(go, "--tblout"))    { if ((tblfp    = fopen(esl_opt_GetString(go, "--tblout"),    "w")) == NULL)  esl_fatal("Failed to open tabular per-seq output file %s for writing\n", esl_opt_GetString(go, "--tblout")); }
+  if (esl_opt_IsOn(go, "--domtblout")) { if ((domtblfp = fopen(esl_opt_GetString(go, "--domtblout"), "w")) == NULL)  esl_fatal("Failed to open tabular per-dom output file %s for writing\n", esl_opt_GetString(go, "--domtblout")); }
+  if (esl_opt_IsOn(go, "--hitout"))    { if ((hitfp    = fopen(esl_opt_GetString(go, "--hitout"),    "wb")) == NULL)  esl_fatal("Failed to open binary hit output file %s for writing\n", esl_opt_GetString(go, "--hitout")); p7_hitfile_WriteMagic(hitfp); }
+  if (esl_opt_IsOn(go, "--pfamtblout")){ if ((pfamtblfp = fopen(esl_opt_GetString(go, "--pfamtblout"), "w")) == NULL)  esl_fatal("Failed to open pfam-style tabular output file %s for writing\n", esl_opt_GetString(go, "--pfamtblout")); }
+
+#ifdef HMMER_THREADS
+  /* initialize thread data */
+  ncpus = ESL_MIN( esl_opt_GetInteger(go, "--cpu"), esl_threads_GetCPUCount());
+  if (ncpus > 0)
+    {
+      threadObj = esl_threads_Create(&pipeline_thread);
+      queue = esl_workqueue_Create(ncpus * 2);
+      if ((ddpool = p7_domainpool_Create(ncpus)) == NULL) p7_Fail("Failed to create domain definition threads");
+    }
+#endif
+
+  infocnt = (ncpus == 0) ? 1 : ncpus;
+  ESL_ALLOC(info, sizeof(*info) * infocnt);
+
+  /* <abc> is not known 'til first HMM is read. */
+  hstatus = p7_hmmfile_Read(hfp, &abc, &hmm);
+  if (hstatus == eslOK)
+    {
+      /* One-time initializations after alphabet <abc> becomes known */
+      if (abc->type != eslAMINO) p7_Fail("hmmsearcht searches with protein profiles; %s is not a protein HMM file\n", cfg->hmmfile);
+
+      gcode = esl_gencode_Create(nt_abc, abc);
+      if (esl_gencode_Set(gcode, esl_opt_GetInteger(go, "-c")) != eslOK) p7_Fail("No such genetic code: NCBI translation table %d\n", esl_opt_GetInteger(go, "-c"));
+
+      output_header(ofp, go, cfg->hmmfile, cfg->dbfile);
+
+      for (i = 0; i < infocnt; ++i)
+	{
+	  info[i].bg    = p7_bg_Create(abc);
+	  info[i].os    = p7_orfscan_Create(gcode, esl_opt_GetInteger(go, "-l"), esl_opt_GetBoolean(go, "-m"),
+					    ! esl_opt_GetBoolean(go, "--crick"), ! esl_opt_GetBoolean(go, "--watson"));
+	  info[i].orfsq = esl_sq_CreateDigital(abc);
+	  if (info[i].os == NULL || info[i].orfsq == NULL) p7_Fail("Failed to allocate ORF translation workspace");
+#ifdef HMMER_THREADS
+	  info[i].queue = queue;
+#endif
+	}
+
+#ifdef HMMER_THREADS
+      for (i = 0; i < ncpus * 2; ++i)
+	{
+	  block = esl_sq_CreateDigitalBlock(BLOCK_SIZE, nt_abc);
+	  if (block == NULL) 	      esl_fatal("Failed to allocate sequence block");
+
+ 	  status = esl_workqueue_Init(queue, block);
+	  if (status != eslOK)	      esl_fatal("Failed to add block to work queue");
+	}
+#endif
+    }
+
+  /* Outer loop: over each query HMM in <hmmfile>. */
+  while (hstatus == eslOK)
+    {
+      P7_PROFILE      *gm      = NULL;
+      P7_OPROFILE     *om      = NULL;       /* optimized query profile                  */
+
+      nquery++;
+      esl_stopwatch_Start(w);
+
+      /* seqfile may need to be rewound (multiquery mode) */
+      if (nquery > 1)
+      {
+        if (! esl_sqfile_IsRewindable(dbfp))
+          esl_fatal("Target sequence file %s isn't rewindable; can't search it with multiple queries", cfg->dbfile);
+        esl_sqfile_Position(dbfp, 0);
+      }
+
+      if (fprintf(ofp, "Query:       %s  [M=%d]\n", hmm->name, hmm->M)  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+      if (hmm->acc)  { if (fprintf(ofp, "Accession:   %s\n", hmm->acc)  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
+      if (hmm->desc) { if (fprintf(ofp, "Description: %s\n", hmm->desc) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
+
+      /* Convert to an optimized model */
+      gm = p7_profile_Create (hmm->M, abc);
+      om = p7_oprofile_Create(hmm->M, abc);
+      p7_ProfileConfig(hmm, info->bg, gm, 100, p7_LOCAL); /* 100 is a dummy length for now; and MSVFilter requires local mode */
+      p7_oprofile_Convert(gm, om);                  /* <om> is now p7_LOCAL, multihit */
+
+      for (i = 0; i < infocnt; ++i)
+	{
+	  /* Create processing pipeline and hit list. Alignments are
+	   * made as domains are found, not deferred: the deferred
+	   * path doesn't have the DNA sequence to show codons from.
+	   */
+	  info[i].th  = p7_tophits_Create();
+	  if (esl_opt_IsOn(go, "--max-hits")) p7_tophits_SetMaxHits(info[i].th, esl_opt_GetInteger(go, "--max-hits"));
+	  info[i].om  = p7_oprofile_Clone(om);
+	  info[i].pli = p7_pipeline_Create(go, om->M, 100, FALSE, p7_SEARCH_SEQS); /* L_hint = 100 is just a dummy for now */
+#ifdef HMMER_THREADS
+	  info[i].pli->ddef->pool = ddpool;
+#endif
+	  status = p7_pli_NewModel(info[i].pli, info[i].om, info[i].bg);
+	  if (status == eslEINVAL) p7_Fail(info->pli->errbuf);
+
+#ifdef HMMER_THREADS
+	  if (ncpus > 0) esl_threads_AddThread(threadObj, &info[i]);
+#endif
+	}
+
+#ifdef HMMER_THREADS
+      if (ncpus > 0)  sstatus = thread_loop(threadObj, queue, dbfp);
+      else            sstatus = serial_loop(info, dbfp);
+#else
+      sstatus = serial_loop(info, dbfp);
+#endif
+      switch(sstatus)
+      {
+      case eslEFORMAT:
+        esl_fatal("Parse failed (sequence file %s):\n%s\n",
+            dbfp->filename, esl_sqfile_GetErrorBuf(dbfp));
+        break;
+      case eslEOF:
+        /* do nothing */
+        break;
+      default:
+        esl_fatal("Unexpected error %d reading sequence file %s", sstatus, dbfp->filename);
+      }
+
+      /* merge the results of the search results */
+      for (i = 1; i < infocnt; ++i)
+	{
+	  p7_tophits_Merge(info[0].th, info[i].th);
+	  p7_pipeline_Merge(info[0].pli, info[i].pli);
+
+	  p7_pipeline_Destroy(info[i].pli);
+	  p7_tophits_Destroy(info[i].th);
+	  p7_oprofile_Destroy(info[i].om);
+	}
+
+      esl_stopwatch_Stop(w);
+
+      /* Print the results.  */
+      p7_tophits_SortBySortkey(info->th);
+      p7_tophits_Threshold(info->th, info->pli);
+      p7_tophits_Targets(ofp, info->th, info->pli, textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+      p7_tophits_Domains(ofp, info->th, info->pli, textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+
+      if (tblfp)    p7_tophits_TabularTargets(tblfp,    hmm->name, hmm->acc, info->th, info->pli, (nquery == 1));
+      if (domtblfp) p7_tophits_TabularDomains(domtblfp, hmm->name, hmm->acc, info->th, info->pli, (nquery == 1));
+      if (hitfp)     p7_hitfile_Write(hitfp, hmm->name, hmm->acc, info->th, info->pli);
+      if (pfamtblfp) p7_tophits_TabularXfam(pfamtblfp, hmm->name, hmm->acc, info->th, info->pli);
+
+      p7_pli_Statistics(ofp, info->pli, w);
+      p7_stagestats_Merge(&stagestats, &(info->pli->stats));
+      if (fprintf(ofp, "//\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+
+      /* Output the results in an MSA (-A option) */
+      if (afp) {
+	ESL_MSA *msa = NULL;
+
+	if (p7_tophits_Alignment(info->th, abc, NULL, NULL, 0, p7_ALL_CONSENSUS_COLS, &msa) == eslOK)
+	  {
+	    esl_msa_SetName     (msa, hmm->name, -1);
+	    esl_msa_SetAccession(msa, hmm->acc,  -1);
+	    esl_msa_SetDesc     (msa, hmm->desc, -1);
+	    esl_msa_FormatAuthor(msa, "hmmsearcht (HMMER %s)", HMMER_VERSION);
+
+	    if (textw > 0) esl_msafile_Write(afp, msa, eslMSAFILE_STOCKHOLM);
+	    else           esl_msafile_Write(afp, msa, eslMSAFILE_PFAM);
+
+	    if (fprintf(ofp, "# Alignment of %d hits satisfying inclusion thresholds saved to: %s\n", msa->nseq, esl_opt_GetString(go, "-A")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+	  }
+	else { if (fprintf(ofp, "# No hits satisfy inclusion thresholds; no alignment saved\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
+
+	esl_msa_Destroy(msa);
+      }
+
+      p7_pipeline_Destroy(info->pli);
+      p7_tophits_Destroy(info->th);
+      p7_oprofile_Destroy(info->om);
+      p7_oprofile_Destroy(om);
+      p7_profile_Destroy(gm);
+      p7_hmm_Destroy(hmm);
+
+      hstatus = p7_hmmfile_Read(hfp, &abc, &hmm);
+    } /* end outer loop over query HMMs */
+
+  switch(hstatus) {
+  case eslEOD:       p7_Fail("read failed, HMM file %s may be truncated?", cfg->hmmfile);      break;
+  case eslEFORMAT:   p7_Fail("bad file format in HMM file %s",             cfg->hmmfile);      break;
+  case eslEINCOMPAT: p7_Fail("HMM file %s contains different alphabets",   cfg->hmmfile);      break;
+  case eslEOF:       /* do nothing. EOF is what we want. */                                    break;
+  default:           p7_Fail("Unexpected error (%d) in reading HMMs from %s", hstatus, cfg->hmmfile);
+  }
+
+
+  /* Terminate outputs... any last words?
+   */
+  if (esl_opt_GetBoolean(go, "--stagestats")) {
+    if (tblfp)     p7_pli_TabularStageStats(tblfp,     &stagestats);
+    if (domtblfp)  p7_pli_TabularStageStats(domtblfp,  &stagestats);
+    if (pfamtblfp) p7_pli_TabularStageStats(pfamtblfp, &stagestats);
+  }
+  if (tblfp)    p7_tophits_TabularTail(tblfp,    "hmmsearcht", p7_SEARCH_SEQS, cfg->hmmfile, cfg->dbfile, go);
+  if (domtblfp) p7_tophits_TabularTail(domtblfp, "hmmsearcht", p7_SEARCH_SEQS, cfg->hmmfile, cfg->dbfile, go);
+  if (hitfp)    p7_hitfile_WriteTail(hitfp, "hmmsearcht", p7_SEARCH_SEQS, cfg->hmmfile, cfg->dbfile, go);
+  if (pfamtblfp) p7_tophits_TabularTail(pfamtblfp,"hmmsearcht", p7_SEARCH_SEQS, cfg->hmmfile, cfg->dbfile, go);
+  if (ofp)      { if (fprintf(ofp, "[ok]\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
+
+  /* Cleanup - prepare for exit
+   */
+  if (nquery > 0 || hstatus == eslEOF)
+    for (i = 0; i < infocnt && abc; ++i)
+      {
+	p7_bg_Destroy(info[i].bg);
+	p7_orfscan_Destroy(info[i].os);
+	esl_sq_Destroy(info[i].orfsq);
+      }
+
+#ifdef HMMER_THREADS
+  if (ncpus > 0)
+    {
+      esl_workqueue_Reset(queue);
+      while (esl_workqueue_Remove(queue, (void **) &block) == eslOK)
+	esl_sq_DestroyBlock(block);
+      esl_workqueue_Destroy(queue);
+      esl_threads_Destroy(threadObj);
+      p7_domainpool_Destroy(ddpool);
+    }
+#endif
+
+  free(info);
+  p7_hmmfile_Close(hfp);
+  esl_sqfile_Close(dbfp);
+  if (gcode) esl_gencode_Destroy(gcode);
+  esl_alphabet_Destroy(abc);
+  esl_alphabet_Destroy(nt_abc);
+  esl_stopwatch_Destroy(w);
+
+  if (ofp != stdout) fclose(ofp);
+  if (afp)           fclose(afp);
+  if (tblfp)         fclose(tblfp);
+  if (domtblfp)      fclose(domtblfp);
+  if (hitfp)         fclose(hitfp);
+  if (pfamtblfp)     fclose(pfamtblfp);
+
+  return eslOK;
+
+ ERROR:
+  return eslFAIL;
+}
+
+
+/* search_orfs()
+ * Translate DNA sequence <dbsq> into its ORFs, and pass each one
+ * through the pipeline, reporting hits against <dbsq>.
+ */
+static void
+search_orfs(WORKER_INFO *info, const ESL_SQ *dbsq)
+{
+  int status;
+
+  p7_orfscan_SetSequence(info->os, dbsq);
+  while ((status = p7_orfscan_Next(info->os, info->orfsq)) == eslOK)
+    {
+      p7_pli_NewSeq(info->pli, info->orfsq);
+      p7_bg_SetLength(info->bg, info->orfsq->n);
+      p7_oprofile_ReconfigLength(info->om, info->orfsq->n);
+
+      p7_Pipeline(info->pli, info->om, info->bg, info->orfsq, dbsq, info->th);
+
+      p7_pipeline_Reuse(info->pli);
+    }
+  if (status != eslEOF) esl_fatal("Failed to translate sequence %s", dbsq->name);
+  p7_orfscan_SetSequence(info->os, NULL);
+}
+
+
+static int
+serial_loop(WORKER_INFO *info, ESL_SQFILE *dbfp)
+{
+  int      sstatus;
+  ESL_SQ   *dbsq     = NULL;   /* one target DNA sequence (digital)  */
+
+  dbsq = esl_sq_CreateDigital(dbfp->abc);
+
+  /* Main loop: */
+  while ((sstatus = esl_sqio_Read(dbfp, dbsq)) == eslOK)
+    {
+      search_orfs(info, dbsq);
+      esl_sq_Reuse(dbsq);
+    }
+
+  esl_sq_Destroy(dbsq);
+
+  return sstatus;
+}
+
+#ifdef HMMER_THREADS
+static int
+thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp)
+{
+  int  status  = eslOK;
+  int  sstatus = eslOK;
+  int  eofCount = 0;
+  ESL_SQ_BLOCK *block;
+  void         *newBlock;
+
+  esl_workqueue_Reset(queue);
+  esl_threads_WaitForStart(obj);
+
+  status = esl_workqueue_ReaderUpdate(queue, NULL, &newBlock);
+  if (status != eslOK) esl_fatal("Work queue reader failed");
+
+  /* Main loop: */
+  while (sstatus == eslOK )
+    {
+      block = (ESL_SQ_BLOCK *) newBlock;
+
+      sstatus = esl_sqio_ReadBlock(dbfp, block, -1, -1, FALSE);
+
+      if (sstatus == eslEOF)
+	{
+	  if (eofCount < esl_threads_GetWorkerCount(obj)) sstatus = eslOK;
+	  ++eofCount;
+	}
+
+      if (sstatus == eslOK)
+	{
+	  status = esl_workqueue_ReaderUpdate(queue, block, &newBlock);
+	  if (status != eslOK) esl_fatal("Work queue reader failed");
+	}
+    }
+
+  status = esl_workqueue_ReaderUpdate(queue, block, NULL);
+  if (status != eslOK) esl_fatal("Work queue reader failed");
+
+  if (sstatus == eslEOF)
+    {
+      /* wait for all the threads to complete */
+      esl_threads_WaitForFinish(obj);
+      esl_workqueue_Complete(queue);
+    }
+
+  return sstatus;
+}
+
+/* pipeline_thread()
+ * Each worker translates the DNA sequences of the blocks it takes
+ * off the queue itself, so translation runs in parallel too.
+ */
+static void
+pipeline_thread(void *arg)
+{
+  int i;
+  int status;
+  int workeridx;
+  WORKER_INFO   *info;
+  ESL_THREADS   *obj;
+
+  ESL_SQ_BLOCK  *block = NULL;
+  void          *newBlock;
+
+  impl_Init();
+
+  obj = (ESL_THREADS *) arg;
+  esl_threads_Started(obj, &workeridx);
+
+  info = (WORKER_INFO *) esl_threads_GetData(obj, workeridx);
+
+  status = esl_workqueue_WorkerUpdate(info->queue, NULL, &newBlock);
+  if (status != eslOK) esl_fatal("Work queue worker failed");
+
+  /* loop until all blocks have been processed */
+  block = (ESL_SQ_BLOCK *) newBlock;
+  while (block->count > 0)
+    {
+      /* Main loop: */
+      for (i = 0; i < block->count; ++i)
+	{
+	  ESL_SQ *dbsq = block->list + i;
+
+	  search_orfs(info, dbsq);
+	  esl_sq_Reuse(dbsq);
+	}
+
+      status = esl_workqueue_WorkerUpdate(info->queue, block, &newBlock);
+      if (status != eslOK) esl_fatal("Work queue worker failed");
+
+      block = (ESL_SQ_BLOCK *) newBlock;
+    }
+
+  status = esl_workqueue_WorkerUpdate(info->queue, block, NULL);
+  if (status != eslOK) esl_fatal("Work queue worker failed");
+
+  esl_threads_Finished(obj, workeridx);
+  return;
+}
+#endif   /* HMMER_THREADS */
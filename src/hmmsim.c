@@ -29,10 +29,23 @@
 #include "esl_stopwatch.h"
 #include "esl_vectorops.h"
 
+#ifdef HMMER_THREADS
+#include "esl_threads.h"
+#endif /*HMMER_THREADS*/
+
 #include "hmmer.h"
 
 #define ALGORITHMS "--fwd,--vit,--hyb,--msv"           /* Exclusive choice for scoring algorithms */
 #define STYLES     "--fs,--sw,--ls,--s"	               /* Exclusive choice for alignment mode     */
+#define SIMCHUNK   1000                                /* seqs per RNG stream; streams don't depend on --cpu */
+
+#if defined (HMMER_THREADS) && defined (HMMER_MPI)
+#define CPUOPTS     "--mpi"
+#define MPIOPTS     "--cpu"
+#else
+#define CPUOPTS     NULL
+#define MPIOPTS     NULL
+#endif
 
 static ESL_OPTIONS options[] = {
   /* name           type      default  env  range     toggles   reqs   incomp  help   docgroup*/
@@ -41,8 +54,11 @@ static ESL_OPTIONS options[] = {
   { "-v",        eslARG_NONE,   FALSE, NULL, NULL,      NULL,  NULL, NULL, "verbose: print scores",                             1 },
   { "-L",        eslARG_INT,    "100", NULL, "n>0",     NULL,  NULL, NULL, "length of random target seqs",                      1 },
   { "-N",        eslARG_INT,   "1000", NULL, "n>0",     NULL,  NULL, NULL, "number of random target seqs",                      1 },
+#ifdef HMMER_THREADS
+  { "--cpu",     eslARG_INT, p7_NCPU,"HMMER_NCPU","n>=0",  NULL,  NULL, CPUOPTS, "number of parallel CPU workers to use for multithreads", 1 },
+#endif
 #ifdef HMMER_MPI
-  { "--mpi",     eslARG_NONE,   FALSE, NULL, NULL,      NULL,  NULL, NULL, "run as an MPI parallel program",                    1 },
+  { "--mpi",     eslARG_NONE,   FALSE, NULL, NULL,      NULL,  NULL, MPIOPTS, "run as an MPI parallel program",                 1 },
 #endif
   { "-o",        eslARG_OUTFILE, NULL, NULL, NULL,      NULL,  NULL, NULL, "direct output to file <f>, not stdout",             2 },
   { "--afile",   eslARG_OUTFILE, NULL, NULL, NULL,      NULL, "-a",  NULL, "output alignment lengths to file <f>",              2 },
@@ -108,6 +124,7 @@ struct cfg_s {
   int             do_stall;	/* TRUE to stall for MPI debugging */
   int             N;		/* number of simulated seqs per HMM */
   int             L;		/* length of simulated seqs */
+  int             ncpus;	/* >0: # of worker threads scoring each HMM's seqs; 0: serial */
 
   /* Masters only (i/o streams) */
   P7_HMMFILE     *hfp;		/* open input HMM file stream */
@@ -128,7 +145,31 @@ static void mpi_master     (ESL_GETOPTS *go, struct cfg_s *cfg);
 static void mpi_worker     (ESL_GETOPTS *go, struct cfg_s *cfg);
 static int  minimum_mpi_working_buffer(ESL_GETOPTS *go, int N, int *ret_wn);
 #endif 
+/* WORKER_INFO: one share of a work unit's N simulated sequences,
+ * scores[i0..i1-1]. The N seqs are sampled in chunks of SIMCHUNK,
+ * chunk c from an RNG stream seeded with seed[c], so the sequences
+ * are the same however many shares there are. In serial mode there's
+ * one share.
+ */
+typedef struct {
+  ESL_GETOPTS    *go;
+  struct cfg_s   *cfg;
+  ESL_RANDOMNESS *r;		/* this share's RNG, reseeded at each chunk      */
+  uint32_t       *seed;		/* seed[c] for chunk c; shared, read-only        */
+  P7_PROFILE     *gm;		/* configured profile; shared, read-only         */
+  P7_OPROFILE    *om;		/* optimized profile; shared, read-only          */
+  double         *scores;	/* shared result array; this share fills i0..i1-1 */
+  int            *alilens;	/* optional alignment lengths, ditto (or NULL)   */
+  int             i0, i1;	/* this share is seqs i0..i1-1 (whole chunks)    */
+  int             status;	/* eslOK, or error code with msg in <errbuf>     */
+  char            errbuf[eslERRBUFSIZE];
+} WORKER_INFO;
+
 static int process_workunit   (ESL_GETOPTS *go, struct cfg_s *cfg, char *errbuf, P7_HMM *hmm, double *scores, int *alilens, double *ret_mu, double *ret_lambda);
+static int score_share        (WORKER_INFO *info);
+#ifdef HMMER_THREADS
+static void score_thread      (void *arg);
+#endif
 static int output_result      (ESL_GETOPTS *go, struct cfg_s *cfg, char *errbuf, P7_HMM *hmm, double *scores, int *alilens, double mu, double lambda);
 static int output_filter_power(ESL_GETOPTS *go, struct cfg_s *cfg, char *errbuf, P7_HMM *hmm, double *scores, double mu, double lambda);
 
@@ -199,6 +240,10 @@ main(int argc, char **argv)
   cfg.do_stall = esl_opt_GetBoolean(go, "--stall");
   cfg.N        = esl_opt_GetInteger(go, "-N");
   cfg.L        = esl_opt_GetInteger(go, "-L");
+  cfg.ncpus    = 0;
+#ifdef HMMER_THREADS
+  cfg.ncpus    = ESL_MIN(esl_opt_GetInteger(go, "--cpu"), esl_threads_GetCPUCount());
+#endif
   cfg.hfp      = NULL;
   cfg.ofp      = NULL;
   cfg.survfp   = NULL;
@@ -215,6 +260,9 @@ main(int argc, char **argv)
   while (cfg.do_stall); 
 
 
+  impl_Init();                  /* processor specific initialization */
+  p7_FLogsumInit();		/* initialize the logsum table once, before any worker threads use it */
+
   /* Start timing. */
   esl_stopwatch_Start(w);
 
@@ -229,6 +277,7 @@ main(int argc, char **argv)
        * this show (proc 0) or working in it (procs >0).
        */
       cfg.do_mpi = TRUE;
+      cfg.ncpus  = 0;		/* the MPI implementation is not multithreaded */
       MPI_Init(&argc, &argv);
       MPI_Comm_rank(MPI_COMM_WORLD, &(cfg.my_rank));
       MPI_Comm_size(MPI_COMM_WORLD, &(cfg.nproc));
@@ -354,12 +403,12 @@ init_master_cfg(ESL_GETOPTS *go, struct cfg_s *cfg, char *errbuf)
 static void
 serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 {
-  P7_HMM     *hmm = NULL;     
-  double     *xv  = NULL;	/* results: array of N scores */
-  int        *av  = NULL;	/* optional results: array of N alignment lengths */
-  double      mu, lambda;
-  char        errbuf[eslERRBUFSIZE];
-  int         status;
+  P7_HMM        *hmm = NULL;     
+  double        *xv  = NULL;	/* results: array of N scores */
+  int           *av  = NULL;	/* optional results: array of N alignment lengths */
+  double         mu, lambda;
+  char           errbuf[eslERRBUFSIZE];
+  int            status;
 
 
   if ((status = init_master_cfg(go, cfg, errbuf)) != eslOK) p7_Fail(errbuf);
@@ -600,6 +649,12 @@ mpi_worker(ESL_GETOPTS *go, struct cfg_s *cfg)
  * The result is the <scores> array, which contains an array of N scores;
  * caller provides this memory.
  * How those scores are generated is controlled by the application configuration in <cfg>.
+ *
+ * The N sequences are sampled in chunks of SIMCHUNK, each chunk from
+ * its own RNG stream seeded from the master's in chunk order. With
+ * worker threads (cfg->ncpus > 0), the chunks are split into one
+ * contiguous share per thread. The scores depend on --seed but not on
+ * the number of threads.
  */
 static int
 process_workunit(ESL_GETOPTS *go, struct cfg_s *cfg, char *errbuf, P7_HMM *hmm, double *scores, int *alilens, double *ret_mu, double *ret_lambda)
@@ -607,15 +662,12 @@ process_workunit(ESL_GETOPTS *go, struct cfg_s *cfg, char *errbuf, P7_HMM *hmm,
   int             L   = esl_opt_GetInteger(go, "-L");
   P7_PROFILE     *gm  = NULL;
   P7_OPROFILE    *om  = NULL;
-  P7_GMX         *gx  = NULL;
-  P7_OMX         *ox  = NULL;
-  P7_TRACE       *tr  = NULL;
-  ESL_DSQ        *dsq = NULL;
-  int             i;
+  WORKER_INFO    *info = NULL;
+  uint32_t       *seed = NULL;
+  int             nchunk = (cfg->N + SIMCHUNK - 1) / SIMCHUNK;
+  int             ninfo  = ESL_MAX(1, ESL_MIN(cfg->ncpus, nchunk));
+  int             t, c;
   int             status;
-  int    scounts[p7T_NSTATETYPES]; /* state usage counts from a trace */
-  float  sc;
-  float  nullsc;
   double mu, lambda;
   int    EmL          = esl_opt_GetInteger(go, "--EmL");
   int    EmN          = esl_opt_GetInteger(go, "--EmN");
@@ -624,7 +676,9 @@ process_workunit(ESL_GETOPTS *go, struct cfg_s *cfg, char *errbuf, P7_HMM *hmm,
   int    EfL          = esl_opt_GetInteger(go, "--EfL");
   int    EfN          = esl_opt_GetInteger(go, "--EfN");
   double Eft          = esl_opt_GetReal   (go, "--Eft");
-  float  nu           = esl_opt_GetReal   (go, "--nu");
+#ifdef HMMER_THREADS
+  ESL_THREADS    *threadObj = NULL;
+#endif
 
   /* Optionally set a custom background, determined by model composition;
    * an experimental hack. 
@@ -662,25 +716,120 @@ process_workunit(ESL_GETOPTS *go, struct cfg_s *cfg, char *errbuf, P7_HMM *hmm,
   p7_oprofile_Convert(gm, om);
   p7_bg_SetLength    (cfg->bg, L);
 
-  /* Remaining allocations */
+  /* One RNG seed per chunk of SIMCHUNK seqs, drawn in chunk order;
+   * then divide the chunks into shares, one per worker.
+   */
+  ESL_ALLOC(seed, sizeof(uint32_t) * nchunk);
+  for (c = 0; c < nchunk; c++) seed[c] = 1 + esl_rnd_Roll(cfg->r, 2147483646);
+
+  ESL_ALLOC(info, sizeof(WORKER_INFO) * ninfo);
+  for (t = 0; t < ninfo; t++) info[t].r = NULL;
+  for (t = 0; t < ninfo; t++)
+    {
+      info[t].go      = go;
+      info[t].cfg     = cfg;
+      info[t].seed    = seed;
+      info[t].gm      = gm;
+      info[t].om      = om;
+      info[t].scores  = scores;
+      info[t].alilens = alilens;
+      info[t].i0      = ESL_MIN(cfg->N, SIMCHUNK * (int) ((int64_t) nchunk * t     / ninfo));
+      info[t].i1      = ESL_MIN(cfg->N, SIMCHUNK * (int) ((int64_t) nchunk * (t+1) / ninfo));
+      info[t].status  = eslOK;
+      info[t].errbuf[0] = '\0';
+      if ((info[t].r = esl_randomness_Create(seed[info[t].i0 / SIMCHUNK])) == NULL) ESL_XFAIL(eslEMEM, errbuf, "allocation failure");
+    }
+
+  if (ninfo == 1) score_share(&info[0]);
+#ifdef HMMER_THREADS
+  else
+    {
+      if ((threadObj = esl_threads_Create(&score_thread)) == NULL) ESL_XFAIL(eslEMEM, errbuf, "failed to create worker threads");
+      for (t = 0; t < ninfo; t++) esl_threads_AddThread(threadObj, &info[t]);
+      esl_threads_WaitForStart (threadObj);
+      esl_threads_WaitForFinish(threadObj);
+    }
+#endif
+
+  for (t = 0; t < ninfo; t++)
+    if (info[t].status != eslOK) ESL_XFAIL(info[t].status, errbuf, "%s", info[t].errbuf);
+
+  *ret_mu     = mu;
+  *ret_lambda = lambda;
+  status      = eslOK;
+
+ ERROR:
+#ifdef HMMER_THREADS
+  if (threadObj != NULL) esl_threads_Destroy(threadObj);
+#endif
+  if (info != NULL)
+    for (t = 0; t < ninfo; t++)
+      if (info[t].r != NULL) esl_randomness_Destroy(info[t].r);
+  if (info != NULL) free(info);
+  if (seed != NULL) free(seed);
+  p7_oprofile_Destroy(om);
+  p7_profile_Destroy(gm);
+  if (status == eslEMEM) sprintf(errbuf, "allocation failure");
+  return status;
+}
+
+
+/* score_share()
+ *
+ * Samples and scores one worker's share of the random sequences,
+ * <info->i0..i1-1>, with the configured profile: the inner loop
+ * of <process_workunit()>, run either serially or in a worker thread.
+ * Returns <eslOK> on success; on failure, returns an error code and
+ * leaves a message in <info->errbuf>.
+ */
+static int
+score_share(WORKER_INFO *info)
+{
+  ESL_GETOPTS    *go  = info->go;
+  struct cfg_s   *cfg = info->cfg;
+  P7_PROFILE     *gm  = info->gm;
+  P7_OPROFILE    *om  = info->om;
+  int             L   = esl_opt_GetInteger(go, "-L");
+  P7_GMX         *gx  = NULL;
+  P7_OMX         *ox  = NULL;
+  P7_TRACE       *tr  = NULL;
+  ESL_DSQ        *dsq = NULL;
+  int             i;
+  int             status;
+  int    scounts[p7T_NSTATETYPES]; /* state usage counts from a trace */
+  float  sc;
+  float  nullsc;
+  float  nu           = esl_opt_GetReal   (go, "--nu");
+
+  /* Allocations */
   gx = p7_gmx_Create(gm->M, L);
   ox = p7_omx_Create(gm->M, 0, L);
   ESL_ALLOC(dsq, sizeof(ESL_DSQ) * (L+2));
   tr = p7_trace_Create();
+  if (gx == NULL || ox == NULL || tr == NULL) { status = eslEMEM; goto ERROR; }
 
-  /* Collect scores from N random sequences of length L  */
-  for (i = 0; i < cfg->N; i++)
+  /* Collect scores from our share of the N random sequences of length L  */
+  for (i = info->i0; i < info->i1; i++)
     {
-      esl_rsq_xfIID(cfg->r, cfg->bg->f, cfg->abc->K, L, dsq);
+      if (i % SIMCHUNK == 0 && i > info->i0) esl_randomness_Init(info->r, info->seed[i / SIMCHUNK]);
+      esl_rsq_xfIID(info->r, cfg->bg->f, cfg->abc->K, L, dsq);
 
       if (esl_opt_GetBoolean(go, "--fast")) 
 	{
-	  if      (esl_opt_GetBoolean(go, "--vit")) p7_ViterbiFilter(dsq, L, om, ox, &sc);
-	  else if (esl_opt_GetBoolean(go, "--fwd")) p7_ForwardParser(dsq, L, om, ox, &sc);
+	  /* The Viterbi and MSV filters are local-only; the Forward parser
+	   * takes any mode, but may run out of range (eslERANGE). There's
+	   * no optimized Hybrid. -a needs the generic Viterbi matrix for
+	   * its traceback.
+	   */
+	  if      (esl_opt_GetBoolean(go, "--fwd")) { if (p7_ForwardParser(dsq, L, om, ox, &sc) != eslOK) sc = eslINFINITY; }
+	  else if (! p7_oprofile_IsLocal(om))       sc = eslINFINITY;
+	  else if (esl_opt_GetBoolean(go, "-a"))    sc = eslINFINITY;
+	  else if (esl_opt_GetBoolean(go, "--vit")) p7_ViterbiFilter(dsq, L, om, ox, &sc);
 	  else if (esl_opt_GetBoolean(go, "--msv")) p7_MSVFilter    (dsq, L, om, ox, &sc);
+	  else                                      sc = eslINFINITY;
 	} 
 
-      if (! esl_opt_GetBoolean(go, "--fast") || sc == eslINFINITY) /* note, if a filter overflows, failover to slow versions */
+      if (! esl_opt_GetBoolean(go, "--fast") || sc == eslINFINITY) /* note, if a filter overflows or can't be used, failover to slow versions */
 	{
 	  if      (esl_opt_GetBoolean(go, "--vit")) p7_GViterbi(dsq, L, gm, gx,       &sc);
 	  else if (esl_opt_GetBoolean(go, "--fwd")) p7_GForward(dsq, L, gm, gx,       &sc);
@@ -699,31 +848,53 @@ process_workunit(ESL_GETOPTS *go, struct cfg_s *cfg, char *errbuf, P7_HMM *hmm,
            * score vs al would gives us relative entropy / model position.
 	   */
 	  /* alilens[i] = scounts[p7T_D] + scounts[p7T_I]; SRE: temporarily testing this instead */
-	  alilens[i] = scounts[p7T_M] + scounts[p7T_D] + scounts[p7T_I];
+	  info->alilens[i] = scounts[p7T_M] + scounts[p7T_D] + scounts[p7T_I];
 
 	  p7_trace_Reuse(tr);
 	}
 
       p7_bg_NullOne(cfg->bg, dsq, L, &nullsc);
-      scores[i] = (sc - nullsc) / eslCONST_LOG2;
+      info->scores[i] = (sc - nullsc) / eslCONST_LOG2;
     }
 
-  *ret_mu     = mu;
-  *ret_lambda = lambda;
-  status      = eslOK;
+  status = eslOK;
 
  ERROR:
   if (dsq != NULL) free(dsq);
   p7_omx_Destroy(ox);
-  p7_oprofile_Destroy(om);
-  p7_profile_Destroy(gm);
   p7_gmx_Destroy(gx);
   p7_trace_Destroy(tr);
-  if (status == eslEMEM) sprintf(errbuf, "allocation failure");
+  if (status == eslEMEM) sprintf(info->errbuf, "allocation failure");
+  info->status = status;
   return status;
 }
 
 
+#ifdef HMMER_THREADS
+/* score_thread()
+ * A worker thread: scores one share of a work unit's sequences.
+ */
+static void 
+score_thread(void *arg)
+{
+  int          workeridx;
+  WORKER_INFO *info;
+  ESL_THREADS *obj;
+
+  impl_Init();
+
+  obj = (ESL_THREADS *) arg;
+  esl_threads_Started(obj, &workeridx);
+
+  info = (WORKER_INFO *) esl_threads_GetData(obj, workeridx);
+  score_share(info);
+
+  esl_threads_Finished(obj, workeridx);
+  return;
+}
+#endif /*HMMER_THREADS*/
+
+
 static int 
 output_result(ESL_GETOPTS *go, struct cfg_s *cfg, char *errbuf, P7_HMM *hmm, double *scores, int *alilens, double pmu, double plambda)
 {
@@ -748,7 +919,7 @@ output_result(ESL_GETOPTS *go, struct cfg_s *cfg, char *errbuf, P7_HMM *hmm, dou
   /* optional "filter power" data file: <hmm name> <# seqs <= P threshold> <fraction of seqs <= P threshold>  */
   if (cfg->ffp)                      output_filter_power(go, cfg, errbuf, hmm, scores, pmu, plambda);
 
-  /* Count the scores into a histogram object.  */
+  /* Count the scores into a histogram object, in sequence order. */
   if ((h = esl_histogram_CreateFull(-50., 50., 0.2)) == NULL) ESL_XFAIL(eslEMEM, errbuf, "allocation failed");
   for (i = 0; i < cfg->N; i++) esl_histogram_Add(h, scores[i]);
 
@@ -855,7 +1026,7 @@ output_result(ESL_GETOPTS *go, struct cfg_s *cfg, char *errbuf, P7_HMM *hmm, dou
   /* fallthrough: both normal, error cases execute same cleanup code */
   status = eslOK;
  ERROR:
-  esl_histogram_Destroy(h);
+  if (h != NULL) esl_histogram_Destroy(h);
   return status;
 }
 
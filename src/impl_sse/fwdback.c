@@ -66,11 +66,13 @@ static int backward_engine(int do_full, const ESL_DSQ *dsq, int L, const P7_OPRO
  *            by calling <ox = p7_omx_Create(M, L, L)> or
  *            <p7_omx_GrowTo(ox, M, L, L)>.
  *
- *            The model <om> must be configured in local alignment
- *            mode. The sparse rescaling method used to keep
- *            probability values within single-precision floating
- *            point dynamic range cannot be safely applied to models in
- *            glocal or global mode.
+ *            The model <om> may be in any alignment mode. In local
+ *            modes, any Mk can reach E, and the sparse rescaling is
+ *            triggered by E. In glocal modes, only M_M and D_M reach
+ *            E (left wing retraction is already folded into the B->Mk
+ *            entries), so high-scoring paths can build up in the
+ *            row without reaching E; rescaling is then triggered by
+ *            the sum of the row's M and D cells instead.
  *
  * Args:      dsq     - digital target sequence, 1..L
  *            L       - length of dsq in residues          
@@ -79,9 +81,11 @@ static int backward_engine(int do_full, const ESL_DSQ *dsq, int L, const P7_OPRO
  *            opt_sc  - RETURN: Forward score (in nats)          
  *
  * Returns:   <eslOK> on success. 
+ *            <eslERANGE> if <om> is in a glocal mode and the score
+ *            underflows single-precision range; the caller should
+ *            fail over to the generic implementation.
  *
- * Throws:    <eslEINVAL> if <ox> allocation is too small, or if the profile
- *            isn't in local alignment mode.
+ * Throws:    <eslEINVAL> if <ox> allocation is too small.
  *            <eslERANGE> if the score exceeds the limited range of
  *            a probability-space odds ratio.
  *            In either case, <*opt_sc> is undefined.
@@ -93,7 +97,6 @@ p7_Forward(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *
   if (om->M >  ox->allocQ4*4)    ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small (too few columns)");
   if (L     >= ox->validR)       ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small (too few MDI rows)");
   if (L     >= ox->allocXR)      ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small (too few X rows)");
-  if (! p7_oprofile_IsLocal(om)) ESL_EXCEPTION(eslEINVAL, "Forward implementation makes assumptions that only work for local alignment");
 #endif
 
   return forward_engine(TRUE, dsq, L, om, ox, opt_sc);
@@ -121,9 +124,11 @@ p7_Forward(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *
  *            ret_sc  - RETURN: Forward score (in nats)          
  *
  * Returns:   <eslOK> on success.
+ *            <eslERANGE> if <om> is in a glocal mode and the score
+ *            underflows single-precision range; the caller should
+ *            fail over to the generic implementation.
  *
- * Throws:    <eslEINVAL> if <ox> allocation is too small, or if the profile
- *            isn't in local alignment mode.
+ * Throws:    <eslEINVAL> if <ox> allocation is too small.
  *            <eslERANGE> if the score exceeds the limited range of
  *            a probability-space odds ratio.
  *            In either case, <*opt_sc> is undefined.
@@ -135,7 +140,6 @@ p7_ForwardParser(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, f
   if (om->M >  ox->allocQ4*4)    ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small (too few columns)");
   if (ox->validR < 1)            ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small (too few MDI rows)");
   if (L     >= ox->allocXR)      ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small (too few X rows)");
-  if (! p7_oprofile_IsLocal(om)) ESL_EXCEPTION(eslEINVAL, "Forward implementation makes assumptions that only work for local alignment");
 #endif
 
   return forward_engine(FALSE, dsq, L, om, ox, opt_sc);
@@ -164,11 +168,8 @@ p7_ForwardParser(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, f
  *            the <fwd> matrix, the caller may have this matrix
  *            calculated either in full or parsing mode.
  *            
- *            The model <om> must be configured in local alignment
- *            mode. The sparse rescaling method used to keep
- *            probability values within single-precision floating
- *            point dynamic range cannot be safely applied to models in
- *            glocal or global mode.
+ *            The model <om> may be in any alignment mode; see
+ *            <p7_Forward()>.
  *
  * Args:      dsq     - digital target sequence, 1..L
  *            L       - length of dsq in residues          
@@ -179,9 +180,11 @@ p7_ForwardParser(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, f
  *            opt_sc  - optRETURN: Backward score (in nats)          
  *
  * Returns:   <eslOK> on success. 
+ *            <eslERANGE> if <om> is in a glocal mode and the score
+ *            underflows single-precision range; the caller should
+ *            fail over to the generic implementation.
  *
- * Throws:    <eslEINVAL> if <ox> allocation is too small, or if the profile
- *            isn't in local alignment mode.
+ * Throws:    <eslEINVAL> if <ox> allocation is too small.
  *            <eslERANGE> if the score exceeds the limited range of
  *            a probability-space odds ratio.
  *            In either case, <*opt_sc> is undefined.
@@ -194,7 +197,6 @@ p7_Backward(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *fwd,
   if (L     >= bck->validR)       ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small (too few MDI rows)");
   if (L     >= bck->allocXR)      ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small (too few X rows)");
   if (L     != fwd->L)            ESL_EXCEPTION(eslEINVAL, "fwd matrix size doesn't agree with length L");
-  if (! p7_oprofile_IsLocal(om))  ESL_EXCEPTION(eslEINVAL, "Forward implementation makes assumptions that only work for local alignment");
 #endif
 
  return backward_engine(TRUE, dsq, L, om, fwd, bck, opt_sc);
@@ -225,9 +227,11 @@ p7_Backward(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *fwd,
  *            opt_sc  - optRETURN: Backward score (in nats)          
  *
  * Returns:   <eslOK> on success. 
+ *            <eslERANGE> if <om> is in a glocal mode and the score
+ *            underflows single-precision range; the caller should
+ *            fail over to the generic implementation.
  *
- * Throws:    <eslEINVAL> if <ox> allocation is too small, or if the profile
- *            isn't in local alignment mode.
+ * Throws:    <eslEINVAL> if <ox> allocation is too small.
  *            <eslERANGE> if the score exceeds the limited range of
  *            a probability-space odds ratio.
  *            In either case, <*opt_sc> is undefined.
@@ -240,7 +244,6 @@ p7_BackwardParser(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX
   if (bck->validR < 1)            ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small (too few MDI rows)");
   if (L     >= bck->allocXR)      ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small (too few X rows)");
   if (L     != fwd->L)            ESL_EXCEPTION(eslEINVAL, "fwd matrix size doesn't agree with length L");
-  if (! p7_oprofile_IsLocal(om))  ESL_EXCEPTION(eslEINVAL, "Forward implementation makes assumptions that only work for local alignment");
 #endif
 
   return backward_engine(FALSE, dsq, L, om, fwd, bck, opt_sc);
@@ -262,10 +265,16 @@ forward_engine(int do_full, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7
   register __m128 xBv;		   /* B state: splatted vector of B[i-1] for B->Mk calculations */
   __m128   zerov;		   /* splatted 0.0's in a vector                                */
   float    xN, xE, xB, xC, xJ;	   /* special states' scores                                    */
+  float    xT;			   /* sum of the row's M,D cells; rescaling trigger in glocal   */
+  float    scale;		   /* sparse rescaling factor for the row                       */
   int i;			   /* counter over sequence positions 1..L                      */
   int q;			   /* counter over quads 0..nq-1                                */
   int j;			   /* counter over DD iterations (4 is full serialization)      */
   int Q       = p7O_NQF(om->M);	   /* segment length: # of vectors                              */
+  int is_local = p7_oprofile_IsLocal(om);
+  int qM      = (om->M-1) % Q;	   /* M_M is element <zM> of quad <qM>                          */
+  int zM      = (om->M-1) / Q;
+  union { __m128 v; float x[4]; } tmp;
   __m128 *dpc = ox->dpf[0];        /* current row, for use in {MDI}MO(dpp,q) access macro       */
   __m128 *dpp;                     /* previous row, for use in {MDI}MO(dpp,q) access macro      */
   __m128 *rp;			   /* will point at om->rfv[x] for residue x[i]                 */
@@ -406,7 +415,16 @@ forward_engine(int do_full, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7
        */
       xEv = _mm_add_ps(xEv, _mm_shuffle_ps(xEv, xEv, _MM_SHUFFLE(0, 3, 2, 1)));
       xEv = _mm_add_ps(xEv, _mm_shuffle_ps(xEv, xEv, _MM_SHUFFLE(1, 0, 3, 2)));
-      _mm_store_ss(&xE, xEv);
+      _mm_store_ss(&xT, xEv);
+
+      /* In glocal modes, only M_M and D_M reach E; the sum over the row
+       * is kept only as the rescaling trigger.
+       */
+      if (is_local) xE = xT;
+      else {
+	tmp.v = _mm_add_ps(MMO(dpc,qM), DMO(dpc,qM));
+	xE    = tmp.x[zM];
+      }
 
       xN =  xN * om->xf[p7O_N][p7O_LOOP];
       xC = (xC * om->xf[p7O_C][p7O_LOOP]) +  (xE * om->xf[p7O_E][p7O_MOVE]);
@@ -414,23 +432,30 @@ forward_engine(int do_full, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7
       xB = (xJ * om->xf[p7O_J][p7O_MOVE]) +  (xN * om->xf[p7O_N][p7O_MOVE]);
       /* and now xB will carry over into next i, and xC carries over after i=L */
 
-      /* Sparse rescaling. xE above threshold? trigger a rescaling event.            */
-      if (xE > 1.0e4)	/* that's a little less than e^10, ~10% of our dynamic range */
+      /* Sparse rescaling. xE (or, in glocal, the row sum) above threshold? trigger a rescaling event. */
+      scale = (is_local ? xE : ESL_MAX(xE, xT));
+      /* A glocal row can also sink toward underflow, on a long target
+       * that's mostly unrelated to the model; then it's rescaled up,
+       * by its largest value, specials included.
+       */
+      if (! is_local && scale < 1.0e-4)
+	scale = ESL_MAX(ESL_MAX(scale, xN), ESL_MAX(ESL_MAX(xJ, xB), xC));
+      if (scale > 1.0e4 || (! is_local && scale < 1.0e-4 && scale > 0.0))	/* that's a little less than e^10, ~10% of our dynamic range */
 	{
-	  xN  = xN / xE;
-	  xC  = xC / xE;
-	  xJ  = xJ / xE;
-	  xB  = xB / xE;
-	  xEv = _mm_set1_ps(1.0 / xE);
+	  xN  = xN / scale;
+	  xC  = xC / scale;
+	  xJ  = xJ / scale;
+	  xB  = xB / scale;
+	  xE  = xE / scale;
+	  xEv = _mm_set1_ps(1.0 / scale);
 	  for (q = 0; q < Q; q++)
 	    {
 	      MMO(dpc,q) = _mm_mul_ps(MMO(dpc,q), xEv);
 	      DMO(dpc,q) = _mm_mul_ps(DMO(dpc,q), xEv);
 	      IMO(dpc,q) = _mm_mul_ps(IMO(dpc,q), xEv);
 	    }
-	  ox->xmx[i*p7X_NXCELLS+p7X_SCALE] = xE;
-	  ox->totscale += log(xE);
-	  xE = 1.0;		
+	  ox->xmx[i*p7X_NXCELLS+p7X_SCALE] = scale;
+	  ox->totscale += log(scale);
 	}
       else ox->xmx[i*p7X_NXCELLS+p7X_SCALE] = 1.0;
 
@@ -454,6 +479,13 @@ forward_engine(int do_full, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7
   /* On an underflow (which shouldn't happen), we counterintuitively return infinity:
    * the effect of this is to force the caller to rescore us with full range.
    */
+  /* In glocal modes, a target much shorter than the model can leave
+   * every path to E below single-precision range. That's a limitation
+   * of the mode, not an error: return normally, so the caller can
+   * fail over to the generic implementation.
+   */
+  if (! is_local && L>0 && xC == 0.0) return eslERANGE;
+
   if       (isnan(xC))        ESL_EXCEPTION(eslERANGE, "forward score is NaN");
   else if  (L>0 && xC == 0.0) ESL_EXCEPTION(eslERANGE, "forward score underflow (is 0.0)");     /* if L==0, xC *should* be 0.0; J5/118 */
   else if  (isinf(xC) == 1)   ESL_EXCEPTION(eslERANGE, "forward score overflow (is infinity)");
@@ -473,11 +505,17 @@ backward_engine(int do_full, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, c
   register __m128 xBv;		      /* collects B->Mk components of B(i)                         */
   register __m128 xEv;	              /* splatted E(i)                                             */
   __m128   zerov;		      /* splatted 0.0's in a vector                                */
+  __m128   emv;			      /* 1.0 for the lanes of Mk,Dk that reach E in glocal, else 0 */
   float    xN, xE, xB, xC, xJ;	      /* special states' scores                                    */
+  float    xT;			      /* in glocal, B(i) or the row's M,D sum, if larger           */
   int      i;			      /* counter over sequence positions 0,1..L                    */
   int      q;			      /* counter over quads 0..Q-1                                 */
   int      Q       = p7O_NQF(om->M);  /* segment length: # of vectors                              */
   int      j;			      /* DD segment iteration counter (4 = full serialization)     */
+  int      is_local = p7_oprofile_IsLocal(om);
+  int      qM      = (om->M-1) % Q;   /* M_M is element <zM> of quad <qM>                          */
+  int      zM      = (om->M-1) / Q;
+  union { __m128 v; float x[4]; } tmp;
   __m128  *dpc;                       /* current DP row                                            */
   __m128  *dpp;			      /* next ("previous") DP row                                  */
   __m128  *rp;			      /* will point into om->rfv[x] for residue x[i+1]             */
@@ -496,12 +534,20 @@ backward_engine(int do_full, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, c
   xEv    = _mm_set1_ps(xE); 
   zerov  = _mm_setzero_ps();  
   dcv    = zerov;		/* solely to silence a compiler warning */
-  for (q = 0; q < Q; q++) MMO(dpc,q) = DMO(dpc,q) = xEv;
+  tmp.v  = zerov;
+  tmp.x[zM] = 1.0;
+  emv    = tmp.v;
+  if (is_local) {
+    for (q = 0; q < Q; q++) MMO(dpc,q) = DMO(dpc,q) = xEv;
+  } else {			/* glocal: only M_M, D_M reach E */
+    for (q = 0; q < Q; q++) MMO(dpc,q) = DMO(dpc,q) = zerov;
+    MMO(dpc,qM) = DMO(dpc,qM) = _mm_mul_ps(xEv, emv);
+  }
   for (q = 0; q < Q; q++) IMO(dpc,q) = zerov;
 
   /* init row L's DD paths, 1) first segment includes xE, from DMO(q) */
   tp  = om->tfv + 8*Q - 1;	                        /* <*tp> now the [4 8 12 x] TDD quad         */
-  dpv = _mm_move_ss(DMO(dpc,Q-1), zerov);               /* start leftshift: [1 5 9 13] -> [x 5 9 13] */
+  dpv = _mm_move_ss(DMO(dpc,0), zerov);                 /* start leftshift: [1 5 9 13] -> [x 5 9 13] */
   dpv = _mm_shuffle_ps(dpv, dpv, _MM_SHUFFLE(0,3,2,1)); /* finish leftshift:[x 5 9 13] -> [5 9 13 x] */
   for (q = Q-1; q >= 0; q--)
     {
@@ -531,8 +577,8 @@ backward_engine(int do_full, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, c
       dcv        = DMO(dpc,q);
     }
 
-  /* Sparse rescaling: same scale factors as fwd matrix */
-  if (fwd->xmx[L*p7X_NXCELLS+p7X_SCALE] > 1.0)
+  /* Sparse rescaling: same scale factors as fwd matrix (which, in glocal, may be < 1) */
+  if (fwd->xmx[L*p7X_NXCELLS+p7X_SCALE] != 1.0)
     {
       xE  = xE / fwd->xmx[L*p7X_NXCELLS+p7X_SCALE];
       xN  = xN / fwd->xmx[L*p7X_NXCELLS+p7X_SCALE];
@@ -610,6 +656,17 @@ backward_engine(int do_full, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, c
       xE = (xC * om->xf[p7O_E][p7O_MOVE]) + (xJ * om->xf[p7O_E][p7O_LOOP]); /* must come after xJ, xC */
       xEv = _mm_set1_ps(xE);	/* splat */
 
+      /* In glocal modes, only M_M and D_M reach E: add E to them
+       * alone, and take it out of phase 3's {MD}->E paths.
+       */
+      if (! is_local)
+	{
+	  xEv         = _mm_mul_ps(xEv, emv);
+	  MMO(dpc,qM) = _mm_add_ps(MMO(dpc,qM), xEv);
+	  DMO(dpc,qM) = _mm_add_ps(DMO(dpc,qM), xEv);
+	  xEv         = zerov;
+	}
+
 
       /* phase 3: {MD}->E paths and one step of the D->D paths */
       tp  = om->tfv + 8*Q - 1;	/* <*tp> now the [4 8 12 x] TDD quad */
@@ -656,12 +713,26 @@ backward_engine(int do_full, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, c
        * from those in <fwd>. This will complicate subsequent
        * posterior decoding routines.
        */
-      if (xB > 1.0e16) bck->has_own_scales = TRUE;
+      /* In glocal modes, a row can build up high-scoring paths that
+       * haven't yet reached B, so the row's sum is watched too.
+       */
+      xT = xB;
+      if (! is_local)
+	{
+	  xBv = zerov;
+	  for (q = 0; q < Q; q++) xBv = _mm_add_ps(xBv, _mm_add_ps(MMO(dpc,q), DMO(dpc,q)));
+	  xBv = _mm_add_ps(xBv, _mm_shuffle_ps(xBv, xBv, _MM_SHUFFLE(0, 3, 2, 1)));
+	  xBv = _mm_add_ps(xBv, _mm_shuffle_ps(xBv, xBv, _MM_SHUFFLE(1, 0, 3, 2)));
+	  _mm_store_ss(&xT, xBv);
+	  xT = ESL_MAX(xT, xB);
+	}
 
-      if      (bck->has_own_scales)  bck->xmx[i*p7X_NXCELLS+p7X_SCALE] = (xB > 1.0e4) ? xB : 1.0;
+      if (xT > 1.0e16) bck->has_own_scales = TRUE;
+
+      if      (bck->has_own_scales)  bck->xmx[i*p7X_NXCELLS+p7X_SCALE] = (xT > 1.0e4) ? xT : 1.0;
       else                           bck->xmx[i*p7X_NXCELLS+p7X_SCALE] = fwd->xmx[i*p7X_NXCELLS+p7X_SCALE];
 
-      if (bck->xmx[i*p7X_NXCELLS+p7X_SCALE] > 1.0)
+      if (bck->xmx[i*p7X_NXCELLS+p7X_SCALE] != 1.0)
 	{
 	  xE /= bck->xmx[i*p7X_NXCELLS+p7X_SCALE];
 	  xN /= bck->xmx[i*p7X_NXCELLS+p7X_SCALE];
@@ -724,6 +795,8 @@ backward_engine(int do_full, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, c
   if (bck->debugging) p7_omx_DumpFBRow(bck, TRUE, 0, 9, 4, bck->xmx[p7X_E], bck->xmx[p7X_N],  bck->xmx[p7X_J], bck->xmx[p7X_B],  bck->xmx[p7X_C]);	/* logify=TRUE, <rowi>=0, width=9, precision=4*/
 #endif
 
+  if (! is_local && L>0 && xN == 0.0) return eslERANGE; /* glocal range limit; see forward_engine() */
+
   if       (isnan(xN))        ESL_EXCEPTION(eslERANGE, "backward score is NaN");
   else if  (L>0 && xN == 0.0) ESL_EXCEPTION(eslERANGE, "backward score underflow (is 0.0)");    /* if L==0, xN *should* be 0.0 [J5/118]*/
   else if  (isinf(xN) == 1)   ESL_EXCEPTION(eslERANGE, "backward score overflow (is infinity)");
@@ -888,10 +961,11 @@ main(int argc, char **argv)
 #include "esl_randomseq.h"
 
 /* 
- * compare to GForward() scores.
+ * compare to GForward() scores, with the model configured in
+ * alignment <mode>.
  */
 static void
-utest_fwdback(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_BG *bg, int M, int L, int N)
+utest_fwdback(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_BG *bg, int M, int L, int N, int mode)
 {
   char        *msg = "forward/backward unit test failed";
   P7_HMM      *hmm = NULL;
@@ -913,15 +987,19 @@ utest_fwdback(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_BG *bg, int M, int L, int
   else tolerance = 0.0001;   /* stronger test: FLogsum() is in slow exact mode. */
 
   p7_oprofile_Sample(r, abc, bg, M, L, &hmm, &gm, &om);
+  if (mode != p7_LOCAL) {
+    p7_ProfileConfig(hmm, bg, gm, L, mode);
+    p7_oprofile_Convert(gm, om);
+  }
   while (N--)
     {
       esl_rsq_xfIID(r, bg->f, abc->K, L, dsq);
 
-      p7_Forward       (dsq, L, om, oxf,      &fsc1);
-      p7_Backward      (dsq, L, om, oxf, oxb, &bsc1);
-      p7_ForwardParser (dsq, L, om, fwd,      &fsc2);
-      p7_BackwardParser(dsq, L, om, fwd, bck, &bsc2);
-      p7_GForward      (dsq, L, gm, gx,  &generic_sc);
+      if (p7_Forward       (dsq, L, om, oxf,      &fsc1)       != eslOK) esl_fatal(msg);
+      if (p7_Backward      (dsq, L, om, oxf, oxb, &bsc1)       != eslOK) esl_fatal(msg);
+      if (p7_ForwardParser (dsq, L, om, fwd,      &fsc2)       != eslOK) esl_fatal(msg);
+      if (p7_BackwardParser(dsq, L, om, fwd, bck, &bsc2)       != eslOK) esl_fatal(msg);
+      if (p7_GForward      (dsq, L, gm, gx,       &generic_sc) != eslOK) esl_fatal(msg);
 
       /* Forward and Backward scores should agree with high tolerance */
       if (fabs(fsc1-bsc1) > 0.0001)    esl_fatal(msg);
@@ -944,6 +1022,43 @@ utest_fwdback(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_BG *bg, int M, int L, int
   p7_profile_Destroy(gm);
   p7_oprofile_Destroy(om);
 }
+
+/* utest_local_scale()
+ * A local Forward only rescales rows down, when xE gets large:
+ * every row's scale factor is either 1.0 or > 1e4. (Only glocal
+ * rows are rescaled up as they sink toward underflow.)
+ */
+static void
+utest_local_scale(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_BG *bg, int M, int L, int N)
+{
+  char        *msg = "forward/backward local scaling unit test failed";
+  P7_HMM      *hmm = NULL;
+  P7_PROFILE  *gm  = NULL;
+  P7_OPROFILE *om  = NULL;
+  ESL_DSQ     *dsq = malloc(sizeof(ESL_DSQ) * (L+2));
+  P7_OMX      *oxf = p7_omx_Create(M, L, L);
+  float        fsc, scale;
+  int          i;
+
+  if (p7_oprofile_Sample(r, abc, bg, M, L, &hmm, &gm, &om) != eslOK) esl_fatal(msg);
+  while (N--)
+    {
+      esl_rsq_xfIID(r, bg->f, abc->K, L, dsq);
+      if (p7_Forward(dsq, L, om, oxf, &fsc) != eslOK) esl_fatal(msg);
+
+      for (i = 1; i <= L; i++)
+	{
+	  scale = oxf->xmx[i*p7X_NXCELLS+p7X_SCALE];
+	  if (scale != 1.0 && scale <= 1.0e4) esl_fatal("%s: row %d scaled by %g", msg, i, scale);
+	}
+    }
+
+  free(dsq);
+  p7_hmm_Destroy(hmm);
+  p7_omx_Destroy(oxf);
+  p7_profile_Destroy(gm);
+  p7_oprofile_Destroy(om);
+}
 #endif /*p7FWDBACK_TESTDRIVE*/
 /*---------------------- end, unit tests ------------------------*/
 
@@ -995,9 +1110,14 @@ main(int argc, char **argv)
   if ((abc = esl_alphabet_Create(eslDNA)) == NULL)  esl_fatal("failed to create alphabet");
   if ((bg = p7_bg_Create(abc))            == NULL)  esl_fatal("failed to create null model");
 
-  utest_fwdback(r, abc, bg, M, L, N);   /* normal sized models */
-  utest_fwdback(r, abc, bg, 1, L, 10);  /* size 1 models       */
-  utest_fwdback(r, abc, bg, M, 1, 10);  /* size 1 sequences    */
+  utest_fwdback(r, abc, bg, M, L, N,  p7_LOCAL);      /* normal sized models */
+  utest_fwdback(r, abc, bg, 1, L, 10, p7_LOCAL);      /* size 1 models       */
+  utest_fwdback(r, abc, bg, M, 1, 10, p7_LOCAL);      /* size 1 sequences    */
+  utest_fwdback(r, abc, bg, M, L, N,  p7_GLOCAL);     /* glocal multihit     */
+  utest_fwdback(r, abc, bg, M, L, N,  p7_UNIGLOCAL);  /* glocal unihit       */
+  utest_fwdback(r, abc, bg, M, 20*L, 2, p7_GLOCAL);   /* long glocal targets, vs. generic Forward */
+  utest_fwdback(r, abc, bg, 1, L, 10, p7_GLOCAL);
+  utest_local_scale(r, abc, bg, 200, 400, 10);
 
   esl_alphabet_Destroy(abc);
   p7_bg_Destroy(bg);
@@ -1006,9 +1126,14 @@ main(int argc, char **argv)
   if ((abc = esl_alphabet_Create(eslAMINO)) == NULL)  esl_fatal("failed to create alphabet");
   if ((bg = p7_bg_Create(abc))              == NULL)  esl_fatal("failed to create null model");
 
-  utest_fwdback(r, abc, bg, M, L, N);   
-  utest_fwdback(r, abc, bg, 1, L, 10);  
-  utest_fwdback(r, abc, bg, M, 1, 10);  
+  utest_fwdback(r, abc, bg, M, L, N,  p7_LOCAL);   
+  utest_fwdback(r, abc, bg, 1, L, 10, p7_LOCAL);  
+  utest_fwdback(r, abc, bg, M, 1, 10, p7_LOCAL);  
+  utest_fwdback(r, abc, bg, M, L, N,  p7_GLOCAL);
+  utest_fwdback(r, abc, bg, M, L, N,  p7_UNIGLOCAL);
+  utest_fwdback(r, abc, bg, M, 20*L, 2, p7_GLOCAL);
+  utest_fwdback(r, abc, bg, 1, L, 10, p7_GLOCAL);
+  utest_local_scale(r, abc, bg, 200, 400, 10);
 
   esl_alphabet_Destroy(abc);
   p7_bg_Destroy(bg);
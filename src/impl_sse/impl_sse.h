@@ -133,7 +133,7 @@ typedef struct p7_oprofile_s {
   int    allocQ4;    /* p7_NQF(allocM): alloc size for tf, rf             */
   int    allocQ8;    /* p7_NQW(allocM): alloc size for tw, rw             */
   int    allocQ16;    /* p7_NQB(allocM): alloc size for rb                 */
-  int    mode;      /* currently must be p7_LOCAL                        */
+  int    mode;      /* filters need p7_LOCAL; Fwd/Bck take any mode     */
   float  nj;      /* expected # of J's: 0 or 1, uni vs. multihit       */
 
   int    clone;                 /* this optimized profile structure is just a copy   */
@@ -338,11 +338,14 @@ extern int p7_OATrace        (const P7_OPROFILE *om, const P7_OMX *pp, const P7_
 
 /* stotrace.c */
 extern int p7_StochasticTrace(ESL_RANDOMNESS *rng, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *ox, P7_TRACE *tr);
+extern int p7_StochasticTraceCached(ESL_RANDOMNESS *rng, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *ox, P7_STOCACHE *stc, P7_TRACE *tr);
 
 /* vitfilter.c */
 extern int p7_ViterbiFilter(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *ret_sc);
 extern int p7_ViterbiFilter_longtarget(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox,
                                         float filtersc, double P, P7_HMM_WINDOWLIST *windowlist);
+extern int p7_ViterbiFilter_longtarget_windows(const ESL_DSQ *dsq, const P7_OPROFILE *om, P7_OMX *ox,
+                                               const P7_HMM_WINDOWLIST *batch, double P, P7_HMM_WINDOWLIST *windowlist);
 
 
 /* vitscore.c */
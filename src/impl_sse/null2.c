@@ -141,13 +141,33 @@ p7_Null2_ByTrace(const P7_OPROFILE *om, const P7_TRACE *tr, int zstart, int zend
   int    q, r;
   int    x;
   int    z;
+  int    kmin, kmax;
+  int    qlo[2], qhi[2];	/* the quads the segment can touch: one or two ranges of q, in order */
+  int    nq, g;
+
+  /* Usage is only counted in M cells, and only for the k's in the
+   * segment; all other cells stay zero, and adding zero to a sum
+   * leaves it bit-for-bit the same, so those cells are skipped below.
+   * k..k' covers q's in one striped range, or two if it wraps around.
+   */
+  kmin = om->M+1;
+  kmax = 0;
+  for (z = zstart; z <= zend; z++)
+    if (tr->i[z] > 0 && tr->k[z] > 0) { kmin = ESL_MIN(kmin, tr->k[z]); kmax = ESL_MAX(kmax, tr->k[z]); }
+
+  if      (kmax == 0)          nq = 0;
+  else if (kmax-kmin+1 >= Q) { nq = 1; qlo[0] = 0; qhi[0] = Q-1; }
+  else {
+    qlo[0] = (kmin-1) % Q;
+    qhi[0] = (kmax-1) % Q;
+    if (qlo[0] <= qhi[0]) nq = 1;
+    else { nq = 2; qlo[1] = qlo[0]; qhi[1] = Q-1; qlo[0] = 0; }
+  }
 
   /* We'll use the i=0 row in wrk for working space: dp[0][] and xmx[][0]. */
-  for (q = 0; q < Q; q++)
-    {
+  for (g = 0; g < nq; g++)
+    for (q = qlo[g]; q <= qhi[g]; q++)
       wrk->dpf[0][q*3 + p7X_M] = _mm_setzero_ps();
-      wrk->dpf[0][q*3 + p7X_I] = _mm_setzero_ps();
-    }
   XMXo(0,p7X_N) =  0.0;
   XMXo(0,p7X_C) =  0.0;
   XMXo(0,p7X_J) =  0.0;
@@ -178,28 +198,29 @@ p7_Null2_ByTrace(const P7_OPROFILE *om, const P7_TRACE *tr, int zstart, int zend
     }
   norm = 1.0 / (float) Ld;
   sv = _mm_set1_ps(norm);
-  for (q = 0; q < Q; q++)
-    {
+  for (g = 0; g < nq; g++)
+    for (q = qlo[g]; q <= qhi[g]; q++)
       wrk->dpf[0][q*3 + p7X_M] = _mm_mul_ps(wrk->dpf[0][q*3 + p7X_M], sv);
-      wrk->dpf[0][q*3 + p7X_I] = _mm_mul_ps(wrk->dpf[0][q*3 + p7X_I], sv);
-    }
   XMXo(0,p7X_N) *= norm;
   XMXo(0,p7X_C) *= norm;
   XMXo(0,p7X_J) *= norm;
 
   /* Calculate null2's emission odds, by taking posterior weighted sum
    * over all emission vectors used in paths explaining the domain.
+   * (Insert usage is counted in the M cells above, so the I cells, with
+   * their implicit 1.0 odds, would only ever add zero.)
    */
   xfactor =  XMXo(0,p7X_N) + XMXo(0,p7X_C) + XMXo(0,p7X_J);
   for (x = 0; x < om->abc->K; x++)
     {
       sv = _mm_setzero_ps();
-      rp = om->rfv[x];
-      for (q = 0; q < Q; q++)
+      for (g = 0; g < nq; g++)
 	{
-	  sv = _mm_add_ps(sv, _mm_mul_ps(wrk->dpf[0][q*3 + p7X_M], *rp)); rp++;
-	  sv = _mm_add_ps(sv,            wrk->dpf[0][q*3 + p7X_I]); /* insert emission odds implicitly 1.0 */
-	  //	  sv = _mm_add_ps(sv, _mm_mul_ps(wrk->dpf[0][q*3 + p7X_I], *rp)); rp++;
+	  rp = om->rfv[x] + qlo[g];
+	  for (q = qlo[g]; q <= qhi[g]; q++)
+	    {
+	      sv = _mm_add_ps(sv, _mm_mul_ps(wrk->dpf[0][q*3 + p7X_M], *rp)); rp++;
+	    }
 	}
       esl_sse_hsum_ps(sv, &(null2[x]));
       null2[x] += xfactor;
@@ -33,7 +33,7 @@ static inline int select_i(ESL_RANDOMNESS *rng, const P7_OPROFILE *om, const P7_
 static inline int select_n(int i);
 static inline int select_c(ESL_RANDOMNESS *rng, const P7_OPROFILE *om, const P7_OMX *ox, int i);
 static inline int select_j(ESL_RANDOMNESS *rng, const P7_OPROFILE *om, const P7_OMX *ox, int i);
-static inline int select_e(ESL_RANDOMNESS *rng, const P7_OPROFILE *om, const P7_OMX *ox, int i, int *ret_k);
+static inline int select_e(ESL_RANDOMNESS *rng, const P7_OPROFILE *om, const P7_OMX *ox, int i, P7_STOCACHE *stc, int *ret_k);
 static inline int select_b(ESL_RANDOMNESS *rng, const P7_OPROFILE *om, const P7_OMX *ox, int i);
 
 
@@ -70,6 +70,37 @@ static inline int select_b(ESL_RANDOMNESS *rng, const P7_OPROFILE *om, const P7_
 int
 p7_StochasticTrace(ESL_RANDOMNESS *rng, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *ox,
 		   P7_TRACE *tr)
+{
+  return p7_StochasticTraceCached(rng, dsq, L, om, ox, NULL, tr);
+}
+
+/* Function:  p7_StochasticTraceCached()
+ * Synopsis:  Sample one of many tracebacks from a Forward matrix.
+ *
+ * Purpose:   Same as <p7_StochasticTrace()>, but for drawing many
+ *            traces from the same Forward matrix <ox>: selection
+ *            tables are kept in <stc> and shared by all the traces
+ *            sampled with it. A row's table is built the second time
+ *            that row is sampled, so rows visited only once cost no
+ *            more than before.
+ *
+ *            The sampled trace is identical to the one
+ *            <p7_StochasticTrace()> would sample with the same state
+ *            of <rng>: the same random numbers are consumed, and the
+ *            same choices are made from them.
+ *
+ *            <stc> must have been created or <p7_stocache_Reuse()>'d
+ *            since <ox> was last computed. If <stc> is <NULL>, this is
+ *            just <p7_StochasticTrace()>.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation error.
+ *            <eslEINVAL> as for <p7_StochasticTrace()>.
+ */
+int
+p7_StochasticTraceCached(ESL_RANDOMNESS *rng, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *ox,
+			 P7_STOCACHE *stc, P7_TRACE *tr)
 {
   int   i;			/* position in sequence 1..L */
   int   k;			/* position in model 1..M */
@@ -77,6 +108,7 @@ p7_StochasticTrace(ESL_RANDOMNESS *rng, const ESL_DSQ *dsq, int L, const P7_OPRO
   int   status;			
   
   if (tr->N != 0) ESL_EXCEPTION(eslEINVAL, "trace not empty; needs to be Reuse()'d?");
+  if (stc != NULL && (status = p7_stocache_GrowTo(stc, L)) != eslOK) return status;
 
   i = L;			
   k = 0;
@@ -92,7 +124,7 @@ p7_StochasticTrace(ESL_RANDOMNESS *rng, const ESL_DSQ *dsq, int L, const P7_OPRO
       case p7T_N: s1 = select_n(i);                            break;
       case p7T_C: s1 = select_c(rng, om, ox, i);               break;
       case p7T_J: s1 = select_j(rng, om, ox, i);               break;
-      case p7T_E: s1 = select_e(rng, om, ox, i, &k);           break;
+      case p7T_E: s1 = select_e(rng, om, ox, i, stc, &k);      break;
       case p7T_B: s1 = select_b(rng, om, ox, i);               break;
       default: ESL_EXCEPTION(eslEINVAL, "bogus state in traceback");
       }
@@ -247,11 +279,10 @@ select_j(ESL_RANDOMNESS *rng, const P7_OPROFILE *om, const P7_OMX *ox, int i)
  * Note that that means double-precision calculation, to be sure 0.0 <= roll < 1.0
  */
 static inline int
-select_e(ESL_RANDOMNESS *rng, const P7_OPROFILE *om, const P7_OMX *ox, int i, int *ret_k)
+select_e_scan(const P7_OMX *ox, int i, double roll, int *ret_k)
 {
-  int    Q     = p7O_NQF(ox->M);
   double sum   = 0.0;
-  double roll  = esl_random(rng);
+  int    Q     = p7O_NQF(ox->M);
   double norm  = 1.0 / ox->xmx[i*p7X_NXCELLS+p7X_E];
   __m128 xEv   = _mm_set1_ps(norm); /* all M, D already scaled exactly the same */
   union { __m128 v; float p[4]; } u;
@@ -278,6 +309,77 @@ select_e(ESL_RANDOMNESS *rng, const P7_OPROFILE *om, const P7_OMX *ox, int i, in
   ESL_EXCEPTION(-1, "unreached code was reached. universe collapses.");
 } 
 
+/* The cached version of the same thing: ecum[] holds the running
+ * <sum> of the scan after each cell, in scan order (8 cells per q:
+ * 4 M then 4 D), so the cell the scan would stop at is the first
+ * one with roll < ecum[j].
+ */
+static int
+select_e_table(const P7_OMX *ox, int i, P7_STOCACHE *stc)
+{
+  int    Q     = p7O_NQF(ox->M);
+  double norm  = 1.0 / ox->xmx[i*p7X_NXCELLS+p7X_E];
+  __m128 xEv   = _mm_set1_ps(norm);
+  union { __m128 v; float p[4]; } u;
+  double sum   = 0.0;
+  double *ecum;
+  int    q,r,j;
+  int    status;
+
+  if (stc->ncells == 0) stc->ncells = 8*Q;
+  ESL_ALLOC(ecum, sizeof(double) * stc->ncells);
+
+  for (j = 0, q = 0; q < Q; q++)
+    {
+      u.v = _mm_mul_ps(ox->dpf[i][q*3 + p7X_M], xEv);
+      for (r = 0; r < 4; r++) { sum += u.p[r]; ecum[j++] = sum; }
+
+      u.v = _mm_mul_ps(ox->dpf[i][q*3 + p7X_D], xEv);
+      for (r = 0; r < 4; r++) { sum += u.p[r]; ecum[j++] = sum; }
+    }
+  stc->ecum[i] = ecum;
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+
+/* select_e_roll() does the work of select_e() for a given <roll>, so
+ * the unit tests can feed it boundary values. A roll that the cached
+ * total falls short of (roundoff) gets a full scan, so it is treated
+ * exactly as the uncached path would treat it.
+ */
+static int
+select_e_roll(const P7_OMX *ox, int i, double roll, P7_STOCACHE *stc, int *ret_k)
+{
+  int     Q    = p7O_NQF(ox->M);
+  double *ecum;
+  int     lo, hi, mid;
+
+  if (stc == NULL) return select_e_scan(ox, i, roll, ret_k);
+  if (stc->ecum[i] == NULL && (++stc->nsel[i] < 2 || select_e_table(ox, i, stc) != eslOK))
+    return select_e_scan(ox, i, roll, ret_k);
+
+  ecum = stc->ecum[i];
+  if (roll >= ecum[stc->ncells-1]) return select_e_scan(ox, i, roll, ret_k);
+
+  lo = 0;
+  hi = stc->ncells-1;
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (roll < ecum[mid]) hi = mid;
+    else                  lo = mid+1;
+  }
+  *ret_k = (lo%4)*Q + lo/8 + 1;
+  return ((lo%8) < 4) ? p7T_M : p7T_D;
+}
+
+static inline int
+select_e(ESL_RANDOMNESS *rng, const P7_OPROFILE *om, const P7_OMX *ox, int i, P7_STOCACHE *stc, int *ret_k)
+{
+  return select_e_roll(ox, i, esl_random(rng), stc, ret_k);
+}
+
 /* B(i) is reached from N(i) or J(i). */
 static inline int
 select_b(ESL_RANDOMNESS *rng, const P7_OPROFILE *om, const P7_OMX *ox, int i)
@@ -450,6 +552,82 @@ utest_stotrace(ESL_GETOPTS *go, ESL_RANDOMNESS *rng, ESL_ALPHABET *abc, P7_PROFI
   p7_omx_Destroy(ox);
   p7_gmx_Destroy(gx);
 }
+
+/* utest_cached()
+ * Traces sampled with a P7_STOCACHE must be identical to the ones 
+ * sampled without it, starting from the same RNG state.
+ */
+static void
+utest_cached(ESL_GETOPTS *go, ESL_RANDOMNESS *rng, P7_OPROFILE *om, ESL_DSQ *dsq, int L, int ntrace)
+{
+  int             seed = 1 + esl_rnd_Roll(rng, 100000);
+  ESL_RANDOMNESS *r1   = esl_randomness_CreateFast(seed);
+  ESL_RANDOMNESS *r2   = esl_randomness_CreateFast(seed);
+  P7_OMX         *ox   = NULL;
+  P7_TRACE       *tr1  = NULL;
+  P7_TRACE       *tr2  = NULL;
+  P7_STOCACHE    *stc  = NULL;
+  int             idx;
+
+  if ((ox  = p7_omx_Create(om->M, L, L))        == NULL)  esl_fatal("optimized DP matrix create failed");
+  if ((tr1 = p7_trace_Create())                 == NULL)  esl_fatal("trace creation failed");
+  if ((tr2 = p7_trace_Create())                 == NULL)  esl_fatal("trace creation failed");
+  if ((stc = p7_stocache_Create(L))             == NULL)  esl_fatal("stocache creation failed");
+  if (p7_Forward (dsq, L, om, ox, NULL)         != eslOK) esl_fatal("forward failed");
+
+  for (idx = 0; idx < ntrace; idx++)
+    {
+      if (p7_StochasticTrace      (r1, dsq, L, om, ox,      tr1) != eslOK) esl_fatal("stochastic trace failed");
+      if (p7_StochasticTraceCached(r2, dsq, L, om, ox, stc, tr2) != eslOK) esl_fatal("cached stochastic trace failed");
+      if (p7_trace_Compare(tr1, tr2, 0.0)                         != eslOK) esl_fatal("cached trace %d differs", idx);
+      p7_trace_Reuse(tr1);
+      p7_trace_Reuse(tr2);
+    }
+
+  p7_stocache_Destroy(stc);
+  p7_trace_Destroy(tr1);
+  p7_trace_Destroy(tr2);
+  p7_omx_Destroy(ox);
+  esl_randomness_Destroy(r1);
+  esl_randomness_Destroy(r2);
+}
+
+/* utest_ecum_boundary()
+ * Rolls at or above the top of a cached E(i) table (which roundoff
+ * can produce) must select the same cell as the uncached scan.
+ */
+static void
+utest_ecum_boundary(P7_OPROFILE *om, ESL_DSQ *dsq, int L)
+{
+  P7_OMX      *ox  = NULL;
+  P7_STOCACHE *stc = NULL;
+  double       roll[3];
+  int          i, j;
+  int          st1, st2, k1, k2;
+
+  if ((ox  = p7_omx_Create(om->M, L, L))        == NULL)  esl_fatal("optimized DP matrix create failed");
+  if ((stc = p7_stocache_Create(L))             == NULL)  esl_fatal("stocache creation failed");
+  if (p7_Forward (dsq, L, om, ox, NULL)         != eslOK) esl_fatal("forward failed");
+
+  for (i = 1; i <= L; i++)
+    {
+      if (ox->xmx[i*p7X_NXCELLS+p7X_E] == 0.0) continue;
+      if (select_e_table(ox, i, stc)    != eslOK) esl_fatal("select_e_table failed");
+
+      roll[0] = stc->ecum[i][stc->ncells-1];
+      roll[1] = nextafter(roll[0], 2.0);
+      roll[2] = nextafter(1.0, 0.0);
+      for (j = 0; j < 3; j++)
+	{
+	  st1 = select_e_roll(ox, i, roll[j], NULL, &k1);
+	  st2 = select_e_roll(ox, i, roll[j], stc,  &k2);
+	  if (st1 != st2 || k1 != k2) esl_fatal("cached E selection differs at row %d, roll %.17g", i, roll[j]);
+	}
+    }
+
+  p7_stocache_Destroy(stc);
+  p7_omx_Destroy(ox);
+}
 #endif /*p7STOTRACE_TESTDRIVE*/
 /*----------------- end, unit tests -----------------------------*/
 
@@ -512,6 +690,8 @@ main(int argc, char **argv)
   if ((sq = esl_sq_CreateDigital(abc))             == NULL) esl_fatal("sequence allocation failed");
   if (p7_ProfileEmit(r, hmm, gm, bg, sq, NULL)    != eslOK) esl_fatal("profile emission failed");
   utest_stotrace(go, r, abc, gm, om, sq->dsq, sq->n, ntrace);
+  utest_cached  (go, r, om, sq->dsq, sq->n, ntrace);
+  utest_ecum_boundary(om, sq->dsq, sq->n);
    
   esl_sq_Destroy(sq);
   free(dsq);
@@ -250,47 +250,18 @@ p7_ViterbiFilter(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, f
 
 
 
-/* Function:  p7_ViterbiFilter_longtarget()
- * Synopsis:  Finds windows within potentially long sequence blocks with Viterbi
- *            scores above threshold (vewy vewy fast, in limited precision)
- *
- * Purpose:   Calculates an approximation of the Viterbi score for regions
- *            of sequence <dsq>, using optimized profile <om>, and a pre-
- *            allocated one-row DP matrix <ox>, and captures the positions
- *            at which such regions exceed the score required to be
- *            significant in the eyes of the calling function (usually
- *            p=0.001).
- *
- *            The resulting landmarks are converted to subsequence
- *            windows by the calling function
- *
- *            The model must be in a local alignment mode; other modes
- *            cannot provide the necessary guarantee of no underflow.
- *
- *            This is a striped SIMD Viterbi implementation using Intel
- *            SSE/SSE2 integer intrinsics \citep{Farrar07}, in reduced
- *            precision (signed words, 16 bits).
- *
- * Args:      dsq     - digital target sequence, 1..L
- *            L       - length of dsq in residues
- *            om      - optimized profile
- *            ox      - DP matrix
- *            filtersc   - null or bias correction, required for translating a P-value threshold into a score threshold
- *            P          - p-value below which a region is captured as being above threshold
- *            windowlist - RETURN: preallocated array of hit windows (start and end of diagonal) for the above-threshold areas
- *
- * Returns:   <eslOK> on success;
- *
- * Throws:    <eslEINVAL> if <ox> allocation is too small, or if
- *            profile isn't in a local alignment mode. (Must be in local
- *            alignment mode because that's what helps us guarantee
- *            limited dynamic range.)
- *
- * Xref:      See p7_ViterbiFilter()
+/* vf_longtarget_scan()
+ * The engine of p7_ViterbiFilter_longtarget() and
+ * p7_ViterbiFilter_longtarget_windows(): scan <dsq> 1..<L>, adding a
+ * window (with id <id>) to <windowlist> wherever the score reaching
+ * E meets <sc_thresh>. <xw_move> is the N/C/J->move score of the
+ * length model for this <dsq>, which the caller may choose in place
+ * of <om>'s, so <om> need not be reconfigured for each target.
+ * The caller has checked <ox> and <om>.
  */
-int
-p7_ViterbiFilter_longtarget(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox,
-                            float filtersc, double P, P7_HMM_WINDOWLIST *windowlist)
+static int
+vf_longtarget_scan(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox,
+                   int16_t xw_move, int16_t sc_thresh, int id, P7_HMM_WINDOWLIST *windowlist)
 {
   register __m128i mpv, dpv, ipv;  /* previous row values                                       */
   register __m128i sv;       /* temp storage of 1 curr row value in progress              */
@@ -309,36 +280,8 @@ p7_ViterbiFilter_longtarget(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7
 
   __m128i negInfv;
 
-  int16_t sc_thresh;
-  float invP;
-
   int z;
   union { __m128i v; int16_t i[8]; } tmp;
-  windowlist->count = 0;
-
-/*
- *  In p7_ViterbiFilter, converting from a scaled int Viterbi score
- *  S (aka xE the score getting to state E) to a probability
- *  goes like this:
- *    vsc =  S + om->xw[p7O_E][p7O_MOVE] + om->xw[p7O_C][p7O_MOVE] - om->base_w
- *    ret_sc /= om->scale_w;
- *    vsc -= 3.0;
- *    P  = esl_gumbel_surv((vfsc - filtersc) / eslCONST_LOG2  ,  om->evparam[p7_VMU],  om->evparam[p7_VLAMBDA]);
- *  and we're computing the threshold vsc, so invert it:
- *    (vsc - filtersc) /  eslCONST_LOG2 = esl_gumbel_invsurv( P, om->evparam[p7_VMU],  om->evparam[p7_VLAMBDA])
- *    vsc = filtersc + eslCONST_LOG2 * esl_gumbel_invsurv( P, om->evparam[p7_VMU],  om->evparam[p7_VLAMBDA])
- *    vsc += 3.0
- *    vsc *= om->scale_w
- *    S = vsc - (float)om->xw[p7O_E][p7O_MOVE] - (float)om->xw[p7O_C][p7O_MOVE] + (float)om->base_w
- */
-  invP = esl_gumbel_invsurv(P, om->evparam[p7_VMU],  om->evparam[p7_VLAMBDA]);
-  sc_thresh =   (int) ceil ( ( (filtersc + (eslCONST_LOG2 * invP) + 3.0) * om->scale_w )
-                - (float)om->xw[p7O_E][p7O_MOVE] - (float)om->xw[p7O_C][p7O_MOVE] + (float)om->base_w );
-
-  /* Check that the DP matrix is ok for us. */
-  if (Q > ox->allocQ8)                                 ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small");
-  if (om->mode != p7_LOCAL && om->mode != p7_UNILOCAL) ESL_EXCEPTION(eslEINVAL, "Fast filter only works for local alignment");
-  ox->M   = om->M;
 
   /* -infinity is -32768 */
   negInfv = _mm_set1_epi16(-32768);
@@ -349,7 +292,7 @@ p7_ViterbiFilter_longtarget(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7
   for (q = 0; q < Q; q++)
     MMXo(q) = IMXo(q) = DMXo(q) = _mm_set1_epi16(-32768);
   xN   = om->base_w;
-  xB   = xN + om->xw[p7O_N][p7O_MOVE];
+  xB   = xN + xw_move;
   xJ   = -32768;
   xC   = -32768;
   xE   = -32768;
@@ -358,7 +301,6 @@ p7_ViterbiFilter_longtarget(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7
   if (ox->debugging) p7_omx_DumpVFRow(ox, 0, xE, 0, xJ, xB, xC); /* first 0 is <rowi>: do header. second 0 is xN: always 0 here. */
 #endif
 
-
   for (i = 1; i <= L; i++)
   {
       rsc   = om->rwv[dsq[i]];
@@ -420,7 +362,7 @@ p7_ViterbiFilter_longtarget(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7
           for (z = 0; z < 8; z++)  { // unstripe
             if ( tmp.i[z] == xE && (q+Q*z+1) <= om->M) {
               // (q+Q*z+1) is the model position k at which the xE score is found
-              p7_hmmwindow_new(windowlist, 0, i, i-1, (q+Q*z+1), 1, 0.0, p7_NOCOMPLEMENT, L );
+              p7_hmmwindow_new(windowlist, id, i, i-1, (q+Q*z+1), 1, 0.0, p7_NOCOMPLEMENT, L );
             }
           }
           MMXo(q) = IMXo(q) = DMXo(q) = _mm_set1_epi16(-32768); //reset score to start search for next vit window.
@@ -428,11 +370,10 @@ p7_ViterbiFilter_longtarget(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7
 
       } else {
 
-
         xN = xN + om->xw[p7O_N][p7O_LOOP];
         xC = ESL_MAX(xC + om->xw[p7O_C][p7O_LOOP], xE + om->xw[p7O_E][p7O_MOVE]);
         xJ = ESL_MAX(xJ + om->xw[p7O_J][p7O_LOOP], xE + om->xw[p7O_E][p7O_LOOP]);
-        xB = ESL_MAX(xJ + om->xw[p7O_J][p7O_MOVE], xN + om->xw[p7O_N][p7O_MOVE]);
+        xB = ESL_MAX(xJ + xw_move, xN + xw_move);
         /* and now xB will carry over into next i, and xC carries over after i=L */
 
         /* Finally the "lazy F" loop (sensu [Farrar07]). We can often
@@ -490,9 +431,158 @@ p7_ViterbiFilter_longtarget(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7
 #endif
   } /* end loop over sequence residues 1..L */
 
-
   return eslOK;
+}
 
+
+/* Function:  p7_ViterbiFilter_longtarget()
+ * Synopsis:  Finds windows within potentially long sequence blocks with Viterbi
+ *            scores above threshold (vewy vewy fast, in limited precision)
+ *
+ * Purpose:   Calculates an approximation of the Viterbi score for regions
+ *            of sequence <dsq>, using optimized profile <om>, and a pre-
+ *            allocated one-row DP matrix <ox>, and captures the positions
+ *            at which such regions exceed the score required to be
+ *            significant in the eyes of the calling function (usually
+ *            p=0.001).
+ *
+ *            The resulting landmarks are converted to subsequence
+ *            windows by the calling function
+ *
+ *            The model must be in a local alignment mode; other modes
+ *            cannot provide the necessary guarantee of no underflow.
+ *
+ *            This is a striped SIMD Viterbi implementation using Intel
+ *            SSE/SSE2 integer intrinsics \citep{Farrar07}, in reduced
+ *            precision (signed words, 16 bits).
+ *
+ * Args:      dsq     - digital target sequence, 1..L
+ *            L       - length of dsq in residues
+ *            om      - optimized profile
+ *            ox      - DP matrix
+ *            filtersc   - null or bias correction, required for translating a P-value threshold into a score threshold
+ *            P          - p-value below which a region is captured as being above threshold
+ *            windowlist - RETURN: preallocated array of hit windows (start and end of diagonal) for the above-threshold areas
+ *
+ * Returns:   <eslOK> on success;
+ *
+ * Throws:    <eslEINVAL> if <ox> allocation is too small, or if
+ *            profile isn't in a local alignment mode. (Must be in local
+ *            alignment mode because that's what helps us guarantee
+ *            limited dynamic range.)
+ *
+ * Xref:      See p7_ViterbiFilter()
+ */
+int
+p7_ViterbiFilter_longtarget(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox,
+                            float filtersc, double P, P7_HMM_WINDOWLIST *windowlist)
+{
+  int     Q = p7O_NQW(om->M);
+  int16_t sc_thresh;
+  float   invP;
+
+  /* Check that the DP matrix is ok for us. */
+  if (Q > ox->allocQ8)                                 ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small");
+  if (om->mode != p7_LOCAL && om->mode != p7_UNILOCAL) ESL_EXCEPTION(eslEINVAL, "Fast filter only works for local alignment");
+  ox->M   = om->M;
+  windowlist->count = 0;
+
+/*
+ *  In p7_ViterbiFilter, converting from a scaled int Viterbi score
+ *  S (aka xE the score getting to state E) to a probability
+ *  goes like this:
+ *    vsc =  S + om->xw[p7O_E][p7O_MOVE] + om->xw[p7O_C][p7O_MOVE] - om->base_w
+ *    ret_sc /= om->scale_w;
+ *    vsc -= 3.0;
+ *    P  = esl_gumbel_surv((vfsc - filtersc) / eslCONST_LOG2  ,  om->evparam[p7_VMU],  om->evparam[p7_VLAMBDA]);
+ *  and we're computing the threshold vsc, so invert it:
+ *    (vsc - filtersc) /  eslCONST_LOG2 = esl_gumbel_invsurv( P, om->evparam[p7_VMU],  om->evparam[p7_VLAMBDA])
+ *    vsc = filtersc + eslCONST_LOG2 * esl_gumbel_invsurv( P, om->evparam[p7_VMU],  om->evparam[p7_VLAMBDA])
+ *    vsc += 3.0
+ *    vsc *= om->scale_w
+ *    S = vsc - (float)om->xw[p7O_E][p7O_MOVE] - (float)om->xw[p7O_C][p7O_MOVE] + (float)om->base_w
+ */
+  invP = esl_gumbel_invsurv(P, om->evparam[p7_VMU],  om->evparam[p7_VLAMBDA]);
+  sc_thresh =   (int) ceil ( ( (filtersc + (eslCONST_LOG2 * invP) + 3.0) * om->scale_w )
+                - (float)om->xw[p7O_E][p7O_MOVE] - (float)om->xw[p7O_C][p7O_MOVE] + (float)om->base_w );
+
+  return vf_longtarget_scan(dsq, L, om, ox, om->xw[p7O_N][p7O_MOVE], sc_thresh, 0, windowlist);
+}
+
+
+/* Function:  p7_ViterbiFilter_longtarget_windows()
+ * Synopsis:  Runs the long target Viterbi filter on a batch of windows
+ *            of a target, in one pass.
+ *
+ * Purpose:   Does what a p7_ViterbiFilter_longtarget() call for each
+ *            window in <batch> would: for each window <w>, scans the
+ *            residues <dsq[w->n..w->n+w->length-1]> for regions with
+ *            Viterbi scores meeting P-value threshold <P>, and adds
+ *            their landmarks to <windowlist>, with <id> set to the
+ *            window's index in <batch> and positions relative to the
+ *            window's start. The windows in <windowlist> are grouped
+ *            by <id>, in order.
+ *
+ *            Each window <w> is scored as if <om>'s length model had
+ *            been set with <p7_oprofile_ReconfigRestLength(om,
+ *            ESL_MIN(w->length, om->max_length))>, with its threshold
+ *            translated from <P> using <w->null_sc> as the filter
+ *            score. Neither <om> nor <ox> is reconfigured between
+ *            windows, and the P-value threshold is converted to a
+ *            score once for the whole batch, so many short windows
+ *            cost about what one window of their total length would.
+ *
+ * Args:      dsq        - digital target sequence that the windows are in
+ *            om         - optimized profile
+ *            ox         - DP matrix
+ *            batch      - windows of <dsq> to scan, with their filter scores in <null_sc>
+ *            P          - p-value below which a region is captured as being above threshold
+ *            windowlist - RETURN: hit windows for the above-threshold areas of all of <batch>
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEINVAL> if <ox> allocation is too small, or if
+ *            profile isn't in a local alignment mode.
+ *
+ * Xref:      See p7_ViterbiFilter_longtarget()
+ */
+int
+p7_ViterbiFilter_longtarget_windows(const ESL_DSQ *dsq, const P7_OPROFILE *om, P7_OMX *ox,
+                                    const P7_HMM_WINDOWLIST *batch, double P, P7_HMM_WINDOWLIST *windowlist)
+{
+  const P7_HMM_WINDOW *win;
+  int     Q = p7O_NQW(om->M);
+  int16_t sc_thresh;
+  int16_t xw_move;
+  float   invP;
+  float   pmove;
+  float   sc;
+  int     w;
+  int     status;
+
+  if (Q > ox->allocQ8)                                 ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small");
+  if (om->mode != p7_LOCAL && om->mode != p7_UNILOCAL) ESL_EXCEPTION(eslEINVAL, "Fast filter only works for local alignment");
+  ox->M   = om->M;
+  windowlist->count = 0;
+
+  invP = esl_gumbel_invsurv(P, om->evparam[p7_VMU],  om->evparam[p7_VLAMBDA]);
+
+  for (w = 0; w < batch->count; w++)
+    {
+      win = batch->windows + w;
+
+      /* N/C/J move score, as p7_oprofile_ReconfigRestLength() would set it */
+      pmove   = (2.0f + om->nj) / ((float) ESL_MIN(win->length, om->max_length) + 2.0f + om->nj);
+      sc      = roundf(om->scale_w * logf(pmove));
+      xw_move = (sc <= -32768.0 ? -32768 : (int16_t) sc);
+
+      /* threshold, as in p7_ViterbiFilter_longtarget() */
+      sc_thresh =   (int) ceil ( ( (win->null_sc + (eslCONST_LOG2 * invP) + 3.0) * om->scale_w )
+                    - (float)om->xw[p7O_E][p7O_MOVE] - (float)xw_move + (float)om->base_w );
+
+      if ((status = vf_longtarget_scan(dsq + win->n - 1, win->length, om, ox, xw_move, sc_thresh, w, windowlist)) != eslOK) return status;
+    }
+  return eslOK;
 }
 /*---------------- end, p7_ViterbiFilter_longtarget() ----------------------*/
 
@@ -692,6 +782,80 @@ utest_viterbi_filter(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_BG *bg, int M, int
   p7_profile_Destroy(gm);
   p7_oprofile_Destroy(om);
 }
+
+/* ViterbiFilter_longtarget_windows() unit test
+ *
+ * The batched long target filter must find exactly the windows that
+ * p7_ViterbiFilter_longtarget() finds in each window on its own, once
+ * <om>'s length model has been set for that window. Compare the two
+ * on <N> windows of random position and length in a random target of
+ * length <L>, with MAXL short enough that some windows are scored
+ * with a shorter length model, and with a permissive P-value threshold
+ * so there's something to compare.
+ */
+static void
+utest_viterbi_filter_longtarget(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_BG *bg, int M, int L, int N)
+{
+  P7_HMM            *hmm = NULL;
+  P7_PROFILE        *gm  = NULL;
+  P7_OPROFILE       *om  = NULL;
+  ESL_DSQ           *dsq = malloc(sizeof(ESL_DSQ) * (L+2));
+  P7_OMX            *ox  = p7_omx_Create(M, 0, 0);
+  P7_HMM_WINDOWLIST  batch;
+  P7_HMM_WINDOWLIST  hits;
+  P7_HMM_WINDOWLIST  one;
+  P7_HMM_WINDOW     *win;
+  double             P   = 0.5;
+  float              nullsc;
+  int                len, n;
+  int                w, h, j;
+
+  p7_oprofile_Sample(r, abc, bg, M, L, &hmm, &gm, &om);
+  om->max_length = ESL_MAX(1, L/2);
+  esl_rsq_xfIID(r, bg->f, abc->K, L, dsq);
+
+  p7_hmmwindow_init(&batch);
+  p7_hmmwindow_init(&hits);
+  p7_hmmwindow_init(&one);
+
+  for (w = 0; w < N; w++)
+    {
+      len = 1 + esl_rnd_Roll(r, L);
+      n   = 1 + esl_rnd_Roll(r, L - len + 1);
+      p7_bg_SetLength(bg, ESL_MIN(len, om->max_length));
+      p7_bg_NullOne  (bg, dsq + n - 1, ESL_MIN(len, om->max_length), &nullsc);
+      win = p7_hmmwindow_new(&batch, 0, n, 0, 0, len, 0.0, p7_NOCOMPLEMENT, L);
+      win->null_sc = nullsc;
+    }
+
+  if (p7_ViterbiFilter_longtarget_windows(dsq, om, ox, &batch, P, &hits) != eslOK)
+    esl_fatal("viterbi filter longtarget unit test failed: batched filter failed");
+
+  for (h = 0, w = 0; w < batch.count; w++)
+    {
+      win = batch.windows + w;
+      p7_oprofile_ReconfigRestLength(om, ESL_MIN(win->length, om->max_length));
+      p7_ViterbiFilter_longtarget(dsq + win->n - 1, win->length, om, ox, win->null_sc, P, &one);
+
+      for (j = 0; j < one.count; j++, h++)
+        {
+          if (h >= hits.count || hits.windows[h].id != w)
+            esl_fatal("viterbi filter longtarget unit test failed: window %d lost a hit", w);
+          if (hits.windows[h].n != one.windows[j].n || hits.windows[h].k != one.windows[j].k)
+            esl_fatal("viterbi filter longtarget unit test failed: window %d hits differ", w);
+        }
+    }
+  if (h != hits.count) esl_fatal("viterbi filter longtarget unit test failed: batched filter found extra hits");
+
+  free(batch.windows);
+  free(hits.windows);
+  free(one.windows);
+  free(dsq);
+  p7_hmm_Destroy(hmm);
+  p7_omx_Destroy(ox);
+  p7_profile_Destroy(gm);
+  p7_oprofile_Destroy(om);
+}
 #endif /*p7VITFILTER_TESTDRIVE*/
 
 
@@ -747,6 +911,10 @@ main(int argc, char **argv)
   utest_viterbi_filter(r, abc, bg, 1, L, 10);  
   utest_viterbi_filter(r, abc, bg, M, 1, 10);  
 
+  if (esl_opt_GetBoolean(go, "-v")) printf("ViterbiFilter_longtarget_windows() tests, DNA\n");
+  utest_viterbi_filter_longtarget(r, abc, bg, M, L, N);
+  utest_viterbi_filter_longtarget(r, abc, bg, M, 1, 10);
+
   esl_alphabet_Destroy(abc);
   p7_bg_Destroy(bg);
 
@@ -145,6 +145,9 @@ p7_Null2_ByTrace(const P7_OPROFILE *om, const P7_TRACE *tr, int zstart, int zend
   int    q, r;
   int    x;
   int    z;
+  int    kmin, kmax;
+  int    qlo[2], qhi[2];	/* the quads the segment can touch; see SSE version */
+  int    nq, g;
 
   vector float  sv;
   vector float *rp;
@@ -152,12 +155,24 @@ p7_Null2_ByTrace(const P7_OPROFILE *om, const P7_TRACE *tr, int zstart, int zend
 
   zerov = (vector float) vec_splat_u32(0);
 
+  kmin = om->M+1;
+  kmax = 0;
+  for (z = zstart; z <= zend; z++)
+    if (tr->i[z] > 0 && tr->k[z] > 0) { kmin = ESL_MIN(kmin, tr->k[z]); kmax = ESL_MAX(kmax, tr->k[z]); }
+
+  if      (kmax == 0)          nq = 0;
+  else if (kmax-kmin+1 >= Q) { nq = 1; qlo[0] = 0; qhi[0] = Q-1; }
+  else {
+    qlo[0] = (kmin-1) % Q;
+    qhi[0] = (kmax-1) % Q;
+    if (qlo[0] <= qhi[0]) nq = 1;
+    else { nq = 2; qlo[1] = qlo[0]; qhi[1] = Q-1; qlo[0] = 0; }
+  }
+
   /* We'll use the i=0 row in wrk for working space: dp[0][] and xmx[][0]. */
-  for (q = 0; q < Q; q++)
-    {
-      wrk->dpf[0][q*3 + p7X_M] = (vector float) vec_splat_u32(0);
-      wrk->dpf[0][q*3 + p7X_I] = (vector float) vec_splat_u32(0);
-    }
+  for (g = 0; g < nq; g++)
+    for (q = qlo[g]; q <= qhi[g]; q++)
+      wrk->dpf[0][q*3 + p7X_M] = zerov;
   XMXo(0,p7X_N) =  0.0;
   XMXo(0,p7X_C) =  0.0;
   XMXo(0,p7X_J) =  0.0;
@@ -187,28 +202,28 @@ p7_Null2_ByTrace(const P7_OPROFILE *om, const P7_TRACE *tr, int zstart, int zend
   norm = 1.0 / (float) Ld;
   sv   = esl_vmx_set_float(norm);
 
-  for (q = 0; q < Q; q++)
-    {
+  for (g = 0; g < nq; g++)
+    for (q = qlo[g]; q <= qhi[g]; q++)
       wrk->dpf[0][q*3 + p7X_M] = vec_madd(wrk->dpf[0][q*3 + p7X_M], sv, zerov);
-      wrk->dpf[0][q*3 + p7X_I] = vec_madd(wrk->dpf[0][q*3 + p7X_I], sv, zerov);
-    }
   XMXo(0,p7X_N) *= norm;
   XMXo(0,p7X_C) *= norm;
   XMXo(0,p7X_J) *= norm;
 
   /* Calculate null2's emission odds, by taking posterior weighted sum
    * over all emission vectors used in paths explaining the domain.
+   * (I cells are never counted, so they'd only add zero.)
    */
   xfactor =  XMXo(0,p7X_N) + XMXo(0,p7X_C) + XMXo(0,p7X_J);
   for (x = 0; x < om->abc->K; x++)
     {
       sv = (vector float) vec_splat_u32(0);
-      rp = om->rfv[x];
-      for (q = 0; q < Q; q++)
+      for (g = 0; g < nq; g++)
 	{
-	  sv = vec_madd(wrk->dpf[0][q*3 + p7X_M], *rp, sv); rp++;
-	  sv = vec_add(sv, wrk->dpf[0][q*3 + p7X_I]);       /* insert emission odds implicitly 1.0 */
-	  //	  sv = _mm_add_ps(sv, _mm_mul_ps(wrk->dpf[0][q*3 + p7X_I], *rp)); rp++;
+	  rp = om->rfv[x] + qlo[g];
+	  for (q = qlo[g]; q <= qhi[g]; q++)
+	    {
+	      sv = vec_madd(wrk->dpf[0][q*3 + p7X_M], *rp, sv); rp++;
+	    }
 	}
       null2[x] = esl_vmx_hsum_float(sv);
       null2[x] += xfactor;
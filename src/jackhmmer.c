@@ -41,6 +41,55 @@ typedef struct {
   P7_OPROFILE      *om;
 } WORKER_INFO;
 
+/* SEARCH_INFO: everything search_query() needs to run the iterations
+ * for one query. The serial master has one, shared by its pipeline
+ * threads; with --qpipe, each query worker has its own.
+ */
+typedef struct {
+  ESL_ALPHABET     *abc;
+  P7_BUILDER       *bld;        /* model construction; not thread safe, so one per query in flight */
+  ESL_SQFILE       *dbfp;       /* open target database; rewound for every iteration               */
+  ESL_KEYHASH      *kh;         /* hash of previous top hits' ranks                                */
+  ESL_STOPWATCH    *w;
+  WORKER_INFO      *info;       /* [0..infocnt-1] pipeline worker info                             */
+  int               infocnt;
+  P7_STAGESTATS     stagestats; /* per-stage totals over the queries searched (--stagestats)       */
+#ifdef HMMER_THREADS
+  int               ncpus;      /* 0 to search with serial_loop(); else # of pipeline threads      */
+  ESL_THREADS      *threadObj;
+  ESL_WORK_QUEUE   *queue;
+  P7_DOMAINPOOL    *ddpool;     /* helper threads for domain definition on big targets, or NULL     */
+#endif
+} SEARCH_INFO;
+
+#ifdef HMMER_THREADS
+/* --qpipe: query workers and the queries they are handed. 
+ * buf[] buffers a query's ofp, afp, tblfp, domtblfp output (or NULL
+ * if that output isn't on) until the master can write it in order.
+ */
+#define QPIPE_NBUF 4
+
+typedef struct {
+  ESL_WORK_QUEUE   *queue;
+  ESL_GETOPTS      *go;
+  WORKER_INFO       info;
+  SEARCH_INFO       sinfo;
+} QUERY_WORKER;
+
+typedef struct {
+  int               nquery;     /* 1..N: which query this is; 0 tells the worker to stop */
+  int               processed;
+  ESL_SQ           *qsq;
+  FILE             *buf[QPIPE_NBUF];
+} QUERY_ITEM;
+
+typedef struct _pending_query_s {
+  int               nquery;
+  FILE             *buf[QPIPE_NBUF];
+  struct _pending_query_s *next;
+} PENDING_QUERY;
+#endif /*HMMER_THREADS*/
+
 #define REPOPTS     "-E,-T,--cut_ga,--cut_nc,--cut_tc"
 #define DOMREPOPTS  "--domE,--domT,--cut_ga,--cut_nc,--cut_tc"
 #define INCOPTS     "--incE,--incT,--cut_ga,--cut_nc,--cut_tc"
@@ -132,6 +181,8 @@ static ESL_OPTIONS options[] = {
   { "--Eft",         eslARG_REAL,      "0.04", NULL,"0<x<1",    NULL,    NULL,  NULL,            "tail mass for Forward exponential tail tau fit",              11 },   
 /* Other options */
   { "--nonull2",    eslARG_NONE,         NULL, NULL, NULL,      NULL,    NULL,  NULL,            "turn off biased composition score corrections",               12 },
+  { "--nosample",   eslARG_NONE,         NULL, NULL, NULL,      NULL,    NULL,  NULL,            "split domains by posterior decoding, not sampling",           12 },
+  { "--stagestats", eslARG_NONE,         NULL, NULL, NULL,      NULL,    NULL,  NULL,            "time each pipeline stage, and count its DP cells",            12 },
   { "-Z",           eslARG_REAL,        FALSE, NULL, "x>0",     NULL,    NULL,  NULL,            "set # of comparisons done, for E-value calculation",          12 },
   { "--domZ",       eslARG_REAL,        FALSE, NULL, "x>0",     NULL,    NULL,  NULL,            "set # of significant seqs, for domain E-value calculation",   12 },
   { "--seed",       eslARG_INT,          "42", NULL, "n>=0",    NULL,    NULL,  NULL,            "set RNG seed to <n> (if 0: one-time arbitrary seed)",         12 },
@@ -140,6 +191,7 @@ static ESL_OPTIONS options[] = {
 
 #ifdef HMMER_THREADS
   { "--cpu",        eslARG_INT,      p7_NCPU,"HMMER_NCPU","n>=0", NULL,    NULL,  CPUOPTS,       "number of parallel CPU workers to use for multithreads",      12 },
+  { "--qpipe",      eslARG_NONE,       FALSE, NULL,  NULL,      NULL,    NULL,"--chkhmm,--chkali","search several queries at once, one per --cpu worker",       12 },
 #endif
 #ifdef HMMER_MPI
   { "--stall",      eslARG_NONE,       FALSE, NULL,  NULL,      NULL,  "--mpi", NULL,            "arrest after start: for debugging MPI under gdb",             12 },  
@@ -174,8 +226,18 @@ static int  serial_loop(WORKER_INFO *info, ESL_SQFILE *dbfp);
 
 static int  thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp);
 static void pipeline_thread(void *arg);
+
+static int  qpipe_loop(ESL_GETOPTS *go, struct cfg_s *cfg, ESL_ALPHABET *abc, P7_BG *bg, int dbformat, int ncpus,
+		       ESL_SQFILE *qfp, FILE *ofp, FILE *afp, FILE *tblfp, FILE *domtblfp, P7_STAGESTATS *stagestats);
+static void query_thread(void *arg);
+static FILE *open_query_buffer(void);
+static void  flush_query_buffer(FILE *buf, FILE *ofp);
 #endif 
 
+static P7_BUILDER *create_builder(ESL_GETOPTS *go, const ESL_ALPHABET *abc, P7_BG *bg);
+static ESL_SQFILE *open_dbfile(const ESL_ALPHABET *abc, char *dbfile, int dbformat);
+static int         search_query(ESL_GETOPTS *go, SEARCH_INFO *sinfo, ESL_SQ *qsq, int nquery, FILE *ofp, FILE *afp, FILE *tblfp, FILE *domtblfp);
+
 #ifdef HMMER_MPI
 static int  mpi_master   (ESL_GETOPTS *go, struct cfg_s *cfg);
 static int  mpi_worker   (ESL_GETOPTS *go, struct cfg_s *cfg);
@@ -344,6 +406,7 @@ output_header(FILE *ofp, ESL_GETOPTS *go, char *qfile, char *dbfile)
   if (esl_opt_IsUsed(go, "--EfN")        && fprintf(ofp, "# seq number, Fwd exp tau fit:     %d\n",             esl_opt_GetInteger(go, "--EfN"))      < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--Eft")        && fprintf(ofp, "# tail mass for Fwd exp tau fit:   %f\n",             esl_opt_GetReal   (go, "--Eft"))      < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--nonull2")    && fprintf(ofp, "# null2 bias corrections:          off\n")                                                  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--nosample")   && fprintf(ofp, "# multidomain envelopes:           posterior decoding\n")                                   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "-Z")           && fprintf(ofp, "# sequence search space set to:    %.0f\n",           esl_opt_GetReal(go, "-Z"))            < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--domZ")       && fprintf(ofp, "# domain search space set to:      %.0f\n",           esl_opt_GetReal(go, "--domZ"))        < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--seed"))
@@ -355,6 +418,7 @@ output_header(FILE *ofp, ESL_GETOPTS *go, char *qfile, char *dbfile)
   if (esl_opt_IsUsed(go, "--tformat")    && fprintf(ofp, "# target <seqdb> format asserted:  %s\n",             esl_opt_GetString(go, "--tformat"))   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 #ifdef HMMER_THREADS
   if (esl_opt_IsUsed(go, "--cpu")        && fprintf(ofp, "# number of worker threads:        %d\n",             esl_opt_GetInteger(go, "--cpu"))      < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--qpipe")      && fprintf(ofp, "# queries searched concurrently:   yes\n")                                                  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 #endif
 #ifdef HMMER_MPI
   if (esl_opt_IsUsed(go, "--mpi")        && fprintf(ofp, "# MPI:                             on\n")                                                   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
@@ -441,18 +505,14 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   ESL_SQ          *qsq      = NULL;               /* query sequence                                  */
   ESL_KEYHASH     *kh       = NULL;		  /* hash of previous top hits' ranks                */
   ESL_STOPWATCH   *w        = NULL;               /* for timing                                      */
+  SEARCH_INFO      sinfo;                         /* search resources handed to search_query()       */
   int              nquery   = 0;
-  int              textw;
-  int              iteration;
-  int              maxiterations;
-  int              nnew_targets;
-  int              prv_msa_nseq;
   int              status   = eslOK;
   int              qstatus  = eslOK;
-  int              sstatus  = eslOK;
 
   int              i;
   int              ncpus    = 0;
+  int              do_qpipe = FALSE;              /* TRUE to search one query per worker (--qpipe)   */
 
   int              infocnt  = 0;
   WORKER_INFO     *info     = NULL;
@@ -460,14 +520,13 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   ESL_SQ_BLOCK    *block    = NULL;
   ESL_THREADS     *threadObj= NULL;
   ESL_WORK_QUEUE  *queue    = NULL;
+  P7_DOMAINPOOL   *ddpool   = NULL;
 #endif
 
   /* Initializations */
   abc           = esl_alphabet_Create(eslAMINO);
   w             = esl_stopwatch_Create();
   kh            = esl_keyhash_Create();
-  maxiterations = esl_opt_GetInteger(go, "-N");
-  textw         = (esl_opt_GetBoolean(go, "--notextw") ? 0 : esl_opt_GetInteger(go, "--textw"));
 
   esl_stopwatch_Start(w);
 
@@ -486,14 +545,8 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
    */
   bg = p7_bg_Create(abc);
 
-  /* Initialize builder configuration 
-   * Default matrix is stored in the --mx option, so it's always IsOn(). 
-   * Check --mxfile first; then go to the --mx option and the default. 
-   */
-  bld = p7_builder_Create(go, abc);
-  if (esl_opt_IsOn(go, "--mxfile")) status = p7_builder_SetScoreSystem (bld, esl_opt_GetString(go, "--mxfile"), NULL, esl_opt_GetReal(go, "--popen"), esl_opt_GetReal(go, "--pextend"), bg);
-  else                              status = p7_builder_LoadScoreSystem(bld, esl_opt_GetString(go, "--mx"),           esl_opt_GetReal(go, "--popen"), esl_opt_GetReal(go, "--pextend"), bg); 
-  if (status != eslOK) p7_Fail("Failed to set single query seq score system:\n%s\n", bld->errbuf);
+  /* Initialize builder configuration */
+  bld = create_builder(go, abc, bg);
 
   /* Open results output files */
   if (esl_opt_IsOn(go, "-o")          && (ofp      = fopen(esl_opt_GetString(go, "-o"),          "w")) == NULL)  
@@ -506,14 +559,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
     p7_Fail("Failed to open tabular per-dom output file %s for writing\n", esl_opt_GetString(go, "--domtblout"));
 
   /* Open the target sequence database for sequential access. */
-  status =  esl_sqfile_OpenDigital(abc, cfg->dbfile, dbformat, p7_SEQDBENV, &dbfp);
-  if      (status == eslENOTFOUND) p7_Fail("Failed to open target sequence database %s for reading\n",      cfg->dbfile);
-  else if (status == eslEFORMAT)   p7_Fail("Target sequence database file %s is empty or misformatted\n",   cfg->dbfile);
-  else if (status == eslEINVAL)    p7_Fail("Can't autodetect format of a stdin or .gz seqfile");
-  else if (status != eslOK)        p7_Fail("Unexpected error %d opening target sequence database file %s\n", status, cfg->dbfile);
-  
-  if (! esl_sqfile_IsRewindable(dbfp)) 
-    p7_Fail("Target sequence file %s isn't rewindable; jackhmmer requires that it is", cfg->dbfile);
+  dbfp = open_dbfile(abc, cfg->dbfile, dbformat);
 
   /* Open the query sequence file  */
   status = esl_sqfile_OpenDigital(abc, cfg->qfile, qformat, NULL, &qfp);
@@ -526,14 +572,16 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 #ifdef HMMER_THREADS
   /* initialize thread data */
   ncpus = ESL_MIN(esl_opt_GetInteger(go, "--cpu"), esl_threads_GetCPUCount());
-  if (ncpus > 0)
+  if (ncpus > 0 && esl_opt_GetBoolean(go, "--qpipe")) do_qpipe = TRUE;
+  if (ncpus > 0 && ! do_qpipe)
     {
       threadObj = esl_threads_Create(&pipeline_thread);
       queue = esl_workqueue_Create(ncpus * 2);
+      if ((ddpool = p7_domainpool_Create(ncpus)) == NULL) p7_Fail("Failed to create domain definition threads");
     }
 #endif
 
-  infocnt = (ncpus == 0) ? 1 : ncpus;
+  infocnt = (ncpus == 0 || do_qpipe) ? 1 : ncpus;
   ESL_ALLOC(info, sizeof(*info) * infocnt);
 
   /* Ready to begin */
@@ -551,7 +599,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
     }
 
 #ifdef HMMER_THREADS
-  for (i = 0; i < ncpus * 2; ++i)
+  for (i = 0; ! do_qpipe && i < ncpus * 2; ++i)
     {
       block = esl_sq_CreateDigitalBlock(BLOCK_SIZE, abc);
       if (block == NULL) 
@@ -567,180 +615,35 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
     }
 #endif
 
-  /* Outer loop over sequence queries, if more than one */
-  while ((qstatus = esl_sqio_Read(qfp, qsq)) == eslOK)
-    {
-      P7_HMM          *hmm     = NULL;	     /* HMM - only needed if checkpointed        */
-      P7_HMM         **ret_hmm = NULL;	     /* HMM - only needed if checkpointed        */
-      P7_OPROFILE     *om      = NULL;       /* optimized query profile                  */
-      P7_TRACE        *qtr     = NULL;       /* faux trace for query sequence            */
-      ESL_MSA         *msa     = NULL;       /* multiple alignment of included hits      */
-      
-      if (esl_opt_IsOn(go, "--chkhmm")) ret_hmm = &hmm;
-
-      nquery++;
-      if (qsq->n == 0) continue; /* skip zero length queries as if they aren't even present. */
-
-      if (fprintf(ofp, "Query:       %s  [L=%ld]\n", qsq->name, (long) qsq->n) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-      if (qsq->acc[0]  != '\0' && fprintf(ofp, "Accession:   %s\n", qsq->acc)  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); 
-      if (qsq->desc[0] != '\0' && fprintf(ofp, "Description: %s\n", qsq->desc) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");  
-      if (fprintf(ofp, "\n")                                                   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-
-      for (iteration = 1; iteration <= maxiterations; iteration++)
-	{       /* We enter each iteration with an optimized profile. */
-	  esl_stopwatch_Start(w);
-
-	  if (om        != NULL) p7_oprofile_Destroy(om);
-	  if (info->pli != NULL) p7_pipeline_Destroy(info->pli);
-	  if (info->th  != NULL) p7_tophits_Destroy(info->th);
-	  if (info->om  != NULL) p7_oprofile_Destroy(info->om);
-
- 	  /* Create the search model: from query alone (round 1) or from MSA (round 2+) */
-	  if (msa == NULL)	/* round 1 */
-	    {
-	      p7_SingleBuilder(bld, qsq, info[0].bg, ret_hmm, &qtr, NULL, &om); /* bypass HMM - only need model */
-	      prv_msa_nseq = 1;
-	    }
-	  else
-	    {
-	      /* Throw away old model. Build new one. */
-	      status = p7_Builder(bld, msa, info[0].bg, ret_hmm, NULL, NULL, &om, NULL);
-	      if      (status == eslENORESULT) p7_Fail("Failed to construct new model from iteration %d results:\n%s", iteration, bld->errbuf);
-	      else if (status == eslEFORMAT)   p7_Fail("Failed to construct new model from iteration %d results:\n%s", iteration, bld->errbuf);
-	      else if (status != eslOK)        p7_Fail("Unexpected error constructing new model at iteration %d:",     iteration);
-
-	      if (fprintf(ofp, "@@\n")                                               < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");  
-	      if (fprintf(ofp, "@@ Round:                  %d\n", iteration)         < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-		  if (fprintf(ofp, "@@ Included in MSA:        %d subsequences (query + %d subseqs from %d targets)\n",
-		      msa->nseq, msa->nseq-1, kh->nkeys)                             < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-	      if (fprintf(ofp, "@@ Model size:             %d positions\n", om->M)   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-	      if (fprintf(ofp, "@@\n\n")                                             < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-
-	      prv_msa_nseq = msa->nseq;
-	      esl_msa_Destroy(msa);
-	    }
-
-	  /* HMM checkpoint output */
-	  if (esl_opt_IsOn(go, "--chkhmm")) {
-	    checkpoint_hmm(nquery, hmm, esl_opt_GetString(go, "--chkhmm"), iteration);
-	    p7_hmm_Destroy(hmm);
-	    hmm = NULL;
-	  }
-
-	  /* Create new processing pipeline and top hits list; destroy old. (TODO: reuse rather than recreate) */
-	  for (i = 0; i < infocnt; ++i)
-	    {
-	      info[i].th  = p7_tophits_Create();
-	      info[i].om  = p7_oprofile_Clone(om);
-	      info[i].pli = p7_pipeline_Create(go, om->M, 400, FALSE, p7_SEARCH_SEQS); /* 400 is a dummy length for now */
-	      p7_pli_NewModel(info[i].pli, info[i].om, info[i].bg);
-
+  sinfo.abc       = abc;
+  sinfo.bld       = bld;
+  sinfo.dbfp      = dbfp;
+  sinfo.kh        = kh;
+  sinfo.w         = w;
+  sinfo.info      = info;
+  sinfo.infocnt   = infocnt;
+  p7_stagestats_Zero(&(sinfo.stagestats));
 #ifdef HMMER_THREADS
-	      if (ncpus > 0) esl_threads_AddThread(threadObj, &info[i]);
+  if (! do_qpipe) bld->ncpus = ncpus;	/* search threads idle while each iteration's model is built */
+  sinfo.ncpus     = ncpus;
+  sinfo.threadObj = threadObj;
+  sinfo.queue     = queue;
+  sinfo.ddpool    = ddpool;
 #endif
-	    }
 
+  /* Outer loop over sequence queries, if more than one */
 #ifdef HMMER_THREADS
-	  if (ncpus > 0) sstatus = thread_loop(threadObj, queue, dbfp);
-	  else           sstatus = serial_loop(info, dbfp);
-#else
-	  sstatus = serial_loop(info, dbfp);
+  if (do_qpipe)
+    qstatus = qpipe_loop(go, cfg, abc, bg, dbformat, ncpus, qfp, ofp, afp, tblfp, domtblfp, &(sinfo.stagestats));
+  else
 #endif
-	  switch(sstatus)
-	    {
-	    case eslEFORMAT:
-	      p7_Fail("Parse failed (sequence file %s):\n%s\n",
-			dbfp->filename, esl_sqfile_GetErrorBuf(dbfp));
-	      break;
-	    case eslEOF:
-	      /* do nothing */
-	      break;
-	    default:
-	      p7_Fail("Unexpected error %d reading sequence file %s",
-			sstatus, dbfp->filename);
-	    }
-
-	  /* merge the results of the search results */
-	  for (i = 1; i < infocnt; ++i)
-	    {
-	      p7_tophits_Merge(info[0].th, info[i].th);
-	      p7_pipeline_Merge(info[0].pli, info[i].pli);
-
-	      p7_pipeline_Destroy(info[i].pli);
-	      p7_tophits_Destroy(info[i].th);
-	      p7_oprofile_Destroy(info[i].om);
-	    }
-
-	  /* Print the results. */
-	  p7_tophits_SortBySortkey(info->th);
-	  p7_tophits_Threshold(info->th, info->pli);
-	  p7_tophits_CompareRanking(info->th, kh, &nnew_targets);
-	  p7_tophits_Targets(ofp, info->th, info->pli, textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-	  p7_tophits_Domains(ofp, info->th, info->pli, textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-
-	  /* Create alignment of the top hits */
-	  /* <&qsq, &qtr, 1> included in p7_tophits_Alignment args here => initial query is added to the msa at each round. */
-	  p7_tophits_Alignment(info->th, abc, &qsq, &qtr, 1, p7_ALL_CONSENSUS_COLS, &msa);
-	  esl_msa_Digitize(abc,msa,NULL);
-	  esl_msa_FormatName(msa, "%s-i%d", qsq->name, iteration);  
-	  if (qsq->acc[0]  != '\0') esl_msa_SetAccession(msa, qsq->acc,  -1);
-	  if (qsq->desc[0] != '\0') esl_msa_SetDesc     (msa, qsq->desc, -1);
-	  esl_msa_FormatAuthor(msa, "jackhmmer (HMMER %s)", HMMER_VERSION);
-
-	  /* Optional checkpointing */
-	  if (esl_opt_IsOn(go, "--chkali")) checkpoint_msa(nquery, msa, esl_opt_GetString(go, "--chkali"), iteration);
-
-	  esl_stopwatch_Stop(w);
-	  p7_pli_Statistics(ofp, info->pli, w);
-
-
-	  /* Convergence test */
-	  if (fprintf(ofp, "\n")                                             < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-	  if (fprintf(ofp, "@@ New targets included:   %d\n", nnew_targets)  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-	  if (fprintf(ofp, "@@ New alignment includes: %d subseqs (was %d), including original query\n",
-		  msa->nseq, prv_msa_nseq)                                   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-	  if (nnew_targets == 0 && msa->nseq <= prv_msa_nseq)
-	    {
-	      if (fprintf(ofp, "@@\n")                                       < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-	      if (fprintf(ofp, "@@ CONVERGED (in %d rounds). \n", iteration) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-	      if (fprintf(ofp, "@@\n\n")                                     < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-	      break;
-	    }
-	  else if (iteration < maxiterations)
-	    { if (fprintf(ofp, "@@ Continuing to next round.\n\n")           < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
-
-	  esl_sqfile_Position(dbfp, 0);
-	} /* end iteration loop */
-
-      /* Because we destroy/create the hitlist, om, pipeline, and msa above, rather than create/destroy,
-       * the results of the last iteration have carried through to us now, and we can output
-       * whatever final results we care to.
-       */
-      if (tblfp)    p7_tophits_TabularTargets(tblfp,    qsq->name, qsq->acc, info->th, info->pli, (nquery == 1));
-      if (domtblfp) p7_tophits_TabularDomains(domtblfp, qsq->name, qsq->acc, info->th, info->pli, (nquery == 1));
-      if (afp) 
+    {
+      while ((qstatus = esl_sqio_Read(qfp, qsq)) == eslOK)
 	{
-	  if (textw > 0) esl_msafile_Write(afp, msa, eslMSAFILE_STOCKHOLM);
-	  else           esl_msafile_Write(afp, msa, eslMSAFILE_PFAM);
-
-	  if (fprintf(ofp, "# Alignment of %d hits satisfying inclusion thresholds saved to: %s\n", msa->nseq, esl_opt_GetString(go, "-A")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+	  nquery++;
+	  if ((status = search_query(go, &sinfo, qsq, nquery, ofp, afp, tblfp, domtblfp)) != eslOK) goto ERROR;
+	  esl_sq_Reuse(qsq);
 	}
-      if (fprintf(ofp, "//\n")  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-
-      p7_pipeline_Destroy(info->pli);
-      p7_tophits_Destroy(info->th);
-      p7_oprofile_Destroy(info->om);
-
-      info->pli = NULL;
-      info->th  = NULL;
-      info->om  = NULL;
-
-      esl_msa_Destroy(msa);
-      p7_oprofile_Destroy(om);
-      p7_trace_Destroy(qtr);
-      esl_sq_Reuse(qsq);
-      esl_keyhash_Reuse(kh);
-      esl_sqfile_Position(dbfp, 0);
     }
   if      (qstatus == eslEFORMAT) p7_Fail("Parse failed (sequence file %s):\n%s\n",
 					    qfp->filename, esl_sqfile_GetErrorBuf(qfp));
@@ -749,6 +652,10 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
   /* Terminate outputs - any last words?
    */
+  if (esl_opt_GetBoolean(go, "--stagestats")) {
+    if (tblfp)    p7_pli_TabularStageStats(tblfp,    &(sinfo.stagestats));
+    if (domtblfp) p7_pli_TabularStageStats(domtblfp, &(sinfo.stagestats));
+  }
   if (tblfp)    p7_tophits_TabularTail(tblfp,    "jackhmmer", p7_SEARCH_SEQS, cfg->qfile, cfg->dbfile, go);
   if (domtblfp) p7_tophits_TabularTail(domtblfp, "jackhmmer", p7_SEARCH_SEQS, cfg->qfile, cfg->dbfile, go);
   if (ofp &&    fprintf(ofp, "[ok]\n")  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
@@ -759,13 +666,14 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
     p7_bg_Destroy(info[i].bg);
 
 #ifdef HMMER_THREADS
-  if (ncpus > 0)
+  if (ncpus > 0 && ! do_qpipe)
     {
       esl_workqueue_Reset(queue);
       while (esl_workqueue_Remove(queue, (void **) &block) == eslOK)
 	esl_sq_DestroyBlock(block);
       esl_workqueue_Destroy(queue);
       esl_threads_Destroy(threadObj);
+      p7_domainpool_Destroy(ddpool);
     }
 #endif
 
@@ -791,6 +699,259 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   return eslFAIL;
 }
 
+/* create_builder()
+ * Create the P7_BUILDER that constructs query models, from the query
+ * sequence alone in round 1 and from the MSA of included hits after
+ * that. The default matrix is stored in the --mx option, so it's
+ * always IsOn(). Check --mxfile first; then go to the --mx option and
+ * the default.
+ */
+static P7_BUILDER *
+create_builder(ESL_GETOPTS *go, const ESL_ALPHABET *abc, P7_BG *bg)
+{
+  P7_BUILDER *bld = NULL;
+  int         status;
+
+  bld = p7_builder_Create(go, abc);
+  if (bld == NULL) p7_Fail("p7_builder_Create failed");
+
+  if (esl_opt_IsOn(go, "--mxfile")) status = p7_builder_SetScoreSystem (bld, esl_opt_GetString(go, "--mxfile"), NULL, esl_opt_GetReal(go, "--popen"), esl_opt_GetReal(go, "--pextend"), bg);
+  else                              status = p7_builder_LoadScoreSystem(bld, esl_opt_GetString(go, "--mx"),           esl_opt_GetReal(go, "--popen"), esl_opt_GetReal(go, "--pextend"), bg); 
+  if (status != eslOK) p7_Fail("Failed to set single query seq score system:\n%s\n", bld->errbuf);
+
+  return bld;
+}
+
+/* open_dbfile()
+ * Open the target sequence database for sequential access.
+ * jackhmmer rewinds it for every iteration, so it must be rewindable.
+ */
+static ESL_SQFILE *
+open_dbfile(const ESL_ALPHABET *abc, char *dbfile, int dbformat)
+{
+  ESL_SQFILE *dbfp = NULL;
+  int         status;
+
+  status =  esl_sqfile_OpenDigital(abc, dbfile, dbformat, p7_SEQDBENV, &dbfp);
+  if      (status == eslENOTFOUND) p7_Fail("Failed to open target sequence database %s for reading\n",      dbfile);
+  else if (status == eslEFORMAT)   p7_Fail("Target sequence database file %s is empty or misformatted\n",   dbfile);
+  else if (status == eslEINVAL)    p7_Fail("Can't autodetect format of a stdin or .gz seqfile");
+  else if (status != eslOK)        p7_Fail("Unexpected error %d opening target sequence database file %s\n", status, dbfile);
+  
+  if (! esl_sqfile_IsRewindable(dbfp)) 
+    p7_Fail("Target sequence file %s isn't rewindable; jackhmmer requires that it is", dbfile);
+
+  return dbfp;
+}
+
+/* search_query()
+ * Run the jackhmmer iterations for one query sequence <qsq>, which
+ * is the <nquery>'th query in the query file, using the search
+ * resources in <sinfo>; write results to <ofp> and to the optional
+ * <afp>, <tblfp>, and <domtblfp> streams.
+ *
+ * Shared by the serial master (which searches with <sinfo->ncpus>
+ * pipeline threads) and the --qpipe query workers (each of which
+ * searches serially with its own <sinfo>).
+ */
+static int
+search_query(ESL_GETOPTS *go, SEARCH_INFO *sinfo, ESL_SQ *qsq, int nquery, FILE *ofp, FILE *afp, FILE *tblfp, FILE *domtblfp)
+{
+  ESL_ALPHABET    *abc      = sinfo->abc;
+  P7_BUILDER      *bld      = sinfo->bld;
+  ESL_SQFILE      *dbfp     = sinfo->dbfp;
+  ESL_KEYHASH     *kh       = sinfo->kh;
+  ESL_STOPWATCH   *w        = sinfo->w;
+  WORKER_INFO     *info     = sinfo->info;
+  int              infocnt  = sinfo->infocnt;
+#ifdef HMMER_THREADS
+  int              ncpus    = sinfo->ncpus;
+  ESL_THREADS     *threadObj= sinfo->threadObj;
+  ESL_WORK_QUEUE  *queue    = sinfo->queue;
+  P7_DOMAINPOOL   *ddpool   = sinfo->ddpool;
+#endif
+  P7_HMM          *hmm      = NULL;	  /* HMM - only needed if checkpointed               */
+  P7_HMM         **ret_hmm  = NULL;	  /* HMM - only needed if checkpointed               */
+  P7_OPROFILE     *om       = NULL;       /* optimized query profile                         */
+  P7_TRACE        *qtr      = NULL;       /* faux trace for query sequence                   */
+  ESL_MSA         *msa      = NULL;       /* multiple alignment of included hits             */
+  int              textw    = (esl_opt_GetBoolean(go, "--notextw") ? 0 : esl_opt_GetInteger(go, "--textw"));
+  int              maxiterations = esl_opt_GetInteger(go, "-N");
+  int              iteration;
+  int              nnew_targets;
+  int              prv_msa_nseq;
+  int              status;
+  int              sstatus;
+  int              i;
+
+  if (esl_opt_IsOn(go, "--chkhmm")) ret_hmm = &hmm;
+
+  if (qsq->n == 0) return eslOK; /* skip zero length queries as if they aren't even present. */
+
+  if (fprintf(ofp, "Query:       %s  [L=%ld]\n", qsq->name, (long) qsq->n) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (qsq->acc[0]  != '\0' && fprintf(ofp, "Accession:   %s\n", qsq->acc)  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); 
+  if (qsq->desc[0] != '\0' && fprintf(ofp, "Description: %s\n", qsq->desc) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");  
+  if (fprintf(ofp, "\n")                                                   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+
+  for (iteration = 1; iteration <= maxiterations; iteration++)
+    {       /* We enter each iteration with an optimized profile. */
+      esl_stopwatch_Start(w);
+
+      if (om        != NULL) p7_oprofile_Destroy(om);
+      if (info->pli != NULL) p7_pipeline_Destroy(info->pli);
+      if (info->th  != NULL) p7_tophits_Destroy(info->th);
+      if (info->om  != NULL) p7_oprofile_Destroy(info->om);
+
+      /* Create the search model: from query alone (round 1) or from MSA (round 2+) */
+      if (msa == NULL)	/* round 1 */
+	{
+	  p7_SingleBuilder(bld, qsq, info[0].bg, ret_hmm, &qtr, NULL, &om); /* bypass HMM - only need model */
+	  prv_msa_nseq = 1;
+	}
+      else
+	{
+	  /* Throw away old model. Build new one. */
+	  status = p7_Builder(bld, msa, info[0].bg, ret_hmm, NULL, NULL, &om, NULL);
+	  if      (status == eslENORESULT) p7_Fail("Failed to construct new model from iteration %d results:\n%s", iteration, bld->errbuf);
+	  else if (status == eslEFORMAT)   p7_Fail("Failed to construct new model from iteration %d results:\n%s", iteration, bld->errbuf);
+	  else if (status != eslOK)        p7_Fail("Unexpected error constructing new model at iteration %d:",     iteration);
+
+	  if (fprintf(ofp, "@@\n")                                               < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");  
+	  if (fprintf(ofp, "@@ Round:                  %d\n", iteration)         < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+	      if (fprintf(ofp, "@@ Included in MSA:        %d subsequences (query + %d subseqs from %d targets)\n",
+		  msa->nseq, msa->nseq-1, kh->nkeys)                             < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+	  if (fprintf(ofp, "@@ Model size:             %d positions\n", om->M)   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+	  if (fprintf(ofp, "@@\n\n")                                             < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+
+	  prv_msa_nseq = msa->nseq;
+	  esl_msa_Destroy(msa);
+	}
+
+      /* HMM checkpoint output */
+      if (esl_opt_IsOn(go, "--chkhmm")) {
+	checkpoint_hmm(nquery, hmm, esl_opt_GetString(go, "--chkhmm"), iteration);
+	p7_hmm_Destroy(hmm);
+	hmm = NULL;
+      }
+
+      /* Create new processing pipeline and top hits list; destroy old. (TODO: reuse rather than recreate) */
+      for (i = 0; i < infocnt; ++i)
+	{
+	  info[i].th  = p7_tophits_Create();
+	  info[i].om  = p7_oprofile_Clone(om);
+	  info[i].pli = p7_pipeline_Create(go, om->M, 400, FALSE, p7_SEARCH_SEQS); /* 400 is a dummy length for now */
+	  p7_pli_NewModel(info[i].pli, info[i].om, info[i].bg);
+
+#ifdef HMMER_THREADS
+	  info[i].pli->ddef->pool = ddpool;
+	  if (ncpus > 0) esl_threads_AddThread(threadObj, &info[i]);
+#endif
+	}
+
+#ifdef HMMER_THREADS
+      if (ncpus > 0) sstatus = thread_loop(threadObj, queue, dbfp);
+      else           sstatus = serial_loop(info, dbfp);
+#else
+      sstatus = serial_loop(info, dbfp);
+#endif
+      switch(sstatus)
+	{
+	case eslEFORMAT:
+	  p7_Fail("Parse failed (sequence file %s):\n%s\n",
+		    dbfp->filename, esl_sqfile_GetErrorBuf(dbfp));
+	  break;
+	case eslEOF:
+	  /* do nothing */
+	  break;
+	default:
+	  p7_Fail("Unexpected error %d reading sequence file %s",
+		    sstatus, dbfp->filename);
+	}
+
+      /* merge the results of the search results */
+      for (i = 1; i < infocnt; ++i)
+	{
+	  p7_tophits_Merge(info[0].th, info[i].th);
+	  p7_pipeline_Merge(info[0].pli, info[i].pli);
+
+	  p7_pipeline_Destroy(info[i].pli);
+	  p7_tophits_Destroy(info[i].th);
+	  p7_oprofile_Destroy(info[i].om);
+	}
+
+      /* Print the results. */
+      p7_tophits_SortBySortkey(info->th);
+      p7_tophits_Threshold(info->th, info->pli);
+      p7_tophits_CompareRanking(info->th, kh, &nnew_targets);
+      p7_tophits_Targets(ofp, info->th, info->pli, textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+      p7_tophits_Domains(ofp, info->th, info->pli, textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+
+      /* Create alignment of the top hits */
+      /* <&qsq, &qtr, 1> included in p7_tophits_Alignment args here => initial query is added to the msa at each round. */
+      p7_tophits_Alignment(info->th, abc, &qsq, &qtr, 1, p7_ALL_CONSENSUS_COLS, &msa);
+      esl_msa_Digitize(abc,msa,NULL);
+      esl_msa_FormatName(msa, "%s-i%d", qsq->name, iteration);  
+      if (qsq->acc[0]  != '\0') esl_msa_SetAccession(msa, qsq->acc,  -1);
+      if (qsq->desc[0] != '\0') esl_msa_SetDesc     (msa, qsq->desc, -1);
+      esl_msa_FormatAuthor(msa, "jackhmmer (HMMER %s)", HMMER_VERSION);
+
+      /* Optional checkpointing */
+      if (esl_opt_IsOn(go, "--chkali")) checkpoint_msa(nquery, msa, esl_opt_GetString(go, "--chkali"), iteration);
+
+      esl_stopwatch_Stop(w);
+      p7_pli_Statistics(ofp, info->pli, w);
+      p7_stagestats_Merge(&(sinfo->stagestats), &(info->pli->stats));
+
+
+      /* Convergence test */
+      if (fprintf(ofp, "\n")                                             < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+      if (fprintf(ofp, "@@ New targets included:   %d\n", nnew_targets)  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+      if (fprintf(ofp, "@@ New alignment includes: %d subseqs (was %d), including original query\n",
+	      msa->nseq, prv_msa_nseq)                                   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+      if (nnew_targets == 0 && msa->nseq <= prv_msa_nseq)
+	{
+	  if (fprintf(ofp, "@@\n")                                       < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+	  if (fprintf(ofp, "@@ CONVERGED (in %d rounds). \n", iteration) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+	  if (fprintf(ofp, "@@\n\n")                                     < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+	  break;
+	}
+      else if (iteration < maxiterations)
+	{ if (fprintf(ofp, "@@ Continuing to next round.\n\n")           < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
+
+      esl_sqfile_Position(dbfp, 0);
+    } /* end iteration loop */
+
+  /* Because we destroy/create the hitlist, om, pipeline, and msa above, rather than create/destroy,
+   * the results of the last iteration have carried through to us now, and we can output
+   * whatever final results we care to.
+   */
+  if (tblfp)    p7_tophits_TabularTargets(tblfp,    qsq->name, qsq->acc, info->th, info->pli, (nquery == 1));
+  if (domtblfp) p7_tophits_TabularDomains(domtblfp, qsq->name, qsq->acc, info->th, info->pli, (nquery == 1));
+  if (afp) 
+    {
+      if (textw > 0) esl_msafile_Write(afp, msa, eslMSAFILE_STOCKHOLM);
+      else           esl_msafile_Write(afp, msa, eslMSAFILE_PFAM);
+
+      if (fprintf(ofp, "# Alignment of %d hits satisfying inclusion thresholds saved to: %s\n", msa->nseq, esl_opt_GetString(go, "-A")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+    }
+  if (fprintf(ofp, "//\n")  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+
+  p7_pipeline_Destroy(info->pli);
+  p7_tophits_Destroy(info->th);
+  p7_oprofile_Destroy(info->om);
+
+  info->pli = NULL;
+  info->th  = NULL;
+  info->om  = NULL;
+
+  esl_msa_Destroy(msa);
+  p7_oprofile_Destroy(om);
+  p7_trace_Destroy(qtr);
+  esl_keyhash_Reuse(kh);
+  esl_sqfile_Position(dbfp, 0);
+  return eslOK;
+}
+
 #ifdef HMMER_MPI
 
 /* Define common tags used by the MPI master/slave processes */
@@ -996,6 +1157,7 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   ESL_SQ          *dbsq     = NULL;               /* target sequence                                 */
   ESL_KEYHASH     *kh       = NULL;		  /* hash of previous top hits' ranks                */
   ESL_STOPWATCH   *w        = NULL;               /* for timing                                      */
+  P7_STAGESTATS    stagestats;                    /* per-stage totals over all queries (--stagestats) */
   int              nquery   = 0;
   int              textw;
   int              iteration;
@@ -1021,6 +1183,7 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   /* Initializations */
   abc           = esl_alphabet_Create(eslAMINO);
   w             = esl_stopwatch_Create();
+  p7_stagestats_Zero(&stagestats);
   kh            = esl_keyhash_Create();
   maxiterations = esl_opt_GetInteger(go, "-N");
   if (esl_opt_GetBoolean(go, "--notextw")) textw = 0;
@@ -1246,6 +1409,7 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
 	  esl_stopwatch_Stop(w);
 	  p7_pli_Statistics(ofp, pli, w);
+	  p7_stagestats_Merge(&stagestats, &(pli->stats));
 
 	  /* Convergence test */
 	  if (fprintf(ofp, "\n")                                             < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
@@ -1334,6 +1498,10 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
   /* Terminate outputs - any last words?
    */
+  if (esl_opt_GetBoolean(go, "--stagestats")) {
+    if (tblfp)    p7_pli_TabularStageStats(tblfp,    &stagestats);
+    if (domtblfp) p7_pli_TabularStageStats(domtblfp, &stagestats);
+  }
   if (tblfp)    p7_tophits_TabularTail(tblfp,    "jackhmmer", p7_SEARCH_SEQS, cfg->qfile, cfg->dbfile, go);
   if (domtblfp) p7_tophits_TabularTail(domtblfp, "jackhmmer", p7_SEARCH_SEQS, cfg->qfile, cfg->dbfile, go);
   if (ofp &&    fprintf(ofp, "[ok]\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
@@ -1484,8 +1652,7 @@ mpi_worker(ESL_GETOPTS *go, struct cfg_s *cfg)
 		  length = dbsq->eoff - block.offset + 1;
 
 		  p7_pli_NewSeq(pli, dbsq);
-		  p7_bg_SetLength(bg, dbsq->n);
-		  p7_oprofile_ReconfigLength(om, dbsq->n);
+		  p7_pli_SetTargetLength(pli, om, bg, dbsq->n);
       
 		  p7_Pipeline(pli, om, bg, dbsq, NULL, th);
 
@@ -1609,8 +1776,7 @@ serial_loop(WORKER_INFO *info, ESL_SQFILE *dbfp)
   while ((sstatus = esl_sqio_Read(dbfp, dbsq)) == eslOK)
     {
       p7_pli_NewSeq(info->pli, dbsq);
-      p7_bg_SetLength(info->bg, dbsq->n);
-      p7_oprofile_ReconfigLength(info->om, dbsq->n);
+      p7_pli_SetTargetLength(info->pli, info->om, info->bg, dbsq->n);
       
       p7_Pipeline(info->pli, info->om, info->bg, dbsq, NULL, info->th);
 
@@ -1681,6 +1847,8 @@ pipeline_thread(void *arg)
 
   ESL_SQ_BLOCK  *block = NULL;
   void          *newBlock;
+  int           *order  = NULL;	/* indices of the block's seqs, by length */
+  int            norder = 0;
 
   impl_Init();
 
@@ -1697,14 +1865,20 @@ pipeline_thread(void *arg)
   block = (ESL_SQ_BLOCK *) newBlock;
   while (block->count > 0)
     {
+      /* visit the block in order of length, so the model is reconfigured once per distinct length */
+      if (block->count > norder) {
+	ESL_REALLOC(order, sizeof(int) * block->count);
+	norder = block->count;
+      }
+      p7_pli_OrderByLength(block->list, block->count, order);
+
       /* Main loop: */
       for (i = 0; i < block->count; ++i)
 	{
-	  ESL_SQ *dbsq = block->list + i;
+	  ESL_SQ *dbsq = block->list + order[i];
 
 	  p7_pli_NewSeq(info->pli, dbsq);
-	  p7_bg_SetLength(info->bg, dbsq->n);
-	  p7_oprofile_ReconfigLength(info->om, dbsq->n);
+	  p7_pli_SetTargetLength(info->pli, info->om, info->bg, dbsq->n);
 
 	  p7_Pipeline(info->pli, info->om, info->bg, dbsq, NULL, info->th);
 
@@ -1721,6 +1895,309 @@ pipeline_thread(void *arg)
   status = esl_workqueue_WorkerUpdate(info->queue, block, NULL);
   if (status != eslOK) p7_Fail("Work queue worker failed");
 
+  free(order);
+  esl_threads_Finished(obj, workeridx);
+  return;
+
+ ERROR:
+  p7_Fail("allocation failure in pipeline thread");
+}
+
+/* qpipe_loop()
+ * The --qpipe version of the query loop: search up to <ncpus>
+ * queries at once.
+ *
+ * Each query worker owns a complete serial search setup (builder,
+ * null model, open target database, key hash), so while one worker
+ * is rebuilding its model in p7_Builder() the others keep scanning
+ * the database. We read queries here and hand them out on a work
+ * queue. A query's output is buffered in temporary files until all
+ * the queries before it are done, then copied to the real outputs,
+ * so results appear in query order just as in the serial version.
+ * The workers' per-stage totals (--stagestats) are added to <stagestats>.
+ */
+static int
+qpipe_loop(ESL_GETOPTS *go, struct cfg_s *cfg, ESL_ALPHABET *abc, P7_BG *bg, int dbformat, int ncpus,
+	   ESL_SQFILE *qfp, FILE *ofp, FILE *afp, FILE *tblfp, FILE *domtblfp, P7_STAGESTATS *stagestats)
+{
+  FILE           *out[QPIPE_NBUF];
+  ESL_THREADS    *threadObj = NULL;
+  ESL_WORK_QUEUE *queue     = NULL;
+  QUERY_WORKER   *qw        = NULL;
+  QUERY_ITEM     *item      = NULL;
+  void           *newItem;
+  PENDING_QUERY  *top       = NULL;
+  PENDING_QUERY  *empty     = NULL;
+  PENDING_QUERY  *tmp       = NULL;
+  int             nquery    = 0;
+  int             processed = 0;
+  int             nstopped  = 0;
+  int             next      = 1;
+  int             qstatus   = eslOK;
+  int             status;
+  int             i, b;
+
+  out[0] = ofp;
+  out[1] = afp;
+  out[2] = tblfp;
+  out[3] = domtblfp;
+
+  threadObj = esl_threads_Create(&query_thread);
+  queue     = esl_workqueue_Create(ncpus * 2);
+
+  ESL_ALLOC(qw, sizeof(*qw) * ncpus);
+  for (i = 0; i < ncpus; ++i)
+    {
+      qw[i].queue           = queue;
+      qw[i].go              = go;
+
+      qw[i].info.pli        = NULL;
+      qw[i].info.th         = NULL;
+      qw[i].info.om         = NULL;
+      qw[i].info.bg         = p7_bg_Clone(bg);
+      qw[i].info.queue      = NULL;
+
+      qw[i].sinfo.abc       = abc;
+      qw[i].sinfo.bld       = create_builder(go, abc, qw[i].info.bg);
+      qw[i].sinfo.dbfp      = open_dbfile(abc, cfg->dbfile, dbformat);
+      qw[i].sinfo.kh        = esl_keyhash_Create();
+      qw[i].sinfo.w         = esl_stopwatch_Create();
+      qw[i].sinfo.info      = &(qw[i].info);
+      qw[i].sinfo.infocnt   = 1;
+      p7_stagestats_Zero(&(qw[i].sinfo.stagestats));
+      qw[i].sinfo.ncpus     = 0;
+      qw[i].sinfo.threadObj = NULL;
+      qw[i].sinfo.queue     = NULL;
+      qw[i].sinfo.ddpool    = NULL;
+
+      esl_threads_AddThread(threadObj, &qw[i]);
+    }
+
+  for (i = 0; i < ncpus * 2; ++i)
+    {
+      ESL_ALLOC(item, sizeof(*item));
+      item->nquery    = 0;
+      item->processed = FALSE;
+      item->qsq       = esl_sq_CreateDigital(abc);
+      for (b = 0; b < QPIPE_NBUF; b++) item->buf[b] = NULL;
+
+      status = esl_workqueue_Init(queue, item);
+      if (status != eslOK) p7_Fail("Failed to add query to work queue");
+    }
+
+  esl_workqueue_Reset(queue);
+  esl_threads_WaitForStart(threadObj);
+
+  status = esl_workqueue_ReaderUpdate(queue, NULL, &newItem);
+  if (status != eslOK) p7_Fail("Work queue reader failed");
+
+  /* Main loop: */
+  item = (QUERY_ITEM *) newItem;
+  while (qstatus == eslOK)
+    {
+      qstatus = esl_sqio_Read(qfp, item->qsq);
+      if (qstatus == eslOK)
+	{
+	  item->nquery = ++nquery;
+	  for (b = 0; b < QPIPE_NBUF; b++)
+	    item->buf[b] = (out[b] == NULL) ? NULL : open_query_buffer();
+	}
+      else if (qstatus == eslEOF && processed < nquery)
+	{
+	  item->nquery = 0;	/* an empty item stops a worker */
+	  nstopped++;
+	  qstatus = eslOK;
+	}
+
+      if (qstatus == eslOK)
+	{
+	  status = esl_workqueue_ReaderUpdate(queue, item, &newItem);
+	  if (status != eslOK) p7_Fail("Work queue reader failed");
+
+	  /* process any results */
+	  item = (QUERY_ITEM *) newItem;
+	  if (item->processed == TRUE)
+	    {
+	      ++processed;
+
+	      /* keep the output in the same order as the queries */
+	      if (item->nquery == next)
+		{
+		  for (b = 0; b < QPIPE_NBUF; b++) flush_query_buffer(item->buf[b], out[b]);
+		  ++next;
+
+		  while (top != NULL && top->nquery == next)
+		    {
+		      for (b = 0; b < QPIPE_NBUF; b++) flush_query_buffer(top->buf[b], out[b]);
+
+		      tmp = top;
+		      top = tmp->next;
+
+		      tmp->next = empty;
+		      empty     = tmp;
+
+		      ++next;
+		    }
+		}
+	      else
+		{
+		  if (empty != NULL) {
+		    tmp   = empty;
+		    empty = tmp->next;
+		  } else {
+		    ESL_ALLOC(tmp, sizeof(PENDING_QUERY));
+		  }
+
+		  tmp->nquery = item->nquery;
+		  for (b = 0; b < QPIPE_NBUF; b++) tmp->buf[b] = item->buf[b];
+
+		  /* add the query to the pending list, sorted by nquery */
+		  if (top == NULL || tmp->nquery < top->nquery) {
+		    tmp->next = top;
+		    top       = tmp;
+		  } else {
+		    PENDING_QUERY *ptr = top;
+		    while (ptr->next != NULL && tmp->nquery > ptr->next->nquery) 
+		      ptr = ptr->next;
+		    tmp->next = ptr->next;
+		    ptr->next = tmp;
+		  }
+		}
+
+	      item->nquery    = 0;
+	      item->processed = FALSE;
+	      for (b = 0; b < QPIPE_NBUF; b++) item->buf[b] = NULL;
+	    }
+	}
+    }
+
+  if (top != NULL) p7_Fail("--qpipe output of query %d was never written", top->nquery);
+
+  while (empty != NULL) {
+    tmp   = empty;
+    empty = tmp->next;
+    free(tmp);
+  }
+
+  /* make sure every worker has been handed an empty item */
+  item->nquery = 0;
+  for (; nstopped < ncpus - 1; nstopped++)
+    {
+      status = esl_workqueue_ReaderUpdate(queue, item, &newItem);
+      if (status != eslOK) p7_Fail("Work queue reader failed");
+      item = (QUERY_ITEM *) newItem;
+      item->nquery = 0;
+    }
+
+  status = esl_workqueue_ReaderUpdate(queue, item, NULL);
+  if (status != eslOK) p7_Fail("Work queue reader failed");
+
+  if (qstatus == eslEOF)
+    {
+      /* wait for all the threads to complete */
+      esl_threads_WaitForFinish(threadObj);
+      esl_workqueue_Complete(queue);  
+    }
+
+  esl_workqueue_Reset(queue);
+  while (esl_workqueue_Remove(queue, (void **) &item) == eslOK)
+    {
+      esl_sq_Destroy(item->qsq);
+      free(item);
+    }
+  esl_workqueue_Destroy(queue);
+  esl_threads_Destroy(threadObj);
+
+  for (i = 0; i < ncpus; ++i)
+    {
+      p7_stagestats_Merge(stagestats, &(qw[i].sinfo.stagestats));
+      p7_bg_Destroy(qw[i].info.bg);
+      p7_builder_Destroy(qw[i].sinfo.bld);
+      esl_sqfile_Close(qw[i].sinfo.dbfp);
+      esl_keyhash_Destroy(qw[i].sinfo.kh);
+      esl_stopwatch_Destroy(qw[i].sinfo.w);
+    }
+  free(qw);
+
+  return qstatus;
+
+ ERROR:
+  p7_Fail("qpipe_loop failed: memory allocation problem");
+  return eslEMEM;
+}
+
+/* open_query_buffer()
+ * Open an anonymous temporary file to hold one stream of one
+ * query's --qpipe output.
+ */
+static FILE *
+open_query_buffer(void)
+{
+  char  tmpname[16] = "esltmpXXXXXX";
+  FILE *fp          = NULL;
+
+  if (esl_tmpfile(tmpname, &fp) != eslOK) p7_Fail("Failed to open a temporary file to buffer --qpipe output");
+  return fp;
+}
+
+/* flush_query_buffer()
+ * Copy buffered output <buf> to the real output stream <ofp>,
+ * then close (and thereby remove) the buffer. No-op if <buf> is NULL.
+ */
+static void
+flush_query_buffer(FILE *buf, FILE *ofp)
+{
+  char   data[4096];
+  size_t n;
+
+  if (buf == NULL) return;
+
+  rewind(buf);
+  while ((n = fread(data, sizeof(char), sizeof(data), buf)) > 0)
+    if (fwrite(data, sizeof(char), n, ofp) != n) p7_Fail("write failed");
+  fclose(buf);
+}
+
+static void 
+query_thread(void *arg)
+{
+  int            status;
+  int            workeridx;
+  QUERY_WORKER  *qw;
+  ESL_THREADS   *obj;
+
+  QUERY_ITEM    *item = NULL;
+  void          *newItem;
+
+  impl_Init();
+
+  obj = (ESL_THREADS *) arg;
+  esl_threads_Started(obj, &workeridx);
+
+  qw = (QUERY_WORKER *) esl_threads_GetData(obj, workeridx);
+
+  status = esl_workqueue_WorkerUpdate(qw->queue, NULL, &newItem);
+  if (status != eslOK) p7_Fail("Work queue worker failed");
+
+  /* loop until we're handed an empty item */
+  item = (QUERY_ITEM *) newItem;
+  while (item->nquery > 0)
+    {
+      status = search_query(qw->go, &(qw->sinfo), item->qsq, item->nquery, item->buf[0], item->buf[1], item->buf[2], item->buf[3]);
+      if (status != eslOK) p7_Fail("Search of query %d (%s) failed", item->nquery, item->qsq->name);
+
+      esl_sq_Reuse(item->qsq);
+      item->processed = TRUE;
+
+      status = esl_workqueue_WorkerUpdate(qw->queue, item, &newItem);
+      if (status != eslOK) p7_Fail("Work queue worker failed");
+
+      item = (QUERY_ITEM *) newItem;
+    }
+
+  status = esl_workqueue_WorkerUpdate(qw->queue, item, NULL);
+  if (status != eslOK) p7_Fail("Work queue worker failed");
+
   esl_threads_Finished(obj, workeridx);
   return;
 }
@@ -0,0 +1,437 @@
+/* Unified speed benchmark for the dynamic programming kernels.
+ *
+ * Each DP implementation file has its own benchmark driver, with its
+ * own options and output. This driver instead runs all of the
+ * vectorized and generic kernels over one set of models (the models
+ * in any HMM files given on the command line, plus randomly sampled
+ * models of chosen sizes) and a range of target lengths, and reports
+ * speed in millions of DP cells per second, either as a table or as
+ * JSON for tracking speed across builds and machines.
+ *
+ * Kernels that need DP matrices as input (Backward, posterior
+ * decoding, null2, optimal accuracy) are timed alone: their inputs
+ * are calculated once, untimed, for one target sequence, and the
+ * kernel is rerun on them, as in the individual benchmark drivers.
+ * Other kernels cycle through a pool of random target sequences that
+ * is generated before timing starts.
+ *
+ * Contents:
+ *    1. Benchmark driver
+ */
+
+/*****************************************************************
+ * 1. Benchmark driver
+ *****************************************************************/
+#ifdef p7KERNELS_BENCHMARK
+/*
+   gcc -o kernels_benchmark -std=gnu99 -O3 -msse2 -I. -L. -I../easel -L../easel -Dp7KERNELS_BENCHMARK kernels.c -lhmmer -leasel -lm
+
+   ./kernels_benchmark ../testsuite/RRM_1.hmm            table, for one model and sampled models
+   ./kernels_benchmark --json out.json -M 0 *.hmm          JSON, for models in files only
+   ./kernels_benchmark --kernels msv,vitfilter -L 400      just some kernels, one length
+ */
+#include "p7_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_getopts.h"
+#include "esl_random.h"
+#include "esl_randomseq.h"
+#include "esl_stopwatch.h"
+
+#include "hmmer.h"
+
+#if   defined eslENABLE_SSE
+#define p7KB_IMPL "sse"
+#elif defined eslENABLE_VMX
+#define p7KB_IMPL "vmx"
+#else
+#define p7KB_IMPL "none"
+#endif
+
+/* Inputs that a kernel needs calculated (untimed) before it's run. */
+#define p7KB_FWD    (1<<0)	/* p7_Forward()  into kb->fwd          */
+#define p7KB_BCK    (1<<1)	/* p7_Backward() into kb->bck          */
+#define p7KB_PP     (1<<2)	/* p7_Decoding() into kb->pp           */
+#define p7KB_GFWD   (1<<3)	/* p7_GForward()  into kb->gfwd        */
+#define p7KB_GBCK   (1<<4)	/* p7_GBackward() into kb->gbck        */
+#define p7KB_GPP    (1<<5)	/* p7_GDecoding() into kb->gpp         */
+#define p7KB_PARSE  (1<<6)	/* p7_ForwardParser() into kb->fwdp    */
+
+/* Everything one kernel needs, configured for one model and target length. */
+typedef struct {
+  P7_BG       *bg;
+  P7_PROFILE  *gm;
+  P7_OPROFILE *om;
+  P7_OMX      *ox;		/* one-row matrix for filters                   */
+  P7_OMX      *fwdp, *bckp;	/* parser matrices: one DP row, L special rows  */
+  P7_OMX      *fwd,  *bck, *pp;	/* full vectorized matrices                     */
+  P7_GMX      *gx, *gfwd, *gbck, *gpp;
+  float       *null2;
+  ESL_DSQ    **dsq;		/* pool of random targets, [0..npool-1]         */
+  int          npool;
+  int          L;
+} KBENCH;
+
+typedef struct {
+  char  *name;
+  char  *impl;			/* "simd" or "generic"                          */
+  int    prep;			/* p7KB_* flags for untimed inputs              */
+  void (*run)(KBENCH *kb, const ESL_DSQ *dsq);
+} KERNEL;
+
+#if defined eslENABLE_SSE
+static void k_ssv      (KBENCH *kb, const ESL_DSQ *dsq) { float sc; p7_SSVFilter     (dsq, kb->L, kb->om,                   &sc); }
+#endif
+static void k_msv      (KBENCH *kb, const ESL_DSQ *dsq) { float sc; p7_MSVFilter     (dsq, kb->L, kb->om, kb->ox,           &sc); }
+static void k_vitfilter(KBENCH *kb, const ESL_DSQ *dsq) { float sc; p7_ViterbiFilter (dsq, kb->L, kb->om, kb->ox,           &sc); }
+static void k_vitscore (KBENCH *kb, const ESL_DSQ *dsq) { float sc; p7_ViterbiScore  (dsq, kb->L, kb->om, kb->ox,           &sc); }
+static void k_fwdparser(KBENCH *kb, const ESL_DSQ *dsq) { float sc; p7_ForwardParser (dsq, kb->L, kb->om, kb->fwdp,         &sc); }
+static void k_bckparser(KBENCH *kb, const ESL_DSQ *dsq) { float sc; p7_BackwardParser(dsq, kb->L, kb->om, kb->fwdp, kb->bckp, &sc); }
+static void k_forward  (KBENCH *kb, const ESL_DSQ *dsq) { float sc; p7_Forward       (dsq, kb->L, kb->om, kb->fwd,          &sc); }
+static void k_backward (KBENCH *kb, const ESL_DSQ *dsq) { float sc; p7_Backward      (dsq, kb->L, kb->om, kb->fwd, kb->bck, &sc); }
+static void k_decoding (KBENCH *kb, const ESL_DSQ *dsq) {           p7_Decoding      (kb->om, kb->fwd, kb->bck, kb->pp);          }
+static void k_null2    (KBENCH *kb, const ESL_DSQ *dsq) {           p7_Null2_ByExpectation(kb->om, kb->pp, kb->null2);             }
+static void k_optacc   (KBENCH *kb, const ESL_DSQ *dsq) { float e;  p7_OptimalAccuracy(kb->om, kb->pp, kb->bck,          &e);  }
+
+static void k_gmsv     (KBENCH *kb, const ESL_DSQ *dsq) { float sc; p7_GMSV          (dsq, kb->L, kb->gm, kb->gx, 2.0,      &sc); }
+static void k_gviterbi (KBENCH *kb, const ESL_DSQ *dsq) { float sc; p7_GViterbi      (dsq, kb->L, kb->gm, kb->gx,           &sc); }
+static void k_gforward (KBENCH *kb, const ESL_DSQ *dsq) { float sc; p7_GForward      (dsq, kb->L, kb->gm, kb->gfwd,         &sc); }
+static void k_gbackward(KBENCH *kb, const ESL_DSQ *dsq) { float sc; p7_GBackward     (dsq, kb->L, kb->gm, kb->gbck,         &sc); }
+static void k_gdecoding(KBENCH *kb, const ESL_DSQ *dsq) {           p7_GDecoding     (kb->gm, kb->gfwd, kb->gbck, kb->gpp);       }
+static void k_gnull2   (KBENCH *kb, const ESL_DSQ *dsq) {           p7_GNull2_ByExpectation(kb->gm, kb->gpp, kb->null2);           }
+static void k_goptacc  (KBENCH *kb, const ESL_DSQ *dsq) { float e;  p7_GOptimalAccuracy(kb->gm, kb->gpp, kb->gx,          &e);  }
+
+static KERNEL kernels[] = {
+#if defined eslENABLE_SSE
+  { "ssv",       "simd",    0,                                 k_ssv       },
+#endif
+  { "msv",       "simd",    0,                                 k_msv       },
+  { "vitfilter", "simd",    0,                                 k_vitfilter },
+  { "vitscore",  "simd",    0,                                 k_vitscore  },
+  { "fwdparser", "simd",    0,                                 k_fwdparser },
+  { "bckparser", "simd",    p7KB_PARSE,                        k_bckparser },
+  { "forward",   "simd",    0,                                 k_forward   },
+  { "backward",  "simd",    p7KB_FWD,                          k_backward  },
+  { "decoding",  "simd",    p7KB_FWD  | p7KB_BCK,              k_decoding  },
+  { "null2",     "simd",    p7KB_FWD  | p7KB_BCK  | p7KB_PP,   k_null2     },
+  { "optacc",    "simd",    p7KB_FWD  | p7KB_BCK  | p7KB_PP,   k_optacc    },
+  { "gmsv",      "generic", 0,                                 k_gmsv      },
+  { "gviterbi",  "generic", 0,                                 k_gviterbi  },
+  { "gforward",  "generic", 0,                                 k_gforward  },
+  { "gbackward", "generic", 0,                                 k_gbackward },
+  { "gdecoding", "generic", p7KB_GFWD | p7KB_GBCK,             k_gdecoding },
+  { "gnull2",    "generic", p7KB_GFWD | p7KB_GBCK | p7KB_GPP,  k_gnull2    },
+  { "goptacc",   "generic", p7KB_GFWD | p7KB_GBCK | p7KB_GPP,  k_goptacc   },
+};
+static int nkernels = sizeof(kernels) / sizeof(KERNEL);
+
+static ESL_OPTIONS options[] = {
+  /* name           type         default   env  range   toggles reqs incomp  help                                                 docgroup*/
+  { "-h",        eslARG_NONE,      FALSE,   NULL, NULL,    NULL,  NULL, NULL,    "show brief help on version and usage",                        0 },
+  { "-s",        eslARG_INT,        "42",   NULL, NULL,    NULL,  NULL, NULL,    "set random number seed to <n>",                               0 },
+  { "-L",        eslARG_STRING, "100,400,1000", NULL, NULL, NULL, NULL, NULL,    "comma-separated list of target lengths",                      0 },
+  { "-M",        eslARG_STRING, "50,200,800",   NULL, NULL, NULL, NULL, NULL,    "comma-separated sizes of sampled models; 0 = none",           0 },
+  { "--dna",     eslARG_NONE,      FALSE,   NULL, NULL,    NULL,  NULL, NULL,    "sample DNA models, not protein (if no <hmmfile>s)",           0 },
+  { "--mcells",  eslARG_REAL,       "20",   NULL, "x>0",   NULL,  NULL, NULL,    "DP cells per measurement, in millions",                       0 },
+  { "--pool",    eslARG_INT,       "100",   NULL, "n>0",   NULL,  NULL, NULL,    "number of random targets to cycle through",                   0 },
+  { "--kernels", eslARG_STRING,     NULL,   NULL, NULL,    NULL,  NULL, NULL,    "only run comma-separated list of kernels <s>",                0 },
+  { "--json",    eslARG_OUTFILE,    NULL,   NULL, NULL,    NULL,  NULL, NULL,    "save results as JSON to file <f> ('-' for stdout)",           0 },
+  { "--tag",     eslARG_STRING,     NULL,   NULL, NULL,    NULL,  NULL, NULL,    "label results with <s> (e.g. build or CPU type), in JSON",    0 },
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+static char usage[]  = "[-options] [<hmmfile>...]";
+static char banner[] = "speed benchmark for all DP kernels";
+
+/* parse_intlist()
+ * Parse a comma-separated list of nonnegative integers <s> into a
+ * newly allocated array <*ret_v> of length <*ret_n>.
+ */
+static void
+parse_intlist(const char *s, int **ret_v, int *ret_n)
+{
+  char *buf = NULL;
+  char *p;
+  char *tok;
+  int  *v   = NULL;
+  int   n   = 0;
+
+  if (esl_strdup(s, -1, &buf) != eslOK) p7_Fail("allocation failed");
+  if ((v = malloc(sizeof(int) * (strlen(s) + 1))) == NULL) p7_Fail("allocation failed");
+  p = buf;
+  while (esl_strtok(&p, ",", &tok) == eslOK)
+    {
+      if (! esl_str_IsInteger(tok) || atoi(tok) < 0) p7_Fail("%s: not a list of nonnegative integers", s);
+      if (atoi(tok) > 0) v[n++] = atoi(tok);
+    }
+  free(buf);
+  *ret_v = v;
+  *ret_n = n;
+}
+
+/* kernel_selected()
+ * TRUE if kernel <name> is in comma-separated list <list>, or <list> is NULL.
+ */
+static int
+kernel_selected(const char *list, const char *name)
+{
+  const char *p;
+  int         n = strlen(name);
+
+  if (list == NULL) return TRUE;
+  for (p = list; (p = strstr(p, name)) != NULL; p += n)
+    if ((p == list || p[-1] == ',') && (p[n] == ',' || p[n] == '\0')) return TRUE;
+  return FALSE;
+}
+
+static void
+json_string(FILE *fp, const char *s)
+{
+  fputc('"', fp);
+  for (; *s; s++)
+    {
+      if (*s == '"' || *s == '\\') fputc('\\', fp);
+      if ((unsigned char) *s >= 0x20) fputc(*s, fp);
+    }
+  fputc('"', fp);
+}
+
+static KBENCH *
+kbench_Create(ESL_RANDOMNESS *r, P7_HMM *hmm, int L, int npool)
+{
+  KBENCH *kb = malloc(sizeof(KBENCH));
+  int     i;
+
+  if (kb == NULL) p7_Fail("allocation failed");
+  kb->L     = L;
+  kb->npool = npool;
+  kb->bg    = p7_bg_Create(hmm->abc);              p7_bg_SetLength(kb->bg, L);
+  kb->gm    = p7_profile_Create(hmm->M, hmm->abc); p7_ProfileConfig(hmm, kb->bg, kb->gm, L, p7_LOCAL);
+  kb->om    = p7_oprofile_Create(hmm->M, hmm->abc); p7_oprofile_Convert(kb->gm, kb->om);
+  p7_oprofile_ReconfigLength(kb->om, L);
+
+  kb->ox    = p7_omx_Create(hmm->M, 0, 0);
+  kb->fwdp  = p7_omx_Create(hmm->M, 0, L);
+  kb->bckp  = p7_omx_Create(hmm->M, 0, L);
+  kb->fwd   = p7_omx_Create(hmm->M, L, L);
+  kb->bck   = p7_omx_Create(hmm->M, L, L);
+  kb->pp    = p7_omx_Create(hmm->M, L, L);
+  kb->gx    = p7_gmx_Create(hmm->M, L);
+  kb->gfwd  = p7_gmx_Create(hmm->M, L);
+  kb->gbck  = p7_gmx_Create(hmm->M, L);
+  kb->gpp   = p7_gmx_Create(hmm->M, L);
+  kb->null2 = malloc(sizeof(float)     * hmm->abc->Kp);
+  kb->dsq   = malloc(sizeof(ESL_DSQ *) * npool);
+  if (kb->null2 == NULL || kb->dsq == NULL) p7_Fail("allocation failed");
+  if (kb->ox == NULL || kb->fwdp == NULL || kb->bckp == NULL || kb->fwd == NULL || kb->bck == NULL || kb->pp == NULL ||
+      kb->gx == NULL || kb->gfwd == NULL || kb->gbck == NULL || kb->gpp == NULL)
+    p7_Fail("DP matrix allocation failed, for M=%d, L=%d", hmm->M, L);
+
+  for (i = 0; i < npool; i++)
+    {
+      if ((kb->dsq[i] = malloc(sizeof(ESL_DSQ) * (L+2))) == NULL) p7_Fail("allocation failed");
+      esl_rsq_xfIID(r, kb->bg->f, hmm->abc->K, L, kb->dsq[i]);
+    }
+  return kb;
+}
+
+static void
+kbench_Destroy(KBENCH *kb)
+{
+  int i;
+
+  for (i = 0; i < kb->npool; i++) free(kb->dsq[i]);
+  free(kb->dsq);
+  free(kb->null2);
+  p7_gmx_Destroy(kb->gpp);
+  p7_gmx_Destroy(kb->gbck);
+  p7_gmx_Destroy(kb->gfwd);
+  p7_gmx_Destroy(kb->gx);
+  p7_omx_Destroy(kb->pp);
+  p7_omx_Destroy(kb->bck);
+  p7_omx_Destroy(kb->fwd);
+  p7_omx_Destroy(kb->bckp);
+  p7_omx_Destroy(kb->fwdp);
+  p7_omx_Destroy(kb->ox);
+  p7_oprofile_Destroy(kb->om);
+  p7_profile_Destroy(kb->gm);
+  p7_bg_Destroy(kb->bg);
+  free(kb);
+}
+
+/* kbench_Prep()
+ * Calculate the untimed inputs that a kernel needs, for target 0.
+ */
+static void
+kbench_Prep(KBENCH *kb, int prep)
+{
+  float sc;
+
+  if (prep & p7KB_PARSE) p7_ForwardParser(kb->dsq[0], kb->L, kb->om, kb->fwdp,          &sc);
+  if (prep & p7KB_FWD)   p7_Forward      (kb->dsq[0], kb->L, kb->om, kb->fwd,           &sc);
+  if (prep & p7KB_BCK)   p7_Backward     (kb->dsq[0], kb->L, kb->om, kb->fwd, kb->bck,  &sc);
+  if (prep & p7KB_PP)    p7_Decoding     (kb->om, kb->fwd, kb->bck, kb->pp);
+  if (prep & p7KB_GFWD)  p7_GForward     (kb->dsq[0], kb->L, kb->gm, kb->gfwd,          &sc);
+  if (prep & p7KB_GBCK)  p7_GBackward    (kb->dsq[0], kb->L, kb->gm, kb->gbck,          &sc);
+  if (prep & p7KB_GPP)   p7_GDecoding    (kb->gm, kb->gfwd, kb->gbck, kb->gpp);
+}
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go       = esl_getopts_Create(options);
+  ESL_RANDOMNESS *r        = NULL;
+  ESL_STOPWATCH  *w        = esl_stopwatch_Create();
+  ESL_ALPHABET   *abc      = NULL;
+  P7_HMMFILE     *hfp      = NULL;
+  P7_HMM        **hmm      = NULL;
+  KBENCH         *kb       = NULL;
+  FILE           *jfp      = NULL;
+  char           *kernlist = NULL;
+  int            *Lv       = NULL;
+  int            *Mv       = NULL;
+  int             nL, nM;
+  int             nhmm     = 0;
+  int             nalloc   = 0;
+  double          mcells;
+  double          Mcs;
+  int             npool;
+  int             nresults = 0;
+  int             a, h, j, k, i, N;
+  char            name[32];
+  int             status;
+
+  if (esl_opt_ProcessCmdline(go, argc, argv) != eslOK ||
+      esl_opt_VerifyConfig(go)               != eslOK)
+    {
+      printf("Failed to parse command line: %s\n", go->errbuf);
+      esl_usage(stdout, argv[0], usage);
+      printf("\nTo see more help on available options, do %s -h\n\n", argv[0]);
+      exit(1);
+    }
+  if (esl_opt_GetBoolean(go, "-h"))
+    {
+      p7_banner(stdout, argv[0], banner);
+      esl_usage(stdout, argv[0], usage);
+      puts("\nOptions:");
+      esl_opt_DisplayHelp(stdout, go, 0, 2, 80);
+      exit(0);
+    }
+
+  r        = esl_randomness_CreateFast(esl_opt_GetInteger(go, "-s"));
+  mcells   = esl_opt_GetReal   (go, "--mcells");
+  npool    = esl_opt_GetInteger(go, "--pool");
+  kernlist = esl_opt_GetString (go, "--kernels");
+  parse_intlist(esl_opt_GetString(go, "-L"), &Lv, &nL);
+  parse_intlist(esl_opt_GetString(go, "-M"), &Mv, &nM);
+  if (nL == 0) p7_Fail("-L needs at least one target length");
+
+  /* The model set: every model in each <hmmfile>, then the sampled ones. */
+  for (a = 1; a <= esl_opt_ArgNumber(go); a++)
+    {
+      if (p7_hmmfile_OpenE(esl_opt_GetArg(go, a), NULL, &hfp, NULL) != eslOK) p7_Fail("Failed to open HMM file %s", esl_opt_GetArg(go, a));
+      while (1)
+	{
+	  if (nhmm == nalloc) {
+	    nalloc += 16;
+	    if ((hmm = realloc(hmm, sizeof(P7_HMM *) * nalloc)) == NULL) p7_Fail("allocation failed");
+	  }
+	  status = p7_hmmfile_Read(hfp, &abc, &hmm[nhmm]);
+	  if      (status == eslEOF)       break;
+	  else if (status == eslEINCOMPAT) p7_Fail("HMM file %s has a different alphabet than the ones before it", esl_opt_GetArg(go, a));
+	  else if (status != eslOK)        p7_Fail("Failed to read HMM from %s", esl_opt_GetArg(go, a));
+	  nhmm++;
+	}
+      p7_hmmfile_Close(hfp);
+    }
+  if (abc == NULL) abc = esl_alphabet_Create(esl_opt_GetBoolean(go, "--dna") ? eslDNA : eslAMINO);
+
+  if ((hmm = realloc(hmm, sizeof(P7_HMM *) * (nhmm + nM + 1))) == NULL) p7_Fail("allocation failed");
+  for (j = 0; j < nM; j++)
+    {
+      if (p7_hmm_Sample(r, Mv[j], abc, &hmm[nhmm]) != eslOK) p7_Fail("failed to sample an HMM");
+      snprintf(name, 32, "sampled-%d", Mv[j]);
+      p7_hmm_SetName(hmm[nhmm], name);
+      nhmm++;
+    }
+  if (nhmm == 0) p7_Fail("no models to benchmark: give <hmmfile>s, or sizes with -M");
+
+  if (esl_opt_IsOn(go, "--json"))
+    {
+      if (strcmp(esl_opt_GetString(go, "--json"), "-") == 0) jfp = stdout;
+      else if ((jfp = fopen(esl_opt_GetString(go, "--json"), "w")) == NULL) p7_Fail("Failed to open JSON output file %s", esl_opt_GetString(go, "--json"));
+
+      fprintf(jfp, "{\n");
+      fprintf(jfp, "  \"benchmark\": \"kernels\",\n");
+      fprintf(jfp, "  \"version\": ");   json_string(jfp, HMMER_VERSION);                                                      fprintf(jfp, ",\n");
+      fprintf(jfp, "  \"simd\": ");      json_string(jfp, p7KB_IMPL);                                                          fprintf(jfp, ",\n");
+      fprintf(jfp, "  \"tag\": ");       json_string(jfp, esl_opt_IsOn(go, "--tag") ? esl_opt_GetString(go, "--tag") : "");   fprintf(jfp, ",\n");
+      fprintf(jfp, "  \"seed\": %d,\n",    esl_opt_GetInteger(go, "-s"));
+      fprintf(jfp, "  \"mcells\": %g,\n",  mcells);
+      fprintf(jfp, "  \"results\": [");
+    }
+  if (jfp != stdout)
+    {
+      printf("# %-10s %-8s %-20s %6s %6s %8s %10s %10s\n", "kernel", "impl", "model", "M", "L", "N", "CPU (s)", "Mc/s");
+      printf("# %-10s %-8s %-20s %6s %6s %8s %10s %10s\n", "----------", "--------", "--------------------", "------", "------", "--------", "----------", "----------");
+    }
+
+  for (h = 0; h < nhmm; h++)
+    for (j = 0; j < nL; j++)
+      {
+	kb = kbench_Create(r, hmm[h], Lv[j], npool);
+	N  = ESL_MAX(1, (int) (mcells * 1e6 / ((double) hmm[h]->M * (double) Lv[j]) + 0.5));
+
+	for (k = 0; k < nkernels; k++)
+	  {
+	    if (! kernel_selected(kernlist, kernels[k].name)) continue;
+	    kbench_Prep(kb, kernels[k].prep);
+
+	    esl_stopwatch_Start(w);
+	    for (i = 0; i < N; i++)   /* a prepped kernel reruns on the seq its inputs came from */
+	      (*kernels[k].run)(kb, kb->dsq[kernels[k].prep ? 0 : i % npool]);
+	    esl_stopwatch_Stop(w);
+
+	    Mcs = (w->user > 0. ? (double) N * (double) Lv[j] * (double) hmm[h]->M * 1e-6 / w->user : 0.);
+
+	    if (jfp != stdout)
+	      printf("  %-10s %-8s %-20s %6d %6d %8d %10.3f %10.1f\n",
+		     kernels[k].name, kernels[k].impl, hmm[h]->name, hmm[h]->M, Lv[j], N, w->user, Mcs);
+	    if (jfp != NULL)
+	      {
+		fprintf(jfp, "%s\n    { \"kernel\": ", nresults ? "," : "");
+		json_string(jfp, kernels[k].name);
+		fprintf(jfp, ", \"impl\": ");
+		json_string(jfp, kernels[k].impl);
+		fprintf(jfp, ", \"model\": ");
+		json_string(jfp, hmm[h]->name);
+		fprintf(jfp, ", \"M\": %d, \"L\": %d, \"N\": %d, \"cpu\": %.4f, \"elapsed\": %.4f, \"mcells_per_sec\": %.2f }",
+			hmm[h]->M, Lv[j], N, w->user, w->elapsed, Mcs);
+	      }
+	    nresults++;
+	  }
+	kbench_Destroy(kb);
+      }
+
+  if (jfp != NULL)
+    {
+      fprintf(jfp, "\n  ]\n}\n");
+      if (jfp != stdout) fclose(jfp);
+    }
+
+  for (h = 0; h < nhmm; h++) p7_hmm_Destroy(hmm[h]);
+  free(hmm);
+  free(Lv);
+  free(Mv);
+  esl_alphabet_Destroy(abc);
+  esl_stopwatch_Destroy(w);
+  esl_randomness_Destroy(r);
+  esl_getopts_Destroy(go);
+  return 0;
+}
+#endif /*p7KERNELS_BENCHMARK*/
+/*-------------------- end, benchmark driver --------------------*/
@@ -15,6 +15,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
+#include <limits.h>
 
 #include "mpi.h"
 
@@ -24,18 +26,6 @@
 
 #include "hmmer.h"
 
-static int p7_hit_MPISend(P7_HIT *hit, int dest, int tag, MPI_Comm comm, char **buf, int *nalloc);
-static int p7_hit_MPIPackSize(P7_HIT *hit, MPI_Comm comm, int *ret_n);
-static int p7_hit_MPIPack(P7_HIT *hit, char *buf, int n, int *pos, MPI_Comm comm);
-static int p7_hit_MPIUnpack(char *buf, int n, int *pos, MPI_Comm comm, P7_HIT *hit);
-static int p7_hit_MPIRecv(int source, int tag, MPI_Comm comm, char **buf, int *nalloc, P7_HIT *hit);
-
-static int p7_dcl_MPISend(P7_DOMAIN *dcl, int dest, int tag, MPI_Comm comm, char **buf, int *nalloc);
-static int p7_dcl_MPIPackSize(P7_DOMAIN *dcl, MPI_Comm comm, int *ret_n);
-static int p7_dcl_MPIPack(P7_DOMAIN *dcl, char *buf, int n, int *pos, MPI_Comm comm);
-static int p7_dcl_MPIUnpack(char *buf, int n, int *pos, MPI_Comm comm, P7_DOMAIN *dcl);
-static int p7_dcl_MPIRecv(int source, int tag, MPI_Comm comm, char **buf, int *nalloc, P7_DOMAIN *dcl);
-
 /*****************************************************************
  * 1. Communicating P7_HMM, a core model.
  *****************************************************************/
@@ -133,7 +123,7 @@ p7_hmm_MPIPackSize(P7_HMM *hmm, MPI_Comm comm, int *ret_n)
   int   M = hmm->M;
   int   sz;
 
-  if (MPI_Pack_size(1,         MPI_INT, comm, &sz) != 0) ESL_XEXCEPTION(eslESYS, "pack size failed");   n += 6*sz; /* M,flags,nseq,eff_nseq,checksum,alphatype */ 
+  if (MPI_Pack_size(1,         MPI_INT, comm, &sz) != 0) ESL_XEXCEPTION(eslESYS, "pack size failed");   n += 7*sz; /* M,flags,nseq,eff_nseq,checksum,max_length,alphatype */ 
   if (MPI_Pack_size(1,       MPI_FLOAT, comm, &sz) != 0) ESL_XEXCEPTION(eslESYS, "pack size failed");   n += 6*sz; /* ga,tc,nc cutoffs */
   if (MPI_Pack_size(7*(M+1), MPI_FLOAT, comm, &sz) != 0) ESL_XEXCEPTION(eslESYS, "pack size failed");   n +=   sz; /* t */
   if (MPI_Pack_size(K*(M+1), MPI_FLOAT, comm, &sz) != 0) ESL_XEXCEPTION(eslESYS, "pack size failed");   n += 2*sz; /* mat,ins */
@@ -214,6 +204,7 @@ p7_hmm_MPIPack(P7_HMM *hmm, char *buf, int n, int *pos, MPI_Comm comm)
   if ((status = esl_mpi_PackOpt(            hmm->ctime,       -1,      MPI_CHAR,  buf, n, pos, comm)) != eslOK) return status;
   if (hmm->flags & p7H_MAP)  { if (MPI_Pack(hmm->map,        M+1,      MPI_INT,   buf, n, pos, comm)  != 0)     ESL_EXCEPTION(eslESYS, "pack failed"); }
   if (MPI_Pack(                             &(hmm->checksum),  1,      MPI_INT,   buf, n, pos, comm)  != 0)     ESL_EXCEPTION(eslESYS, "pack failed"); 
+  if (MPI_Pack(                             &(hmm->max_length),1,      MPI_INT,   buf, n, pos, comm)  != 0)     ESL_EXCEPTION(eslESYS, "pack failed"); 
   if (MPI_Pack(                             hmm->evparam, p7_NEVPARAM, MPI_FLOAT, buf, n, pos, comm)  != 0)     ESL_EXCEPTION(eslESYS, "pack failed"); 
   if (MPI_Pack(                             hmm->cutoff,  p7_NCUTOFFS, MPI_FLOAT, buf, n, pos, comm)  != 0)     ESL_EXCEPTION(eslESYS, "pack failed"); 
   if (MPI_Pack(                             hmm->compo,   p7_MAXABET,  MPI_FLOAT, buf, n, pos, comm)  != 0)     ESL_EXCEPTION(eslESYS, "pack failed"); 
@@ -304,6 +295,7 @@ p7_hmm_MPIUnpack(char *buf, int n, int *pos, MPI_Comm comm, ESL_ALPHABET **abc,
   if ((status = esl_mpi_UnpackOpt(             buf, n, pos,  (void**)&(hmm->ctime),        NULL, MPI_CHAR,  comm)) != eslOK) goto ERROR;
   if (hmm->flags & p7H_MAP)   { if (MPI_Unpack(buf, n, pos,               hmm->map,         M+1, MPI_INT,   comm)  != 0)     ESL_XEXCEPTION(eslESYS, "mpi unpack failed"); }
   if (MPI_Unpack(                              buf, n, pos,       &(hmm->checksum),           1, MPI_INT,   comm)  != 0)     ESL_XEXCEPTION(eslESYS, "mpi unpack failed"); 
+  if (MPI_Unpack(                              buf, n, pos,     &(hmm->max_length),           1, MPI_INT,   comm)  != 0)     ESL_XEXCEPTION(eslESYS, "mpi unpack failed"); 
   if (MPI_Unpack(                              buf, n, pos,           hmm->evparam, p7_NEVPARAM, MPI_FLOAT, comm)  != 0)     ESL_XEXCEPTION(eslESYS, "mpi unpack failed"); 
   if (MPI_Unpack(                              buf, n, pos,            hmm->cutoff, p7_NCUTOFFS, MPI_FLOAT, comm)  != 0)     ESL_XEXCEPTION(eslESYS, "mpi unpack failed"); 
   if (MPI_Unpack(                              buf, n, pos,             hmm->compo,  p7_MAXABET, MPI_FLOAT, comm)  != 0)     ESL_XEXCEPTION(eslESYS, "mpi unpack failed"); 
@@ -696,7 +688,10 @@ p7_pipeline_MPISend(P7_PIPELINE *pli, int dest, int tag, MPI_Comm comm, char **b
   if (MPI_Pack_size(1, MPI_LONG_LONG_INT, comm, &sz) != 0) ESL_XEXCEPTION(eslESYS, "pack size failed");  n += sz;
   if (MPI_Pack_size(1, MPI_LONG_LONG_INT, comm, &sz) != 0) ESL_XEXCEPTION(eslESYS, "pack size failed");  n += sz;
   if (MPI_Pack_size(1, MPI_LONG_LONG_INT, comm, &sz) != 0) ESL_XEXCEPTION(eslESYS, "pack size failed");  n += sz;
+  if (MPI_Pack_size(4, MPI_LONG_LONG_INT, comm, &sz) != 0) ESL_XEXCEPTION(eslESYS, "pack size failed");  n += sz; /* pos_past_* (nhmmer) */
   if (MPI_Pack_size(1, MPI_DOUBLE,        comm, &sz) != 0) ESL_XEXCEPTION(eslESYS, "pack size failed");  n += sz;
+  if (MPI_Pack_size(p7_NSTAGES, MPI_LONG_LONG_INT, comm, &sz) != 0) ESL_XEXCEPTION(eslESYS, "pack size failed");  n += sz; /* stats.ns[]    */
+  if (MPI_Pack_size(p7_NSTAGES, MPI_LONG_LONG_INT, comm, &sz) != 0) ESL_XEXCEPTION(eslESYS, "pack size failed");  n += sz; /* stats.cells[] */
   
   /* Make sure the buffer is allocated appropriately */
   if (*buf == NULL || n > *nalloc) {
@@ -718,7 +713,12 @@ p7_pipeline_MPISend(P7_PIPELINE *pli, int dest, int tag, MPI_Comm comm, char **b
       bogus.n_past_bias = 0;
       bogus.n_past_vit  = 0;
       bogus.n_past_fwd  = 0;
+      bogus.pos_past_msv  = 0;
+      bogus.pos_past_bias = 0;
+      bogus.pos_past_vit  = 0;
+      bogus.pos_past_fwd  = 0;
       bogus.Z           = 0.0;
+      p7_stagestats_Zero(&(bogus.stats));
       pli = &bogus;
    } 
 
@@ -734,7 +734,13 @@ p7_pipeline_MPISend(P7_PIPELINE *pli, int dest, int tag, MPI_Comm comm, char **b
   if (MPI_Pack(&pli->n_past_bias, 1, MPI_LONG_LONG_INT, *buf, n, &pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed"); 
   if (MPI_Pack(&pli->n_past_vit,  1, MPI_LONG_LONG_INT, *buf, n, &pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed"); 
   if (MPI_Pack(&pli->n_past_fwd,  1, MPI_LONG_LONG_INT, *buf, n, &pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed"); 
+  if (MPI_Pack(&pli->pos_past_msv,  1, MPI_LONG_LONG_INT, *buf, n, &pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed"); 
+  if (MPI_Pack(&pli->pos_past_bias, 1, MPI_LONG_LONG_INT, *buf, n, &pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed"); 
+  if (MPI_Pack(&pli->pos_past_vit,  1, MPI_LONG_LONG_INT, *buf, n, &pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed"); 
+  if (MPI_Pack(&pli->pos_past_fwd,  1, MPI_LONG_LONG_INT, *buf, n, &pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed"); 
   if (MPI_Pack(&pli->Z,           1, MPI_DOUBLE,        *buf, n, &pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed"); 
+  if (MPI_Pack(pli->stats.ns,    p7_NSTAGES, MPI_LONG_LONG_INT, *buf, n, &pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed"); 
+  if (MPI_Pack(pli->stats.cells, p7_NSTAGES, MPI_LONG_LONG_INT, *buf, n, &pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed"); 
 
   /* Send the packed pipeline to destination  */
   MPI_Send(*buf, n, MPI_PACKED, dest, tag, comm);
@@ -804,7 +810,13 @@ p7_pipeline_MPIRecv(int source, int tag, MPI_Comm comm, char **buf, int *nalloc,
   if (MPI_Unpack(*buf, n, &pos, &(pli->n_past_bias), 1, MPI_LONG_LONG_INT, comm) != 0) ESL_XEXCEPTION(eslESYS, "unpack failed"); 
   if (MPI_Unpack(*buf, n, &pos, &(pli->n_past_vit),  1, MPI_LONG_LONG_INT, comm) != 0) ESL_XEXCEPTION(eslESYS, "unpack failed"); 
   if (MPI_Unpack(*buf, n, &pos, &(pli->n_past_fwd),  1, MPI_LONG_LONG_INT, comm) != 0) ESL_XEXCEPTION(eslESYS, "unpack failed"); 
+  if (MPI_Unpack(*buf, n, &pos, &(pli->pos_past_msv),  1, MPI_LONG_LONG_INT, comm) != 0) ESL_XEXCEPTION(eslESYS, "unpack failed"); 
+  if (MPI_Unpack(*buf, n, &pos, &(pli->pos_past_bias), 1, MPI_LONG_LONG_INT, comm) != 0) ESL_XEXCEPTION(eslESYS, "unpack failed"); 
+  if (MPI_Unpack(*buf, n, &pos, &(pli->pos_past_vit),  1, MPI_LONG_LONG_INT, comm) != 0) ESL_XEXCEPTION(eslESYS, "unpack failed"); 
+  if (MPI_Unpack(*buf, n, &pos, &(pli->pos_past_fwd),  1, MPI_LONG_LONG_INT, comm) != 0) ESL_XEXCEPTION(eslESYS, "unpack failed"); 
   if (MPI_Unpack(*buf, n, &pos, &(pli->Z),           1, MPI_DOUBLE,        comm) != 0) ESL_XEXCEPTION(eslESYS, "unpack failed"); 
+  if (MPI_Unpack(*buf, n, &pos, pli->stats.ns,    p7_NSTAGES, MPI_LONG_LONG_INT, comm) != 0) ESL_XEXCEPTION(eslESYS, "unpack failed"); 
+  if (MPI_Unpack(*buf, n, &pos, pli->stats.cells, p7_NSTAGES, MPI_LONG_LONG_INT, comm) != 0) ESL_XEXCEPTION(eslESYS, "unpack failed"); 
 
   *ret_pli = pli;
   return eslOK;
@@ -822,6 +834,71 @@ p7_pipeline_MPIRecv(int source, int tag, MPI_Comm comm, char **buf, int *nalloc,
  * 4. Communicating P7_TOPHITS
  *****************************************************************/
 
+/* A P7_TOPHITS travels as one contiguous, relocatable image of raw
+ * bytes, sent with a single MPI_Send():
+ *
+ *     TOPHITS_IMAGE        header: counts, sizes, and a format check
+ *     P7_HIT[N]            hits; name/acc/desc are image offsets, and
+ *                          <offset> is the offset of the hit's domains
+ *     P7_DOMAIN[ndom]      all domains, in hit order; scores_per_pos is
+ *                          an image offset
+ *     P7_ALIDISPLAY[ndom]  one alignment display per domain; mem and
+ *                          the string pointers into it are image offsets
+ *     pool                 strings, alidisplay mem blocks, per-position
+ *                          scores
+ *
+ * Every object starts on an 8-byte boundary, and an offset of 0
+ * means NULL (the header is at 0). This is the same idea as the
+ * hmmpgmd socket protocol, which ships raw P7_HIT structures and
+ * uses <hit->offset> to locate the domains. Raw structures assume
+ * all ranks share a byte order and struct layout; the header
+ * carries enough to detect when they don't.
+ */
+#define p7_TOPHITS_IMAGE_MAGIC  0x50375448   /* "P7TH" */
+#define IMAGE_ALIGN(n)          (((n) + 7) & ~((int64_t) 7))
+#define IMAGE_OFFSET(p)         ((char *) (uintptr_t) (p))
+#define IMAGE_POS(p)            ((int64_t) (uintptr_t) (p))
+
+typedef struct {
+  uint32_t magic;		/* p7_TOPHITS_IMAGE_MAGIC, in sender's byte order */
+  uint32_t hitsz;		/* sizeof(P7_HIT) on the sender                   */
+  uint32_t domsz;		/* sizeof(P7_DOMAIN)                              */
+  uint32_t adsz;		/* sizeof(P7_ALIDISPLAY)                          */
+  uint64_t N;			/* number of hits                                 */
+  uint64_t nreported;
+  uint64_t nincluded;
+  uint64_t ndom;		/* total number of domains over all hits          */
+  int64_t  n;			/* total size of the image, in bytes              */
+} TOPHITS_IMAGE;
+
+/* image_put()
+ * Copy <len> bytes of <src> into the image <img> at <*pos>, advance
+ * <*pos> to the next aligned position, and return the offset the
+ * data were written at; or 0 if <src> is NULL.
+ */
+static int64_t
+image_put(char *img, int64_t *pos, const void *src, int64_t len)
+{
+  int64_t off = *pos;
+
+  if (src == NULL) return 0;
+  memcpy(img + off, src, len);
+  *pos = IMAGE_ALIGN(off + len);
+  return off;
+}
+
+/* image_strdup()
+ * Copy the string at offset <off> in the image into arena <ar>;
+ * <*ret_s> is NULL if <off> is 0.
+ */
+static int
+image_strdup(P7_ARENA *ar, const char *img, int64_t off, char **ret_s)
+{
+  if (off == 0) { *ret_s = NULL; return eslOK; }
+  return p7_arena_Strdup(ar, img + off, -1, ret_s);
+}
+
+
 /* Function:  p7_tophits_MPISend()
  * Synopsis:  Send the TOPHITS as an MPI work unit.
  *
@@ -830,75 +907,123 @@ p7_pipeline_MPIRecv(int source, int tag, MPI_Comm comm, char **buf, int *nalloc,
  *            with MPI tag <tag>, for MPI communicator <comm>, as 
  *            the sole workunit or result. 
  *            
- *            After the TOPHITS <th> information has been sent, send
- *            the each hit as an indepentant message.
+ *            The hits, their domains and alignment displays are
+ *            serialized into a single relocatable image in <*buf>
+ *            and sent as one message of raw bytes. Any alignment
+ *            display in <th> that is not already serialized is
+ *            serialized here (see <p7_alidisplay_Serialize()>).
  *            
  * Returns:   <eslOK> on success; <*buf> may have been reallocated and
  *            <*nalloc> may have been increased.
  * 
  * Throws:    <eslESYS> if an MPI call fails; <eslEMEM> if a malloc/realloc
- *            fails. In either case, <*buf> and <*nalloc> remain valid and useful
- *            memory (though the contents of <*buf> are undefined). 
+ *            fails; <eslERANGE> if the image would exceed the 2GB limit
+ *            of a single MPI message. In any case, <*buf> and <*nalloc>
+ *            remain valid and useful memory (though the contents of
+ *            <*buf> are undefined). 
  */
 int
 p7_tophits_MPISend(P7_TOPHITS *th, int dest, int tag, MPI_Comm comm, char **buf, int *nalloc)
 {
-  int   status;
-  int   sz, n, pos;
-  int   i, j, inx;
-
-  P7_DOMAIN *dcl = NULL;
-  P7_HIT    *hit = NULL;
-
-  n  = 0;
-  sz = 0;
-
-  /* calculate the buffer size needed to hold the largest hit */
-  hit = th->unsrt;
-  for (i = 0; i < th->N; ++i) {
-    for (j = 0; j < th->unsrt[i].ndom; ++j) {
-      if (sz <= hit->dcl[j].ad->memsize) {
-	sz = hit->dcl[j].ad->memsize;
-	dcl = &hit->dcl[j];
-      }
-    }
-    ++hit;
-  }
-
-  if (th->N > 0) {
-    if ((status = p7_hit_MPIPackSize(th->unsrt, comm, &n)) != eslOK) goto ERROR;
-    if (dcl != NULL) {
-      if ((status = p7_dcl_MPIPackSize(dcl, comm, &sz))    != eslOK) goto ERROR;
-      n = (n > sz) ? n : sz;
+  TOPHITS_IMAGE  hdr;
+  P7_HIT        *hit;
+  P7_DOMAIN     *dcl;
+  P7_ALIDISPLAY *ad;
+  P7_HIT        *ihit;
+  P7_DOMAIN     *idcl;
+  P7_ALIDISPLAY *iad;
+  int64_t        hitpos, dompos, adpos, pos;
+  int64_t        memoff;
+  uint64_t       i, k;
+  int            j;
+  int            status;
+
+  /* First pass: size the image. */
+  hdr.ndom = 0;
+  pos      = 0;
+  for (i = 0; i < th->N; i++)
+    {
+      hit = th->unsrt + i;
+      if (hit->name) pos += IMAGE_ALIGN(strlen(hit->name) + 1);
+      if (hit->acc)  pos += IMAGE_ALIGN(strlen(hit->acc)  + 1);
+      if (hit->desc) pos += IMAGE_ALIGN(strlen(hit->desc) + 1);
+      for (j = 0; j < hit->ndom; j++)
+	{
+	  dcl = hit->dcl + j;
+	  if ((status = p7_alidisplay_Serialize(dcl->ad)) != eslOK) return status;
+	  pos += IMAGE_ALIGN(dcl->ad->memsize);
+	  if (dcl->scores_per_pos) pos += IMAGE_ALIGN(sizeof(float) * dcl->ad->N);
+	}
+      hdr.ndom += hit->ndom;
     }
-  }
 
-  if (MPI_Pack_size(3, MPI_LONG_LONG_INT, comm, &sz) != 0) ESL_XEXCEPTION(eslESYS, "pack size failed");
-  n = (n > sz) ? n : sz;
+  hitpos = IMAGE_ALIGN(sizeof(TOPHITS_IMAGE));
+  dompos = hitpos + IMAGE_ALIGN(sizeof(P7_HIT)        * th->N);
+  adpos  = dompos + IMAGE_ALIGN(sizeof(P7_DOMAIN)     * hdr.ndom);
+  pos   += adpos  + IMAGE_ALIGN(sizeof(P7_ALIDISPLAY) * hdr.ndom);
+  if (pos > INT_MAX) ESL_EXCEPTION(eslERANGE, "hit list too large for a single MPI message");
+
+  hdr.magic     = p7_TOPHITS_IMAGE_MAGIC;
+  hdr.hitsz     = sizeof(P7_HIT);
+  hdr.domsz     = sizeof(P7_DOMAIN);
+  hdr.adsz      = sizeof(P7_ALIDISPLAY);
+  hdr.N         = th->N;
+  hdr.nreported = th->nreported;
+  hdr.nincluded = th->nincluded;
+  hdr.n         = pos;
 
   /* Make sure the buffer is allocated appropriately */
-  if (*buf == NULL || n > *nalloc) {
+  if (*buf == NULL || hdr.n > *nalloc) {
     void *tmp;
-    ESL_RALLOC(*buf, tmp, sizeof(char) * n);
-    *nalloc = n; 
+    ESL_RALLOC(*buf, tmp, sizeof(char) * hdr.n);
+    *nalloc = hdr.n; 
   }
 
-  pos = 0;
-  if (MPI_Pack(&th->N,         1, MPI_LONG_LONG_INT, *buf, n, &pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed"); 
-  if (MPI_Pack(&th->nreported, 1, MPI_LONG_LONG_INT, *buf, n, &pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed"); 
-  if (MPI_Pack(&th->nincluded, 1, MPI_LONG_LONG_INT, *buf, n, &pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed"); 
-
-  /* Send the packed tophits information */
-  if (MPI_Send(*buf, n, MPI_PACKED, dest, tag, comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi send failed");
-  if (th->N == 0) return eslOK;
-
-  /* loop through the hit list sending to dest */
-  hit = th->unsrt;
-  for (inx = 0; inx < th->N; ++inx) {
-    if ((status = p7_hit_MPISend(hit, dest, tag, comm, buf, nalloc)) != eslOK) goto ERROR;
-    ++hit;
-  }
+  /* Second pass: lay out the image. The pool starts after the alidisplays. */
+  memcpy(*buf, &hdr, sizeof(TOPHITS_IMAGE));
+  pos  = adpos + IMAGE_ALIGN(sizeof(P7_ALIDISPLAY) * hdr.ndom);
+  ihit = (P7_HIT *)        (*buf + hitpos);
+  idcl = (P7_DOMAIN *)     (*buf + dompos);
+  iad  = (P7_ALIDISPLAY *) (*buf + adpos);
+  for (i = 0, k = 0; i < th->N; i++)
+    {
+      hit = th->unsrt + i;
+      memcpy(ihit + i, hit, sizeof(P7_HIT));
+      ihit[i].name   = IMAGE_OFFSET(image_put(*buf, &pos, hit->name, hit->name ? strlen(hit->name) + 1 : 0));
+      ihit[i].acc    = IMAGE_OFFSET(image_put(*buf, &pos, hit->acc,  hit->acc  ? strlen(hit->acc)  + 1 : 0));
+      ihit[i].desc   = IMAGE_OFFSET(image_put(*buf, &pos, hit->desc, hit->desc ? strlen(hit->desc) + 1 : 0));
+      ihit[i].dcl    = NULL;
+      ihit[i].offset = dompos + sizeof(P7_DOMAIN) * k;
+
+      for (j = 0; j < hit->ndom; j++, k++)
+	{
+	  dcl = hit->dcl + j;
+	  ad  = dcl->ad;
+	  memcpy(idcl + k, dcl, sizeof(P7_DOMAIN));
+	  idcl[k].ad             = NULL; /* alidisplay k goes with domain k */
+	  idcl[k].scores_per_pos = (float *) IMAGE_OFFSET(image_put(*buf, &pos, dcl->scores_per_pos, sizeof(float) * ad->N));
+
+	  memcpy(iad + k, ad, sizeof(P7_ALIDISPLAY));
+	  memoff = image_put(*buf, &pos, ad->mem, ad->memsize);
+	  iad[k].mem     = IMAGE_OFFSET(memoff);
+	  iad[k].rfline  = ad->rfline  ? IMAGE_OFFSET(memoff + (ad->rfline  - ad->mem)) : NULL;
+	  iad[k].mmline  = ad->mmline  ? IMAGE_OFFSET(memoff + (ad->mmline  - ad->mem)) : NULL;
+	  iad[k].csline  = ad->csline  ? IMAGE_OFFSET(memoff + (ad->csline  - ad->mem)) : NULL;
+	  iad[k].model   = ad->model   ? IMAGE_OFFSET(memoff + (ad->model   - ad->mem)) : NULL;
+	  iad[k].mline   = ad->mline   ? IMAGE_OFFSET(memoff + (ad->mline   - ad->mem)) : NULL;
+	  iad[k].aseq    = ad->aseq    ? IMAGE_OFFSET(memoff + (ad->aseq    - ad->mem)) : NULL;
+	  iad[k].ntseq   = ad->ntseq   ? IMAGE_OFFSET(memoff + (ad->ntseq   - ad->mem)) : NULL;
+	  iad[k].ppline  = ad->ppline  ? IMAGE_OFFSET(memoff + (ad->ppline  - ad->mem)) : NULL;
+	  iad[k].hmmname = ad->hmmname ? IMAGE_OFFSET(memoff + (ad->hmmname - ad->mem)) : NULL;
+	  iad[k].hmmacc  = ad->hmmacc  ? IMAGE_OFFSET(memoff + (ad->hmmacc  - ad->mem)) : NULL;
+	  iad[k].hmmdesc = ad->hmmdesc ? IMAGE_OFFSET(memoff + (ad->hmmdesc - ad->mem)) : NULL;
+	  iad[k].sqname  = ad->sqname  ? IMAGE_OFFSET(memoff + (ad->sqname  - ad->mem)) : NULL;
+	  iad[k].sqacc   = ad->sqacc   ? IMAGE_OFFSET(memoff + (ad->sqacc   - ad->mem)) : NULL;
+	  iad[k].sqdesc  = ad->sqdesc  ? IMAGE_OFFSET(memoff + (ad->sqdesc  - ad->mem)) : NULL;
+	}
+    }
 
+  if (MPI_Send(*buf, hdr.n, MPI_BYTE, dest, tag, comm) != 0) ESL_EXCEPTION(eslESYS, "mpi send failed");
   return eslOK;
 
  ERROR:
@@ -908,16 +1033,23 @@ p7_tophits_MPISend(P7_TOPHITS *th, int dest, int tag, MPI_Comm comm, char **buf,
 /* Function:  p7_tophits_MPIRecv()
  * Synopsis:  Receives an TOPHITS as a work unit from an MPI sender.
  *
- * Purpose:   Sends the TOPHITS <th> as a work unit to MPI process
- *            <dest> (where <dest> ranges from 0..<nproc-1>), tagged
- *            with MPI tag <tag>, for MPI communicator <comm>, as 
- *            the sole workunit or result. 
+ * Purpose:   Receive a work unit that consists of a single TOPHITS
+ *            image sent by MPI <source> (<0..nproc-1>, or
+ *            <MPI_ANY_SOURCE>) tagged as <tag> for MPI communicator
+ *            <comm>, and relocate it into a newly allocated
+ *            <*ret_th>.
  *            
- *            After the TOPHITS <th> information has been sent, send
- *            the each hit as an indepentant message.
+ *            The hit array and each hit's domain list are copied
+ *            out of the image with one <memcpy()> apiece; only the
+ *            pointers are rewritten.
  *            
  * Returns:   <eslOK> on success; <*buf> may have been reallocated and
  *            <*nalloc> may have been increased.
+ *            
+ *            Returns <eslFAIL> if the message doesn't come from the
+ *            expected <source> and <tag>; <eslEINCOMPAT> if the image
+ *            was written by a rank with a different byte order or
+ *            struct layout. In either case <*ret_th> is NULL.
  * 
  * Throws:    <eslESYS> if an MPI call fails; <eslEMEM> if a malloc/realloc
  *            fails. In either case, <*buf> and <*nalloc> remain valid and useful
@@ -926,20 +1058,24 @@ p7_tophits_MPISend(P7_TOPHITS *th, int dest, int tag, MPI_Comm comm, char **buf,
 int
 p7_tophits_MPIRecv(int source, int tag, MPI_Comm comm, char **buf, int *nalloc, P7_TOPHITS **ret_th)
 {
-  int         n;
-  int         status;
-  int         pos;
-  P7_TOPHITS *th    = NULL;
-  P7_HIT     *hit   = NULL;
-  MPI_Status  mpistatus;
-
-  uint64_t    nhits;
-  uint64_t    inx;
+  TOPHITS_IMAGE  hdr;
+  P7_TOPHITS    *th    = NULL;
+  P7_HIT        *hit   = NULL;
+  P7_DOMAIN     *dcl   = NULL;
+  P7_ALIDISPLAY *iad   = NULL;
+  char          *mem   = NULL;
+  int64_t        memoff;
+  int64_t        noff, aoff, doff, spos;
+  uint64_t       i, k;
+  int            j;
+  int            n;
+  int            status;
+  MPI_Status     mpistatus;
 
   /* Probe first, because we need to know if our buffer is big enough.
    */
   MPI_Probe(source, tag, comm, &mpistatus);
-  MPI_Get_count(&mpistatus, MPI_PACKED, &n);
+  MPI_Get_count(&mpistatus, MPI_BYTE, &n);
 
   /* make sure we are getting the tag we expect and from whom we expect if from */
   if (tag    != MPI_ANY_TAG    && mpistatus.MPI_TAG    != tag) {
@@ -962,509 +1098,95 @@ p7_tophits_MPIRecv(int source, int tag, MPI_Comm comm, char **buf, int *nalloc,
     *nalloc = n; 
   }
 
-  /* Receive the packed top hits */
-  MPI_Recv(*buf, n, MPI_PACKED, source, tag, comm, &mpistatus);
-
-  /* Unpack it - watching out for the EOD signal of M = -1. */
-  pos = 0;
-  if ((th = p7_tophits_Create()) == NULL) { status = eslEMEM; goto ERROR; }
-  if (MPI_Unpack(*buf, n, &pos, &nhits,         1, MPI_LONG_LONG_INT, comm) != 0) ESL_XEXCEPTION(eslESYS, "unpack failed");
-  if (MPI_Unpack(*buf, n, &pos, &th->nreported, 1, MPI_LONG_LONG_INT, comm) != 0) ESL_XEXCEPTION(eslESYS, "unpack failed");
-  if (MPI_Unpack(*buf, n, &pos, &th->nincluded, 1, MPI_LONG_LONG_INT, comm) != 0) ESL_XEXCEPTION(eslESYS, "unpack failed");
-
-  /* loop through all of the hits sent */
-  for (inx = 0; inx < nhits; ++inx) {
-      if ((status = p7_tophits_CreateNextHit(th, &hit))                  != eslOK) goto ERROR;
-      if ((status = p7_hit_MPIRecv(source, tag, comm, buf, nalloc, hit)) != eslOK) goto ERROR;
-    }
-  *ret_th = th;
-  return eslOK;
-
- ERROR:
-  if (th  != NULL) p7_tophits_Destroy(th);
-  *ret_th = NULL;
-  return status;
-}
-
-
-/* Function:  p7_hit_MPISend()
- */
-int
-p7_hit_MPISend(P7_HIT *hit, int dest, int tag, MPI_Comm comm, char **buf, int *nalloc)
-{
-  int   inx;
-  int   status;
-  int   pos;
-  int   n = *nalloc;
-
-  /* Pack the HIT into the buffer */
-  pos  = 0;
-  if ((status = p7_hit_MPIPack(hit, *buf, n, &pos, comm)) != eslOK) goto ERROR;
-
-  /* Send the packed HIT to the destination. */
-  if (MPI_Send(*buf, n, MPI_PACKED, dest, tag, comm) != 0)  ESL_EXCEPTION(eslESYS, "mpi send failed");
-
-  /* loop through all of the domains */
-  for (inx = 0; inx < hit->ndom; ++inx) {
-    if ((status = p7_dcl_MPISend(hit->dcl + inx, dest, tag, comm, buf, nalloc)) != eslOK) goto ERROR;
-  }
-
-  return eslOK;
+  /* Receive the top hits image */
+  if (MPI_Recv(*buf, n, MPI_BYTE, source, tag, comm, &mpistatus) != 0) ESL_XEXCEPTION(eslESYS, "mpi recv failed");
 
- ERROR:
-  return status;
-}
+  if (n < (int) sizeof(TOPHITS_IMAGE)) { status = eslEINCOMPAT; goto ERROR; }
+  memcpy(&hdr, *buf, sizeof(TOPHITS_IMAGE));
+  if (hdr.magic != p7_TOPHITS_IMAGE_MAGIC ||
+      hdr.hitsz != sizeof(P7_HIT)         ||
+      hdr.domsz != sizeof(P7_DOMAIN)      ||
+      hdr.adsz  != sizeof(P7_ALIDISPLAY)  ||
+      hdr.n     != n)
+    { status = eslEINCOMPAT; goto ERROR; }
 
-/* Function:  p7_hit_MPIRecv()
- */
-int
-p7_hit_MPIRecv(int source, int tag, MPI_Comm comm, char **buf, int *nalloc, P7_HIT *hit)
-{
-  int         n;
-  int         status;
-  int         pos;
-  int         inx;
-  MPI_Status  mpistatus;
-
-  /* Probe first, because we need to know if our buffer is big enough.
-   */
-  MPI_Probe(source, tag, comm, &mpistatus);
-  MPI_Get_count(&mpistatus, MPI_PACKED, &n);
-
-  /* make sure we are getting the tag we expect and from whom we expect if from */
-  if (tag    != MPI_ANY_TAG    && mpistatus.MPI_TAG    != tag) {
-    status = eslFAIL;
-    goto ERROR;
-  }
-  if (source != MPI_ANY_SOURCE && mpistatus.MPI_SOURCE != source) {
-    status = eslFAIL;
-    goto ERROR;
-  }
-
-  /* set the source and tag */
-  tag = mpistatus.MPI_TAG;
-  source = mpistatus.MPI_SOURCE;
-
-  /* Make sure the buffer is allocated appropriately */
-  if (*buf == NULL || n > *nalloc) {
+  if ((th = p7_tophits_Create()) == NULL) { status = eslEMEM; goto ERROR; }
+  if (hdr.N > th->Nalloc) {
     void *tmp;
-    ESL_RALLOC(*buf, tmp, sizeof(char) * n); 
-    *nalloc = n; 
-  }
-
-  /* Receive the packed top hits */
-  MPI_Recv(*buf, n, MPI_PACKED, source, tag, comm, &mpistatus);
-
-  /* Unpack it - watching out for the EOD signal of M = -1. */
-  pos = 0;
-  if ((status = p7_hit_MPIUnpack(*buf, n, &pos, comm, hit)) != eslOK) goto ERROR;
-  ESL_ALLOC(hit->dcl, sizeof(P7_DOMAIN) * hit->ndom);
-
-  /* loop through all of the hits sent */
-  for (inx = 0; inx < hit->ndom; ++inx) {
-     if ((status = p7_dcl_MPIRecv(source, tag, comm, buf, nalloc, hit->dcl + inx)) != eslOK) goto ERROR;
-  }
-  return eslOK;
-
- ERROR:
-  return status;
-}
-
-/* Function:  p7_hit_MPIPackSize()
- * Synopsis:  Calculates size needed to pack a HIT.
- *
- * Purpose:   Calculate an upper bound on the number of bytes
- *            that <p7_hit_MPIPack()> will need to pack an P7_HIT
- *            <hit> in a packed MPI message for MPI communicator
- *            <comm>; return that number of bytes in <*ret_n>.
- *
- * Returns:   <eslOK> on success, and <*ret_n> contains the answer.
- *
- * Throws:    <eslESYS> if an MPI call fails, and <*ret_n> is 0.
- */
-int
-p7_hit_MPIPackSize(P7_HIT *hit, MPI_Comm comm, int *ret_n)
-{
-  int   status;
-  int   n = 0;
-  int   sz;
-
-  /* P7_HIT data */
-  if (MPI_Pack_size(1,            MPI_DOUBLE, comm, &sz) != 0) ESL_XEXCEPTION(eslESYS, "pack size failed"); n += sz;  /* sortkey                 */
-  if (MPI_Pack_size(3,            MPI_FLOAT,  comm, &sz) != 0) ESL_XEXCEPTION(eslESYS, "pack size failed"); n += sz;  /* scores                  */
-  if (MPI_Pack_size(3,            MPI_DOUBLE, comm, &sz) != 0) ESL_XEXCEPTION(eslESYS, "pack size failed"); n += sz;  /* lnP                     */
-  if (MPI_Pack_size(1,            MPI_FLOAT,  comm, &sz) != 0) ESL_XEXCEPTION(eslESYS, "pack size failed"); n += sz;  /* expected                */
-  if (MPI_Pack_size(5,            MPI_INT,    comm, &sz) != 0) ESL_XEXCEPTION(eslESYS, "pack size failed"); n += sz;  /* region, envelopes, ndom */
-  if (MPI_Pack_size(4,            MPI_INT,    comm, &sz) != 0) ESL_XEXCEPTION(eslESYS, "pack size failed"); n += sz;  /* report info             */
-
-  if ((status = esl_mpi_PackOptSize(hit->name, -1, MPI_CHAR, comm, &sz)) != eslOK) goto ERROR; else n += sz;
-  if ((status = esl_mpi_PackOptSize(hit->acc,  -1, MPI_CHAR, comm, &sz)) != eslOK) goto ERROR; else n += sz; 
-  if ((status = esl_mpi_PackOptSize(hit->desc, -1, MPI_CHAR, comm, &sz)) != eslOK) goto ERROR; else n += sz; 
-
-  *ret_n = n;
-  return eslOK;
-
- ERROR:
-  *ret_n = 0;
-  return status;
-
-}
-
-/* Function:  p7_hit_MPIPack()
- * Synopsis:  Packs the HIT into MPI buffer.
- *
- * Purpose:   Packs HIT <hit> into an MPI packed message buffer <buf>
- *            of length <n> bytes, starting at byte position <*position>,
- *            for MPI communicator <comm>.
- *            
- *            The caller must know that <buf>'s allocation of <n>
- *            bytes is large enough to append the packed HIT at
- *            position <*pos>. This typically requires a call to
- *            <p7_hit_MPIPackSize()> first, and reallocation if
- *            needed.
- *            
- * Returns:   <eslOK> on success; <buf> now contains the
- *            packed <hit>, and <*position> is set to the byte
- *            immediately following the last byte of the HIT
- *            in <buf>. 
- *
- * Throws:    <eslESYS> if an MPI call fails; or <eslEMEM> if the
- *            buffer's length <n> was overflowed in trying to pack
- *            <msa> into <buf>. In either case, the state of
- *            <buf> and <*position> is undefined, and both should
- *            be considered to be corrupted.
- */
-int
-p7_hit_MPIPack(P7_HIT *hit, char *buf, int n, int *pos, MPI_Comm comm)
-{
-  int             status;
-
-  if (MPI_Pack(&hit->sortkey,        1, MPI_DOUBLE,   buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed"); 
-  if (MPI_Pack(&hit->score,          1, MPI_FLOAT,    buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed"); 
-  if (MPI_Pack(&hit->pre_score,      1, MPI_FLOAT,    buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed"); 
-  if (MPI_Pack(&hit->sum_score,      1, MPI_FLOAT,    buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed"); 
-  if (MPI_Pack(&hit->lnP,            1, MPI_DOUBLE,   buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed"); 
-  if (MPI_Pack(&hit->pre_lnP,        1, MPI_DOUBLE,   buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed"); 
-  if (MPI_Pack(&hit->sum_lnP,        1, MPI_DOUBLE,   buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed"); 
-  if (MPI_Pack(&hit->nexpected,      1, MPI_FLOAT,    buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed"); 
-  if (MPI_Pack(&hit->nregions,       1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  if (MPI_Pack(&hit->nclustered,     1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  if (MPI_Pack(&hit->noverlaps,      1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  if (MPI_Pack(&hit->nenvelopes,     1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  if (MPI_Pack(&hit->ndom,           1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  if (MPI_Pack(&hit->flags,          1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  if (MPI_Pack(&hit->nreported,      1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  if (MPI_Pack(&hit->nincluded,      1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  if (MPI_Pack(&hit->best_domain,    1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-
-  if ((status = esl_mpi_PackOpt(hit->name,        -1,      MPI_CHAR,  buf, n, pos, comm)) != eslOK) return status;
-  if ((status = esl_mpi_PackOpt(hit->acc,         -1,      MPI_CHAR,  buf, n, pos, comm)) != eslOK) return status; 
-  if ((status = esl_mpi_PackOpt(hit->desc,        -1,      MPI_CHAR,  buf, n, pos, comm)) != eslOK) return status; 
-
-  if (*pos > n) ESL_EXCEPTION(eslEMEM, "buffer overflow");
-  return eslOK;
-  
- ERROR:
-  return status;
-}
-
-/* Function:  p7_hit_MPIUnpack()
- * Synopsis:  Unpacks an HIT from an MPI buffer.
- *
- * Purpose:   Unpack a newly allocated HIT from MPI packed buffer
- *            <buf>, starting from position <*pos>, where the total length
- *            of the buffer in bytes is <n>. 
- *            
- * Returns:   <eslOK> on success. <*pos> is updated to the position of
- *            the next element in <buf> to unpack (if any). <*ret_hit>
- *            contains a newly allocated HIT, which the caller is
- *            responsible for free'ing.
- *            
- * Throws:    <eslESYS> on an MPI call failure. <eslEMEM> on allocation failure.
- *            In either case, <*ret_hit> is <NULL>, and the state of <buf>
- *            and <*pos> is undefined and should be considered to be corrupted.
- */
-int
-p7_hit_MPIUnpack(char *buf, int n, int *pos, MPI_Comm comm, P7_HIT *hit)
-{
-  int  status;
-
-  if (MPI_Unpack(buf, n, pos, &hit->sortkey,     1, MPI_DOUBLE, comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed"); 
-  if (MPI_Unpack(buf, n, pos, &hit->score,       1, MPI_FLOAT,  comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed"); 
-  if (MPI_Unpack(buf, n, pos, &hit->pre_score,   1, MPI_FLOAT,  comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed"); 
-  if (MPI_Unpack(buf, n, pos, &hit->sum_score,   1, MPI_FLOAT,  comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed"); 
-  if (MPI_Unpack(buf, n, pos, &hit->lnP,         1, MPI_DOUBLE, comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed"); 
-  if (MPI_Unpack(buf, n, pos, &hit->pre_lnP,     1, MPI_DOUBLE, comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed"); 
-  if (MPI_Unpack(buf, n, pos, &hit->sum_lnP,     1, MPI_DOUBLE, comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed"); 
-  if (MPI_Unpack(buf, n, pos, &hit->nexpected,   1, MPI_FLOAT,  comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed"); 
-  if (MPI_Unpack(buf, n, pos, &hit->nregions,    1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &hit->nclustered,  1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &hit->noverlaps,   1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &hit->nenvelopes,  1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &hit->ndom,        1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &hit->flags,       1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &hit->nreported,   1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &hit->nincluded,   1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &hit->best_domain, 1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-
-  if ((status = esl_mpi_UnpackOpt(buf, n, pos,   (void**)&(hit->name),        NULL, MPI_CHAR,  comm)) != eslOK) goto ERROR;
-  if ((status = esl_mpi_UnpackOpt(buf, n, pos,   (void**)&(hit->acc),         NULL, MPI_CHAR,  comm)) != eslOK) goto ERROR;
-  if ((status = esl_mpi_UnpackOpt(buf, n, pos,   (void**)&(hit->desc),        NULL, MPI_CHAR,  comm)) != eslOK) goto ERROR;
-
-  return eslOK;
-
- ERROR:
-  return status;
-}
-
-/* Function:  p7_dcl_MPISend()
- */
-int
-p7_dcl_MPISend(P7_DOMAIN *dcl, int dest, int tag, MPI_Comm comm, char **buf, int *nalloc)
-{
-  int   status;
-  int   pos;
-  int   n = *nalloc;
-
-  /* Pack the DOMAIN into the buffer */
-  pos  = 0;
-  if ((status = p7_dcl_MPIPack(dcl, *buf, n, &pos, comm)) != eslOK) goto ERROR;
-
-  /* Send the packed HIT to the destination. */
-  if (MPI_Send(*buf, n, MPI_PACKED, dest, tag, comm) != 0)  ESL_EXCEPTION(eslESYS, "mpi send failed");
-
-  return eslOK;
-
- ERROR:
-  return status;
-}
-
-
-/* Function:  p7_dcl_MPIPackSize()
- */
-int
-p7_dcl_MPIPackSize(P7_DOMAIN *dcl, MPI_Comm comm, int *ret_n)
-{
-  int   status;
-  int   n = 0;
-  int   sz;
-
-  P7_ALIDISPLAY *ad = dcl->ad;
-
-  /* P7_DOMAIN data */
-  if (MPI_Pack_size(4,            MPI_INT,    comm, &sz) != 0) ESL_XEXCEPTION(eslESYS, "pack size failed"); n += sz;  /* alignment info          */
-  if (MPI_Pack_size(5,            MPI_FLOAT,  comm, &sz) != 0) ESL_XEXCEPTION(eslESYS, "pack size failed"); n += sz;  /* score info              */
-  if (MPI_Pack_size(1,            MPI_DOUBLE, comm, &sz) != 0) ESL_XEXCEPTION(eslESYS, "pack size failed"); n += sz;  /* lnP                     */
-  if (MPI_Pack_size(2,            MPI_INT,    comm, &sz) != 0) ESL_XEXCEPTION(eslESYS, "pack size failed"); n += sz;  /* thresholds              */
-
-
-  /* P7_ALIDISPLAY data */
-  if (MPI_Pack_size(17,          MPI_INT,     comm, &sz) != 0) ESL_XEXCEPTION(eslESYS, "pack size failed"); n += sz;  /* offset info             */
-  if (MPI_Pack_size(3,           MPI_LONG,    comm, &sz) != 0) ESL_XEXCEPTION(eslESYS, "pack size failed"); n += sz;  /* sequence info           */
-  if (MPI_Pack_size(1,           MPI_INT,     comm, &sz) != 0) ESL_XEXCEPTION(eslESYS, "pack size failed"); n += sz;  /* string pool size        */
-  if (MPI_Pack_size(ad->memsize, MPI_CHAR,    comm, &sz) != 0) ESL_XEXCEPTION(eslESYS, "pack size failed"); n += sz;  /* string pool             */
-
-  *ret_n = n;
-  return eslOK;
-
- ERROR:
-  *ret_n = 0;
-  return status;
-
-}
-
-/* Function:  p7_dcl_MPIPack()
- */
-int
-p7_dcl_MPIPack(P7_DOMAIN *dcl, char *buf, int n, int *pos, MPI_Comm comm)
-{
-  int             status;
-  int             offset;
-
-  P7_ALIDISPLAY  *ad       = dcl->ad;
-
-  if (MPI_Pack(&dcl->ienv,           1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  if (MPI_Pack(&dcl->jenv,           1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  if (MPI_Pack(&dcl->iali,           1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  if (MPI_Pack(&dcl->jali,           1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  if (MPI_Pack(&dcl->envsc,          1, MPI_FLOAT,    buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  if (MPI_Pack(&dcl->domcorrection,  1, MPI_FLOAT,    buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  if (MPI_Pack(&dcl->dombias,        1, MPI_FLOAT,    buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  if (MPI_Pack(&dcl->oasc,           1, MPI_FLOAT,    buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  if (MPI_Pack(&dcl->bitscore,       1, MPI_FLOAT,    buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  if (MPI_Pack(&dcl->lnP,            1, MPI_DOUBLE,   buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  if (MPI_Pack(&dcl->is_reported,    1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  if (MPI_Pack(&dcl->is_included,    1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-
-  offset = (ad->rfline  == NULL)  ? -1 : ad->rfline - ad->mem;
-  if (MPI_Pack(&offset,              1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  offset = (ad->mmline  == NULL)  ? -1 : ad->mmline - ad->mem;
-  if (MPI_Pack(&offset,              1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  offset = (ad->csline  == NULL)  ? -1 : ad->csline - ad->mem;
-  if (MPI_Pack(&offset,              1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  offset = (ad->model   == NULL)  ? -1 : ad->model - ad->mem;
-  if (MPI_Pack(&offset,              1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  offset = (ad->mline   == NULL)  ? -1 : ad->mline - ad->mem;
-  if (MPI_Pack(&offset,              1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  offset = (ad->aseq    == NULL)     ? -1 : ad->aseq - ad->mem;
-  if (MPI_Pack(&offset,              1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  offset = (ad->ppline  == NULL)  ? -1 : ad->ppline - ad->mem;
-  if (MPI_Pack(&offset,              1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  if (MPI_Pack(&ad->N,               1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  offset = (ad->hmmname == NULL)  ? -1 : ad->hmmname - ad->mem;
-  if (MPI_Pack(&offset,              1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  offset = (ad->hmmacc  == NULL)  ? -1 : ad->hmmacc - ad->mem;
-  if (MPI_Pack(&offset,              1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  offset = (ad->hmmdesc == NULL)  ? -1 : ad->hmmdesc - ad->mem;
-  if (MPI_Pack(&offset,              1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  if (MPI_Pack(&ad->hmmfrom,         1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  if (MPI_Pack(&ad->hmmto,           1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  if (MPI_Pack(&ad->M,               1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  offset = (ad->sqname  == NULL)  ? -1 : ad->sqname - ad->mem;
-  if (MPI_Pack(&offset,              1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  offset = (ad->sqacc   == NULL)  ? -1 : ad->sqacc - ad->mem;
-  if (MPI_Pack(&offset,              1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  offset = (ad->sqdesc  == NULL)  ? -1 : ad->sqdesc - ad->mem;
-  if (MPI_Pack(&offset,              1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  if (MPI_Pack(&ad->sqfrom,          1, MPI_LONG,     buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  if (MPI_Pack(&ad->sqto,            1, MPI_LONG,     buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  if (MPI_Pack(&ad->L,               1, MPI_LONG,     buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  if (MPI_Pack(&ad->memsize,         1, MPI_INT,      buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed");
-  if (MPI_Pack( ad->mem,   ad->memsize, MPI_CHAR,     buf, n, pos, comm) != 0) ESL_XEXCEPTION(eslESYS, "pack failed"); 
-
-  if (*pos > n) ESL_EXCEPTION(eslEMEM, "buffer overflow");
-  return eslOK;
-  
- ERROR:
-  return status;
-}
-
-/* Function:  p7_dcl_MPIUnpack()
- */
-int
-p7_dcl_MPIUnpack(char *buf, int n, int *pos, MPI_Comm comm, P7_DOMAIN *dcl)
-{
-  int  status;
-  int  rfline, mmline, csline, model, mline, aseq, ppline;
-  int  hmmname, hmmacc, hmmdesc;
-  int  sqname, sqacc, sqdesc;
-
-  P7_ALIDISPLAY *ad; 
-
-  ESL_ALLOC(ad, sizeof(P7_ALIDISPLAY));
-
-  if (MPI_Unpack(buf, n, pos, &dcl->ienv,          1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &dcl->jenv,          1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &dcl->iali,          1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &dcl->jali,          1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &dcl->envsc,         1, MPI_FLOAT,  comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &dcl->domcorrection, 1, MPI_FLOAT,  comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &dcl->dombias,       1, MPI_FLOAT,  comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &dcl->oasc,          1, MPI_FLOAT,  comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &dcl->bitscore,      1, MPI_FLOAT,  comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &dcl->lnP,           1, MPI_DOUBLE, comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &dcl->is_reported,   1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &dcl->is_included,   1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &rfline,             1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &mmline,             1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &csline,             1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &model,              1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &mline,              1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &aseq,               1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &ppline,             1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &ad->N,              1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &hmmname,            1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &hmmacc,             1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &hmmdesc,            1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &ad->hmmfrom,        1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &ad->hmmto,          1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &ad->M,              1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &sqname,             1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &sqacc,              1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &sqdesc,             1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &ad->sqfrom,         1, MPI_LONG,   comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &ad->sqto,           1, MPI_LONG,   comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &ad->L,              1, MPI_LONG,   comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-  if (MPI_Unpack(buf, n, pos, &ad->memsize,        1, MPI_INT,    comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed");
-
-  dcl->scores_per_pos = NULL;  /*this field is used for nhmmer, which currently doesn't have MPI support */
-
-  /* allocate the string pools for the alignments */
-  ESL_ALLOC(ad->mem, ad->memsize);
-  if (MPI_Unpack(buf, n, pos,  ad->mem,  ad->memsize, MPI_CHAR,   comm) != 0) ESL_XEXCEPTION(eslESYS, "mpi unpack failed"); 
-
-  ad->rfline  = (rfline == -1)  ? NULL : ad->mem + rfline;
-  ad->mmline  = (mmline == -1)  ? NULL : ad->mem + mmline;
-  ad->csline  = (csline == -1)  ? NULL : ad->mem + csline;
-  ad->model   = (model == -1)   ? NULL : ad->mem + model;
-  ad->mline   = (mline == -1)   ? NULL : ad->mem + mline;
-  ad->aseq    = (aseq == -1)    ? NULL : ad->mem + aseq;
-  ad->ppline  = (ppline == -1)  ? NULL : ad->mem + ppline;
-
-  ad->hmmname = (hmmname == -1) ? NULL : ad->mem + hmmname;
-  ad->hmmacc  = (hmmacc == -1)  ? NULL : ad->mem + hmmacc;
-  ad->hmmdesc = (hmmdesc == -1) ? NULL : ad->mem + hmmdesc;
-
-  ad->sqname  = (sqname == -1)  ? NULL : ad->mem + sqname;
-  ad->sqacc   = (sqacc == -1)   ? NULL : ad->mem + sqacc;
-  ad->sqdesc  = (sqdesc == -1)  ? NULL : ad->mem + sqdesc;
-
-  dcl->ad = ad;
-
-  return eslOK;
-
- ERROR:
-  if (ad  != NULL) {
-    if (ad->mem != NULL) free(ad->mem);
-    free(ad);
+    ESL_RALLOC(th->hit,   tmp, sizeof(P7_HIT *) * hdr.N);
+    ESL_RALLOC(th->unsrt, tmp, sizeof(P7_HIT)   * hdr.N);
+    th->Nalloc = hdr.N;
   }
-  return status;
-}
+  th->nreported = hdr.nreported;
+  th->nincluded = hdr.nincluded;
+  if (hdr.N > 1) th->is_sorted_by_sortkey = FALSE;
 
-/* Function:  p7_dcl_MPIRecv()
- */
-int
-p7_dcl_MPIRecv(int source, int tag, MPI_Comm comm, char **buf, int *nalloc, P7_DOMAIN *dcl)
-{
-  int         status;
-  int         n;
-  int         pos;
-  MPI_Status  mpistatus;
+  /* The alidisplays follow the domains; see the layout above. */
+  iad = (P7_ALIDISPLAY *) (*buf + IMAGE_ALIGN(sizeof(TOPHITS_IMAGE)) + IMAGE_ALIGN(sizeof(P7_HIT) * hdr.N) + IMAGE_ALIGN(sizeof(P7_DOMAIN) * hdr.ndom));
 
-  /* Probe first, because we need to know if our buffer is big enough.
+  /* Relocate one hit at a time, counting it into th->N only once
+   * its pointers are safe for p7_tophits_Destroy() to free.
    */
-  MPI_Probe(source, tag, comm, &mpistatus);
-  MPI_Get_count(&mpistatus, MPI_PACKED, &n);
-
-  /* make sure we are getting the tag we expect and from whom we expect if from */
-  if (tag    != MPI_ANY_TAG    && mpistatus.MPI_TAG    != tag) {
-    status = eslFAIL;
-    goto ERROR;
-  }
-  if (source != MPI_ANY_SOURCE && mpistatus.MPI_SOURCE != source) {
-    status = eslFAIL;
-    goto ERROR;
-  }
-
-  /* set the source and tag */
-  tag = mpistatus.MPI_TAG;
-  source = mpistatus.MPI_SOURCE;
-
-  /* Make sure the buffer is allocated appropriately */
-  if (*buf == NULL || n > *nalloc) {
-    void *tmp;
-    ESL_RALLOC(*buf, tmp, sizeof(char) * n); 
-    *nalloc = n; 
-  }
-
-  /* Receive the packed dcl */
-  MPI_Recv(*buf, n, MPI_PACKED, source, tag, comm, &mpistatus);
+  memcpy(th->unsrt, *buf + IMAGE_ALIGN(sizeof(TOPHITS_IMAGE)), sizeof(P7_HIT) * hdr.N);
+  for (i = 0; i < hdr.N; i++)
+    {
+      hit    = th->unsrt + i;
+      noff   = IMAGE_POS(hit->name);
+      aoff   = IMAGE_POS(hit->acc);
+      doff   = IMAGE_POS(hit->desc);
+      hit->name = hit->acc = hit->desc = NULL;
+      hit->dcl  = NULL;
+      th->N++;
+
+      if ((status = image_strdup(th->arena, *buf, noff, &(hit->name))) != eslOK) goto ERROR;
+      if ((status = image_strdup(th->arena, *buf, aoff, &(hit->acc)))  != eslOK) goto ERROR;
+      if ((status = image_strdup(th->arena, *buf, doff, &(hit->desc))) != eslOK) goto ERROR;
+
+      if (hit->ndom == 0) continue;
+      if ((hit->dcl = p7_arena_Alloc(th->arena, sizeof(P7_DOMAIN) * hit->ndom)) == NULL) { status = eslEMEM; goto ERROR; }
+      memcpy(hit->dcl, *buf + hit->offset, sizeof(P7_DOMAIN) * hit->ndom);
+      for (j = 0; j < hit->ndom; j++) { hit->dcl[j].ad = NULL; hit->dcl[j].scores_per_pos = NULL; hit->dcl[j].envdsq = NULL; }
+
+      k = (hit->offset - IMAGE_ALIGN(sizeof(TOPHITS_IMAGE)) - IMAGE_ALIGN(sizeof(P7_HIT) * hdr.N)) / sizeof(P7_DOMAIN);
+      for (j = 0; j < hit->ndom; j++, k++)
+	{
+	  dcl    = hit->dcl + j;
+	  spos   = IMAGE_POS(((P7_DOMAIN *) (*buf + hit->offset))[j].scores_per_pos);
+	  memoff = IMAGE_POS(iad[k].mem);
+
+	  /* the alidisplay and its mem go into the arena together, as p7_alidisplay_CloneInArena() lays them out */
+	  if ((dcl->ad = p7_arena_Alloc(th->arena, sizeof(P7_ALIDISPLAY) + iad[k].memsize)) == NULL) { status = eslEMEM; goto ERROR; }
+	  memcpy(dcl->ad, iad + k, sizeof(P7_ALIDISPLAY));
+	  mem = (char *) dcl->ad + sizeof(P7_ALIDISPLAY);
+	  memcpy(mem, *buf + memoff, iad[k].memsize);
+	  dcl->ad->mem     = mem;
+	  dcl->ad->rfline  = iad[k].rfline  ? mem + (IMAGE_POS(iad[k].rfline)  - memoff) : NULL;
+	  dcl->ad->mmline  = iad[k].mmline  ? mem + (IMAGE_POS(iad[k].mmline)  - memoff) : NULL;
+	  dcl->ad->csline  = iad[k].csline  ? mem + (IMAGE_POS(iad[k].csline)  - memoff) : NULL;
+	  dcl->ad->model   = iad[k].model   ? mem + (IMAGE_POS(iad[k].model)   - memoff) : NULL;
+	  dcl->ad->mline   = iad[k].mline   ? mem + (IMAGE_POS(iad[k].mline)   - memoff) : NULL;
+	  dcl->ad->aseq    = iad[k].aseq    ? mem + (IMAGE_POS(iad[k].aseq)    - memoff) : NULL;
+	  dcl->ad->ntseq   = iad[k].ntseq   ? mem + (IMAGE_POS(iad[k].ntseq)   - memoff) : NULL;
+	  dcl->ad->ppline  = iad[k].ppline  ? mem + (IMAGE_POS(iad[k].ppline)  - memoff) : NULL;
+	  dcl->ad->hmmname = iad[k].hmmname ? mem + (IMAGE_POS(iad[k].hmmname) - memoff) : NULL;
+	  dcl->ad->hmmacc  = iad[k].hmmacc  ? mem + (IMAGE_POS(iad[k].hmmacc)  - memoff) : NULL;
+	  dcl->ad->hmmdesc = iad[k].hmmdesc ? mem + (IMAGE_POS(iad[k].hmmdesc) - memoff) : NULL;
+	  dcl->ad->sqname  = iad[k].sqname  ? mem + (IMAGE_POS(iad[k].sqname)  - memoff) : NULL;
+	  dcl->ad->sqacc   = iad[k].sqacc   ? mem + (IMAGE_POS(iad[k].sqacc)   - memoff) : NULL;
+	  dcl->ad->sqdesc  = iad[k].sqdesc  ? mem + (IMAGE_POS(iad[k].sqdesc)  - memoff) : NULL;
+	  if (spos) {
+	    if ((dcl->scores_per_pos = p7_arena_Alloc(th->arena, sizeof(float) * dcl->ad->N)) == NULL) { status = eslEMEM; goto ERROR; }
+	    memcpy(dcl->scores_per_pos, *buf + spos, sizeof(float) * dcl->ad->N);
+	  }
+	}
+    }
 
-  /* Unpack it, looking at the status code prefix for EOD/EOK  */
-  pos = 0;
-  return p7_dcl_MPIUnpack(*buf, *nalloc, &pos, comm, dcl);
+  *ret_th = th;
+  return eslOK;
 
  ERROR:
+  if (th  != NULL) p7_tophits_Destroy(th);
+  *ret_th = NULL;
   return status;
 }
 
@@ -1586,6 +1308,8 @@ main(int argc, char **argv)
  *****************************************************************/
 #ifdef p7MPISUPPORT_TESTDRIVE
 
+#include "esl_vectorops.h"
+
 static void
 utest_HMMSendRecv(int my_rank, int nproc)
 {
@@ -1682,6 +1406,102 @@ utest_ProfileSendRecv(int my_rank, int nproc)
 }
 
 
+/* sample_tophits()
+ * Make a small hit list with random alignment displays, for
+ * testing send/recv. Same <r> seed gives the same list.
+ */
+static P7_TOPHITS *
+sample_tophits(ESL_RANDOMNESS *r, int nhits)
+{
+  P7_TOPHITS    *th = p7_tophits_Create();
+  P7_HIT        *hit;
+  P7_ALIDISPLAY *ad;
+  char           name[32];
+  int            i, d;
+
+  for (i = 0; i < nhits; i++)
+    {
+      p7_tophits_CreateNextHit(th, &hit);
+      snprintf(name, 32, "seq%d", i);
+      p7_arena_Strdup(th->arena, name, -1, &(hit->name));
+      if (i % 2) p7_arena_Strdup(th->arena, "acc", -1, &(hit->acc));
+      hit->score  = esl_random(r) * 100.;
+      hit->seqidx = i;
+      hit->ndom   = 1 + esl_rnd_Roll(r, 3);
+      hit->dcl    = p7_arena_Alloc(th->arena, sizeof(P7_DOMAIN) * hit->ndom);
+      for (d = 0; d < hit->ndom; d++)
+	{
+	  hit->dcl[d].ienv           = hit->dcl[d].iali = 1 + esl_rnd_Roll(r, 1000);
+	  hit->dcl[d].jenv           = hit->dcl[d].jali = hit->dcl[d].ienv + 50;
+	  hit->dcl[d].bitscore       = esl_random(r) * 50.;
+	  hit->dcl[d].scores_per_pos = NULL;
+	  hit->dcl[d].envdsq         = NULL;
+	  p7_alidisplay_Sample(r, 50 + esl_rnd_Roll(r, 100), &ad);
+	  hit->dcl[d].ad = p7_alidisplay_CloneInArena(ad, th->arena);  /* the list's arena owns all its hit data */
+	  p7_alidisplay_Destroy(ad);
+	  if (d == 0) {
+	    hit->dcl[d].scores_per_pos = p7_arena_Alloc(th->arena, sizeof(float) * hit->dcl[d].ad->N);
+	    esl_vec_FSet(hit->dcl[d].scores_per_pos, hit->dcl[d].ad->N, 1.0);
+	  }
+	}
+    }
+  return th;
+}
+
+static void
+utest_TophitsSendRecv(int my_rank, int nproc)
+{
+  ESL_RANDOMNESS *r    = esl_randomness_CreateFast(42);
+  P7_TOPHITS     *th   = sample_tophits(r, 100); /* master and worker's sampled lists are identical */
+  P7_TOPHITS     *th2  = NULL;
+  char           *wbuf = NULL;
+  int             wn   = 0;
+  int             i, h, d;
+
+  if (my_rank == 0)
+    {
+      for (i = 1; i < nproc; i++)
+	{
+	  ESL_DPRINTF1(("Master: receiving test hit list\n"));
+	  if (p7_tophits_MPIRecv(MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, &wbuf, &wn, &th2) != eslOK) p7_Die("hit list receive failed");
+	  ESL_DPRINTF1(("Master: test hit list received\n"));
+
+	  if (th2->N != th->N) p7_Die("Received hit list has wrong number of hits");
+	  for (h = 0; h < th->N; h++)
+	    {
+	      if (strcmp(th->unsrt[h].name, th2->unsrt[h].name) != 0)  p7_Die("hit name mismatch");
+	      if (esl_strcmp(th->unsrt[h].acc, th2->unsrt[h].acc) != 0) p7_Die("hit acc mismatch");
+	      if (th2->unsrt[h].desc               != NULL)              p7_Die("hit desc should be NULL");
+	      if (th->unsrt[h].score  != th2->unsrt[h].score)            p7_Die("hit score mismatch");
+	      if (th->unsrt[h].seqidx != th2->unsrt[h].seqidx)           p7_Die("hit seqidx mismatch");
+	      if (th->unsrt[h].ndom   != th2->unsrt[h].ndom)             p7_Die("hit ndom mismatch");
+	      for (d = 0; d < th->unsrt[h].ndom; d++)
+		{
+		  P7_DOMAIN *d1 = th->unsrt[h].dcl  + d;
+		  P7_DOMAIN *d2 = th2->unsrt[h].dcl + d;
+		  if (d1->iali != d2->iali || d1->jali != d2->jali)              p7_Die("domain coords mismatch");
+		  if (d1->bitscore != d2->bitscore)                              p7_Die("domain score mismatch");
+		  if (p7_alidisplay_Compare(d1->ad, d2->ad) != eslOK)            p7_Die("alidisplay mismatch");
+		  if ((d1->scores_per_pos == NULL) != (d2->scores_per_pos == NULL)) p7_Die("scores_per_pos mismatch");
+		  if (d1->scores_per_pos && esl_vec_FCompare(d1->scores_per_pos, d2->scores_per_pos, d1->ad->N, 0.0) != eslOK) p7_Die("scores_per_pos mismatch");
+		}
+	    }
+	  p7_tophits_Destroy(th2);
+	}
+    }
+  else
+    {
+      ESL_DPRINTF1(("Worker %d: sending test hit list\n", my_rank));
+      p7_tophits_MPISend(th, 0, 0, MPI_COMM_WORLD, &wbuf, &wn);
+      ESL_DPRINTF1(("Worker %d: test hit list sent\n", my_rank));
+    }
+
+  free(wbuf);
+  p7_tophits_Destroy(th);
+  esl_randomness_Destroy(r);
+  return;
+}
+
 
 #endif /*p7MPISUPPORT_TESTDRIVE*/
 /*---------------------- end, unit tests ------------------------*/
@@ -1725,6 +1545,7 @@ main(int argc, char **argv)
 
   utest_HMMSendRecv(my_rank, nproc);
   utest_ProfileSendRecv(my_rank, nproc);
+  utest_TophitsSendRecv(my_rank, nproc);
 
   MPI_Finalize();
   return 0;
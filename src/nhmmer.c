@@ -17,7 +17,10 @@
 #include "esl_sqio.h"
 #include "esl_stopwatch.h"
 
-
+#ifdef HMMER_MPI
+#include "mpi.h"
+#include "esl_mpi.h"
+#endif /*HMMER_MPI*/
 
 #ifdef HMMER_THREADS
 #include <unistd.h>
@@ -73,6 +76,36 @@ typedef struct {
 } ID_LENGTH_LIST;
 
 
+#ifdef HMMER_MPI
+/* In MPI mode the master hands target sequences to workers in
+ * blocks; <idx> is the internal ID of the first sequence in the block,
+ * so that hits keep the same seqidx as in a serial search. A block
+ * either holds whole sequences (<start> is 0), or it's one range
+ * <start>..<end> of a sequence of length <L> that's too long to hand
+ * to one worker. Sent as MPI_LONG_LONG_INTs, so all fields are 64 bits.
+ */
+typedef struct {
+  uint64_t  offset;
+  uint64_t  length;
+  uint64_t  count;
+  uint64_t  idx;
+  uint64_t  start;
+  uint64_t  end;
+  uint64_t  L;
+} SEQ_BLOCK;
+
+typedef struct {
+  int             complete;
+  int             size;
+  int             current;
+  int             last;
+  int64_t         nseqs;    /* # of sequences assigned to blocks so far        */
+  SEQ_BLOCK      *blocks;
+  SEQ_BLOCK       split;    /* long sequence being cut into ranges, if count>0 */
+  ID_LENGTH_LIST *lengths;  /* lengths of all sequences in the blocks, by ID   */
+} BLOCK_LIST;
+#endif /*HMMER_MPI*/
+
 static ID_LENGTH_LIST* init_id_length( int size );
 static void            destroy_id_length( ID_LENGTH_LIST *list );
 static int             add_id_length(ID_LENGTH_LIST *list, int id, int L);
@@ -86,8 +119,13 @@ static int             assign_Lengths(P7_TOPHITS *th, ID_LENGTH_LIST *id_length_
 #define QFORMATS     "--qhmm,--qfasta,--qmsa"
 
 
+#if defined (HMMER_THREADS) && defined (HMMER_MPI)
+#define CPUOPTS     "--mpi"
+#define MPIOPTS     "--cpu"
+#else
 #define CPUOPTS     NULL
 #define MPIOPTS     NULL
+#endif
 
 
 static ESL_OPTIONS options[] = {
@@ -98,8 +136,11 @@ static ESL_OPTIONS options[] = {
   { "-A",           eslARG_OUTFILE,      NULL, NULL, NULL,    NULL,  NULL,  NULL,              "save multiple alignment of all hits to file <f>",              2 },
   { "--tblout",     eslARG_OUTFILE,      NULL, NULL, NULL,    NULL,  NULL,  NULL,              "save parseable table of hits to file <f>",                     2 },
   { "--dfamtblout", eslARG_OUTFILE,      NULL, NULL, NULL,    NULL,  NULL,  NULL,              "save table of hits to file, in Dfam format <f>",               2 },
+  { "--hitout",     eslARG_OUTFILE,      NULL, NULL, NULL,    NULL,  NULL,  NULL,              "save hits in compact binary format to file <f>",               2 },
   { "--aliscoresout", eslARG_OUTFILE,    NULL, NULL, NULL,    NULL,  NULL,  NULL,              "save scores for each position in each alignment to <f>",       2 },
   { "--hmmout",     eslARG_OUTFILE,      NULL, NULL, NULL,    NULL,  NULL,  NULL,              "if input is alignment(s), write produced hmms to file <f>",    2 },
+  { "--statsout",   eslARG_OUTFILE,      NULL, NULL, NULL,    NULL,  NULL,  NULL,              "save per-query search statistics as JSON lines to file <f>",   2 },
+  { "--progress",   eslARG_REAL,         NULL, NULL, "x>0",   NULL,"--statsout", NULL,         "add a progress record to --statsout file every <x> seconds",   2 },
   { "--acc",        eslARG_NONE,        FALSE, NULL, NULL,    NULL,  NULL,  NULL,            "prefer accessions over names in output",                       2 },
   { "--noali",      eslARG_NONE,        FALSE, NULL, NULL,    NULL,  NULL,  NULL,            "don't output alignments, so output is smaller",                2 },
   { "--notextw",    eslARG_NONE,         NULL, NULL, NULL,    NULL,  NULL, "--textw",        "unlimit ASCII text output line width",                         2 },
@@ -150,6 +191,8 @@ static ESL_OPTIONS options[] = {
   { "--qformat",    eslARG_STRING,       NULL, NULL, NULL,    NULL,  "--qmsa",       NULL,     "assert query msa <seqfile> is in format <s>",                       12 },
   { "--tformat",    eslARG_STRING,       NULL, NULL, NULL,    NULL,  NULL,           NULL,     "assert target <seqdb> is in format <s>",                        12 },
   { "--nonull2",    eslARG_NONE,         NULL, NULL, NULL,    NULL,  NULL,           NULL,     "turn off biased composition score corrections",                 12 },
+  { "--nosample",   eslARG_NONE,         NULL, NULL, NULL,    NULL,  NULL,           NULL,     "split domains by posterior decoding, not sampling",             12 },
+  { "--stagestats", eslARG_NONE,         NULL, NULL, NULL,    NULL,  NULL,           NULL,     "time each pipeline stage, and count its DP cells",              12 },
   { "-Z",           eslARG_REAL,        FALSE, NULL, "x>0",   NULL,  NULL,           NULL,     "set database size (Megabases) to <x> for E-value calculations", 12 },
   { "--seed",       eslARG_INT,          "42", NULL, "n>=0",  NULL,  NULL,           NULL,     "set RNG seed to <n> (if 0: one-time arbitrary seed)",           12 },
   { "--w_beta",     eslARG_REAL,         NULL, NULL, NULL,    NULL,  NULL,           NULL,     "tail mass at which window length is determined",                12 },
@@ -191,6 +234,10 @@ static ESL_OPTIONS options[] = {
 
 #ifdef HMMER_THREADS 
   { "--cpu",        eslARG_INT, p7_NCPU,"HMMER_NCPU","n>=0",NULL,  NULL,  CPUOPTS,         "number of parallel CPU workers to use for multithreads",      12 },
+#endif
+#ifdef HMMER_MPI
+  { "--stall",      eslARG_NONE,        FALSE, NULL, NULL,    NULL,"--mpi", NULL,            "arrest after start: for debugging MPI under gdb",             12 },
+  { "--mpi",        eslARG_NONE,        FALSE, NULL, NULL,    NULL,  NULL,  MPIOPTS,         "run as an MPI parallel program",                              12 },
 #endif
   {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
 };
@@ -220,14 +267,21 @@ static char banner[] = "search a DNA model, alignment, or sequence against a DNA
 
 
 static int  serial_master  (ESL_GETOPTS *go, struct cfg_s *cfg);
-static int  serial_loop    (WORKER_INFO *info, ID_LENGTH_LIST *id_length_list, ESL_SQFILE *dbfp, char *firstseq_key, int n_targetseqs );
+static int  serial_loop    (WORKER_INFO *info, ID_LENGTH_LIST *id_length_list, ESL_SQFILE *dbfp, int64_t first_seqidx, int n_targetseqs, P7_PROGRESS *prg);
+static void search_window  (WORKER_INFO *info, ESL_SQ *dbsq, ESL_SQ *dbsq_revcmp, int64_t seq_id);
 #if defined (eslENABLE_SSE)
   static int  serial_loop_FM (WORKER_INFO *info, ESL_SQFILE *dbfp);
 #endif
+#ifdef HMMER_MPI
+static int  mpi_loop       (WORKER_INFO *info, ID_LENGTH_LIST *id_length_list, P7_HMM *hmm, ESL_SQFILE *dbfp, BLOCK_LIST *list, struct cfg_s *cfg, ESL_GETOPTS *go, char **mpi_buf, int *mpi_size);
+static int  mpi_terminate  (struct cfg_s *cfg, char **mpi_buf, int *mpi_size);
+static int  mpi_worker     (ESL_GETOPTS *go, struct cfg_s *cfg);
+static int  range_loop     (WORKER_INFO *info, ESL_SQFILE *dbfp, const SEQ_BLOCK *block);
+#endif /*HMMER_MPI*/
 #ifdef HMMER_THREADS
 #define BLOCK_SIZE 1000
 
-static int  thread_loop(WORKER_INFO *info, ID_LENGTH_LIST *id_length_list, ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, char *firstseq_key, int n_targetseqs);
+static int  thread_loop(WORKER_INFO *info, ID_LENGTH_LIST *id_length_list, ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, char *firstseq_key, int n_targetseqs, P7_PROGRESS *prg);
 static void pipeline_thread(void *arg);
 #if defined (eslENABLE_SSE)
 static int  thread_loop_FM(WORKER_INFO *info, ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp);
@@ -323,8 +377,11 @@ output_header(FILE *ofp, const ESL_GETOPTS *go, char *queryfile, char *seqfile,
   if (esl_opt_IsUsed(go, "-A")              && fprintf(ofp, "# MSA of all hits saved to file:   %s\n",            esl_opt_GetString(go, "-A"))             < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--tblout")        && fprintf(ofp, "# hits tabular output:             %s\n",            esl_opt_GetString(go, "--tblout"))       < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--dfamtblout")    && fprintf(ofp, "# hits output in Dfam format:      %s\n",            esl_opt_GetString(go, "--dfamtblout"))   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--hitout")        && fprintf(ofp, "# binary hit output:               %s\n",            esl_opt_GetString(go, "--hitout"))       < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--aliscoresout")  && fprintf(ofp, "# alignment scores output:         %s\n",            esl_opt_GetString(go, "--aliscoresout")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--hmmout")        && fprintf(ofp, "# hmm output:                      %s\n",            esl_opt_GetString(go, "--hmmout"))       < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--statsout")      && fprintf(ofp, "# JSON search statistics output:   %s\n",            esl_opt_GetString(go, "--statsout"))     < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--progress")      && fprintf(ofp, "# progress records every:          %g sec\n",        esl_opt_GetReal(go, "--progress"))       < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 
   if (esl_opt_IsUsed(go, "--acc")        && fprintf(ofp, "# prefer accessions over names:    yes\n")                                                  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--noali")      && fprintf(ofp, "# show alignments in output:       no\n")                                                   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
@@ -372,6 +429,7 @@ output_header(FILE *ofp, const ESL_GETOPTS *go, char *queryfile, char *seqfile,
 
 
   if (esl_opt_IsUsed(go, "--nonull2")    && fprintf(ofp, "# null2 bias corrections:          off\n")                                                   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--nosample")   && fprintf(ofp, "# multidomain envelopes:           posterior decoding\n")                                    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 
   if (esl_opt_IsUsed(go, "--watson")    && fprintf(ofp, "# search only top strand:          on\n")                                                  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--crick") && fprintf(ofp, "# search only bottom strand:       on\n")                                                  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
@@ -388,6 +446,9 @@ output_header(FILE *ofp, const ESL_GETOPTS *go, char *queryfile, char *seqfile,
 #ifdef HMMER_THREADS
   //if (esl_opt_IsUsed(go, "--cpu")        && fprintf(ofp, "# number of worker threads:        %d\n",             esl_opt_GetInteger(go, "--cpu"))      < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (fprintf(ofp, "# number of worker threads:        %d\n",             ncpus)      < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+#endif
+#ifdef HMMER_MPI
+  if (esl_opt_IsUsed(go, "--mpi")        && fprintf(ofp, "# MPI:                             on\n")                                                    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 #endif
   if (fprintf(ofp, "# - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -\n\n")                                                   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   return eslOK;
@@ -442,7 +503,36 @@ main(int argc, char **argv)
   if ( cfg.n_targetseq != -1 && cfg.n_targetseq < 1 )
     p7_Fail("--restrictdb_n must be >= 1\n");
 
-  status = serial_master(go, &cfg);
+  /* Figure out who we are, and send control there: 
+   * we might be an MPI master, an MPI worker, or a serial program.
+   * The MPI master is serial_master() with cfg.do_mpi set: it still
+   * reads the queries (and builds HMMs from MSA or sequence input),
+   * but farms the target sequences out to the workers.
+   */
+#ifdef HMMER_MPI
+  /* pause the execution of the programs execution until the user has a
+   * chance to attach with a debugger and send a signal to resume execution
+   * i.e. (gdb) signal SIGCONT
+   */
+  if (esl_opt_GetBoolean(go, "--stall")) pause();
+
+  if (esl_opt_GetBoolean(go, "--mpi")) 
+    {
+      cfg.do_mpi     = TRUE;
+      MPI_Init(&argc, &argv);
+      MPI_Comm_rank(MPI_COMM_WORLD, &(cfg.my_rank));
+      MPI_Comm_size(MPI_COMM_WORLD, &(cfg.nproc));
+
+      if (cfg.my_rank > 0)  status = mpi_worker(go, &cfg);
+      else                  status = serial_master(go, &cfg);
+
+      MPI_Finalize();
+    }
+  else
+#endif /*HMMER_MPI*/
+    {
+      status = serial_master(go, &cfg);
+    }
 
   esl_getopts_Destroy(go);
   return status;
@@ -464,7 +554,10 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   FILE            *afp          = NULL;            /* alignment output file (-A)                            */
   FILE            *tblfp        = NULL;            /* output stream for tabular  (--tblout)                 */
   FILE            *dfamtblfp    = NULL;            /* output stream for tabular Dfam format (--dfamtblout)  */
+  FILE            *hitfp        = NULL;            /* output stream for binary hit output (--hitout)        */
   FILE            *aliscoresfp  = NULL;            /* output stream for alignment scores (--aliscoresout)   */
+  FILE            *statsfp      = NULL;            /* JSON lines of search statistics (--statsout)          */
+  P7_PROGRESS     *prg          = NULL;            /* periodic progress records (--progress)                */
 
   /*Some fraction of these will be used, depending on what sort of input is used for the query*/
   P7_HMMFILE      *hfp        = NULL;              /* open input HMM file    */
@@ -482,6 +575,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
   ESL_ALPHABET    *abc       = NULL;              /* digital alphabet           */
   ESL_STOPWATCH   *w;
+  P7_STAGESTATS    stagestats;
   P7_SCOREDATA    *scoredata = NULL;
 
   int              textw     = 0;
@@ -512,7 +606,13 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 #endif // eslENABLE_SSE
   ESL_THREADS     *threadObj= NULL;
   ESL_WORK_QUEUE  *queue    = NULL;
+  P7_DOMAINPOOL   *ddpool   = NULL;
 #endif // HMMER_THREADS
+#ifdef HMMER_MPI
+  BLOCK_LIST      *list     = NULL;              /* target blocks, reused for each query (MPI)    */
+  char            *mpi_buf  = NULL;              /* buffer used to pack/unpack structures         */
+  int              mpi_size = 0;                 /* size of the allocated buffer                  */
+#endif
   char   errbuf[eslERRBUFSIZE];
   double window_beta = -1.0 ;
   int window_length  = -1;
@@ -527,6 +627,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (esl_opt_IsUsed(go, "--w_length")) { if (( window_length = esl_opt_GetInteger(go, "--w_length")) < 4  ) esl_fatal("Invalid window length value\n"); }
 
   w = esl_stopwatch_Create();
+  p7_stagestats_Zero(&stagestats);
 
   if (esl_opt_GetBoolean(go, "--notextw")) textw = 0;
   else                                     textw = esl_opt_GetInteger(go, "--textw");
@@ -739,6 +840,10 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
     dbformat = eslSQFILE_FMINDEX;
   }
 
+  if (cfg->do_mpi) {
+    if (dbformat == eslSQFILE_FMINDEX) p7_Fail("--mpi is not supported for fmindex target databases\n");
+    if (cfg->nproc < 2)                p7_Fail("--mpi requires at least 2 processes: a master and one or more workers\n");
+  }
 
 
 
@@ -747,7 +852,10 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (esl_opt_IsOn(go, "-A"))              { if ((afp      = fopen(esl_opt_GetString(go, "-A"), "w")) == NULL) p7_Fail("Failed to open alignment file %s for writing\n", esl_opt_GetString(go, "-A")); }
   if (esl_opt_IsOn(go, "--tblout"))        { if ((tblfp    = fopen(esl_opt_GetString(go, "--tblout"),    "w")) == NULL)  esl_fatal("Failed to open tabular output file %s for writing\n", esl_opt_GetString(go, "--tblout")); }
   if (esl_opt_IsOn(go, "--dfamtblout"))    { if ((dfamtblfp    = fopen(esl_opt_GetString(go, "--dfamtblout"),"w"))   == NULL)  esl_fatal("Failed to open tabular dfam output file %s for writing\n", esl_opt_GetString(go, "--dfamtblout")); }
+  if (esl_opt_IsOn(go, "--hitout"))        { if ((hitfp        = fopen(esl_opt_GetString(go, "--hitout"),    "wb"))   == NULL)  esl_fatal("Failed to open binary hit output file %s for writing\n", esl_opt_GetString(go, "--hitout")); p7_hitfile_WriteMagic(hitfp); }
   if (esl_opt_IsOn(go, "--aliscoresout"))  { if ((aliscoresfp  = fopen(esl_opt_GetString(go, "--aliscoresout"),"w")) == NULL)  esl_fatal("Failed to open alignment scores output file %s for writing\n", esl_opt_GetString(go, "--aliscoresout")); }
+  if (esl_opt_IsOn(go, "--statsout"))      { if ((statsfp      = fopen(esl_opt_GetString(go, "--statsout"),   "w"))   == NULL)  esl_fatal("Failed to open JSON statistics output file %s for writing\n", esl_opt_GetString(go, "--statsout")); }
+  if (esl_opt_IsOn(go, "--progress"))      { if ((prg = p7_progress_Create(statsfp, "nhmmer", esl_opt_GetReal(go, "--progress"), cfg->dbfile)) == NULL) p7_Fail("Failed to create progress reporter"); }
 
   if (qfp_msa != NULL || qfp_sq != NULL) {
     if (esl_opt_IsOn(go, "--hmmout")) {
@@ -758,7 +866,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
 #ifdef HMMER_THREADS
   /* initialize thread data */
-  ncpus = ESL_MIN(esl_opt_GetInteger(go, "--cpu"), esl_threads_GetCPUCount());
+  ncpus = cfg->do_mpi ? 0 : ESL_MIN(esl_opt_GetInteger(go, "--cpu"), esl_threads_GetCPUCount());
 
   if (ncpus > 0) {
 #if defined (eslENABLE_SSE)
@@ -769,6 +877,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
         threadObj = esl_threads_Create(&pipeline_thread);
 
       queue = esl_workqueue_Create(ncpus * 2);
+      if ((ddpool = p7_domainpool_Create(ncpus)) == NULL) p7_Fail("Failed to create domain definition threads");
   }
 #endif
 
@@ -832,6 +941,20 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 #endif
   }
 
+#ifdef HMMER_MPI
+  if (cfg->do_mpi) {
+    ESL_ALLOC(list, sizeof(BLOCK_LIST));
+    list->complete = 0;
+    list->size     = 0;
+    list->current  = 0;
+    list->last     = 0;
+    list->nseqs    = 0;
+    list->blocks   = NULL;
+    list->lengths  = init_id_length(1000);
+    list->split.count = 0;
+  }
+#endif
+
   if (qfp_sq != NULL || qfp_msa  != NULL )  {  // need to convert query sequence / msa to HMM
     builder = p7_builder_Create(NULL, abc);
     if (builder == NULL)  p7_Fail("p7_builder_Create failed");
@@ -975,6 +1098,9 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
           info[i].th  = p7_tophits_Create();
           info[i].om = p7_oprofile_Copy(om);
           info[i].pli = p7_pipeline_Create(go, om->M, 100, TRUE, p7_SEARCH_SEQS); /* L_hint = 100 is just a dummy for now */
+#ifdef HMMER_THREADS
+          info[i].pli->ddef->pool = ddpool;
+#endif
 
           //set method specific --F1, if it wasn't set at command line
           if (!esl_opt_IsOn(go, "--F1") ) {
@@ -1020,6 +1146,8 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
       /* establish the id_lengths data structutre */
       id_length_list = init_id_length(1000);
 
+      if (prg) p7_progress_Start(prg, hmm->name);
+
 #ifdef HMMER_THREADS
 #if defined (eslENABLE_SSE)
       if (dbformat == eslSQFILE_FMINDEX) {
@@ -1032,8 +1160,12 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
       else
 #endif //defined (eslENABLE_SSE)
       {
-        if (ncpus > 0)  sstatus = thread_loop    (info, id_length_list, threadObj, queue, dbfp, cfg->firstseq_key, cfg->n_targetseq);
-        else            sstatus = serial_loop    (info, id_length_list, dbfp, cfg->firstseq_key, cfg->n_targetseq);
+#ifdef HMMER_MPI
+        if (cfg->do_mpi) sstatus = mpi_loop      (info, id_length_list, hmm, dbfp, list, cfg, go, &mpi_buf, &mpi_size);
+        else
+#endif
+        if (ncpus > 0)  sstatus = thread_loop    (info, id_length_list, threadObj, queue, dbfp, cfg->firstseq_key, cfg->n_targetseq, prg);
+        else            sstatus = serial_loop    (info, id_length_list, dbfp, 0, cfg->n_targetseq, prg);
       }
 
 #else //HMMER_THREADS
@@ -1042,7 +1174,12 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
         sstatus = serial_loop_FM (info, dbfp);
       else
 #endif // defined (eslENABLE_SSE)
-        sstatus = serial_loop    (info, id_length_list, dbfp, cfg->firstseq_key, cfg->n_targetseq);
+#ifdef HMMER_MPI
+      if (cfg->do_mpi)
+        sstatus = mpi_loop       (info, id_length_list, hmm, dbfp, list, cfg, go, &mpi_buf, &mpi_size);
+      else
+#endif
+        sstatus = serial_loop    (info, id_length_list, dbfp, 0, cfg->n_targetseq, prg);
 #endif //HMMER_THREADS
 
 
@@ -1122,11 +1259,14 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
       if (tblfp)     p7_tophits_TabularTargets(tblfp,    hmm->name, hmm->acc, info->th, info->pli, (nquery == 1));
       if (dfamtblfp) p7_tophits_TabularXfam(dfamtblfp,   hmm->name, hmm->acc, info->th, info->pli);
+      if (hitfp)     p7_hitfile_Write(hitfp, hmm->name, hmm->acc, info->th, info->pli);
       if (aliscoresfp) p7_tophits_AliScores(aliscoresfp, hmm->name, info->th );
 
       esl_stopwatch_Stop(w);
 
       p7_pli_Statistics(ofp, info->pli, w);
+      p7_stagestats_Merge(&stagestats, &(info->pli->stats));
+      if (statsfp) p7_pli_JSONStatistics(statsfp, "nhmmer", hmm->name, info->pli, info->th, w, ncpus);
 
       if (fprintf(ofp, "//\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 
@@ -1199,9 +1339,17 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   }
 
 
+#ifdef HMMER_MPI
+  if (cfg->do_mpi) mpi_terminate(cfg, &mpi_buf, &mpi_size);
+#endif
+
  /* Terminate outputs - any last words?
    */
+  if (esl_opt_GetBoolean(go, "--stagestats")) {
+    if (tblfp) p7_pli_TabularStageStats(tblfp, &stagestats);
+  }
   if (tblfp)    p7_tophits_TabularTail(tblfp,    "nhmmer", p7_SEARCH_SEQS, cfg->queryfile, cfg->dbfile, go);
+  if (hitfp)    p7_hitfile_WriteTail(hitfp, "nhmmer", p7_SEARCH_SEQS, cfg->queryfile, cfg->dbfile, go);
   if (ofp)      { if (fprintf(ofp, "[ok]\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
 
   /* Cleanup - prepare for successful exit
@@ -1231,12 +1379,20 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
       }
       esl_workqueue_Destroy(queue);
       esl_threads_Destroy(threadObj);
+      p7_domainpool_Destroy(ddpool);
   }
 #endif
 
   free(info);
 
-
+#ifdef HMMER_MPI
+  if (list) {
+    destroy_id_length(list->lengths);
+    if (list->blocks) free(list->blocks);
+    free(list);
+  }
+  if (mpi_buf) free(mpi_buf);
+#endif
 
   if (hfp)     p7_hmmfile_Close(hfp);
   if (qfp_msa) esl_msafile_Close(qfp_msa);
@@ -1248,6 +1404,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   esl_sqfile_Close(dbfp);
   esl_alphabet_Destroy(abc);
   esl_stopwatch_Destroy(w);
+  p7_progress_Destroy(prg);
 
 #if defined (eslENABLE_SSE)
   if (dbformat == eslSQFILE_FMINDEX) {
@@ -1261,7 +1418,9 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (afp)           fclose(afp);
   if (tblfp)         fclose(tblfp);
   if (dfamtblfp)     fclose(dfamtblfp);
+  if (hitfp)         fclose(hitfp);
   if (aliscoresfp)   fclose(aliscoresfp);
+  if (statsfp)       fclose(statsfp);
 
   return eslOK;
 
@@ -1277,7 +1436,10 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
    if (afp)           fclose(afp);
    if (tblfp)         fclose(tblfp);
    if (dfamtblfp)     fclose(dfamtblfp);
+   if (hitfp)         fclose(hitfp);
    if (aliscoresfp)   fclose(aliscoresfp);
+   if (statsfp)       fclose(statsfp);
+   p7_progress_Destroy(prg);
 
 #if defined (eslENABLE_SSE)
    if (dbformat == eslSQFILE_FMINDEX) {
@@ -1290,52 +1452,574 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
    return eslFAIL;
 }
 
-//TODO: MPI code needs to be added here
-static int
-serial_loop(WORKER_INFO *info, ID_LENGTH_LIST *id_length_list, ESL_SQFILE *dbfp, char *firstseq_key, int n_targetseqs)
+#ifdef HMMER_MPI
+
+/* Define common tags used by the MPI master/slave processes */
+#define HMMER_ERROR_TAG          1
+#define HMMER_HMM_TAG            2
+#define HMMER_SEQUENCE_TAG       3
+#define HMMER_BLOCK_TAG          4
+#define HMMER_PIPELINE_TAG       5
+#define HMMER_TOPHITS_TAG        6
+#define HMMER_HIT_TAG            7
+#define HMMER_TERMINATING_TAG    8
+#define HMMER_READY_TAG          9
+
+/* mpi_failure()
+ * Generate an error message.  If the clients rank is not 0, a
+ * message is created with the error message and sent to the
+ * master process for handling.
+ */
+static void
+mpi_failure(char *format, ...)
 {
+  va_list  argp;
+  int      status = eslFAIL;
+  int      len;
+  int      rank;
+  char     str[512];
 
-  int      wstatus = eslOK;
-  int seq_id = 0;
-  ESL_SQ   *dbsq   =  esl_sq_CreateDigital(info->om->abc);
-  ESL_SQ   *dbsq_revcmp;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
-  if (dbsq->abc->complement != NULL)
-    dbsq_revcmp =  esl_sq_CreateDigital(info->om->abc);
+  /* format the error mesg */
+  va_start(argp, format);
+  len = vsnprintf(str, sizeof(str), format, argp);
+  va_end(argp);
 
-  wstatus = esl_sqio_ReadWindow(dbfp, 0, info->pli->block_length, dbsq);
+  /* make sure the error string is terminated */
+  str[sizeof(str)-1] = '\0';
 
-  while (wstatus == eslOK && (n_targetseqs==-1 || seq_id < n_targetseqs) ) {
-      dbsq->idx = seq_id;
-      p7_pli_NewSeq(info->pli, dbsq);
+  /* if the caller is the master, print the results and abort */
+  if (rank == 0)
+    {
+      if (fprintf(stderr, "\nError: ") < 0) exit(eslEWRITE);
+      if (fprintf(stderr, "%s", str)   < 0) exit(eslEWRITE);
+      if (fprintf(stderr, "\n")        < 0) exit(eslEWRITE);
+      fflush(stderr);
 
-      if (info->pli->strands != p7_STRAND_BOTTOMONLY) {
+      MPI_Abort(MPI_COMM_WORLD, status);
+      exit(1);
+    }
+  else
+    {
+      MPI_Send(str, len, MPI_CHAR, 0, HMMER_ERROR_TAG, MPI_COMM_WORLD);
+      pause();
+    }
+}
 
-        info->pli->nres -= dbsq->C; // to account for overlapping region of windows
-        p7_Pipeline_LongTarget(info->pli, info->om, info->scoredata, info->bg, info->th, info->pli->nseqs, dbsq, p7_NOCOMPLEMENT, NULL, NULL, NULL);
-        p7_pipeline_Reuse(info->pli); // prepare for next search
+/* mpi_recv_ready()
+ * Wait for the next message from any worker, which must be a
+ * message with tag <expect>; return the worker's rank.
+ */
+static int
+mpi_recv_ready(int expect, char **mpi_buf, int *mpi_size)
+{
+  MPI_Status  mpistatus;
+  int         size;
+  int         dest;
+  int         status;
+
+  if (MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &mpistatus) != 0)
+    mpi_failure("MPI error %d receiving message from %d\n", mpistatus.MPI_SOURCE);
+
+  MPI_Get_count(&mpistatus, MPI_PACKED, &size);
+  if (*mpi_buf == NULL || size > *mpi_size) {
+    void *tmp;
+    ESL_RALLOC(*mpi_buf, tmp, sizeof(char) * size);
+    *mpi_size = size;
+  }
 
-      } else {
-        info->pli->nres -= dbsq->n;
-      }
+  dest = mpistatus.MPI_SOURCE;
+  MPI_Recv(*mpi_buf, size, MPI_PACKED, dest, mpistatus.MPI_TAG, MPI_COMM_WORLD, &mpistatus);
 
-      //reverse complement
-      if (info->pli->strands != p7_STRAND_TOPONLY && dbsq->abc->complement != NULL )
+  if (mpistatus.MPI_TAG == HMMER_ERROR_TAG)
+    mpi_failure("MPI client %d raised error:\n%s\n", dest, *mpi_buf);
+  if (mpistatus.MPI_TAG != expect)
+    mpi_failure("Unexpected tag %d from %d\n", mpistatus.MPI_TAG, dest);
+
+  return dest;
+
+ ERROR:
+  mpi_failure("Failed to allocate MPI receive buffer\n");
+  return status;
+}
+
+#define MAX_BLOCK_SIZE   (512*1024)
+#define MAX_RANGE_LENGTH (16*1024*1024)  /* residues; longer sequences are handed out in ranges this long */
+
+/* this routine parses the database keeping track of the blocks
+ * offset within the file, number of sequences and the length
+ * of the block.  These blocks are passed as work units to the
+ * MPI workers.  If multiple hmm's are in the query file, the
+ * blocks are reused without parsing the database a second time.
+ *
+ * A sequence longer than MAX_RANGE_LENGTH (a chromosome, say) would
+ * leave all but one worker idle, so it gets blocks of its own, one
+ * for each consecutive range of up to MAX_RANGE_LENGTH residues.
+ * The worker reads its range in overlapping windows, as the serial
+ * and threaded readers do with --block_length, starting with the
+ * pli->W residues before the range (see range_loop()). The first
+ * pass also records the length of each sequence, for
+ * assign_Lengths().
+ */
+static int
+next_block(ESL_SQFILE *sqfp, ESL_SQ *sq, BLOCK_LIST *list, SEQ_BLOCK *block, int n_targetseqs)
+{
+  int      status   = eslOK;
+
+  /* if the list has been calculated, use it instead of parsing the database */
+  if (list->complete)
+    {
+      if (list->current == list->last)
       {
-          esl_sq_Copy(dbsq,dbsq_revcmp);
-          esl_sq_ReverseComplement(dbsq_revcmp);
-          p7_Pipeline_LongTarget(info->pli, info->om, info->scoredata, info->bg, info->th, info->pli->nseqs, dbsq_revcmp, p7_COMPLEMENT, NULL, NULL, NULL);
-          p7_pipeline_Reuse(info->pli); // prepare for next search
+        memset(block, 0, sizeof(SEQ_BLOCK));
+        status = eslEOF;
+      }
+      else
+      {
+        *block = list->blocks[list->current++];
+        status = eslOK;
+      }
+
+      return status;
+    }
+
+  memset(block, 0, sizeof(SEQ_BLOCK));
+  block->idx    = list->nseqs;
+
+  if (list->split.count == 0)
+    {
+      esl_sq_Reuse(sq);
+      if (n_targetseqs != -1 && list->nseqs >= n_targetseqs) status = eslEOF; /* restrictdb: no more targets wanted */
+      while (status == eslOK && block->length < MAX_BLOCK_SIZE && (n_targetseqs == -1 || list->nseqs < n_targetseqs) && (status = esl_sqio_ReadInfo(sqfp, sq)) == eslOK)
+        {
+          if (add_id_length(list->lengths, list->nseqs, sq->L) != eslOK) return eslEMEM;
+          if (sq->L > MAX_RANGE_LENGTH)
+            {  /* cut it into ranges, starting with the next call if this block already has sequences */
+              list->split.offset = sq->roff;
+              list->split.count  = 1;
+              list->split.idx    = list->nseqs;
+              list->split.start  = 1;
+              list->split.L      = sq->L;
+              list->nseqs++;
+              esl_sq_Reuse(sq);
+              break;
+            }
+          if (block->count == 0) block->offset = sq->roff;
+          block->length = sq->eoff - block->offset + 1;
+          block->count++;
+          list->nseqs++;
+          esl_sq_Reuse(sq);
+        }
+
+      if (block->count > 0 && status == eslEOF) status = eslOK;
+      if (block->count == 0 && list->split.count == 0 && status == eslOK) status = eslEOF;
+      if (status == eslEOF) list->complete = 1;
+    }
+
+  if (status == eslOK && block->count == 0)
+    {  /* the next range of a long sequence */
+      *block     = list->split;
+      block->end = ESL_MIN(block->start + MAX_RANGE_LENGTH - 1, block->L);
+      if (block->end == block->L) list->split.count = 0;
+      else                        list->split.start = block->end + 1;
+    }
+
+  /* add the block to the list of known blocks */
+  if (status == eslOK)
+    {
+      if (list->last >= list->size)
+        {
+          void *tmp;
+          list->size += 500;
+          ESL_RALLOC(list->blocks, tmp, sizeof(SEQ_BLOCK) * list->size);
+        }
+      list->blocks[list->last++] = *block;
+    }
+
+  return status;
+
+ ERROR:
+  return eslEMEM;
+}
+
+/* mpi_loop()
+ * The MPI master's counterpart of serial_loop(): send the query
+ * <hmm> to every worker, hand out blocks of target sequences to
+ * workers as they become ready, then collect and merge each
+ * worker's hits and pipeline statistics into <info>.  The caller
+ * then computes E-values and removes duplicates just as it does for
+ * a serial or threaded search.
+ *
+ * Returns <eslEOF> when the whole database (or the --restrictdb
+ * range) has been searched; <eslEFORMAT> on a parse error in the
+ * database. MPI errors are fatal.
+ */
+static int
+mpi_loop(WORKER_INFO *info, ID_LENGTH_LIST *id_length_list, P7_HMM *hmm, ESL_SQFILE *dbfp, BLOCK_LIST *list, struct cfg_s *cfg, ESL_GETOPTS *go, char **mpi_buf, int *mpi_size)
+{
+  ESL_SQ      *dbsq    = esl_sq_CreateDigital(info->om->abc);
+  SEQ_BLOCK    block;
+  int          sstatus = eslOK;
+  int          status;
+  int          dest;
+  int          i;
+
+  list->current = 0;
+
+  /* every worker builds its own profile and pipeline from the query */
+  for (dest = 1; dest < cfg->nproc; ++dest)
+    if ((status = p7_hmm_MPISend(hmm, dest, HMMER_HMM_TAG, MPI_COMM_WORLD, mpi_buf, mpi_size)) != eslOK)
+      mpi_failure("Unexpected error %d sending query HMM to %d", status, dest);
+
+  /* Main loop: */
+  while ((sstatus = next_block(dbfp, dbsq, list, &block, cfg->n_targetseq)) == eslOK)
+    {
+      dest = mpi_recv_ready(HMMER_READY_TAG, mpi_buf, mpi_size);
+      MPI_Send(&block, 7, MPI_LONG_LONG_INT, dest, HMMER_BLOCK_TAG, MPI_COMM_WORLD);
+    }
+  if (sstatus == eslEMEM) mpi_failure("Failed to allocate block list");
+
+  memset(&block, 0, sizeof(SEQ_BLOCK));
+
+  /* wait for all workers to finish up their work blocks */
+  for (i = 1; i < cfg->nproc; ++i)
+    mpi_recv_ready(HMMER_READY_TAG, mpi_buf, mpi_size);
+
+  /* merge the results of the search results */
+  for (dest = 1; dest < cfg->nproc; ++dest)
+    {
+      P7_PIPELINE     *mpi_pli   = NULL;
+      P7_TOPHITS      *mpi_th    = NULL;
+
+      /* send an empty block to signal the worker they are done */
+      MPI_Send(&block, 7, MPI_LONG_LONG_INT, dest, HMMER_BLOCK_TAG, MPI_COMM_WORLD);
+
+      /* wait for the results */
+      if ((status = p7_tophits_MPIRecv(dest, HMMER_TOPHITS_TAG, MPI_COMM_WORLD, mpi_buf, mpi_size, &mpi_th)) != eslOK)
+        mpi_failure("Unexpected error %d receiving tophits from %d", status, dest);
+
+      if ((status = p7_pipeline_MPIRecv(dest, HMMER_PIPELINE_TAG, MPI_COMM_WORLD, mpi_buf, mpi_size, go, &mpi_pli)) != eslOK)
+        mpi_failure("Unexpected error %d receiving pipeline from %d", status, dest);
 
-          info->pli->nres += dbsq_revcmp->W;
+      p7_tophits_Merge(info->th, mpi_th);
+      p7_pipeline_Merge(info->pli, mpi_pli);
 
+      p7_pipeline_Destroy(mpi_pli);
+      p7_tophits_Destroy(mpi_th);
+    }
+
+  /* sequence lengths were recorded by the master on its first pass over the blocks */
+  for (i = 0; i < list->lengths->count; i++)
+    add_id_length(id_length_list, list->lengths->id_lengths[i].id, list->lengths->id_lengths[i].length);
+
+  esl_sq_Destroy(dbsq);
+  return sstatus;
+}
+
+/* mpi_terminate()
+ * After the last query: tell each worker there are no more queries,
+ * and wait for all of them to acknowledge.
+ */
+static int
+mpi_terminate(struct cfg_s *cfg, char **mpi_buf, int *mpi_size)
+{
+  int dest;
+  int i;
+
+  for (dest = 1; dest < cfg->nproc; ++dest)
+    if (p7_hmm_MPISend(NULL, dest, HMMER_HMM_TAG, MPI_COMM_WORLD, mpi_buf, mpi_size) != eslOK)
+      mpi_failure("Failed to send shutdown signal to %d", dest);
+
+  for (i = 1; i < cfg->nproc; ++i)
+    mpi_recv_ready(HMMER_TERMINATING_TAG, mpi_buf, mpi_size);
+
+  return eslOK;
+}
+
+/* mpi_worker()
+ * Receive each query HMM from the master, and search the blocks of
+ * target sequences the master hands out with serial_loop(). The
+ * worker reads the target database itself; it never sees the query
+ * file, so HMM, MSA and sequence queries all work the same way.
+ */
+static int
+mpi_worker(ESL_GETOPTS *go, struct cfg_s *cfg)
+{
+  int              dbformat = eslSQFILE_UNKNOWN; /* format of dbfile                                */
+  ESL_SQFILE      *dbfp     = NULL;              /* open input sequence file                        */
+  ESL_ALPHABET    *abc      = NULL;              /* digital alphabet                                */
+  P7_HMM          *hmm      = NULL;              /* query HMM, from the master                      */
+  P7_BG           *bg       = NULL;              /* null model                                      */
+  WORKER_INFO      info;
+  int              status   = eslOK;
+  int              hstatus  = eslOK;
+  int              sstatus  = eslOK;
+
+  char            *mpi_buf  = NULL;              /* buffer used to pack/unpack structures */
+  int              mpi_size = 0;                 /* size of the allocated buffer */
+
+  MPI_Status       mpistatus;
+  char             errbuf[eslERRBUFSIZE];
+
+  if (esl_opt_IsOn(go, "--tformat")) {
+    dbformat = esl_sqio_EncodeFormat(esl_opt_GetString(go, "--tformat"));
+    if (dbformat == eslSQFILE_UNKNOWN) mpi_failure("%s is not a recognized sequence database file format\n", esl_opt_GetString(go, "--tformat"));
+  }
+
+  /* Open the target sequence database */
+  status = esl_sqfile_Open(cfg->dbfile, dbformat, p7_SEQDBENV, &dbfp);
+  if      (status == eslENOTFOUND) mpi_failure("Failed to open target sequence database %s for reading\n",      cfg->dbfile);
+  else if (status == eslEFORMAT)   mpi_failure("Target sequence database file %s is empty or misformatted\n",   cfg->dbfile);
+  else if (status == eslEINVAL)    mpi_failure("Can't autodetect format of a stdin or .gz seqfile");
+  else if (status != eslOK)        mpi_failure("Unexpected error %d opening target sequence database file %s\n", status, cfg->dbfile);
+
+#ifdef HMMER_THREADS
+  info.queue     = NULL;
+#endif
+  info.fm_cfg    = NULL;
+
+  /* Outside loop: over each query HMM the master sends; eslEOD means we're done. */
+  while ((hstatus = p7_hmm_MPIRecv(0, HMMER_HMM_TAG, MPI_COMM_WORLD, &mpi_buf, &mpi_size, &abc, &hmm)) == eslOK)
+    {
+      P7_PROFILE      *gm      = NULL;
+      SEQ_BLOCK        block;
+
+      /* One-time initializations after alphabet <abc> becomes known */
+      if (bg == NULL) {
+        esl_sqfile_SetDigital(dbfp, abc);
+        bg = p7_bg_Create(abc);
+        if (esl_opt_IsOn(go, "--bgfile") && p7_bg_Read(esl_opt_GetString(go, "--bgfile"), bg, errbuf) != eslOK)
+          mpi_failure("Trouble reading bgfile: %s\n", errbuf);
       }
 
+      /* Convert to an optimized model */
+      gm      = p7_profile_Create (hmm->M, abc);
+      info.om = p7_oprofile_Create(hmm->M, abc);
+      p7_ProfileConfig(hmm, bg, gm, 100, p7_LOCAL); /* 100 is a dummy length for now; and MSVFilter requires local mode */
+      p7_oprofile_Convert(gm, info.om);             /* <om> is now p7_LOCAL, multihit */
+
+      /* Create processing pipeline and hit list, configured as in serial_master() */
+      info.bg  = bg;
+      info.th  = p7_tophits_Create();
+      info.pli = p7_pipeline_Create(go, info.om->M, 100, TRUE, p7_SEARCH_SEQS); /* L_hint = 100 is just a dummy for now */
+      if (!esl_opt_IsOn(go, "--F1") ) info.pli->F1 = 0.02;
+
+      if (p7_pli_NewModel(info.pli, info.om, info.bg) == eslEINVAL) mpi_failure("%s", info.pli->errbuf);
+
+      info.pli->do_alignment_score_calc = esl_opt_IsOn(go, "--aliscoresout") ;
+
+      if (  esl_opt_IsUsed(go, "--watson") )
+        info.pli->strands = p7_STRAND_TOPONLY;
+      else if (  esl_opt_IsUsed(go, "--crick") )
+        info.pli->strands = p7_STRAND_BOTTOMONLY;
+      else
+        info.pli->strands = p7_STRAND_BOTH;
+
+      if (  esl_opt_IsUsed(go, "--block_length") )
+        info.pli->block_length = esl_opt_GetInteger(go, "--block_length");
+      else
+        info.pli->block_length = NHMMER_MAX_RESIDUE_COUNT;
+
+      info.scoredata = p7_hmm_ScoreDataCreate(info.om, NULL);
+
+      status = 0;
+      MPI_Send(&status, 1, MPI_INT, 0, HMMER_READY_TAG, MPI_COMM_WORLD);
+
+      /* receive a sequence block from the master */
+      MPI_Recv(&block, 7, MPI_LONG_LONG_INT, 0, HMMER_BLOCK_TAG, MPI_COMM_WORLD, &mpistatus);
+      while (block.count > 0)
+        {
+          uint64_t nseqs = info.pli->nseqs;
+
+          if (esl_sqfile_Position(dbfp, block.offset) != eslOK)
+            mpi_failure("Cannot position sequence database to %ld\n", block.offset);
+
+          if (block.start > 0) sstatus = range_loop(&info, dbfp, &block);
+          else                 sstatus = serial_loop(&info, NULL, dbfp, block.idx, block.count, NULL);
+          if      (sstatus == eslEFORMAT)                    mpi_failure("Parse failed (sequence file %s):\n%s\n", dbfp->filename, esl_sqfile_GetErrorBuf(dbfp));
+          else if (sstatus != eslOK && sstatus != eslEOF)    mpi_failure("Unexpected error %d reading sequence file %s", sstatus, dbfp->filename);
+
+          /* lets do a little bit of sanity checking here to make sure the blocks are the same;
+           * a sequence cut into ranges is counted with its last range */
+          if (block.start == 0 && info.pli->nseqs - nseqs != block.count)
+            mpi_failure("Block count mismatch - expected %ld found %ld at offset %ld\n", block.count, info.pli->nseqs - nseqs, block.offset);
+
+          /* inform the master we need another block of sequences */
+          status = 0;
+          MPI_Send(&status, 1, MPI_INT, 0, HMMER_READY_TAG, MPI_COMM_WORLD);
+
+          /* wait for the next block of sequences */
+          MPI_Recv(&block, 7, MPI_LONG_LONG_INT, 0, HMMER_BLOCK_TAG, MPI_COMM_WORLD, &mpistatus);
+        }
+
+      /* Send the top hits back to the master. */
+      p7_tophits_MPISend(info.th, 0, HMMER_TOPHITS_TAG, MPI_COMM_WORLD,  &mpi_buf, &mpi_size);
+      p7_pipeline_MPISend(info.pli, 0, HMMER_PIPELINE_TAG, MPI_COMM_WORLD,  &mpi_buf, &mpi_size);
+
+      p7_hmm_ScoreDataDestroy(info.scoredata);
+      p7_pipeline_Destroy(info.pli);
+      p7_tophits_Destroy(info.th);
+      p7_oprofile_Destroy(info.om);
+      p7_profile_Destroy(gm);
+      p7_hmm_Destroy(hmm);
+      hmm = NULL;
+    } /* end outer loop over query HMMs */
+  if (hstatus != eslEOD) mpi_failure("Unexpected error %d receiving query HMM from master", hstatus);
+
+  status = 0;
+  MPI_Send(&status, 1, MPI_INT, 0, HMMER_TERMINATING_TAG, MPI_COMM_WORLD);
+
+  if (mpi_buf != NULL) free(mpi_buf);
+
+  p7_bg_Destroy(bg);
+  esl_alphabet_Destroy(abc);
+  esl_sqfile_Close(dbfp);
+
+  return eslOK;
+}
+
+/* range_loop()
+ * An MPI worker's search of one range <block->start>..<block->end>
+ * of a long target sequence, positioned at the start of its record.
+ * The residues before the range are read and skipped, except for
+ * the last pli->W of them, which are read as the context of the
+ * range's first window, so that hits spanning the boundary with the
+ * previous range are found just as in a serial search. Then the
+ * range is searched in windows of --block_length residues, each
+ * with pli->W residues of overlap with the one before. The sequence
+ * is counted when its last range is done.
+ *
+ * Returns <eslOK> on success; <eslEFORMAT> on a parse error, or
+ * other read errors from esl_sqio_ReadWindow().
+ */
+static int
+range_loop(WORKER_INFO *info, ESL_SQFILE *dbfp, const SEQ_BLOCK *block)
+{
+  ESL_SQ   *dbsq        = esl_sq_CreateDigital(info->om->abc);
+  ESL_SQ   *dbsq_revcmp = NULL;
+  int64_t   C           = ESL_MIN(info->pli->W, block->start - 1); /* context before the range */
+  int64_t   pos         = 0;                                       /* last residue read so far */
+  int64_t   ctx;
+  int64_t   n;
+  int       wstatus     = eslOK;
+
+  if (dbsq->abc->complement != NULL)
+    dbsq_revcmp = esl_sq_CreateDigital(info->om->abc);
+
+  /* read past what precedes the range, then its context */
+  while (wstatus == eslOK && pos < block->start - 1 - C)
+    {
+      n        = ESL_MIN(info->pli->block_length, block->start - 1 - C - pos);
+      wstatus  = esl_sqio_ReadWindow(dbfp, 0, n, dbsq);
+      pos     += n;
+    }
+  if (wstatus == eslOK && C > 0)
+    {
+      wstatus  = esl_sqio_ReadWindow(dbfp, 0, C, dbsq);
+      pos     += C;
+    }
+
+  /* search the range */
+  ctx = C;
+  while (wstatus == eslOK && pos < block->end)
+    {
+      n       = ESL_MIN(info->pli->block_length, block->end - pos);
+      wstatus = esl_sqio_ReadWindow(dbfp, ctx, n, dbsq);
+      if (wstatus != eslOK) break;
+      search_window(info, dbsq, dbsq_revcmp, block->idx);
+      pos += n;
+      ctx  = ESL_MIN(info->pli->W, dbsq->n);
+    }
+  if (wstatus == eslEOD) wstatus = eslEFORMAT; /* sequence is shorter than the master found it to be */
+  if (wstatus == eslOK && block->end == block->L) info->pli->nseqs++;
+
+  esl_sq_Destroy(dbsq);
+  if (dbsq_revcmp) esl_sq_Destroy(dbsq_revcmp);
+  return wstatus;
+}
+#endif /*HMMER_MPI*/
+
+/* window_offset()
+ * Approximate byte offset in the target file of the end of window
+ * <sq>, for progress records: the offset of its sequence's data plus
+ * its end coord, ignoring newlines. -1 if the reader didn't record
+ * the data offset.
+ */
+static int64_t
+window_offset(const ESL_SQ *sq)
+{
+  if (sq->doff <= 0) return -1;
+  return (int64_t) sq->doff + ESL_MAX(sq->start, sq->end);
+}
+
+/* search_window()
+ * Search window <dbsq> of target sequence <seq_id>, on the strands
+ * the pipeline is configured for; <dbsq_revcmp> is workspace for the
+ * reverse complement (NULL if the alphabet has no complement).
+ */
+static void
+search_window(WORKER_INFO *info, ESL_SQ *dbsq, ESL_SQ *dbsq_revcmp, int64_t seq_id)
+{
+  dbsq->idx = seq_id;
+  p7_pli_NewSeq(info->pli, dbsq);
+
+  if (info->pli->strands != p7_STRAND_BOTTOMONLY) {
+
+    info->pli->nres -= dbsq->C; // to account for overlapping region of windows
+    p7_Pipeline_LongTarget(info->pli, info->om, info->scoredata, info->bg, info->th, seq_id, dbsq, p7_NOCOMPLEMENT, NULL, NULL, NULL);
+    p7_pipeline_Reuse(info->pli); // prepare for next search
+
+  } else {
+    info->pli->nres -= dbsq->n;
+  }
+
+  //reverse complement
+  if (info->pli->strands != p7_STRAND_TOPONLY && dbsq->abc->complement != NULL )
+  {
+      esl_sq_Copy(dbsq,dbsq_revcmp);
+      esl_sq_ReverseComplement(dbsq_revcmp);
+      p7_Pipeline_LongTarget(info->pli, info->om, info->scoredata, info->bg, info->th, seq_id, dbsq_revcmp, p7_COMPLEMENT, NULL, NULL, NULL);
+      p7_pipeline_Reuse(info->pli); // prepare for next search
+
+      info->pli->nres += dbsq_revcmp->W;
+
+  }
+}
+
+/* serial_loop()
+ * Search up to <n_targetseqs> sequences (-1 = all) from the current
+ * position of <dbfp>, numbering them from <first_seqidx>. The serial
+ * search starts at 0; an MPI worker starts at the first ID of the
+ * block it was handed. <id_length_list> may be NULL if the caller
+ * doesn't need sequence lengths (the MPI master collects them itself).
+ * If <prg> is non-NULL, count the windows read on it.
+ */
+static int
+serial_loop(WORKER_INFO *info, ID_LENGTH_LIST *id_length_list, ESL_SQFILE *dbfp, int64_t first_seqidx, int n_targetseqs, P7_PROGRESS *prg)
+{
+
+  int      wstatus = eslOK;
+  int64_t  seq_id  = first_seqidx;
+  ESL_SQ   *dbsq   =  esl_sq_CreateDigital(info->om->abc);
+  ESL_SQ   *dbsq_revcmp = NULL;
+
+  if (dbsq->abc->complement != NULL)
+    dbsq_revcmp =  esl_sq_CreateDigital(info->om->abc);
+
+  wstatus = esl_sqio_ReadWindow(dbfp, 0, info->pli->block_length, dbsq);
+
+  while (wstatus == eslOK && (n_targetseqs==-1 || seq_id - first_seqidx < n_targetseqs) ) {
+      search_window(info, dbsq, dbsq_revcmp, seq_id);
+
+      if (prg) p7_progress_Update(prg, 0, dbsq->n - dbsq->C, window_offset(dbsq));
+
       wstatus = esl_sqio_ReadWindow(dbfp, info->om->max_length, info->pli->block_length, dbsq);
       if (wstatus == eslEOD) { // no more left of this sequence ... move along to the next sequence.
-          add_id_length(id_length_list, dbsq->idx, dbsq->L);
+          if (id_length_list != NULL) add_id_length(id_length_list, dbsq->idx, dbsq->L);
 
           info->pli->nseqs++;
+          if (prg) p7_progress_Update(prg, 1, 0, -1);
           esl_sq_Reuse(dbsq);
           wstatus = esl_sqio_ReadWindow(dbfp, 0, info->pli->block_length, dbsq);
 
@@ -1392,10 +2076,11 @@ serial_loop_FM(WORKER_INFO *info, ESL_SQFILE *dbfp)
 
 #ifdef HMMER_THREADS
 static int
-thread_loop(WORKER_INFO *info, ID_LENGTH_LIST *id_length_list, ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, char *firstseq_key, int n_targetseqs)
+thread_loop(WORKER_INFO *info, ID_LENGTH_LIST *id_length_list, ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, char *firstseq_key, int n_targetseqs, P7_PROGRESS *prg)
 {
 
   int          i;
+  int64_t      nres;
   int          status  = eslOK;
   int          sstatus = eslOK;
   int          eofCount = 0;
@@ -1442,6 +2127,11 @@ thread_loop(WORKER_INFO *info, ID_LENGTH_LIST *id_length_list, ESL_THREADS *obj,
       }
       info->pli->nseqs += block->count  - ((abort || block->complete) ? 0 : 1);// if there's an incomplete sequence read into the block wait to count it until it's complete.
 
+      if (prg && block->count > 0) {
+        for (nres = 0, i = 0; i < block->count; i++) nres += block->list[i].n - block->list[i].C;
+        p7_progress_Update(prg, block->count - ((abort || block->complete) ? 0 : 1), nres, window_offset(block->list + block->count - 1));
+      }
+
 
       if (sstatus == eslEOF) {
           if (eofCount < esl_threads_GetWorkerCount(obj)) sstatus = eslOK;
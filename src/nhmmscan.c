@@ -13,6 +13,11 @@
 #include "esl_sqio.h"
 #include "esl_stopwatch.h"
 
+#ifdef HMMER_MPI
+#include "mpi.h"
+#include "esl_mpi.h"
+#endif /*HMMER_MPI*/
+
 #ifdef HMMER_THREADS
 #include <unistd.h>
 #include "esl_threads.h"
@@ -42,8 +47,13 @@ typedef struct {
 #define INCDOMOPTS  "--incdomE,--incdomT,--cut_ga,--cut_nc,--cut_tc"
 #define THRESHOPTS  "-E,-T,--domE,--domT,--incE,--incT,--incdomE,--incdomT,--cut_ga,--cut_nc,--cut_tc"
 
+#if defined (HMMER_THREADS) && defined (HMMER_MPI)
+#define CPUOPTS     "--mpi"
+#define MPIOPTS     "--cpu"
+#else
 #define CPUOPTS     NULL
 #define MPIOPTS     NULL
+#endif
 
 static ESL_OPTIONS options[] = {
   /* name           type          default  env  range toggles  reqs   incomp                         help                                           docgroup*/
@@ -78,6 +88,8 @@ static ESL_OPTIONS options[] = {
   /* Other options */
   { "--qformat",    eslARG_STRING,  NULL, NULL, NULL,    NULL,  NULL,  NULL,             "assert input <seqfile> is in format <s>",                      12 },
   { "--nonull2",    eslARG_NONE,    NULL, NULL, NULL,    NULL,  NULL,  NULL,             "turn off biased composition score corrections",                12 },
+  { "--nosample",   eslARG_NONE,    NULL, NULL, NULL,    NULL,  NULL,  NULL,             "split domains by posterior decoding, not sampling",            12 },
+  { "--stagestats", eslARG_NONE,    NULL, NULL, NULL,    NULL,  NULL,  NULL,             "time each pipeline stage, and count its DP cells",             12 },
   { "-Z",           eslARG_REAL,   FALSE, NULL, "x>0",   NULL,  NULL,  NULL,             "set # of comparisons done, for E-value calculation",           12 },
   { "--seed",       eslARG_INT,    "42",  NULL, "n>=0",  NULL,  NULL,  NULL,             "set RNG seed to <n> (if 0: one-time arbitrary seed)",          12 },
   { "--w_beta",     eslARG_REAL,    NULL, NULL, NULL,    NULL,  NULL,           NULL,    "tail mass at which window length is determined",               12 },
@@ -108,6 +120,10 @@ static ESL_OPTIONS options[] = {
 
 #ifdef HMMER_THREADS
   { "--cpu",        eslARG_INT, p7_NCPU,"HMMER_NCPU","n>=0",NULL,  NULL,  CPUOPTS,         "number of parallel CPU workers to use for multithreads",       12 },
+#endif
+#ifdef HMMER_MPI
+  { "--stall",      eslARG_NONE,   FALSE, NULL, NULL,    NULL,"--mpi", NULL,             "arrest after start: for debugging MPI under gdb",              12 },
+  { "--mpi",        eslARG_NONE,   FALSE, NULL, NULL,    NULL,  NULL,  MPIOPTS,          "run as an MPI parallel program",                               12 },
 #endif
   {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
 };
@@ -131,7 +147,26 @@ static char usage[]  = "[-options] <hmmdb> <seqfile>";
 static char banner[] = "search DNA sequence(s) against a DNA profile database";
 
 static int  serial_master(ESL_GETOPTS *go, struct cfg_s *cfg);
-static int  serial_loop  (WORKER_INFO *info, P7_HMMFILE *hfp);
+static int  serial_loop  (WORKER_INFO *info, P7_HMMFILE *hfp, int nmodels);
+#ifdef HMMER_MPI
+typedef struct {
+  uint64_t  offset;
+  uint64_t  length;
+  uint64_t  count;
+} MSV_BLOCK;
+
+typedef struct {
+  int        complete;
+  int        size;
+  int        current;
+  int        last;
+  MSV_BLOCK *blocks;
+} BLOCK_LIST;
+
+static int  mpi_loop     (WORKER_INFO *info, P7_HMMFILE *hfp, BLOCK_LIST *list, struct cfg_s *cfg, ESL_GETOPTS *go, char **mpi_buf, int *mpi_size);
+static int  mpi_terminate(struct cfg_s *cfg, char **mpi_buf, int *mpi_size);
+static int  mpi_worker   (ESL_GETOPTS *go, struct cfg_s *cfg);
+#endif /*HMMER_MPI*/
 #ifdef HMMER_THREADS
 #define BLOCK_SIZE 1
 static int  thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, P7_HMMFILE *hfp);
@@ -244,6 +279,7 @@ output_header(FILE *ofp, ESL_GETOPTS *go, char *hmmfile, char *seqfile)
   if (esl_opt_IsUsed(go, "--bgfile")     && fprintf(ofp, "# file with custom bg probs:       %s\n",             esl_opt_GetString(go, "--bgfile"))    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 
   if (esl_opt_IsUsed(go, "--nonull2")   && fprintf(ofp, "# null2 bias corrections:          off\n")                                                 < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--nosample")  && fprintf(ofp, "# multidomain envelopes:           posterior decoding\n")                                  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 
   if (esl_opt_IsUsed(go, "--watson")    && fprintf(ofp, "# search only top strand:          on\n")                                                  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--crick") && fprintf(ofp, "# search only bottom strand:       on\n")                                                  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
@@ -258,6 +294,9 @@ output_header(FILE *ofp, ESL_GETOPTS *go, char *hmmfile, char *seqfile)
   if (esl_opt_IsUsed(go, "--w_length")   && fprintf(ofp, "# window length :                  %d\n",             esl_opt_GetInteger(go, "--w_length")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 #ifdef HMMER_THREADS
   if (esl_opt_IsUsed(go, "--cpu")       && fprintf(ofp, "# number of worker threads:        %d\n",            esl_opt_GetInteger(go, "--cpu"))      < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");  
+#endif
+#ifdef HMMER_MPI
+  if (esl_opt_IsUsed(go, "--mpi")       && fprintf(ofp, "# MPI:                             on\n")                                                  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 #endif
   if (fprintf(ofp, "# - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -\n\n")                                                 < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   return eslOK;
@@ -283,7 +322,35 @@ main(int argc, char **argv)
 
   process_commandline(argc, argv, &go, &cfg.hmmfile, &cfg.seqfile);    
 
-  status = serial_master(go, &cfg);
+  /* Figure out who we are, and send control there: 
+   * we might be an MPI master, an MPI worker, or a serial program.
+   * The MPI master is serial_master() with cfg.do_mpi set; it hands
+   * out blocks of models from the pressed database to the workers.
+   */
+#ifdef HMMER_MPI
+  /* pause the execution of the programs execution until the user has a
+   * chance to attach with a debugger and send a signal to resume execution
+   * i.e. (gdb) signal SIGCONT
+   */
+  if (esl_opt_GetBoolean(go, "--stall")) pause();
+
+  if (esl_opt_GetBoolean(go, "--mpi")) 
+    {
+      cfg.do_mpi     = TRUE;
+      MPI_Init(&argc, &argv);
+      MPI_Comm_rank(MPI_COMM_WORLD, &(cfg.my_rank));
+      MPI_Comm_size(MPI_COMM_WORLD, &(cfg.nproc));
+
+      if (cfg.my_rank > 0)  status = mpi_worker(go, &cfg);
+      else                  status = serial_master(go, &cfg);
+
+      MPI_Finalize();
+    }
+  else
+#endif /*HMMER_MPI*/
+    {
+      status = serial_master(go, &cfg);
+    }
 
   esl_getopts_Destroy(go);
   return status;
@@ -313,6 +380,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   ESL_ALPHABET    *abc      = NULL;              /* sequence alphabet                               */
   P7_OPROFILE     *om       = NULL;		 /* target profile                                  */
   ESL_STOPWATCH   *w        = NULL;              /* timing                                          */
+  P7_STAGESTATS    stagestats;                   /* per-stage totals over all queries (--stagestats) */
   ESL_SQ          *qsq      = NULL;		 /* query sequence                                  */
   int              nquery   = 0;
   int              textw;
@@ -329,6 +397,12 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   P7_OM_BLOCK     *block    = NULL;
   ESL_THREADS     *threadObj= NULL;
   ESL_WORK_QUEUE  *queue    = NULL;
+  P7_DOMAINPOOL   *ddpool   = NULL;
+#endif
+#ifdef HMMER_MPI
+  BLOCK_LIST      *list     = NULL;              /* model blocks, reused for each query (MPI)       */
+  char            *mpi_buf  = NULL;              /* buffer used to pack/unpack structures           */
+  int              mpi_size = 0;                 /* size of the allocated buffer                    */
 #endif
   char             errbuf[eslERRBUFSIZE];
 
@@ -339,6 +413,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
 
   w = esl_stopwatch_Create();
+  p7_stagestats_Zero(&stagestats);
 
   if (esl_opt_GetBoolean(go, "--notextw")) textw = 0;
   else                                     textw = esl_opt_GetInteger(go, "--textw");
@@ -362,6 +437,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   else if (hstatus != eslOK)        p7_Fail("Unexpected error in reading HMMs from %s", cfg->hmmfile); 
 
   if (om->max_length == -1) p7_Fail("No MAXL field in model(s); is this an old model format?\nnhmmer/hmmscan require HMMER 3.1 models or later.");
+  if (cfg->do_mpi && cfg->nproc < 2) p7_Fail("--mpi requires at least 2 processes: a master and one or more workers\n");
 
   p7_oprofile_Destroy(om);
   p7_hmmfile_Close(hfp);
@@ -387,11 +463,12 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
 #ifdef HMMER_THREADS
   /* initialize thread data */
-  ncpus = ESL_MIN(esl_opt_GetInteger(go, "--cpu"), esl_threads_GetCPUCount());
+  ncpus = cfg->do_mpi ? 0 : ESL_MIN(esl_opt_GetInteger(go, "--cpu"), esl_threads_GetCPUCount());
   if (ncpus > 0)
     {
       threadObj = esl_threads_Create(&pipeline_thread);
       queue = esl_workqueue_Create(ncpus * 2);
+      if ((ddpool = p7_domainpool_Create(ncpus)) == NULL) p7_Fail("Failed to create domain definition threads");
     }
 #endif
 
@@ -430,6 +507,17 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
     }
 #endif
 
+#ifdef HMMER_MPI
+  if (cfg->do_mpi) {
+    ESL_ALLOC(list, sizeof(BLOCK_LIST));
+    list->complete = 0;
+    list->size     = 0;
+    list->current  = 0;
+    list->last     = 0;
+    list->blocks   = NULL;
+  }
+#endif
+
   /* Outside loop: over each query sequence in <seqfile>. */
   while ((sstatus = esl_sqio_Read(sqfp, qsq)) == eslOK)
   {
@@ -462,6 +550,9 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
         /* Create processing pipeline and hit list */
         info[i].th  = p7_tophits_Create();
         info[i].pli = p7_pipeline_Create(go, 100, 100, TRUE, p7_SCAN_MODELS); /* M_hint = 100, L_hint = 100 are just dummies for now */
+#ifdef HMMER_THREADS
+        info[i].pli->ddef->pool = ddpool;
+#endif
         info[i].pli->hfp = hfp;  /* for two-stage input, pipeline needs <hfp> */
 
         p7_pli_NewSeq(info[i].pli, qsq);
@@ -481,11 +572,15 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 #endif
       }
 
+#ifdef HMMER_MPI
+      if (cfg->do_mpi) hstatus = mpi_loop(info, hfp, list, cfg, go, &mpi_buf, &mpi_size);
+      else
+#endif
 #ifdef HMMER_THREADS
       if (ncpus > 0)  hstatus = thread_loop(threadObj, queue, hfp);
-      else	      hstatus = serial_loop(info, hfp);
+      else	      hstatus = serial_loop(info, hfp, -1);
 #else
-      hstatus = serial_loop(info, hfp);
+      hstatus = serial_loop(info, hfp, -1);
 #endif
       switch(hstatus)
       {
@@ -550,6 +645,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
       esl_stopwatch_Stop(w);
       info->pli->nseqs = 1;
       p7_pli_Statistics(ofp, info->pli, w);
+      p7_stagestats_Merge(&stagestats, &(info->pli->stats));
       if (fprintf(ofp, "//\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
       fflush(ofp);
 
@@ -566,8 +662,15 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   else if (sstatus != eslEOF)     esl_fatal("Unexpected error %d reading sequence file %s",
 					    sstatus, sqfp->filename);
 
+#ifdef HMMER_MPI
+  if (cfg->do_mpi) mpi_terminate(cfg, &mpi_buf, &mpi_size);
+#endif
+
   /* Terminate outputs - any last words?
    */
+  if (esl_opt_GetBoolean(go, "--stagestats")) {
+    if (tblfp) p7_pli_TabularStageStats(tblfp, &stagestats);
+  }
   if (tblfp)    p7_tophits_TabularTail(tblfp,    "hmmscan", p7_SCAN_MODELS, cfg->seqfile, cfg->hmmfile, go);
   if (ofp)      { if (fprintf(ofp, "[ok]\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
 
@@ -587,11 +690,20 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
         p7_oprofile_DestroyBlock(block);
       esl_workqueue_Destroy(queue);
       esl_threads_Destroy(threadObj);
+      p7_domainpool_Destroy(ddpool);
     }
 #endif
 
   ERROR:
 
+#ifdef HMMER_MPI
+  if (list) {
+    if (list->blocks) free(list->blocks);
+    free(list);
+  }
+  if (mpi_buf) free(mpi_buf);
+#endif
+
   p7_bg_Destroy(bg_manual);
 
   if (info!=NULL) free(info);
@@ -610,13 +722,442 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 }
 
 
+#ifdef HMMER_MPI
+
+/* Define common tags used by the MPI master/slave processes */
+#define HMMER_ERROR_TAG          1
+#define HMMER_HMM_TAG            2
+#define HMMER_SEQUENCE_TAG       3
+#define HMMER_BLOCK_TAG          4
+#define HMMER_PIPELINE_TAG       5
+#define HMMER_TOPHITS_TAG        6
+#define HMMER_HIT_TAG            7
+#define HMMER_TERMINATING_TAG    8
+#define HMMER_READY_TAG          9
+
+/* mpi_failure()
+ * Generate an error message.  If the clients rank is not 0, a
+ * message is created with the error message and sent to the
+ * master process for handling.
+ */
+static void
+mpi_failure(char *format, ...)
+{
+  va_list  argp;
+  int      status = eslFAIL;
+  int      len;
+  int      rank;
+  char     str[512];
+
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  /* format the error mesg */
+  va_start(argp, format);
+  len = vsnprintf(str, sizeof(str), format, argp);
+  va_end(argp);
+
+  /* make sure the error string is terminated */
+  str[sizeof(str)-1] = '\0';
+
+  /* if the caller is the master, print the results and abort */
+  if (rank == 0)
+    {
+      if (fprintf(stderr, "\nError: ") < 0) exit(eslEWRITE);
+      if (fprintf(stderr, "%s", str)   < 0) exit(eslEWRITE);
+      if (fprintf(stderr, "\n")        < 0) exit(eslEWRITE);
+      fflush(stderr);
+
+      MPI_Abort(MPI_COMM_WORLD, status);
+      exit(1);
+    }
+  else
+    {
+      MPI_Send(str, len, MPI_CHAR, 0, HMMER_ERROR_TAG, MPI_COMM_WORLD);
+      pause();
+    }
+}
+
+/* mpi_recv_ready()
+ * Wait for the next message from any worker, which must be a
+ * message with tag <expect>; return the worker's rank.
+ */
 static int
-serial_loop(WORKER_INFO *info, P7_HMMFILE *hfp)
+mpi_recv_ready(int expect, char **mpi_buf, int *mpi_size)
+{
+  MPI_Status  mpistatus;
+  int         size;
+  int         dest;
+  int         status;
+
+  if (MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &mpistatus) != 0)
+    mpi_failure("MPI error %d receiving message from %d\n", mpistatus.MPI_SOURCE);
+
+  MPI_Get_count(&mpistatus, MPI_PACKED, &size);
+  if (*mpi_buf == NULL || size > *mpi_size) {
+    void *tmp;
+    ESL_RALLOC(*mpi_buf, tmp, sizeof(char) * size);
+    *mpi_size = size;
+  }
+
+  dest = mpistatus.MPI_SOURCE;
+  MPI_Recv(*mpi_buf, size, MPI_PACKED, dest, mpistatus.MPI_TAG, MPI_COMM_WORLD, &mpistatus);
+
+  if (mpistatus.MPI_TAG == HMMER_ERROR_TAG)
+    mpi_failure("MPI client %d raised error:\n%s\n", dest, *mpi_buf);
+  if (mpistatus.MPI_TAG != expect)
+    mpi_failure("Unexpected tag %d from %d\n", mpistatus.MPI_TAG, dest);
+
+  return dest;
+
+ ERROR:
+  mpi_failure("Failed to allocate MPI receive buffer\n");
+  return status;
+}
+
+#define MAX_BLOCK_SIZE (512*1024)
+
+/* this routine parses the database keeping track of the blocks
+ * offset within the file, number of models and the length
+ * of the block.  These blocks are passed as work units to the
+ * MPI workers.  If multiple sequences are in the query file, the
+ * blocks are reused without parsing the database a second time.
+ */
+static int
+next_block(P7_HMMFILE *hfp, BLOCK_LIST *list, MSV_BLOCK *block)
+{
+  P7_OPROFILE   *om       = NULL;
+  ESL_ALPHABET  *abc      = NULL;
+  int            status   = eslOK;
+
+  /* if the list has been calculated, use it instead of parsing the database */
+  if (list->complete)
+    {
+      if (list->current == list->last)
+        {
+          block->offset = 0;
+          block->length = 0;
+          block->count  = 0;
+
+          status = eslEOF;
+        }
+      else
+        {
+          int inx = list->current++;
+
+          block->offset = list->blocks[inx].offset;
+          block->length = list->blocks[inx].length;
+          block->count  = list->blocks[inx].count;
+
+          status = eslOK;
+        }
+
+      return status;
+    }
+
+  block->offset = 0;
+  block->length = 0;
+  block->count = 0;
+
+  while (block->length < MAX_BLOCK_SIZE && (status = p7_oprofile_ReadInfoMSV(hfp, &abc, &om)) == eslOK)
+    {
+      if (block->count == 0) block->offset = om->roff;
+      block->length = om->eoff - block->offset + 1;
+      block->count++;
+      p7_oprofile_Destroy(om);
+    }
+
+  if (status == eslEOF && block->count > 0) status = eslOK;
+  if (status == eslEOF) list->complete = 1;
+
+  /* add the block to the list of known blocks */
+  if (status == eslOK)
+    {
+      int inx;
+
+      if (list->last >= list->size)
+        {
+          void *tmp;
+          list->size += 500;
+          ESL_RALLOC(list->blocks, tmp, sizeof(MSV_BLOCK) * list->size);
+        }
+
+      inx = list->last++;
+      list->blocks[inx].offset = block->offset;
+      list->blocks[inx].length = block->length;
+      list->blocks[inx].count  = block->count;
+    }
+
+  esl_alphabet_Destroy(abc);
+  return status;
+
+ ERROR:
+  esl_alphabet_Destroy(abc);
+  return eslEMEM;
+}
+
+/* mpi_loop()
+ * The MPI master's counterpart of serial_loop(): hand out blocks of
+ * models from the pressed database <hfp> to workers as they become
+ * ready, then collect and merge each worker's hits and pipeline
+ * statistics into <info>. The workers read the query sequence
+ * themselves, in step with the master.
+ *
+ * Returns <eslEOF> when all models have been searched, or the
+ * error status from reading the database.
+ */
+static int
+mpi_loop(WORKER_INFO *info, P7_HMMFILE *hfp, BLOCK_LIST *list, struct cfg_s *cfg, ESL_GETOPTS *go, char **mpi_buf, int *mpi_size)
+{
+  MSV_BLOCK    block;
+  int          hstatus;
+  int          status;
+  int          dest;
+  int          i;
+
+  list->current = 0;
+
+  /* account for the reverse strand, as serial_loop() does */
+  if (info->pli->strands != p7_STRAND_TOPONLY && info->qsq->abc->complement != NULL)
+    info->pli->nres += info->qsq->n;
+
+  /* Main loop: */
+  while ((hstatus = next_block(hfp, list, &block)) == eslOK)
+    {
+      dest = mpi_recv_ready(HMMER_READY_TAG, mpi_buf, mpi_size);
+      MPI_Send(&block, 3, MPI_LONG_LONG_INT, dest, HMMER_BLOCK_TAG, MPI_COMM_WORLD);
+    }
+  if (hstatus != eslEOF) return hstatus;
+
+  block.offset = 0;
+  block.length = 0;
+  block.count  = 0;
+
+  /* wait for all workers to finish up their work blocks */
+  for (i = 1; i < cfg->nproc; ++i)
+    mpi_recv_ready(HMMER_READY_TAG, mpi_buf, mpi_size);
+
+  /* merge the results of the search results */
+  for (dest = 1; dest < cfg->nproc; ++dest)
+    {
+      P7_PIPELINE     *mpi_pli   = NULL;
+      P7_TOPHITS      *mpi_th    = NULL;
+
+      /* send an empty block to signal the worker they are done */
+      MPI_Send(&block, 3, MPI_LONG_LONG_INT, dest, HMMER_BLOCK_TAG, MPI_COMM_WORLD);
+
+      /* wait for the results */
+      if ((status = p7_tophits_MPIRecv(dest, HMMER_TOPHITS_TAG, MPI_COMM_WORLD, mpi_buf, mpi_size, &mpi_th)) != eslOK)
+        mpi_failure("Unexpected error %d receiving tophits from %d", status, dest);
+
+      if ((status = p7_pipeline_MPIRecv(dest, HMMER_PIPELINE_TAG, MPI_COMM_WORLD, mpi_buf, mpi_size, go, &mpi_pli)) != eslOK)
+        mpi_failure("Unexpected error %d receiving pipeline from %d", status, dest);
+
+      p7_tophits_Merge(info->th, mpi_th);
+      p7_pipeline_Merge(info->pli, mpi_pli);
+
+      p7_pipeline_Destroy(mpi_pli);
+      p7_tophits_Destroy(mpi_th);
+    }
+
+  return hstatus;
+}
+
+/* mpi_terminate()
+ * After the last query, wait for every worker to reach the end of
+ * the query file too.
+ */
+static int
+mpi_terminate(struct cfg_s *cfg, char **mpi_buf, int *mpi_size)
+{
+  int i;
+
+  for (i = 1; i < cfg->nproc; ++i)
+    mpi_recv_ready(HMMER_TERMINATING_TAG, mpi_buf, mpi_size);
+
+  return eslOK;
+}
+
+/* mpi_worker()
+ * Read each query sequence, and search it against the blocks of
+ * models the master hands out, using serial_loop() on each block.
+ */
+static int
+mpi_worker(ESL_GETOPTS *go, struct cfg_s *cfg)
+{
+  int              seqfmt   = eslSQFILE_UNKNOWN; /* format of seqfile                               */
+  ESL_SQFILE      *sqfp     = NULL;              /* open seqfile                                    */
+  P7_HMMFILE      *hfp      = NULL;              /* open HMM database file                          */
+  ESL_ALPHABET    *abc      = NULL;              /* sequence alphabet                               */
+  P7_OPROFILE     *om       = NULL;              /* target profile                                  */
+  ESL_SQ          *qsq      = NULL;              /* query sequence                                  */
+  WORKER_INFO      info;
+  int              status   = eslOK;
+  int              hstatus  = eslOK;
+  int              sstatus  = eslOK;
+
+  char            *mpi_buf  = NULL;              /* buffer used to pack/unpack structures */
+  int              mpi_size = 0;                 /* size of the allocated buffer */
+
+  MPI_Status       mpistatus;
+  char             errbuf[eslERRBUFSIZE];
+
+  if (esl_opt_IsOn(go, "--qformat")) {
+    seqfmt = esl_sqio_EncodeFormat(esl_opt_GetString(go, "--qformat"));
+    if (seqfmt == eslSQFILE_UNKNOWN) mpi_failure("%s is not a recognized input sequence file format\n", esl_opt_GetString(go, "--qformat"));
+  }
+
+  /* Open the target profile database to get the sequence alphabet */
+  status = p7_hmmfile_OpenE(cfg->hmmfile, p7_HMMDBENV, &hfp, errbuf);
+  if      (status == eslENOTFOUND) mpi_failure("File existence/permissions problem in trying to open HMM file %s.\n%s\n", cfg->hmmfile, errbuf);
+  else if (status == eslEFORMAT)   mpi_failure("File format problem in trying to open HMM file %s.\n%s\n",                cfg->hmmfile, errbuf);
+  else if (status != eslOK)        mpi_failure("Unexpected error %d in opening HMM file %s.\n%s\n",               status, cfg->hmmfile, errbuf);  
+  if (! hfp->is_pressed)           mpi_failure("Failed to open binary dbs for HMM file %s: use hmmpress first\n",         hfp->fname);
+
+  hstatus = p7_oprofile_ReadMSV(hfp, &abc, &om);
+  if      (hstatus == eslEFORMAT)   mpi_failure("bad file format in HMM file %s",             cfg->hmmfile);
+  else if (hstatus == eslEINCOMPAT) mpi_failure("HMM file %s contains different alphabets",   cfg->hmmfile);
+  else if (hstatus != eslOK)        mpi_failure("Unexpected error in reading HMMs from %s",   cfg->hmmfile); 
+
+  p7_oprofile_Destroy(om);
+  p7_hmmfile_Close(hfp);
+
+  /* Open the query sequence database */
+  status = esl_sqfile_OpenDigital(abc, cfg->seqfile, seqfmt, NULL, &sqfp);
+  if      (status == eslENOTFOUND) mpi_failure("Failed to open sequence file %s for reading\n",      cfg->seqfile);
+  else if (status == eslEFORMAT)   mpi_failure("Sequence file %s is empty or misformatted\n",        cfg->seqfile);
+  else if (status == eslEINVAL)    mpi_failure("Can't autodetect format of a stdin or .gz seqfile");
+  else if (status != eslOK)        mpi_failure("Unexpected error %d opening sequence file %s\n", status, cfg->seqfile);
+
+  qsq = esl_sq_CreateDigital(abc);
+
+  /* set up the null model(s) as serial_master() does */
+  info.bg         = p7_bg_Create(abc);
+  info.bg_default = NULL;
+  if (esl_opt_IsOn(go, "--bgfile")) {
+    info.bg_default = p7_bg_Create(abc);
+    if (p7_bg_Read(esl_opt_GetString(go, "--bgfile"), info.bg, errbuf) != eslOK) mpi_failure("Trouble reading bgfile: %s\n", errbuf);
+  }
+#ifdef HMMER_THREADS
+  info.queue = NULL;
+#endif
+  ESL_ALLOC(info.scores, sizeof(float) * abc->Kp * 16);
+
+  /* Outside loop: over each query sequence in <seqfile>. */
+  while ((sstatus = esl_sqio_Read(sqfp, qsq)) == eslOK)
+    {
+      MSV_BLOCK        block;
+
+      status = 0;
+      MPI_Send(&status, 1, MPI_INT, 0, HMMER_READY_TAG, MPI_COMM_WORLD);
+
+      /* Open the target profile database */
+      status = p7_hmmfile_OpenE(cfg->hmmfile, p7_HMMDBENV, &hfp, NULL);
+      if (status != eslOK) mpi_failure("Unexpected error %d in opening hmm file %s.\n", status, cfg->hmmfile);  
+
+      /* Create processing pipeline and hit list */
+      info.th  = p7_tophits_Create();
+      info.pli = p7_pipeline_Create(go, 100, 100, TRUE, p7_SCAN_MODELS); /* M_hint = 100, L_hint = 100 are just dummies for now */
+      info.pli->hfp = hfp;  /* for two-stage input, pipeline needs <hfp> */
+
+      p7_pli_NewSeq(info.pli, qsq);
+      info.qsq = qsq;
+
+      if (  esl_opt_IsUsed(go, "--watson") )
+        info.pli->strands = p7_STRAND_TOPONLY;
+      else if (  esl_opt_IsUsed(go, "--crick") )
+        info.pli->strands = p7_STRAND_BOTTOMONLY;
+      else
+        info.pli->strands = p7_STRAND_BOTH;
+
+      info.fwd_emissions = NULL;
+
+      /* receive a model block from the master */
+      MPI_Recv(&block, 3, MPI_LONG_LONG_INT, 0, HMMER_BLOCK_TAG, MPI_COMM_WORLD, &mpistatus);
+      while (block.count > 0)
+        {
+          uint64_t nmodels = info.pli->nmodels;
+
+          hstatus = p7_oprofile_Position(hfp, block.offset);
+          if (hstatus != eslOK) mpi_failure("Cannot position optimized model to %ld\n", block.offset);
+
+          hstatus = serial_loop(&info, hfp, block.count);
+
+          /* lets do a little bit of sanity checking here to make sure the blocks are the same */
+          if (info.pli->nmodels - nmodels != block.count)
+            {
+              switch(hstatus)
+                {
+                case eslEFORMAT:
+                  mpi_failure("bad file format in HMM file %s",              cfg->hmmfile);
+                  break;
+                case eslEINCOMPAT:
+                  mpi_failure("HMM file %s contains different alphabets",    cfg->hmmfile);
+                  break;
+                case eslOK:
+                case eslEOF:
+                  mpi_failure("Block count mismatch - expected %ld found %ld at offset %ld\n", block.count, info.pli->nmodels - nmodels, block.offset);
+                  break;
+                default:
+                  mpi_failure("Unexpected error %d in reading HMMs from %s", hstatus, cfg->hmmfile); 
+                }
+            }
+
+          /* inform the master we need another block of models */
+          status = 0;
+          MPI_Send(&status, 1, MPI_INT, 0, HMMER_READY_TAG, MPI_COMM_WORLD);
+
+          /* wait for the next block of models */
+          MPI_Recv(&block, 3, MPI_LONG_LONG_INT, 0, HMMER_BLOCK_TAG, MPI_COMM_WORLD, &mpistatus);
+        }
+
+      /* Send the top hits back to the master. */
+      p7_tophits_MPISend(info.th, 0, HMMER_TOPHITS_TAG, MPI_COMM_WORLD,  &mpi_buf, &mpi_size);
+      p7_pipeline_MPISend(info.pli, 0, HMMER_PIPELINE_TAG, MPI_COMM_WORLD,  &mpi_buf, &mpi_size);
+
+      p7_hmmfile_Close(hfp);
+      p7_pipeline_Destroy(info.pli);
+      p7_tophits_Destroy(info.th);
+      esl_sq_Reuse(qsq);
+    } /* end outer loop over query sequences */
+  if (sstatus == eslEFORMAT) 
+    mpi_failure("Parse failed (sequence file %s):\n%s\n", sqfp->filename, esl_sqfile_GetErrorBuf(sqfp));
+  else if (sstatus != eslEOF)
+    mpi_failure("Unexpected error %d reading sequence file %s", sstatus, sqfp->filename);
+
+  status = 0;
+  MPI_Send(&status, 1, MPI_INT, 0, HMMER_TERMINATING_TAG, MPI_COMM_WORLD);
+
+  if (mpi_buf != NULL) free(mpi_buf);
+
+  free(info.scores);
+  p7_bg_Destroy(info.bg);
+  p7_bg_Destroy(info.bg_default);
+
+  esl_sq_Destroy(qsq);
+  esl_alphabet_Destroy(abc);
+  esl_sqfile_Close(sqfp);
+
+  return eslOK;
+
+ ERROR:
+  mpi_failure("Failed to allocate worker score arrays\n");
+  return status;
+}
+#endif /*HMMER_MPI*/
+
+/* serial_loop()
+ * Search the query against up to <nmodels> models (-1 = all) read
+ * from the current position of <hfp>. May be called repeatedly on
+ * the same <info> (as an MPI worker does, once per block of models);
+ * only hits added by this call get their E-value corrections.
+ */
+static int
+serial_loop(WORKER_INFO *info, P7_HMMFILE *hfp, int nmodels)
 {
   int            status;
   int i;
   int seq_len = 0;
-  int prev_hit_cnt = 0;
+  int prev_hit_cnt = info->th->N;
   P7_OPROFILE   *om        = NULL;
   P7_SCOREDATA  *scoredata = NULL;   /* hmm-specific data used by nhmmer */
   ESL_ALPHABET  *abc = NULL;
@@ -631,7 +1172,7 @@ serial_loop(WORKER_INFO *info, P7_HMMFILE *hfp)
   }
 
   /* Main loop: */
-  while ((status = p7_oprofile_ReadMSV(hfp, &abc, &om)) == eslOK)
+  while ((nmodels == -1 || nmodels-- > 0) && (status = p7_oprofile_ReadMSV(hfp, &abc, &om)) == eslOK)
   {
       seq_len = 0;
 
@@ -691,6 +1232,7 @@ serial_loop(WORKER_INFO *info, P7_HMMFILE *hfp)
   esl_alphabet_Destroy(abc);
   esl_sq_Destroy(sq_revcmp);
   if (info->fwd_emissions) free(info->fwd_emissions);
+  info->fwd_emissions = NULL;
 
 ERROR:
   return status;
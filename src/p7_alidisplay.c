@@ -47,8 +47,15 @@
  *            which    - domain number, 0..tr->ndom-1
  *            om       - optimized profile (query)
  *            sq       - digital sequence (target)
- *            ntsq     - text sequence (original nucleotide target in the case of translated search)
- *            ddef_app - optional posterior prob alignment line; only nhmmer sends a not-NULL value
+ *            ntsq     - original nucleotide target, in a translated search; else NULL
+ *
+ *            In a translated search, <sq> is an ORF of DNA sequence
+ *            <ntsq>, as returned by <p7_orfscan_Next()>. The
+ *            alignment display then names the DNA sequence as its
+ *            target, and its <ntseq> line holds each aligned
+ *            residue's codon. Its coordinates are still those in
+ *            the ORF; the search pipeline maps them to the DNA
+ *            sequence once domains are scored.
  *
  * Returns:   <eslOK> on success.
  *
@@ -57,6 +64,32 @@
  */
 P7_ALIDISPLAY *
 p7_alidisplay_Create(const P7_TRACE *tr, int which, const P7_OPROFILE *om, const ESL_SQ *sq, const ESL_SQ *ntsq)
+{
+  return p7_alidisplay_CreateInArena(tr, which, om, sq, ntsq, NULL);
+}
+
+
+/* Function:  p7_alidisplay_CreateInArena()
+ * Synopsis:  Create an alignment display in an arena.
+ *
+ * Purpose:   Same as <p7_alidisplay_Create()>, but allocate the
+ *            display from arena <ar>, in one piece: the
+ *            <P7_ALIDISPLAY> itself followed by its <mem>. If <ar> is
+ *            <NULL>, the display is <malloc()>'ed, exactly as
+ *            <p7_alidisplay_Create()> does.
+ *
+ *            A display in an arena belongs to the arena. Caller must
+ *            not <p7_alidisplay_Destroy()> it; it is freed when <ar>
+ *            is.
+ *
+ * Returns:   pointer to the new <P7_ALIDISPLAY>.
+ *
+ * Throws:    <NULL> on allocation failure, or if something's
+ *            internally corrupt in the data. Anything allocated
+ *            from <ar> stays there until <ar> is reused.
+ */
+P7_ALIDISPLAY *
+p7_alidisplay_CreateInArena(const P7_TRACE *tr, int which, const P7_OPROFILE *om, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_ARENA *ar)
 {
   P7_ALIDISPLAY *ad       = NULL;
   char          *Alphabet = om->abc->sym;
@@ -65,9 +98,11 @@ p7_alidisplay_Create(const P7_TRACE *tr, int which, const P7_OPROFILE *om, const
   int            k,x,i,s;
   int            hmm_namelen, hmm_acclen, hmm_desclen;
   int            sq_namelen,  sq_acclen,  sq_desclen;
+  int64_t        ntpos;
+  const ESL_DSQ *ntcmp    = NULL;
+  const ESL_SQ  *tsq      = (ntsq ? ntsq : sq); /* target, as named in the display */
   int            status;
-  ESL_SQ         *ntorfseqtxt = NULL;
-  
+
   /* First figure out which piece of the trace (from first match to last match) 
    * we're going to represent, and how big it is.
    */
@@ -107,16 +142,26 @@ p7_alidisplay_Create(const P7_TRACE *tr, int which, const P7_OPROFILE *om, const
   hmm_acclen  = (om->acc  != NULL ? strlen(om->acc)  : 0);  n += hmm_acclen  + 1;
   hmm_desclen = (om->desc != NULL ? strlen(om->desc) : 0);  n += hmm_desclen + 1;
 
-  sq_namelen  = strlen(sq->name);                           n += sq_namelen  + 1;	  
-  sq_acclen   = strlen(sq->acc);                            n += sq_acclen   + 1; /* sq->acc is "\0" when unset */
-  sq_desclen  = strlen(sq->desc);                           n += sq_desclen  + 1; /* same for desc              */
+  if (ntsq      != NULL) n += 3*(z2-z1+1)+1; /* optional codons, in a translated search */
+  sq_namelen  = strlen(tsq->name);                          n += sq_namelen  + 1;	  
+  sq_acclen   = strlen(tsq->acc);                           n += sq_acclen   + 1; /* sq->acc is "\0" when unset */
+  sq_desclen  = strlen(tsq->desc);                          n += sq_desclen  + 1; /* same for desc              */
  
-  ESL_ALLOC(ad, sizeof(P7_ALIDISPLAY));
-  ad->mem = NULL;
+  if (ar)
+    {
+      if ((ad = p7_arena_Alloc(ar, sizeof(P7_ALIDISPLAY) + sizeof(char) * n)) == NULL) { status = eslEMEM; goto ERROR; }
+      ad->memsize = sizeof(char) * n;
+      ad->mem     = (char *) ad + sizeof(P7_ALIDISPLAY);
+    }
+  else
+    {
+      ESL_ALLOC(ad, sizeof(P7_ALIDISPLAY));
+      ad->mem = NULL;
+      ad->memsize = sizeof(char) * n;
+      ESL_ALLOC(ad->mem, ad->memsize);
+    }
 
   pos = 0; 
-  ad->memsize = sizeof(char) * n;
-  ESL_ALLOC(ad->mem, ad->memsize);
   if (om->rf[0]  != 0) { ad->rfline = ad->mem + pos; pos += z2-z1+2; } else { ad->rfline = NULL; }
   //if (om->mm[0]  != 0) { ad->mmline = ad->mem + pos; pos += z2-z1+2; } else { ad->mmline = NULL; }
   ad->mmline = NULL;
@@ -126,6 +171,7 @@ p7_alidisplay_Create(const P7_TRACE *tr, int which, const P7_OPROFILE *om, const
   ad->aseq    = ad->mem + pos;  pos += z2-z1+2;
 
   if (tr->pp != NULL)  { ad->ppline = ad->mem + pos;  pos += z2-z1+2;} else { ad->ppline = NULL; }
+  if (ntsq   != NULL)  { ad->ntseq  = ad->mem + pos;  pos += 3*(z2-z1+1)+1;} else { ad->ntseq = NULL; }
   ad->hmmname = ad->mem + pos;  pos += hmm_namelen +1;
   ad->hmmacc  = ad->mem + pos;  pos += hmm_acclen +1;
   ad->hmmdesc = ad->mem + pos;  pos += hmm_desclen +1;
@@ -137,9 +183,9 @@ p7_alidisplay_Create(const P7_TRACE *tr, int which, const P7_OPROFILE *om, const
   if (om->acc  != NULL) strcpy(ad->hmmacc,  om->acc);  else ad->hmmacc[0]  = 0;
   if (om->desc != NULL) strcpy(ad->hmmdesc, om->desc); else ad->hmmdesc[0] = 0;
 
-  strcpy(ad->sqname,  sq->name);
-  strcpy(ad->sqacc,   sq->acc);
-  strcpy(ad->sqdesc,  sq->desc);
+  strcpy(ad->sqname,  tsq->name);
+  strcpy(ad->sqacc,   tsq->acc);
+  strcpy(ad->sqdesc,  tsq->desc);
 
   /* Determine hit coords */
   ad->hmmfrom = tr->k[z1];
@@ -213,13 +259,28 @@ p7_alidisplay_Create(const P7_TRACE *tr, int which, const P7_OPROFILE *om, const
   ad->aseq  [z2-z1+1] = '\0';
   ad->N = z2-z1+1;
 
-  esl_sq_Destroy(ntorfseqtxt);  
+  /* optional codon line, in a translated search: each aligned residue's
+   * codon, lower case for insertions; "---" for deletions.
+   */
+  if (ad->ntseq != NULL) {
+    if (sq->start > sq->end) ntcmp = ntsq->abc->complement;
+    for (z = z1; z <= z2; z++)
+      {
+	if (tr->st[z] == p7T_D) { memcpy(ad->ntseq + 3*(z-z1), "---", 3); continue; }
+	ntpos = p7_orfscan_CodonStart(sq, tr->i[z]);
+	for (x = 0; x < 3; x++)
+	  {
+	    s = (ntcmp ? ntcmp[ntsq->dsq[ntpos-x]] : ntsq->dsq[ntpos+x]);
+	    ad->ntseq[3*(z-z1)+x] = (tr->st[z] == p7T_I ? tolower(ntsq->abc->sym[s]) : toupper(ntsq->abc->sym[s]));
+	  }
+      }
+    ad->ntseq[3*(z2-z1+1)] = '\0';
+  }
 
-	
   return ad;
 
  ERROR:
-  p7_alidisplay_Destroy(ad);
+  if (! ar) p7_alidisplay_Destroy(ad);
   return NULL;
 }
 
@@ -313,6 +374,55 @@ p7_alidisplay_Clone(const P7_ALIDISPLAY *ad)
 }
 
 
+/* Function:  p7_alidisplay_CloneInArena()
+ * Synopsis:  Make a duplicate of an ALIDISPLAY in an arena.
+ *
+ * Purpose:   Create a duplicate of alignment display <ad> (serialized
+ *            or not), allocating it from arena <ar>, and return a
+ *            pointer to the duplicate. The duplicate is in serialized
+ *            form, in one allocation: the <P7_ALIDISPLAY> itself,
+ *            followed by its <mem>.
+ *
+ *            The duplicate belongs to the arena. Caller must not
+ *            <p7_alidisplay_Destroy()> or <p7_alidisplay_Deserialize()>
+ *            it; it is freed when <ar> is.
+ *
+ * Returns:   pointer to new <P7_ALIDISPLAY>
+ *
+ * Throws:    <NULL> on allocation failure.
+ */
+P7_ALIDISPLAY *
+p7_alidisplay_CloneInArena(const P7_ALIDISPLAY *ad, P7_ARENA *ar)
+{
+  P7_ALIDISPLAY *ad2 = NULL;
+  size_t         n   = p7_alidisplay_Sizeof(ad);
+  int            pos;
+
+  if ((ad2 = p7_arena_Alloc(ar, n)) == NULL) return NULL;
+  *ad2         = *ad;		/* copies N, M, coords; pointers are reset below */
+  ad2->memsize = n - sizeof(P7_ALIDISPLAY);
+  ad2->mem     = (char *) ad2 + sizeof(P7_ALIDISPLAY);
+
+  /* same layout as p7_alidisplay_Serialize() */
+  pos = 0;
+  if (ad->rfline) { memcpy(ad2->mem+pos, ad->rfline, ad->N+1); ad2->rfline = ad2->mem+pos;  pos += ad->N+1; }
+  if (ad->mmline) { memcpy(ad2->mem+pos, ad->mmline, ad->N+1); ad2->mmline = ad2->mem+pos;  pos += ad->N+1; }
+  if (ad->csline) { memcpy(ad2->mem+pos, ad->csline, ad->N+1); ad2->csline = ad2->mem+pos;  pos += ad->N+1; }
+  memcpy(ad2->mem+pos, ad->model, ad->N+1); ad2->model = ad2->mem+pos; pos += ad->N+1;
+  memcpy(ad2->mem+pos, ad->mline, ad->N+1); ad2->mline = ad2->mem+pos; pos += ad->N+1;
+  memcpy(ad2->mem+pos, ad->aseq,  ad->N+1); ad2->aseq  = ad2->mem+pos; pos += ad->N+1;
+  if (ad->ntseq)  { memcpy(ad2->mem+pos, ad->ntseq, (3*ad->N)+1); ad2->ntseq  = ad2->mem+pos; pos += (3*ad->N)+1; }
+  if (ad->ppline) { memcpy(ad2->mem+pos, ad->ppline, ad->N+1);    ad2->ppline = ad2->mem+pos; pos += ad->N+1; }
+  n = 1 + strlen(ad->hmmname);  memcpy(ad2->mem+pos, ad->hmmname, n); ad2->hmmname = ad2->mem+pos; pos += n;
+  n = 1 + strlen(ad->hmmacc);   memcpy(ad2->mem+pos, ad->hmmacc,  n); ad2->hmmacc  = ad2->mem+pos; pos += n;
+  n = 1 + strlen(ad->hmmdesc);  memcpy(ad2->mem+pos, ad->hmmdesc, n); ad2->hmmdesc = ad2->mem+pos; pos += n;
+  n = 1 + strlen(ad->sqname);   memcpy(ad2->mem+pos, ad->sqname,  n); ad2->sqname  = ad2->mem+pos; pos += n;
+  n = 1 + strlen(ad->sqacc);    memcpy(ad2->mem+pos, ad->sqacc,   n); ad2->sqacc   = ad2->mem+pos; pos += n;
+  n = 1 + strlen(ad->sqdesc);   memcpy(ad2->mem+pos, ad->sqdesc,  n); ad2->sqdesc  = ad2->mem+pos; pos += n;
+  return ad2;
+}
+
+
 /* Function:  p7_alidisplay_Sizeof()
  * Synopsis:  Returns the total size of a P7_ALIDISPLAY, in bytes.
  *
@@ -516,6 +626,25 @@ integer_textwidth(long n)
   return w;
 }
 
+/* translated_spread()
+ * Copy up to <n> characters of display line <s> into <buf>,
+ * centering each in a three-character column to line up with
+ * its codon; '\0'-terminate <buf>.
+ */
+static void
+translated_spread(char *buf, const char *s, int n)
+{
+  int z;
+
+  for (z = 0; z < n && s[z] != '\0'; z++)
+    {
+      buf[3*z]   = ' ';
+      buf[3*z+1] = s[z];
+      buf[3*z+2] = ' ';
+    }
+  buf[3*z] = '\0';
+}
+
 
 /* Function:  p7_alidisplay_EncodePostProb()
  * Synopsis:  Convert a posterior probability to a char code.
@@ -588,11 +717,103 @@ int
 p7_alidisplay_Print(FILE *fp, P7_ALIDISPLAY *ad, int min_aliwidth, int linewidth, P7_PIPELINE *pli)
 {
    int status;
-   if ((status = p7_nontranslated_alidisplay_Print(fp, ad, min_aliwidth, linewidth, pli->show_accessions)) != eslOK) return status;
+   if (ad->ntseq != NULL) { if ((status = p7_translated_alidisplay_Print   (fp, ad, min_aliwidth, linewidth, pli))                   != eslOK) return status; }
+   else                   { if ((status = p7_nontranslated_alidisplay_Print(fp, ad, min_aliwidth, linewidth, pli->show_accessions)) != eslOK) return status; }
 
 	return status;
 }
 
+/* Function:  p7_translated_alidisplay_Print()
+ * Synopsis:  Human readable output of a translated <P7_ALIDISPLAY>
+ *
+ * Purpose:   Prints alignment <ad> of a translated search to stream
+ *            <fp>. Each alignment column is three characters wide:
+ *            the model and target residues are centered over the
+ *            target's codon, shown on an extra line below them. The
+ *            target's coordinates are nucleotide coordinates, on the
+ *            reverse strand if <ad->sqfrom> > <ad->sqto>.
+ *
+ *            Line width is handled as for
+ *            <p7_nontranslated_alidisplay_Print()>, counting three
+ *            characters per alignment column.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEWRITE> on write error, such as filling the disk.
+ */
+int
+p7_translated_alidisplay_Print(FILE *fp, P7_ALIDISPLAY *ad, int min_aliwidth, int linewidth, P7_PIPELINE *pli)
+{
+  char *buf          = NULL;
+  char *show_hmmname = NULL;
+  char *show_seqname = NULL;
+  int   namewidth, coordwidth, aliwidth;
+  int   pos;
+  int   status;
+  int   ni, nk;
+  int   z;
+  long  i1,i2;
+  int   k1,k2;
+
+  /* implement the --acc option for preferring accessions over names in output  */
+  show_hmmname = (pli->show_accessions && ad->hmmacc[0] != '\0') ? ad->hmmacc : ad->hmmname;
+  show_seqname = (pli->show_accessions && ad->sqacc[0]  != '\0') ? ad->sqacc  : ad->sqname;
+      
+  /* dynamically size the output lines; aliwidth counts columns, three chars each */
+  namewidth  = ESL_MAX(strlen(show_hmmname), strlen(show_seqname));
+  coordwidth = ESL_MAX(ESL_MAX(integer_textwidth(ad->hmmfrom),
+                              integer_textwidth(ad->hmmto)),
+                      ESL_MAX(integer_textwidth(ad->sqfrom),
+                              integer_textwidth(ad->sqto)));
+
+  aliwidth   = (linewidth > 0) ? (linewidth - namewidth - 2*coordwidth - 5) / 3 : ad->N;
+  if (aliwidth < ad->N && aliwidth < min_aliwidth) aliwidth = min_aliwidth; /* at least, regardless of some silly linewidth setting */
+  ESL_ALLOC(buf, sizeof(char) * (3*aliwidth+1));
+
+  /* Break the alignment into multiple blocks of width aliwidth for printing */
+  i1 = ad->sqfrom;
+  k1 = ad->hmmfrom;
+  for (pos = 0; pos < ad->N; pos += aliwidth)
+    {
+      if (pos > 0) { if (fprintf(fp, "\n") < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "alignment display write failed"); } /* blank line betweeen blocks */
+
+      ni = nk = 0; 
+      for (z = pos; z < pos + aliwidth && z < ad->N; z++) {
+        if (ad->model[z] != '.') nk++; /* k advances except on insert states */
+        if (ad->aseq[z]  != '-') ni++; /* i advances a codon except on delete states */
+      }
+
+      k2 = k1+nk-1;
+      if (ad->sqfrom < ad->sqto) i2 = i1+3*ni-1;
+      else                       i2 = i1-3*ni+1; /* reverse strand */
+
+      if (ad->csline != NULL) { translated_spread(buf, ad->csline+pos, aliwidth); if (fprintf(fp, "  %*s %s CS\n", namewidth+coordwidth+1, "", buf) < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "alignment display write failed"); } 
+      if (ad->rfline != NULL) { translated_spread(buf, ad->rfline+pos, aliwidth); if (fprintf(fp, "  %*s %s RF\n", namewidth+coordwidth+1, "", buf) < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "alignment display write failed"); } 
+      if (ad->mmline != NULL) { translated_spread(buf, ad->mmline+pos, aliwidth); if (fprintf(fp, "  %*s %s MM\n", namewidth+coordwidth+1, "", buf) < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "alignment display write failed"); }
+
+      translated_spread(buf, ad->model+pos, aliwidth); if (fprintf(fp, "  %*s %*d %s %-*d\n", namewidth,  show_hmmname, coordwidth, k1, buf, coordwidth, k2) < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "alignment display write failed"); 
+      translated_spread(buf, ad->mline+pos, aliwidth); if (fprintf(fp, "  %*s %s\n", namewidth+coordwidth+1, " ", buf)                                       < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "alignment display write failed"); 
+      translated_spread(buf, ad->aseq+pos,  aliwidth); if (fprintf(fp, "  %*s %s\n", namewidth+coordwidth+1, " ", buf)                                       < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "alignment display write failed"); 
+
+      strncpy(buf, ad->ntseq+3*pos, 3*aliwidth); buf[3*aliwidth] = '\0';
+      if (ni > 0) { if (fprintf(fp, "  %*s %*ld %s %-*ld\n", namewidth, show_seqname, coordwidth, i1,  buf, coordwidth, i2)  < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "alignment display write failed");  }
+      else        { if (fprintf(fp, "  %*s %*s %s %*s\n",    namewidth, show_seqname, coordwidth, "-", buf, coordwidth, "-") < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "alignment display write failed");  }
+
+      if (ad->ppline != NULL)  { translated_spread(buf, ad->ppline+pos, aliwidth);  if (fprintf(fp, "  %*s %s PP\n", namewidth+coordwidth+1, "", buf)  < 0) ESL_XEXCEPTION_SYS(eslEWRITE, "alignment display write failed");  }
+
+      k1 += nk;
+      if   (ad->sqfrom < ad->sqto)  i1 += 3*ni;
+      else                          i1 -= 3*ni;  /* reverse strand */
+    }
+  fflush(fp);
+  free(buf);
+  return eslOK;
+
+ ERROR:
+  if (buf) free(buf);
+  return status;
+}
+
 /* Function:  p7_nontranslated_alidisplay_Print()
  * Synopsis:  Human readable output of <P7_ALIDISPLAY>
  *
@@ -1212,6 +1433,8 @@ utest_Serialize(ESL_RANDOMNESS *rng, int ntrials, int N)
   char          msg[] = "utest_Serialize failed";
   P7_ALIDISPLAY *ad   = NULL;
   P7_ALIDISPLAY *ad2  = NULL;
+  P7_ALIDISPLAY *ad3  = NULL;
+  P7_ARENA      *ar   = p7_arena_Create(0);
   int trial;
 
   for (trial = 0; trial < ntrials; trial++)
@@ -1219,9 +1442,13 @@ utest_Serialize(ESL_RANDOMNESS *rng, int ntrials, int N)
       if ( p7_alidisplay_Sample(rng, N, &ad) != eslOK) esl_fatal(msg);
       if ( (ad2 = p7_alidisplay_Clone(ad))   == NULL)  esl_fatal(msg);
       if ( p7_alidisplay_Compare(ad, ad2)    != eslOK) esl_fatal(msg);
+      if ( (ad3 = p7_alidisplay_CloneInArena(ad, ar)) == NULL)  esl_fatal(msg);
+      if ( p7_alidisplay_Compare(ad, ad3)    != eslOK) esl_fatal(msg);
 
       if ( p7_alidisplay_Serialize(ad)       != eslOK) esl_fatal(msg);
       if ( p7_alidisplay_Compare(ad, ad2)    != eslOK) esl_fatal(msg);
+      if ( (ad3 = p7_alidisplay_CloneInArena(ad, ar)) == NULL)  esl_fatal(msg);
+      if ( p7_alidisplay_Compare(ad, ad3)    != eslOK) esl_fatal(msg);
 
       if ( p7_alidisplay_Deserialize(ad)     != eslOK) esl_fatal(msg);
       if ( p7_alidisplay_Compare(ad, ad2)    != eslOK) esl_fatal(msg);
@@ -1229,6 +1456,7 @@ utest_Serialize(ESL_RANDOMNESS *rng, int ntrials, int N)
       p7_alidisplay_Destroy(ad);
       p7_alidisplay_Destroy(ad2);
     }
+  p7_arena_Destroy(ar);
   return;
 }
 
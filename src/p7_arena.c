@@ -0,0 +1,519 @@
+/* P7_ARENA: bump allocation for memory that is freed all at once.
+ *
+ * A hit list accumulates many small allocations (target names,
+ * accessions, descriptions, domain lists, alignment displays,
+ * per-position score arrays) that all live exactly as long as the
+ * list does. Allocating each with malloc() and releasing each with
+ * free() costs a lot in a big search, and scatters the hit data
+ * around the heap. An arena instead carves these allocations out of
+ * a few large blocks, and releases them all at once.
+ *
+ * An arena is not thread-safe. Each thread's hit list has its own,
+ * and arenas are joined when hit lists are merged.
+ *
+ * Contents:
+ *    1. The P7_ARENA object.
+ *    2. Unit tests.
+ *    3. Test driver.
+ */
+#include "p7_config.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "easel.h"
+
+#include "hmmer.h"
+
+#define p7_ARENA_ALIGN     16	          /* every allocation is aligned to this many bytes               */
+#define p7_ARENA_MINBLOCK  4096           /* smallest block we'll allocate, even if caller asks for less */
+#define p7_ARENA_MAXBLOCK  (16*1024*1024) /* geometric growth of new blocks stops here                   */
+
+/*****************************************************************
+ * 1. The P7_ARENA object.
+ *****************************************************************/
+
+/* Function:  p7_arena_Create()
+ * Synopsis:  Create a new, empty <P7_ARENA>.
+ *
+ * Purpose:   Create a new arena, whose first block will be
+ *            <minblock> bytes. No block is allocated until the
+ *            first call to <p7_arena_Alloc()>, so an arena that
+ *            is never used costs next to nothing. Blocks after the
+ *            first one double in size, up to a fixed maximum of 16MB.
+ *
+ * Returns:   a pointer to the new arena.
+ *
+ * Throws:    <NULL> on allocation failure.
+ */
+P7_ARENA *
+p7_arena_Create(size_t minblock)
+{
+  P7_ARENA *ar = NULL;
+  int       status;
+
+  ESL_ALLOC(ar, sizeof(P7_ARENA));
+  ar->blk       = NULL;
+  ar->blksize   = NULL;
+  ar->nblk      = 0;
+  ar->nblkalloc = 0;
+  ar->used      = 0;
+  ar->minblock  = ESL_MAX(minblock, p7_ARENA_MINBLOCK);
+  return ar;
+
+ ERROR:
+  p7_arena_Destroy(ar);
+  return NULL;
+}
+
+/* add_block()
+ * Make room for at least <n> more bytes, by starting a new block
+ * and making it the current one.
+ */
+static int
+add_block(P7_ARENA *ar, size_t n)
+{
+  void  *p;
+  size_t size;
+  int    status;
+
+  if (ar->nblk == ar->nblkalloc)
+    {
+      ESL_RALLOC(ar->blk,     p, sizeof(char *) * (ar->nblkalloc + 8));
+      ESL_RALLOC(ar->blksize, p, sizeof(size_t) * (ar->nblkalloc + 8));
+      ar->nblkalloc += 8;
+    }
+
+  size = (ar->nblk ? ESL_MIN(2 * ar->blksize[ar->nblk-1], p7_ARENA_MAXBLOCK) : ar->minblock);
+  size = ESL_MAX(size, ar->minblock);
+  size = ESL_MAX(size, n);
+
+  ESL_ALLOC(ar->blk[ar->nblk], sizeof(char) * size);
+  ar->blksize[ar->nblk] = size;
+  ar->nblk++;
+  ar->used = 0;
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+
+/* Function:  p7_arena_Alloc()
+ * Synopsis:  Allocate <n> bytes from an arena.
+ *
+ * Purpose:   Return a pointer to <n> bytes of uninitialized memory
+ *            carved from arena <ar>, aligned to a 16 byte boundary.
+ *            The memory remains valid until <ar> is reused or
+ *            destroyed (or, after <p7_arena_Merge()>, until the
+ *            arena it was merged into is). It must not be passed
+ *            to <free()>.
+ *
+ * Returns:   pointer to the memory.
+ *
+ * Throws:    <NULL> on allocation failure.
+ */
+void *
+p7_arena_Alloc(P7_ARENA *ar, size_t n)
+{
+  void *ptr;
+
+  n = (n + p7_ARENA_ALIGN - 1) & ~((size_t) p7_ARENA_ALIGN - 1);
+  if (n == 0) n = p7_ARENA_ALIGN;
+
+  if (ar->nblk == 0 || ar->used + n > ar->blksize[ar->nblk-1])
+    if (add_block(ar, n) != eslOK) return NULL;
+
+  ptr       = ar->blk[ar->nblk-1] + ar->used;
+  ar->used += n;
+  return ptr;
+}
+
+/* Function:  p7_arena_Strdup()
+ * Synopsis:  Duplicate a string into an arena.
+ *
+ * Purpose:   Like <esl_strdup()>, but the copy is allocated in
+ *            arena <ar>. Duplicate string <s> of length <n> (or,
+ *            if <n> is -1, <s> is \0-terminated and its length is
+ *            determined here) and return the copy in <*ret_dup>.
+ *            If <s> is <NULL>, <*ret_dup> is <NULL> too.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure, and <*ret_dup> is <NULL>.
+ */
+int
+p7_arena_Strdup(P7_ARENA *ar, const char *s, int64_t n, char **ret_dup)
+{
+  char *dup = NULL;
+
+  if (s != NULL)
+    {
+      if (n < 0) n = strlen(s);
+      if ((dup = p7_arena_Alloc(ar, sizeof(char) * (n+1))) == NULL) { *ret_dup = NULL; ESL_EXCEPTION(eslEMEM, "arena allocation failed"); }
+      memcpy(dup, s, n);
+      dup[n] = '\0';
+    }
+  *ret_dup = dup;
+  return eslOK;
+}
+
+/* Function:  p7_arena_Owns()
+ * Synopsis:  Test whether a pointer was allocated from an arena.
+ *
+ * Purpose:   Return <TRUE> if <p> points into memory allocated from
+ *            arena <ar>, <FALSE> otherwise. Objects whose parts may
+ *            have come either from an arena or from <malloc()> use
+ *            this to decide what to <free()>. <ar> may be <NULL>,
+ *            in which case the answer is <FALSE>.
+ */
+int
+p7_arena_Owns(const P7_ARENA *ar, const void *p)
+{
+  const char *c = (const char *) p;
+  int         b;
+
+  if (ar == NULL || p == NULL) return FALSE;
+  for (b = ar->nblk-1; b >= 0; b--)
+    if (c >= ar->blk[b] && c < ar->blk[b] + ar->blksize[b]) return TRUE;
+  return FALSE;
+}
+
+/* Function:  p7_arena_Merge()
+ * Synopsis:  Move all of one arena's memory into another.
+ *
+ * Purpose:   Transfer all blocks of arena <src> to <dst>, without
+ *            copying anything: pointers into <src>'s memory stay
+ *            valid, and are now owned by <dst>. <src> is left empty
+ *            and usable. <dst> keeps allocating from its own current
+ *            block.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure; both arenas are
+ *            unchanged.
+ */
+int
+p7_arena_Merge(P7_ARENA *dst, P7_ARENA *src)
+{
+  void  *p;
+  char  *curblk;
+  size_t cursize;
+  int    n;
+  int    status;
+
+  if (src == NULL || src->nblk == 0) return eslOK;
+
+  n = dst->nblk + src->nblk;
+  if (n > dst->nblkalloc)
+    {
+      ESL_RALLOC(dst->blk,     p, sizeof(char *) * n);
+      ESL_RALLOC(dst->blksize, p, sizeof(size_t) * n);
+      dst->nblkalloc = n;
+    }
+
+  if (dst->nblk == 0)
+    {	/* <dst> has nothing: adopt <src>'s current block as ours */
+      memcpy(dst->blk,     src->blk,     sizeof(char *) * src->nblk);
+      memcpy(dst->blksize, src->blksize, sizeof(size_t) * src->nblk);
+      dst->used = src->used;
+    }
+  else
+    {	/* slot <src>'s blocks in front of our current one */
+      curblk  = dst->blk[dst->nblk-1];
+      cursize = dst->blksize[dst->nblk-1];
+      memcpy(dst->blk     + dst->nblk-1, src->blk,     sizeof(char *) * src->nblk);
+      memcpy(dst->blksize + dst->nblk-1, src->blksize, sizeof(size_t) * src->nblk);
+      dst->blk[n-1]     = curblk;
+      dst->blksize[n-1] = cursize;
+    }
+  dst->nblk = n;
+
+  src->nblk = 0;
+  src->used = 0;
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+
+/* Function:  p7_arena_Sizeof()
+ * Synopsis:  Returns the allocated size of an arena, in bytes.
+ */
+size_t
+p7_arena_Sizeof(const P7_ARENA *ar)
+{
+  size_t n = sizeof(P7_ARENA);
+  int    b;
+
+  n += (sizeof(char *) + sizeof(size_t)) * ar->nblkalloc;
+  for (b = 0; b < ar->nblk; b++) n += ar->blksize[b];
+  return n;
+}
+
+/* Function:  p7_arena_Reuse()
+ * Synopsis:  Release everything allocated from an arena.
+ *
+ * Purpose:   Invalidate all memory allocated from <ar>, so it can be
+ *            reused. The largest block is kept, to be carved from
+ *            again; the others are freed.
+ *
+ * Returns:   <eslOK> on success.
+ */
+int
+p7_arena_Reuse(P7_ARENA *ar)
+{
+  int b, keep;
+
+  if (ar == NULL || ar->nblk == 0) return eslOK;
+
+  for (keep = 0, b = 1; b < ar->nblk; b++)
+    if (ar->blksize[b] > ar->blksize[keep]) keep = b;
+  for (b = 0; b < ar->nblk; b++)
+    if (b != keep) free(ar->blk[b]);
+
+  ar->blk[0]     = ar->blk[keep];
+  ar->blksize[0] = ar->blksize[keep];
+  ar->nblk       = 1;
+  ar->used       = 0;
+  return eslOK;
+}
+
+/* Function:  p7_arena_Mark()
+ * Synopsis:  Record an arena's current position.
+ *
+ * Purpose:   Record in <*mark> how much of arena <ar> is in use now,
+ *            so that everything allocated after this point can be
+ *            given back with <p7_arena_Release()>.
+ */
+void
+p7_arena_Mark(const P7_ARENA *ar, P7_ARENAMARK *mark)
+{
+  mark->nblk = ar->nblk;
+  mark->used = ar->used;
+}
+
+/* Function:  p7_arena_Release()
+ * Synopsis:  Give back everything allocated since a mark.
+ *
+ * Purpose:   Invalidate all memory allocated from <ar> since
+ *            <p7_arena_Mark()> recorded <mark>; what was allocated
+ *            before that stays valid. A caller uses this to discard
+ *            data it built tentatively, such as the alignment
+ *            displays of a target that didn't become a hit.
+ *
+ *            <ar> must not have been reused, released to an earlier
+ *            mark, or merged into since <mark> was recorded. 
+ *
+ *            If new blocks were started since the mark, the first
+ *            of them is kept as the current block; the others are
+ *            freed.
+ *
+ * Returns:   <eslOK> on success.
+ */
+int
+p7_arena_Release(P7_ARENA *ar, const P7_ARENAMARK *mark)
+{
+  int b;
+
+  if (ar->nblk > mark->nblk)
+    {
+      for (b = mark->nblk+1; b < ar->nblk; b++) free(ar->blk[b]);
+      ar->nblk = mark->nblk+1;
+      ar->used = 0;
+    }
+  else ar->used = mark->used;
+  return eslOK;
+}
+
+/* Function:  p7_arena_Destroy()
+ * Synopsis:  Frees an arena, and all memory allocated from it.
+ */
+void
+p7_arena_Destroy(P7_ARENA *ar)
+{
+  int b;
+
+  if (ar == NULL) return;
+  for (b = 0; b < ar->nblk; b++) free(ar->blk[b]);
+  if (ar->blk)     free(ar->blk);
+  if (ar->blksize) free(ar->blksize);
+  free(ar);
+}
+/*------------------ end, P7_ARENA object -----------------------*/
+
+
+
+/*****************************************************************
+ * 2. Unit tests
+ *****************************************************************/
+#ifdef p7ARENA_TESTDRIVE
+#include "esl_random.h"
+
+/* utest_alloc()
+ * Fill an arena with many allocations of random size, each stamped
+ * with a distinct byte; make sure they're aligned, owned, and that
+ * none of them clobbered another.
+ */
+static void
+utest_alloc(ESL_RANDOMNESS *rng, int N)
+{
+  char      *msg  = "p7_arena alloc unit test failed";
+  P7_ARENA  *ar   = p7_arena_Create(0);
+  char     **p    = malloc(sizeof(char *) * N);
+  int       *len  = malloc(sizeof(int)    * N);
+  char      *heap = malloc(16);
+  int        i, k;
+
+  for (i = 0; i < N; i++)
+    {
+      len[i] = esl_rnd_Roll(rng, 2000);   /* 0..1999; 0 is legal */
+      if ((p[i] = p7_arena_Alloc(ar, len[i])) == NULL) esl_fatal(msg);
+      if (((uintptr_t) p[i]) % p7_ARENA_ALIGN != 0)    esl_fatal(msg);
+      memset(p[i], i % 256, len[i]);
+    }
+
+  for (i = 0; i < N; i++)
+    {
+      if (! p7_arena_Owns(ar, p[i])) esl_fatal(msg);
+      for (k = 0; k < len[i]; k++)
+	if (p[i][k] != (char) (i % 256)) esl_fatal(msg);
+    }
+  if (p7_arena_Owns(ar, heap)) esl_fatal(msg);
+  if (p7_arena_Owns(NULL, p[0])) esl_fatal(msg);
+
+  p7_arena_Reuse(ar);
+  if (ar->nblk != 1 || ar->used != 0) esl_fatal(msg);
+  if (p7_arena_Alloc(ar, 100) == NULL) esl_fatal(msg);
+
+  p7_arena_Destroy(ar);
+  free(heap);
+  free(len);
+  free(p);
+}
+
+/* utest_merge()
+ * Strings duplicated into two arenas must survive merging one into
+ * the other and destroying the emptied one.
+ */
+static void
+utest_merge(int N)
+{
+  char      *msg  = "p7_arena merge unit test failed";
+  P7_ARENA  *a1   = p7_arena_Create(0);
+  P7_ARENA  *a2   = p7_arena_Create(0);
+  char     **s    = malloc(sizeof(char *) * 2 * N);
+  char       buf[32];
+  char      *nul;
+  int        i;
+
+  for (i = 0; i < 2*N; i++)
+    {
+      snprintf(buf, 32, "seq%d", i);
+      if (p7_arena_Strdup((i < N ? a1 : a2), buf, -1, &(s[i])) != eslOK) esl_fatal(msg);
+    }
+  if (p7_arena_Strdup(a1, NULL, -1, &nul) != eslOK || nul != NULL) esl_fatal(msg);
+
+  if (p7_arena_Merge(a1, a2) != eslOK) esl_fatal(msg);
+  if (a2->nblk != 0)                   esl_fatal(msg);
+  p7_arena_Destroy(a2);
+
+  for (i = 0; i < 2*N; i++)
+    {
+      snprintf(buf, 32, "seq%d", i);
+      if (strcmp(s[i], buf) != 0)    esl_fatal(msg);
+      if (! p7_arena_Owns(a1, s[i])) esl_fatal(msg);
+    }
+
+  /* a1 still allocates, after the merge */
+  if (p7_arena_Strdup(a1, "abc", 2, &nul) != eslOK || strcmp(nul, "ab") != 0) esl_fatal(msg);
+
+  p7_arena_Destroy(a1);
+  free(s);
+}
+
+/* utest_release()
+ * Allocations made before a mark survive releasing to it; the space
+ * allocated after it is handed out again.
+ */
+static void
+utest_release(ESL_RANDOMNESS *rng, int N)
+{
+  char         *msg = "p7_arena release unit test failed";
+  P7_ARENA     *ar  = p7_arena_Create(0);
+  P7_ARENAMARK  mark;
+  char         *s;
+  char         *p;
+  int           i, k;
+
+  if (p7_arena_Strdup(ar, "kept", -1, &s) != eslOK) esl_fatal(msg);
+  for (k = 0; k < 10; k++)
+    {
+      p7_arena_Mark(ar, &mark);
+      for (i = 0; i < N/10; i++)
+	{
+	  if ((p = p7_arena_Alloc(ar, esl_rnd_Roll(rng, 2000))) == NULL) esl_fatal(msg);
+	  memset(p, 0xff, 1);
+	}
+      p7_arena_Release(ar, &mark);
+      if (ar->nblk > mark.nblk+1)    esl_fatal(msg);
+      if (strcmp(s, "kept") != 0)    esl_fatal(msg);
+    }
+
+  /* with nothing allocated since the mark, the next allocation is where the released one was */
+  p7_arena_Mark(ar, &mark);
+  if ((p = p7_arena_Alloc(ar, 16)) == NULL) esl_fatal(msg);
+  p7_arena_Release(ar, &mark);
+  if (p7_arena_Alloc(ar, 16) != p)          esl_fatal(msg);
+
+  p7_arena_Destroy(ar);
+}
+#endif /*p7ARENA_TESTDRIVE*/
+/*-------------------- end, unit tests --------------------------*/
+
+
+
+/*****************************************************************
+ * 3. Test driver
+ *****************************************************************/
+#ifdef p7ARENA_TESTDRIVE
+/*
+  gcc -o p7_arena_utest -std=gnu99 -g -O2 -I. -L. -I../easel -L../easel -Dp7ARENA_TESTDRIVE p7_arena.c -lhmmer -leasel -lm
+  ./p7_arena_utest
+*/
+#include "p7_config.h"
+
+#include "easel.h"
+#include "esl_getopts.h"
+#include "esl_random.h"
+
+#include "hmmer.h"
+
+static ESL_OPTIONS options[] = {
+  /* name           type      default  env  range toggles reqs incomp  help                                       docgroup*/
+  { "-h",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "show brief help on version and usage",             0 },
+  { "-s",        eslARG_INT,     "42", NULL, NULL,  NULL,  NULL, NULL, "set random number seed to <n>",                    0 },
+  { "-N",        eslARG_INT,  "10000", NULL, NULL,  NULL,  NULL, NULL, "number of allocations to test",                    0 },
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+
+static char usage[]  = "[-options]";
+static char banner[] = "test driver for P7_ARENA";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go  = p7_CreateDefaultApp(options, 0, argc, argv, banner, usage);
+  ESL_RANDOMNESS *rng = esl_randomness_CreateFast(esl_opt_GetInteger(go, "-s"));
+  int             N   = esl_opt_GetInteger(go, "-N");
+
+  utest_alloc(rng, N);
+  utest_merge(N);
+  utest_release(rng, N);
+
+  esl_randomness_Destroy(rng);
+  esl_getopts_Destroy(go);
+  return eslOK;
+}
+#endif /*p7ARENA_TESTDRIVE*/
+/*-------------------- end, test driver -------------------------*/
@@ -466,18 +466,59 @@ p7_bg_SetFilter(P7_BG *bg, int M, const float *compo)
  *            The filter null model has no length distribution of its
  *            own; the same geometric length distribution (controlled
  *            by <bg->p1>) that the null1 model uses is imposed.
+ *
+ *            The Forward is the same scaled calculation as
+ *            <esl_hmm_Forward()>, in the same order of operations
+ *            (rows are scaled by multiplying by the float reciprocal of
+ *            their max, as <esl_vec_FScale()> does), so the score is
+ *            bit-identical to the old one; but it streams through <dsq> in
+ *            one pass keeping only the current row, two floats,
+ *            instead of allocating and filling an <L> x 2 matrix for
+ *            each sequence. This is run on every target that passes
+ *            the MSV filter.
  */
 int
 p7_bg_FilterScore(P7_BG *bg, const ESL_DSQ *dsq, int L, float *ret_sc)
 {
-  ESL_HMX *hmx = esl_hmx_Create(L, bg->fhmm->M); /* optimization target: this can be a 2-row matrix, and it can be stored in <bg>. */
-  float nullsc;		                  	 /* (or it could be passed in as an arg, but for sure it shouldn't be alloc'ed here */
-  
-  esl_hmm_Forward(dsq, L, bg->fhmm, hmx, &nullsc);
+  const ESL_HMM *fhmm  = bg->fhmm;
+  float          t00   = fhmm->t[0][0], t01 = fhmm->t[0][1];
+  float          t10   = fhmm->t[1][0], t11 = fhmm->t[1][1];
+  float          f0, f1;	/* scaled Forward values of states 0,1 on the current row */
+  float          p0, p1;	/*  ... and on the previous row                           */
+  float          max;
+  float          scale;		/* 1/max, as a float, as esl_vec_FScale() takes it       */
+  float          nullsc = 0.0;	/* sum of the log scale factors, as esl_hmm_Forward() */
+  int            i;
+
+  if (L == 0) 
+    nullsc = log(fhmm->pi[2]);
+  else
+    {
+      f0  = fhmm->eo[dsq[1]][0] * fhmm->pi[0];
+      f1  = fhmm->eo[dsq[1]][1] * fhmm->pi[1];
+      max = ESL_MAX(f0, f1);
+      scale = 1./max;
+      f0 *= scale;
+      f1 *= scale;
+      nullsc += (float) log(max);
+
+      for (i = 2; i <= L; i++)
+	{
+	  p0 = f0;
+	  p1 = f1;
+	  f0 = (p0 * t00 + p1 * t10) * fhmm->eo[dsq[i]][0];
+	  f1 = (p0 * t01 + p1 * t11) * fhmm->eo[dsq[i]][1];
+	  max = ESL_MAX(f0, f1);
+	  scale = 1./max;
+	  f0 *= scale;
+	  f1 *= scale;
+	  nullsc += (float) log(max);
+	}
+      nullsc += (float) log(f0 * fhmm->t[0][2] + f1 * fhmm->t[1][2]);
+    }
 
   /* impose the length distribution */
   *ret_sc = nullsc + (float) L * logf(bg->p1) + logf(1.-bg->p1);
-  esl_hmx_Destroy(hmx);
   return eslOK;
 }
 
@@ -497,6 +538,8 @@ p7_bg_FilterScore(P7_BG *bg, const ESL_DSQ *dsq, int L, float *ret_sc)
 #include "easel.h"
 #include "esl_alphabet.h"
 #include "esl_getopts.h"
+#include "esl_random.h"
+#include "esl_randomseq.h"
 #include "esl_sq.h"
 #include "esl_stopwatch.h"
 
@@ -522,8 +565,11 @@ main(int argc, char **argv)
   P7_HMMFILE     *hfp     = NULL;
   P7_HMM         *hmm     = NULL;
   P7_BG          *bg      = NULL;
+  ESL_RANDOMNESS *r       = esl_randomness_CreateFast(42);
+  ESL_DSQ        *dsq     = NULL;
   int             L       = esl_opt_GetInteger(go, "-L");
   int             N       = esl_opt_GetInteger(go, "-N");
+  float           sc;
   int             i;
  
   /* Read one HMM from <hmmfile> */
@@ -537,8 +583,22 @@ main(int argc, char **argv)
   for (i = 0; i < N; i++)
     p7_bg_SetFilterByHMM(bg, hmm);
   esl_stopwatch_Stop(w);
-  esl_stopwatch_Display(stdout, w, "# CPU time: ");
+  esl_stopwatch_Display(stdout, w, "# SetFilter CPU time:   ");
+
+  /* The filter score of <N> random seqs of length <L> */
+  p7_bg_SetLength(bg, L);
+  dsq = malloc(sizeof(ESL_DSQ) * (L+2));
+  esl_stopwatch_Start(w);
+  for (i = 0; i < N; i++)
+    {
+      esl_rsq_xfIID(r, bg->f, abc->K, L, dsq);
+      p7_bg_FilterScore(bg, dsq, L, &sc);
+    }
+  esl_stopwatch_Stop(w);
+  esl_stopwatch_Display(stdout, w, "# FilterScore CPU time: ");
 
+  free(dsq);
+  esl_randomness_Destroy(r);
   p7_bg_Destroy(bg);
   p7_hmm_Destroy(hmm);
   esl_alphabet_Destroy(abc);
@@ -555,6 +615,7 @@ main(int argc, char **argv)
 #ifdef p7BG_TESTDRIVE
 #include "esl_dirichlet.h"
 #include "esl_random.h"
+#include "esl_randomseq.h"
 
 static void
 utest_ReadWrite(ESL_RANDOMNESS *rng)
@@ -587,6 +648,50 @@ utest_ReadWrite(ESL_RANDOMNESS *rng)
   free(fq);
   remove(tmpfile);
 }
+
+/* utest_FilterScore()
+ * The streaming two-state Forward in p7_bg_FilterScore() must agree exactly
+ * with esl_hmm_Forward() on the filter HMM, plus the null1 length
+ * distribution, for random compositions and sequences (including
+ * degenerate residues).
+ */
+static void
+utest_FilterScore(ESL_RANDOMNESS *rng)
+{
+  char          msg[]  = "bg FilterScore unit test failed";
+  ESL_ALPHABET *abc    = NULL;
+  P7_BG        *bg     = NULL;
+  ESL_HMX      *hmx    = NULL;
+  ESL_DSQ      *dsq    = NULL;
+  float        *compo  = NULL;
+  int           L      = 1 + esl_rnd_Roll(rng, 1000);
+  int           M      = 1 + esl_rnd_Roll(rng, 300);
+  float         sc1, sc2;
+  int           i;
+
+  if ((abc   = esl_alphabet_Create(eslAMINO))                   == NULL)  esl_fatal(msg);
+  if ((bg    = p7_bg_Create(abc))                               == NULL)  esl_fatal(msg);
+  if ((compo = malloc(sizeof(float) * abc->K))                  == NULL)  esl_fatal(msg);
+  if ((dsq   = malloc(sizeof(ESL_DSQ) * (L+2)))                 == NULL)  esl_fatal(msg);
+  if ((hmx   = esl_hmx_Create(L, bg->fhmm->M))                  == NULL)  esl_fatal(msg);
+  if (esl_dirichlet_FSampleUniform(rng, abc->K, compo)          != eslOK) esl_fatal(msg);
+  if (p7_bg_SetFilter(bg, M, compo)                             != eslOK) esl_fatal(msg);
+  if (p7_bg_SetLength(bg, L)                                    != eslOK) esl_fatal(msg);
+  if (esl_rsq_xfIID(rng, compo, abc->K, L, dsq)                 != eslOK) esl_fatal(msg);
+  for (i = 1; i <= L; i++)
+    if (esl_rnd_Roll(rng, 50) == 0) dsq[i] = abc->Kp - 3;	/* the "any" residue, X for amino */
+
+  if (p7_bg_FilterScore(bg, dsq, L, &sc1)                       != eslOK) esl_fatal(msg);
+  if (esl_hmm_Forward(dsq, L, bg->fhmm, hmx, &sc2)              != eslOK) esl_fatal(msg);
+  sc2 = sc2 + (float) L * logf(bg->p1) + logf(1.-bg->p1);	/* exactly as p7_bg_FilterScore() imposes it */
+  if (sc1 != sc2)                                                         esl_fatal(msg);
+
+  esl_hmx_Destroy(hmx);
+  free(dsq);
+  free(compo);
+  p7_bg_Destroy(bg);
+  esl_alphabet_Destroy(abc);
+}
 #endif /*p7BG_TESTDRIVE*/
 
 
@@ -625,6 +730,7 @@ main(int argc, char **argv)
   if (be_verbose) printf("p7_bg unit test: rng seed %" PRIu32 "\n", esl_randomness_GetSeed(rng));
 
   utest_ReadWrite(rng);
+  utest_FilterScore(rng);
 
   esl_randomness_Destroy(rng);
   esl_getopts_Destroy(go);
@@ -15,7 +15,6 @@
 #include "esl_dmatrix.h"
 #include "esl_getopts.h"
 #include "esl_msa.h"
-#include "esl_msacluster.h"
 #include "esl_msaweight.h"
 #include "esl_random.h"
 #include "esl_vectorops.h"
@@ -92,6 +91,8 @@ p7_builder_Create(const ESL_GETOPTS *go, const ESL_ALPHABET *abc)
     }
 
   bld->max_insert_len = 0;
+  bld->clustcols      = 0;	/* exact single linkage clustering for --eclust, --wblosum */
+  bld->ncpus          = 0;	/* serial; applications that can spare threads for one build set this */
 
   /* The default RE target is alphabet dependent. */
   if (go != NULL &&  esl_opt_IsOn (go, "--ere")) 
@@ -367,6 +368,8 @@ p7_builder_Destroy(P7_BUILDER *bld)
 
 static int    validate_msa         (P7_BUILDER *bld, ESL_MSA *msa);
 static int    relative_weights     (P7_BUILDER *bld, ESL_MSA *msa);
+static int    blosum_weights       (P7_BUILDER *bld, ESL_MSA *msa);
+static int    cluster_msa          (P7_BUILDER *bld, const ESL_MSA *msa, double maxid, int **opt_c, int **opt_nin, int *ret_nc);
 static int    build_model          (P7_BUILDER *bld, ESL_MSA *msa, P7_HMM **ret_hmm, P7_TRACE ***opt_tr);
 static int    effective_seqnumber  (P7_BUILDER *bld, const ESL_MSA *msa, P7_HMM *hmm, const P7_BG *bg);
 static int    parameterize         (P7_BUILDER *bld, P7_HMM *hmm);
@@ -813,7 +816,7 @@ relative_weights(P7_BUILDER *bld, ESL_MSA *msa)
   else if (bld->wgt_strategy == p7_WGT_GIVEN)                   ;
   else if (bld->wgt_strategy == p7_WGT_PB)                      status = esl_msaweight_PB(msa); 
   else if (bld->wgt_strategy == p7_WGT_GSC)                     status = esl_msaweight_GSC(msa); 
-  else if (bld->wgt_strategy == p7_WGT_BLOSUM)                  status = esl_msaweight_BLOSUM(msa, bld->wid); 
+  else if (bld->wgt_strategy == p7_WGT_BLOSUM)                  status = blosum_weights(bld, msa);
   else ESL_EXCEPTION(eslEINCONCEIVABLE, "no such weighting strategy");
 
   if (status != eslOK) ESL_FAIL(status, bld->errbuf, "failed to set relative weights in alignment");
@@ -821,6 +824,79 @@ relative_weights(P7_BUILDER *bld, ESL_MSA *msa)
 }
 
 
+/* blosum_weights():
+ * BLOSUM weights, as esl_msaweight_BLOSUM() sets them, 1/(# of seqs in
+ * the sequence's single linkage cluster at <bld->wid>) normalized to sum
+ * to <nseq>; but clustered with p7_SingleLinkage(), which is faster on
+ * big alignments and can sample <bld->clustcols> columns.
+ */
+static int
+blosum_weights(P7_BUILDER *bld, ESL_MSA *msa)
+{
+  int *c   = NULL;
+  int *nin = NULL;
+  int  nc;
+  int  i;
+  int  status;
+
+  if (msa->nseq == 1) { msa->wgt[0] = 1.0; return eslOK; }
+
+  if ((status = cluster_msa(bld, msa, bld->wid, &c, &nin, &nc)) != eslOK) goto ERROR;
+  for (i = 0; i < msa->nseq; i++)
+    msa->wgt[i] = 1. / (double) nin[c[i]];
+  esl_vec_DNorm (msa->wgt, msa->nseq);
+  esl_vec_DScale(msa->wgt, msa->nseq, (double) msa->nseq);
+  msa->flags |= eslMSA_HASWGTS;
+
+  free(c);
+  free(nin);
+  return eslOK;
+
+ ERROR:
+  if (c   != NULL) free(c);
+  if (nin != NULL) free(nin);
+  return status;
+}
+
+
+/* cluster_msa():
+ * Single linkage clustering of <msa> at <maxid>, for --eclust and --wblosum:
+ * exact, or on a sample of <bld->clustcols> columns. The sample is drawn
+ * with a private RNG, so clustering doesn't change the random numbers
+ * that calibration sees. Its seed mixes <bld->r>'s seed with the
+ * alignment's name and shape, so each alignment gets its own sample,
+ * and the same one however many threads an hmmbuild run uses.
+ */
+static int
+cluster_msa(P7_BUILDER *bld, const ESL_MSA *msa, double maxid, int **opt_c, int **opt_nin, int *ret_nc)
+{
+  ESL_RANDOMNESS *r = NULL;
+  uint32_t        seed;
+  const char     *s;
+  int             status;
+
+  if (bld->clustcols > 0 && bld->clustcols < msa->alen)
+    {
+      seed = esl_randomness_GetSeed(bld->r);               /* FNV-1a style mix */
+      if (msa->name != NULL)
+	for (s = msa->name; *s != '\0'; s++) seed = (seed ^ (uint32_t) *s) * 16777619u;
+      seed = (seed ^ (uint32_t) msa->nseq) * 16777619u;
+      seed = (seed ^ (uint32_t) msa->alen) * 16777619u;
+      seed = 1 + seed % 2147483646;                        /* a positive seed; 0 would mean an arbitrary one */
+
+      if ((r = esl_randomness_CreateFast(seed)) == NULL) { status = eslEMEM; goto ERROR; }
+    }
+  if ((status = p7_SingleLinkage(msa, maxid, bld->clustcols, r, opt_c, opt_nin, ret_nc)) != eslOK) goto ERROR;
+
+  if (r != NULL) esl_randomness_Destroy(r);
+  return eslOK;
+
+ ERROR:
+  if (r != NULL) esl_randomness_Destroy(r);
+  return status;
+}
+
+
 /* build_model():
  * Given <msa>, choose HMM architecture, collect counts;
  * upon return, <*ret_hmm> is newly allocated and contains
@@ -902,7 +978,7 @@ effective_seqnumber(P7_BUILDER *bld, const ESL_MSA *msa, P7_HMM *hmm, const P7_B
     {
         int nclust;
 
-        status = esl_msacluster_SingleLinkage(msa, bld->eid, NULL, NULL, &nclust);
+        status = cluster_msa(bld, msa, bld->eid, NULL, NULL, &nclust);
         if      (status == eslEMEM) ESL_XFAIL(status, bld->errbuf, "memory allocation failed");
         else if (status != eslOK)   ESL_XFAIL(status, bld->errbuf, "single linkage clustering algorithm (at %d%% id) failed", (int)(100 * bld->eid));
 
@@ -5,6 +5,9 @@
  *    1. The P7_DOMAINDEF object: allocation, reuse, destruction
  *    2. Routines inferring domain structure of a target sequence
  *    3. Internal routines 
+ *    4. P7_DOMAINPOOL: helper threads for rescoring envelopes
+ *    5. Example drivers
+ *    6. Benchmark driver
  *    
  * Exegesis:
  * 
@@ -44,10 +47,26 @@
 
 #include "hmmer.h"
 
+/* Envelopes are only handed to a P7_DOMAINPOOL when their total DP
+ * matrix size (sum of envelope lengths x M) is at least this; below
+ * it, thread handoff costs more than it saves.
+ */
+#define p7_DOMAINPOOL_MINCELLS 4000000
+
 static int is_multidomain_region  (P7_DOMAINDEF *ddef, int i, int j);
 static int region_trace_ensemble  (P7_DOMAINDEF *ddef, const P7_OPROFILE *om, const ESL_DSQ *dsq, int ireg, int jreg, const P7_OMX *fwd, P7_OMX *wrk, int *ret_nc);
-static int rescore_isolated_domain(P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_OMX *ox1, P7_OMX *ox2,
-				   int i, int j, int null2_is_done, P7_BG *bg, int long_target, P7_BG *bg_tmp, float *scores_arr, float *fwd_emissions_arr);
+static int add_envelope(P7_SPENSEMBLE *sp, int i, int j, int k, int m, int idx, float prob);
+static int region_posterior_split (P7_DOMAINDEF *ddef, const P7_OPROFILE *om, const ESL_DSQ *dsq, int ireg, int jreg, P7_OMX *fwd, P7_OMX *bck, int *ret_nc);
+static int queue_envelope         (P7_DOMAINDEF *ddef, int i, int j, int null2_is_done);
+static int rescore_envelopes      (P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_OMX *ox1, P7_OMX *ox2,
+				   P7_BG *bg, int long_target, P7_BG *bg_tmp, float *scores_arr, float *fwd_emissions_arr);
+static int rescore_isolated_domain(P7_DOMAINDEF *ddef, P7_STAGESTATS *st, P7_ARENA *ar, P7_OPROFILE *om, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_OMX *ox1, P7_OMX *ox2, P7_TRACE *tr,
+				   int i, int j, int null2_is_done, int do_align, P7_BG *bg, int long_target, P7_BG *bg_tmp, float *scores_arr,
+				   float *fwd_emissions_arr, P7_DOMAIN *dom);
+#ifdef HMMER_THREADS
+static int domainpool_Run(P7_DOMAINPOOL *pool, P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_OMX *ox1, P7_OMX *ox2,
+			  P7_BG *bg, int long_target, P7_BG *bg_tmp, float *scores_arr, float *fwd_emissions_arr);
+#endif
 
 
 /*****************************************************************
@@ -80,7 +99,12 @@ p7_domaindef_Create(ESL_RANDOMNESS *r)
   ddef->n2sc = NULL;
   ddef->sp   = NULL;
   ddef->tr   = NULL;
+  ddef->stc  = NULL;
   ddef->dcl  = NULL;
+  ddef->env  = NULL;
+  ddef->pool = NULL;
+  ddef->stats = NULL;
+  ddef->arena = NULL;
 
   /* level 2 alloc: posterior prob arrays */
   ESL_ALLOC(ddef->mocc, sizeof(float) * (Lalloc+1));
@@ -97,6 +121,10 @@ p7_domaindef_Create(ESL_RANDOMNESS *r)
   ddef->nalloc = nalloc;
   ddef->ndom   = 0;
 
+  ESL_ALLOC(ddef->env, sizeof(P7_ENVELOPE) * nalloc);
+  ddef->envalloc = nalloc;
+  ddef->nenv     = 0;
+
   ddef->nexpected  = 0.0;
   ddef->nregions   = 0;
   ddef->nclustered = 0;
@@ -113,11 +141,14 @@ p7_domaindef_Create(ESL_RANDOMNESS *r)
   ddef->max_diagdiff  = 4;
   ddef->min_posterior = 0.25;
   ddef->min_endpointp = 0.02;
+  ddef->do_sampling   = TRUE;
+  ddef->do_alignment  = TRUE;
 
   /* allocate reusable, growable objects that domain def reuses for each seq */
   ddef->sp  = p7_spensemble_Create(1024, 64, 32); /* init allocs = # sampled pairs; max endpoint range; # of domains */
   ddef->tr  = p7_trace_CreateWithPP();
   ddef->gtr = p7_trace_Create();
+  ddef->stc = p7_stocache_Create(Lalloc);
 
   /* keep a copy of ptr to the RNG */
   ddef->r            = r;  
@@ -196,12 +227,17 @@ p7_domaindef_Reuse(P7_DOMAINDEF *ddef)
   else
     {
       for (d = 0; d < ddef->ndom; d++) {
-	p7_alidisplay_Destroy(ddef->dcl[d].ad); ddef->dcl[d].ad             = NULL;
-	free(ddef->dcl[d].scores_per_pos);      ddef->dcl[d].scores_per_pos = NULL;
+	if (! ddef->arena) {	/* an arena's displays go with the arena */
+	  p7_alidisplay_Destroy(ddef->dcl[d].ad);
+	  free(ddef->dcl[d].scores_per_pos);
+	}
+	ddef->dcl[d].ad             = NULL;
+	ddef->dcl[d].scores_per_pos = NULL;
       }
       
     }
   ddef->ndom = 0;
+  ddef->nenv = 0;
   ddef->L    = 0;
 
   ddef->nexpected  = 0.0;
@@ -291,16 +327,18 @@ p7_domaindef_Destroy(P7_DOMAINDEF *ddef)
   if (ddef->n2sc != NULL) free(ddef->n2sc);
 
   if (ddef->dcl  != NULL) {
-    for (d = 0; d < ddef->ndom; d++) {
+    for (d = 0; ! ddef->arena && d < ddef->ndom; d++) {
       if (ddef->dcl[d].scores_per_pos) free(ddef->dcl[d].scores_per_pos);
       p7_alidisplay_Destroy(ddef->dcl[d].ad);
     }
     free(ddef->dcl);
   }
+  if (ddef->env  != NULL) free(ddef->env);
 
   p7_spensemble_Destroy(ddef->sp);
   p7_trace_Destroy(ddef->tr);
   p7_trace_Destroy(ddef->gtr);
+  p7_stocache_Destroy(ddef->stc);
   free(ddef);
   return;
 }
@@ -341,7 +379,7 @@ p7_domaindef_ByViterbi(P7_PROFILE *gm, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_
   p7_ReconfigUnihit(gm, 0);	  /* process each domain in unihit L=0 mode */
 
   for (d = 0; d < ddef->gtr->ndom; d++)
-    rescore_isolated_domain(ddef, gm, sq, ntsq, gx1, gx2, ddef->gtr->sqfrom[d], ddef->gtr->sqto[d], FALSE, NULL, FALSE, NULL, NULL, NULL);
+    rescore_isolated_domain(ddef, NULL, gm, sq, ntsq, gx1, gx2, ddef->gtr->sqfrom[d], ddef->gtr->sqto[d], FALSE, TRUE, NULL, FALSE, NULL, NULL, NULL);
 
   /* Restore original model configuration, including length */
   if (p7_IsMulti(save_mode))  p7_ReconfigMultihit(gm, saveL); 
@@ -373,12 +411,33 @@ p7_domaindef_ByViterbi(P7_PROFILE *gm, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_
  *            Upon return, <ddef> contains the definitions of all the
  *            domains: their bounds, their null-corrected Forward
  *            scores, and their optimal posterior accuracy alignments.
+ *
+ *            If <ddef->arena> is set, the alignment displays are
+ *            allocated from it, and the arena owns them; the caller
+ *            that sets it (the search pipeline, with its hit list's
+ *            arena) can attach them to a hit without copying them.
+ *
+ *            If <ddef->do_alignment> is FALSE, the alignments are
+ *            skipped, unless the target's envelopes overlap. Each
+ *            unaligned domain's <envdsq> points into <sq>, and is only
+ *            valid while <sq> is; the caller copies what it keeps (see
+ *            <p7_tophits_CopyDomains()>) and aligns it later with
+ *            <p7_domaindef_AlignEnvelope()>. 
+ *
+ *            All envelopes are defined first, then rescored. If the
+ *            caller has registered a <P7_DOMAINPOOL> in <ddef->pool>,
+ *            the envelopes of a big target are rescored in parallel by
+ *            the calling thread and the pool's helper threads. Results
+ *            are the same either way.
  *            
  * Returns:   <eslOK> on success.           
  *            
  *            <eslERANGE> on numeric overflow in posterior
  *            decoding. This should not be possible for multihit
  *            models.
+ *
+ * Throws:    <eslEMEM> on allocation failure; <eslESYS> if a
+ *            thread synchronization call fails.
  */
 int
 p7_domaindef_ByPosteriorHeuristics(const ESL_SQ *sq, const ESL_SQ *ntsq, P7_OPROFILE *om,
@@ -386,6 +445,7 @@ p7_domaindef_ByPosteriorHeuristics(const ESL_SQ *sq, const ESL_SQ *ntsq, P7_OPRO
 				   P7_DOMAINDEF *ddef, P7_BG *bg, int long_target,
 				   P7_BG *bg_tmp, float *scores_arr, float *fwd_emissions_arr)
 {
+  P7_ENVELOPE *env;
   int i, j;
   int triggered;
   int d;
@@ -394,12 +454,17 @@ p7_domaindef_ByPosteriorHeuristics(const ESL_SQ *sq, const ESL_SQ *ntsq, P7_OPRO
   int nc;
   int saveL     = om->L;	/* Save the length config of <om>; will restore upon return */
   int save_mode = om->mode;	/* Likewise for the mode. */
+  uint64_t t0   = 0;
   int status;
 
   if ((status = p7_domaindef_GrowTo(ddef, sq->n))      != eslOK) return status;  /* ddef's btot,etot,mocc now ready for seq of length n */
-  if ((status = p7_DomainDecoding(om, oxf, oxb, ddef)) != eslOK) return status;  /* ddef->{btot,etot,mocc} now made.                    */
+  p7_STAGE_START(ddef->stats, t0);
+  status = p7_DomainDecoding(om, oxf, oxb, ddef);                                 /* ddef->{btot,etot,mocc} now made.                    */
+  p7_STAGE_STOP(ddef->stats, p7_STAGE_DECODING, t0, sq->n);
+  if (status != eslOK) return status;
 
   esl_vec_FSet(ddef->n2sc, sq->n+1, 0.0);          /* ddef->n2sc null2 scores are initialized                        */
+  ddef->nenv      = 0;
   ddef->nexpected = ddef->btot[sq->n];             /* posterior expectation for # of domains (same as etot[sq->n])   */
 
   p7_oprofile_ReconfigUnihit(om, saveL);	   /* process each domain in unihit mode, regardless of om->mode     */
@@ -436,16 +501,23 @@ p7_domaindef_ByPosteriorHeuristics(const ESL_SQ *sq, const ESL_SQ *ntsq, P7_OPRO
              * works
              */
             p7_oprofile_ReconfigMultihit(om, saveL);
+            p7_STAGE_START(ddef->stats, t0);
             p7_Forward(sq->dsq+i-1, j-i+1, om, fwd, NULL);
-
-            region_trace_ensemble(ddef, om, sq->dsq, i, j, fwd, bck, &nc);
+            p7_STAGE_STOP(ddef->stats, p7_STAGE_FWD, t0, (uint64_t) om->M * (j-i+1));
+
+            if (ddef->do_sampling) {
+              p7_STAGE_START(ddef->stats, t0);
+              region_trace_ensemble(ddef, om, sq->dsq, i, j, fwd, bck, &nc);
+              p7_STAGE_STOP(ddef->stats, p7_STAGE_STOCLUST, t0, (uint64_t) ddef->nsamples * (j-i+1));
+            } else
+              region_posterior_split(ddef, om, sq->dsq, i, j, fwd, bck, &nc);
             p7_oprofile_ReconfigUnihit(om, saveL);
-            /* ddef->n2sc is now set on i..j by the traceback-dependent method */
+            /* if sampling, ddef->n2sc is now set on i..j by the traceback-dependent method;
+             * else null2 is calculated by expectation for each envelope, as for a single domain.
+             */
 
-            last_j2 = 0;
             for (d = 0; d < nc; d++) {
                   p7_spensemble_GetClusterCoords(ddef->sp, d, &i2, &j2, NULL, NULL, NULL);
-                  if (i2 <= last_j2) ddef->noverlaps++;
 
                   /* Note that k..m coords on model are available, but
                      * we're currently ignoring them.  This leads to a
@@ -465,11 +537,7 @@ p7_domaindef_ByPosteriorHeuristics(const ESL_SQ *sq, const ESL_SQ *ntsq, P7_OPRO
                      * happens. [xref J5/130].
                   */
                   ddef->nenvelopes++;
-
-                  /*the !long_target argument will cause the function to recompute null2
-                   * scores if this is part of a long_target (nhmmer) pipeline */
-                  if (rescore_isolated_domain(ddef, om, sq, ntsq, fwd, bck, i2, j2, TRUE, bg, long_target, bg_tmp, scores_arr, fwd_emissions_arr) == eslOK)
-                       last_j2 = j2;
+                  if ((status = queue_envelope(ddef, i2, j2, ddef->do_sampling)) != eslOK) return status;
             }
             p7_spensemble_Reuse(ddef->sp);
             p7_trace_Reuse(ddef->tr);
@@ -478,22 +546,149 @@ p7_domaindef_ByPosteriorHeuristics(const ESL_SQ *sq, const ESL_SQ *ntsq, P7_OPRO
         {
             /* The region looks simple, single domain; convert the region to an envelope. */
             ddef->nenvelopes++;
-            rescore_isolated_domain(ddef, om, sq, ntsq, fwd, bck, i, j, FALSE, bg, long_target, bg_tmp, scores_arr, fwd_emissions_arr);
+            if ((status = queue_envelope(ddef, i, j, FALSE)) != eslOK) return status;
         }
         i     = -1;
         triggered = FALSE;
     }
   }
 
+  /* A caller that aligns its reported domains itself can have us skip
+   * the alignments here; but not when envelopes overlap, because
+   * p7_tophits_Threshold() compares their alignments (bug #h74).
+   */
+  if (! ddef->do_alignment && ! long_target)
+    {
+      for (last_j2 = 0, d = 0; d < ddef->nenv; d++) {
+	if (ddef->env[d].i <= last_j2) break;
+	last_j2 = ESL_MAX(last_j2, ddef->env[d].j);
+      }
+      if (d == ddef->nenv)
+	for (d = 0; d < ddef->nenv; d++) ddef->env[d].do_align = FALSE;
+    }
+
+  /* Now score (with null2) and align each envelope. Envelopes are
+   * independent of each other, so on a big target with a <ddef->pool>
+   * they are rescored in parallel.
+   */
+  if ((status = rescore_envelopes(ddef, om, sq, ntsq, fwd, bck, bg, long_target, bg_tmp, scores_arr, fwd_emissions_arr)) != eslOK) return status;
+
+  /* Collect the domains, in envelope order. Count overlapping
+   * envelopes; only clustered envelopes in one region can overlap.
+   */
+  last_j2 = 0;
+  for (d = 0; d < ddef->nenv; d++)
+    {
+      env = &(ddef->env[d]);
+      if (env->i <= last_j2) ddef->noverlaps++;
+      if (env->status != eslOK) {
+	if (env->dom.ad != NULL && ! ddef->arena) p7_alidisplay_Destroy(env->dom.ad);
+	continue;
+      }
+      last_j2 = env->j;
+
+      if (ddef->ndom == ddef->nalloc) {
+	ESL_REALLOC(ddef->dcl, sizeof(P7_DOMAIN) * (ddef->nalloc*2));
+	ddef->nalloc *= 2;
+      }
+      ddef->dcl[ddef->ndom++] = env->dom;
+    }
+  ddef->nenv = 0;
+
 
   /* Restore model to uni/multihit mode, and to its original length model */
   if (p7_IsMulti(save_mode)) p7_oprofile_ReconfigMultihit(om, saveL); 
   else                       p7_oprofile_ReconfigUnihit  (om, saveL); 
   return eslOK;
+
+ ERROR:
+  return status;
 }
 
 
 
+/* Function:  p7_domaindef_AlignEnvelope()
+ * Synopsis:  Make the deferred alignment of one domain.
+ *
+ * Purpose:   Domain <dom> was defined with <ddef->do_alignment> FALSE,
+ *            so it has no alignment yet; but it kept a copy of its
+ *            envelope's residues, <dom->envdsq[0..Ld+1]> for envelope
+ *            length <Ld>, with sentinels at both ends. Now obtain its
+ *            optimal accuracy alignment to <om>, exactly as domain
+ *            definition would have: <om> is configured in unihit mode
+ *            for the target's length <dom->L> while we work, then
+ *            restored. The alignment display is labeled with target
+ *            <name>, and (optionally; may be NULL) <acc> and <desc>.
+ *            It is allocated from arena <ar> (the hit list's, say),
+ *            or with <malloc()> if <ar> is <NULL>.
+ *
+ *            Caller provides DP matrices <ox1> and <ox2> and a trace
+ *            <tr> (with posterior probabilities) for working space;
+ *            the matrices are reallocated as needed, and the trace
+ *            is reused upon return.
+ *
+ *            Upon return, <dom->ad>, <dom->iali>, <dom->jali>, and
+ *            <dom->oasc> are set, and <dom->envdsq> is NULL. If <dom>
+ *            already has an alignment, do nothing.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure; <eslERANGE> on numeric
+ *            overflow in posterior decoding, which can't happen if
+ *            the envelope was rescored successfully before.
+ */
+int
+p7_domaindef_AlignEnvelope(P7_OPROFILE *om, P7_ARENA *ar, const char *name, const char *acc, const char *desc,
+			   P7_OMX *ox1, P7_OMX *ox2, P7_TRACE *tr, P7_DOMAIN *dom)
+{
+  ESL_SQ *sq        = NULL;
+  int     Ld        = dom->jenv - dom->ienv + 1;
+  int     saveL     = om->L;
+  int     save_mode = om->mode;
+  float   oasc;
+  int     status;
+
+  if (dom->ad != NULL || dom->envdsq == NULL) return eslOK;
+
+  if ((status = p7_omx_GrowTo(ox1, om->M, Ld, Ld)) != eslOK) goto ERROR;
+  if ((status = p7_omx_GrowTo(ox2, om->M, Ld, Ld)) != eslOK) goto ERROR;
+  p7_oprofile_ReconfigUnihit(om, dom->L);
+
+  p7_Forward (dom->envdsq, Ld, om,      ox1, NULL);
+  p7_Backward(dom->envdsq, Ld, om, ox1, ox2, NULL);
+  if ((status = p7_Decoding(om, ox1, ox2, ox2)) != eslOK) ESL_XEXCEPTION(status, "posterior decoding failed on a rescored envelope");
+  p7_OptimalAccuracy(om, ox2, ox1, &oasc);
+  p7_OATrace        (om, ox2, ox1, tr);
+
+  /* The trace's seq coords are relative to the envelope, and so is
+   * <sq>; shift the display's coords, and give it the target's length.
+   */
+  if ((sq      = esl_sq_CreateDigitalFrom(om->abc, name, dom->envdsq, Ld, desc, acc, NULL)) == NULL) { status = eslEMEM; goto ERROR; }
+  if ((dom->ad = p7_alidisplay_CreateInArena(tr, 0, om, sq, NULL, ar))                     == NULL) { status = eslEMEM; goto ERROR; }
+  dom->ad->sqfrom += dom->ienv - 1;
+  dom->ad->sqto   += dom->ienv - 1;
+  dom->ad->L       = dom->L;
+
+  dom->iali   = dom->ad->sqfrom;
+  dom->jali   = dom->ad->sqto;
+  dom->oasc   = oasc;
+  dom->envdsq = NULL;
+
+  esl_sq_Destroy(sq);
+  p7_trace_Reuse(tr);
+  if (p7_IsMulti(save_mode)) p7_oprofile_ReconfigMultihit(om, saveL); 
+  else                       p7_oprofile_ReconfigUnihit  (om, saveL); 
+  return eslOK;
+
+ ERROR:
+  esl_sq_Destroy(sq);
+  p7_trace_Reuse(tr);
+  if (p7_IsMulti(save_mode)) p7_oprofile_ReconfigMultihit(om, saveL); 
+  else                       p7_oprofile_ReconfigUnihit  (om, saveL); 
+  return status;
+}
+
+
 /*****************************************************************
  * 3. Internal routines 
  *****************************************************************/
@@ -590,6 +785,9 @@ is_multidomain_region(P7_DOMAINDEF *ddef, int i, int j)
  *    <region_trace_ensemble()> again.
  *    
  * <ddef->tr> is used as working memory for sampled traces.
+ *
+ * <ddef->stc> holds selection tables shared by all the sampled traces
+ *    of this region's Forward matrix; it is reset here.
  *    
  * <wrk> has had its zero row clobbered as working space for a null2 calculation.
  */
@@ -613,9 +811,10 @@ region_trace_ensemble(P7_DOMAINDEF *ddef, const P7_OPROFILE *om, const ESL_DSQ *
     esl_randomness_Init(ddef->r, esl_randomness_GetSeed(ddef->r));
 
   /* Collect an ensemble of sampled traces; calculate null2 odds ratios from these */
+  p7_stocache_Reuse(ddef->stc);
   for (t = 0; t < ddef->nsamples; t++)
     {
-      p7_StochasticTrace(ddef->r, dsq+ireg-1, Lr, om, fwd, ddef->tr);
+      p7_StochasticTraceCached(ddef->r, dsq+ireg-1, Lr, om, fwd, ddef->stc, ddef->tr);
       p7_trace_Index(ddef->tr);
 
       pos = 1;
@@ -750,6 +949,265 @@ reparameterize_model (P7_BG *bg, P7_OPROFILE *om, const ESL_SQ *sq, int start, i
 }
 
 
+/* region_posterior_split()
+ *
+ * The deterministic alternative to <region_trace_ensemble()>, used
+ * when <ddef->do_sampling> is FALSE: we've decided that region
+ * <ireg>..<jreg> may contain more than one domain, and we split it
+ * into envelopes using posterior decoding instead of clustering a
+ * sample of traces. Run time depends only on the size of the region
+ * and the model, not on how many domains are sampled.
+ * 
+ * Caller provides the multihit Forward matrix <fwd> for the region,
+ * as for <region_trace_ensemble()>; <bck> is used for the Backward
+ * matrix, then overwritten by posterior decoding. <fwd> is
+ * overwritten by the optimal accuracy calculation.
+ * 
+ * The domains on the region's maximum expected accuracy (optimal
+ * accuracy) path are the anchors, one envelope each. Between two
+ * anchors, the region is split at the position z that maximizes
+ * etot[z] - btot[z]: the domain ends expected before z less the
+ * domain starts expected before z. Within its piece of the region,
+ * each envelope then extends from its anchor to the widest start
+ * and end points that hold at least <ddef->min_endpointp> of that
+ * piece's B and E posterior mass, which is the same rule the
+ * sampling method applies to its endpoint counts. Envelopes with
+ * less than <ddef->min_posterior> expected domain starts are dropped.
+ * 
+ * The envelopes are left in <ddef->sp>, as if they were the clusters
+ * of a sampled ensemble, so the caller can retrieve them with
+ * <p7_spensemble_GetClusterCoords()>; <*ret_nc> is their number.
+ * Null2 is not calculated here; the caller does it by expectation,
+ * envelope by envelope.
+ */
+static int
+region_posterior_split(P7_DOMAINDEF *ddef, const P7_OPROFILE *om, const ESL_DSQ *dsq, int ireg, int jreg, 
+		       P7_OMX *fwd, P7_OMX *bck, int *ret_nc)
+{
+  P7_SPENSEMBLE *sp = ddef->sp;
+  P7_TRACE      *tr = ddef->tr;
+  int    Lr  = jreg-ireg+1;
+  int    d, z;
+  int    a, b;			/* this envelope's piece of the region            */
+  int    s, t;			/* its anchor: the OA domain's start and end      */
+  int    ienv, jenv;
+  int    split;
+  float  oasc;
+  float  mass, best;
+  uint64_t ncells = (uint64_t) om->M * Lr;
+  uint64_t t0     = 0;
+  int    status;
+
+  sp->nsigc = 0;
+  p7_STAGE_START(ddef->stats, t0);
+  p7_Backward(dsq+ireg-1, Lr, om, fwd, bck, NULL);
+  p7_STAGE_STOP (ddef->stats, p7_STAGE_BCK, t0, ncells);
+  p7_STAGE_START(ddef->stats, t0);
+  status = p7_Decoding(om, fwd, bck, bck);
+  p7_STAGE_STOP (ddef->stats, p7_STAGE_DECODING, t0, ncells);
+  if (status == eslERANGE)
+    {	/* rare: numeric overflow. Hand over the whole region as one envelope; rescoring will deal with it [J3/119-121] */
+      if ((status = add_envelope(sp, ireg, jreg, 1, om->M, 0, 1.0)) != eslOK) goto ERROR;
+      *ret_nc = sp->nc = sp->nsigc;
+      return eslOK;
+    }
+  p7_STAGE_START(ddef->stats, t0);
+  p7_OptimalAccuracy(om, bck, fwd, &oasc);
+  p7_OATrace        (om, bck, fwd, tr);
+  p7_STAGE_STOP (ddef->stats, p7_STAGE_ALIGN, t0, ncells);
+  p7_trace_Index(tr);
+
+  b = ireg-1;
+  for (d = 0; d < tr->ndom; d++)
+    {
+      s = tr->sqfrom[d] + ireg-1;
+      t = tr->sqto[d]   + ireg-1;
+      a = b+1;
+
+      if (d == tr->ndom-1) b = jreg;
+      else {			/* split between this anchor and the next one */
+	split = t;
+	best  = ddef->etot[t] - ddef->btot[t];
+	for (z = t+1; z < tr->sqfrom[d+1] + ireg-1; z++)
+	  if (ddef->etot[z] - ddef->btot[z] > best) { best = ddef->etot[z] - ddef->btot[z]; split = z; }
+	b = split;
+      }
+
+      if (ddef->btot[t] - ddef->btot[a-1] < ddef->min_posterior) continue;
+
+      /* Leftmost start in a..s with enough B posterior mass; else the most probable one. */
+      mass = ddef->btot[s] - ddef->btot[a-1];
+      ienv = s;
+      if (mass > 0.) 
+	{
+	  for (z = a; z <= s; z++)
+	    if (ddef->btot[z] - ddef->btot[z-1] >= ddef->min_endpointp * mass) break;
+	  if (z <= s) ienv = z;
+	  else 
+	    for (best = -1., z = a; z <= s; z++)
+	      if (ddef->btot[z] - ddef->btot[z-1] > best) { best = ddef->btot[z] - ddef->btot[z-1]; ienv = z; }
+	}
+
+      /* Rightmost end in t..b with enough E posterior mass; else the most probable one. */
+      mass = ddef->etot[b] - ddef->etot[t-1];
+      jenv = t;
+      if (mass > 0.)
+	{
+	  for (z = b; z >= t; z--)
+	    if (ddef->etot[z] - ddef->etot[z-1] >= ddef->min_endpointp * mass) break;
+	  if (z >= t) jenv = z;
+	  else 
+	    for (best = -1., z = t; z <= b; z++)
+	      if (ddef->etot[z] - ddef->etot[z-1] > best) { best = ddef->etot[z] - ddef->etot[z-1]; jenv = z; }
+	}
+
+      if ((status = add_envelope(sp, ienv, jenv, tr->hmmfrom[d], tr->hmmto[d], d, ddef->btot[t] - ddef->btot[a-1])) != eslOK) goto ERROR;
+    }
+
+  p7_trace_Reuse(tr);
+  *ret_nc = sp->nc = sp->nsigc;
+  return eslOK;
+
+ ERROR:
+  p7_trace_Reuse(tr);
+  *ret_nc = sp->nc = 0;
+  return status;
+}
+
+/* add_envelope()
+ * Append envelope <i>..<j> (with model coords <k>..<m>, and expected
+ * number of domains <prob>) to the resolved clusters in <sp>. 
+ */
+static int
+add_envelope(P7_SPENSEMBLE *sp, int i, int j, int k, int m, int idx, float prob)
+{
+  int status;
+
+  if (sp->nsigc >= sp->nsigc_alloc) {
+    void *p;
+    ESL_RALLOC(sp->sigc, p, sizeof(struct p7_spcoord_s) * sp->nsigc_alloc * 2);
+    sp->nsigc_alloc *= 2;
+  }
+  sp->sigc[sp->nsigc].i    = i;
+  sp->sigc[sp->nsigc].j    = j;
+  sp->sigc[sp->nsigc].k    = k;
+  sp->sigc[sp->nsigc].m    = m;
+  sp->sigc[sp->nsigc].idx  = idx;
+  sp->sigc[sp->nsigc].prob = prob;
+  sp->nsigc++;
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+
+
+/* queue_envelope()
+ *
+ * Append envelope <i>..<j> to the list of envelopes in <ddef> that
+ * are waiting to be rescored. <null2_is_done> is TRUE if
+ * <ddef->n2sc[i..j]> has already been set by stochastic clustering.
+ *
+ * Returns <eslOK> on success.
+ *
+ * Throws  <eslEMEM> on allocation failure.
+ */
+static int
+queue_envelope(P7_DOMAINDEF *ddef, int i, int j, int null2_is_done)
+{
+  P7_ENVELOPE *env;
+  int          status;
+
+  if (ddef->nenv == ddef->envalloc) {
+    ESL_REALLOC(ddef->env, sizeof(P7_ENVELOPE) * (ddef->envalloc*2));
+    ddef->envalloc *= 2;
+  }
+  env = &(ddef->env[ddef->nenv]);
+  env->i             = i;
+  env->j             = j;
+  env->null2_is_done = null2_is_done;
+  env->do_align      = TRUE;
+  env->status        = eslFAIL;
+  env->dom.ad             = NULL;
+  env->dom.scores_per_pos = NULL;
+  env->dom.envdsq         = NULL;
+  ddef->nenv++;
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+
+
+/* rescore_envelopes()
+ *
+ * Rescore each envelope queued in <ddef->env>, setting its <status>
+ * and, if it succeeds, its <dom>. <ox1>, <ox2> are the caller's DP
+ * matrices, reallocated here as needed; other arguments are passed
+ * on to <rescore_isolated_domain()>.
+ *
+ * If <ddef->pool> is set and the envelopes are big enough in total to
+ * be worth it, they're handed to the pool, and the calling thread
+ * works on them alongside the pool's helper threads. Otherwise
+ * they're done serially, in order. The pool's rescorers make their
+ * alignment displays with <malloc()>; if the caller wants them in
+ * <ddef->arena>, they're moved there afterwards.
+ *
+ * Returns <eslOK> on success. Envelopes that fail to rescore are
+ * flagged by their <status>, not by the return value.
+ *
+ * Throws  <eslEMEM> on allocation failure; <eslESYS> on a threading
+ *         failure.
+ */
+static int
+rescore_envelopes(P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_OMX *ox1, P7_OMX *ox2,
+		  P7_BG *bg, int long_target, P7_BG *bg_tmp, float *scores_arr, float *fwd_emissions_arr)
+{
+  P7_ENVELOPE *env;
+  int          Ld;
+  int          e;
+  int          status;
+
+#ifdef HMMER_THREADS
+  P7_ALIDISPLAY *ad;
+  int64_t      ncells = 0;
+
+  if (ddef->pool != NULL && ddef->nenv > 1)
+    {
+      for (e = 0; e < ddef->nenv; e++)
+	ncells += (int64_t) (ddef->env[e].j - ddef->env[e].i + 1) * (int64_t) om->M;
+      if (ncells >= p7_DOMAINPOOL_MINCELLS)
+	{
+	  if ((status = domainpool_Run(ddef->pool, ddef, om, sq, ntsq, ox1, ox2, bg, long_target, bg_tmp, scores_arr, fwd_emissions_arr)) != eslOK) return status;
+	  for (e = 0; ddef->arena && e < ddef->nenv; e++)
+	    {
+	      env = &(ddef->env[e]);
+	      if (env->dom.ad == NULL) continue;
+	      ad  = env->dom.ad;
+	      env->dom.ad = (env->status == eslOK ? p7_alidisplay_CloneInArena(ad, ddef->arena) : NULL);
+	      p7_alidisplay_Destroy(ad);
+	      if (env->status == eslOK && env->dom.ad == NULL) ESL_EXCEPTION(eslEMEM, "allocation failure");
+	    }
+	  return eslOK;
+	}
+    }
+#endif
+
+  for (e = 0; e < ddef->nenv; e++)
+    {
+      env = &(ddef->env[e]);
+      Ld  = env->j - env->i + 1;
+      if ((status = p7_omx_GrowTo(ox1, om->M, Ld, Ld)) != eslOK) return status;
+      if ((status = p7_omx_GrowTo(ox2, om->M, Ld, Ld)) != eslOK) return status;
+
+      /* with <long_target> TRUE, null2 is recomputed by reparameterization (nhmmer) */
+      env->status = rescore_isolated_domain(ddef, ddef->stats, ddef->arena, om, sq, ntsq, ox1, ox2, ddef->tr, env->i, env->j, env->null2_is_done, env->do_align,
+					    bg, long_target, bg_tmp, scores_arr, fwd_emissions_arr, &(env->dom));
+    }
+  return eslOK;
+}
+
+
 /* rescore_isolated_domain()
  * SRE, Fri Feb  8 09:18:33 2008 [Janelia]
  *
@@ -773,8 +1231,22 @@ reparameterize_model (P7_BG *bg, P7_OPROFILE *om, const ESL_SQ *sq, int start, i
  * against the model. (The caller will typically already have matrices
  * sufficient for the complete sequence lying around, and can just use
  * those.) The caller also provides a <P7_DOMAINDEF> object (ddef)
- * which is (efficiently, we trust) managing any necessary temporary
- * working space and heuristic thresholds.
+ * which holds the null2 scores <ddef->n2sc>, and a trace <tr> to use
+ * as working space for the OA trace. Only <ddef->n2sc[i..j]> is
+ * touched, so envelopes that don't overlap can be rescored
+ * concurrently, each with its own <ox1>, <ox2>, <tr>.
+ *
+ * If <st> is non-NULL, the time and DP cells of each stage are added
+ * to it (--stagestats). Concurrent rescorers each pass their own.
+ *
+ * If <ar> is non-NULL, the alignment display is allocated from it
+ * (see <ddef->arena>); else it's <malloc()>'ed. Concurrent rescorers
+ * pass <NULL>, because an arena isn't thread-safe.
+ *
+ * If <do_align> is FALSE, the OA alignment is skipped: <dom->ad> is
+ * NULL, <dom->oasc> is 0, the alignment coords are the envelope's,
+ * and <dom->envdsq> points into <sq> at the envelope, for the caller
+ * to copy and align later with <p7_domaindef_AlignEnvelope()>.
  *
  * If <long_target> is TRUE, the calling function  optionally
  * passes in three allocated arrays (bg_tmp, scores_arr,
@@ -785,11 +1257,11 @@ reparameterize_model (P7_BG *bg, P7_OPROFILE *om, const ESL_SQ *sq, int start, i
  * 
  * Returns <eslOK> if a domain was successfully identified, scored,
  * and aligned in the envelope; if so, the per-domain information is
- * registered in <ddef>, in <ddef->dcl>.
+ * in <dom>.
  * 
  * And here's what's happened to our working memory:
  * 
- * <ddef>: <ddef->tr> has been used, and possibly reallocated, for
+ * <tr>  : has been used, and possibly reallocated, for
  *         the OA trace of the domain. Before exit, we called
  *         <Reuse()> on it.
  * 
@@ -811,11 +1283,10 @@ reparameterize_model (P7_BG *bg, P7_OPROFILE *om, const ESL_SQ *sq, int start, i
  * 
  */
 static int
-rescore_isolated_domain(P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, const ESL_SQ *ntsq,
-			P7_OMX *ox1, P7_OMX *ox2, int i, int j, int null2_is_done, P7_BG *bg, int long_target,
-			P7_BG *bg_tmp, float *scores_arr, float *fwd_emissions_arr)
+rescore_isolated_domain(P7_DOMAINDEF *ddef, P7_STAGESTATS *st, P7_ARENA *ar, P7_OPROFILE *om, const ESL_SQ *sq, const ESL_SQ *ntsq,
+			P7_OMX *ox1, P7_OMX *ox2, P7_TRACE *tr, int i, int j, int null2_is_done, int do_align, P7_BG *bg, int long_target,
+			P7_BG *bg_tmp, float *scores_arr, float *fwd_emissions_arr, P7_DOMAIN *dom)
 {
-  P7_DOMAIN     *dom           = NULL;
   int            Ld            = j-i+1;
   float          domcorrection = 0.0;
   float          envsc, oasc;
@@ -825,6 +1296,7 @@ rescore_isolated_domain(P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, c
   int            status;
   int            max_env_extra = 20;
   int            orig_L;
+  uint64_t       t0            = 0;
 
 
   if (long_target) {
@@ -840,28 +1312,44 @@ rescore_isolated_domain(P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, c
     reparameterize_model (bg, om, sq, i, j-i+1, fwd_emissions_arr, bg_tmp->f, scores_arr);
   }
 
+  p7_STAGE_START(st, t0);
   p7_Forward (sq->dsq + i-1, Ld, om,      ox1, &envsc);
+  p7_STAGE_STOP (st, p7_STAGE_FWD, t0, (uint64_t) om->M * Ld);
+  p7_STAGE_START(st, t0);
   p7_Backward(sq->dsq + i-1, Ld, om, ox1, ox2, NULL);
+  p7_STAGE_STOP (st, p7_STAGE_BCK, t0, (uint64_t) om->M * Ld);
 
+  p7_STAGE_START(st, t0);
   status = p7_Decoding(om, ox1, ox2, ox2);      /* <ox2> is now overwritten with post probabilities     */
+  p7_STAGE_STOP (st, p7_STAGE_DECODING, t0, (uint64_t) om->M * Ld);
   if (status == eslERANGE) return eslFAIL;      /* rare: numeric overflow; domain is assumed to be repetitive garbage [J3/119-121] */
 
-  /* Find an optimal accuracy alignment */
-  p7_OptimalAccuracy(om, ox2, ox1, &oasc);      /* <ox1> is now overwritten with OA scores              */
-  p7_OATrace        (om, ox2, ox1, ddef->tr);   /* <tr>'s seq coords are offset by i-1, rel to orig dsq */
+  /* Find an optimal accuracy alignment, unless the caller will do
+   * that later for the domains it reports. Then we only note where
+   * the envelope's residues are; the caller copies them.
+   */
+  if (do_align)
+    {
+      p7_STAGE_START(st, t0);
+      p7_OptimalAccuracy(om, ox2, ox1, &oasc);      /* <ox1> is now overwritten with OA scores              */
+      p7_OATrace        (om, ox2, ox1, tr);   /* <tr>'s seq coords are offset by i-1, rel to orig dsq */
 
-  /* hack the trace's sq coords to be correct w.r.t. original dsq */
-  for (z = 0; z < ddef->tr->N; z++)
-    if (ddef->tr->i[z] > 0) ddef->tr->i[z] += i-1;
+      /* hack the trace's sq coords to be correct w.r.t. original dsq */
+      for (z = 0; z < tr->N; z++)
+	if (tr->i[z] > 0) tr->i[z] += i-1;
 
-  /* get ptr to next empty domain structure in domaindef's results */
-  if (ddef->ndom == ddef->nalloc) {
-    ESL_REALLOC(ddef->dcl, sizeof(P7_DOMAIN) * (ddef->nalloc*2));
-    ddef->nalloc *= 2;
-  }
-  dom = &(ddef->dcl[ddef->ndom]);
-  dom->ad             = p7_alidisplay_Create(ddef->tr, 0, om, sq, ntsq);
+      dom->ad     = p7_alidisplay_CreateInArena(tr, 0, om, sq, ntsq, ar);
+      dom->envdsq = NULL;
+      p7_STAGE_STOP(st, p7_STAGE_ALIGN, t0, (uint64_t) om->M * Ld);
+    }
+  else
+    {
+      oasc        = 0.0;
+      dom->ad     = NULL;
+      dom->envdsq = sq->dsq + i-1;
+    }
   dom->scores_per_pos = NULL;
+  dom->L              = sq->n;
 
 
   /* For long target DNA, it's common to see a huge envelope (>1Kb longer than alignment), usually
@@ -890,24 +1378,32 @@ rescore_isolated_domain(P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, c
         reparameterize_model (bg, om, sq, i, Ld, fwd_emissions_arr, bg_tmp->f, scores_arr);
       }
 
+      p7_STAGE_START(st, t0);
       p7_Forward (sq->dsq + i-1, Ld, om,      ox1, &envsc);
+      p7_STAGE_STOP (st, p7_STAGE_FWD, t0, (uint64_t) om->M * Ld);
+      p7_STAGE_START(st, t0);
       p7_Backward(sq->dsq + i-1, Ld, om, ox1, ox2, NULL);
+      p7_STAGE_STOP (st, p7_STAGE_BCK, t0, (uint64_t) om->M * Ld);
 
+      p7_STAGE_START(st, t0);
       status = p7_Decoding(om, ox1, ox2, ox2);      /* <ox2> is now overwritten with post probabilities     */
+      p7_STAGE_STOP (st, p7_STAGE_DECODING, t0, (uint64_t) om->M * Ld);
       if (status == eslERANGE) return eslFAIL;      /* rare: numeric overflow; domain is assumed to be repetitive garbage [J3/119-212] */
 
       /* Find an optimal accuracy alignment */
+      p7_STAGE_START(st, t0);
       p7_OptimalAccuracy(om, ox2, ox1, &oasc);      /* <ox1> is now overwritten with OA scores              */
-      p7_trace_Reuse(ddef->tr);
-      p7_OATrace        (om, ox2, ox1, ddef->tr);   /* <tr>'s seq coords are offset by i-1, rel to orig dsq */
+      p7_trace_Reuse(tr);
+      p7_OATrace        (om, ox2, ox1, tr);   /* <tr>'s seq coords are offset by i-1, rel to orig dsq */
 
       /* re-hack the trace's sq coords to be correct w.r.t. original dsq */
-       for (z = 0; z < ddef->tr->N; z++)
-         if (ddef->tr->i[z] > 0) ddef->tr->i[z] += i-1;
+       for (z = 0; z < tr->N; z++)
+         if (tr->i[z] > 0) tr->i[z] += i-1;
 
-       /* store the results in it, first destroying the old alidisplay object */
-       p7_alidisplay_Destroy(dom->ad);
-       dom->ad            = p7_alidisplay_Create(ddef->tr, 0, om, sq, NULL);
+       /* store the results in it, first destroying the old alidisplay object (unless the arena has it) */
+       if (! ar) p7_alidisplay_Destroy(dom->ad);
+       dom->ad            = p7_alidisplay_CreateInArena(tr, 0, om, sq, NULL, ar);
+       p7_STAGE_STOP(st, p7_STAGE_ALIGN, t0, (uint64_t) om->M * Ld);
     }
 
     /* Estimate bias correction, by computing what the score would've been without
@@ -916,8 +1412,10 @@ rescore_isolated_domain(P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, c
     domcorrection = envsc;
     if (scores_arr!=NULL) { //revert bg and om back to original,
                             //and while I'm at it, capture what the default parameterized score would have been, for "null2"
+      p7_STAGE_START(st, t0);
       reparameterize_model (bg, om, NULL, 0, 0, fwd_emissions_arr, bg_tmp->f, scores_arr);
       p7_Forward (sq->dsq + i-1, Ld, om,      ox1, &domcorrection);
+      p7_STAGE_STOP(st, p7_STAGE_NULL2, t0, (uint64_t) om->M * Ld);
     }
 
     p7_oprofile_ReconfigRestLength(om, orig_L);
@@ -937,9 +1435,11 @@ rescore_isolated_domain(P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, c
      * do it now, by the expectation (posterior decoding) method.
      */
       if (!null2_is_done) {
+        p7_STAGE_START(st, t0);
         p7_Null2_ByExpectation(om, ox2, null2);
         for (pos = i; pos <= j; pos++)
           ddef->n2sc[pos]  = logf(null2[sq->dsq[pos]]);
+        p7_STAGE_STOP(st, p7_STAGE_NULL2, t0, (uint64_t) om->M * Ld);
       }
       for (pos = i; pos <= j; pos++)
         domcorrection   += ddef->n2sc[pos];         /* domcorrection is in units of NATS */
@@ -949,10 +1449,12 @@ rescore_isolated_domain(P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, c
   }
 
 
-  dom->iali          = dom->ad->sqfrom;
-  dom->jali          = dom->ad->sqto;
+  dom->iali          = (dom->ad ? dom->ad->sqfrom : i); /* deferred: envelope, until p7_domaindef_AlignEnvelope() */
+  dom->jali          = (dom->ad ? dom->ad->sqto   : j);
   dom->ienv          = i;
   dom->jenv          = j;
+  dom->iorf          = 0;     /* set by the pipeline only for translated (ORF) hits */
+  dom->jorf          = 0;
   dom->envsc         = envsc;         /* in units of NATS */
   dom->oasc          = oasc;        /* in units of expected # of correctly aligned residues */
   dom->dombias       = 0.0; /* gets set later, using bg->omega and dombias */
@@ -962,19 +1464,380 @@ rescore_isolated_domain(P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, c
   dom->is_included   = FALSE; /* gets set later by caller */
 
 
-  ddef->ndom++;
+  p7_trace_Reuse(tr);
+  return eslOK;
+}
+  
+    
+/*****************************************************************
+ * 4. P7_DOMAINPOOL: helper threads for rescoring envelopes
+ *****************************************************************/
+#ifdef HMMER_THREADS
+
+/* One target's queued envelopes, posted to the pool by the thread
+ * that is defining its domains. That thread and any idle helpers
+ * claim envelopes one at a time until all are taken; the posting
+ * thread then waits for the helpers' last ones to finish.
+ */
+typedef struct domainbatch_s {
+  P7_DOMAINDEF   *ddef;
+  P7_OPROFILE    *om;		/* long targets: a private snapshot that helpers copy, since the poster's <om> gets reparameterized */
+  P7_BG          *bg;		/* likewise */
+  const ESL_SQ   *sq;
+  const ESL_SQ   *ntsq;
+  float          *fwd_emissions_arr;	/* read only */
+  int             long_target;
+  int             do_reparam;	/* TRUE if the poster passed a <scores_arr>: long target null2 by reparameterization */
+  uint64_t        id;		/* unique id; helpers use it to know when their copies of <om>,<bg> are stale */
+  int             nclaimed;	/* env[0..nclaimed-1] have been taken by some thread */
+  int             ndone;	/* this many have been rescored */
+  struct domainbatch_s *next;
+} DOMAINBATCH;
+
+/* A helper thread's own working memory. */
+typedef struct {
+  P7_DOMAINPOOL  *pool;
+  P7_OMX         *ox1;
+  P7_OMX         *ox2;
+  P7_TRACE       *tr;
+  uint64_t        copy_id;	/* batch that <om>, <bg> were copied from; 0 = none */
+  P7_OPROFILE    *om;
+  P7_BG          *bg;
+  P7_BG          *bg_tmp;
+  float          *scores_arr;
+  P7_STAGESTATS   stats;	/* stage timing of the current envelope (--stagestats); folded into its ddef's under the mutex */
+} DOMAINWORKER;
+
+struct p7_domainpool_s {
+  int              nworkers;	/* number of helper threads running */
+  pthread_t       *threads;
+  DOMAINWORKER    *wrk;		/* wrk[0..nalloc-1] are allocated */
+  int              nalloc;
+  pthread_mutex_t  mutex;
+  pthread_cond_t   work_cond;	/* broadcast when a batch is posted, or at shutdown */
+  pthread_cond_t   done_cond;	/* broadcast when a helper finishes the last envelope of a batch */
+  DOMAINBATCH     *head;	/* batches with unclaimed envelopes, oldest first */
+  uint64_t         nbatches;
+  int              shutdown;
+};
+
+static void *domainpool_thread(void *arg);
+
+
+/* Function:  p7_domainpool_Create()
+ * Synopsis:  Start a pool of helper threads for domain definition.
+ *
+ * Purpose:   Create a pool of <nworkers> helper threads that rescore
+ *            domain envelopes for any number of <P7_DOMAINDEF>s.
+ *            A program typically creates one pool, sized to its
+ *            number of worker threads, and registers it in each
+ *            pipeline's <ddef->pool>.
+ *
+ *            The helpers sit idle until a target is big enough that
+ *            <p7_domaindef_ByPosteriorHeuristics()> posts its
+ *            envelopes to the pool. Then the posting thread and
+ *            any idle helpers rescore them together, so one huge
+ *            target doesn't hold up the end of a search while the
+ *            other threads have nothing to do.
+ *
+ * Returns:   a pointer to the new pool.
+ *
+ * Throws:    <NULL> on allocation or thread creation failure.
+ */
+P7_DOMAINPOOL *
+p7_domainpool_Create(int nworkers)
+{
+  P7_DOMAINPOOL *pool = NULL;
+  DOMAINWORKER  *w;
+  int            status;
+
+  ESL_ALLOC(pool, sizeof(P7_DOMAINPOOL));
+  pool->nworkers = 0;
+  pool->threads  = NULL;
+  pool->wrk      = NULL;
+  pool->nalloc   = 0;
+  pool->head     = NULL;
+  pool->nbatches = 0;
+  pool->shutdown = FALSE;
+
+  if (pthread_mutex_init(&pool->mutex,     NULL) != 0) ESL_XEXCEPTION(eslESYS, "mutex init failed");
+  if (pthread_cond_init (&pool->work_cond, NULL) != 0) ESL_XEXCEPTION(eslESYS, "cond init failed");
+  if (pthread_cond_init (&pool->done_cond, NULL) != 0) ESL_XEXCEPTION(eslESYS, "cond init failed");
+
+  ESL_ALLOC(pool->threads, sizeof(pthread_t)    * nworkers);
+  ESL_ALLOC(pool->wrk,     sizeof(DOMAINWORKER) * nworkers);
+  for (pool->nalloc = 0; pool->nalloc < nworkers; pool->nalloc++)
+    {
+      w = &(pool->wrk[pool->nalloc]);
+      w->pool       = pool;
+      w->ox1        = p7_omx_Create(100, 100, 100);
+      w->ox2        = p7_omx_Create(100, 100, 100);
+      w->tr         = p7_trace_CreateWithPP();
+      w->copy_id    = 0;
+      w->om         = NULL;
+      w->bg         = NULL;
+      w->bg_tmp     = NULL;
+      w->scores_arr = NULL;
+      if (w->ox1 == NULL || w->ox2 == NULL || w->tr == NULL) { pool->nalloc++; status = eslEMEM; goto ERROR; }
+    }
+
+  for (pool->nworkers = 0; pool->nworkers < nworkers; pool->nworkers++)
+    if (pthread_create(&(pool->threads[pool->nworkers]), NULL, domainpool_thread, &(pool->wrk[pool->nworkers])) != 0)
+      ESL_XEXCEPTION(eslESYS, "failed to create helper thread");
+  return pool;
+
+ ERROR:
+  p7_domainpool_Destroy(pool);
+  return NULL;
+}
 
-  p7_trace_Reuse(ddef->tr);
+
+/* Function:  p7_domainpool_Destroy()
+ * Synopsis:  Stop and free a pool of helper threads.
+ *
+ * Purpose:   Stop the helper threads in <pool> and free it. The
+ *            caller makes sure no <P7_DOMAINDEF> is still using it.
+ */
+void
+p7_domainpool_Destroy(P7_DOMAINPOOL *pool)
+{
+  DOMAINWORKER *w;
+  int           n;
+
+  if (pool == NULL) return;
+
+  pthread_mutex_lock(&pool->mutex);
+  pool->shutdown = TRUE;
+  pthread_cond_broadcast(&pool->work_cond);
+  pthread_mutex_unlock(&pool->mutex);
+  for (n = 0; n < pool->nworkers; n++)
+    pthread_join(pool->threads[n], NULL);
+
+  for (n = 0; n < pool->nalloc; n++)
+    {
+      w = &(pool->wrk[n]);
+      p7_omx_Destroy(w->ox1);
+      p7_omx_Destroy(w->ox2);
+      p7_trace_Destroy(w->tr);
+      if (w->om         != NULL) p7_oprofile_Destroy(w->om);
+      if (w->bg         != NULL) p7_bg_Destroy(w->bg);
+      if (w->bg_tmp     != NULL) p7_bg_Destroy(w->bg_tmp);
+      if (w->scores_arr != NULL) free(w->scores_arr);
+    }
+  pthread_cond_destroy(&pool->done_cond);
+  pthread_cond_destroy(&pool->work_cond);
+  pthread_mutex_destroy(&pool->mutex);
+  if (pool->wrk     != NULL) free(pool->wrk);
+  if (pool->threads != NULL) free(pool->threads);
+  free(pool);
+}
+
+
+/* domainpool_claim()
+ *
+ * Take the next unclaimed envelope of batch <b>, and return its
+ * index; when that was the last one, take <b> off the pool's list.
+ * Caller holds the pool mutex, and has checked that <b> has an
+ * unclaimed envelope.
+ */
+static int
+domainpool_claim(P7_DOMAINPOOL *pool, DOMAINBATCH *b)
+{
+  DOMAINBATCH **p;
+  int           e = b->nclaimed++;
+
+  if (b->nclaimed == b->ddef->nenv)
+    {
+      for (p = &(pool->head); *p != b; p = &((*p)->next)) ;
+      *p = b->next;
+    }
+  return e;
+}
+
+
+/* domainpool_rescore()
+ *
+ * Helper <w> rescores envelope <e> of batch <b>. For a long target,
+ * rescoring reparameterizes the model and background in place, so
+ * the helper works on its own copies of them, made from the batch's
+ * snapshots and kept until the helper moves on to another batch.
+ */
+static int
+domainpool_rescore(DOMAINWORKER *w, DOMAINBATCH *b, int e)
+{
+  P7_ENVELOPE *env    = &(b->ddef->env[e]);
+  P7_OPROFILE *om     = b->om;
+  P7_BG       *bg     = b->bg;
+  P7_BG       *bg_tmp = NULL;
+  float       *sc     = NULL;
+  int          Ld     = env->j - env->i + 1;
+  int          status;
+
+  if (b->long_target)
+    {
+      if (w->copy_id != b->id)
+	{
+	  if (w->om         != NULL) { p7_oprofile_Destroy(w->om); w->om         = NULL; }
+	  if (w->bg         != NULL) { p7_bg_Destroy(w->bg);       w->bg         = NULL; }
+	  if (w->bg_tmp     != NULL) { p7_bg_Destroy(w->bg_tmp);   w->bg_tmp     = NULL; }
+	  if (w->scores_arr != NULL) { free(w->scores_arr);        w->scores_arr = NULL; }
+	  w->copy_id = 0;
+
+	  if ((w->om = p7_oprofile_Copy(b->om)) == NULL) { status = eslEMEM; goto ERROR; }
+	  if (b->bg != NULL) {
+	    if ((w->bg     = p7_bg_Clone(b->bg)) == NULL) { status = eslEMEM; goto ERROR; }
+	    if ((w->bg_tmp = p7_bg_Clone(b->bg)) == NULL) { status = eslEMEM; goto ERROR; }
+	  }
+	  if (b->do_reparam) ESL_ALLOC(w->scores_arr, sizeof(float) * b->om->abc->Kp * 4);
+	  w->copy_id = b->id;
+	}
+      om     = w->om;
+      bg     = w->bg;
+      bg_tmp = w->bg_tmp;
+      sc     = w->scores_arr;
+    }
+
+  if ((status = p7_omx_GrowTo(w->ox1, om->M, Ld, Ld)) != eslOK) goto ERROR;
+  if ((status = p7_omx_GrowTo(w->ox2, om->M, Ld, Ld)) != eslOK) goto ERROR;
+
+  p7_stagestats_Zero(&(w->stats));
+  env->status = rescore_isolated_domain(b->ddef, (b->ddef->stats ? &(w->stats) : NULL), NULL, om, b->sq, b->ntsq, w->ox1, w->ox2, w->tr, env->i, env->j, env->null2_is_done, env->do_align,
+					bg, b->long_target, bg_tmp, sc, b->fwd_emissions_arr, &(env->dom));
+  return eslOK;
+
+ ERROR:
+  env->status = eslFAIL;
+  return status;
+}
+
+
+/* domainpool_thread()
+ *
+ * A helper's main loop: wait for a batch to be posted, claim and
+ * rescore its envelopes, and keep going until the pool shuts down.
+ */
+static void *
+domainpool_thread(void *arg)
+{
+  DOMAINWORKER  *w    = (DOMAINWORKER *) arg;
+  P7_DOMAINPOOL *pool = w->pool;
+  DOMAINBATCH   *b;
+  int            e;
+
+  pthread_mutex_lock(&pool->mutex);
+  while (1)
+    {
+      while (pool->head == NULL && ! pool->shutdown)
+	pthread_cond_wait(&pool->work_cond, &pool->mutex);
+      if (pool->head == NULL) break;	/* shutdown, with no work left */
+
+      b = pool->head;
+      e = domainpool_claim(pool, b);
+      pthread_mutex_unlock(&pool->mutex);
+
+      domainpool_rescore(w, b, e);
+
+      pthread_mutex_lock(&pool->mutex);
+      if (b->ddef->stats) p7_stagestats_Merge(b->ddef->stats, &(w->stats));
+      if (++b->ndone == b->ddef->nenv) pthread_cond_broadcast(&pool->done_cond);
+    }
+  pthread_mutex_unlock(&pool->mutex);
+  pthread_exit(NULL);
+}
+
+
+/* domainpool_Run()
+ *
+ * Post the envelopes queued in <ddef> to <pool>, work on them in this
+ * thread too, and return when they've all been rescored. Arguments
+ * are those of <rescore_envelopes()>; this thread uses its own <om>,
+ * <bg>, <ox1>, <ox2> and <ddef->tr>, exactly as a serial rescore
+ * would.
+ *
+ * Returns <eslOK> on success.
+ *
+ * Throws  <eslEMEM> on allocation failure; <eslESYS> on a threading
+ *         failure.
+ */
+static int
+domainpool_Run(P7_DOMAINPOOL *pool, P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_OMX *ox1, P7_OMX *ox2,
+	       P7_BG *bg, int long_target, P7_BG *bg_tmp, float *scores_arr, float *fwd_emissions_arr)
+{
+  DOMAINBATCH   b;
+  DOMAINBATCH **p;
+  P7_ENVELOPE  *env;
+  P7_STAGESTATS st;		/* this thread's envelope timing, folded into <ddef->stats> under the mutex, as helpers do */
+  int           Ld;
+  int           e;
+  int           status;
+
+  b.ddef              = ddef;
+  b.om                = om;
+  b.bg                = bg;
+  b.sq                = sq;
+  b.ntsq              = ntsq;
+  b.fwd_emissions_arr = fwd_emissions_arr;
+  b.long_target       = long_target;
+  b.do_reparam        = (scores_arr != NULL);
+  b.nclaimed          = 0;
+  b.ndone             = 0;
+  b.next              = NULL;
+
+  if (long_target)
+    {
+      b.om = NULL;
+      b.bg = NULL;
+      if ((b.om = p7_oprofile_Copy(om)) == NULL)              { status = eslEMEM; goto ERROR; }
+      if (bg != NULL && (b.bg = p7_bg_Clone(bg)) == NULL)     { status = eslEMEM; goto ERROR; }
+    }
+
+  if (pthread_mutex_lock(&pool->mutex) != 0) ESL_XEXCEPTION(eslESYS, "mutex lock failed");
+  b.id = ++pool->nbatches;
+  for (p = &(pool->head); *p != NULL; p = &((*p)->next)) ;
+  *p = &b;
+  pthread_cond_broadcast(&pool->work_cond);
+
+  while (b.nclaimed < ddef->nenv)
+    {
+      e = domainpool_claim(pool, &b);
+      pthread_mutex_unlock(&pool->mutex);
+
+      env = &(ddef->env[e]);
+      Ld  = env->j - env->i + 1;
+      p7_stagestats_Zero(&st);
+      if ((status = p7_omx_GrowTo(ox1, om->M, Ld, Ld)) == eslOK &&
+	  (status = p7_omx_GrowTo(ox2, om->M, Ld, Ld)) == eslOK)
+	env->status = rescore_isolated_domain(ddef, (ddef->stats ? &st : NULL), NULL, om, sq, ntsq, ox1, ox2, ddef->tr, env->i, env->j, env->null2_is_done, env->do_align,
+					      bg, long_target, bg_tmp, scores_arr, fwd_emissions_arr, &(env->dom));
+      else
+	env->status = eslFAIL;
+
+      pthread_mutex_lock(&pool->mutex);
+      if (ddef->stats) p7_stagestats_Merge(ddef->stats, &st);
+      b.ndone++;
+    }
+  while (b.ndone < ddef->nenv)
+    pthread_cond_wait(&pool->done_cond, &pool->mutex);
+  pthread_mutex_unlock(&pool->mutex);
+
+  if (long_target) {
+    p7_oprofile_Destroy(b.om);
+    if (b.bg != NULL) p7_bg_Destroy(b.bg);
+  }
   return eslOK;
 
  ERROR:
-  p7_trace_Reuse(ddef->tr);
+  if (long_target) {
+    if (b.om != NULL) p7_oprofile_Destroy(b.om);
+    if (b.bg != NULL) p7_bg_Destroy(b.bg);
+  }
   return status;
 }
+#endif /*HMMER_THREADS*/
   
-    
+
 /*****************************************************************
- * Example driver.
+ * 5. Example drivers
  *****************************************************************/
 
 #ifdef p7DOMAINDEF_EXAMPLE
@@ -1260,3 +2123,182 @@ main(int argc, char **argv)
 }
 #endif /*p7DOMAINDEF_EXAMPLE2*/
 
+
+
+/*****************************************************************
+ * 6. Benchmark driver
+ *****************************************************************/
+#ifdef p7DOMAINDEF_BENCHMARK
+/* gcc -o domaindef_benchmark -O2 -g -Wall -I../easel -L../easel -I. -L. -Dp7DOMAINDEF_BENCHMARK p7_domaindef.c -lhmmer -leasel -lm
+ * ./domaindef_benchmark <hmmfile> <seqfile>
+ *
+ * Compares domain definition by stochastic traceback clustering (the
+ * default) to domain definition by posterior decoding (--nosample),
+ * on every sequence in <seqfile>: CPU time spent in domain definition
+ * in each mode, number of domains found, and how many of the sampled
+ * envelopes are recovered by decoding (reciprocal overlap of at least
+ * 50%).
+ */
+#include "p7_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "easel.h"
+#include "esl_getopts.h"
+#include "esl_random.h"
+#include "esl_alphabet.h"
+#include "esl_sq.h"
+#include "esl_sqio.h"
+#include "esl_stopwatch.h"
+#include "hmmer.h"
+
+static ESL_OPTIONS options[] = {
+  /* name           type      default  env  range toggles reqs incomp  help                                       docgroup*/
+  { "-h",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "show brief help on version and usage",             0 },
+  { "-s",        eslARG_INT,     "42", NULL, NULL,  NULL,  NULL, NULL, "set random number seed to <n>",                    0 },
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+
+static char usage[]  = "[-options] <hmmfile> <seqfile>";
+static char banner[] = "benchmark domain definition: stochastic clustering vs. posterior decoding";
+
+static double
+define_domains(P7_DOMAINDEF *ddef, int do_sampling, ESL_SQ *sq, P7_OPROFILE *om, P7_BG *bg,
+	       P7_OMX *oxf, P7_OMX *oxb, P7_OMX *fwd, P7_OMX *bck, ESL_STOPWATCH *w)
+{
+  float fwdsc;
+
+  p7_domaindef_Reuse(ddef);
+  ddef->do_sampling = do_sampling;
+
+  p7_ForwardParser (sq->dsq, sq->n, om,      oxf, &fwdsc);
+  p7_BackwardParser(sq->dsq, sq->n, om, oxf, oxb, NULL);
+
+  esl_stopwatch_Start(w);
+  if (p7_domaindef_ByPosteriorHeuristics(sq, NULL, om, oxf, oxb, fwd, bck, ddef, bg, FALSE, NULL, NULL, NULL) != eslOK)
+    p7_Fail("domain definition failed on %s", sq->name);
+  esl_stopwatch_Stop(w);
+  return w->user;
+}
+
+int 
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go      = p7_CreateDefaultApp(options, 2, argc, argv, banner, usage);
+  ESL_RANDOMNESS *r       = esl_randomness_CreateFast(esl_opt_GetInteger(go, "-s"));
+  ESL_STOPWATCH  *w       = esl_stopwatch_Create();
+  char           *hmmfile = esl_opt_GetArg(go, 1);
+  P7_HMMFILE     *hfp     = NULL;
+  P7_HMM         *hmm     = NULL;
+  char           *seqfile = esl_opt_GetArg(go, 2);
+  ESL_SQFILE     *sqfp    = NULL;
+  ESL_SQ         *sq      = NULL;
+  ESL_ALPHABET   *abc     = NULL;
+  P7_BG          *bg      = NULL;
+  P7_PROFILE     *gm      = NULL;
+  P7_OPROFILE    *om      = NULL;
+  P7_OMX         *oxf     = NULL;
+  P7_OMX         *oxb     = NULL;
+  P7_OMX         *fwd     = NULL;
+  P7_OMX         *bck     = NULL;
+  P7_DOMAINDEF   *ddef    = NULL;
+  int64_t        *env     = NULL;  /* sampled envelopes, env[2d] = ienv, env[2d+1] = jenv */
+  int             nalloc  = 0;
+  double          t_sample = 0.;
+  double          t_decode = 0.;
+  int             nseq     = 0;
+  int             ndiffer  = 0;	   /* sequences on which the two modes find different numbers of domains */
+  int             n_sample = 0;
+  int             n_decode = 0;
+  int             n_agree  = 0;
+  int64_t         lo, hi, len1, len2;
+  int             d, d2, nd;
+  int             status;
+
+  if (p7_hmmfile_OpenE(hmmfile, NULL, &hfp, NULL) != eslOK) p7_Fail("Failed to open HMM file %s", hmmfile);
+  if (p7_hmmfile_Read(hfp, &abc, &hmm)            != eslOK) p7_Fail("Failed to read HMM");
+  p7_hmmfile_Close(hfp);
+
+  status = esl_sqfile_OpenDigital(abc, seqfile, eslSQFILE_UNKNOWN, NULL, &sqfp);
+  if      (status == eslENOTFOUND) p7_Fail("No such file.");
+  else if (status == eslEFORMAT)   p7_Fail("Format unrecognized.");
+  else if (status != eslOK)        p7_Fail("Open failed, code %d.", status);
+  sq = esl_sq_CreateDigital(abc);
+
+  p7_FLogsumInit();
+  bg = p7_bg_Create(abc);
+  gm = p7_profile_Create(hmm->M, abc);
+  om = p7_oprofile_Create(hmm->M, abc);
+  p7_ProfileConfig(hmm, bg, gm, 400, p7_LOCAL);
+  p7_oprofile_Convert(gm, om);
+
+  ddef = p7_domaindef_Create(r);
+  oxf  = p7_omx_Create(om->M, 0, 400);
+  oxb  = p7_omx_Create(om->M, 0, 400);
+  fwd  = p7_omx_Create(om->M, 0, 0);
+  bck  = p7_omx_Create(om->M, 0, 0);
+
+  while ((status = esl_sqio_Read(sqfp, sq)) == eslOK)
+    {
+      p7_bg_SetLength(bg, sq->n);
+      p7_oprofile_ReconfigLength(om, sq->n);
+      p7_omx_GrowTo(oxf, om->M, 0, sq->n);
+      p7_omx_GrowTo(oxb, om->M, 0, sq->n);
+
+      t_sample += define_domains(ddef, TRUE, sq, om, bg, oxf, oxb, fwd, bck, w);
+      nd        = ddef->ndom;
+      if (2*nd > nalloc) {
+	nalloc = 2*nd;
+	if ((env = realloc(env, sizeof(int64_t) * nalloc)) == NULL) p7_Fail("allocation failed");
+      }
+      for (d = 0; d < nd; d++) { env[2*d] = ddef->dcl[d].ienv; env[2*d+1] = ddef->dcl[d].jenv; }
+
+      t_decode += define_domains(ddef, FALSE, sq, om, bg, oxf, oxb, fwd, bck, w);
+
+      for (d = 0; d < nd; d++)
+	for (d2 = 0; d2 < ddef->ndom; d2++)
+	  {
+	    lo   = ESL_MAX(env[2*d],   ddef->dcl[d2].ienv);
+	    hi   = ESL_MIN(env[2*d+1], ddef->dcl[d2].jenv);
+	    len1 = env[2*d+1] - env[2*d] + 1;
+	    len2 = ddef->dcl[d2].jenv - ddef->dcl[d2].ienv + 1;
+	    if (hi >= lo && 2*(hi-lo+1) >= len1 && 2*(hi-lo+1) >= len2) { n_agree++; break; }
+	  }
+
+      if (nd != ddef->ndom) ndiffer++;
+      n_sample += nd;
+      n_decode += ddef->ndom;
+      nseq++;
+      esl_sq_Reuse(sq);
+    }
+  if      (status == eslEFORMAT) p7_Fail("Parse failed (sequence file %s):\n%s\n", sqfp->filename, esl_sqfile_GetErrorBuf(sqfp));
+  else if (status != eslEOF)     p7_Fail("Unexpected error %d reading sequence file %s", status, sqfp->filename);
+
+  printf("Sequences:                  %d\n", nseq);
+  printf("Domains, sampling:          %d\n", n_sample);
+  printf("Domains, decoding:          %d\n", n_decode);
+  printf("Sequences w/ different n:   %d\n", ndiffer);
+  printf("Sampled envelopes recovered: %d (%.2f%%)\n", n_agree, n_sample ? 100. * (double) n_agree / (double) n_sample : 0.);
+  printf("CPU time, sampling:         %.2f sec\n", t_sample);
+  printf("CPU time, decoding:         %.2f sec\n", t_decode);
+
+  free(env);
+  p7_domaindef_Destroy(ddef);
+  p7_omx_Destroy(oxf);
+  p7_omx_Destroy(oxb);
+  p7_omx_Destroy(fwd);
+  p7_omx_Destroy(bck);
+  p7_profile_Destroy(gm);
+  p7_oprofile_Destroy(om);
+  p7_bg_Destroy(bg);
+  p7_hmm_Destroy(hmm);
+  esl_sqfile_Close(sqfp);
+  esl_sq_Destroy(sq);
+  esl_alphabet_Destroy(abc);
+  esl_stopwatch_Destroy(w);
+  esl_randomness_Destroy(r);
+  esl_getopts_Destroy(go);
+  return 0;
+}
+#endif /*p7DOMAINDEF_BENCHMARK*/
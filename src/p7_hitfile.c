@@ -0,0 +1,1095 @@
+/* P7_HITFILE: compact binary output of hit lists, and reading it back.
+ *
+ * The tabular outputs (--tblout, --domtblout) are meant to be easy to
+ * parse, but with very many hits, re-parsing their text dominates
+ * downstream processing. A binary hit file (--hitout) holds the same
+ * information in fixed-width records that can be read (or mmap'ed)
+ * without parsing. The reader here rebuilds a <P7_TOPHITS> for each
+ * query, and the tabular outputs can be regenerated from it with
+ * exactly the same text the search program would have produced
+ * (see the <hmmhitconvert> program).
+ *
+ * File format, version 1. All numbers are in the byte order of the
+ * machine that wrote the file; a reader on a machine of the other
+ * byte order sees a byteswapped magic number and refuses the file.
+ *
+ *    uint32_t magic;                       p7_HITFILE_MAGIC_V1
+ *    then any number of blocks, each:
+ *      uint32_t tag;                       p7_HITFILE_QUERY | p7_HITFILE_TAIL; others are skipped
+ *      uint32_t reserved;                  0
+ *      uint64_t nbytes;                    size of the block's payload that follows
+ *      ... payload ...
+ *
+ * A QUERY block holds the hits for one query:
+ *      QUERYHDR                            (below)
+ *      HITREC   [nhits]                    every target in the hit list, in rank order;
+ *                                          flags say which are reported and included
+ *      DOMREC   [ndom]                     all their domains; hit h owns
+ *                                          DOMREC[dom0 .. dom0+ndom-1]
+ *      char     strtab[strsize]            NUL-terminated strings; records refer to
+ *                                          them by byte offset, or -1 for none
+ *
+ * A TAIL block, written last, holds the strings for the "# Program:"
+ * etc. tail of tabular output, NUL-terminated, in the order they're
+ * printed: program, version, pipeline mode, query file, target file,
+ * option settings, current dir, date.
+ *
+ * The record layouts below are fixed; every field is naturally
+ * aligned and there is no implicit padding. Changing them requires
+ * a new magic number.
+ *
+ * Contents:
+ *    1. Writing binary hit files.
+ *    2. The P7_HITFILE reader.
+ *    3. Regenerating tabular output.
+ *    4. Unit tests.
+ *    5. Test driver.
+ */
+#include "p7_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "easel.h"
+#include "esl_getopts.h"
+
+#include "hmmer.h"
+
+static uint32_t p7_HITFILE_MAGIC_V1   = 0xe8e9f4b1; /* "hit1" + 0x80808080 */
+static uint32_t p7_HITFILE_MAGIC_SWAP = 0xb1f4e9e8; /* byteswapped v1      */
+
+#define p7_HITFILE_QUERY  1
+#define p7_HITFILE_TAIL   2
+
+#define p7_HITFILE_DOM_REPORTED (1<<0)
+#define p7_HITFILE_DOM_INCLUDED (1<<1)
+#define p7_HITFILE_DOM_HAS_AD   (1<<2)	/* hmmfrom, hmmto, M, sqfrom, sqto come from an alignment display */
+
+typedef struct {
+  uint32_t tag;
+  uint32_t reserved;
+  uint64_t nbytes;
+} BLOCKHDR;
+
+typedef struct {
+  double   Z;			/* effective # of targets, per-target E-values   */
+  double   domZ;		/* effective # of targets, per-domain E-values   */
+  uint64_t nhits;		/* # of HITRECs that follow                      */
+  uint64_t ndom;		/* # of DOMRECs that follow them                 */
+  uint64_t strsize;		/* size of string table, in bytes                */
+  int64_t  qname;		/* query name (string table offset)              */
+  int64_t  qacc;		/* query accession, or -1                        */
+  int32_t  mode;		/* p7_SEARCH_SEQS | p7_SCAN_MODELS               */
+  int32_t  long_targets;	/* TRUE for nhmmer-style long target hit lists   */
+} QUERYHDR;			/* 64 bytes */
+
+typedef struct {
+  int64_t  name;		/* target name (string table offset)        */
+  int64_t  acc;			/* target accession, or -1                  */
+  int64_t  desc;		/* target description, or -1                */
+  int64_t  seqidx;
+  int64_t  subseq_start;
+  uint64_t dom0;		/* index of this hit's first DOMREC         */
+  double   sortkey;
+  double   lnP;
+  double   pre_lnP;
+  double   sum_lnP;
+  float    score;
+  float    pre_score;
+  float    sum_score;
+  float    nexpected;
+  int32_t  window_length;
+  int32_t  nregions;
+  int32_t  nclustered;
+  int32_t  noverlaps;
+  int32_t  nenvelopes;
+  int32_t  ndom;
+  int32_t  nreported;
+  int32_t  nincluded;
+  int32_t  best_domain;
+  uint32_t flags;		/* p7_IS_REPORTED | p7_IS_INCLUDED | ...    */
+} HITREC;			/* 136 bytes */
+
+typedef struct {
+  int64_t  ienv, jenv;
+  int64_t  iali, jali;
+  int64_t  iorf, jorf;
+  int64_t  sqfrom, sqto;	/* from the alignment display, else iali..jali       */
+  int64_t  L;			/* length of the target sequence                     */
+  double   lnP;
+  float    envsc;
+  float    domcorrection;
+  float    dombias;
+  float    oasc;
+  float    bitscore;
+  int32_t  hmmfrom, hmmto;	/* from the alignment display, else 0                */
+  int32_t  M;			/* model length, from the alignment display, else 0  */
+  uint32_t flags;		/* p7_HITFILE_DOM_REPORTED | _INCLUDED | _HAS_AD     */
+  uint32_t reserved;
+} DOMREC;			/* 120 bytes */
+
+static int write_block_header(FILE *ofp, uint32_t tag, uint64_t nbytes);
+static int write_string(FILE *ofp, const char *s);
+static int read_query_block(P7_HITFILE *hfp, uint64_t nbytes, P7_TOPHITS **ret_th);
+static int read_tail_block(P7_HITFILE *hfp, uint64_t nbytes);
+
+
+/*****************************************************************
+ * 1. Writing binary hit files.
+ *****************************************************************/
+
+/* Function:  p7_hitfile_WriteMagic()
+ * Synopsis:  Start a new binary hit file.
+ *
+ * Purpose:   Write the magic number that starts a binary hit file
+ *            to <ofp>. Call once, before any <p7_hitfile_Write()>.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEWRITE> on write failure.
+ */
+int
+p7_hitfile_WriteMagic(FILE *ofp)
+{
+  if (fwrite(&p7_HITFILE_MAGIC_V1, sizeof(uint32_t), 1, ofp) != 1) ESL_EXCEPTION_SYS(eslEWRITE, "binary hit file write failed");
+  return eslOK;
+}
+
+
+/* Function:  p7_hitfile_Write()
+ * Synopsis:  Write one query's hit list to a binary hit file.
+ *
+ * Purpose:   Write sorted hit list <th> for query <qname> (and
+ *            accession <qacc>, which may be <NULL>) to binary hit
+ *            file <ofp>, with the final pipeline accounting stored
+ *            in <pli>. 
+ *
+ *            All hits and all their domains are written, not just
+ *            the reported ones: the tabular outputs size their
+ *            columns over the whole list, and show each hit's best
+ *            domain whether it's reported or not.
+ *
+ *            Call once per query, as the search programs call
+ *            <p7_tophits_TabularTargets()>.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEWRITE> on write failure.
+ */
+int
+p7_hitfile_Write(FILE *ofp, char *qname, char *qacc, P7_TOPHITS *th, P7_PIPELINE *pli)
+{
+  QUERYHDR    qh;
+  HITREC      hr;
+  DOMREC      dr;
+  P7_HIT     *hit;
+  P7_DOMAIN  *dom;
+  int64_t     stroff;
+  uint64_t    h;
+  int         d;
+  int         status;
+
+  /* Pass 1: size everything up. */
+  memset(&qh, 0, sizeof(QUERYHDR));
+  qh.Z            = pli->Z;
+  qh.domZ         = pli->domZ;
+  qh.mode         = pli->mode;
+  qh.long_targets = pli->long_targets;
+  qh.qname        = 0;
+  qh.strsize      = strlen(qname) + 1;
+  if (qacc != NULL && qacc[0] != '\0') { qh.qacc = qh.strsize; qh.strsize += strlen(qacc) + 1; }
+  else                                   qh.qacc = -1;
+  for (h = 0; h < th->N; h++)
+    {
+      hit = th->hit[h];
+      qh.nhits++;
+      qh.ndom    += hit->ndom;
+      qh.strsize += strlen(hit->name) + 1;
+      if (hit->acc  != NULL) qh.strsize += strlen(hit->acc)  + 1;
+      if (hit->desc != NULL) qh.strsize += strlen(hit->desc) + 1;
+    }
+
+  if ((status = write_block_header(ofp, p7_HITFILE_QUERY,
+				   sizeof(QUERYHDR) + qh.nhits * sizeof(HITREC) + qh.ndom * sizeof(DOMREC) + qh.strsize)) != eslOK) return status;
+  if (fwrite(&qh, sizeof(QUERYHDR), 1, ofp) != 1) ESL_EXCEPTION_SYS(eslEWRITE, "binary hit file write failed");
+
+  /* Pass 2: target records. String offsets are assigned in the same order pass 4 writes the strings. */
+  stroff = strlen(qname) + 1 + (qh.qacc == -1 ? 0 : strlen(qacc) + 1);
+  qh.ndom = 0;
+  for (h = 0; h < th->N; h++)
+    {
+      hit = th->hit[h];
+
+      memset(&hr, 0, sizeof(HITREC));
+      hr.name = stroff;                                    stroff += strlen(hit->name) + 1;
+      if (hit->acc  != NULL) { hr.acc  = stroff;           stroff += strlen(hit->acc)  + 1; } else hr.acc  = -1;
+      if (hit->desc != NULL) { hr.desc = stroff;           stroff += strlen(hit->desc) + 1; } else hr.desc = -1;
+      hr.seqidx        = hit->seqidx;
+      hr.subseq_start  = hit->subseq_start;
+      hr.dom0          = qh.ndom;
+      hr.sortkey       = hit->sortkey;
+      hr.lnP           = hit->lnP;
+      hr.pre_lnP       = hit->pre_lnP;
+      hr.sum_lnP       = hit->sum_lnP;
+      hr.score         = hit->score;
+      hr.pre_score     = hit->pre_score;
+      hr.sum_score     = hit->sum_score;
+      hr.nexpected     = hit->nexpected;
+      hr.window_length = hit->window_length;
+      hr.nregions      = hit->nregions;
+      hr.nclustered    = hit->nclustered;
+      hr.noverlaps     = hit->noverlaps;
+      hr.nenvelopes    = hit->nenvelopes;
+      hr.ndom          = hit->ndom;
+      hr.nreported     = hit->nreported;
+      hr.nincluded     = hit->nincluded;
+      hr.best_domain   = hit->best_domain;
+      hr.flags         = hit->flags;
+      qh.ndom         += hit->ndom;
+      if (fwrite(&hr, sizeof(HITREC), 1, ofp) != 1) ESL_EXCEPTION_SYS(eslEWRITE, "binary hit file write failed");
+    }
+
+  /* Pass 3: domain records. */
+  for (h = 0; h < th->N; h++)
+    {
+      hit = th->hit[h];
+
+      for (d = 0; d < hit->ndom; d++)
+	{
+	  dom = &(hit->dcl[d]);
+	  memset(&dr, 0, sizeof(DOMREC));
+	  dr.ienv          = dom->ienv;
+	  dr.jenv          = dom->jenv;
+	  dr.iali          = dom->iali;
+	  dr.jali          = dom->jali;
+	  dr.iorf          = dom->iorf;
+	  dr.jorf          = dom->jorf;
+	  dr.lnP           = dom->lnP;
+	  dr.envsc         = dom->envsc;
+	  dr.domcorrection = dom->domcorrection;
+	  dr.dombias       = dom->dombias;
+	  dr.oasc          = dom->oasc;
+	  dr.bitscore      = dom->bitscore;
+	  if (dom->is_reported) dr.flags |= p7_HITFILE_DOM_REPORTED;
+	  if (dom->is_included) dr.flags |= p7_HITFILE_DOM_INCLUDED;
+	  if (dom->ad != NULL)
+	    {
+	      dr.flags  |= p7_HITFILE_DOM_HAS_AD;
+	      dr.sqfrom  = dom->ad->sqfrom;
+	      dr.sqto    = dom->ad->sqto;
+	      dr.L       = dom->ad->L;
+	      dr.hmmfrom = dom->ad->hmmfrom;
+	      dr.hmmto   = dom->ad->hmmto;
+	      dr.M       = dom->ad->M;
+	    }
+	  else			/* alignment was deferred, and this domain never needed one */
+	    {
+	      dr.sqfrom  = dom->iali;
+	      dr.sqto    = dom->jali;
+	      dr.L       = dom->L;
+	    }
+	  if (fwrite(&dr, sizeof(DOMREC), 1, ofp) != 1) ESL_EXCEPTION_SYS(eslEWRITE, "binary hit file write failed");
+	}
+    }
+
+  /* Pass 4: the string table. */
+  if ((status = write_string(ofp, qname)) != eslOK) return status;
+  if (qh.qacc != -1 && (status = write_string(ofp, qacc)) != eslOK) return status;
+  for (h = 0; h < th->N; h++)
+    {
+      hit = th->hit[h];
+      if (                     (status = write_string(ofp, hit->name)) != eslOK) return status;
+      if (hit->acc  != NULL && (status = write_string(ofp, hit->acc))  != eslOK) return status;
+      if (hit->desc != NULL && (status = write_string(ofp, hit->desc)) != eslOK) return status;
+    }
+  return eslOK;
+}
+
+
+/* Function:  p7_hitfile_WriteTail()
+ * Synopsis:  Finish a binary hit file.
+ *
+ * Purpose:   Write the record of the program, its version, its
+ *            input files and its options, for regenerating the tail
+ *            of tabular output, to binary hit file <ofp>. Arguments
+ *            are as for <p7_tophits_TabularTail()>. Call once, after
+ *            the last <p7_hitfile_Write()>.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ *            <eslESYS> if time() or ctime_r() system calls fail.
+ *            <eslEWRITE> on write failure.
+ */
+int
+p7_hitfile_WriteTail(FILE *ofp, const char *progname, enum p7_pipemodes_e pipemode, const char *qfile, const char *tfile, const ESL_GETOPTS *go)
+{
+  time_t  date       = time(NULL);
+  char   *spoof_cmd  = NULL;
+  char   *cwd        = NULL;
+  char    timestamp[32];
+  char    version[128];
+  char   *s[8];
+  uint64_t nbytes    = 0;
+  int     i;
+  int     status;
+
+  if ((status = esl_opt_SpoofCmdline(go, &spoof_cmd)) != eslOK) goto ERROR;
+  if (date == -1)                                               ESL_XEXCEPTION(eslESYS, "time() failed");
+  if ((ctime_r(&date, timestamp)) == NULL)                      ESL_XEXCEPTION(eslESYS, "ctime_r() failed");
+  esl_getcwd(&cwd);
+  snprintf(version, 128, "%s (%s)", HMMER_VERSION, HMMER_DATE);
+
+  s[0] = (char *) ((progname == NULL) ? "[none]" : progname);
+  s[1] = version;
+  s[2] = (pipemode == p7_SCAN_MODELS ? "SCAN" : "SEARCH");
+  s[3] = (char *) ((qfile == NULL) ? "[none]" : qfile);
+  s[4] = (char *) ((tfile == NULL) ? "[none]" : tfile);
+  s[5] = spoof_cmd;
+  s[6] = (cwd == NULL) ? "[unknown]" : cwd;
+  s[7] = timestamp;		/* ends in \n, as ctime_r() gives it */
+  for (i = 0; i < 8; i++) nbytes += strlen(s[i]) + 1;
+
+  if ((status = write_block_header(ofp, p7_HITFILE_TAIL, nbytes)) != eslOK) goto ERROR;
+  for (i = 0; i < 8; i++)
+    if ((status = write_string(ofp, s[i])) != eslOK) goto ERROR;
+
+  free(spoof_cmd);
+  if (cwd) free(cwd);
+  return eslOK;
+
+ ERROR:
+  if (spoof_cmd) free(spoof_cmd);
+  if (cwd)       free(cwd);
+  return status;
+}
+
+static int
+write_block_header(FILE *ofp, uint32_t tag, uint64_t nbytes)
+{
+  BLOCKHDR bh;
+
+  bh.tag      = tag;
+  bh.reserved = 0;
+  bh.nbytes   = nbytes;
+  if (fwrite(&bh, sizeof(BLOCKHDR), 1, ofp) != 1) ESL_EXCEPTION_SYS(eslEWRITE, "binary hit file write failed");
+  return eslOK;
+}
+
+static int
+write_string(FILE *ofp, const char *s)
+{
+  if (fwrite(s, sizeof(char), strlen(s) + 1, ofp) != strlen(s) + 1) ESL_EXCEPTION_SYS(eslEWRITE, "binary hit file write failed");
+  return eslOK;
+}
+/*------------------ end, writing hit files ---------------------*/
+
+
+
+/*****************************************************************
+ * 2. The P7_HITFILE reader.
+ *****************************************************************/
+
+/* Function:  p7_hitfile_Open()
+ * Synopsis:  Open a binary hit file for reading.
+ *
+ * Purpose:   Open binary hit file <filename> for reading, and check
+ *            its magic number. If <filename> is "-", read from
+ *            <stdin>. Return the open <P7_HITFILE> in <*ret_hfp>.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ *            <eslENOTFOUND> if <filename> can't be opened for
+ *            reading, and <eslEFORMAT> if it isn't a binary hit
+ *            file; <*ret_hfp> is <NULL>, and <errbuf>, if non-NULL,
+ *            contains an informative message.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ */
+int
+p7_hitfile_Open(const char *filename, P7_HITFILE **ret_hfp, char *errbuf)
+{
+  P7_HITFILE *hfp = NULL;
+  uint32_t    magic;
+  int         i;
+  int         status;
+
+  if (errbuf) errbuf[0] = '\0';
+
+  ESL_ALLOC(hfp, sizeof(P7_HITFILE));
+  hfp->f            = NULL;
+  hfp->fname        = NULL;
+  hfp->do_stdin     = FALSE;
+  hfp->qname        = NULL;
+  hfp->qacc         = NULL;
+  hfp->mode         = p7_SEARCH_SEQS;
+  hfp->long_targets = FALSE;
+  hfp->Z            = 0.;
+  hfp->domZ         = 0.;
+  hfp->nqueries     = 0;
+  hfp->has_tail     = FALSE;
+  for (i = 0; i < 8; i++) hfp->tail[i] = NULL;
+  hfp->errbuf[0]    = '\0';
+
+  if (strcmp(filename, "-") == 0)
+    {
+      hfp->f        = stdin;
+      hfp->do_stdin = TRUE;
+      if ((status = esl_strdup("[STDIN]", -1, &(hfp->fname))) != eslOK) goto ERROR;
+    }
+  else
+    {
+      if ((hfp->f = fopen(filename, "rb")) == NULL) ESL_XFAIL(eslENOTFOUND, errbuf, "Failed to open binary hit file %s for reading", filename);
+      if ((status = esl_strdup(filename, -1, &(hfp->fname))) != eslOK) goto ERROR;
+    }
+
+  if (fread(&magic, sizeof(uint32_t), 1, hfp->f) != 1) ESL_XFAIL(eslEFORMAT, errbuf, "File %s is empty", hfp->fname);
+  if      (magic == p7_HITFILE_MAGIC_SWAP)            ESL_XFAIL(eslEFORMAT, errbuf, "File %s is a binary hit file written on a machine of different byte order", hfp->fname);
+  else if (magic != p7_HITFILE_MAGIC_V1)              ESL_XFAIL(eslEFORMAT, errbuf, "File %s is not a binary hit file", hfp->fname);
+
+  *ret_hfp = hfp;
+  return eslOK;
+
+ ERROR:
+  p7_hitfile_Close(hfp);
+  *ret_hfp = NULL;
+  return status;
+}
+
+
+/* Function:  p7_hitfile_Read()
+ * Synopsis:  Read the next query's hit list from a binary hit file.
+ *
+ * Purpose:   Read the next query's hit list from open binary hit
+ *            file <hfp>, and return it in <*ret_th>, sorted in the
+ *            order it was written. Everything in the new list is
+ *            allocated in its own arena, and is free'd by
+ *            <p7_tophits_Destroy()>. Domains carry minimal
+ *            alignment displays, with coordinates and lengths but
+ *            no alignment.
+ *
+ *            The query's name, accession, and pipeline accounting
+ *            are left in <hfp>: <hfp->qname>, <hfp->qacc> (<NULL> if
+ *            none), <hfp->mode>, <hfp->long_targets>, <hfp->Z>, and
+ *            <hfp->domZ>. These stay valid until the next read.
+ *
+ *            Once the file's tail has been read, <hfp->has_tail> is
+ *            <TRUE>, and <hfp->tail[]> holds its strings.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ *            <eslEOF> if there are no more hit lists in the file.
+ *
+ *            <eslEFORMAT> if the file is corrupt or truncated;
+ *            <hfp->errbuf> contains an informative message.
+ *
+ *            In either case, <*ret_th> is <NULL>.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ */
+int
+p7_hitfile_Read(P7_HITFILE *hfp, P7_TOPHITS **ret_th)
+{
+  BLOCKHDR bh;
+  char     buf[4096];
+  uint64_t n;
+  int      status;
+
+  *ret_th = NULL;
+  while (fread(&bh, sizeof(BLOCKHDR), 1, hfp->f) == 1)
+    {
+      if      (bh.tag == p7_HITFILE_QUERY) return read_query_block(hfp, bh.nbytes, ret_th);
+      else if (bh.tag == p7_HITFILE_TAIL)
+	{
+	  if ((status = read_tail_block(hfp, bh.nbytes)) != eslOK) return status;
+	}
+      else 			/* an unknown block type: skip it */
+	{
+	  for (; bh.nbytes > 0; bh.nbytes -= n)
+	    {
+	      n = ESL_MIN(bh.nbytes, sizeof(buf));
+	      if (fread(buf, 1, n, hfp->f) != n) ESL_FAIL(eslEFORMAT, hfp->errbuf, "binary hit file %s is truncated", hfp->fname);
+	    }
+	}
+    }
+  if (! feof(hfp->f)) ESL_FAIL(eslEFORMAT, hfp->errbuf, "failed to read binary hit file %s", hfp->fname);
+  return eslEOF;
+}
+
+
+/* Function:  p7_hitfile_Close()
+ * Synopsis:  Close a binary hit file.
+ */
+void
+p7_hitfile_Close(P7_HITFILE *hfp)
+{
+  int i;
+
+  if (hfp == NULL) return;
+  if (hfp->f != NULL && ! hfp->do_stdin) fclose(hfp->f);
+  if (hfp->fname) free(hfp->fname);
+  if (hfp->qname) free(hfp->qname);
+  if (hfp->qacc)  free(hfp->qacc);
+  for (i = 0; i < 8; i++)
+    if (hfp->tail[i]) free(hfp->tail[i]);
+  free(hfp);
+}
+
+
+/* read_query_block()
+ * Read the payload of a QUERY block, <nbytes> long, from <hfp>,
+ * and build its hit list.
+ */
+static int
+read_query_block(P7_HITFILE *hfp, uint64_t nbytes, P7_TOPHITS **ret_th)
+{
+  QUERYHDR    qh;
+  HITREC     *hr     = NULL;
+  DOMREC     *dr     = NULL;
+  char       *strtab = NULL;
+  P7_TOPHITS *th     = NULL;
+  P7_HIT     *hit    = NULL;
+  P7_DOMAIN  *dom    = NULL;
+  uint64_t    h;
+  int         d;
+  int         status;
+
+  if (nbytes < sizeof(QUERYHDR) || fread(&qh, sizeof(QUERYHDR), 1, hfp->f) != 1)
+    ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary hit file %s is truncated", hfp->fname);
+  if (qh.strsize == 0 || nbytes != sizeof(QUERYHDR) + qh.nhits * sizeof(HITREC) + qh.ndom * sizeof(DOMREC) + qh.strsize)
+    ESL_XFAIL(eslEFORMAT, hfp->errbuf, "bad query block in binary hit file %s", hfp->fname);
+
+  if (qh.nhits) ESL_ALLOC(hr, sizeof(HITREC) * qh.nhits);
+  if (qh.ndom)  ESL_ALLOC(dr, sizeof(DOMREC) * qh.ndom);
+  ESL_ALLOC(strtab, sizeof(char) * qh.strsize);
+  if (fread(hr,     sizeof(HITREC), qh.nhits,   hfp->f) != qh.nhits ||
+      fread(dr,     sizeof(DOMREC), qh.ndom,    hfp->f) != qh.ndom  ||
+      fread(strtab, sizeof(char),   qh.strsize, hfp->f) != qh.strsize)
+    ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary hit file %s is truncated", hfp->fname);
+
+  /* Validate every reference before we follow it. */
+  if (strtab[qh.strsize-1] != '\0')                                      ESL_XFAIL(eslEFORMAT, hfp->errbuf, "bad string table in binary hit file %s", hfp->fname);
+  if (qh.qname < 0 || qh.qname >= qh.strsize || qh.qacc >= (int64_t) qh.strsize) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "bad query name in binary hit file %s", hfp->fname);
+  for (h = 0; h < qh.nhits; h++)
+    {
+      if (hr[h].name < 0 || hr[h].name >= qh.strsize || hr[h].acc >= (int64_t) qh.strsize || hr[h].desc >= (int64_t) qh.strsize ||
+	  hr[h].ndom < 0 || hr[h].dom0 > qh.ndom || hr[h].ndom > qh.ndom - hr[h].dom0 || hr[h].best_domain < 0 || hr[h].best_domain >= hr[h].ndom)
+	ESL_XFAIL(eslEFORMAT, hfp->errbuf, "bad record for hit %" PRIu64 " of query %s in binary hit file %s", h+1, strtab + qh.qname, hfp->fname);
+    }
+
+  if (hfp->qname) { free(hfp->qname); hfp->qname = NULL; }
+  if (hfp->qacc)  { free(hfp->qacc);  hfp->qacc  = NULL; }
+  if (                 (status = esl_strdup(strtab + qh.qname, -1, &(hfp->qname))) != eslOK) goto ERROR;
+  if (qh.qacc >= 0 &&  (status = esl_strdup(strtab + qh.qacc,  -1, &(hfp->qacc)))  != eslOK) goto ERROR;
+  hfp->mode         = (qh.mode == p7_SCAN_MODELS ? p7_SCAN_MODELS : p7_SEARCH_SEQS);
+  hfp->long_targets = qh.long_targets;
+  hfp->Z            = qh.Z;
+  hfp->domZ         = qh.domZ;
+  hfp->nqueries++;
+
+  if ((th = p7_tophits_Create()) == NULL) { status = eslEMEM; goto ERROR; }
+  for (h = 0; h < qh.nhits; h++)
+    {
+      if ((status = p7_tophits_CreateNextHit(th, &hit)) != eslOK) goto ERROR;
+      if (                   (status = p7_arena_Strdup(th->arena, strtab + hr[h].name, -1, &(hit->name))) != eslOK) goto ERROR;
+      if (hr[h].acc  >= 0 && (status = p7_arena_Strdup(th->arena, strtab + hr[h].acc,  -1, &(hit->acc)))  != eslOK) goto ERROR;
+      if (hr[h].desc >= 0 && (status = p7_arena_Strdup(th->arena, strtab + hr[h].desc, -1, &(hit->desc))) != eslOK) goto ERROR;
+      hit->seqidx        = hr[h].seqidx;
+      hit->subseq_start  = hr[h].subseq_start;
+      hit->sortkey       = hr[h].sortkey;
+      hit->lnP           = hr[h].lnP;
+      hit->pre_lnP       = hr[h].pre_lnP;
+      hit->sum_lnP       = hr[h].sum_lnP;
+      hit->score         = hr[h].score;
+      hit->pre_score     = hr[h].pre_score;
+      hit->sum_score     = hr[h].sum_score;
+      hit->nexpected     = hr[h].nexpected;
+      hit->window_length = hr[h].window_length;
+      hit->nregions      = hr[h].nregions;
+      hit->nclustered    = hr[h].nclustered;
+      hit->noverlaps     = hr[h].noverlaps;
+      hit->nenvelopes    = hr[h].nenvelopes;
+      hit->ndom          = hr[h].ndom;
+      hit->nreported     = hr[h].nreported;
+      hit->nincluded     = hr[h].nincluded;
+      hit->best_domain   = hr[h].best_domain;
+      hit->flags         = hr[h].flags;
+      if (hit->flags & p7_IS_REPORTED) th->nreported++;
+      if (hit->flags & p7_IS_INCLUDED) th->nincluded++;
+
+      if ((hit->dcl = p7_arena_Alloc(th->arena, sizeof(P7_DOMAIN) * ESL_MAX(hit->ndom, 1))) == NULL) { status = eslEMEM; goto ERROR; }
+      for (d = 0; d < hit->ndom; d++)
+	{
+	  DOMREC *r = dr + hr[h].dom0 + d;
+
+	  dom = &(hit->dcl[d]);
+	  dom->ienv           = r->ienv;
+	  dom->jenv           = r->jenv;
+	  dom->iali           = r->iali;
+	  dom->jali           = r->jali;
+	  dom->iorf           = r->iorf;
+	  dom->jorf           = r->jorf;
+	  dom->envsc          = r->envsc;
+	  dom->domcorrection  = r->domcorrection;
+	  dom->dombias        = r->dombias;
+	  dom->oasc           = r->oasc;
+	  dom->bitscore       = r->bitscore;
+	  dom->lnP            = r->lnP;
+	  dom->is_reported    = (r->flags & p7_HITFILE_DOM_REPORTED) ? TRUE : FALSE;
+	  dom->is_included    = (r->flags & p7_HITFILE_DOM_INCLUDED) ? TRUE : FALSE;
+	  dom->scores_per_pos = NULL;
+	  dom->envdsq         = NULL;
+	  dom->L              = r->L;
+	  dom->ad             = NULL;
+	  if (r->flags & p7_HITFILE_DOM_HAS_AD)
+	    {
+	      if ((dom->ad = p7_arena_Alloc(th->arena, sizeof(P7_ALIDISPLAY))) == NULL) { status = eslEMEM; goto ERROR; }
+	      memset(dom->ad, 0, sizeof(P7_ALIDISPLAY));
+	      dom->ad->hmmfrom = r->hmmfrom;
+	      dom->ad->hmmto   = r->hmmto;
+	      dom->ad->M       = r->M;
+	      dom->ad->sqfrom  = r->sqfrom;
+	      dom->ad->sqto    = r->sqto;
+	      dom->ad->L       = r->L;
+	    }
+	}
+    }
+
+  /* hits were written in rank order */
+  for (h = 0; h < th->N; h++) th->hit[h] = th->unsrt + h;
+  th->is_sorted_by_sortkey = TRUE;
+  th->is_sorted_by_seqidx  = FALSE;
+
+  free(hr);
+  free(dr);
+  free(strtab);
+  *ret_th = th;
+  return eslOK;
+
+ ERROR:
+  if (hr)     free(hr);
+  if (dr)     free(dr);
+  if (strtab) free(strtab);
+  p7_tophits_Destroy(th);
+  *ret_th = NULL;
+  return status;
+}
+
+
+/* read_tail_block()
+ * Read the payload of a TAIL block, <nbytes> long, from <hfp>,
+ * into <hfp->tail[]>.
+ */
+static int
+read_tail_block(P7_HITFILE *hfp, uint64_t nbytes)
+{
+  char    *buf = NULL;
+  uint64_t pos = 0;
+  int      i;
+  int      status;
+
+  if (nbytes == 0) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "bad tail block in binary hit file %s", hfp->fname);
+  ESL_ALLOC(buf, sizeof(char) * nbytes);
+  if (fread(buf, sizeof(char), nbytes, hfp->f) != nbytes) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary hit file %s is truncated", hfp->fname);
+  if (buf[nbytes-1] != '\0')                              ESL_XFAIL(eslEFORMAT, hfp->errbuf, "bad tail block in binary hit file %s", hfp->fname);
+
+  for (i = 0; i < 8; i++)
+    {
+      if (pos >= nbytes) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "bad tail block in binary hit file %s", hfp->fname);
+      if (hfp->tail[i]) free(hfp->tail[i]);
+      if ((status = esl_strdup(buf + pos, -1, &(hfp->tail[i]))) != eslOK) goto ERROR;
+      pos += strlen(buf + pos) + 1;
+    }
+  hfp->has_tail = TRUE;
+  free(buf);
+  return eslOK;
+
+ ERROR:
+  if (buf) free(buf);
+  return status;
+}
+/*-------------------- end, P7_HITFILE reader -------------------*/
+
+
+
+/*****************************************************************
+ * 3. Regenerating tabular output.
+ *****************************************************************/
+
+/* tabular_pli()
+ * The tabular writers need only the pipeline accounting that a hit
+ * file keeps for each query; give them a pipeline with just that.
+ */
+static void
+tabular_pli(const P7_HITFILE *hfp, P7_PIPELINE *pli)
+{
+  memset(pli, 0, sizeof(P7_PIPELINE));
+  pli->mode         = hfp->mode;
+  pli->long_targets = hfp->long_targets;
+  pli->Z            = hfp->Z;
+  pli->domZ         = hfp->domZ;
+}
+
+
+/* Function:  p7_hitfile_TabularTargets()
+ * Synopsis:  Regenerate per-target tabular output from a hit file.
+ *
+ * Purpose:   Given hit list <th> that was just read from binary hit
+ *            file <hfp>, write the same per-target table to <ofp>
+ *            that <p7_tophits_TabularTargets()> wrote for it in
+ *            the original search (--tblout).
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEWRITE> on write failure.
+ */
+int
+p7_hitfile_TabularTargets(FILE *ofp, const P7_HITFILE *hfp, P7_TOPHITS *th, int show_header)
+{
+  P7_PIPELINE pli;
+
+  tabular_pli(hfp, &pli);
+  return p7_tophits_TabularTargets(ofp, hfp->qname, hfp->qacc, th, &pli, show_header);
+}
+
+
+/* Function:  p7_hitfile_TabularDomains()
+ * Synopsis:  Regenerate per-domain tabular output from a hit file.
+ *
+ * Purpose:   As <p7_hitfile_TabularTargets()>, for the per-domain
+ *            table (--domtblout).
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEWRITE> on write failure.
+ */
+int
+p7_hitfile_TabularDomains(FILE *ofp, const P7_HITFILE *hfp, P7_TOPHITS *th, int show_header)
+{
+  P7_PIPELINE pli;
+
+  tabular_pli(hfp, &pli);
+  return p7_tophits_TabularDomains(ofp, hfp->qname, hfp->qacc, th, &pli, show_header);
+}
+
+
+/* Function:  p7_hitfile_TabularTail()
+ * Synopsis:  Regenerate the tail of tabular output from a hit file.
+ *
+ * Purpose:   Write the tail that <p7_tophits_TabularTail()> wrote in
+ *            the original search to <ofp>, from the tail of binary
+ *            hit file <hfp>. Call after <p7_hitfile_Read()> has
+ *            returned <eslEOF>; if the file had no tail (the search
+ *            didn't finish), write nothing.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEWRITE> on write failure.
+ */
+int
+p7_hitfile_TabularTail(FILE *ofp, const P7_HITFILE *hfp)
+{
+  if (! hfp->has_tail) return eslOK;
+
+  if (fprintf(ofp, "#\n") < 0)                                      ESL_EXCEPTION_SYS(eslEWRITE, "tabular output tail, write failed");
+  if (fprintf(ofp, "# Program:         %s\n", hfp->tail[0]) < 0)     ESL_EXCEPTION_SYS(eslEWRITE, "tabular output tail, write failed");
+  if (fprintf(ofp, "# Version:         %s\n", hfp->tail[1]) < 0)     ESL_EXCEPTION_SYS(eslEWRITE, "tabular output tail, write failed");
+  if (fprintf(ofp, "# Pipeline mode:   %s\n", hfp->tail[2]) < 0)     ESL_EXCEPTION_SYS(eslEWRITE, "tabular output tail, write failed");
+  if (fprintf(ofp, "# Query file:      %s\n", hfp->tail[3]) < 0)     ESL_EXCEPTION_SYS(eslEWRITE, "tabular output tail, write failed");
+  if (fprintf(ofp, "# Target file:     %s\n", hfp->tail[4]) < 0)     ESL_EXCEPTION_SYS(eslEWRITE, "tabular output tail, write failed");
+  if (fprintf(ofp, "# Option settings: %s\n", hfp->tail[5]) < 0)     ESL_EXCEPTION_SYS(eslEWRITE, "tabular output tail, write failed");
+  if (fprintf(ofp, "# Current dir:     %s\n", hfp->tail[6]) < 0)     ESL_EXCEPTION_SYS(eslEWRITE, "tabular output tail, write failed");
+  if (fprintf(ofp, "# Date:            %s",   hfp->tail[7]) < 0)     ESL_EXCEPTION_SYS(eslEWRITE, "tabular output tail, write failed");
+  if (fprintf(ofp, "# [ok]\n") < 0)                                  ESL_EXCEPTION_SYS(eslEWRITE, "tabular output tail, write failed");
+  return eslOK;
+}
+/*------------------ end, tabular output -------------------------*/
+
+
+
+/*****************************************************************
+ * 4. Unit tests.
+ *****************************************************************/
+#ifdef p7HITFILE_TESTDRIVE
+#include "esl_random.h"
+
+/* sample_tophits()
+ * A sorted hit list of <N> random hits, some reported, some
+ * included, with up to 4 domains each; a few domains lack
+ * alignment displays, as deferred alignments do.
+ */
+static P7_TOPHITS *
+sample_tophits(ESL_RANDOMNESS *r, int N)
+{
+  P7_TOPHITS *th = p7_tophits_Create();
+  P7_HIT     *hit;
+  P7_DOMAIN  *dom;
+  char        buf[64];
+  int         i, d;
+
+  for (i = 0; i < N; i++)
+    {
+      if (p7_tophits_CreateNextHit(th, &hit) != eslOK) esl_fatal("CreateNextHit failed");
+      snprintf(buf, 64, "target%d%.*s", i, esl_rnd_Roll(r, 30), "_with_a_rather_long_name_here_");
+      p7_arena_Strdup(th->arena, buf, -1, &(hit->name));
+      if (esl_rnd_Roll(r, 2)) { snprintf(buf, 64, "PF%05d.%d", i, esl_rnd_Roll(r, 10)); p7_arena_Strdup(th->arena, buf, -1, &(hit->acc)); }
+      if (esl_rnd_Roll(r, 2)) { snprintf(buf, 64, "the description of target %d", i);  p7_arena_Strdup(th->arena, buf, -1, &(hit->desc)); }
+      hit->seqidx        = i;
+      hit->subseq_start  = esl_rnd_Roll(r, 1000);
+      hit->window_length = esl_rnd_Roll(r, 1000);
+      hit->score         = esl_random(r) * 200. - 20.;
+      hit->pre_score     = hit->score + esl_random(r) * 5.;
+      hit->sum_score     = hit->score - esl_random(r);
+      hit->sortkey       = hit->score;
+      hit->lnP           = -esl_random(r) * 300.;
+      hit->pre_lnP       = hit->lnP;
+      hit->sum_lnP       = hit->lnP - 1.;
+      hit->nexpected     = esl_random(r) * 4.;
+      hit->nregions      = esl_rnd_Roll(r, 5);
+      hit->nclustered    = esl_rnd_Roll(r, 5);
+      hit->noverlaps     = esl_rnd_Roll(r, 5);
+      hit->nenvelopes    = esl_rnd_Roll(r, 5);
+      hit->ndom          = 1 + esl_rnd_Roll(r, 4);
+      hit->best_domain   = esl_rnd_Roll(r, hit->ndom);
+      hit->flags         = esl_rnd_Roll(r, 8);
+      hit->dcl           = p7_arena_Alloc(th->arena, sizeof(P7_DOMAIN) * hit->ndom);
+      for (d = 0; d < hit->ndom; d++)
+	{
+	  dom = &(hit->dcl[d]);
+	  memset(dom, 0, sizeof(P7_DOMAIN));
+	  dom->ienv          = 1 + esl_rnd_Roll(r, 500);
+	  dom->jenv          = dom->ienv + esl_rnd_Roll(r, 500);
+	  dom->iali          = dom->ienv;
+	  dom->jali          = dom->jenv;
+	  dom->L             = dom->jenv + esl_rnd_Roll(r, 100);
+	  dom->envsc         = esl_random(r) * 100.;
+	  dom->domcorrection = esl_random(r);
+	  dom->dombias       = esl_random(r) * 3.;
+	  dom->oasc          = esl_random(r) * (dom->jenv - dom->ienv + 1);
+	  dom->bitscore      = esl_random(r) * 100.;
+	  dom->lnP           = -esl_random(r) * 200.;
+	  dom->is_reported   = esl_rnd_Roll(r, 2);
+	  dom->is_included   = esl_rnd_Roll(r, 2);
+	  if (dom->is_reported || d == hit->best_domain || esl_rnd_Roll(r, 2))
+	    {
+	      dom->ad = p7_arena_Alloc(th->arena, sizeof(P7_ALIDISPLAY));
+	      memset(dom->ad, 0, sizeof(P7_ALIDISPLAY));
+	      dom->ad->hmmfrom = 1 + esl_rnd_Roll(r, 100);
+	      dom->ad->hmmto   = dom->ad->hmmfrom + esl_rnd_Roll(r, 100);
+	      dom->ad->M       = dom->ad->hmmto + esl_rnd_Roll(r, 10);
+	      dom->ad->sqfrom  = dom->iali;
+	      dom->ad->sqto    = dom->jali;
+	      dom->ad->L       = dom->L;
+	    }
+	}
+      if (hit->flags & p7_IS_REPORTED) th->nreported++;
+      if (hit->flags & p7_IS_INCLUDED) th->nincluded++;
+    }
+  p7_tophits_SortBySortkey(th);
+  return th;
+}
+
+/* files_differ()
+ * TRUE if the contents of open streams <f1> and <f2> differ.
+ */
+static int
+files_differ(FILE *f1, FILE *f2)
+{
+  int c1, c2;
+
+  rewind(f1);
+  rewind(f2);
+  do { c1 = fgetc(f1); c2 = fgetc(f2); } while (c1 == c2 && c1 != EOF);
+  return (c1 != c2);
+}
+
+/* utest_roundtrip()
+ * Write two random hit lists to a binary hit file, and read them
+ * back. Every written hit must come back with the same data, and
+ * tabular output regenerated from the file must be identical to
+ * tabular output from the original lists.
+ */
+static void
+utest_roundtrip(ESL_RANDOMNESS *r, int N)
+{
+  char        *msg     = "p7_hitfile roundtrip unit test failed";
+  char         tmpname[16] = "p7hitXXXXXX";
+  char         t1name[16]  = "p7hitXXXXXX";
+  char         t2name[16]  = "p7hitXXXXXX";
+  char         errbuf[eslERRBUFSIZE];
+  FILE        *ofp     = NULL;
+  FILE        *t1      = NULL;
+  FILE        *t2      = NULL;
+  P7_HITFILE  *hfp     = NULL;
+  P7_TOPHITS  *th[2];
+  P7_TOPHITS  *th2     = NULL;
+  P7_PIPELINE  pli;
+  char        *qname[2] = { "query1", "query2" };
+  char        *qacc[2]  = { "PF00001.1", NULL };
+  uint64_t     h;
+  int          q, d;
+  int          status;
+
+  memset(&pli, 0, sizeof(P7_PIPELINE));
+  pli.mode = p7_SEARCH_SEQS;
+  pli.Z    = 1000.;
+  pli.domZ = 12.;
+
+  if (esl_tmpfile(t1name, &t1)         != eslOK) esl_fatal(msg);
+  if (esl_tmpfile(t2name, &t2)         != eslOK) esl_fatal(msg);
+  if (esl_tmpfile_named(tmpname, &ofp) != eslOK) esl_fatal(msg);
+  if (p7_hitfile_WriteMagic(ofp)       != eslOK) esl_fatal(msg);
+  for (q = 0; q < 2; q++)
+    {
+      th[q] = sample_tophits(r, (q == 0 ? N : 0));
+      if (p7_hitfile_Write(ofp, qname[q], qacc[q], th[q], &pli) != eslOK) esl_fatal(msg);
+      p7_tophits_TabularTargets(t1, qname[q], qacc[q], th[q], &pli, (q == 0));
+      p7_tophits_TabularDomains(t1, qname[q], qacc[q], th[q], &pli, (q == 0));
+    }
+  fclose(ofp);
+
+  if (p7_hitfile_Open(tmpname, &hfp, errbuf) != eslOK) esl_fatal(msg);
+  for (q = 0; (status = p7_hitfile_Read(hfp, &th2)) == eslOK; q++)
+    {
+      if (q >= 2)                                             esl_fatal(msg);
+      if (strcmp(hfp->qname, qname[q]) != 0)                   esl_fatal(msg);
+      if (esl_strcmp(hfp->qacc, qacc[q]) != 0)                 esl_fatal(msg);
+      if (hfp->Z != pli.Z || hfp->domZ != pli.domZ)            esl_fatal(msg);
+      if (th2->N != th[q]->N)                                  esl_fatal(msg);
+      if (th2->nreported != th[q]->nreported)                  esl_fatal(msg);
+
+      for (h = 0; h < th[q]->N; h++)
+	{
+	  P7_HIT *a = th[q]->hit[h];
+	  P7_HIT *b = th2->hit[h];
+
+	  if (strcmp(a->name, b->name)     != 0)                  esl_fatal(msg);
+	  if (esl_strcmp(a->acc,  b->acc)  != 0)                  esl_fatal(msg);
+	  if (esl_strcmp(a->desc, b->desc) != 0)                  esl_fatal(msg);
+	  if (a->score != b->score || a->lnP != b->lnP)           esl_fatal(msg);
+	  if (a->flags != b->flags || a->ndom != b->ndom)         esl_fatal(msg);
+	  if (a->best_domain != b->best_domain)                   esl_fatal(msg);
+	  for (d = 0; d < a->ndom; d++)
+	    {
+	      if (a->dcl[d].bitscore    != b->dcl[d].bitscore)    esl_fatal(msg);
+	      if (a->dcl[d].lnP         != b->dcl[d].lnP)         esl_fatal(msg);
+	      if (a->dcl[d].ienv        != b->dcl[d].ienv)        esl_fatal(msg);
+	      if (a->dcl[d].jenv        != b->dcl[d].jenv)        esl_fatal(msg);
+	      if (a->dcl[d].is_reported != b->dcl[d].is_reported) esl_fatal(msg);
+	      if ((a->dcl[d].ad == NULL) != (b->dcl[d].ad == NULL)) esl_fatal(msg);
+	      if (a->dcl[d].ad && a->dcl[d].ad->hmmto != b->dcl[d].ad->hmmto) esl_fatal(msg);
+	    }
+	}
+
+      p7_hitfile_TabularTargets(t2, hfp, th2, (q == 0));
+      p7_hitfile_TabularDomains(t2, hfp, th2, (q == 0));
+      p7_tophits_Destroy(th2);
+    }
+  if (status != eslEOF || q != 2) esl_fatal(msg);
+  if (files_differ(t1, t2))       esl_fatal(msg);
+
+  p7_hitfile_Close(hfp);
+  remove(tmpname);
+  fclose(t1);
+  fclose(t2);
+  p7_tophits_Destroy(th[0]);
+  p7_tophits_Destroy(th[1]);
+}
+
+/* utest_corrupt()
+ * A truncated hit file is a format error, not a crash; and a file
+ * that isn't a hit file at all is rejected on opening.
+ */
+static void
+utest_corrupt(ESL_RANDOMNESS *r)
+{
+  char         *msg  = "p7_hitfile corruption unit test failed";
+  char          tmpname[16] = "p7hitXXXXXX";
+  char          errbuf[eslERRBUFSIZE];
+  FILE         *ofp  = NULL;
+  P7_HITFILE   *hfp  = NULL;
+  P7_TOPHITS   *th   = sample_tophits(r, 20);
+  P7_TOPHITS   *th2  = NULL;
+  P7_PIPELINE   pli;
+  char         *buf  = NULL;
+  long          n;
+
+  memset(&pli, 0, sizeof(P7_PIPELINE));
+  if (esl_tmpfile_named(tmpname, &ofp) != eslOK) esl_fatal(msg);
+  p7_hitfile_WriteMagic(ofp);
+  p7_hitfile_Write(ofp, "query", NULL, th, &pli);
+  n = ftell(ofp);
+
+  /* rewrite it, one byte short */
+  if ((buf = malloc(n)) == NULL)         esl_fatal(msg);
+  rewind(ofp);
+  if (fread(buf, 1, n, ofp) != n)        esl_fatal(msg);
+  fclose(ofp);
+  if ((ofp = fopen(tmpname, "wb")) == NULL) esl_fatal(msg);
+  if (fwrite(buf, 1, n-1, ofp) != n-1)   esl_fatal(msg);
+  fclose(ofp);
+
+  if (p7_hitfile_Open(tmpname, &hfp, errbuf) != eslOK)  esl_fatal(msg);
+  if (p7_hitfile_Read(hfp, &th2)             != eslEFORMAT || th2 != NULL) esl_fatal(msg);
+  p7_hitfile_Close(hfp);
+
+  if ((ofp = fopen(tmpname, "w")) == NULL) esl_fatal(msg);
+  fprintf(ofp, "# not a hit file\n");
+  fclose(ofp);
+  if (p7_hitfile_Open(tmpname, &hfp, errbuf) != eslEFORMAT || hfp != NULL) esl_fatal(msg);
+
+  remove(tmpname);
+  free(buf);
+  p7_tophits_Destroy(th);
+}
+#endif /*p7HITFILE_TESTDRIVE*/
+/*-------------------- end, unit tests --------------------------*/
+
+
+
+/*****************************************************************
+ * 5. Test driver.
+ *****************************************************************/
+#ifdef p7HITFILE_TESTDRIVE
+/*
+  gcc -o p7_hitfile_utest -std=gnu99 -g -O2 -I. -L. -I../easel -L../easel -Dp7HITFILE_TESTDRIVE p7_hitfile.c -lhmmer -leasel -lm
+  ./p7_hitfile_utest
+*/
+#include "p7_config.h"
+
+#include "easel.h"
+#include "esl_getopts.h"
+#include "esl_random.h"
+
+#include "hmmer.h"
+
+static ESL_OPTIONS options[] = {
+  /* name           type      default  env  range toggles reqs incomp  help                                       docgroup*/
+  { "-h",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "show brief help on version and usage",             0 },
+  { "-s",        eslARG_INT,     "42", NULL, NULL,  NULL,  NULL, NULL, "set random number seed to <n>",                    0 },
+  { "-N",        eslARG_INT,   "1000", NULL, NULL,  NULL,  NULL, NULL, "number of hits to sample",                         0 },
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+
+static char usage[]  = "[-options]";
+static char banner[] = "test driver for binary hit files";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go  = p7_CreateDefaultApp(options, 0, argc, argv, banner, usage);
+  ESL_RANDOMNESS *rng = esl_randomness_CreateFast(esl_opt_GetInteger(go, "-s"));
+  int             N   = esl_opt_GetInteger(go, "-N");
+
+  utest_roundtrip(rng, N);
+  utest_corrupt(rng);
+
+  esl_randomness_Destroy(rng);
+  esl_getopts_Destroy(go);
+  return eslOK;
+}
+#endif /*p7HITFILE_TESTDRIVE*/
+/*-------------------- end, test driver -------------------------*/
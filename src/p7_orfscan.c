@@ -0,0 +1,451 @@
+/* P7_ORFSCAN: translating a DNA target into open reading frames, for
+ * searching protein profiles against DNA.
+ *
+ * A translated search (hmmsearcht) hands each DNA sequence it reads
+ * to a P7_ORFSCAN, and asks for the sequence's ORFs one at a time.
+ * Each ORF comes back as a digital protein sequence that the usual
+ * search pipeline can take, carrying its nucleotide coordinates in
+ * <start>..<end> (start > end for ORFs on the reverse strand). ORFs
+ * are translated straight out of the DNA sequence's digital residues
+ * as they're asked for, so nothing is stored but the ORF at hand.
+ *
+ * An ORF is a maximal run of sense codons in one of the six frames,
+ * between stop codons or the ends of the sequence. Optionally, ORFs
+ * start only at an initiation codon, which is then translated as Met.
+ *
+ * Contents:
+ *    1. The P7_ORFSCAN object.
+ *    2. Unit tests.
+ *    3. Test driver.
+ */
+#include "p7_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_gencode.h"
+#include "esl_sq.h"
+
+#include "hmmer.h"
+
+static ESL_DSQ *get_codon(const P7_ORFSCAN *os, int64_t c, ESL_DSQ *buf);
+
+
+/*****************************************************************
+ * 1. The P7_ORFSCAN object.
+ *****************************************************************/
+
+/* Function:  p7_orfscan_Create()
+ * Synopsis:  Create a new <P7_ORFSCAN>.
+ *
+ * Purpose:   Create an ORF scanner that translates with genetic code
+ *            <gcode>, and returns only ORFs of at least <minlen>
+ *            amino acids. If <require_init> is TRUE, ORFs start at
+ *            an initiation codon (per <gcode>); otherwise an ORF
+ *            starts right after a stop codon or at the start of the
+ *            frame. <do_watson> and <do_crick> say whether to
+ *            translate the given strand, the reverse complement, or
+ *            both; at least one of them must be TRUE.
+ *
+ *            The scanner keeps a pointer to <gcode>, which must
+ *            remain valid (and unchanged) while the scanner is in
+ *            use. The genetic code's nucleic alphabet must be the
+ *            alphabet of the DNA sequences given to
+ *            <p7_orfscan_SetSequence()>, and its amino alphabet the
+ *            alphabet of the ORF sequences given to
+ *            <p7_orfscan_Next()>.
+ *
+ * Returns:   a pointer to the new scanner.
+ *
+ * Throws:    <NULL> on allocation failure.
+ */
+P7_ORFSCAN *
+p7_orfscan_Create(const ESL_GENCODE *gcode, int minlen, int require_init, int do_watson, int do_crick)
+{
+  P7_ORFSCAN *os = NULL;
+  int         status;
+
+  ESL_ALLOC(os, sizeof(P7_ORFSCAN));
+  os->gcode        = gcode;
+  os->minlen       = ESL_MAX(minlen, 1);
+  os->require_init = require_init;
+  os->do_watson    = do_watson;
+  os->do_crick     = do_crick;
+  os->met          = esl_abc_DigitizeSymbol(gcode->aa_abc, 'M');
+
+  os->ntsq         = NULL;
+  os->strand       = 0;
+  os->frame        = 0;
+  os->c            = 0;
+  os->norf         = 0;
+  return os;
+
+ ERROR:
+  p7_orfscan_Destroy(os);
+  return NULL;
+}
+
+
+/* Function:  p7_orfscan_SetSequence()
+ * Synopsis:  Start scanning a new DNA sequence.
+ *
+ * Purpose:   Start scanning the ORFs of digital DNA sequence <ntsq>.
+ *            The scanner keeps a pointer to <ntsq>, which must stay
+ *            valid until the last of its ORFs has been returned by
+ *            <p7_orfscan_Next()>, or until the scanner is given
+ *            another sequence.
+ *
+ * Returns:   <eslOK> on success.
+ */
+int
+p7_orfscan_SetSequence(P7_ORFSCAN *os, const ESL_SQ *ntsq)
+{
+  os->ntsq   = ntsq;
+  os->strand = (os->do_watson ? 0 : 1);
+  os->frame  = 0;
+  os->c      = 0;
+  os->norf   = 0;
+  return eslOK;
+}
+
+
+/* Function:  p7_orfscan_Next()
+ * Synopsis:  Translate the next ORF of the current DNA sequence.
+ *
+ * Purpose:   Translate the next ORF of the DNA sequence that the
+ *            scanner was given with <p7_orfscan_SetSequence()>, into
+ *            digital protein sequence <orfsq>, which is reused (and
+ *            grown if needed) to hold it. ORFs come in order of
+ *            strand (given strand first), then frame, then position.
+ *
+ *            <orfsq> is named <seqname>/orf<n>, with <n> counting the
+ *            DNA sequence's ORFs from 1; its source is the DNA
+ *            sequence's name, <orfsq->L> is the DNA sequence's
+ *            length, and <orfsq->start>..<orfsq->end> are the 1..L
+ *            nucleotide coordinates of the first residue of its first
+ *            codon and the last residue of its last codon (not
+ *            counting the stop codon). On the reverse strand,
+ *            <start> > <end>. See <p7_orfscan_CodonStart()> for
+ *            finding the codon of any residue of the ORF.
+ *
+ * Returns:   <eslOK> on success, and <orfsq> holds the next ORF.
+ *            <eslEOF> if there are no more ORFs in this sequence.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ */
+int
+p7_orfscan_Next(P7_ORFSCAN *os, ESL_SQ *orfsq)
+{
+  const ESL_GENCODE *gcode = os->gcode;
+  ESL_DSQ            buf[3];
+  ESL_DSQ           *codon;
+  int64_t            ncodons;
+  int64_t            c1;	/* first codon of the ORF */
+  int64_t            n;		/* # of residues in the ORF so far */
+  int                x;
+  int                status;
+
+  if (os->ntsq == NULL) return eslEOF;
+
+  while (os->strand < 2)
+    {
+      ncodons = (os->ntsq->n - os->frame) / 3;
+      while (os->c < ncodons)
+	{
+	  /* Find where the ORF starts. */
+	  if (os->require_init)
+	    {
+	      while (os->c < ncodons && ! esl_gencode_IsInitiator(gcode, get_codon(os, os->c, buf))) os->c++;
+	      if (os->c == ncodons) break;
+	    }
+
+	  /* Translate up to the next stop codon, or the end of the frame. */
+	  esl_sq_Reuse(orfsq);
+	  if ((status = esl_sq_GrowTo(orfsq, ncodons - os->c)) != eslOK) return status;
+	  for (c1 = os->c, n = 0; os->c < ncodons; os->c++)
+	    {
+	      codon = get_codon(os, os->c, buf);
+	      x     = esl_gencode_GetTranslation(gcode, codon);
+	      if (esl_abc_XIsNonresidue(gcode->aa_abc, x)) break;
+	      n++;
+	      orfsq->dsq[n] = (n == 1 && os->require_init ? os->met : x);
+	    }
+	  if (os->c < ncodons) os->c++; /* step over the stop codon */
+	  if (n < os->minlen)  continue;
+
+	  orfsq->dsq[0]   = eslDSQ_SENTINEL;
+	  orfsq->dsq[n+1] = eslDSQ_SENTINEL;
+	  orfsq->n        = n;
+	  orfsq->L        = os->ntsq->n;
+	  if (os->strand == 0) { orfsq->start = 1 + os->frame + 3*c1;           orfsq->end = orfsq->start + 3*n - 1; }
+	  else                 { orfsq->start = os->ntsq->n - os->frame - 3*c1; orfsq->end = orfsq->start - 3*n + 1; }
+
+	  os->norf++;
+	  if ((status = esl_sq_FormatName(orfsq, "%s/orf%" PRId64, os->ntsq->name, os->norf)) != eslOK) return status;
+	  if ((status = esl_sq_SetSource (orfsq, os->ntsq->name))                              != eslOK) return status;
+	  return eslOK;
+	}
+
+      /* This frame is done; on to the next one. */
+      os->c = 0;
+      if (++os->frame == 3)
+	{
+	  os->frame = 0;
+	  os->strand++;
+	  if (os->strand == 1 && ! os->do_crick) os->strand++;
+	}
+    }
+  return eslEOF;
+}
+
+
+/* Function:  p7_orfscan_CodonStart()
+ * Synopsis:  Nucleotide coordinate of an ORF residue's codon.
+ *
+ * Purpose:   Return the nucleotide coordinate (1..L in the source DNA
+ *            sequence) of the first base of the codon for residue <i>
+ *            (1..n) of ORF <orfsq>, as returned by
+ *            <p7_orfscan_Next()>. The codon continues upward from
+ *            there if <orfsq->start> < <orfsq->end>, and downward on
+ *            the reverse strand.
+ */
+int64_t
+p7_orfscan_CodonStart(const ESL_SQ *orfsq, int64_t i)
+{
+  return (orfsq->start < orfsq->end ? orfsq->start + 3*(i-1) : orfsq->start - 3*(i-1));
+}
+
+
+/* Function:  p7_orfscan_Destroy()
+ * Synopsis:  Free a <P7_ORFSCAN>.
+ */
+void
+p7_orfscan_Destroy(P7_ORFSCAN *os)
+{
+  if (os) free(os);
+}
+
+
+/* get_codon()
+ * Return a pointer to the three digital residues of codon <c> (0..)
+ * in the current strand and frame. On the given strand, that's
+ * right in the DNA sequence; on the reverse strand, the codon is
+ * complemented into <buf>.
+ */
+static ESL_DSQ *
+get_codon(const P7_ORFSCAN *os, int64_t c, ESL_DSQ *buf)
+{
+  const ESL_SQ *ntsq = os->ntsq;
+  int64_t       pos;
+
+  if (os->strand == 0) return ntsq->dsq + 1 + os->frame + 3*c;
+
+  pos    = ntsq->n - os->frame - 3*c;
+  buf[0] = ntsq->abc->complement[ntsq->dsq[pos]];
+  buf[1] = ntsq->abc->complement[ntsq->dsq[pos-1]];
+  buf[2] = ntsq->abc->complement[ntsq->dsq[pos-2]];
+  return buf;
+}
+/*------------------ end, P7_ORFSCAN object ---------------------*/
+
+
+
+/*****************************************************************
+ * 2. Unit tests
+ *****************************************************************/
+#ifdef p7ORFSCAN_TESTDRIVE
+#include "esl_random.h"
+
+/* create_dna()
+ * Make a random digital DNA sequence of length <L>, with an
+ * occasional N.
+ */
+static ESL_SQ *
+create_dna(ESL_RANDOMNESS *rng, const ESL_ALPHABET *abc, int64_t L)
+{
+  ESL_SQ  *sq = esl_sq_CreateDigital(abc);
+  int64_t  i;
+
+  esl_sq_GrowTo(sq, L);
+  esl_sq_SetName(sq, "dna");
+  sq->dsq[0] = sq->dsq[L+1] = eslDSQ_SENTINEL;
+  for (i = 1; i <= L; i++)
+    sq->dsq[i] = (esl_rnd_Roll(rng, 50) == 0 ? esl_abc_DigitizeSymbol(abc, 'N') : esl_rnd_Roll(rng, 4));
+  sq->n = L;
+  return sq;
+}
+
+/* utest_scan()
+ * Scan the ORFs of random DNA sequences, and check each one against
+ * its codons, translated independently. Without a minimum length or
+ * initiation codons, every codon of all six frames is either in an
+ * ORF or is a stop codon.
+ */
+static void
+utest_scan(ESL_RANDOMNESS *rng, const ESL_GENCODE *gcode, int ntrials, int64_t maxL, int minlen, int require_init)
+{
+  char       *msg     = "p7_orfscan scan unit test failed";
+  P7_ORFSCAN *os      = p7_orfscan_Create(gcode, minlen, require_init, TRUE, TRUE);
+  ESL_SQ     *orfsq   = esl_sq_CreateDigital(gcode->aa_abc);
+  ESL_SQ     *ntsq    = NULL;
+  ESL_DSQ    *cmp     = gcode->nt_abc->complement;
+  ESL_DSQ     codon[3];
+  int64_t     ncodons, nres, nstop;
+  int64_t     L, i, pos;
+  int         frame, x;
+  int         status;
+
+  while (ntrials--)
+    {
+      L     = esl_rnd_Roll(rng, maxL+1);  /* 0..maxL; 0 is legal */
+      ntsq  = create_dna(rng, gcode->nt_abc, L);
+      nres  = nstop = ncodons = 0;
+
+      p7_orfscan_SetSequence(os, ntsq);
+      while ((status = p7_orfscan_Next(os, orfsq)) == eslOK)
+	{
+	  if (orfsq->n < minlen)                                                           esl_fatal(msg);
+	  if (orfsq->L != L || strcmp(orfsq->source, ntsq->name) != 0)                     esl_fatal(msg);
+	  if (orfsq->end != p7_orfscan_CodonStart(orfsq, orfsq->n) + (orfsq->start < orfsq->end ? 2 : -2)) esl_fatal(msg);
+	  for (i = 1; i <= orfsq->n; i++)
+	    {
+	      pos = p7_orfscan_CodonStart(orfsq, i);
+	      if (orfsq->start < orfsq->end) { codon[0] = ntsq->dsq[pos];      codon[1] = ntsq->dsq[pos+1];      codon[2] = ntsq->dsq[pos+2];      }
+	      else                           { codon[0] = cmp[ntsq->dsq[pos]]; codon[1] = cmp[ntsq->dsq[pos-1]]; codon[2] = cmp[ntsq->dsq[pos-2]]; }
+	      if (pos < 1 || pos > L) esl_fatal(msg);
+
+	      if (i == 1 && require_init) {
+		if (! esl_gencode_IsInitiator(gcode, codon))                                          esl_fatal(msg);
+		if (orfsq->dsq[i] != esl_abc_DigitizeSymbol(gcode->aa_abc, 'M'))                      esl_fatal(msg);
+	      } else if (orfsq->dsq[i] != esl_gencode_GetTranslation(gcode, codon))                  esl_fatal(msg);
+	      if (esl_abc_XIsNonresidue(gcode->aa_abc, orfsq->dsq[i]))                               esl_fatal(msg);
+	    }
+	  nres += orfsq->n;
+	}
+      if (status != eslEOF) esl_fatal(msg);
+
+      if (minlen == 1 && ! require_init)
+	{
+	  for (frame = 0; frame < 3; frame++)
+	    for (pos = 1 + frame; pos + 2 <= L; pos += 3)
+	      {
+		ncodons += 2;
+		x = esl_gencode_GetTranslation(gcode, ntsq->dsq + pos);
+		if (esl_abc_XIsNonresidue(gcode->aa_abc, x)) nstop++;
+		codon[0] = cmp[ntsq->dsq[L-pos+1]]; codon[1] = cmp[ntsq->dsq[L-pos]]; codon[2] = cmp[ntsq->dsq[L-pos-1]];
+		x = esl_gencode_GetTranslation(gcode, codon);
+		if (esl_abc_XIsNonresidue(gcode->aa_abc, x)) nstop++;
+	      }
+	  if (nres + nstop != ncodons) esl_fatal(msg);
+	}
+
+      /* a scanner with no sequence has no ORFs */
+      p7_orfscan_SetSequence(os, NULL);
+      if (p7_orfscan_Next(os, orfsq) != eslEOF) esl_fatal(msg);
+      esl_sq_Destroy(ntsq);
+    }
+
+  esl_sq_Destroy(orfsq);
+  p7_orfscan_Destroy(os);
+}
+
+/* utest_strands()
+ * A scanner restricted to one strand returns exactly that strand's
+ * ORFs from a full scan, in the same order.
+ */
+static void
+utest_strands(ESL_RANDOMNESS *rng, const ESL_GENCODE *gcode, int64_t L)
+{
+  char       *msg   = "p7_orfscan strands unit test failed";
+  P7_ORFSCAN *both  = p7_orfscan_Create(gcode, 5, FALSE, TRUE,  TRUE);
+  P7_ORFSCAN *one[2];
+  ESL_SQ     *ntsq  = create_dna(rng, gcode->nt_abc, L);
+  ESL_SQ     *orf1  = esl_sq_CreateDigital(gcode->aa_abc);
+  ESL_SQ     *orf2  = esl_sq_CreateDigital(gcode->aa_abc);
+  int         s;
+
+  one[0] = p7_orfscan_Create(gcode, 5, FALSE, TRUE,  FALSE);
+  one[1] = p7_orfscan_Create(gcode, 5, FALSE, FALSE, TRUE);
+  p7_orfscan_SetSequence(both,   ntsq);
+  p7_orfscan_SetSequence(one[0], ntsq);
+  p7_orfscan_SetSequence(one[1], ntsq);
+
+  for (s = 0; s < 2; s++)
+    while (p7_orfscan_Next(one[s], orf2) == eslOK)
+      {
+	if (p7_orfscan_Next(both, orf1) != eslOK)                           esl_fatal(msg);
+	if (orf1->start != orf2->start || orf1->end != orf2->end)           esl_fatal(msg);
+	if (orf1->n != orf2->n || memcmp(orf1->dsq, orf2->dsq, orf1->n+2)) esl_fatal(msg);
+	if ((s == 0) != (orf2->start < orf2->end))                          esl_fatal(msg);
+      }
+  if (p7_orfscan_Next(both, orf1) != eslEOF) esl_fatal(msg);
+
+  esl_sq_Destroy(orf1);
+  esl_sq_Destroy(orf2);
+  esl_sq_Destroy(ntsq);
+  p7_orfscan_Destroy(one[0]);
+  p7_orfscan_Destroy(one[1]);
+  p7_orfscan_Destroy(both);
+}
+#endif /*p7ORFSCAN_TESTDRIVE*/
+/*-------------------- end, unit tests --------------------------*/
+
+
+
+/*****************************************************************
+ * 3. Test driver
+ *****************************************************************/
+#ifdef p7ORFSCAN_TESTDRIVE
+/*
+  gcc -o p7_orfscan_utest -std=gnu99 -g -O2 -I. -L. -I../easel -L../easel -Dp7ORFSCAN_TESTDRIVE p7_orfscan.c -lhmmer -leasel -lm
+  ./p7_orfscan_utest
+*/
+#include "p7_config.h"
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_gencode.h"
+#include "esl_getopts.h"
+#include "esl_random.h"
+
+#include "hmmer.h"
+
+static ESL_OPTIONS options[] = {
+  /* name           type      default  env  range toggles reqs incomp  help                                       docgroup*/
+  { "-h",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "show brief help on version and usage",             0 },
+  { "-s",        eslARG_INT,     "42", NULL, NULL,  NULL,  NULL, NULL, "set random number seed to <n>",                    0 },
+  { "-L",        eslARG_INT,    "500", NULL, NULL,  NULL,  NULL, NULL, "maximum length of test DNA sequences",             0 },
+  { "-N",        eslARG_INT,    "100", NULL, NULL,  NULL,  NULL, NULL, "number of test DNA sequences",                     0 },
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+
+static char usage[]  = "[-options]";
+static char banner[] = "test driver for P7_ORFSCAN";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go     = p7_CreateDefaultApp(options, 0, argc, argv, banner, usage);
+  ESL_RANDOMNESS *rng    = esl_randomness_CreateFast(esl_opt_GetInteger(go, "-s"));
+  ESL_ALPHABET   *nt_abc = esl_alphabet_Create(eslDNA);
+  ESL_ALPHABET   *aa_abc = esl_alphabet_Create(eslAMINO);
+  ESL_GENCODE    *gcode  = esl_gencode_Create(nt_abc, aa_abc);
+  int             L      = esl_opt_GetInteger(go, "-L");
+  int             N      = esl_opt_GetInteger(go, "-N");
+
+  utest_scan   (rng, gcode, N, L, 1,  FALSE);
+  utest_scan   (rng, gcode, N, L, 10, FALSE);
+  utest_scan   (rng, gcode, N, L, 1,  TRUE);
+  utest_strands(rng, gcode, L);
+
+  esl_gencode_Destroy(gcode);
+  esl_alphabet_Destroy(aa_abc);
+  esl_alphabet_Destroy(nt_abc);
+  esl_randomness_Destroy(rng);
+  esl_getopts_Destroy(go);
+  return eslOK;
+}
+#endif /*p7ORFSCAN_TESTDRIVE*/
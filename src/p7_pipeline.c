@@ -3,14 +3,23 @@
  * Contents:
  *   1. P7_PIPELINE: allocation, initialization, destruction
  *   2. Pipeline API
- *   3. Example 1: search mode (in a sequence db)
- *   4. Example 2: scan mode (in an HMM db)
+ *   3. P7_STAGESTATS: optional per-stage instrumentation
+ *   4. Machine-readable statistics and progress records
+ *   5. Example 1: search mode (in a sequence db)
+ *   6. Example 2: scan mode (in an HMM db)
  */
 #include "p7_config.h"
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h> 
+#include <time.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
 
 #include "easel.h"
 #include "esl_exponential.h"
@@ -33,6 +42,15 @@ typedef struct {
   float            *fwd_emissions_arr;
 } P7_PIPELINE_LONGTARGET_OBJS;
 
+/* Stage labels (--stagestats) for p7_pli_Statistics(), and short ones
+ * for tabular output; in the order of <enum p7_stages_e>.
+ */
+static const char *stage_longname[p7_NSTAGES] = {
+  "MSV/SSV filter:", "bias filter:", "Vit filter:", "Forward:", "Backward:",
+  "decoding:", "stochastic clustering:", "null2:", "OA alignment:" };
+static const char *stage_shortname[p7_NSTAGES] = {
+  "msv:", "bias:", "vit:", "fwd:", "bck:", "decoding:", "stoclust:", "null2:", "align:" };
+
 
 /*****************************************************************
  * 1. The P7_PIPELINE object: allocation, initialization, destruction.
@@ -85,6 +103,7 @@ typedef struct {
  *            | --nobias     |  turn OFF composition bias filter HMM       |   FALSE   |
  *            | --nonull2    |  turn OFF biased comp score correction      |   FALSE   |
  *            | --seed       |  RNG seed (0=use arbitrary seed)            |      42   |
+ *            | --nosample   |  split domains by decoding, not sampling    |   FALSE   |
  *            | --acc        |  prefer accessions over names in output     |   FALSE   |
  *
  *            As a special case, if <go> is <NULL>, defaults are set as above.
@@ -106,6 +125,7 @@ p7_pipeline_Create(ESL_GETOPTS *go, int M_hint, int L_hint, int long_targets, en
 
   pli->do_alignment_score_calc = 0;
   pli->long_targets = long_targets;
+  pli->curL         = -1;
 
   if ((pli->fwd = p7_omx_Create(M_hint, L_hint, L_hint)) == NULL) goto ERROR;
   if ((pli->bck = p7_omx_Create(M_hint, L_hint, L_hint)) == NULL) goto ERROR;
@@ -121,6 +141,7 @@ p7_pipeline_Create(ESL_GETOPTS *go, int M_hint, int L_hint, int long_targets, en
   pli->do_reseeding       = (seed == 0) ? FALSE : TRUE;
   pli->ddef               = p7_domaindef_Create(pli->r);
   pli->ddef->do_reseeding = pli->do_reseeding;
+  pli->ddef->do_sampling  = (go && esl_opt_GetBoolean(go, "--nosample")) ? FALSE : TRUE;
 
   /* Configure reporting thresholds */
   pli->by_E            = TRUE;
@@ -244,6 +265,9 @@ p7_pipeline_Create(ESL_GETOPTS *go, int M_hint, int L_hint, int long_targets, en
   pli->pos_past_bias   = 0;
   pli->pos_past_vit    = 0;
   pli->pos_past_fwd    = 0;
+  pli->do_stagestats   = (go && esl_opt_GetBoolean(go, "--stagestats") ? TRUE : FALSE);
+  p7_stagestats_Zero(&(pli->stats));
+  pli->ddef->stats     = (pli->do_stagestats ? &(pli->stats) : NULL);
   pli->mode            = mode;
   pli->show_accessions = (go && esl_opt_GetBoolean(go, "--acc")   ? TRUE  : FALSE);
   pli->show_alignments = (go && esl_opt_GetBoolean(go, "--noali") ? FALSE : TRUE);
@@ -502,7 +526,8 @@ p7_pli_NewModel(P7_PIPELINE *pli, const P7_OPROFILE *om, P7_BG *bg)
   if (pli->mode == p7_SEARCH_SEQS)
     status = p7_pli_NewModelThresholds(pli, om);
 
-  pli->W = om->max_length;
+  pli->W    = om->max_length;
+  pli->curL = -1;		/* new model and bias filter HMM: length config is unknown */
 
   return status;
 }
@@ -581,6 +606,74 @@ p7_pli_NewSeq(P7_PIPELINE *pli, const ESL_SQ *sq)
   return eslOK;
 }
 
+/* Function:  p7_pli_SetTargetLength()
+ * Synopsis:  Configure model and null model for a target length, if needed.
+ *
+ * Purpose:   Set the length models of the null model <bg> and the
+ *            profile <om> for a target sequence of length <L>, as
+ *            <p7_bg_SetLength()> and <p7_oprofile_ReconfigLength()>
+ *            do; but skip both calls if <pli> already configured
+ *            <om> and <bg> for length <L> and nothing has changed
+ *            them since. Scores are identical either way; this just
+ *            saves the per-target reconfiguration when successive
+ *            targets have the same length (see
+ *            <p7_pli_OrderByLength()>).
+ *
+ *            Only for a search of target sequences with
+ *            <p7_Pipeline()>, which leaves <om> and <bg> configured
+ *            as it found them. A caller that reconfigures <om> or
+ *            <bg> itself must set <pli->curL> to -1. A call to
+ *            <p7_pli_NewModel()> does so.
+ *
+ * Returns:   <eslOK> on success.
+ */
+int
+p7_pli_SetTargetLength(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, int L)
+{
+  if (L != pli->curL)
+    {
+      p7_bg_SetLength(bg, L);
+      p7_oprofile_ReconfigLength(om, L);
+      pli->curL = L;
+    }
+  return eslOK;
+}
+
+/* Function:  p7_pli_OrderByLength()
+ * Synopsis:  Order a block of target sequences by length.
+ *
+ * Purpose:   Set <order[0..n-1]> to the indices of target sequences
+ *            <sq[0..n-1]> in order of increasing length, ties in
+ *            their input order. A worker that visits a block of
+ *            targets in this order reconfigures its model once per
+ *            distinct length with <p7_pli_SetTargetLength()>,
+ *            instead of once per target. Caller provides <order>,
+ *            allocated for at least <n> elements.
+ *
+ *            <order> is sorted in place (a Shell sort on (length,
+ *            index) pairs), so nothing is allocated per block.
+ *
+ * Returns:   <eslOK> on success.
+ */
+int
+p7_pli_OrderByLength(const ESL_SQ *sq, int n, int *order)
+{
+  int h, i, j, o;
+
+  for (i = 0; i < n; i++) order[i] = i;
+
+  for (h = 1; h < n/3; h = 3*h+1) ;
+  for (; h > 0; h /= 3)
+    for (i = h; i < n; i++)
+      {
+	o = order[i];
+	for (j = i; j >= h && (sq[order[j-h]].n > sq[o].n || (sq[order[j-h]].n == sq[o].n && order[j-h] > o)); j -= h)
+	  order[j] = order[j-h];
+	order[j] = o;
+      }
+  return eslOK;
+}
+
 /* Function:  p7_pipeline_Merge()
  * Synopsis:  Merge the pipeline statistics
  *
@@ -626,6 +719,8 @@ p7_pipeline_Merge(P7_PIPELINE *p1, P7_PIPELINE *p2)
   p1->pos_past_fwd  += p2->pos_past_fwd;
   p1->pos_output    += p2->pos_output;
 
+  p7_stagestats_Merge(&(p1->stats), &(p2->stats));
+
   if (p1->Z_setby == p7_ZSETBY_NTARGETS)
     {
       p1->Z += (p1->mode == p7_SCAN_MODELS) ? p2->nmodels : p2->nseqs;
@@ -638,6 +733,30 @@ p7_pipeline_Merge(P7_PIPELINE *p1, P7_PIPELINE *p2)
   return eslOK;
 }
 
+/* pli_orf_to_nt()
+ * Map the coords of domain <dom> in ORF <orfsq> (see p7_orfscan.c)
+ * to the DNA sequence the ORF came from.
+ */
+static void
+pli_orf_to_nt(P7_DOMAIN *dom, const ESL_SQ *orfsq)
+{
+  int dir = (orfsq->start < orfsq->end ? 1 : -1);
+
+  dom->ienv = p7_orfscan_CodonStart(orfsq, dom->ienv);
+  dom->jenv = p7_orfscan_CodonStart(orfsq, dom->jenv) + 2*dir;
+  dom->iali = p7_orfscan_CodonStart(orfsq, dom->iali);
+  dom->jali = p7_orfscan_CodonStart(orfsq, dom->jali) + 2*dir;
+  dom->iorf = orfsq->start;
+  dom->jorf = orfsq->end;
+  if (dom->ad)
+    {
+      dom->ad->sqfrom = dom->iali;
+      dom->ad->sqto   = dom->jali;
+      dom->ad->L      = orfsq->L;
+    }
+  dom->L = orfsq->L;
+}
+
 /* Function:  p7_Pipeline()
  * Synopsis:  HMMER3's accelerated seq/profile comparison pipeline.
  *
@@ -680,6 +799,10 @@ p7_Pipeline(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, cons
   double           lnP;              /* log P-value of a hit */
   int              Ld;               /* # of residues in envelopes */
   int              d;
+  P7_STAGESTATS   *st      = (pli->do_stagestats ? &(pli->stats) : NULL);
+  uint64_t         t0      = 0;
+  uint64_t         ncells  = (uint64_t) om->M * (uint64_t) sq->n;
+  P7_ARENAMARK     mark;             /* hit list's arena before domain definition */
   int              status;
   
   if (sq->n == 0) return eslOK;    /* silently skip length 0 seqs; they'd cause us all sorts of weird problems */
@@ -690,7 +813,9 @@ p7_Pipeline(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, cons
   p7_bg_NullOne  (bg, sq->dsq, sq->n, &nullsc);
 
   /* First level filter: the MSV filter, multihit with <om> */
+  p7_STAGE_START(st, t0);
   p7_MSVFilter(sq->dsq, sq->n, om, pli->oxf, &usc);
+  p7_STAGE_STOP(st, p7_STAGE_MSV, t0, ncells);
   seq_score = (usc - nullsc) / eslCONST_LOG2;
   P = esl_gumbel_surv(seq_score,  om->evparam[p7_MMU],  om->evparam[p7_MLAMBDA]);
   if (P > pli->F1) return eslOK;
@@ -699,7 +824,9 @@ p7_Pipeline(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, cons
   /* biased composition HMM filtering */
   if (pli->do_biasfilter)
     {
+      p7_STAGE_START(st, t0);
       p7_bg_FilterScore(bg, sq->dsq, sq->n, &filtersc);
+      p7_STAGE_STOP(st, p7_STAGE_BIAS, t0, sq->n);
       seq_score = (usc - filtersc) / eslCONST_LOG2;
       P = esl_gumbel_surv(seq_score,  om->evparam[p7_MMU],  om->evparam[p7_MLAMBDA]);
       if (P > pli->F1) return eslOK;
@@ -718,7 +845,9 @@ p7_Pipeline(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, cons
   /* Second level filter: ViterbiFilter(), multihit with <om> */
   if (P > pli->F2)
     {
+      p7_STAGE_START(st, t0);
       p7_ViterbiFilter(sq->dsq, sq->n, om, pli->oxf, &vfsc);  
+      p7_STAGE_STOP(st, p7_STAGE_VIT, t0, ncells);
       seq_score = (vfsc-filtersc) / eslCONST_LOG2;
       P  = esl_gumbel_surv(seq_score,  om->evparam[p7_VMU],  om->evparam[p7_VLAMBDA]);
       if (P > pli->F2) return eslOK;
@@ -727,7 +856,9 @@ p7_Pipeline(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, cons
 
 
   /* Parse it with Forward and obtain its real Forward score. */
+  p7_STAGE_START(st, t0);
   p7_ForwardParser(sq->dsq, sq->n, om, pli->oxf, &fwdsc);
+  p7_STAGE_STOP(st, p7_STAGE_FWD, t0, ncells);
   seq_score = (fwdsc-filtersc) / eslCONST_LOG2;
   P = esl_exp_surv(seq_score,  om->evparam[p7_FTAU],  om->evparam[p7_FLAMBDA]);
   if (P > pli->F3) return eslOK;
@@ -735,13 +866,25 @@ p7_Pipeline(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, cons
 
   /* ok, it's for real. Now a Backwards parser pass, and hand it to domain definition workflow */
   p7_omx_GrowTo(pli->oxb, om->M, 0, sq->n);
+  p7_STAGE_START(st, t0);
   p7_BackwardParser(sq->dsq, sq->n, om, pli->oxf, pli->oxb, NULL);
+  p7_STAGE_STOP(st, p7_STAGE_BCK, t0, ncells);
+
+  /* Domain definition makes its alignment displays right in the hit
+   * list's arena, so a hit can keep them without copying. Settle the
+   * list first, because a top-K list may compact (replace) its arena
+   * then. If this target doesn't become a hit, its displays are given
+   * back by releasing the arena to <mark>.
+   */
+  if ((status = p7_tophits_Settle(hitlist)) != eslOK) ESL_EXCEPTION(eslEMEM, "allocation failure");
+  pli->ddef->arena = hitlist->arena;
+  p7_arena_Mark(hitlist->arena, &mark);
 
   status = p7_domaindef_ByPosteriorHeuristics(sq, ntsq, om, pli->oxf, pli->oxb, pli->fwd, pli->bck, pli->ddef, bg, FALSE, NULL, NULL, NULL);
   if (status != eslOK) ESL_FAIL(status, pli->errbuf, "domain definition workflow failure"); /* eslERANGE can happen  */
-  if (pli->ddef->nregions   == 0) return eslOK; /* score passed threshold but there's no discrete domains here       */
-  if (pli->ddef->nenvelopes == 0) return eslOK; /* rarer: region was found, stochastic clustered, no envelopes found */
-  if (pli->ddef->ndom       == 0) return eslOK; /* even rarer: envelope found, no domain identified {iss131}         */
+  if (pli->ddef->nregions   == 0) return p7_arena_Release(hitlist->arena, &mark); /* score passed threshold but there's no discrete domains here       */
+  if (pli->ddef->nenvelopes == 0) return p7_arena_Release(hitlist->arena, &mark); /* rarer: region was found, stochastic clustered, no envelopes found */
+  if (pli->ddef->ndom       == 0) return p7_arena_Release(hitlist->arena, &mark); /* even rarer: envelope found, no domain identified {iss131}         */
 
 
   /* Calculate the null2-corrected per-seq score */
@@ -803,20 +946,22 @@ p7_Pipeline(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, cons
   /* Apply thresholding and determine whether to put this
    * target into the hit list. E-value thresholding may
    * only be a lower bound for now, so this list may be longer
-   * than eventually reported.
+   * than eventually reported. A hit list that only keeps its
+   * best hits may already know this one won't make the cut.
    */
   lnP =  esl_exp_logsurv (seq_score,  om->evparam[p7_FTAU], om->evparam[p7_FLAMBDA]);
-  if (p7_pli_TargetReportable(pli, seq_score, lnP))
+  if (p7_pli_TargetReportable(pli, seq_score, lnP) && p7_tophits_Admits(hitlist, pli->inc_by_E ? -lnP : seq_score))
     {
       p7_tophits_CreateNextHit(hitlist, &hit);
       if (pli->mode == p7_SEARCH_SEQS) {
-        if (                       (status  = esl_strdup(sq->name, -1, &(hit->name)))  != eslOK) ESL_EXCEPTION(eslEMEM, "allocation failure");
-        if (sq->acc[0]  != '\0' && (status  = esl_strdup(sq->acc,  -1, &(hit->acc)))   != eslOK) ESL_EXCEPTION(eslEMEM, "allocation failure");
-        if (sq->desc[0] != '\0' && (status  = esl_strdup(sq->desc, -1, &(hit->desc)))  != eslOK) ESL_EXCEPTION(eslEMEM, "allocation failure");
+        const ESL_SQ *tsq = (ntsq ? ntsq : sq); /* a translated search reports the DNA sequence, not the ORF */
+        if (                        (status  = p7_arena_Strdup(hitlist->arena, tsq->name, -1, &(hit->name)))  != eslOK) ESL_EXCEPTION(eslEMEM, "allocation failure");
+        if (tsq->acc[0]  != '\0' && (status  = p7_arena_Strdup(hitlist->arena, tsq->acc,  -1, &(hit->acc)))   != eslOK) ESL_EXCEPTION(eslEMEM, "allocation failure");
+        if (tsq->desc[0] != '\0' && (status  = p7_arena_Strdup(hitlist->arena, tsq->desc, -1, &(hit->desc)))  != eslOK) ESL_EXCEPTION(eslEMEM, "allocation failure");
       } else {
-        if ((status  = esl_strdup(om->name, -1, &(hit->name)))  != eslOK) esl_fatal("allocation failure");
-        if ((status  = esl_strdup(om->acc,  -1, &(hit->acc)))   != eslOK) esl_fatal("allocation failure");
-        if ((status  = esl_strdup(om->desc, -1, &(hit->desc)))  != eslOK) esl_fatal("allocation failure");
+        if ((status  = p7_arena_Strdup(hitlist->arena, om->name, -1, &(hit->name)))  != eslOK) esl_fatal("allocation failure");
+        if ((status  = p7_arena_Strdup(hitlist->arena, om->acc,  -1, &(hit->acc)))   != eslOK) esl_fatal("allocation failure");
+        if ((status  = p7_arena_Strdup(hitlist->arena, om->desc, -1, &(hit->desc)))  != eslOK) esl_fatal("allocation failure");
       } 
       hit->ndom       = pli->ddef->ndom;
       hit->nexpected  = pli->ddef->nexpected;
@@ -842,9 +987,14 @@ p7_Pipeline(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, cons
        * because we probably need to know # of significant
        * hits found to set domZ, and thence threshold and
        * count reported domains.
+       *
+       * The domain list is copied into the hit list's arena,
+       * sharing the alignment displays that domain definition
+       * already made there. If alignments are deferred, the copies
+       * carry their envelopes' residues instead, for
+       * p7_tophits_AlignDomains() to align the reported ones.
        */
-      hit->dcl         = pli->ddef->dcl;
-      pli->ddef->dcl   = NULL;
+      if ((status = p7_tophits_CopyDomains(hitlist, pli->ddef->dcl, pli->ddef->ndom, &(hit->dcl))) != eslOK) ESL_EXCEPTION(eslEMEM, "allocation failure");
       hit->best_domain = 0;
       for (d = 0; d < hit->ndom; d++)
       {
@@ -857,6 +1007,15 @@ p7_Pipeline(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, cons
         if (hit->dcl[d].bitscore > hit->dcl[hit->best_domain].bitscore) hit->best_domain = d;
       }
 
+      /* In a translated search, <sq> is an ORF of <ntsq>. Now that
+       * the domains are scored, map their coordinates from the ORF
+       * to the DNA sequence: i coords to the first base of their
+       * codon, j coords to the last.
+       */
+      if (ntsq)
+	for (d = 0; d < hit->ndom; d++)
+	  pli_orf_to_nt(hit->dcl + d, sq);
+
       /* If we're using model-specific bit score thresholds (GA | TC |
        * NC) and we're in an hmmscan pipeline (mode = p7_SCAN_MODELS),
        * then we *must* apply those reporting or inclusion thresholds
@@ -902,6 +1061,7 @@ p7_Pipeline(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, cons
       }
 	  
     }
+  else p7_arena_Release(hitlist->arena, &mark);  /* not a hit: give back its alignment displays */
 
   return eslOK;
 }
@@ -920,20 +1080,21 @@ p7_Pipeline(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, cons
  *            seq             - sequence in which domain resides
  *            data            - contains model's emission and transition values in unstriped form
  *            K               - alphabet size
+ *            ar              - arena to allocate the scores from (the hit list's)
  *
  * Returns:   <eslOK> on success.
  *
  * Throws:    <eslEMEM> on allocation failure.
  */
 static int
-p7_pli_computeAliScores(P7_DOMAIN *dom, ESL_DSQ *seq, const P7_SCOREDATA *data, int K)
+p7_pli_computeAliScores(P7_DOMAIN *dom, ESL_DSQ *seq, const P7_SCOREDATA *data, int K, P7_ARENA *ar)
 {
   int status;
   int i, j, k;
   float sc;
 
   //Compute score contribution of each position in the alignment to the overall Viterbi score
-  ESL_ALLOC( dom->scores_per_pos, sizeof(float) * dom->ad->N );
+  if ((dom->scores_per_pos = p7_arena_Alloc(ar, sizeof(float) * dom->ad->N)) == NULL) { status = eslEMEM; goto ERROR; }
   for (i=0; i<dom->ad->N; i++)  dom->scores_per_pos[i] = 0.0;
 
   i = dom->iali - 1;        //sequence position
@@ -1048,6 +1209,8 @@ p7_pli_postViterbi_LongTarget(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, P7_T
   float            seq_score;          /* the corrected per-seq bit score */
   double           P;               /* P-value of a hit */
   int              d;
+  int              nkept = 0;         /* # of domains kept as hits */
+  P7_ARENAMARK     mark;              /* hit list's arena before domain definition */
   int              status;
 //  int              nres;
   ESL_DSQ          *dsq_holder;
@@ -1060,12 +1223,16 @@ p7_pli_postViterbi_LongTarget(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, P7_T
   double dom_lnP;
 
   int F3_L = ESL_MIN( window_len,  pli->B3);
+  P7_STAGESTATS *st = (pli->do_stagestats ? &(pli->stats) : NULL);
+  uint64_t       t0 = 0;
 
   p7_bg_SetLength(bg, window_len);
   p7_bg_NullOne  (bg, subseq, window_len, &nullsc);
   if (pli->do_biasfilter)
   {
+    p7_STAGE_START(st, t0);
     p7_bg_FilterScore(bg, subseq, window_len, &bias_filtersc);
+    p7_STAGE_STOP(st, p7_STAGE_BIAS, t0, window_len);
     bias_filtersc -= nullsc;  //remove nullsc, so bias scaling can be done, then add it back on later
   } else {
     bias_filtersc = 0;
@@ -1074,7 +1241,9 @@ p7_pli_postViterbi_LongTarget(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, P7_T
   p7_oprofile_ReconfigRestLength(om, window_len);
 
   /* Parse with Forward and obtain its real Forward score. */
+  p7_STAGE_START(st, t0);
   p7_ForwardParser(subseq, window_len, om, pli->oxf, &fwdsc);
+  p7_STAGE_STOP(st, p7_STAGE_FWD, t0, (uint64_t) om->M * window_len);
   filtersc =  nullsc + (bias_filtersc * ( F3_L>window_len ? 1.0 : (float)F3_L/window_len) );
   seq_score = (fwdsc - filtersc) / eslCONST_LOG2;
   P = esl_exp_surv(seq_score,  om->evparam[p7_FTAU],  om->evparam[p7_FLAMBDA]);
@@ -1097,7 +1266,14 @@ p7_pli_postViterbi_LongTarget(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, P7_T
   /* Now a Backwards parser pass, and hand it to domain definition workflow
    * In this case "domains" will end up being translated as independent "hits" */
   p7_omx_GrowTo(pli->oxb, om->M, 0, window_len);
+  p7_STAGE_START(st, t0);
   p7_BackwardParser(subseq, window_len, om, pli->oxf, pli->oxb, NULL);
+  p7_STAGE_STOP(st, p7_STAGE_BCK, t0, (uint64_t) om->M * window_len);
+
+  /* Alignment displays are made in the hit list's arena, as in p7_Pipeline() */
+  if ((status = p7_tophits_Settle(hitlist)) != eslOK) goto ERROR;
+  pli->ddef->arena = hitlist->arena;
+  p7_arena_Mark(hitlist->arena, &mark);
 
   //if we're asked to not do null correction, pass a NULL instead of a temp scores variable - domaindef knows what to do
   status = p7_domaindef_ByPosteriorHeuristics(pli_tmp->tmpseq, NULL, om, pli->oxf, pli->oxb, pli->fwd, pli->bck, pli->ddef, bg, TRUE,
@@ -1105,8 +1281,8 @@ p7_pli_postViterbi_LongTarget(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, P7_T
 
   pli_tmp->tmpseq->dsq = dsq_holder;
   if (status != eslOK) ESL_FAIL(status, pli->errbuf, "domain definition workflow failure"); /* eslERANGE can happen */
-  if (pli->ddef->nregions   == 0)  return eslOK; /* score passed threshold but there's no discrete domains here       */
-  if (pli->ddef->nenvelopes == 0)  return eslOK; /* rarer: region was found, stochastic clustered, no envelopes found */
+  if (pli->ddef->nregions   == 0)  return p7_arena_Release(hitlist->arena, &mark); /* score passed threshold but there's no discrete domains here       */
+  if (pli->ddef->nenvelopes == 0)  return p7_arena_Release(hitlist->arena, &mark); /* rarer: region was found, stochastic clustered, no envelopes found */
 
 
   /* Put these hits ("domains") into the hit list.
@@ -1133,7 +1309,6 @@ p7_pli_postViterbi_LongTarget(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, P7_T
 
 
       if (ali_len < 8) {
-        p7_alidisplay_Destroy(dom->ad);
         continue; // anything less than this is a funny byproduct of the Forward score passing a very low threshold, but no reliable alignment existing that supports it
       }
 
@@ -1164,7 +1339,7 @@ p7_pli_postViterbi_LongTarget(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, P7_T
       dom_lnP   = esl_exp_logsurv(dom_score, om->evparam[p7_FTAU], om->evparam[p7_FLAMBDA]);
 
       if (pli->do_alignment_score_calc)
-        p7_pli_computeAliScores(dom, subseq, data, om->abc->Kp);
+        p7_pli_computeAliScores(dom, subseq, data, om->abc->Kp, hitlist->arena);
 
       p7_tophits_CreateNextHit(hitlist, &hit);
 
@@ -1175,8 +1350,9 @@ p7_pli_postViterbi_LongTarget(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, P7_T
       hit->seqidx = seqidx;
       hit->subseq_start = seq_start;
 
-      ESL_ALLOC(hit->dcl, sizeof(P7_DOMAIN) );
-      hit->dcl[0] = pli->ddef->dcl[d];
+      /* The hit shares the domain's alignment display and scores, already in the hit list's arena */
+      if ((status = p7_tophits_CopyDomains(hitlist, dom, 1, &(hit->dcl))) != eslOK) goto ERROR;
+      nkept++;
 
       hit->dcl[0].ad->L = seq_len;
 
@@ -1207,13 +1383,13 @@ p7_pli_postViterbi_LongTarget(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, P7_T
 
       if (pli->mode == p7_SEARCH_SEQS)
       {
-        if (                       (status  = esl_strdup(seq_name, -1, &(hit->name)))  != eslOK) ESL_EXCEPTION(eslEMEM, "allocation failure");
-        if (seq_acc[0]  != '\0' && (status  = esl_strdup(seq_acc,  -1, &(hit->acc)))   != eslOK) ESL_EXCEPTION(eslEMEM, "allocation failure");
-        if (seq_desc[0] != '\0' && (status  = esl_strdup(seq_desc, -1, &(hit->desc)))  != eslOK) ESL_EXCEPTION(eslEMEM, "allocation failure");
+        if (                       (status  = p7_arena_Strdup(hitlist->arena, seq_name, -1, &(hit->name)))  != eslOK) ESL_EXCEPTION(eslEMEM, "allocation failure");
+        if (seq_acc[0]  != '\0' && (status  = p7_arena_Strdup(hitlist->arena, seq_acc,  -1, &(hit->acc)))   != eslOK) ESL_EXCEPTION(eslEMEM, "allocation failure");
+        if (seq_desc[0] != '\0' && (status  = p7_arena_Strdup(hitlist->arena, seq_desc, -1, &(hit->desc)))  != eslOK) ESL_EXCEPTION(eslEMEM, "allocation failure");
       } else {
-        if ((status  = esl_strdup(om->name, -1, &(hit->name)))  != eslOK) esl_fatal("allocation failure");
-        if ((status  = esl_strdup(om->acc,  -1, &(hit->acc)))   != eslOK) esl_fatal("allocation failure");
-        if ((status  = esl_strdup(om->desc, -1, &(hit->desc)))  != eslOK) esl_fatal("allocation failure");
+        if ((status  = p7_arena_Strdup(hitlist->arena, om->name, -1, &(hit->name)))  != eslOK) esl_fatal("allocation failure");
+        if ((status  = p7_arena_Strdup(hitlist->arena, om->acc,  -1, &(hit->acc)))   != eslOK) esl_fatal("allocation failure");
+        if ((status  = p7_arena_Strdup(hitlist->arena, om->desc, -1, &(hit->desc)))  != eslOK) esl_fatal("allocation failure");
       }
 
 
@@ -1241,6 +1417,7 @@ p7_pli_postViterbi_LongTarget(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, P7_T
 
   }
 
+  if (nkept == 0) p7_arena_Release(hitlist->arena, &mark);  /* no hits: give back the alignment displays */
   return eslOK;
 
 ERROR:
@@ -1249,40 +1426,113 @@ ERROR:
 }
 
 
+/* Function:  p7_pli_biasFilter_LongTarget()
+ * Synopsis:  the bias filter of the LongTarget P7 search Pipeline
+ *
+ * Purpose:   Decide whether window <subseq> of length <window_len>,
+ *            with null score <nullsc> and MSV score <usc>, survives
+ *            the bias filter, and if so, compute the filter score
+ *            that the Viterbi filter will use to convert its P-value
+ *            threshold to a score threshold: the null score under the
+ *            (possibly shorter) length model that the window is scored
+ *            with downstream, plus the bias correction scaled by --B2.
+ *
+ * Returns:   TRUE if the window passes, and <*ret_filtersc> is set;
+ *            FALSE if it doesn't.
+ */
+static int
+p7_pli_biasFilter_LongTarget(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, ESL_DSQ *subseq, int window_len,
+    float nullsc, float usc, float *ret_filtersc)
+{
+  float            filtersc;           /* HMM null filter score                   */
+  float            bias_filtersc;      /* HMM null filter score                   */
+  float            seq_score;          /* the corrected per-seq bit score */
+  double           P;                  /* P-value of a hit */
+
+  int   loc_window_len;  //used to re-parameterize to shorter target windows
+
+  int F1_L = ESL_MIN( window_len,  pli->B1);
+  int F2_L = ESL_MIN( window_len,  pli->B2);
+  P7_STAGESTATS *st = (pli->do_stagestats ? &(pli->stats) : NULL);
+  uint64_t       t0 = 0;
+
+  //initial bias filter, based on the input window_len
+  if (pli->do_biasfilter) {
+      p7_bg_SetLength(bg, window_len);
+      p7_STAGE_START(st, t0);
+      p7_bg_FilterScore(bg, subseq, window_len, &bias_filtersc);
+      p7_STAGE_STOP(st, p7_STAGE_BIAS, t0, window_len);
+      bias_filtersc -= nullsc; // doing this because I'll be modifying the bias part of filtersc based on length, then adding nullsc back in.
+      filtersc =  nullsc + (bias_filtersc * (float)(( F1_L>window_len ? 1.0 : (float)F1_L/window_len)));
+      seq_score = (usc - filtersc) / eslCONST_LOG2;
+      P = esl_gumbel_surv(seq_score,  om->evparam[p7_MMU],  om->evparam[p7_MLAMBDA]);
+      if (P > pli->F1) return FALSE;
+  } else {
+    bias_filtersc = 0; // mullsc will be added in later
+  }
+  pli->pos_past_bias += window_len;
+
+  //establish a possibly shorter target window parameterization
+  loc_window_len = ESL_MIN(window_len,om->max_length);
+
+  //compute the new nullsc based on possibly shorter window
+  p7_bg_SetLength(bg, loc_window_len);
+  p7_bg_NullOne  (bg, subseq, loc_window_len, &nullsc);
+
+  // bias_filtersc has already been reduced by nullsc based on window_len
+  // We compute a --B2-scaled bias, then tack on the nullsc based on the new,
+  // possibly shorter length model
+  filtersc =  nullsc + (bias_filtersc * ( F2_L>window_len ? 1.0 : (float)F2_L/window_len) );
+
+  *ret_filtersc = filtersc;
+  return TRUE;
+}
+
+
 /* Function:  p7_pli_postSSV_LongTarget()
  * Synopsis:  the part of the LongTarget P7 search Pipeline downstream
- *            of the SSV filter
+ *            of the SSV and bias filters
  *
  * Purpose:   This is called by either the standard (SIMD-SSV) long-target
  *            pipeline (p7_Pipeline_LongTarget) or the FM-index long-target
  *            pipeline (p7_Pipeline_FM), and runs the post-MSV part of H3's
- *            accelerated pipeline to compare profile <om> against sequence
- *            <sq>. If a significant hit is found (within the function
+ *            accelerated pipeline to compare profile <om> against a
+ *            <batch> of windows of digital sequence <dsq> that have
+ *            passed the SSV, MSV and bias filters. If a significant hit
+ *            is found (within the function
  *            p7_pipeline_postViterbi_LongTarget(), called in this function),
  *            information about it is added to the <hitlist>. The pipeline
  *            accumulates beancounting information about how many comparisons
  *            and residues flow through the pipeline while it's active.
  *
+ *            The Viterbi filter is run over all of the <batch> in one
+ *            call (see p7_ViterbiFilter_longtarget_windows()), rather
+ *            than reconfiguring <om> and restarting the filter for
+ *            each window; the windows that pass are then extended,
+ *            merged and passed downstream one <batch> window at a
+ *            time, in order, exactly as if each had been filtered
+ *            on its own.
+ *
  * Args:      pli             - the main pipeline object
  *            om              - optimized profile (query)
  *            bg              - background model
  *            hitlist         - pointer to hit storage bin
  *            data            - for computing windows based on maximum prefix/suffix extensions
- *            seqidx          - the id # of the sequence from which the current window was extracted
- *            window_start    - the starting position of the extracted window (offset from the first
- *                              position of the block of a possibly longer sequence)
- *            window_len      - the length of the extracted window
- *            subseq          - digital sequence of the extracted window
+ *            seqidx          - the id # of the sequence from which the windows were extracted
+ *            batch           - windows of <dsq> that passed the bias filter, with filter scores
+ *                              (from p7_pli_biasFilter_LongTarget()) in <null_sc>
+ *            offset          - offset of <dsq> in the block of a possibly longer sequence; a
+ *                              window's start in that block is its <n> + <offset>
+ *            dsq             - digital sequence that the <batch> windows are in
  *            seq_start       - first position of the sequence block passed in to the calling pipeline function
- *            seq_name        - name of the sequence the window comes from
- *            seq_source      - source of the sequence the window comes from
- *            seq_acc         - acc of the sequence the window comes from
- *            seq_desc        - desc of the sequence the window comes from
- *            seq_len         - length of the sequence the window comes from (only FM will have it; otherwise, 0 and ignored)
- *            nullsc          - score of the passed window vs the bg model
- *            usc             - msv score of the passed window
- *            complementarity - boolean; is the passed window sourced from a complementary sequence block
- *            vit_windowlist  - initialized window list, in which viterbi-passing hits are captured
+ *            seq_name        - name of the sequence the windows come from
+ *            seq_source      - source of the sequence the windows come from
+ *            seq_acc         - acc of the sequence the windows come from
+ *            seq_desc        - desc of the sequence the windows come from
+ *            seq_len         - length of the sequence the windows come from (only FM will have it; otherwise, 0 and ignored)
+ *            complementarity - boolean; are the windows sourced from a complementary sequence block
+ *            vit_batchlist   - initialized window list, in which viterbi-passing hits of the whole batch are captured
+ *            vit_windowlist  - initialized window list, in which viterbi-passing hits of one window are captured
  *            pli_tmp         - a collection of objects used in the long target pipeline that should be
  *                              (and are) only allocated once per pipeline to minimize alloc overhead.
  *
@@ -1301,108 +1551,107 @@ ERROR:
  */
 static int
 p7_pli_postSSV_LongTarget(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, P7_TOPHITS *hitlist, const P7_SCOREDATA *data,
-    int64_t seqidx, uint64_t window_start, int window_len, ESL_DSQ *subseq,
+    int64_t seqidx, const P7_HMM_WINDOWLIST *batch, int64_t offset, ESL_DSQ *dsq,
     uint64_t seq_start, char *seq_name, char *seq_source, char* seq_acc, char* seq_desc, int seq_len,
-    float nullsc, float usc, int complementarity, P7_HMM_WINDOWLIST *vit_windowlist,
+    int complementarity, P7_HMM_WINDOWLIST *vit_batchlist, P7_HMM_WINDOWLIST *vit_windowlist,
     P7_PIPELINE_LONGTARGET_OBJS *pli_tmp
 )
 {
-  float            filtersc;           /* HMM null filter score                   */
-  float            bias_filtersc;      /* HMM null filter score                   */
-  float            seq_score;          /* the corrected per-seq bit score */
-  double           P;                  /* P-value of a hit */
+  P7_HMM_WINDOW   *win;
+  P7_HMM_WINDOW   *hit;
+  ESL_DSQ         *subseq;
+  uint64_t         window_start;
   int i;
+  int w;
+  int h;
   int overlap;
+  int max_batch_len;
+  int status;
   uint64_t new_n;
   uint32_t new_len;
 
-  int   loc_window_len;  //used to re-parameterize to shorter target windows
-
   int max_window_len      = 80000;
   int overlap_len         = ESL_MIN(40000, om->max_length); // Won't allow more than 40K overlap - that's an absurdly long MAXL.
+  P7_STAGESTATS *st       = (pli->do_stagestats ? &(pli->stats) : NULL);
+  uint64_t       t0       = 0;
+  uint64_t       ncells   = 0;
 
-  int F1_L = ESL_MIN( window_len,  pli->B1);
-  int F2_L = ESL_MIN( window_len,  pli->B2);
+  if (batch->count == 0) return eslOK;
 
-  //initial bias filter, based on the input window_len
-  if (pli->do_biasfilter) {
-      p7_bg_SetLength(bg, window_len);
-      p7_bg_FilterScore(bg, subseq, window_len, &bias_filtersc);
-      bias_filtersc -= nullsc; // doing this because I'll be modifying the bias part of filtersc based on length, then adding nullsc back in.
-      filtersc =  nullsc + (bias_filtersc * (float)(( F1_L>window_len ? 1.0 : (float)F1_L/window_len)));
-      seq_score = (usc - filtersc) / eslCONST_LOG2;
-      P = esl_gumbel_surv(seq_score,  om->evparam[p7_MMU],  om->evparam[p7_MLAMBDA]);
-      if (P > pli->F1) return eslOK;
-  } else {
-    bias_filtersc = 0; // mullsc will be added in later
+  /* Second level filter: ViterbiFilter(), multihit with <om>, over the whole batch */
+  max_batch_len = 0;
+  for (w=0; w<batch->count; w++) {
+    max_batch_len = ESL_MAX(max_batch_len, batch->windows[w].length);
+    ncells       += (uint64_t) om->M * batch->windows[w].length;
   }
-  pli->pos_past_bias += window_len;
-
-  //establish a possibly shorter target window parameterization
-  loc_window_len = ESL_MIN(window_len,om->max_length);
-
-  //compute the new nullsc based on possibly shorter window
-  p7_bg_SetLength(bg, loc_window_len);
-  p7_bg_NullOne  (bg, subseq, loc_window_len, &nullsc);
-
-  // bias_filtersc has already been reduced by nullsc based on window_len
-  // We compute a --B2-scaled bias, then tack on the nullsc based on the new,
-  // possibly shorter length model
-  filtersc =  nullsc + (bias_filtersc * ( F2_L>window_len ? 1.0 : (float)F2_L/window_len) );
-
-  //Then configure the model length based on the possibly shorter window length
-  p7_oprofile_ReconfigRestLength(om, loc_window_len);
+  p7_omx_GrowTo(pli->oxf, om->M, 0, max_batch_len);
+
+  //length parameterization is done per window by the filter, without touching <om>
+  p7_STAGE_START(st, t0);
+  status = p7_ViterbiFilter_longtarget_windows(dsq, om, pli->oxf, batch, pli->F2, vit_batchlist);
+  p7_STAGE_STOP(st, p7_STAGE_VIT, t0, ncells);
+  if (status != eslOK) return status;
+
+  h = 0;
+  for (w=0; w<batch->count; w++) {
+    win          = batch->windows + w;
+    subseq       = dsq + win->n - 1;
+    window_start = win->n + offset;
+
+    //pull out this window's viterbi hits; the batch's are grouped by window, in order
+    vit_windowlist->count = 0;
+    for ( ; h < vit_batchlist->count && vit_batchlist->windows[h].id == w; h++) {
+      hit = vit_batchlist->windows + h;
+      if (p7_hmmwindow_new(vit_windowlist, 0, hit->n, hit->fm_n, hit->k, hit->length, hit->score, hit->complementarity, hit->target_len) == NULL)
+        ESL_EXCEPTION(eslEMEM, "Error in LongTarget pipeline\n");
+    }
+    if (vit_windowlist->count == 0) continue;
+
+    p7_pli_ExtendAndMergeWindows (om, data, vit_windowlist, 0.5);
+
+    // if a window is still too long (>80Kb), need to split it up to
+    // ensure numeric stability in Fwd.
+    for (i=0; i<vit_windowlist->count; i++) {
+
+        if (vit_windowlist->windows[i].length > max_window_len) {
+           //modify the current window to restrict length to 40K, then add
+           //new windows with max length 40K, and MAXL overlap w/ preceding window
+           new_n   = vit_windowlist->windows[i].n ;
+           new_len = vit_windowlist->windows[i].length ;
+           vit_windowlist->windows[i].length = max_window_len;
+
+           do {
+             int shift = max_window_len - overlap_len;
+             new_n   +=  shift;
+             new_len -=  shift;
+             p7_hmmwindow_new(vit_windowlist, 0, new_n, 0, 0, ESL_MIN(max_window_len,new_len), 0.0, p7_NOCOMPLEMENT, new_len );
+           } while (new_len > max_window_len);
+        }
+    }
 
-  /* Second level filter: ViterbiFilter(), multihit with <om> */
-  p7_omx_GrowTo(pli->oxf, om->M, 0, window_len);
-
-  //use window_len instead of loc_window_len, because length parameterization is done, just need to loop over subseq
-  p7_ViterbiFilter_longtarget(subseq, window_len, om, pli->oxf, filtersc, pli->F2, vit_windowlist);
-
-  p7_pli_ExtendAndMergeWindows (om, data, vit_windowlist, 0.5);
-
-  // if a window is still too long (>80Kb), need to split it up to
-  // ensure numeric stability in Fwd.
-  for (i=0; i<vit_windowlist->count; i++) {
-
-      if (vit_windowlist->windows[i].length > max_window_len) {
-         //modify the current window to restrict length to 40K, then add
-         //new windows with max length 40K, and MAXL overlap w/ preceding window
-         new_n   = vit_windowlist->windows[i].n ;
-         new_len = vit_windowlist->windows[i].length ;
-         vit_windowlist->windows[i].length = max_window_len;
-
-         do {
-           int shift = max_window_len - overlap_len;
-           new_n   +=  shift;
-           new_len -=  shift;
-           p7_hmmwindow_new(vit_windowlist, 0, new_n, 0, 0, ESL_MIN(max_window_len,new_len), 0.0, p7_NOCOMPLEMENT, new_len );
-         } while (new_len > max_window_len);
+    overlap = 0;
+    for (i=0; i<vit_windowlist->count; i++) {
+      pli->pos_past_vit += vit_windowlist->windows[i].length;
+      //remove overlap with preceding window
+      if (i>0)
+        pli->pos_past_vit -= ESL_MAX(0,  vit_windowlist->windows[i-1].n + vit_windowlist->windows[i-1].length - vit_windowlist->windows[i].n );
+
+      p7_pli_postViterbi_LongTarget(pli, om, bg, hitlist, data, seqidx,
+          window_start+vit_windowlist->windows[i].n-1, vit_windowlist->windows[i].length,
+          subseq + vit_windowlist->windows[i].n - 1,
+          seq_start, seq_name, seq_source, seq_acc, seq_desc, seq_len, complementarity, &overlap,
+          pli_tmp
+      );
+      if (overlap == -1 && i<vit_windowlist->count-1) {
+        overlap = ESL_MAX(0,  vit_windowlist->windows[i].n + vit_windowlist->windows[i].length - vit_windowlist->windows[i+1].n );
+      } else {
+        //that window didn't pass Fwd
+        overlap = 0;
       }
-  }
-
-  overlap = 0;
-  for (i=0; i<vit_windowlist->count; i++) {
-    pli->pos_past_vit += vit_windowlist->windows[i].length;
-    //remove overlap with preceding window
-    if (i>0)
-      pli->pos_past_vit -= ESL_MAX(0,  vit_windowlist->windows[i-1].n + vit_windowlist->windows[i-1].length - vit_windowlist->windows[i].n );
-
-    p7_pli_postViterbi_LongTarget(pli, om, bg, hitlist, data, seqidx,
-        window_start+vit_windowlist->windows[i].n-1, vit_windowlist->windows[i].length,
-        subseq + vit_windowlist->windows[i].n - 1,
-        seq_start, seq_name, seq_source, seq_acc, seq_desc, seq_len, complementarity, &overlap,
-        pli_tmp
-    );
-    if (overlap == -1 && i<vit_windowlist->count-1) {
-      overlap = ESL_MAX(0,  vit_windowlist->windows[i].n + vit_windowlist->windows[i].length - vit_windowlist->windows[i+1].n );
-    } else {
-      //that window didn't pass Fwd
-      overlap = 0;
-    }
 
-    pli->ddef->ndom = 0;
+      pli->ddef->ndom = 0;
 
+    }
   }
 
   return eslOK;
@@ -1472,11 +1721,12 @@ p7_Pipeline_LongTarget(P7_PIPELINE *pli, P7_OPROFILE *om, P7_SCOREDATA *data,
                         )
 {
   int              i;
+  int              nbatch;   /* # of windows passing the bias filter, batched for the Viterbi filter */
   int              status;
   float            nullsc;   /* null model score                        */
   float            usc;      /* msv score  */
+  float            filtersc; /* filter score, for the Viterbi filter    */
   float            P;
-  float            bias_filtersc;
 
   ESL_DSQ          *subseq;
   uint64_t         seq_start;
@@ -1484,10 +1734,15 @@ p7_Pipeline_LongTarget(P7_PIPELINE *pli, P7_OPROFILE *om, P7_SCOREDATA *data,
 
   P7_HMM_WINDOWLIST msv_windowlist;
   P7_HMM_WINDOWLIST vit_windowlist;
+  P7_HMM_WINDOWLIST vit_batchlist;
+  P7_HMM_WINDOWLIST fm_batch;
   P7_HMM_WINDOW    *window;
+  P7_HMM_WINDOW     fm_window;
   FM_SEQDATA        seq_data;
 
   P7_PIPELINE_LONGTARGET_OBJS *pli_tmp;
+  P7_STAGESTATS    *st = (pli->do_stagestats ? &(pli->stats) : NULL);
+  uint64_t          t0 = 0;
 
   if ((sq && (sq->n == 0)) || (fmf && (fmf->N == 0))) return eslOK;    /* silently skip length 0 seqs; they'd cause us all sorts of weird problems */
 
@@ -1501,6 +1756,7 @@ p7_Pipeline_LongTarget(P7_PIPELINE *pli, P7_OPROFILE *om, P7_SCOREDATA *data,
 
   msv_windowlist.windows = NULL;
   vit_windowlist.windows = NULL;
+  vit_batchlist.windows  = NULL;
   p7_hmmwindow_init(&msv_windowlist);
 
   p7_omx_GrowTo(pli->oxf, om->M, 0, om->max_length);    /* expand the one-row omx if needed */
@@ -1515,10 +1771,12 @@ p7_Pipeline_LongTarget(P7_PIPELINE *pli, P7_OPROFILE *om, P7_SCOREDATA *data,
    * This variant of SSV will scan a long sequence and find
    * short high-scoring regions.
    */
+  p7_STAGE_START(st, t0);
   if (fmf) // using an FM-index
     p7_SSVFM_longlarget(om, 2.0, bg, pli->F1, fmf, fmb, fm_cfg, data, pli->strands, &msv_windowlist );
   else // compare directly to sequence
     p7_SSVFilter_longtarget(sq->dsq, sq->n, om, pli->oxf, data, bg, pli->F1, &msv_windowlist);
+  p7_STAGE_STOP(st, p7_STAGE_MSV, t0, (fmf ? 0 : (uint64_t) om->M * sq->n)); /* FM seeds compute no DP cells to speak of */
 
 
   /* convert hits to windows, merging neighboring windows
@@ -1586,11 +1844,19 @@ p7_Pipeline_LongTarget(P7_PIPELINE *pli, P7_OPROFILE *om, P7_SCOREDATA *data,
 
   /* Pass each remaining window on to the remaining pipeline */
     p7_hmmwindow_init(&vit_windowlist);
+    p7_hmmwindow_init(&vit_batchlist);
     pli_tmp->tmpseq = esl_sq_CreateDigital(om->abc);
     if (!fmf )
       free (pli_tmp->tmpseq->dsq);  //this ESL_SQ object is just a container that'll point to a series of other DSQs, so free the one we just created inside the larger SQ object
 
 
+    /* Windows that pass MSV and the bias filter are collected (in
+     * place, at the front of msv_windowlist) into a batch that gets
+     * the Viterbi filter in one pass. In FM mode, each window's
+     * sequence is decoded into the same tmpseq, so the batch is
+     * flushed one window at a time.
+     */
+    nbatch = 0;
     for (i=0; i<msv_windowlist.count; i++){
       window =  msv_windowlist.windows + i ;
 
@@ -1604,40 +1870,49 @@ p7_Pipeline_LongTarget(P7_PIPELINE *pli, P7_OPROFILE *om, P7_SCOREDATA *data,
       p7_bg_SetLength(bg, window->length);
       p7_bg_NullOne  (bg, subseq, window->length, &nullsc);
 
-      p7_bg_FilterScore(bg, subseq, window->length, &bias_filtersc);
       // Compute standard MSV to ensure that bias doesn't overcome SSV score when MSV
       // would have survived it
       p7_oprofile_ReconfigMSVLength(om, window->length);
+      p7_STAGE_START(st, t0);
       p7_MSVFilter(subseq, window->length, om, pli->oxf, &usc);
+      p7_STAGE_STOP(st, p7_STAGE_MSV, t0, (uint64_t) om->M * window->length);
       P = esl_gumbel_surv( (usc-nullsc)/eslCONST_LOG2,  om->evparam[p7_MMU],  om->evparam[p7_MLAMBDA]);
 
       if (P > pli->F1 ) continue;
       pli->pos_past_msv += window->length;
 
+      if (! p7_pli_biasFilter_LongTarget(pli, om, bg, subseq, window->length, nullsc, usc, &filtersc)) continue;
+
       if (fmf) {
         seq_data = fm_cfg->meta->seq_data[window->id];
         seq_start =  seq_data.target_start;
         if (window->complementarity == p7_COMPLEMENT)
           seq_start += seq_data.length - 2;
-      }
 
-      status = p7_pli_postSSV_LongTarget(pli, om, bg, hitlist, data,
-            (fmf != NULL ? seq_data.target_id     : seqidx),
-            window->n, window->length, subseq,
-            (fmf != NULL ? seq_start       : sq->start),
-            (fmf != NULL ? seq_data.name   : sq->name),
-            (fmf != NULL ? seq_data.source : sq->source),
-            (fmf != NULL ? seq_data.acc    : sq->acc),
-            (fmf != NULL ? seq_data.desc   : sq->desc),
-            (fmf != NULL ? seq_data.length : -1),
-            nullsc,
-            usc,
-            (fmf != NULL ? window->complementarity : complementarity),
-            &vit_windowlist,
-            pli_tmp
-        );
+        fm_window         = *window;
+        fm_window.n       = 1;
+        fm_window.null_sc = filtersc;
+        fm_batch.windows  = &fm_window;
+        fm_batch.count    = fm_batch.size = 1;
+
+        status = p7_pli_postSSV_LongTarget(pli, om, bg, hitlist, data,
+              seq_data.target_id, &fm_batch, window->n - 1, subseq,
+              seq_start, seq_data.name, seq_data.source, seq_data.acc, seq_data.desc, seq_data.length,
+              window->complementarity, &vit_batchlist, &vit_windowlist, pli_tmp);
         if (status != eslOK) goto ERROR;
+      } else {
+        window->null_sc = filtersc;
+        msv_windowlist.windows[nbatch++] = *window;
+      }
+    }
 
+    if (!fmf) {
+      msv_windowlist.count = nbatch;
+      status = p7_pli_postSSV_LongTarget(pli, om, bg, hitlist, data,
+            seqidx, &msv_windowlist, 0, sq->dsq,
+            sq->start, sq->name, sq->source, sq->acc, sq->desc, -1,
+            complementarity, &vit_batchlist, &vit_windowlist, pli_tmp);
+      if (status != eslOK) goto ERROR;
     }
 
     if (fmf)  free (pli_tmp->tmpseq->dsq);
@@ -1646,6 +1921,7 @@ p7_Pipeline_LongTarget(P7_PIPELINE *pli, P7_OPROFILE *om, P7_SCOREDATA *data,
 
     esl_sq_Destroy(pli_tmp->tmpseq);
     free (vit_windowlist.windows);
+    free (vit_batchlist.windows);
   }
 
   if (msv_windowlist.windows != NULL) free (msv_windowlist.windows);
@@ -1663,6 +1939,7 @@ p7_Pipeline_LongTarget(P7_PIPELINE *pli, P7_OPROFILE *om, P7_SCOREDATA *data,
 ERROR:
   if (msv_windowlist.windows != NULL) free (msv_windowlist.windows);
   if (vit_windowlist.windows != NULL) free (vit_windowlist.windows);
+  if (vit_batchlist.windows  != NULL) free (vit_batchlist.windows);
 
   if (pli_tmp != NULL) {
     if (pli_tmp->tmpseq != NULL) esl_sq_Destroy(pli_tmp->tmpseq);
@@ -1694,6 +1971,8 @@ int
 p7_pli_Statistics(FILE *ofp, P7_PIPELINE *pli, ESL_STOPWATCH *w)
 {
   double ntargets; 
+  double secs;
+  int    s;
 
   fprintf(ofp, "Internal pipeline statistics summary:\n");
   fprintf(ofp, "-------------------------------------\n");
@@ -1768,13 +2047,362 @@ p7_pli_Statistics(FILE *ofp, P7_PIPELINE *pli, ESL_STOPWATCH *w)
         (double) pli->nres * (double) pli->nnodes / (w->elapsed * 1.0e6));
   }
 
+  if (pli->do_stagestats) {
+    fprintf(ofp, "Per-stage time and DP cells (summed over threads):\n");
+    for (s = 0; s < p7_NSTAGES; s++)
+      {
+        secs = (double) pli->stats.ns[s] * 1e-9;
+        fprintf(ofp, "  %-26s %10.3f sec  %18" PRIu64 " cells", p7_stagestats_Name(s), secs, pli->stats.cells[s]);
+        if (secs > 0. && pli->stats.cells[s] > 0) fprintf(ofp, "  (%.2f Mc/sec)", (double) pli->stats.cells[s] / (secs * 1.0e6));
+        fprintf(ofp, "\n");
+      }
+  }
+
+  return eslOK;
+}
+
+
+/* Function:  p7_pli_TabularStageStats()
+ * Synopsis:  Per-stage timing in the tail of tabular output.
+ *
+ * Purpose:   Write the per-stage times and DP cell counts in <st>
+ *            (collected with --stagestats, typically summed over all
+ *            the queries in a run) to tabular output stream <ofp>, as
+ *            '#' comment lines, one per stage:
+ *            
+ *              # Stage <name>: <seconds> sec <cells> cells
+ *            
+ *            Called just before <p7_tophits_TabularTail()>.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEWRITE> on write failure.
+ */
+int
+p7_pli_TabularStageStats(FILE *ofp, const P7_STAGESTATS *st)
+{
+  int s;
+
+  if (fprintf(ofp, "#\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "tabular stage statistics, write failed");
+  for (s = 0; s < p7_NSTAGES; s++)
+    if (fprintf(ofp, "# Stage %-11s %12.3f sec %18" PRIu64 " cells\n", stage_shortname[s], (double) st->ns[s] * 1e-9, st->cells[s]) < 0)
+      ESL_EXCEPTION_SYS(eslEWRITE, "tabular stage statistics, write failed");
   return eslOK;
 }
 /*------------------- end, pipeline API -------------------------*/
 
 
+
+/*****************************************************************
+ * 3. P7_STAGESTATS: optional per-stage instrumentation
+ *****************************************************************/
+
+/* Function:  p7_stagestats_Clock()
+ * Synopsis:  Nanosecond timestamp for stage timing.
+ *
+ * Purpose:   Return a timestamp in nanoseconds from an arbitrary
+ *            origin, from the monotonic clock where POSIX provides
+ *            one, else from the time of day. Only differences
+ *            between two timestamps are meaningful.
+ */
+uint64_t
+p7_stagestats_Clock(void)
+{
+#if defined(_POSIX_TIMERS) && _POSIX_TIMERS > 0 && defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+#else
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return (uint64_t) tv.tv_sec * 1000000000ull + (uint64_t) tv.tv_usec * 1000ull;
+#endif
+}
+
+/* Function:  p7_stagestats_Zero()
+ * Synopsis:  Zero all the counters of a <P7_STAGESTATS>.
+ */
+void
+p7_stagestats_Zero(P7_STAGESTATS *st)
+{
+  int s;
+  for (s = 0; s < p7_NSTAGES; s++) st->ns[s] = st->cells[s] = 0;
+}
+
+/* Function:  p7_stagestats_Merge()
+ * Synopsis:  Add the counters of <st2> to <st1>.
+ */
+void
+p7_stagestats_Merge(P7_STAGESTATS *st1, const P7_STAGESTATS *st2)
+{
+  int s;
+  for (s = 0; s < p7_NSTAGES; s++) {
+    st1->ns[s]    += st2->ns[s];
+    st1->cells[s] += st2->cells[s];
+  }
+}
+
+/* Function:  p7_stagestats_Name()
+ * Synopsis:  Return the label of stage <s>.
+ */
+const char *
+p7_stagestats_Name(int s)
+{
+  return ((s >= 0 && s < p7_NSTAGES) ? stage_longname[s] : "[unknown stage]");
+}
+/*------------- end, P7_STAGESTATS instrumentation --------------*/
+
+
+/*****************************************************************
+ * 4. Machine-readable statistics and progress records
+ *****************************************************************/
+
+/* The --statsout stream is JSON lines: one object per line, each
+ * with a "type" member, "query" or "progress". Names are the only
+ * strings that need escaping.
+ */
+static int
+json_string(FILE *ofp, const char *str)
+{
+  const char *c;
+
+  if (str == NULL) return (fputs("null", ofp) < 0) ? eslEWRITE : eslOK;
+
+  if (fputc('"', ofp) == EOF) return eslEWRITE;
+  for (c = str; *c != '\0'; c++)
+    {
+      if      (*c == '"' || *c == '\\')      { if (fprintf(ofp, "\\%c", *c) < 0)                      return eslEWRITE; }
+      else if ((unsigned char) *c < 0x20)   { if (fprintf(ofp, "\\u%04x", (unsigned char) *c) < 0)  return eslEWRITE; }
+      else                                  { if (fputc(*c, ofp) == EOF)                             return eslEWRITE; }
+    }
+  if (fputc('"', ofp) == EOF) return eslEWRITE;
+  return eslOK;
+}
+
+/* Peak resident set size of this process in kilobytes; -1 if the
+ * system doesn't tell us.
+ */
+static int64_t
+peak_rss_kb(void)
+{
+#if defined(HAVE_GETRUSAGE) && defined(HAVE_SYS_RESOURCE_H)
+  struct rusage ru;
+
+  if (getrusage(RUSAGE_SELF, &ru) != 0) return -1;
+#if defined(__APPLE__)
+  return (int64_t) ru.ru_maxrss / 1024;	/* MacOS/X reports bytes; Linux, BSDs report KB */
+#else
+  return (int64_t) ru.ru_maxrss;
+#endif
+#else
+  return -1;
+#endif
+}
+
+/* Function:  p7_pli_JSONStatistics()
+ * Synopsis:  Write one query's pipeline statistics as a JSON line.
+ *
+ * Purpose:   Write the accounting in pipeline <pli> at the end of a
+ *            search to <ofp> as a single-line JSON object, for job
+ *            schedulers and scripts (--statsout): program <progname>,
+ *            query name <qname>, the number of query and target
+ *            models, sequences and residues; the number of targets
+ *            (or, for long targets, residues) passing each filter and
+ *            its pass rate; the number of reported and included hits
+ *            in <th>, if <th> is non-NULL; elapsed, user and system
+ *            seconds from stopped stopwatch <w>, if <w> is non-NULL;
+ *            the process's peak resident set size so far; and the
+ *            number of worker threads <nthreads> (0 if serial).
+ *
+ *            Unknown values are written as <null>.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEWRITE> on any write failure.
+ */
+int
+p7_pli_JSONStatistics(FILE *ofp, const char *progname, const char *qname, P7_PIPELINE *pli, const P7_TOPHITS *th, ESL_STOPWATCH *w, int nthreads)
+{
+  static const char *filtername[4] = { "msv", "bias", "vit", "fwd" };
+  uint64_t pass[4];
+  double   denom;
+  int64_t  rss = peak_rss_kb();
+  int      i;
+
+  if (pli->long_targets) {
+    pass[0] = pli->pos_past_msv;  pass[1] = pli->pos_past_bias;
+    pass[2] = pli->pos_past_vit;  pass[3] = pli->pos_past_fwd;
+    denom   = (double) pli->nres * (double) pli->nmodels;
+  } else {
+    pass[0] = pli->n_past_msv;    pass[1] = pli->n_past_bias;
+    pass[2] = pli->n_past_vit;    pass[3] = pli->n_past_fwd;
+    denom   = (double) (pli->mode == p7_SEARCH_SEQS ? pli->nseqs : pli->nmodels);
+  }
+
+  if (fputs("{\"type\":\"query\",\"program\":", ofp) < 0)                  ESL_EXCEPTION_SYS(eslEWRITE, "json statistics, write failed");
+  if (json_string(ofp, progname) != eslOK)                                 ESL_EXCEPTION_SYS(eslEWRITE, "json statistics, write failed");
+  if (fputs(",\"query\":", ofp) < 0)                                       ESL_EXCEPTION_SYS(eslEWRITE, "json statistics, write failed");
+  if (json_string(ofp, qname) != eslOK)                                    ESL_EXCEPTION_SYS(eslEWRITE, "json statistics, write failed");
+  if (fprintf(ofp, ",\"mode\":\"%s\",\"models\":%" PRIu64 ",\"nodes\":%" PRIu64 ",\"seqs\":%" PRIu64 ",\"residues\":%" PRIu64,
+	      pli->mode == p7_SEARCH_SEQS ? "search" : "scan",
+	      pli->nmodels, pli->nnodes, pli->nseqs, pli->nres) < 0)      ESL_EXCEPTION_SYS(eslEWRITE, "json statistics, write failed");
+
+  if (fprintf(ofp, ",\"pass_units\":\"%s\",\"pass\":{\"msv\":%" PRIu64 ",\"bias\":%" PRIu64 ",\"vit\":%" PRIu64 ",\"fwd\":%" PRIu64 "}",
+	      pli->long_targets ? "residues" : "targets",
+	      pass[0], pass[1], pass[2], pass[3]) < 0)                    ESL_EXCEPTION_SYS(eslEWRITE, "json statistics, write failed");
+  if (fputs(",\"pass_rate\":{", ofp) < 0)                                  ESL_EXCEPTION_SYS(eslEWRITE, "json statistics, write failed");
+  for (i = 0; i < 4; i++)
+    {
+      if (fprintf(ofp, "%s\"%s\":", i ? "," : "", filtername[i]) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "json statistics, write failed");
+      if (denom > 0.) { if (fprintf(ofp, "%.6g", (double) pass[i] / denom) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "json statistics, write failed"); }
+      else            { if (fputs("null", ofp) < 0)                              ESL_EXCEPTION_SYS(eslEWRITE, "json statistics, write failed"); }
+    }
+  if (fputs("}", ofp) < 0)                                                 ESL_EXCEPTION_SYS(eslEWRITE, "json statistics, write failed");
+
+  if (th) { if (fprintf(ofp, ",\"reported\":%" PRIu64 ",\"included\":%" PRIu64, th->nreported, th->nincluded) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "json statistics, write failed"); }
+  else    { if (fputs(",\"reported\":null,\"included\":null", ofp) < 0)                                             ESL_EXCEPTION_SYS(eslEWRITE, "json statistics, write failed"); }
+
+  if (w)  { if (fprintf(ofp, ",\"elapsed\":%.3f,\"user\":%.3f,\"sys\":%.3f", w->elapsed, w->user, w->sys) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "json statistics, write failed"); }
+  else    { if (fputs(",\"elapsed\":null,\"user\":null,\"sys\":null", ofp) < 0)                               ESL_EXCEPTION_SYS(eslEWRITE, "json statistics, write failed"); }
+
+  if (rss >= 0) { if (fprintf(ofp, ",\"peak_rss_kb\":%" PRId64, rss) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "json statistics, write failed"); }
+  else          { if (fputs(",\"peak_rss_kb\":null", ofp) < 0)            ESL_EXCEPTION_SYS(eslEWRITE, "json statistics, write failed"); }
+
+  if (fprintf(ofp, ",\"threads\":%d}\n", nthreads) < 0)                   ESL_EXCEPTION_SYS(eslEWRITE, "json statistics, write failed");
+  fflush(ofp);
+  return eslOK;
+}
+
+
+/* Function:  p7_progress_Create()
+ * Synopsis:  Create a periodic progress reporter.
+ *
+ * Purpose:   Create a progress reporter that writes a JSON line
+ *            record to <ofp> at most every <interval> seconds, on
+ *            behalf of program <progname>, for passes over the target
+ *            file <dbfile>.
+ *
+ *            If <dbfile> is a regular file (not stdin, not gzipped),
+ *            its size is used to estimate the fraction done and the
+ *            time remaining; otherwise those are reported as <null>.
+ *
+ * Returns:   ptr to the new <P7_PROGRESS>.
+ *
+ * Throws:    <NULL> on allocation failure.
+ */
+P7_PROGRESS *
+p7_progress_Create(FILE *ofp, const char *progname, double interval, const char *dbfile)
+{
+  P7_PROGRESS *prg = NULL;
+  struct stat  fileinfo;
+  int          n;
+  int          status;
+
+  ESL_ALLOC(prg, sizeof(P7_PROGRESS));
+  prg->ofp      = ofp;
+  prg->progname = progname;
+  prg->qname    = NULL;
+  prg->interval = (uint64_t) (ESL_MAX(interval, 0.) * 1e9);
+  prg->dbsize   = 0;
+
+  n = (dbfile ? strlen(dbfile) : 0);
+  if (n > 0 && strcmp(dbfile, "-") != 0 && (n < 3 || strcmp(dbfile+n-3, ".gz") != 0) &&
+      stat(dbfile, &fileinfo) == 0 && S_ISREG(fileinfo.st_mode))
+    prg->dbsize = (int64_t) fileinfo.st_size;
+
+  p7_progress_Start(prg, NULL);
+  return prg;
+
+ ERROR:
+  p7_progress_Destroy(prg);
+  return NULL;
+}
+
+/* Function:  p7_progress_Start()
+ * Synopsis:  Start a new pass over the targets.
+ *
+ * Purpose:   Reset the counters and the clock of <prg> for a new pass
+ *            over the target database, for query <qname> (or NULL,
+ *            for a batch of queries searched together).
+ */
+void
+p7_progress_Start(P7_PROGRESS *prg, const char *qname)
+{
+  prg->qname = qname;
+  prg->nseqs = 0;
+  prg->nres  = 0;
+  prg->t0    = p7_stagestats_Clock();
+  prg->tnext = prg->t0 + prg->interval;
+}
+
+/* Function:  p7_progress_Update()
+ * Synopsis:  Count targets read, and maybe write a progress record.
+ *
+ * Purpose:   Add <nseqs> targets of <nres> total residues to the
+ *            counts for this pass of <prg>; <offset> is the current
+ *            byte offset in the target file, or -1 if unknown. If a
+ *            record is due, write one: residues and targets read so
+ *            far, elapsed seconds, rate in residues/sec, and the
+ *            fraction done and estimated seconds remaining if known.
+ *
+ *            Counts are of targets read, not finished: with threads,
+ *            the reader runs a few blocks ahead of the workers.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEWRITE> on write failure.
+ */
+int
+p7_progress_Update(P7_PROGRESS *prg, uint64_t nseqs, uint64_t nres, int64_t offset)
+{
+  uint64_t now;
+  double   secs;
+  double   frac;
+
+  prg->nseqs += nseqs;
+  prg->nres  += nres;
+
+  now = p7_stagestats_Clock();
+  if (now < prg->tnext) return eslOK;
+  while (prg->tnext <= now) prg->tnext += ESL_MAX(prg->interval, 1);
+
+  secs = (double) (now - prg->t0) * 1e-9;
+  if (fputs("{\"type\":\"progress\",\"program\":", prg->ofp) < 0)  ESL_EXCEPTION_SYS(eslEWRITE, "progress record, write failed");
+  if (json_string(prg->ofp, prg->progname) != eslOK)                 ESL_EXCEPTION_SYS(eslEWRITE, "progress record, write failed");
+  if (fputs(",\"query\":", prg->ofp) < 0)                            ESL_EXCEPTION_SYS(eslEWRITE, "progress record, write failed");
+  if (json_string(prg->ofp, prg->qname) != eslOK)                    ESL_EXCEPTION_SYS(eslEWRITE, "progress record, write failed");
+  if (fprintf(prg->ofp, ",\"seqs\":%" PRIu64 ",\"residues\":%" PRIu64 ",\"elapsed\":%.3f,\"rate\":%.6g",
+	      prg->nseqs, prg->nres, secs, secs > 0. ? (double) prg->nres / secs : 0.) < 0)
+                                                                     ESL_EXCEPTION_SYS(eslEWRITE, "progress record, write failed");
+
+  if (prg->dbsize > 0 && offset > 0)
+    {
+      frac = ESL_MIN(1.0, (double) offset / (double) prg->dbsize);
+      if (fprintf(prg->ofp, ",\"frac\":%.4f,\"eta\":%.1f}\n", frac, secs * (1.0 - frac) / frac) < 0)
+	ESL_EXCEPTION_SYS(eslEWRITE, "progress record, write failed");
+    }
+  else if (fputs(",\"frac\":null,\"eta\":null}\n", prg->ofp) < 0)
+    ESL_EXCEPTION_SYS(eslEWRITE, "progress record, write failed");
+
+  fflush(prg->ofp);
+  return eslOK;
+}
+
+/* Function:  p7_progress_Destroy()
+ * Synopsis:  Free a <P7_PROGRESS>.
+ */
+void
+p7_progress_Destroy(P7_PROGRESS *prg)
+{
+  if (prg) free(prg);
+}
+/*------------- end, machine-readable statistics ----------------*/
+
+
 /*****************************************************************
- * 3. Example 1: "search mode" in a sequence db
+ * 5. Example 1: "search mode" in a sequence db
  *****************************************************************/
 
 #ifdef p7PIPELINE_EXAMPLE
@@ -1808,6 +2436,8 @@ static ESL_OPTIONS options[] = {
   { "--F3",         eslARG_REAL,  "1e-5", NULL, NULL,      NULL,  NULL, "--max",                        "Stage 3 (Fwd) threshold: promote hits w/ P <= F3",             0 },
   { "--nobias",     eslARG_NONE,   NULL,  NULL, NULL,      NULL,  NULL, "--max",                        "turn off composition bias filter",                             0 },
   { "--nonull2",    eslARG_NONE,   NULL,  NULL, NULL,      NULL,  NULL,  NULL,                          "turn off biased composition score corrections",                0 },
+  { "--nosample",   eslARG_NONE,   NULL,  NULL, NULL,      NULL,  NULL,  NULL,                          "split domains by posterior decoding, not sampling",            0 },
+  { "--stagestats", eslARG_NONE,   NULL,  NULL, NULL,      NULL,  NULL,  NULL,                          "time each pipeline stage, and count its DP cells",             0 },
   { "--seed",       eslARG_INT,    "42",  NULL, "n>=0",    NULL,  NULL,  NULL,                          "set RNG seed to <n> (if 0: one-time arbitrary seed)",          0 },
   { "--acc",        eslARG_NONE,  FALSE,  NULL, NULL,      NULL,  NULL,  NULL,                          "output target accessions instead of names if possible",        0 },
  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
@@ -1914,7 +2544,7 @@ main(int argc, char **argv)
 
 
 /*****************************************************************
- * 4. Example 2: "scan mode" in an HMM db
+ * 6. Example 2: "scan mode" in an HMM db
  *****************************************************************/
 #ifdef p7PIPELINE_EXAMPLE2
 /* gcc -o pipeline_example2 -g -Wall -I../easel -L../easel -I. -L. -Dp7PIPELINE_EXAMPLE2 p7_pipeline.c -lhmmer -leasel -lm
@@ -1947,6 +2577,8 @@ static ESL_OPTIONS options[] = {
   { "--F3",         eslARG_REAL,  "1e-5", NULL, NULL,      NULL,  NULL, "--max",                        "Stage 3 (Fwd) threshold: promote hits w/ P <= F3",             0 },
   { "--nobias",     eslARG_NONE,   NULL,  NULL, NULL,      NULL,  NULL, "--max",                        "turn off composition bias filter",                             0 },
   { "--nonull2",    eslARG_NONE,   NULL,  NULL, NULL,      NULL,  NULL,  NULL,                          "turn off biased composition score corrections",                0 },
+  { "--nosample",   eslARG_NONE,   NULL,  NULL, NULL,      NULL,  NULL,  NULL,                          "split domains by posterior decoding, not sampling",            0 },
+  { "--stagestats", eslARG_NONE,   NULL,  NULL, NULL,      NULL,  NULL,  NULL,                          "time each pipeline stage, and count its DP cells",             0 },
   { "--seed",       eslARG_INT,    "42",  NULL, "n>=0",    NULL,  NULL,  NULL,                          "set RNG seed to <n> (if 0: one-time arbitrary seed)",          0 },
   { "--acc",        eslARG_NONE,  FALSE,  NULL, NULL,      NULL,  NULL,  NULL,                          "output target accessions instead of names if possible",        0 },
   {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
@@ -12,10 +12,18 @@
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <math.h>
 
 #include "easel.h"
 #include "hmmer.h"
 
+#define p7_TOPHITS_ARENABLOCK 65536  /* first block of a hit list's arena, bytes */
+
+static int  copy_domains(P7_ARENA *ar, const P7_DOMAIN *dcl, int ndom, int deep, P7_DOMAIN **ret_dcl);
+static void free_hit_data(P7_HIT *hit, uint64_t N, const P7_ARENA *ar);
+static int  topk_settle(P7_TOPHITS *h);
+static int  topk_truncate(P7_TOPHITS *h);
+
 /*****************************************************************
  *= 1. The P7_TOPHITS object
  *****************************************************************/
@@ -26,6 +34,18 @@
  * Purpose:   Allocates a new <P7_TOPHITS> hit list and return a pointer
  *            to it.
  *
+ *            The list has its own <P7_ARENA>, <h->arena>, that
+ *            callers filling in hits must allocate names,
+ *            accessions, descriptions, domain lists, alignment
+ *            displays, and score arrays from (see
+ *            <p7_arena_Strdup()>, <p7_tophits_CopyDomains()>,
+ *            <p7_alidisplay_CreateInArena()>). The arena owns all of
+ *            it, and it is released all at once by
+ *            <p7_tophits_Reuse()> or <p7_tophits_Destroy()>. Only a
+ *            list that was built by hand without an arena
+ *            (<h->arena> is <NULL>) has its hit data free'd
+ *            individually.
+ *
  * Throws:    <NULL> on allocation failure.
  */
 P7_TOPHITS *
@@ -38,9 +58,11 @@ p7_tophits_Create(void)
   ESL_ALLOC(h, sizeof(P7_TOPHITS));
   h->hit    = NULL;
   h->unsrt  = NULL;
+  h->arena  = NULL;
 
   ESL_ALLOC(h->hit,   sizeof(P7_HIT *) * default_nalloc);
   ESL_ALLOC(h->unsrt, sizeof(P7_HIT)   * default_nalloc);
+  if ((h->arena = p7_arena_Create(p7_TOPHITS_ARENABLOCK)) == NULL) { status = eslEMEM; goto ERROR; }
   h->Nalloc    = default_nalloc;
   h->N         = 0;
   h->nreported = 0;
@@ -48,6 +70,11 @@ p7_tophits_Create(void)
   h->is_sorted_by_sortkey = TRUE; /* but only because there's 0 hits */
   h->is_sorted_by_seqidx  = FALSE;
   h->hit[0]    = h->unsrt;        /* if you're going to call it "sorted" when it contains just one hit, you need this */
+  h->maxhits   = 0;
+  h->heap      = NULL;
+  h->nheap     = 0;
+  h->ndropped  = 0;
+  h->nevicted  = 0;
   return h;
 
  ERROR:
@@ -107,6 +134,11 @@ p7_tophits_Grow(P7_TOPHITS *h)
  *            this new <P7_HIT> structure for data to be filled
  *            in by the caller.
  *
+ *            In top-K mode (see <p7_tophits_SetMaxHits()>), the
+ *            previous new hit, now filled in, is either kept, or
+ *            dropped here; so don't hold on to a hit pointer past
+ *            the next call.
+ *
  * Returns:   <eslOK> on success.
  *
  * Throws:    <eslEMEM> on allocation error.
@@ -117,7 +149,8 @@ p7_tophits_CreateNextHit(P7_TOPHITS *h, P7_HIT **ret_hit)
   P7_HIT *hit = NULL;
   int     status;
 
-  if ((status = p7_tophits_Grow(h)) != eslOK) goto ERROR;
+  if ((status = p7_tophits_Settle(h)) != eslOK) goto ERROR;
+  if ((status = p7_tophits_Grow(h))   != eslOK) goto ERROR;
   
   hit = &(h->unsrt[h->N]);
   h->N++;
@@ -164,6 +197,77 @@ p7_tophits_CreateNextHit(P7_TOPHITS *h, P7_HIT **ret_hit)
 
 
 
+/* Function:  p7_tophits_CopyDomains()
+ * Synopsis:  Copy a domain list into a hit list's arena.
+ *
+ * Purpose:   Copy the <ndom> domains in <dcl> into the arena of hit
+ *            list <h>, and return the copy in <*ret_dcl>, ready to be
+ *            attached to one of <h>'s hits. <dcl> itself is
+ *            unchanged; caller still owns it.
+ *
+ *            The domains' alignment displays and per-position score
+ *            arrays must already have been made in <h>'s arena
+ *            (<p7_domaindef_ByPosteriorHeuristics()> does that when
+ *            <ddef->arena> is <h->arena>); only the pointers to them
+ *            are copied.
+ *
+ *            A domain whose alignment was deferred has its envelope's
+ *            residues copied, with sentinels at both ends, so the
+ *            copy no longer depends on the target sequence.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure, and <*ret_dcl> is <NULL>.
+ *            Anything already copied stays in the arena until <h> is
+ *            reused or destroyed.
+ */
+int
+p7_tophits_CopyDomains(P7_TOPHITS *h, const P7_DOMAIN *dcl, int ndom, P7_DOMAIN **ret_dcl)
+{
+  return copy_domains(h->arena, dcl, ndom, FALSE, ret_dcl);
+}
+
+/* copy_domains()
+ * Copy <ndom> domains <dcl> into arena <ar>. If <deep> is TRUE, their
+ * alignment displays and score arrays are copied too; otherwise the
+ * copy shares them with <dcl>. Envelope residues are always copied.
+ */
+static int
+copy_domains(P7_ARENA *ar, const P7_DOMAIN *dcl, int ndom, int deep, P7_DOMAIN **ret_dcl)
+{
+  P7_DOMAIN *dcl2 = NULL;
+  int64_t    Ld;
+  int        d;
+  int        status;
+
+  if ((dcl2 = p7_arena_Alloc(ar, sizeof(P7_DOMAIN) * ESL_MAX(ndom, 1))) == NULL) { status = eslEMEM; goto ERROR; }
+  memcpy(dcl2, dcl, sizeof(P7_DOMAIN) * ndom);
+
+  for (d = 0; d < ndom; d++)
+    {
+      if (deep && dcl[d].ad != NULL && (dcl2[d].ad = p7_alidisplay_CloneInArena(dcl[d].ad, ar)) == NULL) { status = eslEMEM; goto ERROR; }
+      if (dcl[d].envdsq != NULL)
+	{
+	  Ld = dcl[d].jenv - dcl[d].ienv + 1;
+	  if ((dcl2[d].envdsq = p7_arena_Alloc(ar, sizeof(ESL_DSQ) * (Ld+2))) == NULL) { status = eslEMEM; goto ERROR; }
+	  memcpy(dcl2[d].envdsq + 1, dcl[d].envdsq + 1, sizeof(ESL_DSQ) * Ld);
+	  dcl2[d].envdsq[0] = dcl2[d].envdsq[Ld+1] = eslDSQ_SENTINEL;
+	}
+      if (deep && dcl[d].scores_per_pos != NULL)
+	{
+	  if ((dcl2[d].scores_per_pos = p7_arena_Alloc(ar, sizeof(float) * dcl[d].ad->N)) == NULL) { status = eslEMEM; goto ERROR; }
+	  memcpy(dcl2[d].scores_per_pos, dcl[d].scores_per_pos, sizeof(float) * dcl[d].ad->N);
+	}
+    }
+  *ret_dcl = dcl2;
+  return eslOK;
+
+ ERROR:
+  *ret_dcl = NULL;
+  return status;
+}
+
+
 /* Function:  p7_tophits_Add()
  * Synopsis:  Add a hit to the top hits list.
  *
@@ -220,10 +324,11 @@ p7_tophits_Add(P7_TOPHITS *h,
 {
   int status;
 
-  if ((status = p7_tophits_Grow(h))                           != eslOK) return status;
-  if ((status = esl_strdup(name, -1, &(h->unsrt[h->N].name))) != eslOK) return status;
-  if ((status = esl_strdup(acc,  -1, &(h->unsrt[h->N].acc)))  != eslOK) return status;
-  if ((status = esl_strdup(desc, -1, &(h->unsrt[h->N].desc))) != eslOK) return status;
+  if ((status = p7_tophits_Settle(h))                                        != eslOK) return status;
+  if ((status = p7_tophits_Grow(h))                                          != eslOK) return status;
+  if ((status = p7_arena_Strdup(h->arena, name, -1, &(h->unsrt[h->N].name))) != eslOK) return status;
+  if ((status = p7_arena_Strdup(h->arena, acc,  -1, &(h->unsrt[h->N].acc)))  != eslOK) return status;
+  if ((status = p7_arena_Strdup(h->arena, desc, -1, &(h->unsrt[h->N].desc))) != eslOK) return status;
   h->unsrt[h->N].sortkey    = sortkey;
   h->unsrt[h->N].score      = score;
   h->unsrt[h->N].pre_score  = 0.0;
@@ -344,7 +449,9 @@ int
 p7_tophits_SortBySortkey(P7_TOPHITS *h)
 {
   int i;
+  int status;
 
+  if ((status = topk_settle(h)) != eslOK) return status;
   if (h->is_sorted_by_sortkey)  return eslOK;
   for (i = 0; i < h->N; i++) h->hit[i] = h->unsrt + i;
   if (h->N > 1)  qsort(h->hit, h->N, sizeof(P7_HIT *), hit_sorter_by_sortkey);
@@ -368,7 +475,9 @@ int
 p7_tophits_SortBySeqidxAndAlipos(P7_TOPHITS *h)
 {
   int i;
+  int status;
 
+  if ((status = topk_settle(h)) != eslOK) return status;
   if (h->is_sorted_by_seqidx)  return eslOK;
   for (i = 0; i < h->N; i++) h->hit[i] = h->unsrt + i;
   if (h->N > 1)  qsort(h->hit, h->N, sizeof(P7_HIT *), hit_sorter_by_seqidx_aliposition);
@@ -391,7 +500,9 @@ int
 p7_tophits_SortByModelnameAndAlipos(P7_TOPHITS *h)
 {
   int i;
+  int status;
 
+  if ((status = topk_settle(h)) != eslOK) return status;
   if (h->is_sorted_by_seqidx)  return eslOK;
   for (i = 0; i < h->N; i++) h->hit[i] = h->unsrt + i;
   if (h->N > 1)  qsort(h->hit, h->N, sizeof(P7_HIT *), hit_sorter_by_modelname_aliposition);
@@ -401,6 +512,265 @@ p7_tophits_SortByModelnameAndAlipos(P7_TOPHITS *h)
 }
 
 
+/* Function:  p7_tophits_SetMaxHits()
+ * Synopsis:  Keep only the best hits ("top-K" mode).
+ *
+ * Purpose:   Bound the empty hit list <h> to its <maxhits> best hits,
+ *            by sortkey; or if <maxhits> is 0, turn the bound off.
+ *
+ *            In a permissive search of a big database, most hits that
+ *            pass the pipeline would be thresholded away in the end
+ *            anyway. In top-K mode the list doesn't grow past
+ *            <maxhits> (plus one, the newest): kept hits are
+ *            organized in a heap with the worst one on top, and each
+ *            new hit either replaces it or is dropped. Pipelines ask
+ *            <p7_tophits_Admits()> first, and skip making a hit at all
+ *            when it can't make the cut. Every <maxhits> drops, the
+ *            list's arena is compacted, so memory use is bounded by
+ *            <maxhits> too. Sorting costs O(K log K), and each
+ *            candidate O(log K).
+ *
+ *            Ties in sortkey are broken the same way as in
+ *            <p7_tophits_SortBySortkey()>, so the hits that are kept
+ *            don't depend on the order hits arrive in, or on how
+ *            they're divided up among lists that are later merged
+ *            by <p7_tophits_Merge()>.
+ *
+ *            Only for lists whose sortkeys are final as hits are
+ *            made; not for nhmmer-style lists, whose E-values are
+ *            only computed after the search.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ *            <eslEINVAL> if <h> isn't empty.
+ */
+int
+p7_tophits_SetMaxHits(P7_TOPHITS *h, uint64_t maxhits)
+{
+  void *p;
+  int   status;
+
+  if (h->N > 0) ESL_EXCEPTION(eslEINVAL, "can only set a hit list's maxhits when it's empty");
+  if (maxhits > 0) ESL_RALLOC(h->heap, p, sizeof(uint64_t) * (maxhits+1));
+  h->maxhits  = maxhits;
+  h->nheap    = 0;
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+
+
+/* Function:  p7_tophits_Admits()
+ * Synopsis:  Check whether a new hit could make it into a top-K list.
+ *
+ * Purpose:   Return <TRUE> if a hit with sortkey <sortkey> could be
+ *            kept in hit list <h>; <FALSE> if <h> is a full top-K
+ *            list and the hit is worse than the worst hit it already
+ *            keeps, in which case it's counted in <h->ndropped>.
+ *            Lists without a bound admit everything.
+ *
+ *            The bound only tightens as hits accumulate, so a caller
+ *            can skip building any hit that isn't admitted.
+ */
+int
+p7_tophits_Admits(P7_TOPHITS *h, double sortkey)
+{
+  if (h->maxhits == 0 || h->nheap < h->maxhits) return TRUE;
+  if (sortkey >= h->unsrt[h->heap[0]].sortkey)   return TRUE;  /* ties are decided for real when the hit is made */
+  h->ndropped++;
+  return FALSE;
+}
+
+/* topk_worse()
+ * TRUE if hit unsrt[a] ranks below unsrt[b].
+ */
+static int
+topk_worse(const P7_TOPHITS *h, uint64_t a, uint64_t b)
+{
+  P7_HIT *ha = h->unsrt + a;
+  P7_HIT *hb = h->unsrt + b;
+  return (hit_sorter_by_sortkey(&ha, &hb) > 0);
+}
+
+static void
+topk_siftup(P7_TOPHITS *h, uint64_t i)
+{
+  uint64_t parent, tmp;
+
+  while (i > 0)
+    {
+      parent = (i-1) / 2;
+      if (! topk_worse(h, h->heap[i], h->heap[parent])) break;
+      tmp = h->heap[i]; h->heap[i] = h->heap[parent]; h->heap[parent] = tmp;
+      i   = parent;
+    }
+}
+
+static void
+topk_siftdown(P7_TOPHITS *h, uint64_t i)
+{
+  uint64_t c, tmp;
+
+  while ((c = 2*i+1) < h->nheap)
+    {
+      if (c+1 < h->nheap && topk_worse(h, h->heap[c+1], h->heap[c])) c++;
+      if (! topk_worse(h, h->heap[c], h->heap[i])) break;
+      tmp = h->heap[i]; h->heap[i] = h->heap[c]; h->heap[c] = tmp;
+      i   = c;
+    }
+}
+
+/* topk_compact()
+ * Copy everything the kept hits hold in <h>'s arena to a new arena,
+ * and free the old one with the dropped hits' leftovers in it.
+ * If we run out of memory partway, the two arenas are joined, so all
+ * hits stay valid either way.
+ */
+static int
+topk_compact(P7_TOPHITS *h)
+{
+  P7_ARENA  *old = h->arena;
+  P7_ARENA  *ar  = NULL;
+  P7_HIT    *hit;
+  P7_DOMAIN *dcl;
+  uint64_t   i;
+  int        status;
+
+  if (old == NULL) return eslOK;
+  if ((ar = p7_arena_Create(old->minblock)) == NULL) { status = eslEMEM; goto ERROR; }
+
+  for (i = 0; i < h->N; i++)
+    {
+      hit = h->unsrt + i;
+      if ((status = p7_arena_Strdup(ar, hit->name, -1, &(hit->name))) != eslOK) goto ERROR;
+      if ((status = p7_arena_Strdup(ar, hit->acc,  -1, &(hit->acc)))  != eslOK) goto ERROR;
+      if ((status = p7_arena_Strdup(ar, hit->desc, -1, &(hit->desc))) != eslOK) goto ERROR;
+      if (hit->dcl != NULL)
+	{
+	  if ((status = copy_domains(ar, hit->dcl, hit->ndom, TRUE, &dcl)) != eslOK) goto ERROR;
+	  hit->dcl = dcl;
+	}
+    }
+
+  p7_arena_Destroy(old);
+  h->arena    = ar;
+  h->nevicted = 0;
+  return eslOK;
+
+ ERROR:
+  if (ar && p7_arena_Merge(old, ar) == eslOK) p7_arena_Destroy(ar);
+  return status;
+}
+
+/* topk_settle()
+ * In a top-K list, decide the fate of the newest hit, unsrt[N-1],
+ * which the caller has finished filling in: push it on the heap;
+ * or, if the list is full, let it replace the worst kept hit, or
+ * drop it.
+ */
+static int
+topk_settle(P7_TOPHITS *h)
+{
+  uint64_t newest;
+  uint64_t worst;
+
+  if (h->maxhits == 0 || h->nheap == h->N) return eslOK;
+  newest = h->N-1;
+
+  if (h->nheap < h->maxhits)
+    {
+      h->heap[h->nheap++] = newest;
+      topk_siftup(h, h->nheap-1);
+      return eslOK;
+    }
+
+  worst = h->heap[0];
+  if (topk_worse(h, worst, newest))
+    {  /* the newest hit takes over the worst one's slot */
+      free_hit_data(h->unsrt + worst, 1, h->arena);
+      h->unsrt[worst] = h->unsrt[newest];
+      topk_siftdown(h, 0);
+    }
+  else free_hit_data(h->unsrt + newest, 1, h->arena);
+
+  h->N--;
+  h->ndropped++;
+  h->nevicted++;
+  h->is_sorted_by_sortkey = FALSE;
+  h->is_sorted_by_seqidx  = FALSE;
+  return eslOK;
+}
+
+
+/* Function:  p7_tophits_Settle()
+ * Synopsis:  Settle the newest hit in a top-K list.
+ *
+ * Purpose:   In a top-K hit list <h>, decide the fate of the newest
+ *            hit, which the caller has finished filling in: keep it,
+ *            or drop it or the worst kept hit. Every <h->maxhits>
+ *            drops, compact <h>'s arena.
+ *
+ *            This is done anyway when the next hit is made or the
+ *            list is sorted. A caller about to allocate from
+ *            <h->arena> before it makes the next hit (the search
+ *            pipeline, making alignment displays there) calls it
+ *            first, because compaction replaces the arena. Does
+ *            nothing for lists without a bound.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ */
+int
+p7_tophits_Settle(P7_TOPHITS *h)
+{
+  int status;
+
+  if ((status = topk_settle(h)) != eslOK) return status;
+  if (h->maxhits && h->nevicted >= h->maxhits) return topk_compact(h);
+  return eslOK;
+}
+
+/* topk_truncate()
+ * After a merge, a top-K list sorted by sortkey may hold more
+ * than <maxhits> hits: drop the excess, and rebuild the heap.
+ * The kept hits are repacked in sorted order, for which the
+ * heap is simply the reverse order.
+ */
+static int
+topk_truncate(P7_TOPHITS *h)
+{
+  P7_HIT  *unsrt = NULL;
+  void    *p;
+  uint64_t i;
+  int      status;
+
+  if (h->N > h->maxhits)
+    {
+      ESL_ALLOC(unsrt, sizeof(P7_HIT) * h->Nalloc);
+      for (i = h->maxhits; i < h->N; i++) free_hit_data(h->hit[i], 1, h->arena);
+      for (i = 0; i < h->maxhits; i++) { unsrt[i] = *(h->hit[i]); h->hit[i] = unsrt + i; }
+      free(h->unsrt);
+      h->unsrt     = unsrt;
+      h->ndropped += h->N - h->maxhits;
+      h->nevicted += h->N - h->maxhits;
+      h->N         = h->maxhits;
+    }
+
+  ESL_RALLOC(h->heap, p, sizeof(uint64_t) * (h->maxhits+1));
+  for (i = 0; i < h->N; i++) h->heap[i] = h->hit[h->N-1-i] - h->unsrt;
+  h->nheap = h->N;
+
+  if (h->nevicted >= h->maxhits) return topk_compact(h);
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+
+
 /* Function:  p7_tophits_Merge()
  * Synopsis:  Merge two top hits lists.
  *
@@ -410,10 +780,21 @@ p7_tophits_SortByModelnameAndAlipos(P7_TOPHITS *h)
  *            not access it further, and may as well free
  *            it immediately.
  *
+ *            <h2>'s arena blocks are handed over to <h1>'s arena,
+ *            so none of <h2>'s hit data are copied. Both lists must
+ *            own their hit data the same way, both with an arena or
+ *            both without (an empty <h1> without one simply takes
+ *            <h2>'s).
+ *
+ *            If <h1> is a top-K list, only its <h1->maxhits> best
+ *            hits are kept.
+ *
  * Returns:   <eslOK> on success.
  *
  * Throws:    <eslEMEM> on allocation failure, and
  *            both <h1> and <h2> remain valid.
+ *            <eslEINVAL> if one list has an arena and the other
+ *            doesn't.
  */
 int
 p7_tophits_Merge(P7_TOPHITS *h1, P7_TOPHITS *h2)
@@ -426,11 +807,15 @@ p7_tophits_Merge(P7_TOPHITS *h1, P7_TOPHITS *h2)
   uint64_t Nalloc = h1->N + h2->N;
   int      status;
 
-  if(h2->N <= 0) return eslOK;
+  if(h2->N <= 0) { h1->ndropped += h2->ndropped; h2->ndropped = 0; return eslOK; }
+  if ((h1->arena == NULL) != (h2->arena == NULL) && ! (h1->arena == NULL && h1->N == 0))
+    ESL_EXCEPTION(eslEINVAL, "can't merge a hit list with an arena and one without");
   
-  /* Make sure the two lists are sorted */
+  /* Make sure the two lists are sorted (which also settles top-K lists) */
   if ((status = p7_tophits_SortBySortkey(h1)) != eslOK) goto ERROR;
   if ((status = p7_tophits_SortBySortkey(h2)) != eslOK) goto ERROR;
+  h1->ndropped += h2->ndropped;
+  h2->ndropped  = 0;
 
   /* Attempt our allocations, so we fail early if we fail. 
    * Reallocating h1->unsrt screws up h1->hit, so fix it.
@@ -440,6 +825,12 @@ p7_tophits_Merge(P7_TOPHITS *h1, P7_TOPHITS *h2)
   for (i = 0; i < h1->N; i++)
     h1->hit[i] = h1->unsrt + (h1->hit[i] - ori1);
 
+  /* h2's arena moves to h1 too. (An empty h1 without an arena of
+   * its own can simply take h2's.)
+   */
+  if      (h1->arena == NULL) { h1->arena = h2->arena; h2->arena = NULL; }
+  else if ((status = p7_arena_Merge(h1->arena, h2->arena)) != eslOK) goto ERROR;
+
   /* Append h2's unsorted data array to h1. h2's data begin at <new2> */
   new2 = h1->unsrt + h1->N;
   memcpy(new2, h2->unsrt, sizeof(P7_HIT) * h2->N);
@@ -462,10 +853,12 @@ p7_tophits_Merge(P7_TOPHITS *h1, P7_TOPHITS *h2)
 
   /* Construct the new grown h1 */
   free(h1->hit);
-  h1->hit    = new_hit;
-  h1->Nalloc = Nalloc;
-  h1->N     += h2->N;
+  h1->hit       = new_hit;
+  h1->Nalloc    = Nalloc;
+  h1->N        += h2->N;
   /* and is_sorted is TRUE, as a side effect of p7_tophits_Sort() above. */
+
+  if (h1->maxhits) return topk_truncate(h1);
   return eslOK;
   
  ERROR:
@@ -587,6 +980,36 @@ p7_tophits_GetMaxShownLength(P7_TOPHITS *h)
 }
 
 
+/* free_hit_data()
+ * Free what each of the <N> hits in <hit> holds. If the hits belong
+ * to a list with an arena <ar>, the arena owns all of it, and it
+ * goes all at once with the arena; there's nothing to do.
+ */
+static void
+free_hit_data(P7_HIT *hit, uint64_t N, const P7_ARENA *ar)
+{
+  uint64_t i;
+  int      j;
+
+  if (ar != NULL) return;
+  for (i = 0; i < N; i++)
+    {
+      if (hit[i].name != NULL) free(hit[i].name);
+      if (hit[i].acc  != NULL) free(hit[i].acc);
+      if (hit[i].desc != NULL) free(hit[i].desc);
+      if (hit[i].dcl  != NULL)
+	{
+	  for (j = 0; j < hit[i].ndom; j++)
+	    {
+	      if (hit[i].dcl[j].ad             != NULL) p7_alidisplay_Destroy(hit[i].dcl[j].ad);
+	      if (hit[i].dcl[j].scores_per_pos != NULL) free(hit[i].dcl[j].scores_per_pos);
+	    }
+	  free(hit[i].dcl);
+	}
+    }
+}
+
+
 /* Function:  p7_tophits_Reuse()
  * Synopsis:  Reuse a hit list, freeing internals.
  *
@@ -598,23 +1021,14 @@ p7_tophits_GetMaxShownLength(P7_TOPHITS *h)
 int
 p7_tophits_Reuse(P7_TOPHITS *h)
 {
-  int i, j;
-
   if (h == NULL) return eslOK;
-  if (h->unsrt != NULL) 
-  {
-    for (i = 0; i < h->N; i++)
-    {
-      if (h->unsrt[i].name != NULL) free(h->unsrt[i].name);
-      if (h->unsrt[i].acc  != NULL) free(h->unsrt[i].acc);
-      if (h->unsrt[i].desc != NULL) free(h->unsrt[i].desc);
-      if (h->unsrt[i].dcl  != NULL) {
-        for (j = 0; j < h->unsrt[i].ndom; j++)
-          if (h->unsrt[i].dcl[j].ad != NULL) p7_alidisplay_Destroy(h->unsrt[i].dcl[j].ad);
-        free(h->unsrt[i].dcl);
-      }
-    }
-  }
+  if (h->unsrt != NULL) free_hit_data(h->unsrt, h->N, h->arena);
+  p7_arena_Reuse(h->arena);
+
+  h->nheap     = 0;
+  h->ndropped  = 0;
+  h->nevicted  = 0;
+
   h->N         = 0;
   h->is_sorted_by_seqidx = FALSE;
   h->is_sorted_by_sortkey = TRUE;  /* because there are 0 hits */
@@ -628,26 +1042,15 @@ p7_tophits_Reuse(P7_TOPHITS *h)
 void
 p7_tophits_Destroy(P7_TOPHITS *h)
 {
-  int i,j;
   if (h == NULL) return;
   if (h->hit   != NULL) free(h->hit);
   if (h->unsrt != NULL) 
   {
-    for (i = 0; i < h->N; i++)
-    {
-      if (h->unsrt[i].name != NULL) free(h->unsrt[i].name);
-      if (h->unsrt[i].acc  != NULL) free(h->unsrt[i].acc);
-      if (h->unsrt[i].desc != NULL) free(h->unsrt[i].desc);
-      if (h->unsrt[i].dcl  != NULL) {
-        for (j = 0; j < h->unsrt[i].ndom; j++) {
-          if (h->unsrt[i].dcl[j].ad             != NULL) p7_alidisplay_Destroy(h->unsrt[i].dcl[j].ad);
-	  if (h->unsrt[i].dcl[j].scores_per_pos != NULL) free (h->unsrt[i].dcl->scores_per_pos);
-	}
-        free(h->unsrt[i].dcl);
-      }
-    }
+    free_hit_data(h->unsrt, h->N, h->arena);
     free(h->unsrt);
   }
+  p7_arena_Destroy(h->arena);
+  if (h->heap) free(h->heap);
   free(h);
   return;
 }
@@ -662,6 +1065,22 @@ p7_tophits_Destroy(P7_TOPHITS *h)
  * 2. Standard (human-readable) output of pipeline results
  *****************************************************************/
 
+/* domain_acc()
+ * Mean posterior probability of the aligned residues of <dom>: the
+ * expected # of correctly aligned residues <oasc>, divided by the
+ * envelope length. A translated hit's envelope is in DNA coords
+ * (<iorf> set, see p7_pipeline.c) while <oasc> counts amino acids,
+ * so the envelope length is taken in codons.
+ */
+static double
+domain_acc(const P7_DOMAIN *dom)
+{
+  double Ld = 1.0 + fabs((double) (dom->jenv - dom->ienv));
+
+  if (dom->iorf) Ld /= 3.;
+  return dom->oasc / Ld;
+}
+
 /* workaround_bug_h74(): 
  * Different envelopes, identical alignment
  * 
@@ -964,6 +1383,74 @@ p7_tophits_Threshold(P7_TOPHITS *th, P7_PIPELINE *pli)
 
 
 
+/* Function:  p7_tophits_AlignDomains()
+ * Synopsis:  Make deferred alignments of reported domains.
+ *
+ * Purpose:   If the pipeline that filled hit list <th> deferred its
+ *            alignments (<pli->ddef->do_alignment> FALSE), align each
+ *            reported or included domain to the query profile <om>,
+ *            now that <p7_tophits_Threshold()> has decided which ones
+ *            those are. Domains that won't be shown are never aligned.
+ *            Other domains are left alone, so this is a no-op for a
+ *            pipeline that aligned everything.
+ *
+ *            Only for a search pipeline (<p7_SEARCH_SEQS>), where the
+ *            targets are sequences and <om> is the one query.
+ *
+ *            If <st> is non-NULL, the alignments' time and DP cells
+ *            are counted in its alignment stage; pass the pipeline's
+ *            <pli->stats> when it's timing stages.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ */
+int
+p7_tophits_AlignDomains(P7_TOPHITS *th, P7_OPROFILE *om, P7_STAGESTATS *st)
+{
+  P7_OMX    *ox1 = NULL;
+  P7_OMX    *ox2 = NULL;
+  P7_TRACE  *tr  = NULL;
+  P7_HIT    *hit;
+  P7_DOMAIN *dom;
+  uint64_t   h;
+  uint64_t   t0  = 0;
+  int        d;
+  int        status;
+
+  for (h = 0; h < th->N; h++)
+    {
+      hit = th->unsrt + h;
+      for (d = 0; d < hit->ndom; d++)
+	{
+	  dom = hit->dcl + d;
+	  if (dom->envdsq == NULL || ! (dom->is_reported || dom->is_included)) continue;
+
+	  if (tr == NULL)
+	    {  /* most lists don't need these; allocate on first use */
+	      if ((ox1 = p7_omx_Create(om->M, 400, 400)) == NULL) { status = eslEMEM; goto ERROR; }
+	      if ((ox2 = p7_omx_Create(om->M, 400, 400)) == NULL) { status = eslEMEM; goto ERROR; }
+	      if ((tr  = p7_trace_CreateWithPP())        == NULL) { status = eslEMEM; goto ERROR; }
+	    }
+	  p7_STAGE_START(st, t0);
+	  if ((status = p7_domaindef_AlignEnvelope(om, th->arena, hit->name, hit->acc, hit->desc, ox1, ox2, tr, dom)) != eslOK) goto ERROR;
+	  p7_STAGE_STOP(st, p7_STAGE_ALIGN, t0, (uint64_t) om->M * (dom->jenv - dom->ienv + 1));
+	}
+    }
+
+  p7_omx_Destroy(ox1);
+  p7_omx_Destroy(ox2);
+  p7_trace_Destroy(tr);
+  return eslOK;
+
+ ERROR:
+  p7_omx_Destroy(ox1);
+  p7_omx_Destroy(ox2);
+  p7_trace_Destroy(tr);
+  return status;
+}
+
+
 /* Function:  p7_tophits_CompareRanking()
  * Synopsis:  Compare current top hits to previous top hits ranking.
  *
@@ -1202,6 +1689,11 @@ p7_tophits_Targets(FILE *ofp, P7_TOPHITS *th, P7_PIPELINE *pli, int textw)
       if (fprintf(ofp, "\n   [No hits detected that satisfy reporting thresholds]\n") < 0)
         ESL_EXCEPTION_SYS(eslEWRITE, "per-sequence hit list: write failed");
     }
+  if (th->maxhits && th->ndropped)
+    {
+      if (fprintf(ofp, "\n   [%" PRIu64 " more hits not kept, beyond the best %" PRIu64 "]\n", th->ndropped, th->maxhits) < 0)
+        ESL_EXCEPTION_SYS(eslEWRITE, "per-sequence hit list: write failed");
+    }
   return eslOK;
 }
 
@@ -1332,7 +1824,7 @@ p7_tophits_Domains(FILE *ofp, P7_TOPHITS *th, P7_PIPELINE *pli, int textw)
 				(th->hit[h]->dcl[d].ienv == 1) ? '[' : '.',
 				(th->hit[h]->dcl[d].jenv == th->hit[h]->dcl[d].ad->L) ? ']' : '.',
 				th->hit[h]->dcl[d].ad->L,
-				(th->hit[h]->dcl[d].oasc / (1.0 + fabs((float) (th->hit[h]->dcl[d].jenv - th->hit[h]->dcl[d].ienv))))) < 0)
+				domain_acc(th->hit[h]->dcl + d)) < 0)
 		      ESL_EXCEPTION_SYS(eslEWRITE, "domain hit list: write failed");
 		  }
 		else
@@ -1365,7 +1857,7 @@ p7_tophits_Domains(FILE *ofp, P7_TOPHITS *th, P7_PIPELINE *pli, int textw)
 		      ESL_EXCEPTION_SYS(eslEWRITE, "domain hit list: write failed");						   
 		    
 		    if (fprintf(ofp, " %4.2f\n",
-				(th->hit[h]->dcl[d].oasc / (1.0 + fabs((float) (th->hit[h]->dcl[d].jenv - th->hit[h]->dcl[d].ienv))))) < 0)
+				domain_acc(th->hit[h]->dcl + d)) < 0)
 		      ESL_EXCEPTION_SYS(eslEWRITE, "domain hit list: write failed");
 		  }
             
@@ -1547,6 +2039,207 @@ p7_tophits_Alignment(const P7_TOPHITS *th, const ESL_ALPHABET *abc,
  * 3. Tabular (parsable) output of pipeline results.
  *****************************************************************/
 
+/* The tabular outputs can run to millions of lines, and formatting
+ * them field by field with fprintf() dominates the cost of writing
+ * them. TABBUF formats fields itself into a large buffer that's
+ * written out a block at a time. Its output is byte for byte what the
+ * corresponding printf() conversion gives; for the rare number it
+ * can't format exactly (a decimal rounding tie, or an extreme value)
+ * it falls back to snprintf().
+ */
+#define p7_TABBUF_SIZE 65536
+
+typedef struct {
+  FILE  *ofp;
+  char  *buf;
+  size_t n;
+  int    status;		/* eslOK, or eslEWRITE once a write has failed */
+} TABBUF;
+
+static int
+tabbuf_Open(TABBUF *tb, FILE *ofp)
+{
+  int status;
+
+  tb->ofp    = ofp;
+  tb->n      = 0;
+  tb->status = eslOK;
+  ESL_ALLOC(tb->buf, sizeof(char) * p7_TABBUF_SIZE);
+  return eslOK;
+
+ ERROR:
+  tb->buf = NULL;
+  return status;
+}
+
+static void
+tabbuf_flush(TABBUF *tb)
+{
+  if (tb->n > 0 && tb->status == eslOK && fwrite(tb->buf, sizeof(char), tb->n, tb->ofp) != tb->n) tb->status = eslEWRITE;
+  tb->n = 0;
+}
+
+/* Returns <eslOK>, or <eslEWRITE> if any write failed. */
+static int
+tabbuf_Close(TABBUF *tb)
+{
+  tabbuf_flush(tb);
+  free(tb->buf);
+  tb->buf = NULL;
+  return tb->status;
+}
+
+/* make room for <n> more chars; <n> <= p7_TABBUF_SIZE */
+static void
+tabbuf_reserve(TABBUF *tb, size_t n)
+{
+  if (tb->n + n > p7_TABBUF_SIZE) tabbuf_flush(tb);
+}
+
+static void
+tab_char(TABBUF *tb, char c)
+{
+  tabbuf_reserve(tb, 1);
+  tb->buf[tb->n++] = c;
+}
+
+/* %-*s if <left>, else %*s */
+static void
+tab_str(TABBUF *tb, const char *s, int width, int left)
+{
+  size_t len = strlen(s);
+  size_t pad = (width > 0 && (size_t) width > len) ? width - len : 0;
+
+  if (len + pad > p7_TABBUF_SIZE)
+    {  /* an enormous description: write it straight through */
+      tabbuf_flush(tb);
+      if (tb->status == eslOK && fprintf(tb->ofp, (left ? "%-*s" : "%*s"), width, s) < 0) tb->status = eslEWRITE;
+      return;
+    }
+  tabbuf_reserve(tb, len + pad);
+  if (! left) { memset(tb->buf + tb->n, ' ', pad); tb->n += pad; }
+  memcpy(tb->buf + tb->n, s, len);  tb->n += len;
+  if (left)   { memset(tb->buf + tb->n, ' ', pad); tb->n += pad; }
+}
+
+/* %*d, for any integer type */
+static void
+tab_int(TABBUF *tb, int64_t v, int width)
+{
+  char     tmp[24];
+  int      pos = 24;
+  uint64_t u   = (v < 0 ? -(uint64_t) v : (uint64_t) v);
+
+  do { tmp[--pos] = '0' + (u % 10); u /= 10; } while (u);
+  if (v < 0) tmp[--pos] = '-';
+
+  tabbuf_reserve(tb, ESL_MAX(width, 24));
+  for (; width > 24 - pos; width--) tb->buf[tb->n++] = ' ';
+  memcpy(tb->buf + tb->n, tmp + pos, 24 - pos);
+  tb->n += 24 - pos;
+}
+
+static void
+tab_fallback(TABBUF *tb, const char *fmt, int width, int prec, double x)
+{
+  tabbuf_reserve(tb, 512);
+  tb->n += snprintf(tb->buf + tb->n, 512, fmt, width, prec, x);
+}
+
+/* %*.*f, with <prec> 0..6.
+ * fl(|x| * 10^prec) is within 1e-7 of the exact product for the
+ * magnitudes we accept, so unless its fraction is that close to 0.5,
+ * it rounds the same way the exact value does.
+ */
+static void
+tab_fixed(TABBUF *tb, double x, int width, int prec)
+{
+  static const double scale[7] = { 1., 10., 100., 1000., 10000., 100000., 1000000. };
+  char     tmp[32];
+  int      pos = 32;
+  double   y, r;
+  uint64_t u;
+  int      k;
+
+  if (! isfinite(x) || fabs(x) * scale[prec] >= 1e9) { tab_fallback(tb, "%*.*f", width, prec, x); return; }
+  y = fabs(x) * scale[prec];
+  r = floor(y);
+  if (fabs(y - r - 0.5) < 1e-6) { tab_fallback(tb, "%*.*f", width, prec, x); return; }
+  if (y - r > 0.5) r += 1.0;
+
+  u = (uint64_t) r;
+  for (k = 0; k < prec; k++) { tmp[--pos] = '0' + (u % 10); u /= 10; }
+  if (prec) tmp[--pos] = '.';
+  do { tmp[--pos] = '0' + (u % 10); u /= 10; } while (u);
+  if (signbit(x)) tmp[--pos] = '-'; /* as printf: -0.04 is "-0.0" */
+
+  tabbuf_reserve(tb, ESL_MAX(width, 32));
+  for (; width > 32 - pos; width--) tb->buf[tb->n++] = ' ';
+  memcpy(tb->buf + tb->n, tmp + pos, 32 - pos);
+  tb->n += 32 - pos;
+}
+
+/* %*.2g: two significant digits, fixed or exponential notation
+ * by the C rules, trailing zeros dropped. 
+ */
+static void
+tab_g2(TABBUF *tb, double x, int width)
+{
+  char   tmp[32];
+  int    n = 0;
+  double ax = fabs(x);
+  double m, r;
+  int    e, d1, d2, k;
+
+  if (! isfinite(x) || (ax != 0. && (ax < 1e-290 || ax > 1e290))) { tab_fallback(tb, "%*.*g", width, 2, x); return; }
+
+  if (signbit(x)) tmp[n++] = '-';
+  if (ax == 0.) tmp[n++] = '0';
+  else
+    {
+      /* find m = ax / 10^(e-1), in [10,100) up to roundoff, and round it to 2 digits d1d2 */
+      e = (int) floor(log10(ax));
+      m = ax / pow(10., e-1);
+      if      (m <  10.) { m *= 10.; e--; }
+      else if (m >= 100.) { m /= 10.; e++; }
+      r = floor(m);
+      if (fabs(m - r - 0.5) < 1e-9) { tab_fallback(tb, "%*.*g", width, 2, x); return; }
+      if (m - r > 0.5) r += 1.0;
+      if (r >= 100.) { r = 10.; e++; }
+      d1 = (int) r / 10;
+      d2 = (int) r % 10;
+
+      if (e >= -4 && e < 2)
+	{
+	  if (e == 1)      { tmp[n++] = '0' + d1; tmp[n++] = '0' + d2; }
+	  else if (e == 0) { tmp[n++] = '0' + d1; if (d2) { tmp[n++] = '.'; tmp[n++] = '0' + d2; } }
+	  else {
+	    tmp[n++] = '0'; tmp[n++] = '.';
+	    for (k = -1; k > e; k--) tmp[n++] = '0';
+	    tmp[n++] = '0' + d1;
+	    if (d2) tmp[n++] = '0' + d2;
+	  }
+	}
+      else
+	{
+	  tmp[n++] = '0' + d1;
+	  if (d2) { tmp[n++] = '.'; tmp[n++] = '0' + d2; }
+	  tmp[n++] = 'e';
+	  tmp[n++] = (e < 0 ? '-' : '+');
+	  if (e < 0) e = -e;
+	  if (e >= 100) tmp[n++] = '0' + e / 100;
+	  tmp[n++] = '0' + (e / 10) % 10;
+	  tmp[n++] = '0' + e % 10;
+	}
+    }
+
+  tabbuf_reserve(tb, ESL_MAX(width, 32));
+  for (; width > n; width--) tb->buf[tb->n++] = ' ';
+  memcpy(tb->buf + tb->n, tmp, n);
+  tb->n += n;
+}
+
+
 /* Function:  p7_tophits_TabularTargets()
  * Synopsis:  Output parsable table of per-sequence hits.
  *
@@ -1571,7 +2264,9 @@ p7_tophits_TabularTargets(FILE *ofp, char *qname, char *qacc, P7_TOPHITS *th, P7
   int qaccw  = ((qacc != NULL) ? ESL_MAX(10, strlen(qacc)) : 10);
   int taccw  = ESL_MAX(10, p7_tophits_GetMaxAccessionLength(th));
   int posw   = (pli->long_targets ? ESL_MAX(7, p7_tophits_GetMaxPositionLength(th)) : 0);
+  TABBUF tb;
   int h,d;
+  int status;
 
   if (show_header)
   {
@@ -1597,56 +2292,51 @@ p7_tophits_TabularTargets(FILE *ofp, char *qname, char *qacc, P7_TOPHITS *th, P7
       }
   }
 
+  if ((status = tabbuf_Open(&tb, ofp)) != eslOK) return status;
   for (h = 0; h < th->N; h++)
     if (th->hit[h]->flags & p7_IS_REPORTED)    
     {
         d    = th->hit[h]->best_domain;
+        tab_str(&tb, th->hit[h]->name,                                         tnamew, TRUE);  tab_char(&tb, ' ');
+        tab_str(&tb, th->hit[h]->acc ? th->hit[h]->acc : "-",                  taccw,  TRUE);  tab_char(&tb, ' ');
+        tab_str(&tb, qname,                                                    qnamew, TRUE);  tab_char(&tb, ' ');
+        tab_str(&tb, (qacc != NULL && qacc[0] != '\0') ? qacc : "-",           qaccw,  TRUE);  tab_char(&tb, ' ');
         if (pli->long_targets) 
         {
-            if (fprintf(ofp, "%-*s %-*s %-*s %-*s %7d %7d %*" PRId64 " %*" PRId64 " %*" PRId64 " %*" PRId64 " %*" PRId64 " %6s %9.2g %6.1f %5.1f  %s\n",
-                tnamew, th->hit[h]->name,
-                taccw,  th->hit[h]->acc ? th->hit[h]->acc : "-",
-                qnamew, qname,
-                qaccw,  ( (qacc != NULL && qacc[0] != '\0') ? qacc : "-"),
-                th->hit[h]->dcl[d].ad->hmmfrom,
-                th->hit[h]->dcl[d].ad->hmmto,
-                posw, th->hit[h]->dcl[d].iali,
-                posw, th->hit[h]->dcl[d].jali,
-                posw, th->hit[h]->dcl[d].ienv,
-                posw, th->hit[h]->dcl[d].jenv,
-                posw, th->hit[h]->dcl[0].ad->L,
-                (th->hit[h]->dcl[d].iali < th->hit[h]->dcl[d].jali ? "   +  "  :  "   -  "),
-                exp(th->hit[h]->lnP),
-                th->hit[h]->score,
-                th->hit[h]->dcl[d].dombias * eslCONST_LOG2R, /* convert NATS to BITS at last moment */
-                th->hit[h]->desc == NULL ? "-" :  th->hit[h]->desc ) < 0)
-                  ESL_EXCEPTION_SYS(eslEWRITE, "tabular per-sequence hit list: write failed");
+            tab_int  (&tb, th->hit[h]->dcl[d].ad->hmmfrom,      7);    tab_char(&tb, ' ');
+            tab_int  (&tb, th->hit[h]->dcl[d].ad->hmmto,        7);    tab_char(&tb, ' ');
+            tab_int  (&tb, th->hit[h]->dcl[d].iali,             posw); tab_char(&tb, ' ');
+            tab_int  (&tb, th->hit[h]->dcl[d].jali,             posw); tab_char(&tb, ' ');
+            tab_int  (&tb, th->hit[h]->dcl[d].ienv,             posw); tab_char(&tb, ' ');
+            tab_int  (&tb, th->hit[h]->dcl[d].jenv,             posw); tab_char(&tb, ' ');
+            tab_int  (&tb, th->hit[h]->dcl[0].ad->L,            posw); tab_char(&tb, ' ');
+            tab_str  (&tb, (th->hit[h]->dcl[d].iali < th->hit[h]->dcl[d].jali ? "   +  "  :  "   -  "), 6, FALSE); tab_char(&tb, ' ');
+            tab_g2   (&tb, exp(th->hit[h]->lnP),                9);    tab_char(&tb, ' ');
+            tab_fixed(&tb, th->hit[h]->score,                   6, 1); tab_char(&tb, ' ');
+            tab_fixed(&tb, th->hit[h]->dcl[d].dombias * eslCONST_LOG2R, 5, 1); /* convert NATS to BITS at last moment */
+            tab_str  (&tb, "  ", 0, FALSE);
         }
         else
         {
-                if (fprintf(ofp, "%-*s %-*s %-*s %-*s %9.2g %6.1f %5.1f %9.2g %6.1f %5.1f %5.1f %3d %3d %3d %3d %3d %3d %3d %s\n",
-                tnamew, th->hit[h]->name,
-                taccw,  th->hit[h]->acc ? th->hit[h]->acc : "-",
-                qnamew, qname,
-                qaccw,  ( (qacc != NULL && qacc[0] != '\0') ? qacc : "-"),
-                exp(th->hit[h]->lnP) * pli->Z,
-                th->hit[h]->score,
-                th->hit[h]->pre_score - th->hit[h]->score, /* bias correction */
-                exp(th->hit[h]->dcl[d].lnP) * pli->Z,
-                th->hit[h]->dcl[d].bitscore,
-                th->hit[h]->dcl[d].dombias * eslCONST_LOG2R, /* convert NATS to BITS at last moment */
-                th->hit[h]->nexpected,
-                th->hit[h]->nregions,
-                th->hit[h]->nclustered,
-                th->hit[h]->noverlaps,
-                th->hit[h]->nenvelopes,
-                th->hit[h]->ndom,
-                th->hit[h]->nreported,
-                th->hit[h]->nincluded,
-                (th->hit[h]->desc == NULL ? "-" : th->hit[h]->desc)) < 0)
-                  ESL_EXCEPTION_SYS(eslEWRITE, "tabular per-sequence hit list: write failed");
+            tab_g2   (&tb, exp(th->hit[h]->lnP) * pli->Z,                  9);    tab_char(&tb, ' ');
+            tab_fixed(&tb, th->hit[h]->score,                              6, 1); tab_char(&tb, ' ');
+            tab_fixed(&tb, th->hit[h]->pre_score - th->hit[h]->score,      5, 1); tab_char(&tb, ' '); /* bias correction */
+            tab_g2   (&tb, exp(th->hit[h]->dcl[d].lnP) * pli->Z,           9);    tab_char(&tb, ' ');
+            tab_fixed(&tb, th->hit[h]->dcl[d].bitscore,                    6, 1); tab_char(&tb, ' ');
+            tab_fixed(&tb, th->hit[h]->dcl[d].dombias * eslCONST_LOG2R,    5, 1); tab_char(&tb, ' '); /* convert NATS to BITS at last moment */
+            tab_fixed(&tb, th->hit[h]->nexpected,                          5, 1); tab_char(&tb, ' ');
+            tab_int  (&tb, th->hit[h]->nregions,   3); tab_char(&tb, ' ');
+            tab_int  (&tb, th->hit[h]->nclustered, 3); tab_char(&tb, ' ');
+            tab_int  (&tb, th->hit[h]->noverlaps,  3); tab_char(&tb, ' ');
+            tab_int  (&tb, th->hit[h]->nenvelopes, 3); tab_char(&tb, ' ');
+            tab_int  (&tb, th->hit[h]->ndom,       3); tab_char(&tb, ' ');
+            tab_int  (&tb, th->hit[h]->nreported,  3); tab_char(&tb, ' ');
+            tab_int  (&tb, th->hit[h]->nincluded,  3); tab_char(&tb, ' ');
         }
+        tab_str (&tb, (th->hit[h]->desc == NULL ? "-" : th->hit[h]->desc), 0, FALSE);
+        tab_char(&tb, '\n');
     }
+  if (tabbuf_Close(&tb) != eslOK) ESL_EXCEPTION_SYS(eslEWRITE, "tabular per-sequence hit list: write failed");
   return eslOK;
 }
 
@@ -1676,7 +2366,9 @@ p7_tophits_TabularDomains(FILE *ofp, char *qname, char *qacc, P7_TOPHITS *th, P7
   int qaccw  = (qacc ? ESL_MAX(10, strlen(qacc)) : 10);
   int taccw  = ESL_MAX(10, p7_tophits_GetMaxAccessionLength(th));
   int tlen, qlen;
+  TABBUF tb;
   int h,d,nd;
+  int status;
 
   if (show_header)
     {
@@ -1690,6 +2382,7 @@ p7_tophits_TabularDomains(FILE *ofp, char *qname, char *qacc, P7_TOPHITS *th, P7
            ESL_EXCEPTION_SYS(eslEWRITE, "tabular per-domain hit list: write failed");
     }
 
+  if ((status = tabbuf_Open(&tb, ofp)) != eslOK) return status;
   for (h = 0; h < th->N; h++)
     if (th->hit[h]->flags & p7_IS_REPORTED)
     {
@@ -1707,36 +2400,33 @@ p7_tophits_TabularDomains(FILE *ofp, char *qname, char *qacc, P7_TOPHITS *th, P7
               if (pli->mode == p7_SEARCH_SEQS) { qlen = th->hit[h]->dcl[d].ad->M; tlen = th->hit[h]->dcl[d].ad->L;  }
               else                             { qlen = th->hit[h]->dcl[d].ad->L; tlen = th->hit[h]->dcl[d].ad->M;  }
 
-
-
-              if (fprintf(ofp, "%-*s %-*s %5d %-*s %-*s %5d %9.2g %6.1f %5.1f %3d %3d %9.2g %9.2g %6.1f %5.1f %5d %5d %5" PRId64 " %5" PRId64 " %5" PRId64 " %5" PRId64 " %4.2f %s\n",
-                tnamew, th->hit[h]->name,
-                taccw,  th->hit[h]->acc ? th->hit[h]->acc : "-",
-                tlen,
-                qnamew, qname,
-                qaccw,  ( (qacc != NULL && qacc[0] != '\0') ? qacc : "-"),
-                qlen,
-                exp(th->hit[h]->lnP) * pli->Z,
-                th->hit[h]->score,
-                th->hit[h]->pre_score - th->hit[h]->score, /* bias correction */
-                nd,
-                th->hit[h]->nreported,
-                exp(th->hit[h]->dcl[d].lnP) * pli->domZ,
-                exp(th->hit[h]->dcl[d].lnP) * pli->Z,
-                th->hit[h]->dcl[d].bitscore,
-                th->hit[h]->dcl[d].dombias * eslCONST_LOG2R, /* NATS to BITS at last moment */
-                th->hit[h]->dcl[d].ad->hmmfrom,
-                th->hit[h]->dcl[d].ad->hmmto,
-                th->hit[h]->dcl[d].ad->sqfrom,
-                th->hit[h]->dcl[d].ad->sqto,
-                th->hit[h]->dcl[d].ienv,
-                th->hit[h]->dcl[d].jenv,
-                (th->hit[h]->dcl[d].oasc / (1.0 + fabs((float) (th->hit[h]->dcl[d].jenv - th->hit[h]->dcl[d].ienv)))),
-                (th->hit[h]->desc ?  th->hit[h]->desc : "-")) < 0)
-                  ESL_EXCEPTION_SYS(eslEWRITE, "tabular per-domain hit list: write failed");
-
+              tab_str  (&tb, th->hit[h]->name,                                  tnamew, TRUE); tab_char(&tb, ' ');
+              tab_str  (&tb, th->hit[h]->acc ? th->hit[h]->acc : "-",           taccw,  TRUE); tab_char(&tb, ' ');
+              tab_int  (&tb, tlen,                                              5);            tab_char(&tb, ' ');
+              tab_str  (&tb, qname,                                             qnamew, TRUE); tab_char(&tb, ' ');
+              tab_str  (&tb, (qacc != NULL && qacc[0] != '\0') ? qacc : "-",    qaccw,  TRUE); tab_char(&tb, ' ');
+              tab_int  (&tb, qlen,                                              5);            tab_char(&tb, ' ');
+              tab_g2   (&tb, exp(th->hit[h]->lnP) * pli->Z,                     9);            tab_char(&tb, ' ');
+              tab_fixed(&tb, th->hit[h]->score,                                 6, 1);         tab_char(&tb, ' ');
+              tab_fixed(&tb, th->hit[h]->pre_score - th->hit[h]->score,         5, 1);         tab_char(&tb, ' '); /* bias correction */
+              tab_int  (&tb, nd,                                                3);            tab_char(&tb, ' ');
+              tab_int  (&tb, th->hit[h]->nreported,                             3);            tab_char(&tb, ' ');
+              tab_g2   (&tb, exp(th->hit[h]->dcl[d].lnP) * pli->domZ,           9);            tab_char(&tb, ' ');
+              tab_g2   (&tb, exp(th->hit[h]->dcl[d].lnP) * pli->Z,              9);            tab_char(&tb, ' ');
+              tab_fixed(&tb, th->hit[h]->dcl[d].bitscore,                       6, 1);         tab_char(&tb, ' ');
+              tab_fixed(&tb, th->hit[h]->dcl[d].dombias * eslCONST_LOG2R,       5, 1);         tab_char(&tb, ' '); /* NATS to BITS at last moment */
+              tab_int  (&tb, th->hit[h]->dcl[d].ad->hmmfrom,                    5);            tab_char(&tb, ' ');
+              tab_int  (&tb, th->hit[h]->dcl[d].ad->hmmto,                      5);            tab_char(&tb, ' ');
+              tab_int  (&tb, th->hit[h]->dcl[d].ad->sqfrom,                     5);            tab_char(&tb, ' ');
+              tab_int  (&tb, th->hit[h]->dcl[d].ad->sqto,                       5);            tab_char(&tb, ' ');
+              tab_int  (&tb, th->hit[h]->dcl[d].ienv,                           5);            tab_char(&tb, ' ');
+              tab_int  (&tb, th->hit[h]->dcl[d].jenv,                           5);            tab_char(&tb, ' ');
+              tab_fixed(&tb, domain_acc(th->hit[h]->dcl + d), 4, 2); tab_char(&tb, ' ');
+              tab_str  (&tb, (th->hit[h]->desc ?  th->hit[h]->desc : "-"), 0, FALSE);
+              tab_char (&tb, '\n');
           }
       }
+  if (tabbuf_Close(&tb) != eslOK) ESL_EXCEPTION_SYS(eslEWRITE, "tabular per-domain hit list: write failed");
   return eslOK;
 }
 
@@ -1863,7 +2553,7 @@ p7_tophits_TabularXfam(FILE *ofp, char *qname, char *qacc, P7_TOPHITS *th, P7_PI
             {
               p7_tophits_CreateNextHit(domHitlist, &domhit);
               ndomReported++;
-              ESL_ALLOC(domhit->dcl, sizeof(P7_DOMAIN) );
+              if ((domhit->dcl = p7_arena_Alloc(domHitlist->arena, sizeof(P7_DOMAIN))) == NULL) { status = eslEMEM; goto ERROR; }
 
               domhit->ndom       = ndomReported;  // re-using this variable to track the ordinal value of the domain in the original hit list that generated this pseudo-hit
               domhit->name       = th->hit[h]->name;
@@ -1905,19 +2595,12 @@ p7_tophits_TabularXfam(FILE *ofp, char *qname, char *qacc, P7_TOPHITS *th, P7_PI
               (domhit->desc ?  domhit->desc : "-")) < 0)
                 ESL_XEXCEPTION_SYS(eslEWRITE, "xfam tabular output: write failed");
       }
-      free (domHitlist->unsrt);
-      free (domHitlist->hit);
-      free (domHitlist);
+      p7_tophits_Destroy(domHitlist);  /* names are borrowed from <th>; the arena holds only the domain copies */
   }
   return eslOK;
 
  ERROR:
-  if (domHitlist) 
-  {
-      free (domHitlist->unsrt);
-      free (domHitlist->hit);
-      free (domHitlist);
-  }
+  p7_tophits_Destroy(domHitlist);
   return status;
 }
 
@@ -2155,6 +2838,107 @@ static ESL_OPTIONS options[] = {
 static char usage[]  = "[-options]";
 static char banner[] = "test driver for P7_TOPHITS";
 
+/* utest_topk()
+ * Spread N random hits over three top-K lists, merge them, and make
+ * sure we kept exactly the K best, as a full sort of all N says.
+ * With N >> K, this also exercises arena compaction.
+ */
+static void
+utest_topk(ESL_RANDOMNESS *r, int N, int K)
+{
+  char        msg[]  = "top-K unit test failed";
+  P7_TOPHITS *full   = p7_tophits_Create();
+  P7_TOPHITS *th[3];
+  int        *perm   = malloc(sizeof(int) * N);
+  double      key;
+  char        name[32];
+  int         i, j, tmp;
+
+  for (i = 0; i < 3; i++) {
+    th[i] = p7_tophits_Create();
+    if (p7_tophits_SetMaxHits(th[i], K) != eslOK) esl_fatal(msg);
+  }
+
+  /* distinct keys in random order; ties would need domain coords to break */
+  if (perm == NULL) esl_fatal(msg);
+  for (i = 0; i < N; i++) perm[i] = i;
+  for (i = N-1; i > 0; i--) { j = esl_rnd_Roll(r, i+1); tmp = perm[i]; perm[i] = perm[j]; perm[j] = tmp; }
+
+  for (i = 0; i < N; i++)
+    {
+      key = (double) perm[i];
+      snprintf(name, 32, "%.0f", key);
+      p7_tophits_Add(full, name, NULL, NULL, key, (float) key, key, (float) key, key, i, i, N, i, i, N, 1, 1, NULL);
+      if (p7_tophits_Admits(th[i%3], key))
+	p7_tophits_Add(th[i%3], name, NULL, NULL, key, (float) key, key, (float) key, key, i, i, N, i, i, N, 1, 1, NULL);
+    }
+
+  p7_tophits_Merge(th[0], th[1]);
+  p7_tophits_Merge(th[0], th[2]);
+  p7_tophits_SortBySortkey(th[0]);
+  p7_tophits_SortBySortkey(full);
+
+  if (th[0]->N        != ESL_MIN(N, K))         esl_fatal(msg);
+  if (th[0]->ndropped != N - th[0]->N)          esl_fatal(msg);
+  for (i = 0; i < th[0]->N; i++)
+    {
+      if (th[0]->hit[i]->sortkey != full->hit[i]->sortkey) esl_fatal(msg);
+      snprintf(name, 32, "%.0f", th[0]->hit[i]->sortkey);
+      if (strcmp(th[0]->hit[i]->name, name) != 0)          esl_fatal(msg);
+    }
+
+  for (i = 0; i < 3; i++) p7_tophits_Destroy(th[i]);
+  p7_tophits_Destroy(full);
+  free(perm);
+}
+
+/* utest_tabfmt()
+ * The tabular output's own field formatting must match printf()
+ * exactly, including rounding ties, signed zeros, and the switch
+ * between fixed and exponential notation in %g.
+ */
+static void
+check_tabfmt(TABBUF *tb, const char *expect, const char *fmt, double x)
+{
+  tb->buf[tb->n] = '\0';
+  if (strcmp(tb->buf, expect) != 0) esl_fatal("tabular format %s of %.17g: got \"%s\", expected \"%s\"", fmt, x, tb->buf, expect);
+  tb->n = 0;
+}
+
+static void
+utest_tabfmt(ESL_RANDOMNESS *r, int N)
+{
+  double  special[] = { 0., -0., 1., 10., 100., 9.95, 99.5, 0.125, 0.25, 2.5, 0.05, -0.04, 0.35, 1e-4, 9.96e-5, 1e-5, 1.5e-5,
+			1e-99, 1e-100, 9.99e99, 1e-300, 1e300, 123456.75, 1e12, -7.25 };
+  int     nspecial  = sizeof(special) / sizeof(double);
+  char    expect[512];
+  TABBUF  tb;
+  double  x;
+  int64_t v;
+  int     i;
+
+  if (tabbuf_Open(&tb, NULL) != eslOK) esl_fatal("tabbuf_Open() failed");
+
+  for (i = 0; i < nspecial + N; i++)
+    {
+      if      (i < nspecial) x = special[i];
+      else if (i % 3 == 0)   x = exp(-700. * esl_random(r)) * pow(10., esl_rnd_Roll(r, 20)); /* E-values   */
+      else if (i % 3 == 1)   x = (float) ((esl_random(r) - 0.5) * 2000.);                  /* bit scores */
+      else                   x = esl_rnd_Roll(r, 1000) / 1000.;                             /* acc; ties  */
+
+      tab_g2   (&tb, x, 9);    snprintf(expect, 512, "%9.2g", x); check_tabfmt(&tb, expect, "%9.2g", x);
+      tab_fixed(&tb, x, 6, 1); snprintf(expect, 512, "%6.1f", x); check_tabfmt(&tb, expect, "%6.1f", x);
+      tab_fixed(&tb, x, 4, 2); snprintf(expect, 512, "%4.2f", x); check_tabfmt(&tb, expect, "%4.2f", x);
+
+      v = (int64_t) esl_rnd_Roll(r, 2000000) - 1000000;
+      tab_int(&tb, v, 7);      snprintf(expect, 512, "%7" PRId64, v); check_tabfmt(&tb, expect, "%7d", (double) v);
+    }
+  tab_str(&tb, "abc", 5, TRUE);  check_tabfmt(&tb, "abc  ", "%-5s", 0.);
+  tab_str(&tb, "abc", 5, FALSE); check_tabfmt(&tb, "  abc", "%5s",  0.);
+  tab_str(&tb, "abc", 0, FALSE); check_tabfmt(&tb, "abc",   "%s",   0.);
+  tabbuf_Close(&tb);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -2199,6 +2983,12 @@ main(int argc, char **argv)
   if (strcmp(h3->hit[3*N+1]->name, "last")  != 0) esl_fatal("after merge 2, sort failed (last is %s = %f)", h3->hit[3*N+1]->name,     h3->hit[3*N+1]->sortkey);
   
   if (p7_tophits_GetMaxNameLength(h3) != strlen(name)) esl_fatal("GetMaxNameLength() failed");
+  utest_topk(r, N,    10);
+  utest_topk(r, 10*N, N);
+  utest_topk(r, 5,    N);
+  utest_tabfmt(r, N);
+  for (i = 0; i < 3*N+2; i++)
+    if (! p7_arena_Owns(h3->arena, h3->hit[i]->name)) esl_fatal("after merge 2, hit %d name not in merged arena", i);
 
   p7_tophits_Destroy(h1);
   p7_tophits_Destroy(h2);
@@ -1452,6 +1452,34 @@ p7_trace_Doctor(P7_TRACE *tr, int *opt_ndi, int *opt_nid)
  */
 int
 p7_trace_Count(P7_HMM *hmm, ESL_DSQ *dsq, float wt, P7_TRACE *tr)
+{
+  return p7_trace_CountBand(hmm, dsq, wt, tr, 0, hmm->M, 0, tr->N-1);
+}
+
+
+/* Function: p7_trace_CountBand()
+ * 
+ * Purpose:  Same as <p7_trace_Count()>, but only accumulate counts
+ *           into the nodes <ka..kb> of <hmm> (the mat[k], ins[k], and
+ *           t[k] rows), where $0 \leq ka \leq kb \leq M$. Counts
+ *           in other nodes are left untouched.
+ *
+ *           Counting the same traces, in the same order, into
+ *           disjoint bands that cover 0..M gives the same result as
+ *           <p7_trace_Count()>, down to the last bit; this is how
+ *           model construction divides the counting amongst threads.
+ *
+ *           Only trace positions <za..zb> are visited; pass <0> and
+ *           <tr->N-1> to visit all of them. A caller that knows
+ *           where nodes <ka..kb> lie in <tr> can narrow this, so
+ *           long as no state outside <za..zb> counts into the band.
+ *
+ * Return:   <eslOK> on success.
+ *
+ * Throws:   <eslEINVAL> if something's corrupt in the trace.
+ */
+int
+p7_trace_CountBand(P7_HMM *hmm, ESL_DSQ *dsq, float wt, P7_TRACE *tr, int ka, int kb, int za, int zb)
 {
   int z;			/* position index in trace */
   int i;			/* symbol position in seq */
@@ -1488,6 +1516,8 @@ p7_trace_Count(P7_HMM *hmm, ESL_DSQ *dsq, float wt, P7_TRACE *tr)
     for (z = tr->N-3; z > 0; z--)
       if (tr->st[z] == p7T_M) { z2 = z; break; }
 
+  z1 = ESL_MAX(z1, za);
+  z2 = ESL_MIN(z2, zb+1);
   for (z = z1; z < z2; z++) 
     {
       if (tr->st[z] == p7T_X) continue; /* skip missing data */
@@ -1499,6 +1529,12 @@ p7_trace_Count(P7_HMM *hmm, ESL_DSQ *dsq, float wt, P7_TRACE *tr)
       k2  = tr->k[z+1];
       i   = tr->i[z];
 
+      /* A state outside our band of nodes only counts into other nodes;
+       * except B (node 0), whose wing-retracted B->DD->Mk path can reach
+       * into the band.
+       */
+      if ((k < ka || k > kb) && st != p7T_B) continue;
+
       /* Emission counts. */
       if      (st == p7T_M) esl_abc_FCount(hmm->abc, hmm->mat[k], dsq[i], wt);
       else if (st == p7T_I) esl_abc_FCount(hmm->abc, hmm->ins[k], dsq[i], wt);
@@ -1509,11 +1545,12 @@ p7_trace_Count(P7_HMM *hmm, ESL_DSQ *dsq, float wt, P7_TRACE *tr)
       if (st == p7T_B) {
 	if (st2 == p7T_M && k2 > 1)   /* wing-retracted B->DD->Mk path */
 	  {
-	    hmm->t[0][p7H_MD] += wt;                
-	    for (ktmp = 1; ktmp < k2-1; ktmp++) 
+	    if (ka == 0) hmm->t[0][p7H_MD] += wt;                
+	    for (ktmp = ESL_MAX(1, ka); ktmp < k2-1 && ktmp <= kb; ktmp++) 
 	      hmm->t[ktmp][p7H_DD] += wt;
-	    hmm->t[ktmp][p7H_DM] += wt;
+	    if (k2-1 >= ka && k2-1 <= kb) hmm->t[k2-1][p7H_DM] += wt;
 	  }
+	else if (ka > 0) continue;
 	else  {
 	  switch (st2) {
 	  case p7T_M: hmm->t[0][p7H_MM] += wt; break;
@@ -62,7 +62,10 @@ static ESL_OPTIONS options[] = {
   { "-A",           eslARG_OUTFILE,      NULL, NULL, NULL,      NULL,  NULL,  NULL,              "save multiple alignment of hits to file <f>",                  2 },
   { "--tblout",     eslARG_OUTFILE,      NULL, NULL, NULL,      NULL,  NULL,  NULL,              "save parseable table of per-sequence hits to file <f>",        2 },
   { "--domtblout",  eslARG_OUTFILE,      NULL, NULL, NULL,      NULL,  NULL,  NULL,              "save parseable table of per-domain hits to file <f>",          2 },
+  { "--hitout",     eslARG_OUTFILE,      NULL, NULL, NULL,      NULL,  NULL,  NULL,              "save hits in compact binary format to file <f>",               2 },
   { "--pfamtblout", eslARG_OUTFILE,      NULL, NULL, NULL,      NULL,  NULL,  NULL,              "save table of hits and domains to file, in Pfam format <f>",   2 },
+  { "--statsout",   eslARG_OUTFILE,      NULL, NULL, NULL,      NULL,  NULL,  NULL,              "save per-query search statistics as JSON lines to file <f>",   2 },
+  { "--progress",   eslARG_REAL,         NULL, NULL, "x>0",     NULL,"--statsout", NULL,         "add a progress record to --statsout file every <x> seconds",   2 },
   { "--acc",        eslARG_NONE,        FALSE, NULL, NULL,      NULL,  NULL,  NULL,              "prefer accessions over names in output",                       2 },
   { "--noali",      eslARG_NONE,        FALSE, NULL, NULL,      NULL,  NULL,  NULL,              "don't output alignments, so output is smaller",                2 },
   { "--notextw",    eslARG_NONE,         NULL, NULL, NULL,      NULL,  NULL, "--textw",          "unlimit ASCII text output line width",                         2 },
@@ -77,6 +80,7 @@ static ESL_OPTIONS options[] = {
   { "-T",           eslARG_REAL,        FALSE, NULL,  NULL,     NULL,  NULL,  REPOPTS,           "report sequences >= this score threshold in output",           4 },
   { "--domE",       eslARG_REAL,       "10.0", NULL, "x>0",     NULL,  NULL,  DOMREPOPTS,        "report domains <= this E-value threshold in output",           4 },
   { "--domT",       eslARG_REAL,        FALSE, NULL,  NULL,     NULL,  NULL,  DOMREPOPTS,        "report domains >= this score cutoff in output",                4 },
+  { "--max-hits",   eslARG_INT,          NULL, NULL,  "n>0",    NULL,  NULL,  NULL,              "keep only the <n> best-scoring hits (saves memory)",           4 },
 /* Control of inclusion thresholds */
   { "--incE",       eslARG_REAL,       "0.01", NULL, "x>0",     NULL,  NULL,  INCOPTS,           "consider sequences <= this E-value threshold as significant",  5 },
   { "--incT",       eslARG_REAL,        FALSE, NULL,  NULL,     NULL,  NULL,  INCOPTS,           "consider sequences >= this score threshold as significant",    5 },
@@ -102,6 +106,8 @@ static ESL_OPTIONS options[] = {
   { "--Eft",        eslARG_REAL,       "0.04", NULL,"0<x<1",    NULL,  NULL,  NULL,              "tail mass for Forward exponential tail tau fit",              11 },   
 /* other options */
   { "--nonull2",    eslARG_NONE,        NULL,  NULL, NULL,      NULL,  NULL,  NULL,              "turn off biased composition score corrections",               12 },
+  { "--nosample",   eslARG_NONE,        NULL,  NULL, NULL,      NULL,  NULL,  NULL,              "split domains by posterior decoding, not sampling",           12 },
+  { "--stagestats", eslARG_NONE,        NULL,  NULL, NULL,      NULL,  NULL,  NULL,              "time each pipeline stage, and count its DP cells",            12 },
   { "-Z",           eslARG_REAL,       FALSE, NULL, "x>0",     NULL,  NULL,  NULL,              "set # of comparisons done, for E-value calculation",          12 },
   { "--domZ",       eslARG_REAL,       FALSE, NULL, "x>0",     NULL,  NULL,  NULL,              "set # of significant seqs, for domain E-value calculation",   12 },
   { "--seed",       eslARG_INT,         "42",  NULL, "n>=0",    NULL,  NULL,  NULL,              "set RNG seed to <n> (if 0: one-time arbitrary seed)",         12 },
@@ -147,12 +153,12 @@ struct cfg_s {
 };
 
 static int  serial_master(ESL_GETOPTS *go, struct cfg_s *cfg);
-static int  serial_loop  (WORKER_INFO *info, ESL_SQFILE *dbfp, int n_targetseqs);
+static int  serial_loop  (WORKER_INFO *info, ESL_SQFILE *dbfp, int n_targetseqs, P7_PROGRESS *prg);
 
 #ifdef HMMER_THREADS
 #define BLOCK_SIZE 1000
 
-static int  thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, int n_targetseqs);
+static int  thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, int n_targetseqs, P7_PROGRESS *prg);
 static void pipeline_thread(void *arg);
 #endif 
 
@@ -242,7 +248,10 @@ output_header(FILE *ofp, ESL_GETOPTS *go, char *qfile, char *dbfile)
   if (esl_opt_IsUsed(go, "-A")          && fprintf(ofp, "# MSA of hits saved to file:       %s\n",             esl_opt_GetString(go, "-A"))          < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--tblout")    && fprintf(ofp, "# per-seq hits tabular output:     %s\n",             esl_opt_GetString(go, "--tblout"))    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--domtblout") && fprintf(ofp, "# per-dom hits tabular output:     %s\n",             esl_opt_GetString(go, "--domtblout")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--hitout")    && fprintf(ofp, "# binary hit output:               %s\n",             esl_opt_GetString(go, "--hitout")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--pfamtblout")&& fprintf(ofp, "# pfam-style tabular hit output:   %s\n",             esl_opt_GetString(go, "--pfamtblout")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--statsout")  && fprintf(ofp, "# JSON search statistics output:   %s\n",             esl_opt_GetString(go, "--statsout"))  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--progress")  && fprintf(ofp, "# progress records every:          %g sec\n",         esl_opt_GetReal(go, "--progress"))    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--acc")       && fprintf(ofp, "# prefer accessions over names:    yes\n")                                                  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--noali")     && fprintf(ofp, "# show alignments in output:       no\n")                                                   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--notextw")   && fprintf(ofp, "# max ASCII text line length:      unlimited\n")                                            < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
@@ -255,6 +264,7 @@ output_header(FILE *ofp, ESL_GETOPTS *go, char *qfile, char *dbfile)
   if (esl_opt_IsUsed(go, "-T")          && fprintf(ofp, "# sequence reporting threshold:    score >= %g\n",    esl_opt_GetReal(go, "-T"))            < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--domE")      && fprintf(ofp, "# domain reporting threshold:      E-value <= %g\n",  esl_opt_GetReal(go, "--domE"))        < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--domT")      && fprintf(ofp, "# domain reporting threshold:      score >= %g\n",    esl_opt_GetReal(go, "--domT"))        < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--max-hits")  && fprintf(ofp, "# max hits kept:                   %d\n",             esl_opt_GetInteger(go, "--max-hits")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--incE")      && fprintf(ofp, "# sequence inclusion threshold:    E-value <= %g\n",  esl_opt_GetReal(go, "--incE"))        < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--incT")      && fprintf(ofp, "# sequence inclusion threshold:    score >= %g\n",    esl_opt_GetReal(go, "--incT"))        < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--incdomE")   && fprintf(ofp, "# domain inclusion threshold:      E-value <= %g\n",  esl_opt_GetReal(go, "--incdomE"))     < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
@@ -272,6 +282,7 @@ output_header(FILE *ofp, ESL_GETOPTS *go, char *qfile, char *dbfile)
   if (esl_opt_IsUsed(go, "--ssifile")          && fprintf(ofp, "# Override ssi file to:            %s\n",            esl_opt_GetString(go, "--ssifile"))       < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 
   if (esl_opt_IsUsed(go, "--nonull2")   && fprintf(ofp, "# null2 bias corrections:          off\n")                                                  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--nosample")  && fprintf(ofp, "# multidomain envelopes:           posterior decoding\n")                                   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--EmL")       && fprintf(ofp, "# seq length, MSV Gumbel mu fit:   %d\n",             esl_opt_GetInteger(go, "--EmL"))      < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--EmN")       && fprintf(ofp, "# seq number, MSV Gumbel mu fit:   %d\n",             esl_opt_GetInteger(go, "--EmN"))      < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--EvL")       && fprintf(ofp, "# seq length, Vit Gumbel mu fit:   %d\n",             esl_opt_GetInteger(go, "--EvL"))      < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
@@ -383,7 +394,10 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   FILE            *afp      = NULL;               /* alignment output file (-A option)                */
   FILE            *tblfp    = NULL;		  /* output stream for tabular per-seq (--tblout)     */
   FILE            *domtblfp = NULL;		  /* output stream for tabular per-seq (--domtblout)  */
+  FILE            *hitfp    = NULL;		  /* output stream for binary hit output (--hitout)   */
   FILE            *pfamtblfp= NULL;              /* output stream for pfam tabular output (--pfamtblout)    */
+  FILE            *statsfp  = NULL;               /* JSON lines of search statistics (--statsout)     */
+  P7_PROGRESS     *prg      = NULL;               /* periodic progress records (--progress)           */
   int              qformat  = eslSQFILE_UNKNOWN;  /* format of qfile                                  */
   ESL_SQFILE      *qfp      = NULL;		  /* open qfile                                       */
   ESL_SQ          *qsq      = NULL;               /* query sequence                                   */
@@ -393,6 +407,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   P7_BG           *bg       = NULL;		  /* null model (copies made of this into threads)    */
   P7_BUILDER      *bld      = NULL;               /* HMM construction configuration                   */
   ESL_STOPWATCH   *w        = NULL;               /* for timing                                       */
+  P7_STAGESTATS    stagestats;                    /* per-stage totals over all queries (--stagestats) */
   int              nquery   = 0;
   int              seed;
   int              textw;
@@ -407,11 +422,13 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   ESL_SQ_BLOCK    *block    = NULL;
   ESL_THREADS     *threadObj= NULL;
   ESL_WORK_QUEUE  *queue    = NULL;
+  P7_DOMAINPOOL   *ddpool   = NULL;
 #endif
 
   /* Initializations */
   abc     = esl_alphabet_Create(eslAMINO);
   w       = esl_stopwatch_Create();
+  p7_stagestats_Zero(&stagestats);
   textw   = (esl_opt_GetBoolean(go, "--notextw") ? 0 : esl_opt_GetInteger(go, "--textw"));
   bg      = p7_bg_Create(abc);
 
@@ -452,7 +469,10 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (esl_opt_IsOn(go, "-A"))          { if ((afp      = fopen(esl_opt_GetString(go, "-A"),          "w")) == NULL)  p7_Fail("Failed to open alignment output file %s for writing\n",       esl_opt_GetString(go, "-A")); } 
   if (esl_opt_IsOn(go, "--tblout"))    { if ((tblfp    = fopen(esl_opt_GetString(go, "--tblout"),    "w")) == NULL)  p7_Fail("Failed to open tabular per-seq output file %s for writing\n", esl_opt_GetString(go, "--tblfp")); }
   if (esl_opt_IsOn(go, "--domtblout")) { if ((domtblfp = fopen(esl_opt_GetString(go, "--domtblout"), "w")) == NULL)  p7_Fail("Failed to open tabular per-dom output file %s for writing\n", esl_opt_GetString(go, "--domtblfp")); }
+  if (esl_opt_IsOn(go, "--hitout"))    { if ((hitfp    = fopen(esl_opt_GetString(go, "--hitout"),    "wb")) == NULL)  p7_Fail("Failed to open binary hit output file %s for writing\n", esl_opt_GetString(go, "--hitout")); p7_hitfile_WriteMagic(hitfp); }
   if (esl_opt_IsOn(go, "--pfamtblout")){ if ((pfamtblfp = fopen(esl_opt_GetString(go, "--pfamtblout"), "w")) == NULL)  esl_fatal("Failed to open pfam-style tabular output file %s for writing\n", esl_opt_GetString(go, "--pfamtblout")); }
+  if (esl_opt_IsOn(go, "--statsout"))  { if ((statsfp  = fopen(esl_opt_GetString(go, "--statsout"),  "w")) == NULL)  esl_fatal("Failed to open JSON statistics output file %s for writing\n", esl_opt_GetString(go, "--statsout")); }
+  if (esl_opt_IsOn(go, "--progress"))  { if ((prg = p7_progress_Create(statsfp, "phmmer", esl_opt_GetReal(go, "--progress"), cfg->dbfile)) == NULL) p7_Fail("Failed to create progress reporter"); }
 
   /* Open the target sequence database for sequential access. */
   status =  esl_sqfile_OpenDigital(abc, cfg->dbfile, dbformat, p7_SEQDBENV, &dbfp);
@@ -485,6 +505,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
     {
       threadObj = esl_threads_Create(&pipeline_thread);
       queue = esl_workqueue_Create(ncpus * 2);
+      if ((ddpool = p7_domainpool_Create(ncpus)) == NULL) p7_Fail("Failed to create domain definition threads");
     }
 #endif
 
@@ -560,8 +581,13 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
       {
         /* Create processing pipeline and hit list */
         info[i].th  = p7_tophits_Create();
+        if (esl_opt_IsOn(go, "--max-hits")) p7_tophits_SetMaxHits(info[i].th, esl_opt_GetInteger(go, "--max-hits"));
         info[i].om  = p7_oprofile_Clone(om);
         info[i].pli = p7_pipeline_Create(go, om->M, 100, FALSE, p7_SEARCH_SEQS); /* L_hint = 100 is just a dummy for now */
+#ifdef HMMER_THREADS
+        info[i].pli->ddef->pool = ddpool;
+#endif
+        info[i].pli->ddef->do_alignment = FALSE; /* reported domains are aligned after thresholding */
         p7_pli_NewModel(info[i].pli, info[i].om, info[i].bg);
 
 #ifdef HMMER_THREADS
@@ -569,11 +595,13 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 #endif
       }
 
+      if (prg) p7_progress_Start(prg, qsq->name);
+
 #ifdef HMMER_THREADS
-      if (ncpus > 0) sstatus = thread_loop(threadObj, queue, dbfp, cfg->n_targetseq);
-      else           sstatus = serial_loop(info, dbfp, cfg->n_targetseq);
+      if (ncpus > 0) sstatus = thread_loop(threadObj, queue, dbfp, cfg->n_targetseq, prg);
+      else           sstatus = serial_loop(info, dbfp, cfg->n_targetseq, prg);
 #else
-      sstatus = serial_loop(info, dbfp, cfg->n_targetseq);
+      sstatus = serial_loop(info, dbfp, cfg->n_targetseq, prg);
 #endif
       switch(sstatus)
       {
@@ -604,15 +632,19 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
       /* Print the results.  */
       p7_tophits_SortBySortkey(info->th);
       p7_tophits_Threshold(info->th, info->pli);
+      if (p7_tophits_AlignDomains(info->th, info->om, info->pli->do_stagestats ? &(info->pli->stats) : NULL) != eslOK) p7_Fail("Failed to align reported domains");
       p7_tophits_Targets(ofp, info->th, info->pli, textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
       p7_tophits_Domains(ofp, info->th, info->pli, textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   
       if (tblfp)     p7_tophits_TabularTargets(tblfp,    qsq->name, qsq->acc, info->th, info->pli, (nquery == 1));
       if (domtblfp)  p7_tophits_TabularDomains(domtblfp, qsq->name, qsq->acc, info->th, info->pli, (nquery == 1));
+      if (hitfp)     p7_hitfile_Write(hitfp, qsq->name, qsq->acc, info->th, info->pli);
       if (pfamtblfp) p7_tophits_TabularXfam(pfamtblfp, qsq->name, qsq->acc, info->th, info->pli);
 
       esl_stopwatch_Stop(w);
       p7_pli_Statistics(ofp, info->pli, w);
+      if (statsfp) p7_pli_JSONStatistics(statsfp, "phmmer", qsq->name, info->pli, info->th, w, ncpus);
+      p7_stagestats_Merge(&stagestats, &(info->pli->stats));
       if (fprintf(ofp, "//\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
       fflush(ofp);
 
@@ -651,8 +683,14 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
   /* Terminate outputs - any last words?
    */
+  if (esl_opt_GetBoolean(go, "--stagestats")) {
+    if (tblfp)     p7_pli_TabularStageStats(tblfp,     &stagestats);
+    if (domtblfp)  p7_pli_TabularStageStats(domtblfp,  &stagestats);
+    if (pfamtblfp) p7_pli_TabularStageStats(pfamtblfp, &stagestats);
+  }
   if (tblfp)     p7_tophits_TabularTail(tblfp,    "phmmer", p7_SEARCH_SEQS, cfg->qfile, cfg->dbfile, go);
   if (domtblfp)  p7_tophits_TabularTail(domtblfp, "phmmer", p7_SEARCH_SEQS, cfg->qfile, cfg->dbfile, go);
+  if (hitfp)    p7_hitfile_WriteTail(hitfp, "phmmer", p7_SEARCH_SEQS, cfg->qfile, cfg->dbfile, go);
   if (pfamtblfp) p7_tophits_TabularTail(pfamtblfp,"phmmer", p7_SEARCH_SEQS, cfg->qfile, cfg->dbfile, go);
   if (ofp)    { if (fprintf(ofp, "[ok]\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
 
@@ -669,10 +707,12 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 	esl_sq_DestroyBlock(block);
       esl_workqueue_Destroy(queue);
       esl_threads_Destroy(threadObj);
+      p7_domainpool_Destroy(ddpool);
     }
 #endif
 
   free(info);
+  p7_progress_Destroy(prg);
   esl_sqfile_Close(dbfp);
   esl_sqfile_Close(qfp);
   esl_stopwatch_Destroy(w);
@@ -685,7 +725,9 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (afp      != NULL)   fclose(afp);
   if (tblfp    != NULL)   fclose(tblfp);
   if (domtblfp != NULL)   fclose(domtblfp);
+  if (hitfp    != NULL)   fclose(hitfp);
   if (pfamtblfp)     fclose(pfamtblfp);
+  if (statsfp)       fclose(statsfp);
   return eslOK;
 
  ERROR:
@@ -869,7 +911,9 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   FILE            *afp      = NULL;               /* alignment output file (-A option)                */
   FILE            *tblfp    = NULL;		  /* output stream for tabular per-seq (--tblout)     */
   FILE            *domtblfp = NULL;		  /* output stream for tabular per-seq (--domtblout)  */
+  FILE            *hitfp    = NULL;		  /* output stream for binary hit output (--hitout)   */
   FILE            *pfamtblfp= NULL;              /* output stream for pfam-style tabular output  (--pfamtblout) */
+  FILE            *statsfp  = NULL;               /* JSON lines of search statistics (--statsout)     */
   int              qformat  = eslSQFILE_UNKNOWN;  /* format of qfile                                  */
   P7_BG           *bg       = NULL;	          /* null model                                      */
   ESL_SQFILE      *qfp      = NULL;		  /* open qfile                                       */
@@ -880,6 +924,7 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   ESL_ALPHABET    *abc      = NULL;               /* sequence alphabet                                */
   P7_BUILDER      *bld      = NULL;               /* HMM construction configuration                   */
   ESL_STOPWATCH   *w        = NULL;               /* for timing                                       */
+  P7_STAGESTATS    stagestats;                    /* per-stage totals over all queries (--stagestats) */
   int              nquery   = 0;
   int              seed;
   int              textw;
@@ -902,6 +947,7 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   /* Initializations */
   abc     = esl_alphabet_Create(eslAMINO);
   w       = esl_stopwatch_Create();
+  p7_stagestats_Zero(&stagestats);
   if (esl_opt_GetBoolean(go, "--notextw")) textw = 0;
   else                                     textw = esl_opt_GetInteger(go, "--textw");
   esl_stopwatch_Start(w);
@@ -948,8 +994,13 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
     mpi_failure("Failed to open tabular per-seq output file %s for writing\n", esl_opt_GetString(go, "--tblfp"));
   if (esl_opt_IsOn(go, "--domtblout") && (domtblfp = fopen(esl_opt_GetString(go, "--domtblout"), "w")) == NULL)
     mpi_failure("Failed to open tabular per-dom output file %s for writing\n", esl_opt_GetString(go, "--domtblfp"));
+  if (esl_opt_IsOn(go, "--hitout") && (hitfp = fopen(esl_opt_GetString(go, "--hitout"), "wb")) == NULL)
+    mpi_failure("Failed to open binary hit output file %s for writing\n", esl_opt_GetString(go, "--hitout"));
+  if (hitfp) p7_hitfile_WriteMagic(hitfp);
   if (esl_opt_IsOn(go, "--pfamtblout") && (pfamtblfp = fopen(esl_opt_GetString(go, "--pfamtblout"), "w")) == NULL)
     mpi_failure("Failed to open pfam-style tabular output file %s for writing\n", esl_opt_GetString(go, "--pfamtblout"));
+  if (esl_opt_IsOn(go, "--statsout") && (statsfp = fopen(esl_opt_GetString(go, "--statsout"), "w")) == NULL)
+    mpi_failure("Failed to open JSON statistics output file %s for writing\n", esl_opt_GetString(go, "--statsout"));
     
   /* Open the target sequence database for sequential access. */
   status =  esl_sqfile_OpenDigital(abc, cfg->dbfile, dbformat, p7_SEQDBENV, &dbfp);
@@ -1021,6 +1072,7 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
       /* Create processing pipeline and hit list */
       th  = p7_tophits_Create(); 
+      if (esl_opt_IsOn(go, "--max-hits")) p7_tophits_SetMaxHits(th, esl_opt_GetInteger(go, "--max-hits"));
       pli = p7_pipeline_Create(go, om->M, 100, FALSE, p7_SEARCH_SEQS); /* L_hint = 100 is just a dummy for now */
       p7_pli_NewModel(pli, om, bg);
 
@@ -1122,10 +1174,13 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   
       if (tblfp)     p7_tophits_TabularTargets(tblfp,    qsq->name, qsq->acc, th, pli, (nquery == 1));
       if (domtblfp)  p7_tophits_TabularDomains(domtblfp, qsq->name, qsq->acc, th, pli, (nquery == 1));
+      if (hitfp)     p7_hitfile_Write(hitfp, qsq->name, qsq->acc, th, pli);
       if (pfamtblfp) p7_tophits_TabularXfam(pfamtblfp,  qsq->name, qsq->acc, th, pli);
 
       esl_stopwatch_Stop(w);
       p7_pli_Statistics(ofp, pli, w);
+      if (statsfp) p7_pli_JSONStatistics(statsfp, "phmmer", qsq->name, pli, th, w, 0);
+      p7_stagestats_Merge(&stagestats, &(pli->stats));
       if (fprintf(ofp, "//\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 
       /* Output the results in an MSA (-A option) */
@@ -1184,8 +1239,14 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
   /* Terminate outputs - any last words?
    */
+  if (esl_opt_GetBoolean(go, "--stagestats")) {
+    if (tblfp)     p7_pli_TabularStageStats(tblfp,     &stagestats);
+    if (domtblfp)  p7_pli_TabularStageStats(domtblfp,  &stagestats);
+    if (pfamtblfp) p7_pli_TabularStageStats(pfamtblfp, &stagestats);
+  }
   if (tblfp)    p7_tophits_TabularTail(tblfp,    "phmmer", p7_SEARCH_SEQS, cfg->qfile, cfg->dbfile, go);
   if (domtblfp) p7_tophits_TabularTail(domtblfp, "phmmer", p7_SEARCH_SEQS, cfg->qfile, cfg->dbfile, go);
+  if (hitfp)    p7_hitfile_WriteTail(hitfp, "phmmer", p7_SEARCH_SEQS, cfg->qfile, cfg->dbfile, go);
   if (pfamtblfp)p7_tophits_TabularTail(pfamtblfp, "phmmer", p7_SEARCH_SEQS, cfg->qfile, cfg->dbfile, go);
   if (ofp)      { if (fprintf(ofp, "[ok]\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
 
@@ -1208,7 +1269,9 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   if (afp      != NULL)   fclose(afp);
   if (tblfp    != NULL)   fclose(tblfp);
   if (domtblfp != NULL)   fclose(domtblfp);
+  if (hitfp    != NULL)   fclose(hitfp);
   if (pfamtblfp)     fclose(pfamtblfp);
+  if (statsfp)       fclose(statsfp);
   return eslOK;
 
  ERROR:
@@ -1314,6 +1377,7 @@ mpi_worker(ESL_GETOPTS *go, struct cfg_s *cfg)
 
       /* Create processing pipeline and hit list */
       th  = p7_tophits_Create(); 
+      if (esl_opt_IsOn(go, "--max-hits")) p7_tophits_SetMaxHits(th, esl_opt_GetInteger(go, "--max-hits"));
       pli = p7_pipeline_Create(go, om->M, 100, FALSE, p7_SEARCH_SEQS); /* L_hint = 100 is just a dummy for now */
       p7_pli_NewModel(pli, om, bg);
 
@@ -1332,8 +1396,7 @@ mpi_worker(ESL_GETOPTS *go, struct cfg_s *cfg)
 	      length = dbsq->eoff - block.offset + 1;
 
 	      p7_pli_NewSeq(pli, dbsq);
-	      p7_bg_SetLength(bg, dbsq->n);
-	      p7_oprofile_ReconfigLength(om, dbsq->n);
+	      p7_pli_SetTargetLength(pli, om, bg, dbsq->n);
       
 	      p7_Pipeline(pli, om, bg, dbsq, NULL, th);
 
@@ -1390,8 +1453,12 @@ mpi_worker(ESL_GETOPTS *go, struct cfg_s *cfg)
 #endif /*HMMER_MPI*/
 
 
+/* serial_loop(), thread_loop()
+ * Search the target database with one query; if <prg> is non-NULL,
+ * count the targets read on it as they're read.
+ */
 static int
-serial_loop(WORKER_INFO *info, ESL_SQFILE *dbfp, int n_targetseqs)
+serial_loop(WORKER_INFO *info, ESL_SQFILE *dbfp, int n_targetseqs, P7_PROGRESS *prg)
 {
   int      sstatus   = eslOK;
   ESL_SQ   *dbsq     = NULL;   /* one target sequence (digital)  */
@@ -1403,11 +1470,11 @@ serial_loop(WORKER_INFO *info, ESL_SQFILE *dbfp, int n_targetseqs)
   while ((n_targetseqs==-1 || seq_cnt<n_targetseqs) && (sstatus = esl_sqio_Read(dbfp, dbsq)) == eslOK)
     {
       p7_pli_NewSeq(info->pli, dbsq);
-      p7_bg_SetLength(info->bg, dbsq->n);
-      p7_oprofile_ReconfigLength(info->om, dbsq->n);
+      p7_pli_SetTargetLength(info->pli, info->om, info->bg, dbsq->n);
       
       p7_Pipeline(info->pli, info->om, info->bg, dbsq, NULL, info->th);
 
+      if (prg) p7_progress_Update(prg, 1, dbsq->n, dbsq->eoff);
       seq_cnt++;
       esl_sq_Reuse(dbsq);
       p7_pipeline_Reuse(info->pli);
@@ -1423,11 +1490,13 @@ serial_loop(WORKER_INFO *info, ESL_SQFILE *dbfp, int n_targetseqs)
 
 #ifdef HMMER_THREADS
 static int
-thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, int n_targetseqs)
+thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, int n_targetseqs, P7_PROGRESS *prg)
 {
   int  status  = eslOK;
   int  sstatus = eslOK;
   int  eofCount = 0;
+  int  i;
+  int64_t       nres;
   ESL_SQ_BLOCK *block;
   void         *newBlock;
 
@@ -1451,6 +1520,12 @@ thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, int n_tar
         n_targetseqs -= block->count;
       }
 
+      if (prg && sstatus == eslOK && block->count > 0)
+      {
+        for (nres = 0, i = 0; i < block->count; i++) nres += block->list[i].n;
+        p7_progress_Update(prg, block->count, nres, block->list[block->count-1].eoff);
+      }
+
       if (sstatus == eslEOF)
       {
         if (eofCount < esl_threads_GetWorkerCount(obj)) sstatus = eslOK;
@@ -1487,6 +1562,8 @@ pipeline_thread(void *arg)
   ESL_THREADS   *obj;
   ESL_SQ_BLOCK  *block = NULL;
   void          *newBlock;
+  int           *order  = NULL;	/* indices of the block's seqs, by length */
+  int            norder = 0;
   
   impl_Init();
 
@@ -1502,14 +1579,20 @@ pipeline_thread(void *arg)
   block = (ESL_SQ_BLOCK *) newBlock;
   while (block->count > 0)
     {
+      /* visit the block in order of length, so the model is reconfigured once per distinct length */
+      if (block->count > norder) {
+	ESL_REALLOC(order, sizeof(int) * block->count);
+	norder = block->count;
+      }
+      p7_pli_OrderByLength(block->list, block->count, order);
+
       /* Main loop: */
       for (i = 0; i < block->count; ++i)
 	{
-	  ESL_SQ *dbsq = block->list + i;
+	  ESL_SQ *dbsq = block->list + order[i];
 
 	  p7_pli_NewSeq(info->pli, dbsq);
-	  p7_bg_SetLength(info->bg, dbsq->n);
-	  p7_oprofile_ReconfigLength(info->om, dbsq->n);
+	  p7_pli_SetTargetLength(info->pli, info->om, info->bg, dbsq->n);
 	  
 	  p7_Pipeline(info->pli, info->om, info->bg, dbsq, NULL, info->th);
 	  
@@ -1526,8 +1609,12 @@ pipeline_thread(void *arg)
   status = esl_workqueue_WorkerUpdate(info->queue, block, NULL);
   if (status != eslOK) p7_Fail("Work queue worker failed");
 
+  free(order);
   esl_threads_Finished(obj, workeridx);
   return;
+
+ ERROR:
+  p7_Fail("allocation failure in pipeline thread");
 }
 #endif   /* HMMER_THREADS */
 
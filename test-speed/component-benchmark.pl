@@ -2,66 +2,66 @@
 
 # Component speed benchmarks
 #
-# Usage:     ./component-benchmark.pl <top_builddir>   <top_srcdir> 
-# Example:   ./component-benchmark.pl ../build-icc-mpi ..  > component-benchmark.out
+# Usage:     ./component-benchmark.pl <top_builddir> <top_srcdir> [<json outfile> [<tag>]]
+# Example:   ./component-benchmark.pl ../build-icc-mpi .. > component-benchmark.out
+#            ./component-benchmark.pl ../build-gcc .. gcc-skylake.json gcc-skylake
 #
-# For a range of models of different sizes, run a speed benchmark for
-# each component of H3's pipeline. Output an ASCII summary table to
-# stdout.
+# For a range of models of different sizes (testsuite models, plus
+# models sampled by the benchmark itself), run a speed benchmark for
+# each DP kernel of H3's pipeline, vectorized and generic, at several
+# target lengths, using the unified kernels_benchmark driver (make dev
+# in src/). Output an ASCII summary table to stdout: one row per
+# kernel, one column per model, in Mc/s at the middle target length.
+# Optionally also save the driver's full results as JSON, labeled with
+# <tag>, for comparing builds and CPU types.
 #
 # SRE, Thu Mar 10 09:07:38 2011
 
 $top_builddir = shift;
 $top_srcdir   = shift;
+$jsonfile     = shift;
+$tag          = shift;
 
-#@benchmarks = ( "./generic_fwdback_benchmark -F", "./msvfilter_benchmark" );
-  	
-@benchmarks = ( "src/impl/msvfilter_benchmark", 
- 		"src/impl/vitfilter_benchmark",
- 		"src/impl/fwdback_benchmark -PF",
-  		"src/impl/fwdback_benchmark -PB",
- 		"src/impl/fwdback_benchmark -F",
-  		"src/impl/fwdback_benchmark -B",
-  		"src/impl/decoding_benchmark",
-  		"src/impl/null2_benchmark",
-  		"src/impl/null2_benchmark -t",
-  		"src/impl/optacc_benchmark",
-		"src/generic_msv_benchmark",
-		"src/generic_viterbi_benchmark",
-		"src/generic_fwdback_benchmark -F",
-		"src/generic_fwdback_benchmark -B",
-		"src/generic_decoding_benchmark",
-		"src/generic_null2_benchmark",
-		"src/generic_optacc_benchmark" );
+$benchmark    = "${top_builddir}/src/kernels_benchmark";
+@models       = ("XYPPX", "RRM_1", "Caudal_act", "LuxC", "Patched", "SMC_N");
+@Ls           = (100, 400, 1000);
+$tableL       = 400;
 
-@models = ("XYPPX", "RRM_1", "Caudal_act", "LuxC", "Patched", "SMC_N");
+if (! -x $benchmark) { die "$benchmark not found: do 'make dev' in src/ first\n"; }
 
-printf("%30s ", "");
-foreach $model (@models) { printf("%23s ", $model); }
-printf("\n");
-printf("%30s ", "");
-foreach $model (@models) { printf("%23s ", "-----------------------"); }
-printf("\n");
+$opts  = "-L " . join(",", @Ls);
+$opts .= " --json $jsonfile" if defined $jsonfile;
+$opts .= " --tag $tag"       if defined $tag;
+$hmmfiles = join(" ", map { "${top_srcdir}/testsuite/$_.hmm" } @models);
+
+$output = `$benchmark $opts $hmmfiles`;
+if ($? != 0) { die "$benchmark failed\n"; }
 
-foreach $benchmark (@benchmarks)
+# Table rows: kernel impl model M L N cputime Mc/s
+@kernels = ();
+%seen    = ();
+@names   = ();
+%mname   = ();
+foreach $line (split(/\n/, $output))
 {
-    ($benchmark_name) = ($benchmark =~ /\/([^\/]+_benchmark.*)$/);
-    printf("%-30s ", $benchmark_name);
-    foreach $model (@models)
-    {
-	$output = `${top_builddir}/$benchmark ${top_srcdir}/testsuite/$model.hmm`;
-	($cputime, $M, $Mcs) = &get_results($output);  
-	printf("%8s (%7s Mc/s) ", $cputime, $Mcs);
-    }	    
-    printf("\n");
+    next if $line =~ /^\#/;
+    ($kernel, $impl, $model, $M, $L, $N, $cputime, $Mcs) = split(' ', $line);
+    next unless defined $Mcs;
+    next unless $L == $tableL;
+    if (! $seen{$kernel}++)  { push(@kernels, $kernel); }
+    if (! $mname{$model}++)  { push(@names,   $model);  }
+    $result{$kernel}{$model} = sprintf("%8s (%7s Mc/s)", $cputime, $Mcs);
 }
 
-
-sub get_results {
-    my($output) = @_;
-
-    if ($output =~ /^\# CPU time:\s+(\S+)/) { $cputime = $1; }
-    if ($output =~ /^\# M\s+=\s+(\d+)/)     { $M       = $1; }
-    if ($output =~ /\# (\S+) Mc\/s/)        { $Mcs     = $1; } 
-    ($cputime, $M, $Mcs);
+printf("%-12s ", "L=$tableL");
+foreach $model (@names) { printf("%23s ", $model); }
+printf("\n");
+printf("%-12s ", "");
+foreach $model (@names) { printf("%23s ", "-----------------------"); }
+printf("\n");
+foreach $kernel (@kernels)
+{
+    printf("%-12s ", $kernel);
+    foreach $model (@names) { printf("%23s ", $result{$kernel}{$model}); }
+    printf("\n");
 }
@@ -0,0 +1,211 @@
+#! /usr/bin/perl
+
+# Self-contained pipeline throughput benchmark
+#
+# Usage:    ./pipeline-benchmark.pl [-options] <top_builddir> <top_srcdir> <workdir>
+# Example:  ./pipeline-benchmark.pl -c 0,1,4 ../build-gcc .. pb-gcc > pb-gcc.out
+#
+# Unlike speed-master.pl, needs no cluster and no external databases:
+# everything it searches is synthesized deterministically from the
+# testsuite models, so results are comparable across builds and
+# machines. It:
+#
+#   1. makes a protein target database: sequences sampled from the
+#      testsuite's protein models in multihit local profile mode
+#      (hmmemit -p; homologs in random flanks), interleaved with
+#      i.i.d. background sequences (esl-shuffle -G); and a DNA one,
+#      the same way from the DNA models, with long background
+#      sequences;
+#   2. times hmmsearch, hmmscan, phmmer, jackhmmer and nhmmer on them,
+#      at each of a list of --cpu counts;
+#   3. reports, for each run, wall clock and CPU seconds, the number
+#      of targets (or residues, for nhmmer) passing each filter stage,
+#      and the number of hits, summed over all queries in the run.
+#
+# Output is one whitespace-delimited line per run, with a header
+# line starting with '#'. With -t, each run is made with --stagestats,
+# and is followed by a '#' line of the seconds spent in each pipeline
+# stage (summed over threads and queries), from the tail of its
+# --tblout file.
+#
+# Options:
+#   -c <list>  : comma-separated --cpu counts to time     [0,1,2,4]
+#   -n <n>     : protein background sequences, L=400      [20000]
+#   -h <n>     : homologs sampled from each model         [200]
+#   -s <n>     : random number seed for the database      [42]
+#   -k         : keep <workdir> and the database when done
+#   -t         : also report per-stage times (--stagestats)
+#
+# The <workdir> is created; it must not already exist.
+
+use Getopt::Std;
+use Time::HiRes qw(gettimeofday tv_interval);
+
+getopts('c:n:h:s:kt');
+$cpulist  = defined $opt_c ? $opt_c : "0,1,2,4";
+$nbg      = defined $opt_n ? $opt_n : 20000;
+$nhom     = defined $opt_h ? $opt_h : 200;
+$seed     = defined $opt_s ? $opt_s : 42;
+
+$top_builddir = shift;
+$top_srcdir   = shift;
+$wrkdir       = shift;
+if (! defined $wrkdir) { die "Usage: ./pipeline-benchmark.pl [-options] <top_builddir> <top_srcdir> <workdir>\n"; }
+
+@protmodels = ("2OG-FeII_Oxy_3", "Caudal_act", "LuxC", "Patched", "RRM_1", "SMC_N");
+@dnamodels  = ("2OG-FeII_Oxy_3-nt", "3box", "PSE");
+$query      = "Caudal_act";	# consensus of this model is the phmmer/jackhmmer query
+$nscan      = 100;		# hmmscan queries: the first <nscan> protein targets
+
+@h3progs  = ("hmmemit", "hmmpress", "hmmsearch", "hmmscan", "phmmer", "jackhmmer", "nhmmer");
+@eslprogs = ("esl-shuffle");
+foreach $prog (@h3progs)  { if (! -x "$top_builddir/src/$prog")            { die "didn't find $prog executable in $top_builddir/src\n"; } }
+foreach $prog (@eslprogs) { if (! -x "$top_builddir/easel/miniapps/$prog") { die "didn't find $prog executable in $top_builddir/easel/miniapps\n"; } }
+$emit    = "$top_builddir/src/hmmemit";
+$shuffle = "$top_builddir/easel/miniapps/esl-shuffle";
+
+if (-e $wrkdir) { die "$wrkdir exists\n"; }
+mkdir($wrkdir) || die "failed to create $wrkdir\n";
+
+# A build without thread support has no --cpu option: time it serially only.
+$output = `$top_builddir/src/hmmsearch -h`;
+@cpus   = ($output =~ /--cpu/) ? split(/,/, $cpulist) : ("-");
+
+# 1. The databases, and the query files.
+&cat_models("$wrkdir/prot.hmm", @protmodels);
+&cat_models("$wrkdir/dna.hmm",  @dnamodels);
+&run("$top_builddir/src/hmmpress $wrkdir/prot.hmm");
+
+$s = $seed;
+foreach $model (@protmodels) { &run("$emit -p -L 400  -N $nhom --seed $s $top_srcdir/testsuite/$model.hmm >> $wrkdir/prot-hom.fa"); $s++; }
+foreach $model (@dnamodels)  { &run("$emit -p -L 2000 -N 50    --seed $s $top_srcdir/testsuite/$model.hmm >> $wrkdir/dna-hom.fa");  $s++; }
+&run("$shuffle -G --amino -N $nbg -L 400    --seed $s > $wrkdir/prot-bg.fa"); $s++;
+&run("$shuffle -G --dna   -N 20   -L 100000 --seed $s > $wrkdir/dna-bg.fa");  $s++;
+&mix_fasta("$wrkdir/prot.fa", "$wrkdir/prot-hom.fa", "$wrkdir/prot-bg.fa", 0);
+&mix_fasta("$wrkdir/dna.fa",  "$wrkdir/dna-hom.fa",  "$wrkdir/dna-bg.fa",  0);
+&mix_fasta("$wrkdir/scan.fa", "$wrkdir/prot-hom.fa", "$wrkdir/prot-bg.fa", $nscan);
+&run("$emit -c $top_srcdir/testsuite/$query.hmm > $wrkdir/query.fa");
+
+# 2. The searches.
+@searches = ( [ "hmmsearch", "",      "$wrkdir/prot.hmm",  "$wrkdir/prot.fa" ],
+	      [ "hmmscan",   "",      "$wrkdir/prot.hmm",  "$wrkdir/scan.fa" ],
+	      [ "phmmer",    "",      "$wrkdir/query.fa",  "$wrkdir/prot.fa" ],
+	      [ "jackhmmer", "-N 3",  "$wrkdir/query.fa",  "$wrkdir/prot.fa" ],
+	      [ "nhmmer",    "",      "$wrkdir/dna.hmm",   "$wrkdir/dna.fa"  ] );
+
+$uname = `uname -srm`; chomp $uname;
+printf("# pipeline-benchmark: seed=%d nbg=%d nhom=%d; %s\n", $seed, $nbg, $nhom, $uname);
+printf("# %-10s %4s %10s %10s %12s %12s %12s %12s %12s %8s\n",
+       "program", "cpu", "wall(s)", "cpu(s)", "targets", "pass_msv", "pass_bias", "pass_vit", "pass_fwd", "hits");
+
+foreach $search (@searches)
+{
+    ($prog, $opts, $qfile, $tfile) = @$search;
+    # Warmup: an untimed run, so the target database is in the filesystem cache.
+    &run("$top_builddir/src/$prog $opts -o /dev/null $qfile $tfile");
+
+    foreach $ncpu (@cpus)
+    {
+	$cpuopt = ($ncpu eq "-") ? "" : "--cpu $ncpu";
+	$cpuopt .= " --stagestats" if $opt_t;
+	$t0     = [gettimeofday];
+	$output = `$top_builddir/src/$prog $opts $cpuopt --tblout $wrkdir/$prog.tbl $qfile $tfile`;
+	if ($? != 0) { die "FAIL: $prog $opts $cpuopt\n"; }
+	$wall   = tv_interval($t0);
+
+	&parse_stats($output);
+	$nhits = `grep -cv '^#' $wrkdir/$prog.tbl`; chomp $nhits;
+	printf("  %-10s %4s %10.2f %10.2f %12d %12d %12d %12d %12d %8d\n",
+	       $prog, $ncpu, $wall, $cputime, $ntargets, $npass{msv}, $npass{bias}, $npass{vit}, $npass{fwd}, $nhits);
+	if ($opt_t) { printf("#   stages(s): %s\n", &stage_times("$wrkdir/$prog.tbl")); }
+    }
+}
+
+if (! $opt_k) { system("rm -rf $wrkdir"); }
+exit 0;
+
+
+sub run {
+    my ($cmd) = @_;
+    system("$cmd > /dev/null 2>&1") if $cmd !~ />/;
+    system("$cmd 2>/dev/null")      if $cmd =~ />/;
+    if ($? != 0) { die "FAIL: $cmd\n"; }
+}
+
+sub cat_models {
+    my ($outfile, @models) = @_;
+    my $model;
+    unlink $outfile;
+    foreach $model (@models) { &run("cat $top_srcdir/testsuite/$model.hmm >> $outfile"); }
+}
+
+# mix_fasta(<outfile>, <homfile>, <bgfile>, <nmax>)
+# Interleave homologs evenly among background seqs, renaming all of
+# them "bench<n>" (keeping the original name as the description);
+# write only the first <nmax> seqs, if <nmax> > 0.
+sub mix_fasta {
+    my ($outfile, $homfile, $bgfile, $nmax) = @_;
+    my @hom = &read_fasta($homfile);
+    my @bg  = &read_fasta($bgfile);
+    my $n   = 0;
+    my ($i, $j, $step, $seq);
+
+    open(OUT, ">$outfile") || die "failed to open $outfile\n";
+    $step = (@hom > 0) ? (@bg + @hom) / @hom : 0;
+    for ($i = $j = 0; $i < @bg || $j < @hom; )
+    {
+	if ($j < @hom && ($i >= @bg || ($n+1) >= ($j+1) * $step)) { $seq = $hom[$j++]; }
+	else                                                      { $seq = $bg[$i++];  }
+	$seq =~ s/^>(\S+)[^\n]*/>bench$n $1/;
+	print OUT $seq;
+	$n++;
+	last if $nmax > 0 && $n >= $nmax;
+    }
+    close OUT;
+}
+
+sub read_fasta {
+    my ($file) = @_;
+    my @seqs   = ();
+    open(IN, $file) || die "failed to open $file\n";
+    while (<IN>)
+    {
+	if (/^>/) { push(@seqs, $_); }
+	else      { $seqs[$#seqs] .= $_; }
+    }
+    close IN;
+    return @seqs;
+}
+
+# stage_times(<tblfile>)
+# The per-stage seconds recorded by --stagestats in the tail of a
+# tabular output file, as "name=secs ..." in pipeline order.
+sub stage_times {
+    my ($file) = @_;
+    my @stages = ();
+    open(IN, $file) || die "failed to open $file\n";
+    while (<IN>)
+    {
+	if (/^\# Stage (\S+):\s+(\S+) sec/) { push(@stages, "$1=$2"); }
+    }
+    close IN;
+    return join(" ", @stages);
+}
+
+# parse_stats(<output>)
+# Sum the pipeline statistics over all the queries (and iterations) in one run.
+sub parse_stats {
+    my ($output) = @_;
+    $cputime  = 0.;
+    $ntargets = 0;
+    %npass    = (msv => 0, bias => 0, vit => 0, fwd => 0);
+    foreach (split(/\n/, $output))
+    {
+	if    (/^Target (?:sequences|model\(s\)):\s+(\d+)/)      { $ntargets     += $1; }
+	elsif (/^(?:Passed|Residues passing) (?:MSV|SSV) filter:\s*(\d+)/) { $npass{msv}  += $1; }
+	elsif (/^(?:Passed|Residues passing) bias filter:\s*(\d+)/)        { $npass{bias} += $1; }
+	elsif (/^(?:Passed|Residues passing) Vit filter:\s*(\d+)/)         { $npass{vit}  += $1; }
+	elsif (/^(?:Passed|Residues passing) Fwd filter:\s*(\d+)/)         { $npass{fwd}  += $1; }
+	elsif (/^\# CPU time:\s+(\S+)u\s+(\S+)s/)                 { $cputime      += $1 + $2; }
+    }
+}
@@ -0,0 +1,86 @@
+#! /usr/bin/perl
+
+# Test that a binary hit file (--hitout) converts back to exactly the
+# tabular output (--tblout, --domtblout) that the search programs
+# write directly.
+#
+# Usage:   ./i22-hitfile.pl <builddir> <srcdir> <tmpfile prefix>
+# Example: ./i22-hitfile.pl ..         ..       tmpfoo
+# 
+
+BEGIN {
+    $builddir  = shift;
+    $srcdir    = shift;
+    $tmppfx    = shift;
+    $verbose   = shift;  # if arg not given, defaults to false (zero)    
+}
+
+# The test makes use of the following files:
+#   20aa.hmm, 20aa-alitest.fa       protein query model, target seqs
+#   3box.hmm, 3box-alitest.fa       DNA query model, target seqs (nhmmer)
+#
+# It creates the following files:
+#   $tmppfx.hmm                     two copies of 20aa.hmm, so there are two queries
+#   $tmppfx.fa                      one query seq sampled from 20aa.hmm
+#   $tmppfx.hit                     binary hit file
+#   $tmppfx.tbl, $tmppfx.domtbl     tabular output from the search program
+#   $tmppfx.tbl2, $tmppfx.domtbl2   tabular output from hmmhitconvert
+
+@h3progs =  ( "hmmsearch", "phmmer", "nhmmer", "hmmemit", "hmmhitconvert");
+foreach $h3prog  (@h3progs)  { if (! -x "$builddir/src/$h3prog")          { die "FAIL: didn't find $h3prog executable in $builddir/src\n";              } }
+
+do_cmd("cat $srcdir/testsuite/20aa.hmm $srcdir/testsuite/20aa.hmm > $tmppfx.hmm");
+do_cmd("$builddir/src/hmmemit --seed 10 $srcdir/testsuite/20aa.hmm > $tmppfx.fa");
+
+# hmmsearch
+do_cmd("$builddir/src/hmmsearch --tblout $tmppfx.tbl --domtblout $tmppfx.domtbl --hitout $tmppfx.hit $tmppfx.hmm $srcdir/testsuite/20aa-alitest.fa");
+if ($? != 0) { die "FAIL: hmmsearch failed\n"; }
+check("hmmsearch", 1);
+
+# phmmer
+do_cmd("$builddir/src/phmmer --tblout $tmppfx.tbl --domtblout $tmppfx.domtbl --hitout $tmppfx.hit $tmppfx.fa $srcdir/testsuite/20aa-alitest.fa");
+if ($? != 0) { die "FAIL: phmmer failed\n"; }
+check("phmmer", 1);
+
+# nhmmer has no per-domain table
+do_cmd("$builddir/src/nhmmer --tblout $tmppfx.tbl --hitout $tmppfx.hit $srcdir/testsuite/3box.hmm $srcdir/testsuite/3box-alitest.fa");
+if ($? != 0) { die "FAIL: nhmmer failed\n"; }
+check("nhmmer", 0);
+
+print "ok\n";
+unlink "$tmppfx.hmm";
+unlink "$tmppfx.fa";
+unlink "$tmppfx.hit";
+unlink <$tmppfx.tbl*>;
+unlink <$tmppfx.domtbl*>;
+exit 0;
+
+
+sub check {
+    my ($prog, $do_dom) = @_;
+
+    if ($do_dom) { do_cmd("$builddir/src/hmmhitconvert --tblout $tmppfx.tbl2 --domtblout $tmppfx.domtbl2 $tmppfx.hit"); }
+    else         { do_cmd("$builddir/src/hmmhitconvert --tblout $tmppfx.tbl2 $tmppfx.hit"); }
+    if ($? != 0) { die "FAIL: hmmhitconvert failed on $prog hit file\n"; }
+
+    if (slurp("$tmppfx.tbl") ne slurp("$tmppfx.tbl2"))                   { die "FAIL: $prog --tblout and converted hit file differ\n"; }
+    if ($do_dom && slurp("$tmppfx.domtbl") ne slurp("$tmppfx.domtbl2"))  { die "FAIL: $prog --domtblout and converted hit file differ\n"; }
+    if (slurp("$tmppfx.tbl") !~ /^[^#]/m)                                { die "FAIL: $prog found no hits to compare\n"; }
+}
+
+# slurp a tabular output file, except for its timestamp, which
+# may differ by a second between the two.
+sub slurp {
+    my ($file) = @_;
+    my $text = "";
+    open(TBL, $file) || die "FAIL: couldn't open $file\n";
+    while (<TBL>) { if (! /^\# Date:/) { $text .= $_; } }
+    close TBL;
+    return $text;
+}
+
+sub do_cmd {
+    $cmd = shift;
+    print "$cmd\n" if $verbose;
+    return `$cmd`;  
+}
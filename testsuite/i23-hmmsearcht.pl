@@ -0,0 +1,113 @@
+#! /usr/bin/perl
+
+# Test that hmmsearcht finds a protein coding sequence on either
+# strand of a DNA target, and reports it in nucleotide coordinates
+# on the codons of the coding sequence.
+#
+# Usage:   ./i23-hmmsearcht.pl <builddir> <srcdir> <tmpfile prefix>
+# Example: ./i23-hmmsearcht.pl ..         ..       tmpfoo
+#
+
+BEGIN {
+    $builddir  = shift;
+    $srcdir    = shift;
+    $tmppfx    = shift;
+    $verbose   = shift;  # if arg not given, defaults to false (zero)
+}
+
+# The test makes use of the following files:
+#   tutorial/globins4.hmm        protein query model
+#   tutorial/HBB_HUMAN           a globin, back-translated into the targets
+#
+# It creates the following files:
+#   $tmppfx.fa                   two DNA targets: HBB_HUMAN's coding sequence
+#                                on the top strand of "watson", and on the
+#                                bottom strand of "crick", in random flanks
+#   $tmppfx.domtbl               per-domain tabular output
+
+@h3progs =  ( "hmmsearcht");
+foreach $h3prog  (@h3progs)  { if (! -x "$builddir/src/$h3prog")          { die "FAIL: didn't find $h3prog executable in $builddir/src\n";              } }
+
+# One codon for each amino acid is enough.
+%codon = ( A => "GCT", C => "TGT", D => "GAT", E => "GAA", F => "TTT", G => "GGT", H => "CAT", I => "ATT",
+	   K => "AAA", L => "CTG", M => "ATG", N => "AAT", P => "CCG", Q => "CAG", R => "CGT", S => "TCT",
+	   T => "ACC", V => "GTT", W => "TGG", Y => "TAT" );
+
+open(SEQ, "$srcdir/tutorial/HBB_HUMAN") || die "FAIL: couldn't open HBB_HUMAN\n";
+while (<SEQ>) { if (! /^>/) { chomp; $prot .= $_; } }
+close SEQ;
+$cds = "";
+foreach $aa (split //, $prot) { $cds .= $codon{$aa}; }
+
+srand(42);
+$flank5  = random_dna(301);
+$flank3  = random_dna(259);
+$start   = length($flank5) + 1;          # 1st nt of the coding sequence
+$end     = $start + length($cds) - 1;    # last nt of the coding sequence
+$L       = length($flank5) + length($cds) + length($flank3);
+
+open(FA, ">$tmppfx.fa") || die "FAIL: couldn't write $tmppfx.fa\n";
+print FA ">watson\n", $flank5, $cds, $flank3, "\n";
+print FA ">crick\n",  revcomp($flank5 . $cds . $flank3), "\n";
+close FA;
+
+do_cmd("$builddir/src/hmmsearcht --domtblout $tmppfx.domtbl $srcdir/tutorial/globins4.hmm $tmppfx.fa");
+if ($? != 0) { die "FAIL: hmmsearcht failed\n"; }
+
+open(TBL, "$tmppfx.domtbl") || die "FAIL: couldn't open $tmppfx.domtbl\n";
+while (<TBL>)
+{
+    if (/^\#/) { next; }
+    @fields  = split;
+    ($name, $alifrom, $alito) = ($fields[0], $fields[17], $fields[18]);
+    if ($fields[6] > 1e-20) { next; }  # only the real hit, not chance hits in the flanks
+    $seen{$name}++;
+
+    if ($name eq "watson") {
+	if ($alifrom >= $alito)                        { die "FAIL: watson hit on wrong strand\n"; }
+	if ($alifrom < $start || $alito > $end)        { die "FAIL: watson hit outside the coding sequence\n"; }
+	if (($alifrom - $start) % 3 != 0)              { die "FAIL: watson hit doesn't start on a codon\n"; }
+	if (($alito - $start) % 3   != 2)              { die "FAIL: watson hit doesn't end on a codon\n"; }
+    } elsif ($name eq "crick") {
+	# On the reverse strand, the coding sequence runs from L-start+1 down to L-end+1.
+	if ($alifrom <= $alito)                        { die "FAIL: crick hit on wrong strand\n"; }
+	if ($alifrom > $L-$start+1 || $alito < $L-$end+1) { die "FAIL: crick hit outside the coding sequence\n"; }
+	if (($L-$start+1 - $alifrom) % 3 != 0)         { die "FAIL: crick hit doesn't start on a codon\n"; }
+	if (($L-$start+1 - $alito)   % 3 != 2)         { die "FAIL: crick hit doesn't end on a codon\n"; }
+    }
+}
+close TBL;
+if ($seen{"watson"} != 1) { die "FAIL: expected one hit to watson\n"; }
+if ($seen{"crick"}  != 1) { die "FAIL: expected one hit to crick\n"; }
+
+# Restricted to one strand, only that strand's hit is found.
+do_cmd("$builddir/src/hmmsearcht --watson -E 1e-20 --domtblout $tmppfx.domtbl $srcdir/tutorial/globins4.hmm $tmppfx.fa");
+if ($? != 0) { die "FAIL: hmmsearcht --watson failed\n"; }
+$output = `grep -v '^#' $tmppfx.domtbl`;
+if ($output !~ /^watson / || $output =~ /^crick /m) { die "FAIL: --watson\n"; }
+
+print "ok\n";
+unlink "$tmppfx.fa";
+unlink "$tmppfx.domtbl";
+exit 0;
+
+
+sub random_dna {
+    my ($n) = @_;
+    my $s = "";
+    for (my $i = 0; $i < $n; $i++) { $s .= substr("ACGT", int(rand(4)), 1); }
+    return $s;
+}
+
+sub revcomp {
+    my ($s) = @_;
+    $s = reverse $s;
+    $s =~ tr/ACGT/TGCA/;
+    return $s;
+}
+
+sub do_cmd {
+    $cmd = shift;
+    print "$cmd\n" if $verbose;
+    return `$cmd`;
+}
@@ -0,0 +1,78 @@
+#! /usr/bin/perl
+
+# Test that multithreaded programs give the same results as a serial
+# run with the same --seed: --cpu 0 and --cpu 2 must produce
+# identical output, apart from comment lines (timings and the like).
+#
+# Usage:   ./i24-cpu-determinism.pl <builddir> <srcdir> <tmpfile prefix>
+# Example: ./i24-cpu-determinism.pl ..         ..       tmpfoo
+#
+
+BEGIN {
+    $builddir  = shift;
+    $srcdir    = shift;
+    $tmppfx    = shift;
+    $verbose   = shift;  # if arg not given, defaults to false (zero)
+}
+
+# The test makes use of the following files:
+#   Caudal_act.hmm                  query model for hmmsim
+#   SMC_N.sto                       one alignment: hmmbuild threads inside the build
+#   minifam                         several alignments: hmmbuild threads across them
+#
+# It creates the following files:
+#   $tmppfx.0.out, $tmppfx.2.out    output with --cpu 0, --cpu 2
+#   $tmppfx.0.hmm, $tmppfx.2.hmm    hmmbuild's models, ditto
+
+@h3progs =  ( "hmmsim", "hmmbuild" );
+foreach $h3prog  (@h3progs)  { if (! -x "$builddir/src/$h3prog")          { die "FAIL: didn't find $h3prog executable in $builddir/src\n";              } }
+
+# hmmsim: N spans several RNG chunks, so shares split them
+foreach $opts ("", "--vit", "--fast --fwd")
+{
+    check_cpu("hmmsim $opts", "$builddir/src/hmmsim --cpu %1\$d --seed 42 -N 2500 $opts -o %2\$s.out $srcdir/testsuite/Caudal_act.hmm > /dev/null", ".out");
+}
+
+# hmmbuild: model construction and calibration, one alignment or several
+foreach $msafile ("SMC_N.sto", "minifam")
+{
+    check_cpu("hmmbuild $msafile", "$builddir/src/hmmbuild --cpu %1\$d --seed 42 -o %2\$s.out %2\$s.hmm $srcdir/testsuite/$msafile", ".out", ".hmm");
+}
+
+print "ok\n";
+unlink <$tmppfx.*.out>;
+unlink <$tmppfx.*.hmm>;
+exit 0;
+
+
+# check_cpu($what, $cmd, @sfx): run $cmd with --cpu 0 and 2 (%1$d),
+# writing files <prefix>.<sfx> (%2$s is <prefix>), and compare them.
+sub check_cpu {
+    my ($what, $cmd, @sfx) = @_;
+
+    foreach $ncpu (0, 2) {
+	do_cmd(sprintf($cmd, $ncpu, "$tmppfx.$ncpu"));
+	if ($? != 0) { die "FAIL: $what --cpu $ncpu failed\n"; }
+    }
+    foreach $sfx (@sfx) {
+	if (slurp("$tmppfx.0$sfx") ne slurp("$tmppfx.2$sfx")) { die "FAIL: $what $sfx output differs between --cpu 0 and --cpu 2\n"; }
+	if (slurp("$tmppfx.0$sfx") eq "")                      { die "FAIL: $what gave no $sfx output to compare\n"; }
+    }
+}
+
+# slurp an output file, except for comment lines, and the DATE and
+# COM lines of a model file, which record when and how it was built.
+sub slurp {
+    my ($file) = @_;
+    my $text = "";
+    open(OUT, $file) || die "FAIL: couldn't open $file\n";
+    while (<OUT>) { if (! /^(\#|DATE |COM )/) { $text .= $_; } }
+    close OUT;
+    return $text;
+}
+
+sub do_cmd {
+    $cmd = shift;
+    if ($verbose) { print "$cmd\n"; }
+    system("$cmd");
+}